@@ -13,8 +13,9 @@ import numpy as np
 
 from extra_foam.algorithms import (
     correct_image_data, mask_image_data, movingAvgImageData,
-    nanmean_image_data
+    nanmean_image_data, partition_config
 )
+from extra_foam.algorithms.imageproc import setSimdEnabled, simdEnabled
 
 
 def _run_nanmean_image_array(data, data_type):
@@ -232,6 +233,86 @@ def bench_correct_gain_offset(shape):
     _run_correct_image_array(data, np.float64, gain, offset)
 
 
+def _run_simd(func, data, nbytes, repeat=5):
+    """Return the throughputs (GB/s) of the scalar and the SIMD code paths."""
+    throughputs = []
+    for enabled in (False, True):
+        setSimdEnabled(enabled)
+        dt = float("inf")
+        for _ in range(repeat):
+            data_cpp = data.copy()
+            t0 = time.perf_counter()
+            func(data_cpp)
+            dt = min(dt, time.perf_counter() - t0)
+        throughputs.append(nbytes / dt / 1e9)
+    setSimdEnabled(True)
+    return throughputs
+
+
+def bench_simd(shape):
+    data = np.random.rand(*shape)
+    data[::4, ::4, ::4] = np.nan
+    mask = np.zeros(shape[-2:], dtype=np.bool)
+    mask[::10, ::10] = True
+    gain = np.random.randn(*shape)
+    offset = np.random.randn(*shape)
+
+    if not simdEnabled():
+        print("\nSIMD is not available!")
+        return
+
+    for data_type in (np.float32, np.float64):
+        data_t = data.astype(data_type)
+        gain_t = gain.astype(data_type)
+        offset_t = offset.astype(data_type)
+        nb = data_t.nbytes
+
+        # (name, function, bytes read and written)
+        cases = [
+            ("mask (threshold)",
+             lambda x: mask_image_data(x, threshold_mask=(0.2, 0.8), keep_nan=True),
+             2 * nb),
+            ("mask (image and threshold)",
+             lambda x: mask_image_data(x, image_mask=mask, threshold_mask=(0.2, 0.8)),
+             2 * nb),
+            ("correct (gain and offset)",
+             lambda x: correct_image_data(x, gain=gain_t, offset=offset_t),
+             4 * nb),
+            ("moving average",
+             lambda x: movingAvgImageData(x, data_t, 5),
+             3 * nb),
+            ("nanmean",
+             lambda x: nanmean_image_data(x),
+             nb),
+        ]
+
+        print(f"\nscalar vs SIMD throughput (GB/s) with {data_type} - ")
+        for name, func, nbytes in cases:
+            scalar, vectorized = _run_simd(func, data_t, nbytes)
+            print(f"{name}: {scalar:.2f} vs {vectorized:.2f}, "
+                  f"speedup: {vectorized / scalar:.2f}")
+
+
+def bench_partition(shape, repeat=5):
+    data = np.random.rand(*shape).astype(np.float32)
+    data[::4, ::4, ::4] = np.nan
+    gain = np.random.randn(*shape).astype(np.float32)
+    offset = np.random.randn(*shape).astype(np.float32)
+
+    print(f"\npartition mode with {np.float32} - ")
+    for mode, affinity in [("blocked", False), ("row", False), ("row", True)]:
+        with partition_config(mode, 1, affinity):
+            dt = float("inf")
+            for _ in range(repeat):
+                data_cpp = data.copy()
+                t0 = time.perf_counter()
+                correct_image_data(data_cpp, gain=gain, offset=offset)
+                mask_image_data(data_cpp, threshold_mask=(0.2, 0.8), keep_nan=True)
+                nanmean_image_data(data_cpp)
+                dt = min(dt, time.perf_counter() - t0)
+        print(f"{mode} (affinity = {affinity}): {dt:.4f}")
+
+
 if __name__ == "__main__":
     print("*" * 80)
     print("Benchmark image processing")
@@ -246,3 +327,5 @@ if __name__ == "__main__":
         bench_moving_average_image_array(s)
         bench_mask_image_array(s)
         bench_correct_gain_offset(s)
+        bench_simd(s)
+        bench_partition(s)
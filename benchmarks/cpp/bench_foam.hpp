@@ -0,0 +1,252 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_BENCH_FOAM_H
+#define EXTRA_FOAM_BENCH_FOAM_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xrandom.hpp"
+
+#if defined(FOAM_WITH_TBB)
+#include "tbb/task_arena.h"
+#endif
+
+namespace foam
+{
+namespace bench
+{
+
+/**
+ * Shapes of the detectors benchmarked.
+ *
+ * An image has the size of a 1M detector with the 16 modules stacked along
+ * the slow-scan direction.
+ */
+struct Detector
+{
+  const char* name;
+  std::size_t module_height;
+  std::size_t module_width;
+
+  std::size_t imageHeight() const { return 16 * module_height; }
+  std::size_t imageWidth() const { return module_width; }
+};
+
+static const std::array<Detector, 3> kDetectors {{
+  {"AGIPD", 512, 128},
+  {"LPD", 256, 256},
+  {"DSSC", 128, 512}
+}};
+
+static const std::vector<int64_t> kPulses {1, 64, 352};
+
+/**
+ * Number of threads benchmarked: powers of two up to the maximum
+ * concurrency of the machine, which is also included.
+ */
+inline std::vector<int64_t> threadCounts()
+{
+#if defined(FOAM_WITH_TBB)
+  auto n_max = static_cast<int64_t>(tbb::this_task_arena::max_concurrency());
+#else
+  int64_t n_max = 1;
+#endif
+  std::vector<int64_t> counts;
+  for (int64_t n = 1; n < n_max; n *= 2) counts.push_back(n);
+  counts.push_back(n_max);
+  return counts;
+}
+
+namespace detail
+{
+
+inline void addArgs(benchmark::internal::Benchmark* b, std::size_t detector, const std::vector<int64_t>& pulses)
+{
+  for (auto n_pulses : pulses)
+  {
+    for (auto n_threads : threadCounts()) b->Args({static_cast<int64_t>(detector), n_pulses, n_threads});
+  }
+}
+
+} // detail
+
+/**
+ * Arguments of all the benchmarks are (detector, pulses, threads), so that
+ * the results of different kernels can be compared.
+ */
+inline void imageArgs(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({"detector", "pulses", "threads"});
+  for (std::size_t i = 0; i < kDetectors.size(); ++i) detail::addArgs(b, i, kPulses);
+  b->UseRealTime();
+}
+
+/**
+ * Arguments of a benchmark of a kernel which processes a single image.
+ */
+inline void singleImageArgs(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({"detector", "pulses", "threads"});
+  for (std::size_t i = 0; i < kDetectors.size(); ++i) detail::addArgs(b, i, {1});
+  b->UseRealTime();
+}
+
+/**
+ * Arguments of a benchmark of a kernel which is specific to a detector,
+ * e.g. a geometry.
+ */
+template<std::size_t D>
+inline void detectorArgs(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({"detector", "pulses", "threads"});
+  detail::addArgs(b, D, kPulses);
+  b->UseRealTime();
+}
+
+/**
+ * Arguments of a benchmark of a kernel which is specific to a detector and
+ * processes a single image.
+ */
+template<std::size_t D>
+inline void singleImageDetectorArgs(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({"detector", "pulses", "threads"});
+  detail::addArgs(b, D, {1});
+  b->UseRealTime();
+}
+
+/**
+ * Return the detector of a benchmark and label the benchmark with its name.
+ */
+inline const Detector& detector(benchmark::State& state)
+{
+  const auto& det = kDetectors[static_cast<std::size_t>(state.range(0))];
+  state.SetLabel(det.name);
+  return det;
+}
+
+/**
+ * Random data in [lb, ub) with every seventh element being nan if T is a
+ * floating point type.
+ */
+template<typename T, std::size_t N>
+inline xt::xtensor<T, N> randomData(const std::array<std::size_t, N>& shape, double lb = 0., double ub = 1.)
+{
+  xt::random::seed(42);
+  xt::xtensor<T, N> data = xt::cast<T>(xt::random::rand<double>(shape, lb, ub));
+  if (std::is_floating_point<T>::value)
+  {
+    for (std::size_t i = 0; i < data.size(); i += 7) data.data()[i] = std::numeric_limits<T>::quiet_NaN();
+  }
+  return data;
+}
+
+/**
+ * Random images of the detector of a benchmark. shape = (pulses, y, x)
+ */
+template<typename T>
+inline xt::xtensor<T, 3> randomImages(benchmark::State& state)
+{
+  const auto& det = detector(state);
+  return randomData<T, 3>({static_cast<std::size_t>(state.range(1)), det.imageHeight(), det.imageWidth()});
+}
+
+/**
+ * A random image of the detector of a benchmark. shape = (y, x)
+ */
+template<typename T>
+inline xt::xtensor<T, 2> randomImage(benchmark::State& state)
+{
+  const auto& det = detector(state);
+  return randomData<T, 2>({det.imageHeight(), det.imageWidth()});
+}
+
+namespace detail
+{
+
+/**
+ * Time per iteration with a single thread, keyed by the kernel and the
+ * arguments except the number of threads.
+ */
+inline std::map<std::pair<std::type_index, std::vector<int64_t>>, double>& singleThreadTimes()
+{
+  static std::map<std::pair<std::type_index, std::vector<int64_t>>, double> times;
+  return times;
+}
+
+} // detail
+
+/**
+ * Run a kernel in the benchmark loop with the number of threads given by the
+ * arguments.
+ *
+ * The following counters are reported:
+ * - bytes_per_second: bytes read and written by a call of the kernel
+ *   divided by the wall time of it.
+ * - efficiency: T(1) / (n * T(n)), where T(n) is the wall time with n
+ *   threads. The benchmark with a single thread must run before the others,
+ *   which is the registration order.
+ *
+ * @param state: benchmark state.
+ * @param n_bytes: number of bytes read and written by a call of the kernel.
+ * @param f: kernel. Each lambda is a different kernel.
+ */
+template<typename F>
+inline void runKernel(benchmark::State& state, std::size_t n_bytes, F&& f)
+{
+  std::vector<int64_t> args {state.range(0), state.range(1)};
+  int64_t n_threads = state.range(2);
+
+#if defined(FOAM_WITH_TBB)
+  tbb::task_arena arena(static_cast<int>(n_threads));
+  // initialize the worker threads before timing
+  arena.execute(f);
+#else
+  f();
+#endif
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (auto _ : state)
+  {
+#if defined(FOAM_WITH_TBB)
+    arena.execute(f);
+#else
+    f();
+#endif
+    benchmark::ClobberMemory();
+  }
+  std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * n_bytes));
+
+  double t = dt.count() / static_cast<double>(state.iterations());
+  auto key = std::make_pair(std::type_index(typeid(F)), args);
+  auto& times = detail::singleThreadTimes();
+  if (n_threads == 1) times[key] = t;
+  auto it = times.find(key);
+  if (it != times.end()) state.counters["efficiency"] = it->second / (static_cast<double>(n_threads) * t);
+}
+
+} // bench
+} // foam
+
+#endif //EXTRA_FOAM_BENCH_FOAM_H
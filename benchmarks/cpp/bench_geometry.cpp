@@ -0,0 +1,201 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cstdint>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xbuilder.hpp"
+#include "xtensor/xview.hpp"
+
+#include "f_geometry.hpp"
+
+#include "bench_foam.hpp"
+
+namespace foam
+{
+namespace bench
+{
+
+template<typename G>
+struct GeometryDetector;
+
+template<>
+struct GeometryDetector<AGIPD_1MGeometry> { static constexpr std::size_t value = 0; };
+
+template<>
+struct GeometryDetector<LPD_1MGeometry> { static constexpr std::size_t value = 1; };
+
+template<>
+struct GeometryDetector<DSSC_1MGeometry> { static constexpr std::size_t value = 2; };
+
+template<typename G>
+void geometryArgs(benchmark::internal::Benchmark* b)
+{
+  detectorArgs<GeometryDetector<G>::value>(b);
+}
+
+template<typename G>
+void singleImageGeometryArgs(benchmark::internal::Benchmark* b)
+{
+  singleImageDetectorArgs<GeometryDetector<G>::value>(b);
+}
+
+// Register a benchmark for all the geometries with raw and calibrated data.
+#define FOAM_BENCHMARK_GEOMETRY(NAME)                                                                 \
+  BENCHMARK_TEMPLATE(NAME, AGIPD_1MGeometry, uint16_t)->Apply(geometryArgs<AGIPD_1MGeometry>);        \
+  BENCHMARK_TEMPLATE(NAME, AGIPD_1MGeometry, float)->Apply(geometryArgs<AGIPD_1MGeometry>);           \
+  BENCHMARK_TEMPLATE(NAME, LPD_1MGeometry, uint16_t)->Apply(geometryArgs<LPD_1MGeometry>);            \
+  BENCHMARK_TEMPLATE(NAME, LPD_1MGeometry, float)->Apply(geometryArgs<LPD_1MGeometry>);               \
+  BENCHMARK_TEMPLATE(NAME, DSSC_1MGeometry, uint16_t)->Apply(geometryArgs<DSSC_1MGeometry>);          \
+  BENCHMARK_TEMPLATE(NAME, DSSC_1MGeometry, float)->Apply(geometryArgs<DSSC_1MGeometry>);
+
+template<typename G, typename T>
+xt::xtensor<T, 4> randomModules(benchmark::State& state)
+{
+  detector(state);
+  return randomData<T, 4>({static_cast<std::size_t>(state.range(1)),
+                           static_cast<std::size_t>(G::n_modules),
+                           static_cast<std::size_t>(G::module_shape[0]),
+                           static_cast<std::size_t>(G::module_shape[1])}, 0., 1000.);
+}
+
+template<typename G>
+xt::xtensor<float, 3> assembledImages(const G& geom, std::size_t n_pulses)
+{
+  auto shape = geom.assembledShape();
+  xt::xtensor<float, 3> dst({n_pulses, static_cast<std::size_t>(shape[0]), static_cast<std::size_t>(shape[1])});
+  dst.fill(std::numeric_limits<float>::quiet_NaN());
+  return dst;
+}
+
+template<typename G>
+xt::xtensor<float, 3> moduleConstants(float v)
+{
+  return v * xt::ones<float>({static_cast<std::size_t>(G::n_modules),
+                             static_cast<std::size_t>(G::module_shape[0]),
+                             static_cast<std::size_t>(G::module_shape[1])});
+}
+
+template<typename G, typename T>
+void BM_positionAllModules(benchmark::State& state)
+{
+  G geom;
+  auto src = randomModules<G, T>(state);
+  auto dst = assembledImages(geom, src.shape()[0]);
+  runKernel(state, src.size() * (sizeof(T) + sizeof(float)), [&] {
+    geom.positionAllModules(src, dst);
+  });
+}
+FOAM_BENCHMARK_GEOMETRY(BM_positionAllModules)
+
+template<typename G, typename T>
+void BM_positionAllModulesIgnoreTileEdge(benchmark::State& state)
+{
+  G geom;
+  auto src = randomModules<G, T>(state);
+  auto dst = assembledImages(geom, src.shape()[0]);
+  runKernel(state, src.size() * (sizeof(T) + sizeof(float)), [&] {
+    geom.positionAllModules(src, dst, true);
+  });
+}
+FOAM_BENCHMARK_GEOMETRY(BM_positionAllModulesIgnoreTileEdge)
+
+template<typename G, typename T>
+void BM_positionAllModulesVector(benchmark::State& state)
+{
+  G geom;
+  auto modules = randomModules<G, T>(state);
+  std::vector<xt::xtensor<T, 3>> src;
+  for (std::size_t im = 0; im < modules.shape()[1]; ++im)
+  {
+    src.emplace_back(xt::view(modules, xt::all(), im, xt::all(), xt::all()));
+  }
+  auto dst = assembledImages(geom, modules.shape()[0]);
+  runKernel(state, modules.size() * (sizeof(T) + sizeof(float)), [&] {
+    geom.positionAllModules(src, dst);
+  });
+}
+FOAM_BENCHMARK_GEOMETRY(BM_positionAllModulesVector)
+
+template<typename G, typename T>
+void BM_positionModule(benchmark::State& state)
+{
+  G geom;
+  auto src = randomModules<G, T>(state);
+  auto dst = assembledImages(geom, src.shape()[0]);
+  runKernel(state, src.size() / G::n_modules * (sizeof(T) + sizeof(float)), [&] {
+    geom.positionModule(src, dst, 0);
+  });
+}
+FOAM_BENCHMARK_GEOMETRY(BM_positionModule)
+
+template<typename G, typename T>
+void BM_positionAllModulesCorrected(benchmark::State& state)
+{
+  G geom;
+  auto src = randomModules<G, T>(state);
+  auto dst = assembledImages(geom, src.shape()[0]);
+  auto gain = moduleConstants<G>(2.f);
+  auto offset = moduleConstants<G>(1.f);
+  runKernel(state, src.size() * (sizeof(T) + sizeof(float)) + 2 * gain.size() * sizeof(float), [&] {
+    geom.positionAllModules(src, dst, gain, offset);
+  });
+}
+FOAM_BENCHMARK_GEOMETRY(BM_positionAllModulesCorrected)
+
+template<typename G, typename T>
+void BM_positionAllModulesCorrectedMasked(benchmark::State& state)
+{
+  G geom;
+  auto src = randomModules<G, T>(state);
+  auto dst = assembledImages(geom, src.shape()[0]);
+  auto gain = moduleConstants<G>(2.f);
+  auto offset = moduleConstants<G>(1.f);
+  xt::xtensor<bool, 3> mask = randomData<float, 3>(gain.shape()) > 0.9f;
+  runKernel(state, src.size() * (sizeof(T) + sizeof(float)) + gain.size() * (2 * sizeof(float) + 1), [&] {
+    geom.positionAllModules(src, dst, gain, offset, mask);
+  });
+}
+FOAM_BENCHMARK_GEOMETRY(BM_positionAllModulesCorrectedMasked)
+
+template<typename G, typename T>
+void BM_dismantleAllModules(benchmark::State& state)
+{
+  G geom;
+  auto dst = randomModules<G, T>(state);
+  auto shape = geom.assembledShape();
+  auto src = randomData<T, 3>({dst.shape()[0], static_cast<std::size_t>(shape[0]),
+                               static_cast<std::size_t>(shape[1])}, 0., 1000.);
+  runKernel(state, (src.size() + dst.size()) * sizeof(T), [&] {
+    geom.dismantleAllModules(src, dst);
+  });
+}
+FOAM_BENCHMARK_GEOMETRY(BM_dismantleAllModules)
+
+template<typename G>
+void BM_pixelPositions(benchmark::State& state)
+{
+  detector(state);
+  G geom;
+  xt::xtensor<int32_t, 4> dst({static_cast<std::size_t>(G::n_modules),
+                               static_cast<std::size_t>(G::module_shape[0]),
+                               static_cast<std::size_t>(G::module_shape[1]), 2});
+  runKernel(state, dst.size() * sizeof(int32_t), [&] {
+    geom.pixelPositions(dst);
+  });
+}
+BENCHMARK_TEMPLATE(BM_pixelPositions, AGIPD_1MGeometry)->Apply(singleImageGeometryArgs<AGIPD_1MGeometry>);
+BENCHMARK_TEMPLATE(BM_pixelPositions, LPD_1MGeometry)->Apply(singleImageGeometryArgs<LPD_1MGeometry>);
+BENCHMARK_TEMPLATE(BM_pixelPositions, DSSC_1MGeometry)->Apply(singleImageGeometryArgs<DSSC_1MGeometry>);
+
+} // bench
+} // foam
@@ -0,0 +1,322 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xbuilder.hpp"
+
+#include "f_imageproc.hpp"
+
+#include "bench_foam.hpp"
+
+namespace foam
+{
+namespace bench
+{
+
+template<typename T>
+using Images = xt::xtensor<T, 3>;
+
+template<typename T>
+using Image = xt::xtensor<T, 2>;
+
+using ImageMask = xt::xtensor<bool, 2>;
+
+ImageMask randomImageMask(benchmark::State& state)
+{
+  return randomImage<float>(state) > 0.9f;
+}
+
+/* nanmean */
+
+template<typename T>
+void BM_nanmeanImageArray(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, (src.size() + src.size() / src.shape()[0]) * sizeof(T), [&] {
+    benchmark::DoNotOptimize(nanmeanImageArray(src));
+  });
+}
+BENCHMARK_TEMPLATE(BM_nanmeanImageArray, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_nanmeanImageArray, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_nanmeanImageArrayKeep(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  std::vector<size_t> keep;
+  for (size_t i = 0; i < src.shape()[0]; ++i)
+  {
+    if (i % 10 != 1 || src.shape()[0] == 1) keep.push_back(i);
+  }
+  auto image_size = src.size() / src.shape()[0];
+  runKernel(state, (keep.size() + 1) * image_size * sizeof(T), [&] {
+    benchmark::DoNotOptimize(nanmeanImageArray(src, keep));
+  });
+}
+BENCHMARK_TEMPLATE(BM_nanmeanImageArrayKeep, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_nanmeanImageArrayKeep, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_nanmeanTwoImages(benchmark::State& state)
+{
+  auto src1 = randomImage<T>(state);
+  auto src2 = randomImage<T>(state);
+  Image<T> mean(src1.shape());
+  runKernel(state, 3 * src1.size() * sizeof(T), [&] {
+    nanmeanImageArray(src1, src2, mean);
+  });
+}
+BENCHMARK_TEMPLATE(BM_nanmeanTwoImages, float)->Apply(singleImageArgs);
+BENCHMARK_TEMPLATE(BM_nanmeanTwoImages, double)->Apply(singleImageArgs);
+
+template<typename T>
+void BM_nanmeanOnOffImageArray(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  std::vector<size_t> on;
+  std::vector<size_t> off;
+  for (size_t i = 0; i < src.shape()[0]; ++i)
+  {
+    if (i % 2 == 0) on.push_back(i);
+    else off.push_back(i);
+  }
+  Image<T> mean_on({src.shape()[1], src.shape()[2]});
+  Image<T> mean_off({src.shape()[1], src.shape()[2]});
+  runKernel(state, (src.size() + 2 * mean_on.size()) * sizeof(T), [&] {
+    nanmeanOnOffImageArray(src, on, off, mean_on, mean_off);
+  });
+}
+BENCHMARK_TEMPLATE(BM_nanmeanOnOffImageArray, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_nanmeanOnOffImageArray, double)->Apply(imageArgs);
+
+/* masking */
+
+template<typename T>
+void BM_maskImageArrayZero(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, 2 * src.size() * sizeof(T), [&] {
+    maskImageDataZero(src);
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageArrayZero, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageArrayZero, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_maskImageArrayZeroThreshold(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, 2 * src.size() * sizeof(T), [&] {
+    maskImageDataZero(src, T(0.1), T(0.9));
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageArrayZeroThreshold, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageArrayZeroThreshold, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_maskImageArrayNanThreshold(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, 2 * src.size() * sizeof(T), [&] {
+    maskImageDataNan(src, T(0.1), T(0.9));
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanThreshold, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanThreshold, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_maskImageArrayNanImageMask(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  auto mask = randomImageMask(state);
+  runKernel(state, 2 * src.size() * sizeof(T) + mask.size(), [&] {
+    maskImageDataNan(src, mask);
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanImageMask, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanImageMask, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_maskImageArrayNanImageMaskThreshold(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  auto mask = randomImageMask(state);
+  runKernel(state, 2 * src.size() * sizeof(T) + mask.size(), [&] {
+    maskImageDataNan(src, mask, T(0.1), T(0.9));
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanImageMaskThreshold, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanImageMaskThreshold, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_maskImageArrayNanBitMaskThreshold(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  BitMask mask(randomImageMask(state));
+  runKernel(state, 2 * src.size() * sizeof(T) + mask.nBytes(), [&] {
+    maskImageDataNan(src, mask, T(0.1), T(0.9));
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanBitMaskThreshold, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageArrayNanBitMaskThreshold, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_maskImageNanImageMaskThresholdOut(benchmark::State& state)
+{
+  auto src = randomImage<T>(state);
+  auto mask = randomImageMask(state);
+  ImageMask out(mask.shape());
+  runKernel(state, 2 * src.size() * sizeof(T) + 2 * mask.size(), [&] {
+    maskImageDataNan(src, mask, T(0.1), T(0.9), out);
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageNanImageMaskThresholdOut, float)->Apply(singleImageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageNanImageMaskThresholdOut, double)->Apply(singleImageArgs);
+
+template<typename T>
+void BM_maskImageNanBitMaskThresholdOut(benchmark::State& state)
+{
+  auto src = randomImage<T>(state);
+  BitMask mask(randomImageMask(state));
+  BitMask out(mask.shape()[0], mask.shape()[1]);
+  runKernel(state, 2 * src.size() * sizeof(T) + 2 * mask.nBytes(), [&] {
+    maskImageDataNan(src, mask, T(0.1), T(0.9), out);
+  });
+}
+BENCHMARK_TEMPLATE(BM_maskImageNanBitMaskThresholdOut, float)->Apply(singleImageArgs);
+BENCHMARK_TEMPLATE(BM_maskImageNanBitMaskThresholdOut, double)->Apply(singleImageArgs);
+
+template<typename T>
+void BM_imageDataNanMask(benchmark::State& state)
+{
+  auto src = randomImage<T>(state);
+  ImageMask out(src.shape());
+  runKernel(state, src.size() * (sizeof(T) + 1), [&] {
+    imageDataNanMask(src, out);
+  });
+}
+BENCHMARK_TEMPLATE(BM_imageDataNanMask, float)->Apply(singleImageArgs);
+BENCHMARK_TEMPLATE(BM_imageDataNanMask, double)->Apply(singleImageArgs);
+
+template<typename T>
+void BM_imageDataThresholdBitMask(benchmark::State& state)
+{
+  auto src = randomImage<T>(state);
+  BitMask out(src.shape()[0], src.shape()[1]);
+  runKernel(state, src.size() * sizeof(T) + out.nBytes(), [&] {
+    imageDataThresholdMask(src, T(0.1), T(0.9), out);
+  });
+}
+BENCHMARK_TEMPLATE(BM_imageDataThresholdBitMask, float)->Apply(singleImageArgs);
+BENCHMARK_TEMPLATE(BM_imageDataThresholdBitMask, double)->Apply(singleImageArgs);
+
+/* moving average */
+
+template<typename T>
+void BM_movingAvgImageArray(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  auto data = randomImages<T>(state);
+  runKernel(state, 3 * src.size() * sizeof(T), [&] {
+    movingAvgImageData(src, data, 2);
+  });
+}
+BENCHMARK_TEMPLATE(BM_movingAvgImageArray, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_movingAvgImageArray, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_movingAvgImage(benchmark::State& state)
+{
+  auto src = randomImage<T>(state);
+  auto data = randomImage<T>(state);
+  runKernel(state, 3 * src.size() * sizeof(T), [&] {
+    movingAvgImageData(src, data, 2);
+  });
+}
+BENCHMARK_TEMPLATE(BM_movingAvgImage, float)->Apply(singleImageArgs);
+BENCHMARK_TEMPLATE(BM_movingAvgImage, double)->Apply(singleImageArgs);
+
+/* correction
+ *
+ * The data are corrected in place in each iteration. The gains are ones so
+ * that the data do not decay into denormals.
+ */
+
+template<typename T>
+void BM_correctOffset(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  auto offset = randomData<T, 3>(src.shape(), -1e-3, 1e-3);
+  runKernel(state, 3 * src.size() * sizeof(T), [&] {
+    correctImageData<OffsetPolicy>(src, offset);
+  });
+}
+BENCHMARK_TEMPLATE(BM_correctOffset, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_correctOffset, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_correctGain(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  Images<T> gain = xt::ones<T>(src.shape());
+  runKernel(state, 3 * src.size() * sizeof(T), [&] {
+    correctImageData<GainPolicy>(src, gain);
+  });
+}
+BENCHMARK_TEMPLATE(BM_correctGain, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_correctGain, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_correctGainOffset(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  Images<T> gain = xt::ones<T>(src.shape());
+  auto offset = randomData<T, 3>(src.shape(), -1e-3, 1e-3);
+  runKernel(state, 4 * src.size() * sizeof(T), [&] {
+    correctImageData(src, gain, offset);
+  });
+}
+BENCHMARK_TEMPLATE(BM_correctGainOffset, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_correctGainOffset, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_correctMaskNanmeanImageArray(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  Images<T> gain = xt::ones<T>(src.shape());
+  auto offset = randomData<T, 3>(src.shape(), -1e-3, 1e-3);
+  auto mask = randomImageMask(state);
+  runKernel(state, (4 * src.size() + mask.size()) * sizeof(T) + mask.size(), [&] {
+    benchmark::DoNotOptimize(correctMaskNanmeanImageArray(src, gain, offset, mask, T(0.1), T(0.9)));
+  });
+}
+BENCHMARK_TEMPLATE(BM_correctMaskNanmeanImageArray, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_correctMaskNanmeanImageArray, double)->Apply(imageArgs);
+
+template<typename T>
+void BM_correctMaskNanmeanImageArrayBitMask(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  Images<T> gain = xt::ones<T>(src.shape());
+  auto offset = randomData<T, 3>(src.shape(), -1e-3, 1e-3);
+  BitMask mask(randomImageMask(state));
+  auto image_size = src.size() / src.shape()[0];
+  runKernel(state, (4 * src.size() + image_size) * sizeof(T) + mask.nBytes(), [&] {
+    benchmark::DoNotOptimize(correctMaskNanmeanImageArray(src, gain, offset, mask, T(0.1), T(0.9)));
+  });
+}
+BENCHMARK_TEMPLATE(BM_correctMaskNanmeanImageArrayBitMask, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_correctMaskNanmeanImageArrayBitMask, double)->Apply(imageArgs);
+
+} // bench
+} // foam
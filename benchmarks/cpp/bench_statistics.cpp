@@ -0,0 +1,128 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xarray.hpp"
+
+#include "f_statistics.hpp"
+
+#include "bench_foam.hpp"
+
+namespace foam
+{
+namespace bench
+{
+
+#define FOAM_REDUCER(NAME, FUNCTOR)                                                             \
+struct NAME                                                                                     \
+{                                                                                               \
+  template<typename E>                                                                          \
+  static auto all(const E& src) { return FUNCTOR(src); }                                        \
+                                                                                                \
+  template<typename E>                                                                          \
+  static auto axis(const E& src, const std::vector<int>& axes)                                  \
+  {                                                                                             \
+    return FUNCTOR<xt::xarray<typename E::value_type>>(src, axes);                              \
+  }                                                                                             \
+};
+
+FOAM_REDUCER(NanSum, nansum)
+FOAM_REDUCER(NanMean, nanmean)
+FOAM_REDUCER(NanVar, nanvar)
+FOAM_REDUCER(NanStd, nanstd)
+FOAM_REDUCER(NanMin, nanmin)
+FOAM_REDUCER(NanMax, nanmax)
+
+/**
+ * Reduce over all the axes.
+ */
+template<typename Reducer, typename T>
+void BM_nanReduce(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, src.size() * sizeof(T), [&] {
+    benchmark::DoNotOptimize(Reducer::all(src));
+  });
+}
+
+/**
+ * Reduce over the pulses, e.g. the average image of a train.
+ */
+template<typename Reducer, typename T>
+void BM_nanReducePulses(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, (src.size() + src.size() / src.shape()[0]) * sizeof(T), [&] {
+    benchmark::DoNotOptimize(Reducer::axis(src, {0}));
+  });
+}
+
+/**
+ * Reduce over the pixels, e.g. the FOM of each pulse.
+ */
+template<typename Reducer, typename T>
+void BM_nanReducePixels(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, (src.size() + src.shape()[0]) * sizeof(T), [&] {
+    benchmark::DoNotOptimize(Reducer::axis(src, {1, 2}));
+  });
+}
+
+#define FOAM_BENCHMARK_REDUCER(REDUCER)                                                         \
+  BENCHMARK_TEMPLATE(BM_nanReduce, REDUCER, float)->Apply(imageArgs);                           \
+  BENCHMARK_TEMPLATE(BM_nanReduce, REDUCER, double)->Apply(imageArgs);                          \
+  BENCHMARK_TEMPLATE(BM_nanReducePulses, REDUCER, float)->Apply(imageArgs);                     \
+  BENCHMARK_TEMPLATE(BM_nanReducePulses, REDUCER, double)->Apply(imageArgs);                    \
+  BENCHMARK_TEMPLATE(BM_nanReducePixels, REDUCER, float)->Apply(imageArgs);                     \
+  BENCHMARK_TEMPLATE(BM_nanReducePixels, REDUCER, double)->Apply(imageArgs);
+
+FOAM_BENCHMARK_REDUCER(NanSum)
+FOAM_BENCHMARK_REDUCER(NanMean)
+FOAM_BENCHMARK_REDUCER(NanVar)
+FOAM_BENCHMARK_REDUCER(NanStd)
+FOAM_BENCHMARK_REDUCER(NanMin)
+FOAM_BENCHMARK_REDUCER(NanMax)
+
+template<typename T>
+void BM_histogramWithStats(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  runKernel(state, src.size() * sizeof(T), [&] {
+    benchmark::DoNotOptimize(
+      histogramWithStats<xt::xtensor<int64_t, 1>, xt::xtensor<double, 1>>(src, 10, 0.1, 0.9));
+  });
+}
+BENCHMARK_TEMPLATE(BM_histogramWithStats, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_histogramWithStats, double)->Apply(imageArgs);
+
+/**
+ * The bin range is determined by the data, which takes an extra pass.
+ */
+template<typename T>
+void BM_histogramWithStatsInfRange(benchmark::State& state)
+{
+  auto src = randomImages<T>(state);
+  auto inf = std::numeric_limits<double>::infinity();
+  runKernel(state, src.size() * sizeof(T), [&] {
+    benchmark::DoNotOptimize(
+      histogramWithStats<xt::xtensor<int64_t, 1>, xt::xtensor<double, 1>>(src, 10, -inf, inf));
+  });
+}
+BENCHMARK_TEMPLATE(BM_histogramWithStatsInfRange, float)->Apply(imageArgs);
+BENCHMARK_TEMPLATE(BM_histogramWithStatsInfRange, double)->Apply(imageArgs);
+
+} // bench
+} // foam
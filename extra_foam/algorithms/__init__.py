@@ -9,28 +9,47 @@ All rights reserved.
 """
 from .statistics_py import (
     hist_with_stats, nanhist_with_stats, compute_statistics,
-    nanmean, nansum, nanstd, nanvar,
+    nanmean, nansum, nanstd, nanvar, nanmin, nanmax,
     quick_min_max
 )
 
 from .miscellaneous import (
     normalize_auc
 )
-from .sampling import down_sample, slice_curve, up_sample
+from .sampling import (
+    down_sample, nan_down_sample_image, nan_down_sample_image_with_levels,
+    slice_curve, up_sample
+)
 from .data_structures import OrderedSet, Stack
 from .azimuthal_integ import compute_q, energy2wavelength
+from .azimuthal_integrator import (
+    AzimuthalIntegrator as FoamAzimuthalIntegrator
+)
 
 from .helpers import intersection
+from .roi_py import roi_projection, roi_statistics, RoiStat, N_ROI_STATS
+from .digitizer_py import integrate_pulses
+from .partition import (
+    get_partition_config, numa_node_count, partition_config,
+    set_partition_config
+)
+from .buffer_pool import aligned_empty, BufferPool
+from .kernel_profiling import (
+    kernel_latency_stats, kernel_profiling, kernel_profiling_enabled,
+    reset_kernel_profiling, set_kernel_profiling
+)
 
 from .imageproc_py import (
-    nanmean_image_data, correct_image_data, mask_image_data,
-    movingAvgImageData
+    BitMask, nanmean_image_data, correct_image_data, mask_image_data,
+    correct_mask_nanmean_image_data, movingAvgImageData,
+    nanmean_on_off_image_data
 )
 
 from .datamodel import (
     RawImageDataFloat, RawImageDataDouble,
     MovingAverageArrayFloat, MovingAverageArrayDouble,
-    MovingAverageFloat, MovingAverageDouble
+    MovingAverageFloat, MovingAverageDouble,
+    DarkAccumulatorFloat, DarkAccumulatorDouble
 )
 
 from .spectrum import (
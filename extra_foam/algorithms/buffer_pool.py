@@ -0,0 +1,69 @@
+"""
+Distributed under the terms of the BSD 3-Clause License.
+
+The full license is in the file LICENSE, distributed with this software.
+
+Author: Jun Zhu <jun.zhu@xfel.eu>
+Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+All rights reserved.
+"""
+import numpy as np
+
+
+# alignment of the buffers in bytes, i.e. a cache line
+BUFFER_ALIGNMENT = 64
+
+
+def aligned_empty(shape, dtype, alignment=BUFFER_ALIGNMENT):
+    """Return a new C-contiguous array without initializing the entries.
+
+    Unlike numpy.empty, the data of the array starts at the given
+    alignment in bytes.
+    """
+    dtype = np.dtype(dtype)
+    n_bytes = int(np.prod(shape)) * dtype.itemsize
+    raw = np.empty(n_bytes + alignment, dtype=np.uint8)
+    offset = -raw.ctypes.data % alignment
+    return raw[offset:offset + n_bytes].view(dtype).reshape(shape)
+
+
+class BufferPool:
+    """Named persistent buffers which are reused from train to train.
+
+    The buffers are passed as the 'out' argument of the C++ kernels. A
+    buffer is only reallocated when its shape or dtype changes, e.g. when
+    the number of pulses changes.
+
+    Note: an array of a buffer must not be sent downstream while the
+          buffer can still be overwritten!
+    """
+    def __init__(self, alignment=BUFFER_ALIGNMENT):
+        self._alignment = alignment
+        self._buffers = dict()
+
+    def get(self, name, shape, dtype):
+        """Return the buffer with the given name, shape and dtype.
+
+        :param str name: name of the buffer.
+        :param tuple shape: shape of the buffer.
+        :param dtype: data type of the buffer.
+
+        :return numpy.ndarray: the buffer, whose data is not initialized.
+        """
+        shape = tuple(shape)
+        dtype = np.dtype(dtype)
+        buffer = self._buffers.get(name)
+        if buffer is None or buffer.shape != shape or buffer.dtype != dtype:
+            buffer = aligned_empty(shape, dtype, self._alignment)
+            self._buffers[name] = buffer
+        return buffer
+
+    def clear(self):
+        """Release all the buffers."""
+        self._buffers.clear()
+
+    def __contains__(self, name):
+        return name in self._buffers
+
+    def __len__(self):
+        return len(self._buffers)
@@ -0,0 +1,40 @@
+"""
+Distributed under the terms of the BSD 3-Clause License.
+
+The full license is in the file LICENSE, distributed with this software.
+
+Author: Jun Zhu <jun.zhu@xfel.eu>
+Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+All rights reserved.
+"""
+from .digitizer import integratePulses
+
+
+def integrate_pulses(waveform, *, baseline, pulse_start, pulse_period,
+                     pulse_width, n_pulses=None, out=None):
+    """Integrate the pulses in a digitizer waveform.
+
+    The raw samples (int16, uint16, float32 or float64) are integrated
+    directly, i.e. the waveform is not converted to floating point first.
+    The mean of the samples in the baseline window is subtracted from
+    every sample of a pulse.
+
+    :param numpy.ndarray waveform: raw waveform. Shape = (samples,)
+    :param tuple baseline: (start, end) of the baseline window in samples.
+        The end is exclusive. An empty window means no baseline subtraction.
+    :param int pulse_start: first sample of the first pulse.
+    :param int pulse_period: number of samples between two pulses.
+    :param int pulse_width: number of samples of each pulse.
+    :param None/int n_pulses: number of pulses. None for as many pulses as
+        fit in the waveform. Ignored if out is given.
+    :param None/numpy.ndarray out: float32 array to store the integrals.
+
+    :return numpy.ndarray: float32 pulse integrals. Shape = (pulses,)
+    """
+    args = (waveform, baseline[0], baseline[1],
+            pulse_start, pulse_period, pulse_width)
+
+    if out is None:
+        return integratePulses(*args, 0 if n_pulses is None else n_pulses)
+    integratePulses(*args, out)
+    return out
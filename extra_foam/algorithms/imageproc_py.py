@@ -10,29 +10,78 @@ All rights reserved.
 import numpy as np
 
 from .imageproc import (
-    nanmeanImageArray, movingAvgImageData,
+    BitMask, nanmeanImageArray, movingAvgImageData,
     imageDataNanMask, maskImageDataNan, maskImageDataZero,
-    correctGain, correctOffset, correctGainOffset
+    correctGain, correctOffset, correctGainOffset,
+    correctMaskNanmeanImageArray, nanmeanOnOffImageArray
 )
 
 
-def nanmean_image_data(data, *, kept=None):
+def nanmean_image_data(data, *, kept=None, out=None):
     """Compute nanmean of an array of images of a tuple/list of two images.
 
     :param tuple/list/numpy.array data: a tuple/list of two 2D arrays, or
         a 2D or 3D numpy array.
     :param None/list kept: indices of the kept images.
+    :param None/numpy.ndarray out: array to store the nanmean, which must
+        have the same dtype as the data. Shape = (y, x)
     """
     if isinstance(data, (tuple, list)):
-        return nanmeanImageArray(*data)
+        if out is None:
+            return nanmeanImageArray(*data)
+        nanmeanImageArray(*data, out)
+        return out
 
     if data.ndim == 2:
-        return data.copy()
+        if out is None:
+            return data.copy()
+        np.copyto(out, data)
+        return out
+
+    if out is None:
+        if kept is None:
+            return nanmeanImageArray(data)
+        return nanmeanImageArray(data, kept)
 
     if kept is None:
-        return nanmeanImageArray(data)
+        nanmeanImageArray(data, out=out)
+    else:
+        nanmeanImageArray(data, kept, out=out)
+    return out
+
+
+def nanmean_on_off_image_data(data, indices_on, indices_off, *,
+                              out_on=None, out_off=None):
+    """Compute nanmeans of the on- and off-images of an array of images.
+
+    It is equivalent to calling nanmean_image_data with the on- and
+    off-indices separately, but the data is only traversed once.
+
+    :param numpy.ndarray data: image data. Shape = (indices, y, x)
+    :param list indices_on: indices of the on-images.
+    :param list indices_off: indices of the off-images.
+    :param None/numpy.ndarray out_on: array to store the nanmean of the
+        on-images. Shape = (y, x)
+    :param None/numpy.ndarray out_off: array to store the nanmean of the
+        off-images. Shape = (y, x)
+
+    :return tuple: (nanmean of the on-images, nanmean of the off-images).
+        None for an empty list of indices.
+    """
+    shape = data.shape[-2:]
+    empty = np.empty((0, 0), dtype=data.dtype)
+
+    if indices_on and out_on is None:
+        out_on = np.empty(shape, dtype=data.dtype)
+    if indices_off and out_off is None:
+        out_off = np.empty(shape, dtype=data.dtype)
+
+    nanmeanOnOffImageArray(data, indices_on, indices_off,
+                           out_on if indices_on else empty,
+                           out_off if indices_off else empty)
 
-    return nanmeanImageArray(data, kept)
+    return (out_on if indices_on else None,
+            out_off if indices_off else None)
 
 
 def correct_image_data(data, *, gain=None, offset=None):
@@ -61,16 +110,17 @@ def mask_image_data(arr, *,
 
     :param numpy.ndarray arr: image data to be masked.
         Shape = (y, x) or (indices, y, x)
-    :param numpy.ndarray image_mask: image mask. If provided, it must have
-        the same shape as a single image, and the type must be bool.
-        Shape = (y, x)
+    :param numpy.ndarray/BitMask image_mask: image mask. If provided, it
+        must have the same shape as a single image, and the type must be
+        bool if it is a numpy.ndarray. Shape = (y, x)
     :param tuple/None threshold_mask: (min, max) of the threshold mask.
     :param bool keep_nan: True for masking all pixels in nan and False for
         masking all pixels to zero.
-    :param numpy.ndarray out: Optional output array in which to mark the
-        union of all pixels being masked. The default is None; if provided,
-        it must have the same shape as the image, and the dtype must be bool.
-        Only available if the image data is a 2D array. Shape = (y, x)
+    :param numpy.ndarray/BitMask out: Optional output array in which to
+        mark the union of all pixels being masked. The default is None; if
+        provided, it must have the same shape as the image, and the dtype
+        must be bool if it is a numpy.ndarray. Only available if the image
+        data is a 2D array. Shape = (y, x)
     """
     f = maskImageDataNan if keep_nan else maskImageDataZero
 
@@ -87,7 +137,7 @@ def mask_image_data(arr, *,
         if arr.ndim == 3:
             raise ValueError("'arr' must be 2D when 'out' is specified!")
 
-        if out.dtype != np.bool:
+        if not isinstance(out, BitMask) and out.dtype != np.bool:
             raise ValueError("Type of 'out' must be bool!")
 
         if image_mask is None:
@@ -101,3 +151,52 @@ def mask_image_data(arr, *,
                 f(arr, image_mask, out)
             else:
                 f(arr, image_mask, *threshold_mask, out)
+
+
+def correct_mask_nanmean_image_data(data, *,
+                                    gain=None,
+                                    offset=None,
+                                    image_mask=None,
+                                    threshold_mask=None,
+                                    kept=None,
+                                    out=None):
+    """Correct, mask and compute nanmean of an array of images in one pass.
+
+    It is equivalent to calling correct_image_data, mask_image_data (with
+    keep_nan=True) and nanmean_image_data in sequence, but the data is
+    only traversed once.
+
+    :param numpy.ndarray data: image data, which will be corrected and
+        masked inplace. Shape = (indices, y, x)
+    :param None/numpy.ndarray gain: gain constants, which has the same
+        shape as the image data.
+    :param None/numpy.ndarray offset: offset constants, which has the same
+        shape as the image data.
+    :param None/numpy.ndarray/BitMask image_mask: image mask.
+        Shape = (y, x), dtype = np.bool
+    :param None/tuple threshold_mask: (min, max) of the threshold mask.
+    :param None/list kept: indices of the images which contribute to the
+        nanmean. All the images are corrected and masked regardless.
+    :param None/numpy.ndarray out: array to store the nanmean, which must
+        have the same dtype as the data. Shape = (y, x)
+
+    :return numpy.ndarray: nanmean of the selected images. Shape = (y, x)
+    """
+    if gain is None:
+        gain = np.empty((0, 0, 0), dtype=data.dtype)
+    if offset is None:
+        offset = np.empty((0, 0, 0), dtype=data.dtype)
+    if image_mask is None:
+        image_mask = np.empty((0, 0), dtype=np.bool)
+    if threshold_mask is None:
+        threshold_mask = (-np.inf, np.inf)
+
+    args = (data, gain, offset, image_mask, *threshold_mask)
+    if kept is not None:
+        args += (kept,)
+
+    if out is None:
+        return correctMaskNanmeanImageArray(*args)
+
+    correctMaskNanmeanImageArray(*args, out=out)
+    return out
@@ -0,0 +1,83 @@
+"""
+Distributed under the terms of the BSD 3-Clause License.
+
+The full license is in the file LICENSE, distributed with this software.
+
+Author: Jun Zhu <jun.zhu@xfel.eu>
+Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+All rights reserved.
+"""
+from contextlib import contextmanager
+
+from . import imageproc, geometry, statistics, roi
+
+
+# Each extension module keeps its own profiler.
+_modules = {
+    "imageproc": imageproc,
+    "geometry": geometry,
+    "statistics": statistics,
+    "roi": roi,
+}
+
+
+def set_kernel_profiling(enabled):
+    """Enable or disable the profiling of the C++ kernels.
+
+    When enabled, each call of an instrumented kernel records its wall
+    time, the bytes of its input data, and the numbers of TBB tasks and
+    allocations during the call.
+    """
+    for m in _modules.values():
+        m.setProfilingEnabled(enabled)
+
+
+def kernel_profiling_enabled():
+    """Return whether the profiling of the C++ kernels is enabled."""
+    return imageproc.profilingEnabled()
+
+
+def reset_kernel_profiling():
+    """Discard the recorded kernel latencies."""
+    for m in _modules.values():
+        m.resetProfiling()
+
+
+def kernel_latency_stats(reset=False):
+    """Return the latency statistics of the C++ kernels.
+
+    :param bool reset: True for discarding the statistics after they are
+        returned, so that each call reports the calls since the previous
+        one.
+
+    :return dict: statistics keyed by "<module>.<kernel>". Each entry has
+        the number of calls, the mean, median, 99th percentile and maximum
+        latencies in ms, the throughput in GB/s as well as the mean numbers
+        of TBB tasks and allocations per call.
+    """
+    ret = dict()
+    for name, m in _modules.items():
+        for kernel, s in m.profilingStats(reset).items():
+            n = s['count']
+            ret[f"{name}.{kernel}"] = {
+                'count': n,
+                'mean': 1e-6 * s['total_ns'] / n,
+                'p50': 1e-6 * s['p50_ns'],
+                'p99': 1e-6 * s['p99_ns'],
+                'max': 1e-6 * s['max_ns'],
+                'throughput': s['bytes'] / s['total_ns'] if s['total_ns'] > 0 else 0.,
+                'tasks': s['tasks'] / n,
+                'allocations': s['allocations'] / n,
+            }
+    return ret
+
+
+@contextmanager
+def kernel_profiling():
+    """Temporarily enable the profiling of the C++ kernels."""
+    prev = kernel_profiling_enabled()
+    set_kernel_profiling(True)
+    try:
+        yield
+    finally:
+        set_kernel_profiling(prev)
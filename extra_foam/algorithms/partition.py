@@ -0,0 +1,69 @@
+"""
+Distributed under the terms of the BSD 3-Clause License.
+
+The full license is in the file LICENSE, distributed with this software.
+
+Author: Jun Zhu <jun.zhu@xfel.eu>
+Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+All rights reserved.
+"""
+from contextlib import contextmanager
+
+from . import (
+    azimuthal_integrator, binning, datamodel, digitizer, geometry,
+    image_codec, imageproc, modules_buffer, roi, statistics
+)
+
+
+# Each extension module keeps its own copy of the config, which is only
+# used by the kernels called through it. Therefore, the config is set in
+# all the modules which have parallel kernels.
+_modules = (
+    imageproc, geometry, datamodel, statistics, roi, azimuthal_integrator,
+    digitizer, image_codec, binning, modules_buffer
+)
+
+
+def set_partition_config(mode="row", grain_size=1, affinity=True, numa=False):
+    """Set how the parallel C++ kernels split the work into tasks.
+
+    :param str mode: "row" for splitting only over pulses/modules/rows so
+        that each row is processed as a whole; "blocked" for splitting
+        over all the dimensions.
+    :param int grain_size: minimum number of items (pulses, rows, ...)
+        per task.
+    :param bool affinity: True for reusing the thread affinity of the
+        previous call of the same kernel, so that the same cores touch
+        the same data train after train.
+    :param bool numa: True for splitting the pulses over the NUMA nodes
+        and processing the pulses of each node in a task arena pinned to
+        it. The same pulse is always assigned to the same node. It has no
+        effect on a machine with a single NUMA node.
+    """
+    for m in _modules:
+        m.setPartitionConfig(mode, grain_size, affinity, numa)
+
+
+def get_partition_config():
+    """Return the current partition config as
+    (mode, grain_size, affinity, numa)."""
+    return imageproc.partitionConfig()
+
+
+def numa_node_count():
+    """Return the number of NUMA nodes used by the NUMA mode."""
+    return imageproc.numaNodeCount()
+
+
+@contextmanager
+def partition_config(mode="row", grain_size=1, affinity=True, numa=False):
+    """Temporarily change the partition config.
+
+    Note: the config is global and the change is seen by all the threads.
+    """
+    prev = get_partition_config()
+    set_partition_config(mode, grain_size, affinity, numa)
+    try:
+        yield
+    finally:
+        set_partition_config(*prev)
@@ -0,0 +1,76 @@
+"""
+Distributed under the terms of the BSD 3-Clause License.
+
+The full license is in the file LICENSE, distributed with this software.
+
+Author: Jun Zhu <jun.zhu@xfel.eu>
+Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+All rights reserved.
+"""
+import math
+
+from .roi import roiStatistics, roiProjection, RoiStat, N_ROI_STATS
+
+
+def _threshold_args(threshold_mask):
+    if threshold_mask is None:
+        return -math.inf, math.inf
+    return threshold_mask
+
+
+def roi_statistics(data, rois, *, image_mask=None, threshold_mask=None,
+                   with_median=False, out=None):
+    """Calculate the statistics in multiple ROIs of an array of images.
+
+    The image mask and the threshold mask are applied on the fly, i.e.
+    neither the images nor the ROIs are copied or modified.
+
+    :param numpy.ndarray data: image data. Shape = (indices, y, x)
+    :param list rois: (x, y, w, h) of each ROI.
+    :param numpy.ndarray image_mask: image mask. Shape = (y, x)
+    :param tuple/None threshold_mask: (min, max) of the threshold mask.
+    :param bool with_median: True for also calculating the median.
+    :param None/numpy.ndarray out: array to store the statistics, which
+        must have the same dtype as the data.
+
+    :return numpy.ndarray: statistics indexed by RoiStat.
+        Shape = (indices, ROIs, N_ROI_STATS)
+    """
+    lb, ub = _threshold_args(threshold_mask)
+    if image_mask is None:
+        args = (data, rois, lb, ub, with_median)
+    else:
+        args = (data, rois, image_mask, lb, ub, with_median)
+
+    if out is None:
+        return roiStatistics(*args)
+    roiStatistics(*args, out)
+    return out
+
+
+def roi_projection(data, roi, direction, *, mean=False,
+                   image_mask=None, threshold_mask=None, out=None):
+    """Project a ROI of an array of images onto the x or y axis.
+
+    :param numpy.ndarray data: image data. Shape = (indices, y, x)
+    :param tuple roi: (x, y, w, h) of the ROI.
+    :param str direction: 'x' for reducing along y and 'y' for reducing
+        along x.
+    :param bool mean: True for nanmean and False for nansum.
+    :param numpy.ndarray image_mask: image mask. Shape = (y, x)
+    :param tuple/None threshold_mask: (min, max) of the threshold mask.
+    :param None/numpy.ndarray out: array to store the projections, which
+        must have the same dtype as the data.
+
+    :return numpy.ndarray: projections. Shape = (indices, w) or (indices, h)
+    """
+    lb, ub = _threshold_args(threshold_mask)
+    if image_mask is None:
+        args = (data, roi, direction, mean, lb, ub)
+    else:
+        args = (data, roi, image_mask, direction, mean, lb, ub)
+
+    if out is None:
+        return roiProjection(*args)
+    roiProjection(*args, out)
+    return out
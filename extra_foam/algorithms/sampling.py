@@ -9,6 +9,11 @@ All rights reserved.
 """
 import numpy as np
 
+from .statistics import nanDownSampleImage as _nan_down_sample_image_cpp
+from .statistics import (
+    nanDownSampleImageWithLevels as _nan_down_sample_image_with_levels_cpp
+)
+
 
 def slice_curve(y, x, x_min=None, x_max=None):
     """Slice an x-y plot based on the range of x values.
@@ -60,6 +65,51 @@ def down_sample(x):
     raise ValueError("Array dimension > 3!")
 
 
+def _as_float_image(x):
+    if not isinstance(x, np.ndarray):
+        raise TypeError("Input must be a numpy.ndarray!")
+
+    if x.ndim != 2:
+        raise ValueError("Input must be a 2D array!")
+
+    if x.dtype not in (np.float32, np.float64):
+        return x.astype(np.float32)
+    return x
+
+
+def nan_down_sample_image(x, rate=2):
+    """Down sample an image by averaging the non-nan pixels in blocks.
+
+    Unlike down_sample, every pixel contributes to the result. It is
+    implemented in C++ and runs in parallel without the GIL.
+
+    :param numpy.ndarray x: image data. Shape = (y, x)
+    :param int rate: down-sample rate, i.e. the size of the blocks of
+        rate x rate pixels. The blocks at the edges can be smaller.
+
+    :return numpy.ndarray: down-sampled image, which is nan for blocks
+        without any non-nan pixel. Shape = (ceil(y/rate), ceil(x/rate))
+    """
+    return _nan_down_sample_image_cpp(_as_float_image(x), rate)
+
+
+def nan_down_sample_image_with_levels(x, rate=2, q=None):
+    """Down sample an image and estimate the levels for displaying it.
+
+    See nan_down_sample_image and statistics_py.quick_min_max.
+
+    :param numpy.ndarray x: image data. Shape = (y, x)
+    :param int rate: down-sample rate.
+    :param float/None q: quantile when calculating the levels, which
+        must be within [0, 1].
+
+    :return tuple: (down-sampled image, (min, max))
+    """
+    image, v_min, v_max = _nan_down_sample_image_with_levels_cpp(
+        _as_float_image(x), rate, 1. if q is None else q)
+    return image, (v_min, v_max)
+
+
 def up_sample(x, shape):
     """Up sample an array.
 
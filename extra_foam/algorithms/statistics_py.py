@@ -12,45 +12,79 @@ import numpy as np
 from .imageproc_py import mask_image_data, nanmeanImageArray
 from .statistics import nanmean as _nanmean_cpp
 from .statistics import nansum as _nansum_cpp
+from .statistics import nanstd as _nanstd_cpp
+from .statistics import nanvar as _nanvar_cpp
+from .statistics import nanmin as _nanmin_cpp
+from .statistics import nanmax as _nanmax_cpp
+from .statistics import histogramWithStats as _histogram_with_stats_cpp
+from .statistics import quickMinMax as _quick_min_max_cpp
 
 
 _NAN_CPP_TYPES = (np.float32, np.float64)
 
 
-def nansum(a, axis=None):
+def _reduce_cpp(func, a, axis, out):
+    if out is None:
+        return func(a, axis=axis)
+    func(a, axis=axis, out=out)
+    return out
+
+
+def _check_out(axis, out):
+    if axis is None and out is not None:
+        raise ValueError("'out' is only supported for a reduction along axes!")
+
+
+def nansum(a, axis=None, *, out=None):
     """Faster numpy.nansum.
 
     This is a wrapper over numpy.nansum. It uses the C++ implementation
     in EXtra-foam when applicable. Otherwise, it falls back to numpy.nansum.
+
+    :param None/numpy.ndarray out: array to store the result. It is only
+        supported when axis is given.
     """
+    _check_out(axis, out)
     if axis is None:
         return _nansum_cpp(a)
 
     if a.dtype in _NAN_CPP_TYPES:
-        return _nansum_cpp(a, axis=axis)
+        return _reduce_cpp(_nansum_cpp, a, axis, out)
 
-    return np.nansum(a, axis=axis)
+    return np.nansum(a, axis=axis, out=out)
 
 
-def nanmean(a, axis=None):
+def nanmean(a, axis=None, *, out=None):
     """Faster numpy.nansum.
 
     This is a wrapper over numpy.nanmean. It uses the C++ implementation
     in EXtra-foam when applicable. Otherwise, it falls back to numpy.nanmean.
+
+    :param None/numpy.ndarray out: array to store the result. It is only
+        supported when axis is given.
     """
+    _check_out(axis, out)
     if axis is None:
         return _nanmean_cpp(a)
 
     if a.dtype in _NAN_CPP_TYPES:
         if axis == 0 and a.ndim == 3:
-            return nanmeanImageArray(a)
-        return _nanmean_cpp(a, axis=axis)
+            if out is None:
+                return nanmeanImageArray(a)
+            nanmeanImageArray(a, out=out)
+            return out
+        return _reduce_cpp(_nanmean_cpp, a, axis, out)
 
-    return np.nanmean(a, axis=axis)
+    return np.nanmean(a, axis=axis, out=out)
 
 
 def quick_min_max(x, q=None):
-    """Estimate the min/max values of input by down-sampling.
+    """Estimate the min/max values of input.
+
+    For float32 and float64 data, all the finite elements are scanned in
+    C++ and the quantiles are estimated from a histogram, which possibly
+    widens the range by a bin width (1/1024 of the full range) on each
+    side. Otherwise, the data are down-sampled to at most 1e5 elements.
 
     :param numpy.ndarray x: data, 2D array for now.
     :param float/None q: quantile when calculating the min/max, which
@@ -64,6 +98,9 @@ def quick_min_max(x, q=None):
     if x.ndim != 2:
         raise ValueError("Input must be a 2D array!")
 
+    if x.dtype in _NAN_CPP_TYPES:
+        return _quick_min_max_cpp(x, 1. if q is None else q)
+
     while x.size > 1e5:
         sl = [slice(None)] * x.ndim
         sl[np.argmax(x.shape)] = slice(None, None, 2)
@@ -81,30 +118,101 @@ def quick_min_max(x, q=None):
            np.nanquantile(x, q, interpolation='nearest')
 
 
-def nanstd(a, axis=None, *, normalized=False):
+def nanstd(a, axis=None, *, normalized=False, out=None):
     """Faster numpy.nanstd.
 
-    # TODO:
-
     This is a wrapper over numpy.nanstd. It uses the C++ implementation
-    in EXtra-foam when applicable. Otherwise, it falls back to numpy.nansum.
+    in EXtra-foam when applicable. Otherwise, it falls back to numpy.nanstd.
+
+    :param bool normalized: True for normalizing the result by the nanmean.
+    :param None/numpy.ndarray out: array to store the result. It is only
+        supported when axis is given.
     """
+    _check_out(axis, out)
+    if a.dtype in _NAN_CPP_TYPES:
+        if axis is None:
+            ret = _nanstd_cpp(a)
+            return ret / _nanmean_cpp(a) if normalized else ret
+
+        ret = _reduce_cpp(_nanstd_cpp, a, axis, out)
+        if normalized:
+            ret /= _nanmean_cpp(a, axis=axis)
+        return ret
+
+    ret = np.nanstd(a, axis=axis, out=out)
     if normalized:
-        return np.nanstd(a, axis=axis) / np.nanmean(a, axis=axis)
-    return np.nanstd(a, axis=axis)
+        ret /= np.nanmean(a, axis=axis)
+    return ret
 
 
-def nanvar(a, axis=None, *, normalized=False):
+def nanvar(a, axis=None, *, normalized=False, out=None):
     """Faster numpy.nanvar.
 
-    # TODO:
-
     This is a wrapper over numpy.nanvar. It uses the C++ implementation
-    in EXtra-foam when applicable. Otherwise, it falls back to numpy.nansum.
+    in EXtra-foam when applicable. Otherwise, it falls back to numpy.nanvar.
+
+    :param bool normalized: True for normalizing the result by the square
+        of the nanmean.
+    :param None/numpy.ndarray out: array to store the result. It is only
+        supported when axis is given.
     """
+    _check_out(axis, out)
+    if a.dtype in _NAN_CPP_TYPES:
+        if axis is None:
+            ret = _nanvar_cpp(a)
+            return ret / _nanmean_cpp(a) ** 2 if normalized else ret
+
+        ret = _reduce_cpp(_nanvar_cpp, a, axis, out)
+        if normalized:
+            ret /= _nanmean_cpp(a, axis=axis) ** 2
+        return ret
+
+    ret = np.nanvar(a, axis=axis, out=out)
     if normalized:
-        return np.nanvar(a, axis=axis) / np.nanmean(a, axis=axis) ** 2
-    return np.nanvar(a, axis=axis)
+        ret /= np.nanmean(a, axis=axis) ** 2
+    return ret
+
+
+def nanmin(a, axis=None, *, out=None):
+    """Faster numpy.nanmin.
+
+    This is a wrapper over numpy.nanmin. It uses the C++ implementation
+    in EXtra-foam when applicable. Otherwise, it falls back to numpy.nanmin.
+
+    Note: unlike numpy.nanmin, the C++ implementation returns nan without
+          warning for all-nan slices.
+
+    :param None/numpy.ndarray out: array to store the result. It is only
+        supported when axis is given.
+    """
+    _check_out(axis, out)
+    if a.dtype in _NAN_CPP_TYPES:
+        if axis is None:
+            return _nanmin_cpp(a)
+        return _reduce_cpp(_nanmin_cpp, a, axis, out)
+
+    return np.nanmin(a, axis=axis, out=out)
+
+
+def nanmax(a, axis=None, *, out=None):
+    """Faster numpy.nanmax.
+
+    This is a wrapper over numpy.nanmax. It uses the C++ implementation
+    in EXtra-foam when applicable. Otherwise, it falls back to numpy.nanmax.
+
+    Note: unlike numpy.nanmax, the C++ implementation returns nan without
+          warning for all-nan slices.
+
+    :param None/numpy.ndarray out: array to store the result. It is only
+        supported when axis is given.
+    """
+    _check_out(axis, out)
+    if a.dtype in _NAN_CPP_TYPES:
+        if axis is None:
+            return _nanmax_cpp(a)
+        return _reduce_cpp(_nanmax_cpp, a, axis, out)
+
+    return np.nanmax(a, axis=axis, out=out)
 
 
 def _get_outer_edges(arr, range):
@@ -175,12 +283,12 @@ def nanhist_with_stats(roi, bin_range=(-np.inf, np.inf), n_bins=10):
 
     :raise ValueError: if finite outer edges cannot be found.
     """
+    if roi.dtype in _NAN_CPP_TYPES and 1 <= roi.ndim <= 3:
+        return _histogram_with_stats_cpp(roi, n_bins, *bin_range)
+
     # Note: Since the nan functions in numpy is typically 5-8 slower
     # than the non-nan counterpart, it is always faster to remove nan
     # first, which results in a copy, and then calculate the statistics.
-
-    # TODO: the following three steps can be merged into one to improve
-    #       the performance.
     filtered = roi.copy()
     mask_image_data(filtered, threshold_mask=bin_range)
     filtered = filtered[~np.isnan(filtered)]
@@ -202,6 +310,10 @@ def hist_with_stats(data, bin_range=(-np.inf, np.inf), n_bins=10):
 
     :raise ValueError: if finite outer edges cannot be found.
     """
+    if isinstance(data, np.ndarray) and data.dtype in _NAN_CPP_TYPES \
+            and 1 <= data.ndim <= 3:
+        return _histogram_with_stats_cpp(data, n_bins, *bin_range)
+
     v_min, v_max = _get_outer_edges(data, bin_range)
 
     filtered = data[(data >= v_min) & (data <= v_max)]
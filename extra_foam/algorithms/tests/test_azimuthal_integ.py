@@ -1,5 +1,8 @@
 import unittest
 
+import numpy as np
+
+from extra_foam.algorithms import FoamAzimuthalIntegrator
 from extra_foam.algorithms.azimuthal_integ import (
     energy2wavelength, compute_q
 )
@@ -13,3 +16,59 @@ class TestAzimuthalIntegration(unittest.TestCase):
     def testComputeQ(self):
         # any catchy numbers?
         pass
+
+    def testFoamAzimuthalIntegrator(self):
+        from pyFAI.azimuthalIntegrator import AzimuthalIntegrator as PyFAIIntegrator
+
+        dist, pixel, wavelength = 0.2, 2e-4, 5e-10
+        poni1, poni2 = 40 * pixel, 20 * pixel
+        ny, nx, npt = 128, 64, 32
+
+        integ = FoamAzimuthalIntegrator(dist=dist, poni1=poni1, poni2=poni2,
+                                        pixel1=pixel, pixel2=pixel,
+                                        wavelength=wavelength)
+
+        # momentum transfer follows the pyFAI convention
+        ref = PyFAIIntegrator(dist=dist, poni1=poni1, poni2=poni2,
+                              pixel1=pixel, pixel2=pixel, wavelength=wavelength)
+        np.testing.assert_allclose(0.1 * ref.qArray((ny, nx)), integ.qMap(ny, nx), rtol=1e-6)
+
+        # brute-force integration
+        y, x = np.mgrid[:ny, :nx]
+        p1 = (y + 0.5) * pixel - poni1
+        p2 = (x + 0.5) * pixel - poni2
+        r2 = p1 ** 2 + p2 ** 2
+        cos2_tth = dist ** 2 / (dist ** 2 + r2)
+        cos_2chi = np.divide(p2 ** 2 - p1 ** 2, r2, out=np.ones_like(r2), where=r2 > 0)
+        weight = cos2_tth ** 1.5 * 0.5 * (1 + cos2_tth - cos_2chi * (1 - cos2_tth))
+        q = integ.qMap(ny, nx)
+
+        imgs = np.random.rand(4, ny, nx).astype(np.float32)
+        imgs[:, ::5, ::3] = np.nan
+        mask = np.zeros((ny, nx), dtype=bool)
+        mask[::2, ::7] = True
+        radial_range, threshold = (0.01, 0.08), (0.1, 0.9)
+
+        momentum, intensities = integ.integrate1d(
+            imgs, npt, radial_range, mask=mask, threshold=threshold)
+        self.assertEqual((4, npt), intensities.shape)
+        self.assertEqual(np.float32, intensities.dtype)
+        edges = np.linspace(*radial_range, npt + 1)
+        np.testing.assert_allclose(0.5 * (edges[1:] + edges[:-1]), momentum)
+
+        bins = np.minimum(((q - radial_range[0]) / (edges[1] - edges[0])).astype(int), npt - 1)
+        in_range = (q >= radial_range[0]) & (q <= radial_range[1])
+        for img, intensity in zip(imgs, intensities):
+            with np.errstate(invalid='ignore'):
+                valid = in_range & ~mask & (img >= threshold[0]) & (img <= threshold[1])
+            signal = np.bincount(bins[valid], img[valid], minlength=npt)
+            norm = np.bincount(bins[valid], weight[valid], minlength=npt)
+            np.testing.assert_allclose(
+                np.divide(signal, norm, out=np.zeros(npt), where=norm > 0), intensity, rtol=1e-5)
+
+        # single image without mask
+        momentum, intensity = integ.integrate1d(imgs[0], npt, radial_range)
+        self.assertEqual((npt,), intensity.shape)
+
+        with self.assertRaises(ValueError):
+            integ.integrate1d(imgs[0], npt, (0.1, 0.01))
@@ -0,0 +1,92 @@
+import pytest
+
+import numpy as np
+from scipy import stats
+
+from extra_foam.algorithms.binning import Binning1D, Binning2D, UniformBins
+
+
+class TestBinning:
+    def testUniformBins(self):
+        with pytest.raises(ValueError):
+            UniformBins(0, 0, 1)
+        with pytest.raises(ValueError):
+            UniformBins(2, 1, 0)
+
+        bins = UniformBins(5, -0.3, 1.1)
+        assert 5 == len(bins)
+        edges = np.linspace(-0.3, 1.1, 6)
+        np.testing.assert_array_equal(edges, bins.edges)
+        for v in np.linspace(-0.5, 1.3, 100):
+            expected = np.searchsorted(edges, v, side='right') - 1
+            if v == edges[-1]:
+                expected = 4
+            elif expected >= 5:
+                expected = -1
+            assert expected == bins.index(v)
+        assert -1 == bins.index(np.nan)
+
+    @pytest.mark.parametrize("statistic", ['sum', 'mean'])
+    def testBinning1D(self, statistic):
+        with pytest.raises(ValueError):
+            Binning1D(UniformBins(4, 0, 1), 'count')
+
+        x = np.random.rand(100)
+        fom = np.random.rand(100)
+        # columnar history as in SimpleVectorSequence
+        vfom = np.asfortranarray(np.random.rand(100, 6))
+
+        binning = Binning1D(UniformBins(4, 0.1, 0.9), statistic, 6)
+        with pytest.raises(TypeError):
+            # no implicit conversion
+            binning.rebin(x.astype(np.float32), fom, vfom)
+        with pytest.raises(ValueError):
+            binning.rebin(x, fom[:-1], vfom)
+        with pytest.raises(ValueError):
+            binning.rebin(x, fom, vfom[:, :-1])
+
+        binning.rebin(x, fom, vfom)
+        stats1, edges, _ = stats.binned_statistic(x, fom, statistic, 4, (0.1, 0.9))
+        counts, _, _ = stats.binned_statistic(x, fom, 'count', 4, (0.1, 0.9))
+        heat, _, _ = stats.binned_statistic(x, vfom.T, statistic, 4, (0.1, 0.9))
+        np.testing.assert_array_almost_equal(edges, binning.edges)
+        np.testing.assert_array_almost_equal(np.nan_to_num(stats1), binning.stats)
+        np.testing.assert_array_equal(counts, binning.counts)
+        assert (6, 4) == binning.vfom_heat.shape
+        np.testing.assert_array_almost_equal(np.nan_to_num(heat), binning.vfom_heat)
+
+        # views are updated in place
+        counts = binning.counts
+        assert not counts.flags.writeable
+        assert 1 == binning.update(0.35, 0.5, np.ones(6))
+        assert -1 == binning.update(0.95, 0.5, np.ones(6))
+        assert counts[1] == binning.counts[1]
+        with pytest.raises(ValueError):
+            binning.update(0.35, 0.5, np.ones(5))
+
+        binning = Binning1D(UniformBins(4, 0.1, 0.9), statistic)
+        binning.rebin(x, fom)
+        assert binning.vfom_heat is None
+        assert 0 == binning.vfom_size
+
+    @pytest.mark.parametrize("statistic", ['sum', 'mean'])
+    def testBinning2D(self, statistic):
+        x = np.random.rand(100)
+        y = np.random.rand(100)
+        fom = np.random.rand(100)
+
+        binning = Binning2D(UniformBins(4, 0.1, 0.9), UniformBins(3, 0.2, 0.7), statistic)
+        binning.rebin(x, y, fom)
+
+        heat, edges_y, edges_x, _ = stats.binned_statistic_2d(
+            y, x, fom, statistic, [3, 4], [(0.2, 0.7), (0.1, 0.9)])
+        heat_count, _, _, _ = stats.binned_statistic_2d(
+            y, x, fom, 'count', [3, 4], [(0.2, 0.7), (0.1, 0.9)])
+        np.testing.assert_array_almost_equal(edges_x, binning.edges_x)
+        np.testing.assert_array_almost_equal(edges_y, binning.edges_y)
+        assert (3, 4) == binning.heat.shape
+        np.testing.assert_array_almost_equal(np.nan_to_num(heat), binning.heat)
+        np.testing.assert_array_equal(heat_count, binning.heat_count)
+
+        assert 4 * 2 + 1 == binning.update(0.35, 0.65, 1.)
+        assert -1 == binning.update(0.35, 0.75, 1.)
@@ -0,0 +1,38 @@
+import pytest
+
+import numpy as np
+
+from extra_foam.algorithms import aligned_empty, BufferPool
+
+
+@pytest.mark.parametrize("shape, dtype", [((3, 5), np.float32), ((7, 3, 2), np.int16), ((0,), np.float64)])
+def testAlignedEmpty(shape, dtype):
+    a = aligned_empty(shape, dtype)
+    assert shape == a.shape
+    assert dtype == a.dtype
+    assert a.flags.c_contiguous
+    assert a.flags.writeable
+    if a.size > 0:
+        assert 0 == a.ctypes.data % 64
+
+    assert 0 == aligned_empty((10,), np.float32, alignment=256).ctypes.data % 256
+
+
+def testBufferPool():
+    pool = BufferPool()
+    buffer = pool.get("on", (3, 4), np.float32)
+    assert "on" in pool
+
+    # the buffer is reused for the same shape and dtype
+    assert buffer is pool.get("on", [3, 4], "float32")
+
+    # the buffer is reallocated when the shape or the dtype changes
+    new_buffer = pool.get("on", (3, 5), np.float32)
+    assert (3, 5) == new_buffer.shape
+    assert np.float64 == pool.get("on", (3, 5), np.float64).dtype
+    assert 1 == len(pool)
+
+    pool.get("off", (3, 4), np.float32)
+    assert 2 == len(pool)
+    pool.clear()
+    assert 0 == len(pool)
@@ -71,6 +71,29 @@ class TestRawImageDataCpp(unittest.TestCase):
         self.assertEqual(1, data.count())
         np.testing.assert_array_equal(new_arr, data.get())
 
+    def testInplaceUpdate(self):
+        arr = np.ones((3, 4, 4), dtype=np.float32)
+        data = RawImageDataFloat(arr)
+        data.setWindow(3)
+
+        ma = data.get()
+        # read-only view without copying
+        self.assertFalse(ma.flags.writeable)
+        self.assertTrue(np.shares_memory(ma, data.get()))
+        self.assertFalse(np.shares_memory(ma, arr))
+        with self.assertRaises(ValueError):
+            ma[0, 0, 0] = 2
+
+        # the buffer is reused and updated in place
+        data.set(3 * arr)
+        np.testing.assert_array_equal(2 * arr, ma)
+        data.set(np.ascontiguousarray(np.swapaxes(4 * arr, 1, 2)))
+        data.set(np.swapaxes(5 * arr, 1, 2))
+        self.assertTrue(np.shares_memory(ma, data.get()))
+        np.testing.assert_array_almost_equal(np.full_like(arr, 3.4444444), ma)
+        # the input is not modified
+        np.testing.assert_array_equal(np.ones((3, 4, 4)), arr)
+
     def testPerformance(self):
         self._run_performance_with_type(np.float32)
         self._run_performance_with_type(np.float64)
@@ -175,6 +198,82 @@ class TestMovingAverageArrayCpp(unittest.TestCase):
         np.testing.assert_array_equal(vec, data.get())
 
 
+    def testExactModes(self):
+        for dtype in (np.float32, np.float64):
+            for mode in ("sliding", "welford"):
+                self._run_exact_mode_with_type(dtype, mode)
+
+    def _run_exact_mode_with_type(self, dtype, mode):
+        window = 4
+        frames = [np.random.rand(3, 5).astype(dtype) for _ in range(10)]
+        if dtype == np.float32:
+            data = MovingAverageArrayFloat(frames[0])
+        else:  # dtype == np.float64:
+            data = MovingAverageArrayDouble(frames[0])
+
+        self.assertEqual("approximate", data.mode())
+        data.setMode(mode)
+        self.assertEqual(mode, data.mode())
+        data.setWindow(window)
+
+        for i, frame in enumerate(frames[1:], 1):
+            data.set(frame)
+            selected = frames[max(0, i - window + 1):i + 1]
+            self.assertEqual(len(selected), data.count())
+            np.testing.assert_array_almost_equal(np.mean(selected, axis=0), data.get(), decimal=5)
+            if mode == "welford":
+                np.testing.assert_array_almost_equal(np.var(selected, axis=0), data.variance(), decimal=5)
+            else:
+                with self.assertRaises(RuntimeError):
+                    data.variance()
+
+        # change of the window starts a new average
+        data.setWindow(2)
+        data.set(frames[0])
+        self.assertEqual(1, data.count())
+        np.testing.assert_array_equal(frames[0], data.get())
+
+        with self.assertRaises(ValueError):
+            data.setMode("unknown")
+
+    def testExactModesWithNan(self):
+        for dtype in (np.float32, np.float64):
+            for mode in ("sliding", "welford"):
+                self._run_exact_mode_with_nan(dtype, mode)
+
+    def _run_exact_mode_with_nan(self, dtype, mode):
+        window = 3
+        frames = [np.random.rand(3, 5).astype(dtype) for _ in range(8)]
+        frames[1][0, 0] = np.nan
+        frames[1][1, 1] = np.nan
+        frames[2][1, 1] = np.nan
+        frames[3][1, 1] = np.nan
+        if dtype == np.float32:
+            data = MovingAverageArrayFloat(frames[0])
+        else:  # dtype == np.float64:
+            data = MovingAverageArrayDouble(frames[0])
+        data.setMode(mode)
+        data.setWindow(window)
+
+        for i, frame in enumerate(frames[1:], 1):
+            data.set(frame)
+            selected = frames[max(0, i - window + 1):i + 1]
+            if i == 3:
+                # all the values of a pixel within the window are NaN
+                self.assertTrue(np.isnan(data.get()[1, 1]))
+            else:
+                np.testing.assert_array_almost_equal(
+                    np.nanmean(selected, axis=0), data.get(), decimal=5)
+                if mode == "welford":
+                    np.testing.assert_array_almost_equal(
+                        np.nanvar(selected, axis=0), data.variance(), decimal=5)
+
+        # the average recovers once the NaN frames slide out of the window
+        self.assertFalse(np.any(np.isnan(data.get())))
+        np.testing.assert_array_almost_equal(
+            np.mean(frames[-window:], axis=0), data.get(), decimal=5)
+
+
 class TestMovingAverageCpp(unittest.TestCase):
     def test_general(self):
         self._run_with_type(np.float32)
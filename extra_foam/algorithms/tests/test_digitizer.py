@@ -0,0 +1,59 @@
+import pytest
+
+import numpy as np
+
+from extra_foam.algorithms import integrate_pulses
+
+
+def _integrate_pulses_py(waveform, baseline, pulse_start, pulse_period,
+                         pulse_width, n_pulses):
+    b0, b1 = baseline
+    bl = waveform[b0:b1].astype(np.float64).mean() if b1 > b0 else 0.
+    starts = pulse_start + pulse_period * np.arange(n_pulses)
+    return np.array([waveform[s:s + pulse_width].astype(np.float64).sum()
+                     - bl * pulse_width for s in starts])
+
+
+@pytest.mark.parametrize("dtype", [np.int16, np.uint16, np.float32, np.float64])
+def testIntegratePulses(dtype):
+    waveform = np.random.randint(0, 1000, size=5000).astype(dtype)
+    kwargs = dict(baseline=(0, 100), pulse_start=200, pulse_period=440,
+                  pulse_width=100)
+
+    ret = integrate_pulses(waveform, **kwargs)
+    assert np.float32 == ret.dtype
+    # as many pulses as fit: (5000 - 200 - 100) // 440 + 1
+    assert (11,) == ret.shape
+    np.testing.assert_allclose(
+        _integrate_pulses_py(waveform, n_pulses=11, **kwargs), ret, rtol=1e-5)
+
+    np.testing.assert_array_equal(
+        ret[:4], integrate_pulses(waveform, n_pulses=4, **kwargs))
+
+    out = np.empty(5, dtype=np.float32)
+    assert out is integrate_pulses(waveform, out=out, **kwargs)
+    np.testing.assert_array_equal(ret[:5], out)
+
+    # strided waveform
+    np.testing.assert_allclose(
+        _integrate_pulses_py(waveform[::2], n_pulses=6, **kwargs),
+        integrate_pulses(waveform[::2], **kwargs), rtol=1e-5)
+
+
+def testIntegratePulsesInvalidWindows():
+    waveform = np.zeros(100, dtype=np.int16)
+    kwargs = dict(pulse_start=10, pulse_period=20, pulse_width=10)
+
+    with pytest.raises(ValueError):
+        integrate_pulses(waveform, baseline=(10, 0), **kwargs)
+    with pytest.raises(IndexError):
+        integrate_pulses(waveform, baseline=(0, 101), **kwargs)
+    with pytest.raises(IndexError):
+        integrate_pulses(waveform, baseline=(0, 10), n_pulses=6, **kwargs)
+    with pytest.raises(ValueError):
+        integrate_pulses(waveform, baseline=(0, 10), pulse_start=10,
+                         pulse_period=20, pulse_width=0)
+
+    # the waveform is not converted
+    with pytest.raises(TypeError):
+        integrate_pulses(waveform.astype(np.int32), baseline=(0, 10), **kwargs)
@@ -0,0 +1,93 @@
+import pytest
+
+import numpy as np
+
+from extra_foam.algorithms.history import HistoryBuffer
+from extra_foam.pipeline.processors.base_processor import (
+    OneWayAccuPairSequence, SimplePairSequence
+)
+
+
+def testHistoryBuffer():
+    history = HistoryBuffer(3, 2)
+    assert 3 == history.capacity
+    assert 2 == history.n_columns
+    assert 0 == len(history)
+
+    for i in range(5):
+        history.append(1000 + i, i, [10 * i, 1 if i % 2 else np.nan])
+
+    assert 3 == len(history)
+    np.testing.assert_array_equal([1002, 1003, 1004], history.tids())
+    assert np.uint64 == history.tids().dtype
+    np.testing.assert_array_equal([2, 3, 4], history.x())
+    np.testing.assert_array_equal([20, 30, 40], history.y(0))
+    np.testing.assert_array_equal([np.nan, 1, np.nan], history.y(1))
+    assert 0 == history.n_bins
+    assert 0 == len(history.binX())
+
+    # zero-copy read-only views
+    x = history.x()
+    assert not x.flags.writeable
+    with pytest.raises(ValueError):
+        x[0] = 1
+    del history
+    np.testing.assert_array_equal([2, 3, 4], x)
+
+    history = HistoryBuffer(3, 1)
+    with pytest.raises(ValueError):
+        history.append(1, 1, [1, 2])
+    with pytest.raises(IndexError):
+        history.y(1)
+    with pytest.raises(ValueError):
+        history.setResolution(-1)
+    with pytest.raises(ValueError):
+        HistoryBuffer(0, 1)
+
+    history.append(1, 1, [1])
+    history.clear()
+    assert 0 == len(history)
+
+
+@pytest.mark.parametrize("resolution", [0.1, 1.])
+def testBinsAgainstOneWayAccuPairSequence(resolution):
+    history = HistoryBuffer(100, 1, resolution)
+    seq = OneWayAccuPairSequence(resolution, max_len=100)
+
+    x = np.repeat(np.arange(0, 20, 0.5), np.random.randint(1, 5, 40))
+    x += np.random.uniform(-0.05, 0.05, len(x))
+    y = np.random.randn(len(x))
+    for i, (vx, vy) in enumerate(zip(x, y)):
+        history.append(i, vx, [vy])
+        seq.append((vx, vy))
+
+    x_gt, y_gt = seq.data()
+    np.testing.assert_allclose(x_gt, history.binX())
+    np.testing.assert_allclose(y_gt.avg, history.binMean())
+    np.testing.assert_array_equal(y_gt.count, history.binCount())
+    np.testing.assert_array_equal(y_gt.count, history.binCount(0))
+    np.testing.assert_allclose(y_gt.max - y_gt.avg, 0.5 * history.binStd(),
+                               atol=1e-12)
+
+
+def testSetResolution():
+    history = HistoryBuffer(10, 1)
+    for i, (vx, vy) in enumerate(zip([0, 0, 0, 0.5, 0.5, 3],
+                                     [1, 2, 3, 10, 20, 7])):
+        history.append(i, vx, [vy])
+
+    # the history is binned
+    history.setResolution(0.1)
+    np.testing.assert_array_equal([0, 0.5], history.binX())
+    np.testing.assert_array_equal([3, 2], history.binCount())
+
+    # the bins are merged
+    history.setResolution(1.)
+    assert 1. == history.resolution
+    np.testing.assert_allclose([0.2], history.binX())
+    np.testing.assert_allclose([7.2], history.binMean())
+    np.testing.assert_allclose([np.std([1, 2, 3, 10, 20])], history.binStd())
+
+    history.setResolution(0)
+    assert 0 == history.n_bins
+    assert 6 == len(history)
@@ -1,11 +1,13 @@
 import unittest
+from concurrent.futures import ThreadPoolExecutor
 
 import pytest
 
 import numpy as np
 
 from extra_foam.algorithms import (
-    correct_image_data, mask_image_data, movingAvgImageData, nanmean_image_data
+    BitMask, correct_image_data, correct_mask_nanmean_image_data, mask_image_data,
+    movingAvgImageData, nanmean_image_data, nanmean_on_off_image_data
 )
 
 
@@ -248,6 +250,137 @@ class TestImageProc(unittest.TestCase):
                                                 [[-2, 1, 2], [2, np.nan, np.nan]]],
                                                dtype=np.float32), img)
 
+    def testCorrectMaskNanmeanImageData(self):
+        arr2d = np.ones((2, 2), dtype=np.float32)
+        arr3d = np.ones((2, 2, 2), dtype=np.float32)
+
+        # test invalid input
+        with self.assertRaises(TypeError):
+            correct_mask_nanmean_image_data(arr2d)
+        with self.assertRaises(TypeError):
+            correct_mask_nanmean_image_data(arr3d, gain=arr3d.astype(np.float64))
+        with self.assertRaises(ValueError):
+            correct_mask_nanmean_image_data(arr3d, offset=np.ones((2, 2, 3), dtype=np.float32))
+        with self.assertRaises(ValueError):
+            correct_mask_nanmean_image_data(arr3d, image_mask=np.ones((2, 3), dtype=np.bool))
+        with self.assertRaises(ValueError):
+            correct_mask_nanmean_image_data(arr3d, kept=[])
+        with self.assertRaises(IndexError):
+            correct_mask_nanmean_image_data(arr3d, kept=[2])
+
+        data = np.random.randn(4, 3, 5).astype(np.float32)
+        data[0, 0, 0] = np.nan
+        gain = np.random.randn(4, 3, 5).astype(np.float32)
+        offset = np.random.randn(4, 3, 5).astype(np.float32)
+        image_mask = np.zeros((3, 5), dtype=np.bool)
+        image_mask[1, ::2] = True
+        threshold_mask = (-1, 1)
+
+        for kept in [None, [0, 2, 3]]:
+            for g, o in [(None, None), (gain, None), (None, offset), (gain, offset)]:
+                expected = data.copy()
+                correct_image_data(expected, gain=g, offset=o)
+                mask_image_data(expected, image_mask=image_mask, threshold_mask=threshold_mask)
+                with np.warnings.catch_warnings():
+                    np.warnings.simplefilter("ignore", category=RuntimeWarning)
+                    expected_mean = nanmean_image_data(expected, kept=kept)
+
+                imgs = data.copy()
+                mean = correct_mask_nanmean_image_data(
+                    imgs, gain=g, offset=o, image_mask=image_mask,
+                    threshold_mask=threshold_mask, kept=kept)
+                np.testing.assert_array_almost_equal(expected, imgs)
+                np.testing.assert_array_almost_equal(expected_mean, mean)
+
+        # without any mask
+        imgs = data.copy()
+        mean = correct_mask_nanmean_image_data(imgs, offset=offset)
+        np.testing.assert_array_almost_equal(data - offset, imgs)
+        np.testing.assert_array_almost_equal(nanmean_image_data(data - offset), mean)
+
+    def testNanmeanOnOffImageData(self):
+        arr3d = np.ones((2, 2, 2), dtype=np.float32)
+
+        # test invalid input
+        with self.assertRaises(TypeError):
+            nanmean_on_off_image_data(np.ones((2, 2), dtype=np.float32), [0], [1])
+        with self.assertRaises(IndexError):
+            nanmean_on_off_image_data(arr3d, [0], [2])
+        with self.assertRaises(ValueError):
+            nanmean_on_off_image_data(arr3d, [0], [1], out_on=np.ones((2, 3), dtype=np.float32))
+
+        data = np.random.randn(6, 3, 5).astype(np.float32)
+        data[0, 0, 0] = np.nan
+        data[::2, 1, 1] = np.nan
+
+        indices_on, indices_off = [0, 2, 4], [1, 3]
+        with np.warnings.catch_warnings():
+            np.warnings.simplefilter("ignore", category=RuntimeWarning)
+            expected_on = nanmean_image_data(data, kept=indices_on)
+        expected_off = nanmean_image_data(data, kept=indices_off)
+
+        image_on, image_off = nanmean_on_off_image_data(data, indices_on, indices_off)
+        np.testing.assert_array_almost_equal(expected_on, image_on)
+        np.testing.assert_array_almost_equal(expected_off, image_off)
+
+        # with output buffers
+        out_on = np.empty((3, 5), dtype=np.float32)
+        image_on, image_off = nanmean_on_off_image_data(
+            data, indices_on, [], out_on=out_on)
+        self.assertIs(out_on, image_on)
+        self.assertIsNone(image_off)
+        np.testing.assert_array_almost_equal(expected_on, out_on)
+
+    def testNanmeanImageDataWithOutput(self):
+        data = np.random.randn(5, 3, 4).astype(np.float32)
+        data[0, 0, 0] = np.nan
+
+        out = np.empty((3, 4), dtype=np.float32)
+        self.assertIs(out, nanmean_image_data(data, out=out))
+        np.testing.assert_array_equal(nanmean_image_data(data), out)
+
+        self.assertIs(out, nanmean_image_data(data, kept=[1, 3], out=out))
+        np.testing.assert_array_equal(nanmean_image_data(data, kept=[1, 3]), out)
+
+        self.assertIs(out, nanmean_image_data([data[0], data[1]], out=out))
+        np.testing.assert_array_equal(nanmean_image_data([data[0], data[1]]), out)
+
+        self.assertIs(out, nanmean_image_data(data[2], out=out))
+        np.testing.assert_array_equal(data[2], out)
+
+        with self.assertRaises(ValueError):
+            nanmean_image_data(data, out=np.empty((4, 3), dtype=np.float32))
+        with self.assertRaises(TypeError):
+            nanmean_image_data(data, out=np.empty((3, 4), dtype=np.float64))
+
+        # fused correction, masking and nanmean
+        gain = np.random.randn(5, 3, 4).astype(np.float32)
+        image_mask = np.random.choice([True, False], size=(3, 4))
+        for mask in (image_mask, BitMask(image_mask)):
+            for kept in (None, [0, 2]):
+                expected = correct_mask_nanmean_image_data(
+                    data.copy(), gain=gain, image_mask=mask, kept=kept)
+                ret = correct_mask_nanmean_image_data(
+                    data.copy(), gain=gain, image_mask=mask, kept=kept, out=out)
+                self.assertIs(out, ret)
+                np.testing.assert_array_equal(expected, out)
+
+    def testConcurrentCalls(self):
+        # the kernels release the GIL
+        data = [np.random.randn(32, 64, 128).astype(np.float32) for _ in range(4)]
+        expected = [nanmean_image_data(d) for d in data]
+
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            rets = list(executor.map(nanmean_image_data, data))
+        for ret, gt in zip(rets, expected):
+            np.testing.assert_array_equal(gt, ret)
+
+        imgs = [d.copy() for d in data]
+        with ThreadPoolExecutor(max_workers=4) as executor:
+            list(executor.map(lambda x: mask_image_data(x, threshold_mask=(0, 1)), imgs))
+        for img, d in zip(imgs, data):
+            np.testing.assert_array_equal(np.where((d < 0) | (d > 1), np.nan, d), img)
+
 
 class TestMaskImageData:
     @pytest.mark.parametrize("keep_nan, mt, dtype",
@@ -402,3 +535,66 @@ class TestMaskImageData:
             np.array([[mt, 2, mt], [mt, mt, mt]], dtype=dtype), img)
         np.testing.assert_array_equal(
             np.array([[True, False, True], [True, True, True]], dtype=np.bool), out)
+
+    def testBitMask(self):
+        img_mask = np.array([[1, 0, 0, 1, 0, 0, 0, 0, 1], [0, 1, 0, 0, 0, 0, 0, 0, 1]], dtype=np.bool)
+        mask = BitMask(img_mask)
+        self.assertEqual((2, 9), mask.shape)
+        self.assertEqual(5, mask.count())
+        np.testing.assert_array_equal(img_mask, mask.toImageMask())
+        # the layout is identical to numpy.packbits
+        self.assertEqual(np.packbits(img_mask).tobytes(), mask.tobytes())
+        self.assertEqual(mask, BitMask.frombytes(2, 9, np.packbits(img_mask)))
+        with pytest.raises(ValueError, match="Expected at least 3 bytes"):
+            BitMask.frombytes(2, 9, b'\x00\x00')
+
+        # combine masks word-wise
+        other = BitMask(2, 9)
+        other |= mask
+        self.assertEqual(mask, other)
+        other &= BitMask(2, 9)
+        self.assertFalse(other.any())
+        np.testing.assert_array_equal(img_mask, (mask | BitMask(2, 9)).toImageMask())
+        with pytest.raises(ValueError, match="Masks have different shapes"):
+            mask | BitMask(2, 8)
+
+    @pytest.mark.parametrize("keep_nan, mt, dtype",
+                             [(False, 0, np.float32), (True, np.nan, np.float32)])
+    def testMaskImageDataWithBitMask(self, keep_nan, mt, dtype):
+        img_mask = np.array([[1, 0, 0], [1, 0, 0]], dtype=np.bool)
+        bit_mask = BitMask(img_mask)
+
+        # identical to a bool image mask
+        img = np.array([[1, 2, np.nan], [3, 4, 5]], dtype=dtype)
+        img_gt = img.copy()
+        mask_image_data(img, image_mask=bit_mask, threshold_mask=(2, 3), keep_nan=keep_nan)
+        mask_image_data(img_gt, image_mask=img_mask, threshold_mask=(2, 3), keep_nan=keep_nan)
+        np.testing.assert_array_equal(img_gt, img)
+
+        imgs = np.array([[[1, 2, np.nan], [3, 4, 5]], [[1, 2, 3], [3, 4, 5]]], dtype=dtype)
+        imgs_gt = imgs.copy()
+        mask_image_data(imgs, image_mask=bit_mask, keep_nan=keep_nan)
+        mask_image_data(imgs_gt, image_mask=img_mask, keep_nan=keep_nan)
+        np.testing.assert_array_equal(imgs_gt, imgs)
+
+        # output into a bit-packed mask
+        img = np.array([[1, 2, np.nan], [3, 4, 5]], dtype=dtype)
+        out = BitMask(2, 3)
+        mask_image_data(img, image_mask=bit_mask, threshold_mask=(2, 3), keep_nan=keep_nan, out=out)
+        np.testing.assert_array_equal(np.array([[mt, 2, mt], [mt, mt, mt]], dtype=dtype), img)
+        np.testing.assert_array_equal(
+            np.array([[True, False, True], [True, True, True]], dtype=np.bool), out.toImageMask())
+
+        img = np.array([[1, 2, np.nan], [3, 4, 5]], dtype=dtype)
+        out = BitMask(2, 3)
+        mask_image_data(img, keep_nan=keep_nan, out=out)
+        np.testing.assert_array_equal(
+            np.array([[False, False, True], [False, False, False]], dtype=np.bool), out.toImageMask())
+
+        # fused kernel
+        imgs = np.array([[[1, 2, np.nan], [3, 4, 5]], [[1, 2, 3], [3, 4, 5]]], dtype=dtype)
+        imgs_gt = imgs.copy()
+        np.testing.assert_array_equal(
+            correct_mask_nanmean_image_data(imgs_gt, image_mask=img_mask, threshold_mask=(2, 4)),
+            correct_mask_nanmean_image_data(imgs, image_mask=bit_mask, threshold_mask=(2, 4)))
+        np.testing.assert_array_equal(imgs_gt, imgs)
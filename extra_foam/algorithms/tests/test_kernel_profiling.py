@@ -0,0 +1,43 @@
+import unittest
+
+import numpy as np
+
+from extra_foam.algorithms import (
+    kernel_latency_stats, kernel_profiling, kernel_profiling_enabled,
+    reset_kernel_profiling, mask_image_data, nanmean_image_data, nanmean
+)
+
+
+class TestKernelProfiling(unittest.TestCase):
+    def setUp(self):
+        reset_kernel_profiling()
+
+    def testDisabled(self):
+        self.assertFalse(kernel_profiling_enabled())
+
+        data = np.random.rand(4, 16, 32).astype(np.float32)
+        nanmean_image_data(data)
+        self.assertDictEqual({}, kernel_latency_stats())
+
+    def testStats(self):
+        data = np.random.rand(4, 16, 32).astype(np.float32)
+
+        with kernel_profiling():
+            self.assertTrue(kernel_profiling_enabled())
+            for _ in range(3):
+                mask_image_data(data, threshold_mask=(0.1, 0.9), keep_nan=True)
+                nanmean_image_data(data)
+            nanmean(data)
+        self.assertFalse(kernel_profiling_enabled())
+
+        stats = kernel_latency_stats(reset=True)
+        s = stats["imageproc.nanmeanImageArray"]
+        self.assertEqual(3, s['count'])
+        self.assertTrue(0 <= s['p50'] <= s['p99'] <= s['max'])
+        self.assertGreater(s['throughput'], 0)
+        self.assertEqual(1, s['allocations'])
+        self.assertEqual(3, stats["imageproc.maskImageDataNan"]['count'])
+        self.assertEqual(1, stats["statistics.nanmean"]['count'])
+
+        # statistics have been reset
+        self.assertDictEqual({}, kernel_latency_stats())
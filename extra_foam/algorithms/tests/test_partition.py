@@ -0,0 +1,61 @@
+import unittest
+
+import numpy as np
+
+from extra_foam.algorithms import (
+    get_partition_config, numa_node_count, partition_config,
+    set_partition_config, mask_image_data, nanmean_image_data
+)
+
+
+class TestPartition(unittest.TestCase):
+    def testConfig(self):
+        self.assertTupleEqual(("row", 1, True, False), get_partition_config())
+
+        with partition_config("blocked", 4, False):
+            self.assertTupleEqual(("blocked", 4, False, False), get_partition_config())
+        with partition_config("row", 2, True, True):
+            self.assertTupleEqual(("row", 2, True, True), get_partition_config())
+        self.assertTupleEqual(("row", 1, True, False), get_partition_config())
+
+        with self.assertRaises(ValueError):
+            set_partition_config("unknown")
+        with self.assertRaises(ValueError):
+            set_partition_config("row", 0)
+        self.assertTupleEqual(("row", 1, True, False), get_partition_config())
+
+        self.assertGreaterEqual(numa_node_count(), 1)
+
+    def testAllModules(self):
+        from extra_foam.algorithms import partition
+
+        names = {m.__name__.rsplit('.', 1)[-1] for m in partition._modules}
+        # all the modules which run kernels through f_parallel.hpp
+        self.assertSetEqual({"imageproc", "geometry", "datamodel", "statistics",
+                             "roi", "azimuthal_integrator", "digitizer",
+                             "image_codec", "binning", "modules_buffer"}, names)
+
+        with partition_config("blocked", 3, False, True):
+            for m in partition._modules:
+                self.assertTupleEqual(("blocked", 3, False, True), m.partitionConfig(),
+                                      msg=m.__name__)
+        for m in partition._modules:
+            self.assertTupleEqual(("row", 1, True, False), m.partitionConfig(),
+                                  msg=m.__name__)
+
+    def testIdenticalResults(self):
+        data = np.random.rand(8, 33, 65).astype(np.float32)
+        data[::2, ::3, ::4] = np.nan
+
+        results = []
+        for mode in ("row", "blocked"):
+            for affinity, numa in ((True, False), (False, False), (True, True)):
+                with partition_config(mode, 2, affinity, numa):
+                    masked = data.copy()
+                    mask_image_data(masked, threshold_mask=(0.1, 0.9), keep_nan=True)
+                    results.append((masked, nanmean_image_data(masked)))
+
+        for masked, mean in results[1:]:
+            np.testing.assert_array_equal(results[0][0], masked)
+            # the partial sums of the NUMA nodes are added in another order
+            np.testing.assert_allclose(results[0][1], mean, rtol=1e-6)
@@ -0,0 +1,111 @@
+import pytest
+
+import numpy as np
+
+from extra_foam.algorithms import (
+    mask_image_data, roi_projection, roi_statistics, RoiStat, N_ROI_STATS
+)
+
+
+_stat_handlers = {
+    RoiStat.SUM: np.nansum,
+    RoiStat.MEAN: np.nanmean,
+    RoiStat.MEDIAN: np.nanmedian,
+    RoiStat.MIN: np.nanmin,
+    RoiStat.MAX: np.nanmax,
+    RoiStat.VAR: np.nanvar,
+    RoiStat.STD: np.nanstd,
+}
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+@pytest.mark.parametrize("with_mask", [False, True])
+@pytest.mark.parametrize("threshold_mask", [None, (0.2, 0.8)])
+def testRoiStatistics(dtype, with_mask, threshold_mask):
+    data = np.random.rand(8, 40, 30).astype(dtype)
+    data[0, 5, 5] = np.nan
+    image_mask = np.random.choice([True, False], size=data.shape[-2:]) if with_mask else None
+    # the last ROI is clipped by the image
+    rois = [(0, 0, 10, 20), (5, 10, 15, 15), (25, 30, 10, 20)]
+
+    ret = roi_statistics(data, rois, image_mask=image_mask,
+                         threshold_mask=threshold_mask, with_median=True)
+    assert (len(data), len(rois), N_ROI_STATS) == ret.shape
+    assert dtype == ret.dtype
+
+    masked = data.copy()
+    mask_image_data(masked, image_mask=image_mask, threshold_mask=threshold_mask)
+    for k, (x, y, w, h) in enumerate(rois):
+        roi = masked[:, y:y + h, x:x + w]
+        np.testing.assert_array_equal(np.sum(~np.isnan(roi), axis=(-2, -1)),
+                                      ret[:, k, int(RoiStat.COUNT)])
+        for stat, handler in _stat_handlers.items():
+            np.testing.assert_allclose(handler(roi, axis=(-2, -1)),
+                                       ret[:, k, int(stat)], rtol=1e-4)
+
+    # the original data are not modified
+    assert np.count_nonzero(np.isnan(data)) == 1
+
+
+@pytest.mark.parametrize("with_mask", [False, True])
+def testRoiStatisticsWithOutput(with_mask):
+    data = np.random.rand(4, 20, 30).astype(np.float32)
+    image_mask = np.random.choice([True, False], size=data.shape[-2:]) if with_mask else None
+    rois = [(0, 0, 10, 20), (25, 10, 10, 20)]
+
+    expected = roi_statistics(data, rois, image_mask=image_mask, with_median=True)
+    out = np.empty((4, 2, N_ROI_STATS), dtype=np.float32)
+    assert out is roi_statistics(data, rois, image_mask=image_mask,
+                                 with_median=True, out=out)
+    np.testing.assert_array_equal(expected, out)
+
+    with pytest.raises(ValueError, match="wrong shape"):
+        roi_statistics(data, rois[:1], image_mask=image_mask, out=out)
+    with pytest.raises(TypeError):
+        roi_statistics(data, rois, image_mask=image_mask, out=out.astype(np.float64))
+
+
+def testRoiStatisticsEmpty():
+    data = np.ones((2, 10, 10), dtype=np.float32)
+
+    ret = roi_statistics(data, [(20, 20, 5, 5)])
+    np.testing.assert_array_equal([0, 0], ret[:, 0, int(RoiStat.COUNT)])
+    np.testing.assert_array_equal([0, 0], ret[:, 0, int(RoiStat.SUM)])
+    assert np.all(np.isnan(ret[:, 0, int(RoiStat.MEAN)]))
+
+    with pytest.raises(ValueError):
+        roi_statistics(data, [(0, 0, 5, 5)], threshold_mask=(1, 0))
+
+    with pytest.raises(ValueError):
+        roi_statistics(data, [(0, 0, 5, 5)], image_mask=np.zeros((10, 9), dtype=bool))
+
+
+@pytest.mark.parametrize("direction, axis", [('x', -2), ('y', -1)])
+@pytest.mark.parametrize("mean, handler", [(False, np.nansum), (True, np.nanmean)])
+def testRoiProjection(direction, axis, mean, handler):
+    data = np.random.rand(8, 40, 30).astype(np.float32)
+    data[0, 5, 5] = np.nan
+    image_mask = np.random.choice([True, False], size=data.shape[-2:])
+    threshold_mask = (0.1, 0.9)
+    x, y, w, h = roi = (3, 4, 20, 10)
+
+    ret = roi_projection(data, roi, direction, mean=mean,
+                         image_mask=image_mask, threshold_mask=threshold_mask)
+
+    masked = data.copy()
+    mask_image_data(masked, image_mask=image_mask, threshold_mask=threshold_mask)
+    with np.warnings.catch_warnings():
+        np.warnings.simplefilter("ignore", category=RuntimeWarning)
+        expected = handler(masked[:, y:y + h, x:x + w], axis=axis)
+    np.testing.assert_allclose(expected, ret, rtol=1e-5)
+
+    with pytest.raises(ValueError, match="Unknown projection direction"):
+        roi_projection(data, roi, 'z')
+
+    out = np.empty((8, w if direction == 'x' else h), dtype=np.float32)
+    assert out is roi_projection(data, roi, direction, mean=mean, image_mask=image_mask,
+                                 threshold_mask=threshold_mask, out=out)
+    np.testing.assert_array_equal(ret, out)
+
+    with pytest.raises(ValueError, match="wrong shape"):
+        roi_projection(data, (3, 4, 5, 5), direction, out=out)
@@ -3,7 +3,10 @@ import math
 
 import numpy as np
 
-from extra_foam.algorithms import down_sample, slice_curve, up_sample
+from extra_foam.algorithms import (
+    down_sample, nan_down_sample_image, nan_down_sample_image_with_levels,
+    slice_curve, up_sample
+)
 
 
 class TestSampling(unittest.TestCase):
@@ -66,6 +69,43 @@ class TestSampling(unittest.TestCase):
         with self.assertRaises(ValueError):
             down_sample(np.arange(16).reshape(2, 2, 2, 2))
 
+    def test_nan_down_sample_image(self):
+        x = np.array([[1, 2, 3, 4, 5],
+                      [3, np.nan, 5, np.nan, 7],
+                      [np.nan, np.nan, 1, 1, 9]], dtype=np.float32)
+
+        ret = nan_down_sample_image(x)
+        self.assertEqual(np.float32, ret.dtype)
+        np.testing.assert_array_equal(np.array([[2, 4, 6], [np.nan, 1, 9]]), ret)
+        np.testing.assert_array_equal(x, nan_down_sample_image(x, 1))
+        np.testing.assert_array_almost_equal(np.array([[2.5, 7]]), nan_down_sample_image(x, 4))
+
+        # the result is the same as numpy
+        data = np.random.rand(64, 96)
+        data[::3, ::5] = np.nan
+        with np.warnings.catch_warnings():
+            np.warnings.simplefilter("ignore", category=RuntimeWarning)
+            gt = np.nanmean(data.reshape(16, 4, 24, 4), axis=(1, 3))
+        np.testing.assert_array_almost_equal(gt, nan_down_sample_image(data, 4))
+
+        # other dtypes are converted to float
+        ret = nan_down_sample_image(np.ones((4, 4), dtype=np.uint16))
+        np.testing.assert_array_equal(np.ones((2, 2), dtype=np.float32), ret)
+
+        with self.assertRaises(ValueError):
+            nan_down_sample_image(x, 0)
+        with self.assertRaises(ValueError):
+            nan_down_sample_image(np.ones((2, 2, 2)))
+        with self.assertRaises(TypeError):
+            nan_down_sample_image([[1, 2], [3, 4]])
+
+        image, levels = nan_down_sample_image_with_levels(x)
+        np.testing.assert_array_equal(np.array([[2, 4, 6], [np.nan, 1, 9]]), image)
+        self.assertTupleEqual((1, 9), levels)
+        image, levels = nan_down_sample_image_with_levels(x, rate=2, q=0.9)
+        self.assertLessEqual(levels[0], 1)
+        self.assertGreaterEqual(levels[1], 9)
+
     def test_upsample(self):
         x1 = np.array([1, 2])
         x1_gt = np.array([1, 1, 2, 2])
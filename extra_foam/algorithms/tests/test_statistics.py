@@ -6,7 +6,7 @@ import numpy as np
 
 from extra_foam.algorithms.statistics_py import (
     hist_with_stats, nanhist_with_stats, compute_statistics, _get_outer_edges,
-    nanmean, nansum, quick_min_max
+    nanmean, nansum, nanstd, nanvar, nanmin, nanmax, quick_min_max
 )
 
 
@@ -16,12 +16,23 @@ class TestStatistics:
         arr = np.array([[np.nan, 1, 2, 3, 4], [5, 6, 7, 8, np.nan]])
         assert quick_min_max(arr) == (1., 8.)
         assert quick_min_max(arr, q=1.0) == (1, 8)
-        assert quick_min_max(arr, q=0.9) == (2, 7)
-        assert quick_min_max(arr, q=0.7) == (3, 6)
-        assert quick_min_max(arr, q=0.3) == (3, 6)
+        # quantiles of float data are estimated from a histogram
+        width = 7. / 1024
+        assert quick_min_max(arr, q=0.9) == pytest.approx((2, 7), abs=width)
+        assert quick_min_max(arr, q=0.7) == pytest.approx((3, 6), abs=width)
+        assert quick_min_max(arr, q=0.3) == pytest.approx((3, 6), abs=width)
+        v_min, v_max = quick_min_max(arr, q=0.9)
+        assert v_min <= 2 and v_max >= 7
+
+        # the python implementation for the other types
+        arr_int = np.array([[0, 1, 2, 3, 4], [5, 6, 7, 8, 9]], dtype=np.uint16)
+        assert quick_min_max(arr_int) == (0, 9)
+        assert quick_min_max(arr_int, q=0.9) == (1, 8)
 
         with pytest.raises(ValueError):
             quick_min_max(arr, q=1.1)
+        with pytest.raises(ValueError):
+            quick_min_max(arr_int, q=1.1)
 
         # test array size > 1e5
         arr = np.ones((1000, 1000), dtype=np.float32)
@@ -32,13 +43,30 @@ class TestStatistics:
         assert quick_min_max(arr) == (1., 2.)
         assert quick_min_max(arr, q=0.9) == (1, 2)
 
+        # no down-sampling of float data
+        arr[1, 1] = 10
+        assert quick_min_max(arr) == (1., 10.)
+        arr[1, 1] = np.inf
+        assert quick_min_max(arr) == (1., 2.)
+
+        data = np.random.randn(512, 1024).astype(np.float32)
+        data[::7, ::5] = np.nan
+        v_min, v_max = quick_min_max(data, q=0.99)
+        width = (np.nanmax(data) - np.nanmin(data)) / 1024
+        v_min_gt = np.nanquantile(data, 0.01, interpolation='nearest')
+        v_max_gt = np.nanquantile(data, 0.99, interpolation='nearest')
+        assert v_min_gt - width <= v_min <= v_min_gt
+        assert v_max_gt <= v_max <= v_max_gt + width
+
     def _assert_array_almost_equal(self, a, b):
         np.testing.assert_array_almost_equal(a, b)
         if isinstance(a, np.ndarray):
             assert a.dtype == b.dtype
 
     @pytest.mark.parametrize("dtype", [np.float32, np.float64])
-    @pytest.mark.parametrize("f_cpp, f_py", [(nanmean, np.nanmean), (nansum, np.nansum)])
+    @pytest.mark.parametrize("f_cpp, f_py", [(nanmean, np.nanmean), (nansum, np.nansum),
+                                             (nanstd, np.nanstd), (nanvar, np.nanvar),
+                                             (nanmin, np.nanmin), (nanmax, np.nanmax)])
     def testCppStatistics(self, f_cpp, f_py, dtype):
         a1d = np.array([np.nan, 1, 2], dtype=dtype)
         a2d = np.array([[np.nan, 1, 2], [3, 6, np.nan]], dtype=dtype)
@@ -67,6 +95,44 @@ class TestStatistics:
             self._assert_array_almost_equal(f_py(a3d, axis=(-2, -1)), f_cpp(a3d, axis=(-2, -1)))
             self._assert_array_almost_equal(f_py(a4d, axis=(-2, -1)), f_cpp(a4d, axis=(-2, -1)))
 
+            # axis = (0, 2) which keeps the last axis
+            self._assert_array_almost_equal(f_py(a4d, axis=(0, 2)), f_cpp(a4d, axis=(0, 2)))
+            self._assert_array_almost_equal(f_py(a5d, axis=(1, 3)), f_cpp(a5d, axis=(1, 3)))
+
+            # non-contiguous data
+            self._assert_array_almost_equal(f_py(a4d[..., ::2], axis=-1), f_cpp(a4d[..., ::2], axis=-1))
+            self._assert_array_almost_equal(f_py(a4d.T, axis=(0, 1)), f_cpp(a4d.T, axis=(0, 1)))
+
+    @pytest.mark.parametrize("dtype", [np.float32, np.float64, np.int32])
+    @pytest.mark.parametrize("f_cpp", [nanmean, nansum, nanstd, nanvar, nanmin, nanmax])
+    def testCppStatisticsWithOutput(self, f_cpp, dtype):
+        a4d = np.arange(120, dtype=dtype).reshape(2, 3, 4, 5)
+        if dtype != np.int32:
+            a4d[:, ::2, ::3, ::4] = np.nan
+
+        for axis in (0, (-2, -1), (0, 2)):
+            expected = f_cpp(a4d, axis=axis)
+            out = np.empty_like(expected)
+            assert out is f_cpp(a4d, axis=axis, out=out)
+            self._assert_array_almost_equal(expected, out)
+
+        if dtype != np.int32:
+            with pytest.raises(ValueError, match="wrong shape"):
+                f_cpp(a4d, axis=0, out=np.empty((3, 5, 4), dtype=dtype))
+            with pytest.raises(ValueError, match="C-contiguous"):
+                f_cpp(a4d, axis=0, out=np.empty((5, 4, 3), dtype=dtype).T)
+
+        with pytest.raises(ValueError, match="only supported"):
+            f_cpp(a4d, out=np.empty((), dtype=dtype))
+
+    @pytest.mark.parametrize("f_cpp", [nanmean, nansum, nanstd, nanvar, nanmin, nanmax])
+    def testCppStatisticsInvalidAxis(self, f_cpp):
+        a3d = np.ones((2, 3, 4), dtype=np.float32)
+        with pytest.raises(ValueError, match="out of bounds"):
+            f_cpp(a3d, axis=3)
+        with pytest.raises(ValueError, match="Duplicated"):
+            f_cpp(a3d, axis=(1, -2))
+
     def testNanhistWithStats(self):
         # case 1
         roi = np.array([[np.nan, 1, 2], [3, 6, np.nan]], dtype=np.float32)
@@ -143,6 +209,33 @@ class TestStatistics:
         with pytest.raises(ValueError):
             hist_with_stats(roi, (-np.inf, np.inf), 4)
 
+    @pytest.mark.parametrize("dtype", [np.float32, np.float64])
+    @pytest.mark.parametrize("bin_range", [(-np.inf, np.inf), (2, np.inf), (-np.inf, 12), (1, 15)])
+    def testCppHistWithStats(self, dtype, bin_range):
+        np.random.seed(42)
+        data = np.random.normal(10, 3, size=(20, 30, 50)).astype(dtype)
+        data[:, ::3, ::7] = np.nan
+
+        for arr in (data, data[1], data[1, 2], data[:, 1, ::2]):
+            hist, bin_centers, mean, median, std = nanhist_with_stats(arr, bin_range, 17)
+
+            filtered = arr[~np.isnan(arr)]
+            filtered = filtered[(filtered >= bin_range[0]) & (filtered <= bin_range[1])]
+            hist_gt, bin_edges_gt = np.histogram(
+                filtered, bins=17, range=_get_outer_edges(filtered, bin_range))
+            np.testing.assert_array_equal(hist_gt, hist)
+            np.testing.assert_array_almost_equal(
+                (bin_edges_gt[1:] + bin_edges_gt[:-1]) / 2.0, bin_centers, decimal=5)
+            assert np.mean(filtered) == pytest.approx(mean, rel=1e-5)
+            assert np.median(filtered) == pytest.approx(median)
+            assert np.std(filtered) == pytest.approx(std, rel=1e-5)
+
+        with pytest.raises(ValueError, match="Lower boundary"):
+            nanhist_with_stats(data, (3, 1), 4)
+
+        with pytest.raises(ValueError, match="Number of bins"):
+            nanhist_with_stats(data, bin_range, 0)
+
     def testFindActualRange(self):
         arr = np.array([1, 2, 3, 4])
         assert (-1.5, 2.5) == _get_outer_edges(arr, (-1.5, 2.5))
@@ -223,6 +223,15 @@ class _Config(dict):
         # size, the smaller the latency)
         "PIPELINE_MAX_QUEUE_SIZE": 2,
         "PIPELINE_SLOW_POLICY": PipelineSlowPolicy.DROP,
+        # whether to record the latencies of the C++ kernels
+        "PIPELINE_KERNEL_PROFILING": False,
+        # interval for publishing the kernel latencies, in milliseconds
+        "PIPELINE_KERNEL_PROFILING_INTERVAL": 5000,
+        # whether to split the pulses over the NUMA nodes in the C++ kernels
+        "PIPELINE_NUMA": False,
+        # number of slots of the shared memory which passes the image to the
+        # GUI (0 for pickling the image)
+        "PIPELINE_SHMEM_N_SLOTS": 8,
         # timeout of the zmq bridge, in second
         "BRIDGE_TIMEOUT": 0.1,
         # maximum length of the cache used in data correlation by train ID
@@ -247,6 +256,17 @@ class _Config(dict):
         "SOURCE_EXPIRATION_TIMER": 2000,
         "SOURCE_USER_DEFINED_CATEGORY": "User-defined",
         # -------------------------------------------------------------
+        # Digitizer
+        # -------------------------------------------------------------
+        # windows (in samples) for integrating the pulses in raw digitizer
+        # waveforms. The end of the baseline window is exclusive.
+        "DIGITIZER_PULSE_INTEGRATION": {
+            "BASELINE": (0, 100),
+            "PULSE_START": 1000,
+            "PULSE_PERIOD": 440,
+            "PULSE_WIDTH": 100,
+        },
+        # -------------------------------------------------------------
         # REDIS
         # -------------------------------------------------------------
         # absolute path of the Redis server executable
@@ -470,6 +490,16 @@ class _Config(dict):
 
                 self[key] = det_cfg[key]
 
+        # update the pulse integration windows of raw digitizer waveforms
+        integ_cfg = cfg.get("DIGITIZER", dict()).get("PULSE_INTEGRATION", dict())
+        if integ_cfg:
+            windows = dict(self["DIGITIZER_PULSE_INTEGRATION"])
+            for key in windows:
+                if key in integ_cfg:
+                    windows[key] = tuple(integ_cfg[key]) \
+                        if key == "BASELINE" else int(integ_cfg[key])
+            self["DIGITIZER_PULSE_INTEGRATION"] = windows
+
         # update data sources
         src_cfg = cfg.get("SOURCE", dict())
         self["SOURCE_DEFAULT_TYPE"] = src_cfg["DEFAULT_TYPE"]
@@ -7,6 +7,7 @@ Author: Jun Zhu <jun.zhu@xfel.eu>
 Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
 All rights reserved.
 """
+import json
 import time
 
 from .base_proxy import _AbstractProxy
@@ -26,6 +27,7 @@ class MonProxy(_AbstractProxy):
     MON_N_DROPPED = "mon:n_dropped"
     MON_PERFORMANCE = "mon:train_id"
     MON_AVAILABLE_SOURCES = "mon:available_sources"
+    MON_KERNEL_LATENCY = "mon:kernel_latency"
 
     @redis_except_handler
     def add_tid_with_timestamp(self, tid, dropped=False):
@@ -117,3 +119,34 @@ class MonProxy(_AbstractProxy):
                  otherwise, a dictionary of source name and train ID pairs.
         """
         return self.hget_all(self.MON_AVAILABLE_SOURCES)
+
+    @redis_except_handler
+    def set_kernel_latency(self, worker, stats):
+        """Set the latency statistics of the C++ kernels run by a worker.
+
+        :param str worker: name of the worker.
+        :param dict stats: statistics keyed by kernel name.
+
+        :return: None if the connection failed;
+                 A list of results of 'DEL', 'hmset' and 'PEXPIRE'.
+        """
+        pipe = self._db.pipeline()
+        key = f"{self.MON_KERNEL_LATENCY}:{worker}"
+        pipe.execute_command('DEL', key)
+        if stats:
+            pipe.hmset(key, {k: json.dumps(v) for k, v in stats.items()})
+            # key expiration time should be longer than the publishing interval
+            pipe.execute_command(
+                'PEXPIRE', key, 2 * config['PIPELINE_KERNEL_PROFILING_INTERVAL'])
+        return pipe.execute()
+
+    def get_kernel_latency(self, worker):
+        """Query the latency statistics of the C++ kernels run by a worker.
+
+        :return: None if the connection failed;
+                 otherwise, a dictionary of statistics keyed by kernel name.
+        """
+        ret = self.hget_all(f"{self.MON_KERNEL_LATENCY}:{worker}")
+        if ret is None:
+            return
+        return {k: json.loads(v) for k, v in ret.items()}
@@ -19,12 +19,29 @@ from extra_geom import DSSC_1MGeometry as _geom_DSSC_1MGeometry
 from ..algorithms.geometry import AGIPD_1MGeometry as _AGIPD_1MGeometry
 from ..algorithms.geometry import LPD_1MGeometry as _LPD_1MGeometry
 from ..algorithms.geometry import DSSC_1MGeometry as _DSSC_1MGeometry
+from ..algorithms.geometry import GenericGeometry as _GenericGeometry
+from ..algorithms.geometry import GeometryTile
+from ..algorithms.imageproc import fillImageData as _fillImageData
 from ..config import config, GeomAssembler
 
 
 _IMAGE_DTYPE = config['SOURCE_PROC_IMAGE_DTYPE']
 
 
+def _full_nan(shape, dtype):
+    """Make an array filled with nan.
+
+    An array of images is filled by the C++ kernel, so that its pages are
+    first touched by the threads, and in the NUMA mode on the nodes, which
+    process the same pulses afterwards.
+    """
+    if len(shape) == 3 and np.dtype(dtype) in (np.float32, np.float64):
+        out = np.empty(shape, dtype=dtype)
+        _fillImageData(out, np.nan)
+        return out
+    return np.full(shape, np.nan, dtype=dtype)
+
+
 class _1MGeometryPyMixin:
     def output_array_for_position_fast(self, extra_shape=(), dtype=_IMAGE_DTYPE):
         """Make an array with the shape of assembled data filled with nan.
@@ -34,9 +51,10 @@ class _1MGeometryPyMixin:
         shape = extra_shape + tuple(self.assembledShape())
         if dtype == np.bool:
             return np.full(shape, 0, dtype=dtype)
-        return np.full(shape, np.nan, dtype=dtype)
+        return _full_nan(shape, dtype)
 
-    def position_all_modules(self, modules, out, *, ignore_tile_edge=False):
+    def position_all_modules(self, modules, out, *, ignore_tile_edge=False,
+                             gain=None, offset=None, mask=None):
         """Assemble data in modules according to where the pixels are.
 
         Match the EXtra-geom signature.
@@ -49,7 +67,35 @@ class _1MGeometryPyMixin:
             of tiles. If 'out' is pre-filled with nan, it it equivalent to
             masking the tile edges. This is an extra feature which does not
             exist in EXtra-geom.
+        :param numpy.ndarray gain: gain constants in modules. If given
+            together with 'offset', the modules data are corrected by
+            gain * (data - offset) while being assembled.
+            Shape = (modules, y, x)
+        :param numpy.ndarray offset: offset constants in modules.
+            Shape = (modules, y, x)
+        :param numpy.ndarray mask: pixel mask in modules. Masked pixels are
+            set to nan. It can only be used together with 'gain' and
+            'offset'. Shape = (modules, y, x)
         """
+        if gain is not None or offset is not None:
+            if gain is None or offset is None:
+                raise ValueError("gain and offset must be given together!")
+            if not isinstance(modules, np.ndarray) or modules.ndim != 4:
+                raise ValueError("Correction during assembling requires "
+                                 "modules data with shape "
+                                 "(memory cells, modules, y, x)!")
+            if mask is None:
+                self.positionAllModules(
+                    modules, out, gain, offset, ignore_tile_edge)
+            else:
+                self.positionAllModules(
+                    modules, out, gain, offset, mask, ignore_tile_edge)
+            return
+
+        if mask is not None:
+            raise ValueError("mask can only be applied together with "
+                             "gain and offset!")
+
         if isinstance(modules, np.ndarray):
             self.positionAllModules(modules, out, ignore_tile_edge)
         else:  # extra_data.StackView
@@ -58,12 +104,27 @@ class _1MGeometryPyMixin:
                 ml.append(modules[:, i, ...])
             self.positionAllModules(ml, out, ignore_tile_edge)
 
+    def position_module(self, modules, out, im, *, ignore_tile_edge=False):
+        """Assemble a single module according to where the pixels are.
+
+        It allows assembling a module as soon as its data has arrived.
+
+        :param numpy.ndarray modules: data in modules.
+            Shape = (memory cells, modules, y x)
+        :param numpy.ndarray out: assembled data.
+            Shape = (memory cells, y, x)
+        :param int im: index of the module.
+        :param ignore_tile_edge: True for ignoring the pixels at the edges
+            of tiles.
+        """
+        self.positionModule(modules, out, im, ignore_tile_edge)
+
     def output_array_for_dismantle_fast(self, extra_shape=(), dtype=_IMAGE_DTYPE):
         """Make an array with the shape of data in modules filled with nan."""
         shape = extra_shape + (self.n_modules, *self.module_shape)
         if dtype == np.bool:
             return np.full(shape, 0, dtype=dtype)
-        return np.full(shape, np.nan, dtype=dtype)
+        return _full_nan(shape, dtype)
 
     def dismantle_all_modules(self, assembled, out):
         """Dismantle assembled data into data in modules.
@@ -75,6 +136,17 @@ class _1MGeometryPyMixin:
         """
         self.dismantleAllModules(assembled, out)
 
+    def pixel_positions(self, *, ignore_tile_edge=False):
+        """Get the positions of the pixels in modules in the assembled image.
+
+        :param ignore_tile_edge: True for ignoring the pixels at the edges
+            of tiles, whose positions are set to -1.
+
+        :return numpy.ndarray: (row, col) of each pixel in the assembled
+            image. Shape = (modules, y, x, 2)
+        """
+        return self.pixelPositions(ignore_tile_edge)
+
 
 class DSSC_1MGeometryFast(_DSSC_1MGeometry, _1MGeometryPyMixin):
     """DSSC_1MGeometryFast.
@@ -171,6 +243,49 @@ class AGIPD_1MGeometryFast(_AGIPD_1MGeometry, _1MGeometryPyMixin):
 
         return cls(modules)
 
+class GenericGeometryFast(_GenericGeometry, _1MGeometryPyMixin):
+    """GenericGeometryFast.
+
+    Geometry with any number of modules and tiles, e.g. for JungFrau and
+    ePix100, implemented in C++. The default geometry stacks the modules
+    vertically along the y axis.
+    """
+    @classmethod
+    def from_crystfel_geom(cls, filename, n_modules, module_shape):
+        """Load the geometry from a CrystFEL geometry file.
+
+        Each panel is a tile. The module of a panel is given by its integer
+        'dim' entry, e.g. 'dim1 = 0'. Without such an entry, the modules
+        are stacked along the slow-scan dimension of the data.
+
+        :param str filename: path of the geometry file.
+        :param int n_modules: number of modules.
+        :param tuple module_shape: shape (ss, fs) of the data of a module.
+        """
+        from cfelpyutils.crystfel_utils import load_crystfel_geometry
+
+        geom_dict = load_crystfel_geometry(filename)
+        tiles = []
+        for d in geom_dict['panels'].values():
+            module_dims = [v for v in d.get('dim_structure', [])
+                           if isinstance(v, int)]
+            if module_dims:
+                module, min_ss = module_dims[0], d['min_ss']
+            else:
+                module, min_ss = divmod(d['min_ss'], module_shape[0])
+
+            tiles.append(GeometryTile(
+                module=module,
+                origin=(min_ss, d['min_fs']),
+                shape=(d['max_ss'] - d['min_ss'] + 1,
+                       d['max_fs'] - d['min_fs'] + 1),
+                # CrystFEL positions are in pixels
+                corner=(d['cnx'], d['cny']),
+                fs_vec=(d['fsx'], d['fsy']),
+                ss_vec=(d['ssx'], d['ssy'])))
+
+        return cls(n_modules, tuple(module_shape), tiles)
+
 # patches for geometry classes from EXtra-geom
 
 class AGIPD_1MGeometry(_geom_AGIPD_1MGeometry):
@@ -225,4 +340,17 @@ def load_geometry(detector, filepath, *,
             return DSSC_1MGeometry.from_h5_file_and_quad_positions(
                 filepath, quad_positions)
 
+    if detector in ('JungFrau', 'JungFrauPR', 'ePix100'):
+        if assembler != GeomAssembler.OWN:
+            raise ValueError(f"Only EXtra-foam assembler is supported for "
+                             f"{detector}!")
+
+        n_modules = config["NUMBER_OF_MODULES"]
+        module_shape = tuple(config["MODULE_SHAPE"])
+        if stack_only:
+            return GenericGeometryFast(n_modules, module_shape)
+
+        return GenericGeometryFast.from_crystfel_geom(
+            filepath, n_modules, module_shape)
+
     raise ValueError(f"Unknown detector {detector}!")
@@ -10,6 +10,7 @@ from extra_foam.geometries import (
     DSSC_1MGeometryFast, LPD_1MGeometryFast, AGIPD_1MGeometryFast
 )
 import extra_geom as eg
+from extra_foam.algorithms import FoamAzimuthalIntegrator
 from extra_foam.config import config
 
 
@@ -44,7 +45,7 @@ class _Test1MGeometryMixin:
 
         np.testing.assert_array_equal(modules, dismantled_out)
 
-    @pytest.mark.parametrize("dtype", [_IMAGE_DTYPE, _RAW_IMAGE_DTYPE, bool])
+    @pytest.mark.parametrize("dtype", [_IMAGE_DTYPE, _RAW_IMAGE_DTYPE, np.int16, np.uint32, bool])
     def testAssemblingBridge(self, dtype):
         modules = np.ones((self.n_pulses, self.n_modules, *self.module_shape), dtype=dtype)
 
@@ -68,7 +69,7 @@ class _Test1MGeometryMixin:
 
         np.testing.assert_array_equal(modules, dismantled_out)
 
-    @pytest.mark.parametrize("dtype", [_IMAGE_DTYPE, _RAW_IMAGE_DTYPE, bool])
+    @pytest.mark.parametrize("dtype", [_IMAGE_DTYPE, _RAW_IMAGE_DTYPE, np.int16, np.uint32, bool])
     def testAssemblingFile(self, dtype):
         modules = StackView(
             {i: np.ones((self.n_pulses, *self.module_shape), dtype=dtype) for i in range(self.n_modules)},
@@ -104,6 +105,81 @@ class _Test1MGeometryMixin:
         assert 0 == np.count_nonzero(~np.isnan(out_stack[:, 0::self.tile_shape[0], :]))
         assert 0 == np.count_nonzero(~np.isnan(out_stack[:, 0::self.tile_shape[0], :]))
 
+    @pytest.mark.parametrize("dtype", [_IMAGE_DTYPE, _RAW_IMAGE_DTYPE])
+    def testAssemblingModuleByModule(self, dtype):
+        modules = np.ones((self.n_pulses, self.n_modules, *self.module_shape), dtype=dtype)
+        for i in range(self.n_modules):
+            modules[:, i] *= i
+
+        out_gt = self.geom_fast.output_array_for_position_fast((self.n_pulses,), _IMAGE_DTYPE)
+        self.geom_fast.position_all_modules(modules, out_gt)
+
+        out_fast = self.geom_fast.output_array_for_position_fast((self.n_pulses,), _IMAGE_DTYPE)
+        for i in range(self.n_modules):
+            self.geom_fast.position_module(modules, out_fast, i)
+        np.testing.assert_array_equal(out_gt, out_fast)
+
+        with pytest.raises(ValueError, match="out of range"):
+            self.geom_fast.position_module(modules, out_fast, self.n_modules)
+
+    @pytest.mark.parametrize("dtype", [_IMAGE_DTYPE, _RAW_IMAGE_DTYPE])
+    def testAssemblingWithCorrection(self, dtype):
+        shape = (self.n_pulses, self.n_modules, *self.module_shape)
+        modules = np.random.randint(0, 100, size=shape).astype(dtype)
+        gain = np.random.rand(self.n_modules, *self.module_shape).astype(_IMAGE_DTYPE)
+        offset = np.random.rand(self.n_modules, *self.module_shape).astype(_IMAGE_DTYPE)
+        mask = np.random.choice([True, False], size=offset.shape)
+
+        out_gt = self.geom_fast.output_array_for_position_fast((self.n_pulses,), _IMAGE_DTYPE)
+        corrected = (gain * (modules.astype(_IMAGE_DTYPE) - offset)).astype(_IMAGE_DTYPE)
+        self.geom_fast.position_all_modules(corrected, out_gt)
+
+        out = self.geom_fast.output_array_for_position_fast((self.n_pulses,), _IMAGE_DTYPE)
+        self.geom_fast.position_all_modules(modules, out, gain=gain, offset=offset)
+        np.testing.assert_array_almost_equal(out_gt, out)
+
+        out_gt = self.geom_fast.output_array_for_position_fast((self.n_pulses,), _IMAGE_DTYPE)
+        corrected[:, mask] = np.nan
+        self.geom_fast.position_all_modules(corrected, out_gt)
+
+        out = self.geom_fast.output_array_for_position_fast((self.n_pulses,), _IMAGE_DTYPE)
+        self.geom_fast.position_all_modules(modules, out, gain=gain, offset=offset, mask=mask)
+        np.testing.assert_array_almost_equal(out_gt, out)
+
+        with pytest.raises(ValueError):
+            self.geom_fast.position_all_modules(modules, out, gain=gain)
+
+        with pytest.raises(ValueError):
+            self.geom_fast.position_all_modules(modules, out, mask=mask)
+
+        with pytest.raises(ValueError):
+            self.geom_fast.position_all_modules(modules, out, gain=gain[:-1], offset=offset)
+
+    @pytest.mark.parametrize("ignore_tile_edge", [False, True])
+    def testPixelPositions(self, ignore_tile_edge):
+        shape = (self.n_pulses, self.n_modules, *self.module_shape)
+        modules = np.random.rand(*shape).astype(_IMAGE_DTYPE)
+
+        out = self.geom_fast.output_array_for_position_fast((self.n_pulses,), _IMAGE_DTYPE)
+        self.geom_fast.position_all_modules(modules, out, ignore_tile_edge=ignore_tile_edge)
+
+        pos = self.geom_fast.pixel_positions(ignore_tile_edge=ignore_tile_edge)
+        assert (self.n_modules, *self.module_shape, 2) == pos.shape
+        positioned = pos[..., 0] >= 0
+        np.testing.assert_array_equal(positioned, pos[..., 1] >= 0)
+        assert np.count_nonzero(~np.isnan(out[0])) == np.count_nonzero(positioned)
+        np.testing.assert_array_equal(modules[:, positioned],
+                                      out[:, pos[positioned][:, 0], pos[positioned][:, 1]])
+
+        # integrate the modules data without assembling them
+        integ = FoamAzimuthalIntegrator(dist=0.2, poni1=0.1, poni2=0.1,
+                                        pixel1=2e-4, pixel2=2e-4, wavelength=5e-10)
+        integ.setPixelPositions(pos)
+        q_gt, intensities_gt = integ.integrate1d(out, 128, (0.1, 1.))
+        q, intensities = integ.integrate1d(modules, 128, (0.1, 1.))
+        np.testing.assert_array_almost_equal(q_gt, q)
+        np.testing.assert_array_almost_equal(intensities_gt, intensities, decimal=4)
+
 
 class TestDSSC_1MGeometryFast(_Test1MGeometryMixin):
     @classmethod
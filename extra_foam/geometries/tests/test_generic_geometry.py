@@ -0,0 +1,164 @@
+import os
+import os.path as osp
+import tempfile
+
+import pytest
+
+import numpy as np
+
+from extra_foam.geometries import (
+    AGIPD_1MGeometryFast, GenericGeometryFast, GeometryTile
+)
+from extra_foam.config import config
+
+
+_geom_path = osp.join(osp.dirname(osp.abspath(__file__)), "../")
+
+_IMAGE_DTYPE = config['SOURCE_PROC_IMAGE_DTYPE']
+_RAW_IMAGE_DTYPE = config['SOURCE_RAW_IMAGE_DTYPE']
+
+
+_JUNGFRAU_GEOM = """
+data = /data/data
+dim0 = %
+dim1 = ss
+dim2 = fs
+
+adu_per_eV = 0.0042
+clen = 0.1
+photon_energy = 9300
+res = 13333.3
+
+p0a0/min_fs = 0
+p0a0/min_ss = 0
+p0a0/max_fs = 5
+p0a0/max_ss = 1
+p0a0/fs = +1.0x +0.0y
+p0a0/ss = +0.0x +1.0y
+p0a0/corner_x = 0.0
+p0a0/corner_y = 0.0
+p0a0/coffset = 0.0
+
+p0a1/min_fs = 0
+p0a1/min_ss = 2
+p0a1/max_fs = 5
+p0a1/max_ss = 3
+p0a1/fs = +1.0x +0.0y
+p0a1/ss = +0.0x +1.0y
+p0a1/corner_x = 0.0
+p0a1/corner_y = 3.0
+p0a1/coffset = 0.0
+
+p1a0/min_fs = 0
+p1a0/min_ss = 4
+p1a0/max_fs = 5
+p1a0/max_ss = 5
+p1a0/fs = +0.0x -1.0y
+p1a0/ss = +1.0x +0.0y
+p1a0/corner_x = 8.0
+p1a0/corner_y = 6.0
+p1a0/coffset = 0.0
+
+p1a1/min_fs = 0
+p1a1/min_ss = 6
+p1a1/max_fs = 5
+p1a1/max_ss = 7
+p1a1/fs = +0.0x -1.0y
+p1a1/ss = +1.0x +0.0y
+p1a1/corner_x = 10.0
+p1a1/corner_y = 6.0
+p1a1/coffset = 0.0
+"""
+
+
+class TestGenericGeometryFast:
+    @pytest.mark.parametrize("dtype", [_IMAGE_DTYPE, _RAW_IMAGE_DTYPE, np.int16, np.uint32])
+    def testStacked(self, dtype):
+        n_pulses, n_modules, module_shape = 3, 2, (512, 1024)
+        geom = GenericGeometryFast(n_modules, module_shape)
+        assert 2 == geom.n_modules
+        assert (1024, 1024) == tuple(geom.assembledShape())
+
+        modules = np.random.randint(0, 100, size=(n_pulses, n_modules, *module_shape)).astype(dtype)
+        out = geom.output_array_for_position_fast((n_pulses,), _IMAGE_DTYPE)
+        geom.position_all_modules(modules, out)
+        np.testing.assert_array_equal(modules.reshape(n_pulses, -1, module_shape[-1]), out)
+
+        dismantled = geom.output_array_for_dismantle_fast((n_pulses,), _IMAGE_DTYPE)
+        geom.dismantle_all_modules(out, dismantled)
+        np.testing.assert_array_equal(modules, dismantled)
+
+        with pytest.raises(ValueError, match="modules"):
+            geom.position_all_modules(modules[:, :1], out)
+
+    def testCrystfelGeomModulesStackedAlongSs(self):
+        fd, filename = tempfile.mkstemp(suffix=".geom")
+        with os.fdopen(fd, 'w') as f:
+            f.write(_JUNGFRAU_GEOM)
+        try:
+            geom = GenericGeometryFast.from_crystfel_geom(filename, 2, (4, 6))
+        finally:
+            os.remove(filename)
+
+        assert 4 == len(geom.tiles)
+        assert (6, 12) == tuple(geom.assembledShape())
+
+        modules = np.arange(2 * 2 * 4 * 6, dtype=_IMAGE_DTYPE).reshape(2, 2, 4, 6)
+        out = geom.output_array_for_position_fast((2,), _IMAGE_DTYPE)
+        geom.position_all_modules(modules, out)
+
+        # module 0: two tiles with a gap of one row in between
+        np.testing.assert_array_equal(modules[:, 0, :2], out[:, :2, :6])
+        assert np.isnan(out[:, 2, :8]).all()
+        np.testing.assert_array_equal(modules[:, 0, 2:], out[:, 3:5, :6])
+        # module 1: fast scan along -y and slow scan along x
+        for ss in range(4):
+            np.testing.assert_array_equal(modules[:, 1, ss, ::-1], out[:, :, 8 + ss])
+        assert np.isnan(out[:, :, 6:8]).all()
+
+        pos = geom.pixel_positions()
+        assert (2, 4, 6, 2) == pos.shape
+        np.testing.assert_array_equal([3, 0], pos[0, 2, 0])
+        np.testing.assert_array_equal([5, 8], pos[1, 0, 0])
+
+    @pytest.mark.parametrize("ignore_tile_edge", [False, True])
+    def testEquivalentTo1MGeometry(self, ignore_tile_edge):
+        geom_file = osp.join(_geom_path, "agipd_mar18_v11.geom")
+        geom_1m = AGIPD_1MGeometryFast.from_crystfel_geom(geom_file)
+        geom = GenericGeometryFast.from_crystfel_geom(
+            geom_file, AGIPD_1MGeometryFast.n_modules, AGIPD_1MGeometryFast.module_shape)
+
+        assert geom_1m.assembledShape() == geom.assembledShape()
+
+        n_pulses = 2
+        shape = (n_pulses, AGIPD_1MGeometryFast.n_modules, *AGIPD_1MGeometryFast.module_shape)
+        modules = np.random.rand(*shape).astype(_IMAGE_DTYPE)
+        out_gt = geom_1m.output_array_for_position_fast((n_pulses,), _IMAGE_DTYPE)
+        geom_1m.position_all_modules(modules, out_gt, ignore_tile_edge=ignore_tile_edge)
+        out = geom.output_array_for_position_fast((n_pulses,), _IMAGE_DTYPE)
+        geom.position_all_modules(modules, out, ignore_tile_edge=ignore_tile_edge)
+        np.testing.assert_array_equal(out_gt, out)
+
+        np.testing.assert_array_equal(geom_1m.pixel_positions(ignore_tile_edge=ignore_tile_edge),
+                                      geom.pixel_positions(ignore_tile_edge=ignore_tile_edge))
+
+    def testInvalidTiles(self):
+        tile = GeometryTile(module=0, origin=(0, 0), shape=(4, 4), corner=(0, 0),
+                            fs_vec=(1, 0), ss_vec=(0, 1))
+        GenericGeometryFast(1, (4, 4), [tile])
+
+        with pytest.raises(ValueError, match="out of range"):
+            GenericGeometryFast(1, (4, 4), [GeometryTile(
+                module=1, origin=(0, 0), shape=(4, 4), corner=(0, 0), fs_vec=(1, 0), ss_vec=(0, 1))])
+
+        with pytest.raises(ValueError, match="does not fit"):
+            GenericGeometryFast(1, (4, 4), [GeometryTile(
+                module=0, origin=(1, 0), shape=(4, 4), corner=(0, 0), fs_vec=(1, 0), ss_vec=(0, 1))])
+
+        with pytest.raises(ValueError, match="snapped"):
+            GenericGeometryFast(1, (4, 4), [GeometryTile(
+                module=0, origin=(0, 0), shape=(4, 4), corner=(0, 0), fs_vec=(0.7, 0.7), ss_vec=(0, 1))])
+
+        with pytest.raises(ValueError, match="orthogonal"):
+            GenericGeometryFast(1, (4, 4), [GeometryTile(
+                module=0, origin=(0, 0), shape=(4, 4), corner=(0, 0), fs_vec=(1, 0), ss_vec=(-1, 0))])
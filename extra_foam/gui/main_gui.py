@@ -45,6 +45,7 @@ from ..logger import logger
 from ..utils import profiler
 from ..ipc import RedisConnection, RedisPSubscriber
 from ..pipeline import MpInQueue
+from ..pipeline.f_shmem import ImageReceiver
 from ..processes import shutdown_all
 from ..database import MonProxy
 
@@ -103,6 +104,7 @@ class MainGUI(QMainWindow):
         self._close_ev = close_ev
         self._input_update_ev = Event()
         self._input = MpInQueue(self._input_update_ev, pause_ev, close_ev)
+        self._image_receiver = ImageReceiver()
 
         self._pulse_resolved = config["PULSE_RESOLVED"]
         self._require_geometry = config["REQUIRE_GEOMETRY"]
@@ -348,10 +350,14 @@ class MainGUI(QMainWindow):
 
         try:
             processed = self._input.get()
-            self._queue.append(processed)
         except Empty:
             return
 
+        # the image stays in shared memory until the next one is received
+        if not self._image_receiver.receive(processed):
+            return
+        self._queue.append(processed)
+
         # clear the previous plots no matter what comes next
         # for w in self._plot_windows.keys():
         #     w.reset()
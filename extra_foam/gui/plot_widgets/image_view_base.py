@@ -82,7 +82,8 @@ class ImageViewF(QWidget):
         if hide_axis:
             self._plot_widget.hideAxis()
 
-        self._image_item = ImageItem()
+        # down-sample large images to the screen resolution
+        self._image_item = ImageItem(autoDownsample=True)
         self._plot_widget.addItem(self._image_item)
         self._image_item.mouse_moved_sgn.connect(self.onMouseMoved)
 
@@ -10,11 +10,12 @@ All rights reserved.
 import numpy as np
 
 from PyQt5.QtGui import QColor, QImage, QPainter, QPainterPath, QPicture
-from PyQt5.QtCore import pyqtSignal, pyqtSlot, QPoint, QRectF, Qt
+from PyQt5.QtCore import pyqtSignal, pyqtSlot, QPoint, QPointF, QRectF, Qt
 
 from .. import pyqtgraph as pg
 
 from ..misc_widgets import FColor
+from ...algorithms import nan_down_sample_image
 from ...config import config, MaskState
 from ...ipc import ImageMaskPub
 
@@ -31,6 +32,44 @@ class ImageItem(pg.ImageItem):
 
         self.drawing = False
 
+    def render(self):
+        """Override.
+
+        Down-sample a float image with the NaN-aware C++ kernel instead of
+        pyqtgraph.functions.downsample.
+        """
+        image = self.image
+        if not self.autoDownsample or image is None or image.ndim != 2 \
+                or image.dtype not in (np.float32, np.float64):
+            super().render()
+            return
+
+        o = self.mapToDevice(QPointF(0, 0))
+        x = self.mapToDevice(QPointF(1, 0))
+        y = self.mapToDevice(QPointF(0, 1))
+        if o is None:
+            # not in a view yet
+            rate = 1
+        else:
+            w = pg.Point(x - o).length()
+            h = pg.Point(y - o).length()
+            if w == 0 or h == 0:
+                self.qimage = None
+                return
+
+            # keep the resolution of the finer axis
+            rate = max(1, int(1.0 / max(w, h)))
+        self._lastDownsample = (rate, rate)
+
+        self.autoDownsample = False
+        if rate > 1:
+            self.image = nan_down_sample_image(image, rate)
+        try:
+            super().render()
+        finally:
+            self.image = image
+            self.autoDownsample = True
+
     def hoverEvent(self, ev):
         """Override."""
         if ev.isExit():
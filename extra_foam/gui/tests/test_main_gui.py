@@ -263,9 +263,7 @@ class TestMainGuiCtrl(unittest.TestCase):
     def testCorrelationCtrlWidget(self):
         from extra_foam.gui.ctrl_widgets.correlation_ctrl_widget import (
             _N_PARAMS, _DEFAULT_RESOLUTION)
-        from extra_foam.pipeline.processors.base_processor import (
-            SimplePairSequence, OneWayAccuPairSequence
-        )
+        from extra_foam.algorithms.history import HistoryBuffer
         USER_DEFINED_KEY = config["SOURCE_USER_DEFINED_CATEGORY"]
 
         widget = self.gui.correlation_ctrl_widget
@@ -332,19 +330,34 @@ class TestMainGuiCtrl(unittest.TestCase):
 
             # change resolution
             proc._reset = False
-            self.assertIsInstance(proc._correlation, SimplePairSequence)
-            self.assertIsInstance(proc._correlation_slave, SimplePairSequence)
+            # FOM and FOM slave are stored in the same history
+            self.assertIsInstance(proc._correlation, HistoryBuffer)
+            self.assertEqual(2, proc._correlation.n_columns)
+            self.assertEqual(0, proc._correlation.resolution)
+            proc._correlation.clear()
+            for i, x in enumerate([0., 0., 0.8, 0.8, 1.5, 1.5]):
+                proc._correlation.append(i, x, [i, -i])
+            self.assertEqual(0, proc._correlation.n_bins)
             widget._table.cellWidget(idx, 3).setText(str(1.0))
             proc.update()
             self.assertEqual(1.0, proc._resolution)
-            self.assertIsInstance(proc._correlation, OneWayAccuPairSequence)
-            self.assertIsInstance(proc._correlation_slave, OneWayAccuPairSequence)
-            # sequence type change will not have 'reset'
+            self.assertIsInstance(proc._correlation, HistoryBuffer)
+            self.assertEqual(1.0, proc._correlation.resolution)
+            # the history is re-binned instead of being reset
             self.assertFalse(proc._reset)
+            self.assertEqual(6, len(proc._correlation))
+            np.testing.assert_array_equal([4, 2], proc._correlation.binCount())
             widget._table.cellWidget(idx, 3).setText(str(2.0))
             proc.update()
             self.assertEqual(2.0, proc._resolution)
-            self.assertTrue(proc._reset)
+            self.assertIsInstance(proc._correlation, HistoryBuffer)
+            self.assertEqual(2.0, proc._correlation.resolution)
+            # the bins are merged
+            self.assertFalse(proc._reset)
+            self.assertEqual(6, len(proc._correlation))
+            np.testing.assert_array_equal([6], proc._correlation.binCount())
+            np.testing.assert_allclose([2.5], proc._correlation.binMean(0))
+            np.testing.assert_allclose([-2.5], proc._correlation.binMean(1))
 
             # test reset button
             proc._reset = False
@@ -16,7 +16,8 @@ import numpy as np
 from ..config import config, AnalysisType, PumpProbeMode
 
 from extra_foam.algorithms import (
-    intersection, movingAvgImageData, mask_image_data, nanmean_image_data
+    intersection, movingAvgImageData, mask_image_data, nanmean_image_data,
+    DarkAccumulatorFloat
 )
 
 
@@ -166,6 +167,98 @@ class RawImageData(MovingAverageArray):
         return self._data.ndim == 3
 
 
+class DarkData:
+    """Stores the running statistics of dark images.
+
+    Only the per-pixel mean, M2 and number of valid values are kept, so the
+    memory does not grow with the number of recorded trains. NaN values are
+    ignored. The average is returned as a read-only view which is updated
+    in place, while the other quantities are calculated on request.
+    """
+
+    def __init__(self):
+        self._acc = DarkAccumulatorFloat()
+        self._ndim = None
+        self._mean_image = None  # cache
+
+    def __get__(self, instance, instance_type):
+        if instance is None:
+            return self
+
+        return self.mean
+
+    def __set__(self, instance, data):
+        if data is None:
+            self.reset()
+            return
+
+        data = np.asarray(data, dtype=np.float32)
+        if data.ndim != self._ndim:
+            # (y, x) and (1, y, x) cannot be accumulated together
+            self._acc.reset()
+            self._ndim = data.ndim
+        self._acc.update(data)
+        self._mean_image = None
+
+    def __delete__(self, instance):
+        self.reset()
+
+    def reset(self):
+        self._acc.reset()
+        self._ndim = None
+        self._mean_image = None
+
+    @property
+    def count(self):
+        return self._acc.count()
+
+    @property
+    def mean(self):
+        """Average of each memory cell."""
+        if self._acc.count() == 0:
+            return None
+
+        mean = self._acc.mean()
+        return mean[0] if self._ndim == 2 else mean
+
+    @property
+    def mean_image(self):
+        """Average over memory cells."""
+        if self._acc.count() == 0:
+            return None
+
+        if self._mean_image is None:
+            self._mean_image = self._acc.meanImage()
+        return self._mean_image
+
+    def std(self, ddof=0):
+        """Standard deviation of each memory cell."""
+        if self._acc.count() == 0:
+            return None
+
+        std = self._acc.stddev(ddof)
+        return std[0] if self._ndim == 2 else std
+
+    def nan_count(self):
+        """Number of NaN values received by each memory cell."""
+        if self._acc.count() == 0:
+            return None
+
+        count = self._acc.nanCount()
+        return count[0] if self._ndim == 2 else count
+
+    def bad_pixel_mask(self, lb, ub):
+        """Mask of pixels without valid value or with noise outside [lb, ub].
+
+        :param float lb: lower boundary of the standard deviation.
+        :param float ub: upper boundary of the standard deviation.
+        """
+        if self._acc.count() == 0:
+            return None
+
+        return self._acc.noiseMask(lb, ub)
+
+
 class DataItem:
     """Train-resolved data item.
 
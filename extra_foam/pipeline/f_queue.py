@@ -7,11 +7,14 @@ Author: Jun Zhu <jun.zhu@xfel.eu>
 Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
 All rights reserved.
 """
-from collections import deque, OrderedDict
+from collections import deque
 from queue import Empty, Full
 from threading import Lock
 
 from .data_model import ProcessedData
+from ..algorithms.correlator import (
+    CorrelationStatus, TrainCorrelator, MAX_SOURCES
+)
 from ..ipc import process_logger as logger
 from ..config import config
 
@@ -83,6 +86,10 @@ class CorrelateQueue(SimpleQueue):
     one can pop the data out of the queue only if all required data items
     are correlated.
 
+    The bookkeeping of the arrived sources is done by a native
+    TrainCorrelator, so that inserting a train, evicting an old train and
+    detecting a correlated train do not scan the cache.
+
     It has the same interface as the Python internal threading.Queue
     """
     _cache_size = config["CORRELATION_QUEUE_CACHE_SIZE"]
@@ -98,12 +105,34 @@ class CorrelateQueue(SimpleQueue):
 
         self._catalog = catalog
 
-        self._cached = OrderedDict()
+        # cached data of the pending trains
+        self._cached = dict()
+
+        self._correlator = None
+        # bit of each source item in the catalog
+        self._source_bits = dict()
 
         # keep the latest correlated data and tid
         self._correlated = None
         self._correlated_tid = -1
 
+    def _update_correlator(self):
+        """Recreate the correlator if the source items have changed.
+
+        :return TrainCorrelator: the correlator in use or None if the
+            catalog is empty.
+        """
+        sources = tuple(self._catalog)
+        if sources != tuple(self._source_bits):
+            self._cached.clear()
+            self._source_bits = {src: 1 << i for i, src in enumerate(sources)}
+            if len(sources) > MAX_SOURCES:
+                raise ValueError(f"Cannot correlate more than {MAX_SOURCES} "
+                                 f"source items!")
+            self._correlator = TrainCorrelator(len(sources), self._cache_size) \
+                if sources else None
+        return self._correlator
+
     def put(self, item, again=False):
         """Queue interface.
 
@@ -113,20 +142,45 @@ class CorrelateQueue(SimpleQueue):
         :param bool again: whether this item has been tried to put into
             the queue before.
         """
-        def _found_all(catalog, meta):
-            for k in catalog:
-                if k not in meta:
-                    return False
-            return True
-
         new_meta, new_raw = item['meta'], item['raw']
         if len(new_meta) == 0:
             return
 
         catalog = self._catalog
+        correlator = self._update_correlator()
 
         tid = next(iter(new_meta.values()))["tid"]
-        if tid > self._correlated_tid:
+        source_bits = self._source_bits
+        sources = 0
+        for src in new_meta:
+            sources |= source_bits.get(src, 0)
+
+        if correlator is None:
+            # nothing to correlate
+            status = CorrelationStatus.CORRELATED \
+                if tid > self._correlated_tid else CorrelationStatus.LATE
+            result = None
+        elif sources == 0:
+            # none of the sources is required, e.g. the data of a source
+            # which is not in the catalog
+            status = CorrelationStatus.LATE \
+                if tid <= self._correlated_tid else CorrelationStatus.PENDING
+            result = None
+        else:
+            result = correlator.put(tid, sources)
+            status = result.status
+
+        if result is not None and result.evicted:
+            self._evict(result.evicted_tid)
+
+        if status == CorrelationStatus.LATE:
+            # the train can no longer be correlated
+            self._cached.pop(tid, None)
+            if not again:
+                logger.warning(f"Train ID of the new item: {tid} is smaller "
+                               f"than the previous correlated train ID "
+                               f"{self._correlated_tid}")
+        else:
             # update cached data
             cached = self._cached.setdefault(
                 tid, {'meta': dict(), 'raw': dict()})
@@ -137,7 +191,10 @@ class CorrelateQueue(SimpleQueue):
             cached_meta.update(new_meta)
             cached_raw.update(new_raw)
 
-            if _found_all(catalog, cached_meta):
+            if status == CorrelationStatus.CORRELATED:
+                # the older pending trains can no longer be correlated
+                for k in [k for k in self._cached if k <= tid]:
+                    del self._cached[k]
                 self._correlated = {
                     'catalog': catalog.__copy__(),
                     'meta': cached_meta,
@@ -146,27 +203,22 @@ class CorrelateQueue(SimpleQueue):
                 }
                 self._correlated_tid = tid
 
-                while True:
-                    # delete old data
-                    key, _ = self._cached.popitem(last=False)
-                    if key == tid:
-                        break
-        else:
-            if not again:
-                logger.warning(f"Train ID of the new item: {tid} is smaller "
-                               f"than the previous correlated train ID "
-                               f"{self._correlated_tid}")
+        if len(self._cached) > self._cache_size:
+            # Stale trains and trains without any of the required sources
+            # are not evicted by the correlator.
+            self._evict(min(self._cached))
 
         if self._correlated is not None:
             # just correlated or the following line raises Full
             super().put(self._correlated)
             self._correlated = None
 
-        if len(self._cached) > self._cache_size:
-            k, v = self._cached.popitem(last=False)
-            msg = f"Failed to correlate all the source items for train {k}! "
+    def _evict(self, tid):
+        v = self._cached.pop(tid, None)
+        if v is not None and tid > self._correlated_tid:
+            msg = f"Failed to correlate all the source items for train {tid}! "
             logger.warning(msg + f"{len(v['meta'])} out of "
-                                 f"{len(catalog)} are available.")
+                                 f"{len(self._catalog)} are available.")
 
     def put_nowait(self, item, again=False):
         self.put(item, again=again)
@@ -174,6 +226,8 @@ class CorrelateQueue(SimpleQueue):
     def clear(self):
         """Override."""
         self._cached.clear()
+        if self._correlator is not None:
+            self._correlator.reset()
         self._correlated = None
         self._correlated_tid = -1
         super().clear()
@@ -0,0 +1,248 @@
+"""
+Distributed under the terms of the BSD 3-Clause License.
+
+The full license is in the file LICENSE, distributed with this software.
+
+Author: Jun Zhu <jun.zhu@xfel.eu>
+Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+All rights reserved.
+"""
+from contextlib import contextmanager
+import copy
+import os
+
+import numpy as np
+
+from ..algorithms.ring_buffer import RingBufferHandle, SharedRingBuffer
+from ..ipc import process_logger as logger
+
+
+class TrainRingBuffer:
+    """Shared-memory ring buffer for passing train data between processes.
+
+    The producer writes the data of a train into a slot only once and
+    passes around the returned RingBufferHandle instead of the data, e.g.
+    via a multiprocessing queue. Consumers in other processes (workers,
+    GUI, web monitor) attach to the buffer by name and map numpy views
+    onto the slot without copying.
+
+    A slot held by a consumer is never overwritten. Otherwise, the oldest
+    train is overwritten by the producer, which never waits for consumers.
+    The slots held by consumers which died are recovered by the producer
+    once all the slots are held.
+    """
+    def __init__(self, name, *, n_slots=None, slot_size=None):
+        """Initialization.
+
+        :param str name: name of the shared memory, e.g. "/foam_pulse".
+        :param int n_slots: number of slots. If both n_slots and slot_size
+            are None, it attaches to an existing ring buffer.
+        :param int slot_size: capacity (in bytes) of each slot.
+        """
+        if n_slots is None and slot_size is None:
+            self._buffer = SharedRingBuffer(name)
+        elif n_slots is None or slot_size is None:
+            raise ValueError("'n_slots' and 'slot_size' must be specified "
+                             "together!")
+        else:
+            self._buffer = SharedRingBuffer(name, n_slots, slot_size)
+
+    @property
+    def name(self):
+        return self._buffer.name
+
+    @property
+    def owner(self):
+        return self._buffer.owner
+
+    @property
+    def n_slots(self):
+        return self._buffer.n_slots
+
+    @property
+    def slot_size(self):
+        return self._buffer.slot_size
+
+    def put(self, tid, arr):
+        """Copy an array into a slot and publish it.
+
+        :param int tid: train ID.
+        :param numpy.ndarray arr: a C-contiguous array.
+
+        :return RingBufferHandle: handle of the published slot.
+        """
+        return self._buffer.write(tid, arr)
+
+    def claim(self, shape, dtype):
+        """Claim a slot for writing in place.
+
+        :param tuple shape: shape of the data.
+        :param numpy.dtype dtype: data type of the data.
+
+        :return numpy.ndarray: a writable view of the slot, which must be
+            passed to publish() once it has been filled.
+        """
+        return self._buffer.claim(shape, dtype)
+
+    def publish(self, tid, arr):
+        """Publish the claimed slot.
+
+        :param int tid: train ID.
+        :param numpy.ndarray arr: the array returned by claim().
+
+        :return RingBufferHandle: handle of the published slot.
+        """
+        return self._buffer.publish(tid, arr)
+
+    def abandon(self):
+        """Give up the claimed slot."""
+        self._buffer.abandon()
+
+    def latest(self):
+        """Return the handle of the latest train or None."""
+        return self._buffer.latest()
+
+    def valid(self, handle):
+        """Whether the train of the handle is still in the buffer."""
+        return self._buffer.valid(handle)
+
+    def hold(self, handle):
+        """Hold the slot of a handle and map a read-only view onto it.
+
+        The view must not be used after the slot has been released.
+
+        :raise LookupError: if the train has already been overwritten.
+        """
+        if not self._buffer.acquire(handle):
+            raise LookupError(f"Train {handle.tid} has been overwritten!")
+        return self._buffer.view(handle)
+
+    def release(self, handle):
+        """Release a slot held by hold()."""
+        self._buffer.release(handle)
+
+    def recover(self):
+        """Release the slots held by consumers which no longer exist.
+
+        :return int: number of the released holds.
+        """
+        return self._buffer.recover()
+
+    def n_holders(self, slot):
+        """Number of holds of a slot."""
+        return self._buffer.n_holders(slot)
+
+    @contextmanager
+    def get(self, handle):
+        """Map a read-only view onto the slot of a handle.
+
+        The slot is held within the context. Therefore, the view must not
+        be used outside of it.
+
+        :raise LookupError: if the train has already been overwritten.
+        """
+        view = self.hold(handle)
+        try:
+            yield view
+        finally:
+            self.release(handle)
+
+
+class SharedImage:
+    """Reference to an image in a TrainRingBuffer.
+
+    It is sent in place of the image itself.
+    """
+    __slots__ = ['name', 'handle']
+
+    def __init__(self, name, handle):
+        self.name = name
+        self.handle = handle
+
+
+class ImageSender:
+    """Send the average image of the processed data via shared memory.
+
+    The image is written into a TrainRingBuffer owned by the sender and
+    only a SharedImage is pickled. The ring buffer is re-created whenever
+    the image no longer fits into a slot.
+    """
+    def __init__(self, n_slots):
+        """Initialization.
+
+        :param int n_slots: number of slots. The image is pickled as
+            usual if it is 0.
+        """
+        self._n_slots = n_slots
+        self._prefix = f"/foam_image_{os.getpid()}"
+        self._generation = 0
+        self._buffer = None
+
+    def send(self, processed):
+        """Return the processed data to be sent.
+
+        The processed data are not modified since they can still be used
+        by other outputs.
+        """
+        image = processed.image.masked_mean
+        if self._n_slots == 0 or not isinstance(image, np.ndarray):
+            return processed
+
+        image = np.ascontiguousarray(image)
+        try:
+            if self._buffer is None or image.nbytes > self._buffer.slot_size:
+                self._buffer = None
+                self._generation += 1
+                self._buffer = TrainRingBuffer(
+                    f"{self._prefix}_{self._generation}",
+                    n_slots=self._n_slots, slot_size=image.nbytes)
+            handle = self._buffer.put(processed.tid, image)
+        except (RuntimeError, ValueError) as e:
+            logger.debug(f"Failed to put the image into shared memory: "
+                         f"{repr(e)}")
+            return processed
+
+        out = copy.copy(processed)
+        out.image = copy.copy(processed.image)
+        out.image.masked_mean = SharedImage(self._buffer.name, handle)
+        return out
+
+
+class ImageReceiver:
+    """Receive the average image of the processed data via shared memory.
+
+    The slot of the latest image is held until the next one is received,
+    so the image is shown without copying it.
+    """
+    def __init__(self):
+        self._buffer = None
+        self._held = None
+
+    def receive(self, processed):
+        """Replace the SharedImage in the processed data with a view.
+
+        :return bool: False if the image has already been overwritten.
+        """
+        ref = processed.image.masked_mean
+        if not isinstance(ref, SharedImage):
+            return True
+
+        self.release()
+        try:
+            if self._buffer is None or self._buffer.name != ref.name:
+                self._buffer = None
+                self._buffer = TrainRingBuffer(ref.name)
+            processed.image.masked_mean = self._buffer.hold(ref.handle)
+        except (RuntimeError, LookupError):
+            # the ring buffer has been re-created or the slot overwritten
+            processed.image.masked_mean = None
+            return False
+
+        self._held = ref.handle
+        return True
+
+    def release(self):
+        """Release the slot of the latest image."""
+        if self._held is not None:
+            self._buffer.release(self._held)
+            self._held = None
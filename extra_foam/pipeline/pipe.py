@@ -14,6 +14,7 @@ import time
 
 from .f_zmq import BridgeProxy, FoamZmqServer
 from .f_queue import CorrelateQueue, SimpleQueue
+from .f_shmem import ImageSender
 from .processors.base_processor import _RedisParserMixin
 from ..config import config, DataSource
 from ..utils import profiler, run_in_thread
@@ -281,11 +282,16 @@ class MpInQueue(_PipeInBase):
 
 
 class MpOutQueue(_PipeOutBase):
-    """A pipe which uses a multi-processing queue to dispatch data."""
+    """A pipe which uses a multi-processing queue to dispatch data.
+
+    The final pipe passes the average image via shared memory.
+    """
     def __init__(self, *args, **kwargs):
         super().__init__(*args, **kwargs)
 
         self._client = None
+        self._image_sender = ImageSender(
+            config["PIPELINE_SHMEM_N_SLOTS"] if self._final else 0)
 
     @run_in_thread(daemon=True)
     def run(self):
@@ -302,7 +308,7 @@ class MpOutQueue(_PipeOutBase):
                     data = self._cache.get_nowait()
 
                     if self._final:
-                        data_out = data['processed']
+                        data_out = self._image_sender.send(data['processed'])
 
                         tid = data_out.tid
                         self._mon.add_tid_with_timestamp(tid)
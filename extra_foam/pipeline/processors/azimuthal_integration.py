@@ -21,7 +21,9 @@ from ...config import AnalysisType, Normalizer
 from ...database import Metadata as mt
 from ...utils import profiler
 
-from extra_foam.algorithms import energy2wavelength, mask_image_data
+from extra_foam.algorithms import (
+    energy2wavelength, FoamAzimuthalIntegrator
+)
 
 
 class _AzimuthalIntegProcessorBase(_BaseProcessor):
@@ -138,7 +140,38 @@ class _AzimuthalIntegProcessorBase(_BaseProcessor):
 
 
 class AzimuthalIntegProcessorPulse(_AzimuthalIntegProcessorBase):
-    """Pulse-resolved azimuthal integration processor."""
+    """Pulse-resolved azimuthal integration processor.
+
+    The images of all the pulses are integrated by the native integrator
+    in a single parallel call. The pixel-to-bin map is cached until the
+    geometry, the image shape, the number of integration points or the
+    integration range changes. Pixels are not split, so that the
+    integration method is ignored.
+    """
+
+    def __init__(self):
+        super().__init__()
+
+        self._foam_integrator = None
+
+    def _update_foam_integrator(self):
+        integ = self._foam_integrator
+        if integ is None \
+                or integ.dist != self._sample_dist \
+                or integ.wavelength != self._wavelength \
+                or integ.poni1 != self._poni1 \
+                or integ.poni2 != self._poni2 \
+                or integ.pixel1 != self._pixel1 \
+                or integ.pixel2 != self._pixel2:
+            self._foam_integrator = FoamAzimuthalIntegrator(
+                dist=self._sample_dist,
+                poni1=self._poni1,
+                poni2=self._poni2,
+                pixel1=self._pixel1,
+                pixel2=self._pixel2,
+                wavelength=self._wavelength)
+
+        return self._foam_integrator
 
     @profiler("Azimuthal Integration Processor (Pulse)")
     def process(self, data):
@@ -148,35 +181,22 @@ class AzimuthalIntegProcessorPulse(_AzimuthalIntegProcessorBase):
         processed = data['processed']
         assembled = data['assembled']['sliced']
 
-        integrator = self._update_integrator()
-        integ1d = functools.partial(integrator.integrate1d,
-                                    method=self._integ_method,
-                                    radial_range=self._integ_range,
-                                    correctSolidAngle=True,
-                                    polarization_factor=1,
-                                    unit="q_A^-1")
-        integ_points = self._integ_points
+        integrator = self._update_foam_integrator()
 
         threshold_mask = processed.image.threshold_mask
+        if threshold_mask is None:
+            threshold_mask = (-np.inf, np.inf)
         image_mask = processed.image.image_mask
 
-        def _integrate1d_imp(i):
-            masked = assembled[i].copy()
-            mask = np.zeros_like(image_mask)
-            mask_image_data(masked,
-                            image_mask=image_mask,
-                            threshold_mask=threshold_mask,
-                            out=mask)
-            return integ1d(masked, integ_points, mask=mask)
-
-        intensities = []  # pulsed A.I.
-        with ThreadPoolExecutor(max_workers=4) as executor:
-            for i, ret in zip(range(len(assembled)),
-                              executor.map(_integrate1d_imp,
-                                           range(len(assembled)))):
-                if i == 0:
-                    momentum = ret.radial
-                intensities.append(ret.intensity)
+        # mask and threshold are applied on the fly without copying images
+        if image_mask is None:
+            momentum, intensities = integrator.integrate1d(
+                assembled, self._integ_points, self._integ_range,
+                threshold=threshold_mask)
+        else:
+            momentum, intensities = integrator.integrate1d(
+                assembled, self._integ_points, self._integ_range,
+                mask=image_mask, threshold=threshold_mask)
 
         # intensities = self._normalize_fom(
         #     processed, np.array(intensities), self._normalizer,
@@ -10,7 +10,6 @@ All rights reserved.
 import math
 
 import numpy as np
-from scipy import stats
 
 from .base_processor import _BaseProcessor, SimpleSequence, SimpleVectorSequence
 from ..exceptions import ProcessingError, UnknownParameterError
@@ -18,6 +17,7 @@ from ...database import Metadata as mt
 from ...config import AnalysisType, BinMode
 from ...utils import profiler
 from ...ipc import process_logger as logger
+from ...algorithms.binning import Binning1D, Binning2D, UniformBins
 
 
 class _BinMixin:
@@ -88,6 +88,10 @@ class BinningProcessor(_BaseProcessor, _BinMixin):
             shape = (_n_bins2, _n_bins1)
         _heat_count (numpy.array): count heatmap for 2D binning.
             shape = (_n_bins2, _n_bins1)
+        _binning1 (Binning1D): native 1D binning with param1. _stats1,
+            _counts1 and _vfom_heat1 are views of its result.
+        _binning2 (Binning2D): native 2D binning. _heat and _heat_count
+            are views of its result.
         _has_param1 (bool): True if both 'device ID' and 'property' are
             specified for param1.
         _has_param2 (bool): True if both 'device ID' and 'property' are
@@ -145,6 +149,9 @@ class BinningProcessor(_BaseProcessor, _BinMixin):
         self._heat = None
         self._heat_count = None
 
+        self._binning1 = None
+        self._binning2 = None
+
         # used to check whether pump-probe FOM is available
         self._pp_fail_flag = 0
 
@@ -367,30 +374,21 @@ class BinningProcessor(_BaseProcessor, _BinMixin):
             # there is no (FOM, etc.) data
             self._actual_range1 = (0, 0)
 
-        self._stats1, self._edges1, _ = \
-            stats.binned_statistic(self._slow1.data(),
-                                   self._fom.data(),
-                                   self._statistics(),
-                                   self._n_bins1,
-                                   self._actual_range1)
-        np.nan_to_num(self._stats1, copy=False)
-
-        if self._vfom is not None:
-            self._vfom_heat1, _, _ = \
-                stats.binned_statistic(self._slow1.data(),
-                                       self._vfom.data().T,
-                                       self._statistics(),
-                                       self._n_bins1,
-                                       self._actual_range1)
-            np.nan_to_num(self._vfom_heat1, copy=False)
-
-        self._counts1, _, _ = \
-            stats.binned_statistic(self._slow1.data(),
-                                   self._fom.data(),
-                                   'count',
-                                   self._n_bins1,
-                                   self._actual_range1)
-        np.nan_to_num(self._counts1, copy=False)
+        # The bin index of each data point is calculated only once and the
+        # columnar history is accumulated in a single pass.
+        vfom_size = 0 if self._vfom is None else self._vfom.size
+        binning = Binning1D(UniformBins(self._n_bins1, *self._actual_range1),
+                            self._statistics(),
+                            vfom_size)
+        binning.rebin(self._slow1.data(),
+                      self._fom.data(),
+                      None if self._vfom is None else self._vfom.data())
+
+        self._binning1 = binning
+        self._edges1 = binning.edges
+        self._stats1 = binning.stats
+        self._counts1 = binning.counts
+        self._vfom_heat1 = binning.vfom_heat
 
     def _init_vfom_binning(self, vfom, vfom_x):
         self._vfom = SimpleVectorSequence(
@@ -399,19 +397,8 @@ class BinningProcessor(_BaseProcessor, _BinMixin):
         self._vfom.append(vfom)
 
     def _update_1d_binning(self, fom, vfom, s1):
-        iloc = self.searchsorted(self._edges1, s1)
-        if 0 <= iloc < self._n_bins1:
-            self._counts1[iloc] += 1
-            count = self._counts1[iloc]
-            if self._mode == BinMode.ACCUMULATE:
-                self._stats1[iloc] += fom
-                if vfom is not None:
-                    self._vfom_heat1[:, iloc] += vfom
-            else:  # self._mode == BinMode.AVERAGE
-                self._stats1[iloc] += (fom - self._stats1[iloc]) / count
-                if vfom is not None:
-                    self._vfom_heat1[:, iloc] += \
-                        (vfom - self._vfom_heat1[:, iloc]) / count
+        binning = self._binning1
+        binning.update(s1, fom, vfom if binning.vfom_size > 0 else None)
 
     def _new_2d_binning(self):
         if self._actual_range2[0] is None:
@@ -419,40 +406,24 @@ class BinningProcessor(_BaseProcessor, _BinMixin):
             # there is no (FOM, etc.) data
             self._actual_range2 = (0, 0)
 
-        # Note: the return array from 'stats.binned_statistic_2d' has a swap x and y
-        # axis compared to conventional image data
-        self._heat, self._edges2, _, _ = \
-            stats.binned_statistic_2d(self._slow2.data(),
-                                      self._slow1.data(),
-                                      self._fom.data(),
-                                      self._statistics(),
-                                      [self._n_bins2, self._n_bins1],
-                                      [self._actual_range2, self._actual_range1])
-        np.nan_to_num(self._heat, copy=False)
-
-        self._heat_count, _, _, _ = \
-            stats.binned_statistic_2d(self._slow2.data(),
-                                      self._slow1.data(),
-                                      self._fom.data(),
-                                      'count',
-                                      [self._n_bins2, self._n_bins1],
-                                      [self._actual_range2, self._actual_range1])
-        np.nan_to_num(self._heat_count, copy=False)
+        # Note: the heatmap has a shape of (_n_bins2, _n_bins1)
+        binning = Binning2D(UniformBins(self._n_bins1, *self._actual_range1),
+                            UniformBins(self._n_bins2, *self._actual_range2),
+                            self._statistics())
+        binning.rebin(self._slow1.data(),
+                      self._slow2.data(),
+                      self._fom.data())
+
+        self._binning2 = binning
+        self._edges2 = binning.edges_y
+        self._heat = binning.heat
+        self._heat_count = binning.heat_count
 
     def _update_2d_binning(self, fom, s1, s2):
-        iloc_x = self.searchsorted(self._edges1, s1)
-        iloc_y = self.searchsorted(self._edges2, s2)
-        if 0 <= iloc_x < self._n_bins1 and 0 <= iloc_y < self._n_bins2:
-            self._heat_count[iloc_y, iloc_x] += 1
-            if self._mode == BinMode.ACCUMULATE:
-                self._heat[iloc_y, iloc_x] += fom
-            else:   # self._mode == BinMode.AVERAGE
-                self._heat[iloc_y, iloc_x] += \
-                    (fom - self._heat[iloc_y, iloc_x]) / \
-                    self._heat_count[iloc_y, iloc_x]
+        self._binning2.update(s1, s2, fom)
 
     def _statistics(self):
-        """Return the statistic mode string used in Scipy."""
+        """Return the statistic mode string used in the binning."""
         return 'sum' if self._mode == BinMode.ACCUMULATE else 'mean'
 
     def _clear_history(self):
@@ -467,6 +438,7 @@ class BinningProcessor(_BaseProcessor, _BinMixin):
         self._stats1 = None
         self._vfom_heat1 = None
         self._vfom_x1 = None
+        self._binning1 = None
 
         self._pp_fail_flag = 0
 
@@ -483,6 +455,7 @@ class BinningProcessor(_BaseProcessor, _BinMixin):
 
         self._heat = None
         self._heat_count = None
+        self._binning2 = None
 
     def _get_actual_range(self, data, bin_range, auto_range):
         # It is guaranteed that bin_range[0] < bin_range[1]
@@ -7,10 +7,11 @@ Author: Jun Zhu <jun.zhu@xfel.eu>
 Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
 All rights reserved.
 """
-from .base_processor import (
-    _BaseProcessor, SimplePairSequence, OneWayAccuPairSequence
-)
+import numpy as np
+
+from .base_processor import _BaseProcessor, _StatDataItem
 from ..exceptions import ProcessingError, UnknownParameterError
+from ...algorithms.history import HistoryBuffer
 from ...ipc import process_logger as logger
 from ...config import AnalysisType
 from ...database import Metadata as mt
@@ -24,17 +25,15 @@ class CorrelationProcessor(_BaseProcessor):
         _idx (int): Index of correlation starting from 1.
         analysis_type (AnalysisType): analysis type.
         _pp_analysis_type (AnalysisType): pump-probe analysis type.
-        _correlation (Sequence): pair sequences (SimplePairSequence,
-            OneWayAccuPairSequence) for storing the history of
-            (correlator, FOM).
-        _correlation_slave (Sequence): pair sequences (SimplePairSequence,
-            OneWayAccuPairSequence) for storing the history of
-            (correlator, FOM slave).
+        _correlation (HistoryBuffer): store the history of
+            (train ID, correlator, FOM, FOM slave) and, if the resolution
+            is non-zero, the statistics of the FOMs binned by correlator.
+            A missing FOM slave is stored as NaN.
         _source: source of slow data.
         _resolution: resolution of correlation.
         _reset: reset flag for correlation data.
-        _correlation_pp (SimplePairSequence): store the history of
-            (correlator, FOM) which is displayed in PumpProbeWindow.
+        _correlation_pp (HistoryBuffer): store the history of
+            (train ID, train ID, FOM) which is displayed in PumpProbeWindow.
         _pp_fail_flag (int): a flag used to check whether pump-probe FOM is
             available
     """
@@ -50,13 +49,12 @@ class CorrelationProcessor(_BaseProcessor):
         self.analysis_type = AnalysisType.UNDEFINED
         self._pp_analysis_type = AnalysisType.UNDEFINED
 
-        self._correlation = SimplePairSequence(max_len=self._MAX_POINTS)
-        self._correlation_slave = SimplePairSequence(max_len=self._MAX_POINTS)
+        self._correlation = HistoryBuffer(self._MAX_POINTS, 2)
         self._source = ""
         self._resolution = 0.0
         self._reset = False
 
-        self._correlation_pp = SimplePairSequence(max_len=self._MAX_POINTS)
+        self._correlation_pp = HistoryBuffer(self._MAX_POINTS, 1)
         self._pp_fail_flag = 0
 
     def update(self):
@@ -73,21 +71,10 @@ class CorrelationProcessor(_BaseProcessor):
             self._reset = True
 
         resolution = float(cfg[f'resolution{idx}'])
-        if self._resolution != 0 and resolution == 0:
-            self._correlation = SimplePairSequence(
-                max_len=self._MAX_POINTS)
-            self._correlation_slave = SimplePairSequence(
-                max_len=self._MAX_POINTS)
-        elif self._resolution == 0 and resolution != 0:
-            self._correlation = OneWayAccuPairSequence(
-                resolution, max_len=self._MAX_POINTS)
-            self._correlation_slave = OneWayAccuPairSequence(
-                resolution, max_len=self._MAX_POINTS)
-        elif self._resolution != resolution:
-            # In the above two cases, we do not need 'reset' since
-            # new Sequence object will be constructed.
-            self._reset = True
-        self._resolution = resolution
+        if self._resolution != resolution:
+            # the history is kept and re-binned with the new resolution
+            self._correlation.setResolution(resolution)
+            self._resolution = resolution
 
         reset_key = f'reset{idx}'
         if reset_key in cfg:
@@ -116,8 +103,7 @@ class CorrelationProcessor(_BaseProcessor):
                 self._pp_analysis_type = pp_analysis_type
 
         if self._reset:
-            self._correlation.reset()
-            self._correlation_slave.reset()
+            self._correlation.clear()
             self._reset = False
 
         try:
@@ -126,8 +112,8 @@ class CorrelationProcessor(_BaseProcessor):
             logger.error(f"[Correlation] {str(e)}!")
 
         out = processed.corr[self._idx - 1]
-        out.x, out.y = self._correlation.data()
-        out.x_slave, out.y_slave = self._correlation_slave.data()
+        (out.x, out.y), (out.x_slave, out.y_slave) = \
+            self._correlation_data()
         out.source = self._source
         out.resolution = self._resolution
 
@@ -143,13 +129,38 @@ class CorrelationProcessor(_BaseProcessor):
         pp = processed.pp
 
         if pp.reset:
-            self._correlation_pp.reset()
+            self._correlation_pp.clear()
 
         if pp.fom is not None:
-            self._correlation_pp.append((tid, pp.fom))
+            self._correlation_pp.append(tid, tid, [pp.fom])
 
         c = processed.corr.pp
-        c.x, c.y = self._correlation_pp.data()
+        c.x, c.y = self._correlation_pp.x(), self._correlation_pp.y(0)
+
+    def _correlation_data(self):
+        """Return the (x, y) pairs of FOM and FOM slave.
+
+        The pairs of FOM are views of the history. The pairs of FOM slave
+        only contain the trains or bins which have a FOM slave.
+        """
+        history = self._correlation
+        if history.resolution == 0:
+            x, y, y_slave = history.x(), history.y(0), history.y(1)
+            mask = ~np.isnan(y_slave)
+            return (x, y), (x[mask], y_slave[mask])
+
+        x = history.binX()
+        y, y_slave = self._bin_stats(0), self._bin_stats(1)
+        mask = y_slave.count > 0
+        return (x, y), (x[mask], _StatDataItem(*(v[mask] for v in y_slave)))
+
+    def _bin_stats(self, column):
+        history = self._correlation
+        avg = history.binMean(column)
+        # y_min and y_max store avg -/+ 0.5 * standard deviation
+        half_std = 0.5 * history.binStd(column)
+        return _StatDataItem(avg, avg - half_std, avg + half_std,
+                             history.binCount(column))
 
     def _update_data_point(self, processed, raw):
         analysis_type = self.analysis_type
@@ -190,6 +201,6 @@ class CorrelationProcessor(_BaseProcessor):
             logger.error(err)
 
         if v is not None:
-            self._correlation.append((v, fom))
-            if fom_slave is not None:
-                self._correlation_slave.append((v, fom_slave))
+            self._correlation.append(
+                processed.tid, v,
+                [fom, np.nan if fom_slave is None else fom_slave])
@@ -13,6 +13,8 @@ from .base_processor import _BaseProcessor
 from ..data_model import MovingAverageArray
 from ..exceptions import ProcessingError
 from ...database import Metadata as mt
+from ...algorithms import integrate_pulses
+from ...config import config
 from ...utils import profiler
 
 
@@ -42,6 +44,15 @@ class DigitizerProcessor(_BaseProcessor):
         'data.peaks': 'ADC'
     }
 
+    # raw waveforms, whose pulses are integrated in the pipeline
+    _raw_channels = {
+        'digitizers.channel_1_A.raw.samples': 'A',
+        'digitizers.channel_1_B.raw.samples': 'B',
+        'digitizers.channel_1_C.raw.samples': 'C',
+        'digitizers.channel_1_D.raw.samples': 'D',
+        'data.rawData': 'ADC'
+    }
+
     _pulse_integral_channels = {
         'A': "_pulse_integral_a_ma",
         'B': "_pulse_integral_b_ma",
@@ -96,26 +107,46 @@ class DigitizerProcessor(_BaseProcessor):
             device_id, ppt = src.split(' ')
             if ppt in self._integ_channels:
                 channel = self._integ_channels[ppt]
-                attr_name = self._pulse_integral_channels[channel]
-                self.__class__.__dict__[attr_name].__set__(self, np.array(
-                    arr[catalog.get_slicer(src)], dtype=np.float32))
-
-                processed.pulse.digitizer[channel].pulse_integral = \
-                    self.__class__.__dict__[attr_name].__get__(
-                        self, self.__class__)
-
-                # apply pulse filter
-                self.filter_pulse_by_vrange(
-                    self.__class__.__dict__[attr_name].__get__(
-                        self, self.__class__),
-                    catalog.get_vrange(src),
-                    processed.pidx,
-                    src)
-
-                # It is allowed to select only one digitizer channel
-                processed.pulse.digitizer.ch_normalizer = channel
+                pulse_integral = np.array(
+                    arr[catalog.get_slicer(src)], dtype=np.float32)
+            elif ppt in self._raw_channels:
+                channel = self._raw_channels[ppt]
+                # the raw samples are integrated in their own dtype
+                pulse_integral = self._integrate_pulses(
+                    arr)[catalog.get_slicer(src)]
             else:
                 # This is not UnknownParameterError since the property input
                 # by the user maybe a valid property for the digitizer device.
                 raise ProcessingError(
                     f'[Digitizer] Unknown property: {ppt}')
+
+            attr_name = self._pulse_integral_channels[channel]
+            self.__class__.__dict__[attr_name].__set__(self, pulse_integral)
+
+            processed.pulse.digitizer[channel].pulse_integral = \
+                self.__class__.__dict__[attr_name].__get__(
+                    self, self.__class__)
+
+            # apply pulse filter
+            self.filter_pulse_by_vrange(
+                self.__class__.__dict__[attr_name].__get__(
+                    self, self.__class__),
+                catalog.get_vrange(src),
+                processed.pidx,
+                src)
+
+            # It is allowed to select only one digitizer channel
+            processed.pulse.digitizer.ch_normalizer = channel
+
+    @staticmethod
+    def _integrate_pulses(waveform):
+        windows = config["DIGITIZER_PULSE_INTEGRATION"]
+        try:
+            return integrate_pulses(
+                np.asarray(waveform),
+                baseline=windows["BASELINE"],
+                pulse_start=windows["PULSE_START"],
+                pulse_period=windows["PULSE_PERIOD"],
+                pulse_width=windows["PULSE_WIDTH"])
+        except (TypeError, ValueError, IndexError) as e:
+            raise ProcessingError(f'[Digitizer] {repr(e)}')
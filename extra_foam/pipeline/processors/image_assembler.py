@@ -16,15 +16,18 @@ from extra_data import stack_detector_data
 
 from .base_processor import _RedisParserMixin
 from ..exceptions import AssemblingError
+from ...algorithms.modules_buffer import ModulesBuffer
 from ...config import config, GeomAssembler, DataSource
 from ...database import SourceCatalog
-from ...geometries import load_geometry
+from ...geometries import GenericGeometryFast, load_geometry
 from ...ipc import process_logger as logger
 
 
 _IMAGE_DTYPE = config['SOURCE_PROC_IMAGE_DTYPE']
 _RAW_IMAGE_DTYPE = config['SOURCE_RAW_IMAGE_DTYPE']
 _TRAIN_ID = SourceCatalog.TRAIN_ID
+# dtypes of the modules data which can be assembled without conversion
+_GEOM_SRC_DTYPES = (_IMAGE_DTYPE, np.uint16, np.int16, np.uint32)
 
 
 class ImageAssemblerFactory(ABC):
@@ -44,6 +47,10 @@ class ImageAssemblerFactory(ABC):
                 quadrants.
             _geom: geometry instance in use.
             _out_array (numpy.ndarray): buffer to store the assembled modules.
+            _stack_geom (GenericGeometryFast): geometry which stacks the
+                modules vertically, used if there is no geometry.
+            _modules_buffer (ModulesBuffer): persistent buffer to store the
+                data of the module sources received from the bridge.
         """
         def __init__(self):
             """Initialization."""
@@ -56,6 +63,8 @@ class ImageAssemblerFactory(ABC):
             self._quad_position = None
             self._geom = None
             self._out_array = None
+            self._stack_geom = None
+            self._modules_buffer = None
 
         @property
         def geometry(self):
@@ -108,6 +117,60 @@ class ImageAssemblerFactory(ABC):
             """Get modules data from file."""
             pass
 
+        def _get_module_bridge(self, module_data):
+            """Get the data of a single module source from bridge.
+
+            Required for detectors whose modules can arrive as separate
+            sources.
+
+            :return numpy.ndarray: a view of the module data with the
+                layout (memory cells, y, x).
+            """
+            raise NotImplementedError
+
+        def _stack_modules_bridge(self, data, src):
+            """Copy the data of all the module sources into a persistent buffer.
+
+            Each module is copied once, straight from the received payload,
+            into the buffer which is reused train after train. Missing
+            modules are filled with nan.
+
+            :param dict data: data of the module sources.
+            :param str src: source name with "*" in place of the module index.
+
+            -> (memory cells, modules, y, x)
+            """
+            src_name, ppt = src.split(' ')
+            prefix, suffix = src_name.split('*')
+
+            modules = dict()
+            for module_name, module_data in data.items():
+                idx = int(module_name[len(prefix):len(module_name) - len(suffix)])
+                modules[idx] = self._get_module_bridge(module_data[ppt])
+
+            n_pulses = {m.shape[0] for m in modules.values()}
+            if len(n_pulses) != 1:
+                raise ValueError(f"Modules have different memory cells: "
+                                 f"{sorted(n_pulses)}")
+
+            n_modules = config["NUMBER_OF_MODULES"]
+            module_shape = tuple(config["MODULE_SHAPE"])
+            if self._modules_buffer is None:
+                self._modules_buffer = ModulesBuffer(n_modules, *module_shape)
+
+            buffer = self._modules_buffer
+            buffer.reset(n_pulses.pop())
+            for idx, module_data in modules.items():
+                if module_data.shape[-2:] != module_shape:
+                    raise ValueError(f"Expected module shape {module_shape}, "
+                                     f"but get {module_data.shape[-2:]} "
+                                     f"instead!")
+                if module_data.dtype not in _GEOM_SRC_DTYPES:
+                    module_data = module_data.astype(_IMAGE_DTYPE)
+                buffer.setModule(idx, module_data)
+            buffer.fillMissing(np.nan)
+            return buffer.data
+
         def _load_geometry(self, filepath, quad_positions):
             """Load geometry from file.
 
@@ -167,11 +230,9 @@ class ImageAssemblerFactory(ABC):
 
                 return self._out_array
 
-            # temporary workaround for Pulse resolved JungFrau without geometry
+            # Pulse resolved JungFrau without geometry
             if config["DETECTOR"] == "JungFrauPR":
-                shape = modules.shape
-                # Stacking modules vertically along y axis.
-                return modules.reshape(shape[0], -1, shape[-1])
+                return self._assemble_stacked(modules)
 
             # For train-resolved detector, assembled is a reference
             # to the array data received from the pyzmq. This array data
@@ -181,6 +242,33 @@ class ImageAssemblerFactory(ABC):
             # FIXME: why once a while this takes a few ms???
             return modules.astype(image_dtype)
 
+        def _assemble_stacked(self, modules):
+            """Stack modules vertically along the y axis.
+
+            :param numpy.ndarray modules: modules data. shape = (memory cells,
+                modules, y, x)
+
+            :return numpy.ndarray assembled: stacked modules. shape =
+                (memory cells, modules * y, x)
+            """
+            n_pulses, n_modules = modules.shape[:2]
+            module_shape = modules.shape[-2:]
+            geom = self._stack_geom
+            if geom is None or geom.n_modules != n_modules \
+                    or tuple(geom.module_shape) != module_shape:
+                geom = GenericGeometryFast(n_modules, module_shape)
+                self._stack_geom = geom
+
+            shape = (n_pulses, *geom.assembledShape())
+            if self._out_array is None or self._out_array.shape != shape:
+                self._out_array = geom.output_array_for_position_fast(
+                    extra_shape=(n_pulses,), dtype=_IMAGE_DTYPE)
+
+            if modules.dtype not in _GEOM_SRC_DTYPES:
+                modules = modules.astype(_IMAGE_DTYPE)
+            geom.position_all_modules(modules, out=self._out_array)
+            return self._out_array
+
         def process(self, data):
             """Override."""
             meta = data['meta']
@@ -193,7 +281,11 @@ class ImageAssemblerFactory(ABC):
                 if src_type == DataSource.FILE:
                     modules_data = self._get_modules_file(raw, src)
                 elif src_type == DataSource.BRIDGE:
-                    modules_data = self._get_modules_bridge(raw, src)
+                    if isinstance(raw[src], dict):
+                        # modules arrive as separate sources
+                        modules_data = self._stack_modules_bridge(raw[src], src)
+                    else:
+                        modules_data = self._get_modules_bridge(raw, src)
                 else:
                     raise ValueError(f"Unknown source type: {src_type}")
 
@@ -262,6 +354,18 @@ class ImageAssemblerFactory(ABC):
             # (memory cells, modules, y, x)
             return modules_data
 
+        def _get_module_bridge(self, module_data):
+            """Override.
+
+            - calibrated, "image.data", (x, y, memory cells)
+            - raw, "image.data", (x, y, memory cells)
+            -> (memory cells, y, x)
+            """
+            if module_data.shape[0] == config["MODULE_SHAPE"][1]:
+                return np.transpose(module_data, (2, 1, 0))
+            # (memory cells, y, x)
+            return module_data
+
         def _get_modules_file(self, data, src):
             """Override.
 
@@ -300,6 +404,15 @@ class ImageAssemblerFactory(ABC):
             """
             return np.moveaxis(np.moveaxis(data[src], 3, 0), 3, 2)
 
+        def _get_module_bridge(self, module_data):
+            """Override.
+
+            - calibrated, "image.data", (x, y, memory cells)
+            - raw, "image.data", (x, y, memory cells)
+            -> (memory cells, y, x)
+            """
+            return np.transpose(module_data, (2, 1, 0))
+
         def _get_modules_file(self, data, src):
             """Override.
 
@@ -339,6 +452,15 @@ class ImageAssemblerFactory(ABC):
             """
             return np.moveaxis(np.moveaxis(data[src], 3, 0), 3, 2)
 
+        def _get_module_bridge(self, module_data):
+            """Override.
+
+            - calibrated, "image.data", (x, y, memory cells)
+            - raw, "image.data", (x, y, memory cells)
+            -> (memory cells, y, x)
+            """
+            return np.transpose(module_data, (2, 1, 0))
+
         def _get_modules_file(self, data, src):
             """Override.
 
@@ -11,7 +11,7 @@ import numpy as np
 
 from .base_processor import _BaseProcessor
 from .image_assembler import ImageAssemblerFactory
-from ..data_model import RawImageData
+from ..data_model import DarkData
 from ..exceptions import ImageProcessingError, ProcessingError
 from ...database import Metadata as mt
 from ...ipc import (
@@ -19,7 +19,7 @@ from ...ipc import (
 )
 from ...ipc import process_logger as logger
 from ...utils import profiler
-from ...config import config, _MAX_INT32
+from ...config import config
 
 from extra_foam.algorithms import (
     correct_image_data, mask_image_data, nanmean_image_data
@@ -35,7 +35,7 @@ class ImageProcessor(_BaseProcessor):
     Attributes:
         _require_geom (bool): whether a Geometry is required to assemble
             the detector modules.
-        _dark (RawImageData): store the moving average of dark
+        _dark (DarkData): store the running average of dark
             images in a train. Shape = (indices, y, x) for pulse-resolved
             and shape = (y, x) for train-resolved
         _correct_gain (bool): whether to apply gain correction.
@@ -71,7 +71,7 @@ class ImageProcessor(_BaseProcessor):
         _poi_indices (list): indices of POI pulses.
     """
 
-    _dark = RawImageData(_MAX_INT32)
+    _dark = DarkData()
 
     def __init__(self):
         super().__init__()
@@ -204,18 +204,14 @@ class ImageProcessor(_BaseProcessor):
         self._update_pois(image_data, sliced_assembled)
 
     def _record_dark(self, assembled):
-        if self._dark is None:
-            # _dark should not share the memory with
-            # data[src] since the latter will be dark subtracted.
-            self._dark = assembled.copy()
-        else:
-            # moving average (it reset the current moving average if the
-            # new dark has a different shape)
-            self._dark = assembled
+        # The statistics are accumulated in separate buffers, so _dark does
+        # not share the memory with data[src], which will be dark subtracted.
+        # It starts a new accumulation if the new dark has a different shape.
+        self._dark = assembled
 
         # For visualization of the dark:
         # FIXME: it would be better to calculate sliced dark mean.
-        self._dark_mean = nanmean_image_data(self._dark)
+        self._dark_mean = self.__class__._dark.mean_image
 
     def _update_image_mask(self, image_shape):
         try:
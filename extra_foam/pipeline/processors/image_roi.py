@@ -22,7 +22,7 @@ from ...utils import profiler
 from ...config import AnalysisType, Normalizer, RoiCombo, RoiFom, RoiProjType
 
 from extra_foam.algorithms import (
-    intersection, mask_image_data, nanstd, nanvar
+    intersection, nanmax, nanmin, nanstd, nanvar, roi_statistics, RoiStat
 )
 
 
@@ -45,8 +45,8 @@ class _RoiProcessorBase(_BaseProcessor):
         RoiFom.SUM: nansum,
         RoiFom.MEAN: nanmean,
         RoiFom.MEDIAN: np.nanmedian,
-        RoiFom.MAX: np.nanmax,
-        RoiFom.MIN: np.nanmin,
+        RoiFom.MAX: nanmax,
+        RoiFom.MIN: nanmin,
         RoiFom.STD: nanstd,
         RoiFom.VAR: nanvar,
         RoiFom.N_STD: functools.partial(nanstd, normalized=True),
@@ -116,10 +116,24 @@ class _RoiProcessorBase(_BaseProcessor):
 class ImageRoiPulse(_RoiProcessorBase):
     """Pulse-resolved ROI processor.
 
+    The statistics of all the required ROIs of all the pulses are calculated
+    in a single pass, with the image mask and the threshold mask applied on
+    the fly.
+
     Attributes:
         _geom1, _geom2, _geom3, _geom4 (list): ROI geometries.
     """
 
+    _fom_stats = {
+        RoiFom.SUM: int(RoiStat.SUM),
+        RoiFom.MEAN: int(RoiStat.MEAN),
+        RoiFom.MEDIAN: int(RoiStat.MEDIAN),
+        RoiFom.MAX: int(RoiStat.MAX),
+        RoiFom.MIN: int(RoiStat.MIN),
+        RoiFom.STD: int(RoiStat.STD),
+        RoiFom.VAR: int(RoiStat.VAR),
+    }
+
     def __init__(self):
         super().__init__()
 
@@ -155,26 +169,59 @@ class ImageRoiPulse(_RoiProcessorBase):
         roi.geom4.geometry = intersection(self._geom4, img_geom)
 
         if self._pulse_resolved:
-            self._process_norm(assembled, processed)
-            self._process_fom(assembled, processed)
+            stats = self._compute_roi_stats(assembled, processed)
+            self._process_norm(stats, processed)
+            self._process_fom(stats, processed)
             self._process_hist(processed)
 
-    def _compute_fom(self, roi, fom_type, image_mask, threshold_mask):
-        if roi is None:
+    def _compute_roi_stats(self, assembled, processed):
+        """Calculate the statistics of the required ROIs in one pass.
+
+        :return dict: statistics of each ROI with shape
+            (pulses, N_ROI_STATS). None for ROIs which are not required
+            or not available.
+        """
+        roi = processed.roi
+        required = []
+        if self._meta.has_analysis(AnalysisType.ROI_FOM_PULSE):
+            required.extend([(1, roi.geom1), (2, roi.geom2)])
+        if self._meta.has_analysis(AnalysisType.ROI_NORM_PULSE):
+            required.extend([(3, roi.geom3), (4, roi.geom4)])
+
+        # ROI.rect returns None in this case
+        required = [(i, geom) for i, geom in required
+                    if min(geom.geometry) >= 0]
+
+        stats = dict.fromkeys(range(1, 5))
+        if not required:
+            return stats
+
+        median_types = (self._fom_type, self._norm_type)
+        ret = roi_statistics(assembled,
+                             [geom.geometry for _, geom in required],
+                             image_mask=processed.image.image_mask,
+                             threshold_mask=processed.image.threshold_mask,
+                             with_median=RoiFom.MEDIAN in median_types)
+        for k, (i, _) in enumerate(required):
+            stats[i] = ret[:, k, :]
+        return stats
+
+    def _compute_fom(self, stats, fom_type):
+        if stats is None:
             return
 
+        if fom_type == RoiFom.N_STD:
+            return stats[:, int(RoiStat.STD)] / stats[:, int(RoiStat.MEAN)]
+        if fom_type == RoiFom.N_VAR:
+            return stats[:, int(RoiStat.VAR)] / stats[:, int(RoiStat.MEAN)] ** 2
+
         try:
-            handler = self._fom_handlers[fom_type]
+            return stats[:, self._fom_stats[fom_type]]
         except KeyError:
             raise UnknownParameterError(
                 f"[ROI][FOM] Unknown FOM type: {fom_type}")
 
-        mask_image_data(roi,
-                        image_mask=image_mask,
-                        threshold_mask=threshold_mask)
-        return handler(roi, axis=(-2, -1))
-
-    def _process_norm(self, assembled, processed):
+    def _process_norm(self, stats, processed):
         """Calculate pulse-resolved ROI normalizers.
 
         Always calculate.
@@ -182,27 +229,15 @@ class ImageRoiPulse(_RoiProcessorBase):
         if not self._meta.has_analysis(AnalysisType.ROI_NORM_PULSE):
             return
 
-        threshold_mask = processed.image.threshold_mask
-        image_mask = processed.image.image_mask
-
-        roi = processed.roi
-
-        roi3 = roi.geom3.rect(assembled)
-        mask3 = None if image_mask is None else roi.geom3.rect(image_mask)
-        roi4 = roi.geom4.rect(assembled)
-        mask4 = None if image_mask is None else roi.geom4.rect(image_mask)
-
         if self._norm_combo == RoiCombo.ROI3:
             processed.pulse.roi.norm = self._compute_fom(
-                roi3, self._norm_type, mask3, threshold_mask)
+                stats[3], self._norm_type)
         elif self._norm_combo == RoiCombo.ROI4:
             processed.pulse.roi.norm = self._compute_fom(
-                roi4, self._norm_type, mask4, threshold_mask)
+                stats[4], self._norm_type)
         else:
-            norm3 = self._compute_fom(
-                roi3, self._norm_type, mask3, threshold_mask)
-            norm4 = self._compute_fom(
-                roi4, self._norm_type, mask4, threshold_mask)
+            norm3 = self._compute_fom(stats[3], self._norm_type)
+            norm4 = self._compute_fom(stats[4], self._norm_type)
             if norm3 is not None and norm4 is not None:
                 if self._norm_combo == RoiCombo.ROI3_SUB_ROI4:
                     processed.pulse.roi.norm = norm3 - norm4
@@ -218,7 +253,7 @@ class ImageRoiPulse(_RoiProcessorBase):
         #       check whether they have activated and set a valid ROI region
         #       when they need ROI information in their analysis.
 
-    def _process_fom(self, assembled, processed):
+    def _process_fom(self, stats, processed):
         """Calculate pulse-resolved ROI FOMs.
 
         Always calculate.
@@ -226,27 +261,15 @@ class ImageRoiPulse(_RoiProcessorBase):
         if not self._meta.has_analysis(AnalysisType.ROI_FOM_PULSE):
             return
 
-        threshold_mask = processed.image.threshold_mask
-        image_mask = processed.image.image_mask
-
-        roi = processed.roi
-
-        roi1 = roi.geom1.rect(assembled)
-        mask1 = None if image_mask is None else roi.geom1.rect(image_mask)
-        roi2 = roi.geom2.rect(assembled)
-        mask2 = None if image_mask is None else roi.geom2.rect(image_mask)
-
         if self._fom_combo == RoiCombo.ROI1:
             processed.pulse.roi.fom = self._compute_fom(
-                roi1, self._fom_type, mask1, threshold_mask)
+                stats[1], self._fom_type)
         elif self._fom_combo == RoiCombo.ROI2:
             processed.pulse.roi.fom = self._compute_fom(
-                roi2, self._fom_type, mask2, threshold_mask)
+                stats[2], self._fom_type)
         else:
-            fom1 = self._compute_fom(
-                roi1, self._fom_type, mask1, threshold_mask)
-            fom2 = self._compute_fom(
-                roi2, self._fom_type, mask2, threshold_mask)
+            fom1 = self._compute_fom(stats[1], self._fom_type)
+            fom2 = self._compute_fom(stats[2], self._fom_type)
             if fom1 is not None and fom2 is not None:
                 if self._fom_combo == RoiCombo.ROI1_SUB_ROI2:
                     processed.pulse.roi.fom = fom1 - fom2
@@ -15,7 +15,9 @@ from ...config import AnalysisType, PumpProbeMode
 from ...database import Metadata as mt
 from ...utils import profiler
 
-from extra_foam.algorithms import mask_image_data, nanmean_image_data
+from extra_foam.algorithms import (
+    mask_image_data, nanmean_image_data, nanmean_on_off_image_data
+)
 
 
 class PumpProbeProcessor(_BaseProcessor):
@@ -195,7 +197,15 @@ class PumpProbeProcessor(_BaseProcessor):
                     if not indices_on:
                         raise DropAllPulsesError(
                             f"[Pump-probe] {tid}: all on pulses were dropped")
-                    image_on = nanmean_image_data(assembled, kept=indices_on)
+                    if mode == PumpProbeMode.SAME_TRAIN:
+                        if not indices_off:
+                            raise DropAllPulsesError(
+                                f"[Pump-probe] {tid}: all off pulses were dropped")
+                        # calculate the on and off images in a single pass
+                        image_on, image_off = nanmean_on_off_image_data(
+                            assembled, indices_on, indices_off)
+                    else:
+                        image_on = nanmean_image_data(assembled, kept=indices_on)
 
                     curr_indices.extend(indices_on)
                     curr_means.append(image_on)
@@ -228,10 +238,11 @@ class PumpProbeProcessor(_BaseProcessor):
 
                 else:
                     # train-resolved data does not have the mode 'SAME_TRAIN'
-                    if not indices_off:
-                        raise DropAllPulsesError(
-                            f"[Pump-probe] {tid}: all off pulses were dropped")
-                    image_off = nanmean_image_data(assembled, kept=indices_off)
+                    if image_off is None:
+                        if not indices_off:
+                            raise DropAllPulsesError(
+                                f"[Pump-probe] {tid}: all off pulses were dropped")
+                        image_off = nanmean_image_data(assembled, kept=indices_off)
                     curr_indices.extend(indices_off)
                     curr_means.append(image_off)
 
@@ -255,8 +266,10 @@ class PumpProbeProcessor(_BaseProcessor):
                         if not indices_on:
                             raise DropAllPulsesError(
                                 f"[Pump-probe] {tid}: all on pulses were dropped")
-                        self._prev_unmasked_on = nanmean_image_data(
-                            assembled, kept=indices_on)
+                        # A new array is needed for every on-train since the
+                        # on-image is sent downstream at the next off-train.
+                        self._prev_unmasked_on, _ = nanmean_on_off_image_data(
+                            assembled, indices_on, [])
                         curr_indices.extend(indices_on)
                         curr_means.append(self._prev_unmasked_on)
                     else:
@@ -97,3 +97,51 @@ class TestAzimuthalIntegProcessorTrain(_TestDataMixin):
             assert len(pp.x) == proc._integ_points
             assert len(pp.y) == proc._integ_points
             assert pp.fom is not None and pp.fom != 0
+
+
+class TestAzimuthalIntegProcessorPulse(_TestDataMixin):
+    @pytest.fixture(autouse=True)
+    def setUp(self):
+        proc = AzimuthalIntegProcessorPulse()
+
+        proc._sample_dist = 0.2
+        proc._pixel1 = 2e-4
+        proc._pixel2 = 2e-4
+        proc._poni1 = 0
+        proc._poni2 = 0
+        proc._wavelength = 5e-10
+
+        proc._integ_method = 'BBox'
+        proc._integ_range = (0, 0.2)
+        proc._integ_points = 64
+
+        proc._fom_integ_range = (-np.inf, np.inf)
+
+        self._proc = proc
+
+    def testAzimuthalIntegration(self):
+        proc = self._proc
+
+        shape = (4, 128, 64)
+        image_mask = np.zeros(shape[-2:], dtype=np.bool)
+        image_mask[:, ::2] = True
+        data, processed = self.data_with_assembled(1001, shape,
+                                                   image_mask=image_mask,
+                                                   threshold_mask=(0, 0.5))
+        with patch.object(proc._meta, 'has_analysis',
+                          side_effect=lambda x: True if x == AnalysisType.AZIMUTHAL_INTEG_PULSE else False):
+            proc.process(data)
+
+            ai = processed.pulse.ai
+            assert len(ai.x) == proc._integ_points
+            assert (shape[0], proc._integ_points) == ai.y.shape
+            assert not np.any(np.isnan(ai.y))
+            assert len(ai.fom) == shape[0]
+
+            # the integrator is reused until the geometry changes
+            integrator = proc._foam_integrator
+            proc.process(data)
+            assert integrator is proc._foam_integrator
+            proc._sample_dist = 0.3
+            proc.process(data)
+            assert integrator is not proc._foam_integrator
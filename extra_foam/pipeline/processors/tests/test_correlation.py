@@ -9,12 +9,11 @@ All rights reserved.
 """
 import pytest
 from unittest import mock
+from unittest.mock import MagicMock
 
 import numpy as np
 
-from extra_foam.pipeline.processors.correlation import (
-    CorrelationProcessor, SimplePairSequence, OneWayAccuPairSequence
-)
+from extra_foam.pipeline.processors.correlation import CorrelationProcessor
 
 from extra_foam.config import AnalysisType
 
@@ -54,10 +53,6 @@ class TestCorrelationProcessor(_TestDataMixin):
         proc = CorrelationProcessor(index+1)
         proc.analysis_type = analysis_type
 
-        proc._resolution = 0.0
-        proc._correlation = SimplePairSequence()
-        proc._correlation_slave = SimplePairSequence()
-
         # source is empty
         proc._source = ''
         empty_arr = np.array([], dtype=np.float64)
@@ -167,12 +162,75 @@ class TestCorrelationProcessor(_TestDataMixin):
         np.testing.assert_array_equal(np.array([1, 2], dtype=np.float64), corr[index].y_slave)
 
         # test reset
+        proc._correlation_pp.append(1000, 1000, [1])
         proc._reset = True
-        with mock.patch.object(proc._correlation_pp, "reset") as patched_reset:
+        proc.process(data)
+        np.testing.assert_array_equal(np.array([1], dtype=np.float64), corr[index].x)
+        np.testing.assert_array_equal(np.array([30], dtype=np.float64), corr[index].y)
+        np.testing.assert_array_equal(np.array([1], dtype=np.float64), corr[index].x_slave)
+        np.testing.assert_array_equal(np.array([2], dtype=np.float64), corr[index].y_slave)
+        # correlation_pp has another reset flag
+        assert 1 == len(proc._correlation_pp)
+
+    @pytest.mark.parametrize("index", [0, 1])
+    def testResolution(self, index):
+        data, processed = self.simple_data(1001, (2, 2))
+        corr = processed.corr
+
+        slow_src = f'A{index} ppt'
+        proc = CorrelationProcessor(index+1)
+        proc.analysis_type = AnalysisType.ROI_FOM
+        proc._source = slow_src
+
+        for v, fom, fom_slave in [(1, 10, None), (1, 20, 1), (1.05, 30, 2),
+                                  (2, 40, None), (2, 60, None), (3, 70, 4)]:
+            data['raw'] = {slow_src: v}
+            processed.roi.fom = fom
+            processed.roi.fom_slave = fom_slave
             proc.process(data)
-            np.testing.assert_array_equal(np.array([1], dtype=np.float64), corr[index].x)
-            np.testing.assert_array_equal(np.array([30], dtype=np.float64), corr[index].y)
-            np.testing.assert_array_equal(np.array([1], dtype=np.float64), corr[index].x_slave)
-            np.testing.assert_array_equal(np.array([2], dtype=np.float64), corr[index].y_slave)
-            # correlation_pp has another reset flag
-            patched_reset.assert_not_called()
+
+        cfg = {'analysis_type': str(int(AnalysisType.ROI_FOM)),
+               f'source{index+1}': slow_src}
+
+        # the history is binned instead of being reset
+        proc._meta.hget_all = MagicMock(
+            return_value={**cfg, f'resolution{index+1}': '0.1'})
+        proc.update()
+        assert not proc._reset
+        proc.process(data)
+        item = corr[index]
+        assert 0.1 == item.resolution
+        np.testing.assert_allclose([3.05 / 3, 2, 3], item.x)
+        np.testing.assert_allclose([20, 50, 70], item.y.avg)
+        np.testing.assert_allclose(
+            [20 - 0.5 * np.std([10, 20, 30]), 45, 70], item.y.min)
+        np.testing.assert_array_equal([3, 2, 2], item.y.count)
+        # the bin without FOM slave is excluded
+        np.testing.assert_allclose([3.05 / 3, 3], item.x_slave)
+        np.testing.assert_allclose([1.5, 4], item.y_slave.avg)
+        np.testing.assert_array_equal([2, 2], item.y_slave.count)
+
+        # the bins are merged
+        proc._meta.hget_all = MagicMock(
+            return_value={**cfg, f'resolution{index+1}': '2'})
+        proc.update()
+        proc.process(data)
+        item = corr[index]
+        np.testing.assert_allclose([np.mean([1, 1, 1.05, 2, 2, 3, 3, 3])],
+                                   item.x)
+        np.testing.assert_allclose([np.mean([10, 20, 30, 40, 60, 70, 70, 70])],
+                                   item.y.avg)
+        np.testing.assert_array_equal([8], item.y.count)
+        np.testing.assert_array_equal([5], item.y_slave.count)
+
+        # back to the history
+        proc._meta.hget_all = MagicMock(
+            return_value={**cfg, f'resolution{index+1}': '0'})
+        proc.update()
+        proc.process(data)
+        item = corr[index]
+        np.testing.assert_array_equal([1, 1, 1.05, 2, 2, 3, 3, 3, 3], item.x)
+        np.testing.assert_array_equal(
+            [10, 20, 30, 40, 60, 70, 70, 70, 70], item.y)
+        np.testing.assert_array_equal([1, 1.05, 3, 3, 3, 3], item.x_slave)
+        np.testing.assert_array_equal([1, 2, 4, 4, 4, 4], item.y_slave)
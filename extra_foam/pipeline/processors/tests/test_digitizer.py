@@ -17,6 +17,7 @@ from extra_foam.pipeline.tests import _TestDataMixin
 from extra_foam.pipeline.processors.digitizer import DigitizerProcessor
 from extra_foam.database import SourceItem
 from extra_foam.pipeline.exceptions import ProcessingError
+from extra_foam.config import config
 
 
 class TestDigitizer(_TestDataMixin, unittest.TestCase):
@@ -106,6 +107,57 @@ class TestDigitizer(_TestDataMixin, unittest.TestCase):
 
             self._reset_processed(processed)
 
+    def testRawWaveform(self):
+        data, processed = self.simple_data(1234, (2, 2))
+        meta = data['meta']
+        raw = data['raw']
+        catalog = data['catalog']
+
+        proc = DigitizerProcessor()
+        proc._meta.hdel = MagicMock()
+
+        windows = {
+            "BASELINE": (0, 10),
+            "PULSE_START": 20,
+            "PULSE_PERIOD": 30,
+            "PULSE_WIDTH": 10,
+        }
+        n_pulses = 4
+        waveform = np.full(140, 2, dtype=np.int16)
+        pulse_integral_gt = np.random.randint(-10, 10, size=n_pulses)
+        for i, v in enumerate(pulse_integral_gt):
+            waveform[20 + 30 * i] += v
+
+        for ch in itertools.chain(self._adq_channels, self._fastadc_channels):
+            if ch in self._adq_channels:
+                item = SourceItem('Digitizer', 'digitizer1:network', [],
+                                  f'digitizers.channel_1_{ch}.raw.samples',
+                                  slice(1, None), (-np.inf, np.inf))
+            else:
+                item = SourceItem('Digitizer', 'digitizer1:channel_2.output', [],
+                                  'data.rawData',
+                                  slice(1, None), (-np.inf, np.inf))
+            catalog.clear()
+            catalog.add_item(item)
+            src = f"{item.name} {item.property}"
+            meta[src] = {'tid': 12346}
+            raw[src] = waveform
+
+            with patch.dict(config._data,
+                            {"DIGITIZER_PULSE_INTEGRATION": windows}):
+                proc.process(data)
+            np.testing.assert_array_equal(
+                pulse_integral_gt[1:], processed.pulse.digitizer[ch].pulse_integral)
+            self.assertEqual(ch, processed.pulse.digitizer.ch_normalizer)
+
+            # windows which do not fit in the waveform
+            with patch.dict(config._data,
+                            {"DIGITIZER_PULSE_INTEGRATION": {**windows, "BASELINE": (0, 200)}}):
+                with self.assertRaises(ProcessingError):
+                    proc.process(data)
+
+            self._reset_processed(processed)
+
     def _reset_processed(self, processed):
         for ch in self._adq_channels:
             processed.pulse.digitizer[ch].pulse_integral = None
@@ -199,6 +199,49 @@ class TestAgipdAssembler:
         self._assembler.process(data)
         _check_assembled_result(data, src)
 
+    def testAssembleBridgeModules(self):
+        key_name = 'image.data'
+        src, catalog = self._create_catalog('SPB_DET_AGIPD1M-1/DET/*CH0:xtdf', key_name)
+
+        data = {
+            'catalog': catalog,
+            'meta': {
+                src: {
+                    'tid': 10001,
+                    'source_type': DataSource.BRIDGE,
+                }
+            },
+            'raw': {
+                src: {
+                    # (fs, ss, memory cells)
+                    'SPB_DET_AGIPD1M-1/DET/11CH0:xtdf':
+                        {key_name: np.ones((128, 512, 4), dtype=_IMAGE_DTYPE)},
+                    # (memory cells, ss, fs)
+                    'SPB_DET_AGIPD1M-1/DET/7CH0:xtdf':
+                        {key_name: 2 * np.ones((4, 512, 128), dtype=_RAW_IMAGE_DTYPE)},
+                }
+            },
+        }
+
+        self._assembler.process(copy.deepcopy(data))
+        modules = self._assembler._modules_buffer.data
+        assert (4, 16, 512, 128) == modules.shape
+        np.testing.assert_array_equal(np.ones((4, 512, 128)), modules[:, 11])
+        np.testing.assert_array_equal(2 * np.ones((4, 512, 128)), modules[:, 7])
+        assert np.isnan(modules[:, 0]).all()
+
+        # the buffer is reused
+        buffer = self._assembler._modules_buffer
+        processed = copy.deepcopy(data)
+        self._assembler.process(processed)
+        assert buffer is self._assembler._modules_buffer
+        _check_assembled_result(processed, src)
+
+        with pytest.raises(AssemblingError, match='different memory cells'):
+            data['raw'][src]['SPB_DET_AGIPD1M-1/DET/7CH0:xtdf'][key_name] = \
+                np.ones((5, 512, 128), dtype=_IMAGE_DTYPE)
+            self._assembler.process(data)
+
         # test single module
 
         # (modules, fs, ss, memory cells)
@@ -775,7 +818,8 @@ class TestJungfrauPulseResolvedAssembler(unittest.TestCase):
         self.assertTupleEqual(assembled.shape, (16, 512, 1024))
 
         # test multi-frame (16 here), two-modules JungFrau in new array shape
-        data['raw'][src] = np.ones((2, 512, 1024, 16))
+        modules = np.random.rand(2, 512, 1024, 16)
+        data['raw'][src] = modules
 
         temp = self._assembler._get_modules_bridge(data['raw'], src)
         self.assertTupleEqual(temp.shape, (16, 2, 512, 1024))
@@ -783,6 +827,9 @@ class TestJungfrauPulseResolvedAssembler(unittest.TestCase):
         self._assembler.process(data)
         assembled = data['assembled']['data']
         self.assertTupleEqual(assembled.shape, (16, 1024, 1024))
+        # modules are stacked vertically along the y axis
+        np.testing.assert_array_almost_equal(
+            np.moveaxis(modules, -1, 0).reshape(16, 1024, 1024), assembled)
 
         # test multi-frame, three-modules JungFrau
         with self.assertRaisesRegex(AssemblingError, 'Expected 1 or 2 module'):
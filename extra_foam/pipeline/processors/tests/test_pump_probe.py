@@ -407,6 +407,15 @@ class TestPumpProbeProcessorPr(_PumpProbeTestMixin, _TestDataMixin, unittest.Tes
         self.assertEqual(processed.pp.on.digitizer_pulse_integral, prev_dpi_on)
         self.check_digitizer(processed, 'off', [1, 3])
 
+        # the published on-image is not overwritten by the next on-train
+        image_on = processed.pp.image_on
+        image_on_gt = image_on.copy()
+        data, _ = self._gen_data(1004)  # on
+        data['assembled']['sliced'] += 1
+        proc.process(data)
+        self.assertIsNot(image_on, proc._prev_unmasked_on)
+        np.testing.assert_array_equal(image_on_gt, image_on)
+
         # --------------------
         # test pulse filtering
         # --------------------
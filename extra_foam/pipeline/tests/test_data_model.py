@@ -5,7 +5,7 @@ import numpy as np
 
 from extra_foam.pipeline.data_model import (
     PulseIndexMask, MovingAverageArray, MovingAverageScalar,
-    ImageData, ProcessedData, RawImageData
+    DarkData, ImageData, ProcessedData, RawImageData
 )
 from extra_foam.config import config
 
@@ -189,6 +189,88 @@ class TestRawImageData(unittest.TestCase):
         self.assertEqual(0, Dummy.data.count)
 
 
+class TestDarkData(unittest.TestCase):
+    def testTrainResolved(self):
+        class Dummy:
+            data = DarkData()
+
+        dm = Dummy()
+        self.assertIsNone(dm.data)
+        self.assertIsNone(Dummy.data.mean_image)
+        self.assertEqual(0, Dummy.data.count)
+
+        arr1 = np.ones((3, 3), dtype=np.float32)
+        arr1[0][2] = np.nan
+        arr2 = 3 * np.ones((3, 3), dtype=np.float32)
+        arr2[1][2] = np.nan
+        dm.data = arr1
+        dm.data = arr2
+        self.assertEqual(2, Dummy.data.count)
+
+        expected = 2 * np.ones((3, 3), dtype=np.float32)
+        # NaN is ignored
+        expected[0][2] = 3
+        expected[1][2] = 1
+        np.testing.assert_array_equal(expected, dm.data)
+        np.testing.assert_array_equal(expected, Dummy.data.mean_image)
+        expected_std = np.ones((3, 3), dtype=np.float32)
+        expected_std[0][2] = expected_std[1][2] = 0
+        np.testing.assert_array_almost_equal(expected_std, Dummy.data.std())
+        expected_nan = np.zeros((3, 3), dtype=np.uint32)
+        expected_nan[0][2] = expected_nan[1][2] = 1
+        np.testing.assert_array_equal(expected_nan, Dummy.data.nan_count())
+        np.testing.assert_array_equal(expected_std == 0, Dummy.data.bad_pixel_mask(0.5, 2))
+
+        # the returned average is a read-only view
+        with self.assertRaises(ValueError):
+            dm.data[0, 0] = 1
+
+        # set an image with a different shape
+        new_arr = 2 * np.ones((3, 1), dtype=np.float32)
+        dm.data = new_arr
+        self.assertEqual(1, Dummy.data.count)
+        np.testing.assert_array_equal(new_arr, dm.data)
+
+        del dm.data
+        self.assertIsNone(dm.data)
+        self.assertEqual(0, Dummy.data.count)
+
+    def testPulseResolved(self):
+        class Dummy:
+            data = DarkData()
+
+        dm = Dummy()
+
+        arr1 = np.random.randn(3, 4, 4).astype(np.float32)
+        arr2 = np.random.randn(3, 4, 4).astype(np.float32)
+        arr2[1][2][1] = np.nan
+        dm.data = arr1
+        mean_image = Dummy.data.mean_image
+        np.testing.assert_array_almost_equal(np.mean(arr1, axis=0), mean_image)
+        # the mean image is cached
+        self.assertIs(mean_image, Dummy.data.mean_image)
+
+        dm.data = arr2
+        data = np.stack([arr1, arr2])
+        self.assertEqual(2, Dummy.data.count)
+        np.testing.assert_array_almost_equal(np.nanmean(data, axis=0), dm.data)
+        np.testing.assert_array_almost_equal(np.nanstd(data, axis=0), Dummy.data.std())
+        np.testing.assert_array_almost_equal(np.nanstd(data, axis=0, ddof=1)[0], Dummy.data.std(ddof=1)[0])
+        np.testing.assert_array_almost_equal(
+            np.nanmean(np.nanmean(data, axis=0), axis=0), Dummy.data.mean_image)
+
+        # an image with a single memory cell is not train-resolved data
+        dm.data = arr1[:1]
+        self.assertEqual(1, Dummy.data.count)
+        dm.data = arr1[0]
+        self.assertEqual(1, Dummy.data.count)
+        self.assertEqual((4, 4), dm.data.shape)
+
+        dm.data = None
+        self.assertIsNone(dm.data)
+        self.assertIsNone(Dummy.data.std())
+
+
 class TestProcessedData(unittest.TestCase):
     def testGeneral(self):
         # ---------------------
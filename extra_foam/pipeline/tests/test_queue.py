@@ -128,3 +128,35 @@ class TestCorrelateQueue(unittest.TestCase):
             queue.put(data)
         warning.assert_called_once()
         self.assertEqual(cache_size(), len(queue._cached))
+
+    @patch('extra_foam.ipc.ProcessLogger.warning')
+    def testLateSources(self, warning):
+        catalog = self._create_catalog({"ABC": "a", "Motor": "b"})
+        queue = CorrelateQueue(catalog, maxsize=10)
+
+        queue.put(self._create_data(1001, {"ABC": "a"}))
+        queue.put(self._create_data(1002, {"ABC": "a", "Motor": "b"}))
+        self.assertEqual(1, queue.qsize())
+        warning.assert_not_called()
+        # the pending older train is dropped together with the correlated one
+        self.assertEqual(0, len(queue._cached))
+
+        # train 1001 can no longer be correlated
+        queue.put(self._create_data(1001, {"Motor": "b"}))
+        self.assertEqual(1, queue.qsize())
+        warning.assert_called_once()
+        self.assertNotIn(1001, queue._cached)
+        warning.reset_mock()
+
+        # the same item is put again after the queue was full
+        queue.put(self._create_data(1002, {"Motor": "b"}), again=True)
+        warning.assert_not_called()
+
+        self.assertEqual(1, queue._correlator.n_correlated)
+        self.assertEqual(2, queue._correlator.n_late)
+
+        queue.clear()
+        self.assertTrue(queue.empty())
+        self.assertEqual(0, queue._correlator.n_correlated)
+        queue.put(self._create_data(1001, {"ABC": "a", "Motor": "b"}))
+        self.assertEqual(1, queue.qsize())
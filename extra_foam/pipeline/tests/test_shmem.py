@@ -0,0 +1,176 @@
+import unittest
+import multiprocessing as mp
+import os
+import pickle
+
+import numpy as np
+
+from extra_foam.pipeline.data_model import ProcessedData
+from extra_foam.pipeline.f_shmem import (
+    ImageReceiver, ImageSender, RingBufferHandle, SharedImage, TrainRingBuffer
+)
+
+
+def _consume(name, handle, queue):
+    buffer = TrainRingBuffer(name)
+    with buffer.get(handle) as view:
+        queue.put((view.shape, view.dtype.str, float(view.sum())))
+
+
+def _die_holding(name, handle):
+    TrainRingBuffer(name).hold(handle)
+    os._exit(0)
+
+
+class TestTrainRingBuffer(unittest.TestCase):
+    def setUp(self):
+        self._name = f"/foam_test_shmem_{os.getpid()}"
+
+    def testGeneral(self):
+        with self.assertRaises(ValueError):
+            TrainRingBuffer(self._name, n_slots=2)
+
+        producer = TrainRingBuffer(self._name, n_slots=3, slot_size=1024)
+        self.assertTrue(producer.owner)
+        self.assertEqual(3, producer.n_slots)
+        self.assertEqual(1024, producer.slot_size)
+        self.assertIsNone(producer.latest())
+
+        consumer = TrainRingBuffer(self._name)
+        self.assertFalse(consumer.owner)
+
+        data = np.arange(24, dtype=np.float32).reshape(2, 3, 4)
+        handle = producer.put(1001, data)
+        self.assertEqual(1001, handle.tid)
+        self.assertEqual(handle.seq, consumer.latest().seq)
+
+        with consumer.get(handle) as view:
+            np.testing.assert_array_equal(data, view)
+            self.assertEqual(np.float32, view.dtype)
+            self.assertFalse(view.flags.writeable)
+
+        # the handle can be sent to another process
+        handle2 = pickle.loads(pickle.dumps(handle))
+        self.assertEqual((handle.slot, handle.seq, handle.tid),
+                         (handle2.slot, handle2.seq, handle2.tid))
+
+        with self.assertRaisesRegex(ValueError, "exceeds the slot size"):
+            producer.put(1002, np.ones(1000, dtype=np.float32))
+        with self.assertRaisesRegex(ValueError, "C-contiguous"):
+            producer.put(1002, data[:, :, ::2])
+
+        # overwritten
+        for tid in range(1002, 1005):
+            producer.put(tid, data)
+        self.assertFalse(consumer.valid(handle))
+        with self.assertRaisesRegex(LookupError, "overwritten"):
+            with consumer.get(handle):
+                pass
+
+    def testClaimAndPublish(self):
+        producer = TrainRingBuffer(self._name, n_slots=2, slot_size=1024)
+        consumer = TrainRingBuffer(self._name)
+
+        arr = producer.claim((4, 4), np.float64)
+        arr[:] = 2.
+        handle = producer.publish(1001, arr)
+        with consumer.get(handle) as view:
+            np.testing.assert_array_equal(np.full((4, 4), 2.), view)
+
+        arr = producer.claim((2, 2), np.float64)
+        with self.assertRaisesRegex(ValueError, "not a view of the claimed slot"):
+            producer.publish(1002, np.ones((2, 2)))
+        producer.abandon()
+
+        with self.assertRaisesRegex(ValueError, "exceeds the slot size"):
+            producer.claim((100, 100), np.float64)
+
+    def testMultiProcess(self):
+        producer = TrainRingBuffer(self._name, n_slots=4, slot_size=4096)
+        data = np.ones((4, 8, 8), dtype=np.float32)
+        handle = producer.put(1001, data)
+
+        queue = mp.Queue()
+        p = mp.Process(target=_consume, args=(self._name, handle, queue))
+        p.start()
+        shape, dtype, total = queue.get(timeout=10)
+        p.join()
+
+        self.assertEqual(data.shape, shape)
+        self.assertEqual(data.dtype.str, dtype)
+        self.assertEqual(data.sum(), total)
+
+    def testDeadConsumer(self):
+        producer = TrainRingBuffer(self._name, n_slots=2, slot_size=1024)
+        data = np.ones(16)
+        held = producer.put(1001, data)
+        handle = producer.put(1002, data)
+
+        p = mp.Process(target=_die_holding, args=(self._name, held))
+        p.start()
+        p.join()
+        self.assertEqual(1, producer.n_holders(held.slot))
+
+        consumer = TrainRingBuffer(self._name)
+        consumer.hold(handle)
+        # the slot held by the dead consumer is recovered
+        self.assertEqual(held.slot, producer.put(1003, data).slot)
+        self.assertEqual(0, producer.n_holders(held.slot))
+        consumer.release(handle)
+
+
+class TestImageSenderReceiver(unittest.TestCase):
+    def _processed(self, tid, shape):
+        processed = ProcessedData(tid)
+        processed.image.masked_mean = np.random.randn(*shape).astype(np.float32)
+        return processed
+
+    def testSendAndReceive(self):
+        sender = ImageSender(2)
+        receiver = ImageReceiver()
+
+        processed = self._processed(1001, (4, 8))
+        image = processed.image.masked_mean
+        out = sender.send(processed)
+        # the processed data are not modified
+        self.assertIs(image, processed.image.masked_mean)
+        self.assertEqual(1001, out.tid)
+        ref = out.image.masked_mean
+        self.assertIsInstance(ref, SharedImage)
+
+        out = pickle.loads(pickle.dumps(out))
+        self.assertTrue(receiver.receive(out))
+        view = out.image.masked_mean
+        np.testing.assert_array_equal(image, view)
+        self.assertFalse(view.flags.writeable)
+        self.assertEqual(1, sender._buffer.n_holders(ref.handle.slot))
+
+        # the previous image is released once a new one is received
+        out2 = pickle.loads(pickle.dumps(sender.send(self._processed(1002, (4, 8)))))
+        self.assertTrue(receiver.receive(out2))
+        self.assertEqual(0, sender._buffer.n_holders(ref.handle.slot))
+
+        # the ring buffer is re-created for a larger image
+        processed = self._processed(1003, (8, 8))
+        out3 = sender.send(processed)
+        self.assertNotEqual(ref.name, out3.image.masked_mean.name)
+        self.assertTrue(receiver.receive(out3))
+        np.testing.assert_array_equal(processed.image.masked_mean,
+                                      out3.image.masked_mean)
+        receiver.release()
+
+        # overwritten
+        out4 = sender.send(self._processed(1004, (8, 8)))
+        for tid in range(1005, 1008):
+            sender.send(self._processed(tid, (8, 8)))
+        self.assertFalse(receiver.receive(out4))
+        self.assertIsNone(out4.image.masked_mean)
+
+    def testPassThrough(self):
+        # the image is pickled
+        processed = self._processed(1001, (4, 8))
+        self.assertIs(processed, ImageSender(0).send(processed))
+
+        processed.image.masked_mean = None
+        self.assertIs(processed, ImageSender(2).send(processed))
+        self.assertTrue(ImageReceiver().receive(processed))
@@ -29,6 +29,9 @@ from .processors import (
     HistogramProcessor,
     XgmProcessor,
 )
+from ..algorithms import (
+    kernel_latency_stats, set_kernel_profiling, set_partition_config
+)
 from ..config import config, PipelineSlowPolicy
 from ..ipc import RedisConnection
 from ..ipc import process_logger as logger
@@ -68,6 +71,11 @@ class ProcessWorker(mp.Process):
 
         self._mon = MonProxy()
 
+        self._kernel_profiling = config["PIPELINE_KERNEL_PROFILING"]
+        self._numa = config["PIPELINE_NUMA"]
+        # the time when the kernel latencies were published
+        self._prev_profiling_time = None
+
     def _set_processors(self, opts):
         for opt in opts:
             args = ()
@@ -100,6 +108,13 @@ class ProcessWorker(mp.Process):
         if self._extension is not None:
             self._extension.start()
 
+        if self._kernel_profiling:
+            set_kernel_profiling(True)
+            self._prev_profiling_time = time.monotonic()
+
+        if self._numa:
+            set_partition_config(numa=True)
+
         data_out = None
         while not self.closing:
             if not self.running:
@@ -124,6 +139,9 @@ class ProcessWorker(mp.Process):
                 except Empty:
                     pass
 
+                if self._kernel_profiling:
+                    self._publish_kernel_latency()
+
             if data_out is not None:
                 sent = False
                 # TODO: still put the data but signal the data has been dropped.
@@ -175,6 +193,20 @@ class ProcessWorker(mp.Process):
                              repr(e))
                 logger.error(repr(e))
 
+    def _publish_kernel_latency(self):
+        """Publish the latencies of the C++ kernels since the last call.
+
+        The kernels are run in this process, so each worker has its own
+        statistics.
+        """
+        now = time.monotonic()
+        interval = 0.001 * config["PIPELINE_KERNEL_PROFILING_INTERVAL"]
+        if now - self._prev_profiling_time < interval:
+            return
+
+        self._mon.set_kernel_latency(self._name, kernel_latency_stats(reset=True))
+        self._prev_profiling_time = now
+
     @property
     def closing(self):
         return self._close_ev.is_set()
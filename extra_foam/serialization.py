@@ -10,6 +10,8 @@ All rights reserved.
 import struct
 import numpy as np
 
+from .algorithms.imageproc import BitMask
+from .algorithms.image_codec import decodeImages, encodeImages, ImageCodec
 from .config import config
 
 
@@ -18,14 +20,25 @@ if 'SOURCE_PROC_IMAGE_DTYPE' in config:
 else:
     _DEFAULT_DTYPE = np.float32
 
+_IMAGE_CODECS = {
+    'float32': ImageCodec.FLOAT32,
+    'float16': ImageCodec.FLOAT16,
+    'uint16': ImageCodec.UINT16,
+    'uint8': ImageCodec.UINT8,
+}
+
 
 def serialize_image(img, is_mask=False):
     """Serialize a single image.
 
-    :param numpy.ndarray img: a 2d numpy array.
+    :param numpy.ndarray/BitMask img: a 2d numpy array or a bit-packed
+        mask. The bytes of a bit-packed mask are sent as they are.
     :param bool is_mask: if True, it assumes that the input is
         a boolean array.
     """
+    if isinstance(img, BitMask):
+        return struct.pack('>II', *img.shape) + img.tobytes()
+
     if not isinstance(img, np.ndarray):
         raise TypeError(r"Input image must be a numpy.ndarray!")
 
@@ -40,19 +53,25 @@ def serialize_image(img, is_mask=False):
     return struct.pack('>II', *img.shape) + img.tobytes()
 
 
-def deserialize_image(data, dtype=_DEFAULT_DTYPE, is_mask=False):
+def deserialize_image(data, dtype=_DEFAULT_DTYPE, is_mask=False,
+                      packed=False):
     """Deserialize a single image.
 
     :param bytes data: serialized image bytes.
     :param type dtype: data type of the image.
     :param bool is_mask: if True, it assumes that the input is the buffer of
         a bit array.
+    :param bool packed: if True, a mask is returned as a BitMask without
+        being unpacked. Only used if is_mask is True.
 
-    :return: a 2d numpy array.
+    :return: a 2d numpy array or a BitMask.
     """
     offset = 8
     w, h = struct.unpack('>II', data[:offset])
 
+    if is_mask and packed:
+        return BitMask.frombytes(w, h, memoryview(data)[offset:])
+
     if is_mask:
         packed_bits = np.frombuffer(data, dtype=np.uint8, offset=offset)
         img = np.unpackbits(packed_bits)[:w*h].astype(np.bool, copy=False)
@@ -64,10 +83,16 @@ def deserialize_image(data, dtype=_DEFAULT_DTYPE, is_mask=False):
     return img
 
 
-def serialize_images(imgs):
+def serialize_images(imgs, codec=None):
     """Serialize an array of images.
 
     :param numpy.ndarray imgs: a 3d numpy array with shape (indices, y, x).
+    :param None/str codec: if given, the images are encoded for display,
+        i.e. quantized and compressed image by image. 'float32' is lossless.
+        'float16' keeps 11 significant bits. 'uint16' and 'uint8' quantize
+        each image between its finite minimum and maximum, and non-finite
+        pixels are decoded as NaN. Only float32 and float64 images can be
+        encoded.
     """
     if not isinstance(imgs, np.ndarray):
         raise TypeError(r"Input images must be a numpy.ndarray!")
@@ -75,17 +100,42 @@ def serialize_images(imgs):
     if imgs.ndim != 3:
         raise ValueError(f"The shape of image must be (indices, y, x)!")
 
-    return struct.pack('>III', *imgs.shape) + imgs.tobytes()
+    if codec is None:
+        return struct.pack('>III', *imgs.shape) + imgs.tobytes()
 
+    try:
+        image_codec = _IMAGE_CODECS[codec]
+    except KeyError:
+        raise ValueError(f"Unknown image codec: {codec}! "
+                         f"The valid codecs are: {list(_IMAGE_CODECS)}")
 
-def deserialize_images(data, dtype=_DEFAULT_DTYPE):
+    return struct.pack('>IIIB', *imgs.shape, int(image_codec)) + \
+        encodeImages(imgs, image_codec)
+
+
+def deserialize_images(data, dtype=_DEFAULT_DTYPE, encoded=False, out=None):
     """Deserialize an array of images.
 
     :param bytes data: serialized image bytes.
     :param type dtype: data type of the image.
+    :param bool encoded: True if the images were serialized with a codec.
+    :param None/numpy.ndarray out: array to store the decoded images. Only
+        used if encoded is True.
 
-    :return: a 3d numpy array with shape (indices, y, x)
+    :return: a 3d numpy array with shape (indices, y, x). Images which
+        were not encoded are returned as a view of the data.
     """
+    if encoded:
+        offset = 13
+        *shape, codec = struct.unpack('>IIIB', data[:offset])
+        if out is None:
+            out = np.empty(shape, dtype=dtype)
+        elif out.shape != tuple(shape):
+            raise ValueError(f"Output array has shape {out.shape}, "
+                             f"expected {tuple(shape)}!")
+        decodeImages(memoryview(data)[offset:], ImageCodec(codec), out)
+        return out
+
     offset = 12
     shape = struct.unpack('>III', data[:offset])
 
@@ -332,6 +332,14 @@ def application():
                         choices=[0, 1],
                         default=1,
                         type=int)
+    parser.add_argument('--profile_kernels',
+                        action='store_true',
+                        help="Record the latencies of the C++ kernels in "
+                             "the pipeline and publish them to Redis")
+    parser.add_argument('--numa',
+                        action='store_true',
+                        help="Split the pulses over the NUMA nodes in the "
+                             "C++ kernels of the pipeline")
     parser.add_argument("--redis_address",
                         help="Address of the Redis server",
                         default="127.0.0.1",
@@ -360,7 +368,9 @@ def application():
 
     # update global configuration
     config.load(detector, topic,
-                PIPELINE_SLOW_POLICY=PipelineSlowPolicy(args.pipeline_slow_policy))
+                PIPELINE_SLOW_POLICY=PipelineSlowPolicy(args.pipeline_slow_policy),
+                PIPELINE_KERNEL_PROFILING=args.profile_kernels,
+                PIPELINE_NUMA=args.numa)
 
     foam = Foam(redis_address=redis_address).init()
 
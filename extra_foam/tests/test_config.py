@@ -103,6 +103,13 @@ class TestConfig:
         for device_id, ppts in xgm_control_srcs.items():
             assert cfg.control_sources["XGM"][device_id] == ppts
 
+        # test pulse integration windows of digitizers were loaded
+        integ_cfg = cfg_from_file["DIGITIZER"]["PULSE_INTEGRATION"]
+        windows = cfg["DIGITIZER_PULSE_INTEGRATION"]
+        assert tuple(integ_cfg["BASELINE"]) == windows["BASELINE"]
+        for key in ["PULSE_START", "PULSE_PERIOD", "PULSE_WIDTH"]:
+            assert integ_cfg[key] == windows[key]
+
         os.remove(cfg.config_file)
 
     def testInvalidSourceCategory(self):
@@ -10,6 +10,8 @@ All rights reserved.
 import unittest
 
 import numpy as np
+
+from extra_foam.algorithms import BitMask
 from extra_foam.serialization import (
     serialize_image, deserialize_image, serialize_images, deserialize_images
 )
@@ -26,6 +28,8 @@ class TestSerialization(unittest.TestCase):
             serialize_images([[1, 2, 3], [4, 5, 6]])
         with self.assertRaises(ValueError):
             serialize_images(np.ones((2, 2)))
+        with self.assertRaises(ValueError):
+            serialize_images(np.ones((2, 2, 2)), codec='int8')
 
     def testGeneral(self):
         # test serializing and deserializing a single image
@@ -59,6 +63,16 @@ class TestSerialization(unittest.TestCase):
         self.assertEqual(orig_mask.shape, mask.shape)
         self.assertEqual(np.bool, mask.dtype)
 
+        # test serializing and deserializing a bit-packed mask
+        orig_mask = np.array([[1, 1, 0], [0, 1, 1]], dtype=np.bool)
+        bit_mask = BitMask(orig_mask)
+
+        mask_bytes = serialize_image(bit_mask)
+        self.assertEqual(serialize_image(orig_mask, is_mask=True), mask_bytes)
+        mask = deserialize_image(mask_bytes, is_mask=True)
+        np.testing.assert_array_equal(orig_mask, mask)
+        self.assertEqual(bit_mask, deserialize_image(mask_bytes, is_mask=True, packed=True))
+
         # test serializing and deserializing a group of images
         orig_imgs = np.array([[[1, 2], [3, 4]],
                               [[1, 2], [3, 4]]], dtype=np.int32)
@@ -69,3 +83,37 @@ class TestSerialization(unittest.TestCase):
         np.testing.assert_array_equal(orig_imgs, imgs)
         self.assertEqual(orig_imgs.shape, imgs.shape)
         self.assertEqual(np.float32, img.dtype)
+
+    def testEncodedImages(self):
+        orig_imgs = np.random.normal(100, 5, size=(4, 64, 100)).astype(np.float32)
+        orig_imgs[0, ::3, ::5] = np.nan
+        orig_imgs[1] = np.nan
+        orig_imgs[2] = 7.
+        finite = np.isfinite(orig_imgs)
+
+        for codec, atol in [('float32', 0), ('float16', 0.0625),
+                            ('uint16', 1e-3), ('uint8', 0.1)]:
+            imgs_bytes = serialize_images(orig_imgs, codec=codec)
+            self.assertLess(len(imgs_bytes), orig_imgs.nbytes)
+
+            imgs = deserialize_images(imgs_bytes, encoded=True)
+            self.assertEqual(orig_imgs.shape, imgs.shape)
+            self.assertEqual(np.float32, imgs.dtype)
+            np.testing.assert_array_equal(~finite, np.isnan(imgs))
+            np.testing.assert_allclose(orig_imgs[finite], imgs[finite], atol=atol)
+
+            # decode into a pre-allocated array
+            out = np.empty(orig_imgs.shape, dtype=np.float64)
+            self.assertIs(out, deserialize_images(imgs_bytes, encoded=True, out=out))
+            np.testing.assert_allclose(imgs, out, atol=1e-6)
+            with self.assertRaises(ValueError):
+                deserialize_images(imgs_bytes, encoded=True,
+                                   out=np.empty((4, 64, 99), dtype=np.float32))
+
+            # truncated stream
+            with self.assertRaises(ValueError):
+                deserialize_images(imgs_bytes[:-1], encoded=True)
+
+        # the quantized codecs are much smaller
+        self.assertLess(4 * len(serialize_images(orig_imgs, codec='uint8')),
+                        orig_imgs.nbytes)
@@ -97,6 +97,7 @@ class BuildExt(build_ext):
             self.xtensor_with_xsimd = strtobool(os.environ.get('XTENSOR_WITH_XSIMD', '1'))
 
         self.with_tests = strtobool(os.environ.get('BUILD_FOAM_TESTS', '0'))
+        self.with_benchmarks = strtobool(os.environ.get('BUILD_FOAM_BENCHMARKS', '0'))
 
     def run(self):
         try:
@@ -162,6 +163,11 @@ class BuildExt(build_ext):
         else:
             cmake_options.append('-DBUILD_FOAM_TESTS=OFF')
 
+        if self.with_benchmarks:
+            cmake_options.append('-DBUILD_FOAM_BENCHMARKS=ON')
+        else:
+            cmake_options.append('-DBUILD_FOAM_BENCHMARKS=OFF')
+
         # FIXME
         build_options = ['--', '-j4']
 
@@ -0,0 +1,135 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <limits>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "xtensor/xadapt.hpp"
+
+#include "f_azimuthal_integrator.hpp"
+#include "f_pyconfig.hpp"
+
+namespace py = pybind11;
+
+
+PYBIND11_MODULE(azimuthal_integrator, m)
+{
+  xt::import_numpy();
+
+  using foam::AzimuthalIntegrator;
+  using RangeType = AzimuthalIntegrator::RangeType;
+
+  m.doc() = "Azimuthal integration.";
+
+  foam::definePartitionConfig(m);
+
+  const RangeType no_threshold {-std::numeric_limits<double>::infinity(),
+                                std::numeric_limits<double>::infinity()};
+
+  py::class_<AzimuthalIntegrator> cls(m, "AzimuthalIntegrator");
+
+  cls.def(py::init<double, double, double, double, double, double, double>(),
+          py::arg("dist"), py::arg("poni1"), py::arg("poni2"), py::arg("pixel1"), py::arg("pixel2"),
+          py::arg("wavelength"), py::arg("polarization_factor") = 1.)
+    .def_property_readonly("dist", &AzimuthalIntegrator::dist)
+    .def_property_readonly("poni1", &AzimuthalIntegrator::poni1)
+    .def_property_readonly("poni2", &AzimuthalIntegrator::poni2)
+    .def_property_readonly("pixel1", &AzimuthalIntegrator::pixel1)
+    .def_property_readonly("pixel2", &AzimuthalIntegrator::pixel2)
+    .def_property_readonly("wavelength", &AzimuthalIntegrator::wavelength)
+    .def_property_readonly("polarization_factor", &AzimuthalIntegrator::polarizationFactor)
+    .def("qMap", [] (const AzimuthalIntegrator& self, std::size_t ny, std::size_t nx)
+    {
+      auto dst = xt::pytensor<double, 2>::from_shape({ny, nx});
+      {
+        py::gil_scoped_release release;
+        self.qMap(dst);
+      }
+      return dst;
+    }, py::arg("ny"), py::arg("nx"))
+    .def("setPixelPositions",
+         (void (AzimuthalIntegrator::*)(const xt::pytensor<int32_t, 4>&)) &AzimuthalIntegrator::setPixelPositions,
+         py::arg("positions").noconvert(), foam::release_gil());
+
+#define FOAM_INTEGRATE1D_IMP(VALUE_TYPE)                                                                    \
+  cls.def("integrate1d", [] (AzimuthalIntegrator& self, const xt::pytensor<VALUE_TYPE, 2>& src,            \
+                             std::size_t npt, const RangeType& radial_range,                                \
+                             const xt::pytensor<bool, 2>& mask, const RangeType& threshold)                 \
+  {                                                                                                         \
+    auto dst = xt::pytensor<VALUE_TYPE, 1>::from_shape({npt});                                              \
+    {                                                                                                       \
+      py::gil_scoped_release release;                                                                       \
+      self.integrate1d(src, mask, dst, radial_range, threshold);                                            \
+    }                                                                                                       \
+    return py::make_tuple(xt::pytensor<double, 1>(xt::adapt(self.radial())), dst);                         \
+  }, py::arg("src").noconvert(), py::arg("npt"), py::arg("radial_range"), py::arg("mask").noconvert(),      \
+     py::arg("threshold") = no_threshold);                                                                  \
+  cls.def("integrate1d", [] (AzimuthalIntegrator& self, const xt::pytensor<VALUE_TYPE, 2>& src,            \
+                             std::size_t npt, const RangeType& radial_range, const RangeType& threshold)    \
+  {                                                                                                         \
+    auto dst = xt::pytensor<VALUE_TYPE, 1>::from_shape({npt});                                              \
+    {                                                                                                       \
+      py::gil_scoped_release release;                                                                       \
+      self.integrate1d(src, dst, radial_range, threshold);                                                  \
+    }                                                                                                       \
+    return py::make_tuple(xt::pytensor<double, 1>(xt::adapt(self.radial())), dst);                         \
+  }, py::arg("src").noconvert(), py::arg("npt"), py::arg("radial_range"),                                   \
+     py::arg("threshold") = no_threshold);                                                                  \
+  cls.def("integrate1d", [] (AzimuthalIntegrator& self, const xt::pytensor<VALUE_TYPE, 3>& src,            \
+                             std::size_t npt, const RangeType& radial_range,                                \
+                             const xt::pytensor<bool, 2>& mask, const RangeType& threshold)                 \
+  {                                                                                                         \
+    auto dst = xt::pytensor<VALUE_TYPE, 2>::from_shape({static_cast<std::size_t>(src.shape()[0]), npt});   \
+    {                                                                                                       \
+      py::gil_scoped_release release;                                                                       \
+      self.integrate1d(src, mask, dst, radial_range, threshold);                                            \
+    }                                                                                                       \
+    return py::make_tuple(xt::pytensor<double, 1>(xt::adapt(self.radial())), dst);                         \
+  }, py::arg("src").noconvert(), py::arg("npt"), py::arg("radial_range"), py::arg("mask").noconvert(),      \
+     py::arg("threshold") = no_threshold);                                                                  \
+  cls.def("integrate1d", [] (AzimuthalIntegrator& self, const xt::pytensor<VALUE_TYPE, 3>& src,            \
+                             std::size_t npt, const RangeType& radial_range, const RangeType& threshold)    \
+  {                                                                                                         \
+    auto dst = xt::pytensor<VALUE_TYPE, 2>::from_shape({static_cast<std::size_t>(src.shape()[0]), npt});   \
+    {                                                                                                       \
+      py::gil_scoped_release release;                                                                       \
+      self.integrate1d(src, dst, radial_range, threshold);                                                  \
+    }                                                                                                       \
+    return py::make_tuple(xt::pytensor<double, 1>(xt::adapt(self.radial())), dst);                         \
+  }, py::arg("src").noconvert(), py::arg("npt"), py::arg("radial_range"),                                   \
+     py::arg("threshold") = no_threshold);                                                                  \
+  cls.def("integrate1d", [] (AzimuthalIntegrator& self, const xt::pytensor<VALUE_TYPE, 4>& src,            \
+                             std::size_t npt, const RangeType& radial_range,                                \
+                             const xt::pytensor<bool, 3>& mask, const RangeType& threshold)                 \
+  {                                                                                                         \
+    auto dst = xt::pytensor<VALUE_TYPE, 2>::from_shape({static_cast<std::size_t>(src.shape()[0]), npt});   \
+    {                                                                                                       \
+      py::gil_scoped_release release;                                                                       \
+      self.integrate1d(src, mask, dst, radial_range, threshold);                                            \
+    }                                                                                                       \
+    return py::make_tuple(xt::pytensor<double, 1>(xt::adapt(self.radial())), dst);                         \
+  }, py::arg("src").noconvert(), py::arg("npt"), py::arg("radial_range"), py::arg("mask").noconvert(),      \
+     py::arg("threshold") = no_threshold);                                                                  \
+  cls.def("integrate1d", [] (AzimuthalIntegrator& self, const xt::pytensor<VALUE_TYPE, 4>& src,            \
+                             std::size_t npt, const RangeType& radial_range, const RangeType& threshold)    \
+  {                                                                                                         \
+    auto dst = xt::pytensor<VALUE_TYPE, 2>::from_shape({static_cast<std::size_t>(src.shape()[0]), npt});   \
+    {                                                                                                       \
+      py::gil_scoped_release release;                                                                       \
+      self.integrate1d(src, dst, radial_range, threshold);                                                  \
+    }                                                                                                       \
+    return py::make_tuple(xt::pytensor<double, 1>(xt::adapt(self.radial())), dst);                         \
+  }, py::arg("src").noconvert(), py::arg("npt"), py::arg("radial_range"),                                   \
+     py::arg("threshold") = no_threshold);
+
+  FOAM_INTEGRATE1D_IMP(float)
+  FOAM_INTEGRATE1D_IMP(double)
+}
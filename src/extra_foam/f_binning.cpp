@@ -0,0 +1,196 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <vector>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/numpy.h"
+
+#include "xtensor/xtensor.hpp"
+
+#include "f_binning.hpp"
+#include "f_pyconfig.hpp"
+
+namespace py = pybind11;
+
+
+namespace
+{
+
+/**
+ * Return a read-only numpy view of the data owned by a binning object.
+ */
+py::array_t<double> readOnlyView(py::object owner, const std::vector<double>& data,
+                                 std::vector<py::ssize_t> shape)
+{
+  py::array_t<double> view(shape, data.data(), owner);
+  view.attr("setflags")(py::arg("write") = false);
+  return view;
+}
+
+/**
+ * Return a pointer to contiguous data. A copy is made in tmp if necessary.
+ */
+const double* contiguous(const xt::pytensor<double, 1>& arr, xt::xtensor<double, 1>& tmp)
+{
+  if (arr.strides()[0] == 1 || arr.size() <= 1) return arr.data() + arr.data_offset();
+  tmp = arr;
+  return tmp.data();
+}
+
+void checkHistorySize(std::size_t n, std::size_t expected, const char* name)
+{
+  if (n != expected)
+  {
+    std::stringstream ss;
+    ss << "History of " << name << " has " << n << " data points, expected " << expected;
+    throw std::invalid_argument(ss.str());
+  }
+}
+
+} // namespace
+
+
+PYBIND11_MODULE(binning, m)
+{
+  xt::import_numpy();
+
+  m.doc() = "Binning of FOM and VFOM with respect to slow data.";
+
+  foam::definePartitionConfig(m);
+
+  py::class_<foam::UniformBins>(m, "UniformBins")
+    .def(py::init<std::size_t, double, double>(), py::arg("n_bins"), py::arg("lb"), py::arg("ub"))
+    .def("index", &foam::UniformBins::index, py::arg("v"))
+    .def("__len__", &foam::UniformBins::size)
+    .def_property_readonly("edges", [] (const foam::UniformBins& self)
+    {
+      const auto& edges = self.edges();
+      return py::array_t<double>(static_cast<py::ssize_t>(edges.size()), edges.data());
+    });
+
+  using foam::Binning1D;
+
+  py::class_<Binning1D>(m, "Binning1D")
+    .def(py::init([] (const foam::UniformBins& bins, const std::string& statistic, std::size_t vfom_size)
+      {
+        return new Binning1D(bins, foam::toBinStatistic(statistic), vfom_size);
+      }), py::arg("bins"), py::arg("statistic"), py::arg("vfom_size") = 0)
+    .def("rebin", [] (Binning1D& self,
+                      const xt::pytensor<double, 1>& x,
+                      const xt::pytensor<double, 1>& fom,
+                      py::object vfom)
+    {
+      std::size_t n = x.size();
+      checkHistorySize(fom.size(), n, "FOM");
+
+      xt::xtensor<double, 1> x_tmp, fom_tmp;
+      const double* px = contiguous(x, x_tmp);
+      const double* pf = contiguous(fom, fom_tmp);
+
+      if (vfom.is_none())
+      {
+        py::gil_scoped_release release;
+        self.rebin(px, pf, n);
+        return;
+      }
+
+      // history of VFOM with shape (data points, VFOM size) in any memory layout
+      auto v = vfom.cast<xt::pytensor<double, 2>>();
+      checkHistorySize(v.shape()[0], n, "VFOM");
+      if (v.shape()[1] != self.vfomSize())
+        throw std::invalid_argument("VFOM history has a different size!");
+
+      py::gil_scoped_release release;
+      self.rebin(px, pf, n, v.data() + v.data_offset(),
+                 static_cast<std::ptrdiff_t>(v.strides()[0]), static_cast<std::ptrdiff_t>(v.strides()[1]));
+    }, py::arg("x").noconvert(), py::arg("fom").noconvert(), py::arg("vfom") = py::none())
+    .def("update", [] (Binning1D& self, double x, double fom, py::object vfom)
+    {
+      if (vfom.is_none()) return self.update(x, fom);
+
+      auto v = vfom.cast<xt::pytensor<double, 1>>();
+      if (v.size() != self.vfomSize()) throw std::invalid_argument("VFOM has a different size!");
+      return self.update(x, fom, v.data() + v.data_offset(), static_cast<std::ptrdiff_t>(v.strides()[0]));
+    }, py::arg("x"), py::arg("fom"), py::arg("vfom") = py::none())
+    .def_property_readonly("edges", [] (const Binning1D& self)
+    {
+      const auto& edges = self.bins().edges();
+      return py::array_t<double>(static_cast<py::ssize_t>(edges.size()), edges.data());
+    })
+    .def_property_readonly("vfom_size", &Binning1D::vfomSize)
+    // The following arrays are views of the result, which is updated in
+    // place by the next update.
+    .def_property_readonly("counts", [] (py::object self)
+    {
+      const auto& b = self.cast<const Binning1D&>();
+      return readOnlyView(self, b.counts(), {static_cast<py::ssize_t>(b.bins().size())});
+    })
+    .def_property_readonly("stats", [] (py::object self)
+    {
+      const auto& b = self.cast<const Binning1D&>();
+      return readOnlyView(self, b.stats(), {static_cast<py::ssize_t>(b.bins().size())});
+    })
+    .def_property_readonly("vfom_heat", [] (py::object self) -> py::object
+    {
+      const auto& b = self.cast<const Binning1D&>();
+      if (b.vfomSize() == 0) return py::none();
+      return readOnlyView(self, b.vfomHeat(), {static_cast<py::ssize_t>(b.vfomSize()),
+                                               static_cast<py::ssize_t>(b.bins().size())});
+    });
+
+  using foam::Binning2D;
+
+  py::class_<Binning2D>(m, "Binning2D")
+    .def(py::init([] (const foam::UniformBins& bins_x, const foam::UniformBins& bins_y,
+                      const std::string& statistic)
+      {
+        return new Binning2D(bins_x, bins_y, foam::toBinStatistic(statistic));
+      }), py::arg("bins_x"), py::arg("bins_y"), py::arg("statistic"))
+    .def("rebin", [] (Binning2D& self,
+                      const xt::pytensor<double, 1>& x,
+                      const xt::pytensor<double, 1>& y,
+                      const xt::pytensor<double, 1>& fom)
+    {
+      std::size_t n = x.size();
+      checkHistorySize(y.size(), n, "the second slow data");
+      checkHistorySize(fom.size(), n, "FOM");
+
+      xt::xtensor<double, 1> x_tmp, y_tmp, fom_tmp;
+      const double* px = contiguous(x, x_tmp);
+      const double* py_ = contiguous(y, y_tmp);
+      const double* pf = contiguous(fom, fom_tmp);
+
+      py::gil_scoped_release release;
+      self.rebin(px, py_, pf, n);
+    }, py::arg("x").noconvert(), py::arg("y").noconvert(), py::arg("fom").noconvert())
+    .def("update", &Binning2D::update, py::arg("x"), py::arg("y"), py::arg("fom"))
+    .def_property_readonly("edges_x", [] (const Binning2D& self)
+    {
+      const auto& edges = self.binsX().edges();
+      return py::array_t<double>(static_cast<py::ssize_t>(edges.size()), edges.data());
+    })
+    .def_property_readonly("edges_y", [] (const Binning2D& self)
+    {
+      const auto& edges = self.binsY().edges();
+      return py::array_t<double>(static_cast<py::ssize_t>(edges.size()), edges.data());
+    })
+    .def_property_readonly("heat_count", [] (py::object self)
+    {
+      const auto& b = self.cast<const Binning2D&>();
+      return readOnlyView(self, b.heatCount(), {static_cast<py::ssize_t>(b.binsY().size()),
+                                                static_cast<py::ssize_t>(b.binsX().size())});
+    })
+    .def_property_readonly("heat", [] (py::object self)
+    {
+      const auto& b = self.cast<const Binning2D&>();
+      return readOnlyView(self, b.heat(), {static_cast<py::ssize_t>(b.binsY().size()),
+                                           static_cast<py::ssize_t>(b.binsX().size())});
+    });
+}
@@ -0,0 +1,51 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include "pybind11/pybind11.h"
+
+#include "f_correlator.hpp"
+
+namespace py = pybind11;
+
+
+PYBIND11_MODULE(correlator, m)
+{
+  using foam::CorrelationStatus;
+  using foam::CorrelationResult;
+  using foam::TrainCorrelator;
+
+  m.doc() = "Train ID correlator.";
+
+  py::enum_<CorrelationStatus>(m, "CorrelationStatus")
+    .value("PENDING", CorrelationStatus::PENDING)
+    .value("CORRELATED", CorrelationStatus::CORRELATED)
+    .value("LATE", CorrelationStatus::LATE);
+
+  py::class_<CorrelationResult>(m, "CorrelationResult")
+    .def_readonly("status", &CorrelationResult::status)
+    .def_readonly("evicted", &CorrelationResult::evicted)
+    .def_readonly("evicted_tid", &CorrelationResult::evicted_tid)
+    .def_readonly("evicted_sources", &CorrelationResult::evicted_sources);
+
+  m.attr("MAX_SOURCES") = py::int_(TrainCorrelator::kMaxSources);
+  m.attr("MAX_CAPACITY") = py::int_(TrainCorrelator::kMaxCapacity);
+
+  py::class_<TrainCorrelator>(m, "TrainCorrelator")
+    .def(py::init<std::size_t, std::size_t>(), py::arg("n_sources"), py::arg("capacity"))
+    .def("put", &TrainCorrelator::put, py::arg("tid"), py::arg("sources"))
+    .def("isLate", &TrainCorrelator::isLate, py::arg("tid"))
+    .def("hasCorrelated", &TrainCorrelator::hasCorrelated)
+    .def("correlatedTid", &TrainCorrelator::correlatedTid)
+    .def("reset", &TrainCorrelator::reset)
+    .def_property_readonly("n_sources", &TrainCorrelator::nSources)
+    .def_property_readonly("capacity", &TrainCorrelator::capacity)
+    .def_property_readonly("n_correlated", &TrainCorrelator::nCorrelated)
+    .def_property_readonly("n_dropped", &TrainCorrelator::nDropped)
+    .def_property_readonly("n_late", &TrainCorrelator::nLate);
+}
@@ -8,12 +8,23 @@
  * All rights reserved.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "pybind11/pybind11.h"
+#include "pybind11/numpy.h"
 #include "xtensor/xarray.hpp"
-#define FORCE_IMPORT_ARRAY
-#include "xtensor-python/pyarray.hpp"
+
+#include "f_dark_accumulator.hpp"
+#include "f_imageproc.hpp"
+#include "f_pyconfig.hpp"
+
+namespace py = pybind11;
 
 
 /**
@@ -61,8 +72,51 @@ public:
 };
 
 
+/**
+ * How the moving average of an array is updated after the window is filled.
+ *
+ * APPROXIMATE: avg += (new - avg) / window. No history is kept.
+ * SLIDING: exact average of the last 'window' arrays, which are kept in a
+ *          ring buffer. NaN is ignored, i.e. the average of a pixel is over
+ *          its valid values within the window, and it is NaN only if none
+ *          of them is valid.
+ * WELFORD: same as SLIDING, but also keeps the running variance.
+ */
+enum class MovingAverageMode
+{
+  APPROXIMATE,
+  SLIDING,
+  WELFORD
+};
+
+inline MovingAverageMode toMovingAverageMode(const std::string& mode)
+{
+  if (mode == "approximate") return MovingAverageMode::APPROXIMATE;
+  if (mode == "sliding") return MovingAverageMode::SLIDING;
+  if (mode == "welford") return MovingAverageMode::WELFORD;
+  throw std::invalid_argument("Unknown moving average mode: " + mode);
+}
+
+inline std::string toString(MovingAverageMode mode)
+{
+  if (mode == MovingAverageMode::SLIDING) return "sliding";
+  if (mode == MovingAverageMode::WELFORD) return "welford";
+  return "approximate";
+}
+
+
 /**
  * Moving average of a numpy array.
+ *
+ * The average is updated in place. In the exact modes, the arrays within
+ * the window are kept in a ring buffer which is allocated once when the
+ * first array of a new window arrives.
+ *
+ * Thread safety: the GIL is released while the average is being updated by
+ * set(), so that other Python threads can run in the meantime. Therefore, an
+ * instance must only be used by one thread at a time, and the view returned
+ * by get() must not be read by another thread during set(). Different
+ * instances can be used concurrently.
  */
 template<typename T>
 class MovingAverageArray {
@@ -72,31 +126,261 @@ protected:
   size_t window_;
   size_t count_;
 
+  MovingAverageMode mode_;
+  // mode and window with which data_ is being accumulated
+  MovingAverageMode active_mode_;
+  size_t active_window_;
+
+  std::vector<T> history_; // ring buffer of the last 'window_' arrays
+  size_t head_; // slot of the oldest array in the ring buffer
+  std::vector<T> m2_; // sum of squares of differences from the average
+  std::vector<size_t> n_valid_; // number of valid (non-NaN) values of each pixel in the window
+
+  bool isExact() const { return active_mode_ != MovingAverageMode::APPROXIMATE; }
+
+  T* slot(size_t i) { return history_.data() + i * data_.size(); }
+
+  /**
+   * Start a new average with the current data as the first array.
+   */
+  void restart()
+  {
+    count_ = 1;
+    active_mode_ = mode_;
+    active_window_ = window_;
+    head_ = 0;
+
+    if (isExact() && window_ > 1)
+    {
+      history_.resize(window_ * data_.size());
+      std::copy(data_.cbegin(), data_.cend(), slot(0));
+      n_valid_.resize(data_.size());
+      std::transform(data_.cbegin(), data_.cend(), n_valid_.begin(),
+                     [] (T v) -> size_t { return std::isnan(v) ? 0 : 1; });
+    } else
+    {
+      history_.clear();
+      history_.shrink_to_fit();
+      n_valid_.clear();
+      n_valid_.shrink_to_fit();
+    }
+
+    if (active_mode_ == MovingAverageMode::WELFORD) m2_.assign(data_.size(), T(0));
+    else
+    {
+      m2_.clear();
+      m2_.shrink_to_fit();
+    }
+  }
+
+  /**
+   * Add a valid value of a pixel to the window. m2 is nullptr if the
+   * variance is not kept.
+   */
+  static void addValue(T v, T& avg, T* m2, size_t& n_valid)
+  {
+    if (++n_valid == 1)
+    {
+      avg = v;
+      if (m2) *m2 = T(0);
+      return;
+    }
+    T delta = v - avg;
+    avg += delta / static_cast<T>(n_valid);
+    if (m2) *m2 += delta * (v - avg);
+  }
+
+  /**
+   * Remove a valid value of a pixel from the window.
+   */
+  static void removeValue(T v, T& avg, T* m2, size_t& n_valid)
+  {
+    if (--n_valid == 0)
+    {
+      avg = std::numeric_limits<T>::quiet_NaN();
+      if (m2) *m2 = T(0);
+      return;
+    }
+    T delta = v - avg;
+    avg -= delta / static_cast<T>(n_valid);
+    if (m2) *m2 -= delta * (v - avg);
+  }
+
+  /**
+   * Accumulate a new array when the window is not filled yet in the exact modes.
+   */
+  void grow(const T* src)
+  {
+    ++count_;
+    T* avg = data_.data();
+    T* dst = slot(count_ - 1);
+    T* m2 = m2_.data();
+    size_t* n_valid = n_valid_.data();
+    bool welford = active_mode_ == MovingAverageMode::WELFORD;
+
+    foam::detail::parallelFor(data_.size(), [=] (size_t begin, size_t end)
+    {
+      for (size_t k = begin; k < end; ++k)
+      {
+        T v = src[k];
+        dst[k] = v;
+        if (!std::isnan(v)) addValue(v, avg[k], welford ? m2 + k : nullptr, n_valid[k]);
+      }
+    });
+  }
+
+  /**
+   * Replace the oldest array in the window by a new one.
+   */
+  void slide(const T* src)
+  {
+    T* avg = data_.data();
+    T* old = slot(head_);
+    T* m2 = m2_.data();
+    size_t* n_valid = n_valid_.data();
+    bool welford = active_mode_ == MovingAverageMode::WELFORD;
+
+    foam::detail::parallelFor(data_.size(), [=] (size_t begin, size_t end)
+    {
+      for (size_t k = begin; k < end; ++k)
+      {
+        T v = src[k];
+        T v_old = old[k];
+        old[k] = v;
+        bool valid = !std::isnan(v);
+        bool valid_old = !std::isnan(v_old);
+        T* m2k = welford ? m2 + k : nullptr;
+
+        if (valid && valid_old)
+        {
+          // the number of valid values is unchanged
+          T avg_old = avg[k];
+          avg[k] += (v - v_old) / static_cast<T>(n_valid[k]);
+          if (welford) *m2k += (v - v_old) * (v - avg[k] + v_old - avg_old);
+        } else
+        {
+          if (valid_old) removeValue(v_old, avg[k], m2k, n_valid[k]);
+          if (valid) addValue(v, avg[k], m2k, n_valid[k]);
+        }
+      }
+    });
+
+    head_ = (head_ + 1) % count_;
+  }
+
+  /**
+   * Return a pointer to the data of arr which has the same memory layout as
+   * the average. A contiguous copy is made in tmp if necessary.
+   */
+  const T* contiguous(const xt::pyarray<T>& arr, xt::pyarray<T>& tmp) const
+  {
+    if (std::equal(arr.strides().begin(), arr.strides().end(), data_.strides().begin())) return arr.data();
+    tmp = arr;
+    return tmp.data();
+  }
+
+  /**
+   * Update the average in the approximate mode: avg += (arr - avg) / count.
+   */
+  virtual void approximate(const xt::pyarray<T>& arr, size_t count)
+  {
+    xt::pyarray<T> tmp;
+    const T* src = contiguous(arr, tmp);
+    T* avg = data_.data();
+    T n = static_cast<T>(count);
+
+    py::gil_scoped_release release;
+    foam::detail::parallelFor(data_.size(), [=] (size_t begin, size_t end)
+    {
+      for (size_t k = begin; k < end; ++k) avg[k] += (src[k] - avg[k]) / n;
+    });
+  }
+
 public:
   explicit MovingAverageArray(const xt::pyarray<T>& arr)
-    : data_(arr), window_(1), count_(1) {
+    : data_(arr), window_(1), count_(1),
+      mode_(MovingAverageMode::APPROXIMATE), active_mode_(MovingAverageMode::APPROXIMATE), active_window_(1),
+      head_(0) {
   };
 
   virtual ~MovingAverageArray() = default;
 
   void set(const xt::pyarray<T>& arr) {
-    if (window_ > 1 && count_ <= window_ && arr.shape() == data_.shape()) {
-      if (count_ < window_) {
-        ++count_;
-        data_ = data_ + (arr - data_) / count_;
-      } else {
-        // this is an approximation
-        data_ = data_ + (arr - data_) / window_;
-      }
-    } else {
+    bool same_shape = arr.shape() == data_.shape();
+    // nothing to lose if only a single array has been received
+    if (same_shape && count_ == 1 && (mode_ != active_mode_ || window_ != active_window_)) restart();
+
+    bool accumulate = window_ > 1 && same_shape && mode_ == active_mode_;
+    if (isExact()) accumulate = accumulate && window_ == active_window_;
+    else accumulate = accumulate && count_ <= window_;
+
+    if (! accumulate) {
       data_ = arr;
-      count_ = 1;
+      restart();
+      return;
+    }
+
+    if (! isExact()) {
+      if (count_ < window_) ++count_;
+      approximate(arr, count_); // count_ == window_ is an approximation
+      return;
     }
+
+    // the kernels index the input directly, which requires the same
+    // memory layout as the average
+    xt::pyarray<T> tmp;
+    const T* src = contiguous(arr, tmp);
+    py::gil_scoped_release release;
+    if (count_ < window_) grow(src);
+    else slide(src);
   };
 
-  // TODO: fix it
+  /**
+   * Return the moving average.
+   *
+   * The Python binding returns a read-only view of it without copying.
+   */
   xt::pyarray<T>& get() { return data_; }
 
+  /**
+   * Return the variance of the arrays within the window.
+   *
+   * Only available in the WELFORD mode.
+   */
+  xt::pyarray<T> variance() const {
+    if (active_mode_ != MovingAverageMode::WELFORD)
+      throw std::runtime_error("Variance is only available in the 'welford' mode!");
+
+    xt::pyarray<T> var(data_.shape());
+    T* dst = var.data();
+    const T* m2 = m2_.data();
+    {
+      py::gil_scoped_release release;
+      if (n_valid_.empty())
+      {
+        // a single array
+        const T* avg = data_.data();
+        foam::detail::parallelFor(var.size(), [=] (size_t begin, size_t end)
+        {
+          for (size_t k = begin; k < end; ++k) dst[k] = std::isnan(avg[k]) ? avg[k] : T(0);
+        });
+      } else
+      {
+        const size_t* n_valid = n_valid_.data();
+        // m2 can be slightly negative due to rounding
+        foam::detail::parallelFor(var.size(), [=] (size_t begin, size_t end)
+        {
+          for (size_t k = begin; k < end; ++k)
+          {
+            dst[k] = n_valid[k] == 0 ? std::numeric_limits<T>::quiet_NaN()
+                                     : std::max(m2[k] / static_cast<T>(n_valid[k]), T(0));
+          }
+        });
+      }
+    }
+    return var;
+  }
+
   void setWindow(size_t v) {
     if (! v) throw std::invalid_argument("Moving average window must be positive!");
 
@@ -106,12 +390,45 @@ public:
   size_t window() const { return window_; }
 
   size_t count() const { return count_; }
+
+  /**
+   * Set the mode of the moving average. Like the window, the new mode takes
+   * effect with the next array. A new average will be started unless the
+   * current one contains only a single array.
+   */
+  void setMode(MovingAverageMode mode) { mode_ = mode; }
+
+  MovingAverageMode mode() const { return mode_; }
 };
 
 
 template <typename T>
 class RawImageData : public MovingAverageArray<T> {
 
+protected:
+
+  /**
+   * Override.
+   *
+   * Update the preallocated average in place with the parallel image kernels.
+   */
+  void approximate(const xt::pyarray<T>& arr, size_t count) override
+  {
+    if (pulseResolved()) {
+      xt::pytensor<T, 3> avg(this->data_, py::object::borrowed_t{});
+      xt::pytensor<T, 3> data(arr, py::object::borrowed_t{});
+      py::gil_scoped_release release;
+      foam::movingAvgImageData(avg, data, count);
+    } else if (this->data_.dimension() == 2) {
+      xt::pytensor<T, 2> avg(this->data_, py::object::borrowed_t{});
+      xt::pytensor<T, 2> data(arr, py::object::borrowed_t{});
+      py::gil_scoped_release release;
+      foam::movingAvgImageData(avg, data, count);
+    } else {
+      MovingAverageArray<T>::approximate(arr, count);
+    }
+  }
+
 public:
   explicit RawImageData(const xt::pyarray<T>& arr) : MovingAverageArray<T>(arr) {
   };
@@ -127,7 +444,15 @@ public:
 };
 
 
-namespace py = pybind11;
+/**
+ * Return a read-only numpy view of an array without copying the data.
+ */
+template<typename T>
+py::object readOnlyView(xt::pyarray<T>& arr) {
+  py::object view = py::reinterpret_borrow<py::object>(arr).attr("view")();
+  view.attr("setflags")(py::arg("write") = false);
+  return view;
+}
 
 template<typename T>
 void declare_MovingAverage(py::module &m, const std::string &type_str) {
@@ -151,11 +476,15 @@ void declare_MovingAverageArray(py::module &m, const std::string &type_str) {
   std::string py_class_name = std::string("MovingAverageArray") + type_str;
   py::class_<Class>(m, py_class_name.c_str())
     .def(py::init<const xt::pyarray<T>&>())
-    .def("get", &Class::get)
+    .def("get", [] (Class& self) { return readOnlyView(self.get()); })
     .def("set", &Class::set)
     .def("window", &Class::window)
     .def("setWindow", &Class::setWindow)
-    .def("count", &Class::count);
+    .def("count", &Class::count)
+    .def("variance", &Class::variance)
+    .def("setMode", [] (Class& self, const std::string& mode) { self.setMode(toMovingAverageMode(mode)); },
+         py::arg("mode"))
+    .def("mode", [] (const Class& self) { return toString(self.mode()); });
 }
 
 
@@ -171,9 +500,90 @@ void declare_RawImageData(py::module &m, const std::string &type_str) {
 }
 
 
+template<typename T>
+void declare_DarkAccumulator(py::module &m, const std::string &type_str) {
+  using Class = foam::DarkAccumulator<T>;
+
+  std::string py_class_name = std::string("DarkAccumulator") + type_str;
+  py::class_<Class> cls(m, py_class_name.c_str());
+
+  cls.def(py::init<>())
+    .def("update", [] (Class& self, const xt::pytensor<T, 3>& src)
+    {
+      py::gil_scoped_release release;
+      self.update(src);
+    }, py::arg("src").noconvert())
+    .def("update", [] (Class& self, const xt::pytensor<T, 2>& src)
+    {
+      py::gil_scoped_release release;
+      self.update(src);
+    }, py::arg("src").noconvert())
+    .def("reset", &Class::reset)
+    .def("count", &Class::count)
+    .def_property_readonly("shape", [] (const Class& self)
+    {
+      const auto& s = self.shape();
+      return py::make_tuple(s[0], s[1], s[2]);
+    })
+    // The returned array is a read-only view of the running average, which
+    // is updated in place by the next train.
+    .def("mean", [] (py::object self)
+    {
+      auto& acc = self.cast<Class&>();
+      const auto& s = acc.shape();
+      std::vector<py::ssize_t> shape(s.begin(), s.end());
+      py::array_t<T> view(shape, acc.mean(), self);
+      view.attr("setflags")(py::arg("write") = false);
+      return view;
+    })
+    .def("stddev", [] (const Class& self, std::size_t ddof)
+    {
+      const auto& s = self.shape();
+      auto out = xt::pytensor<T, 3>::from_shape({s[0], s[1], s[2]});
+      {
+        py::gil_scoped_release release;
+        self.stddev(out, ddof);
+      }
+      return out;
+    }, py::arg("ddof") = 0)
+    .def("nanCount", [] (const Class& self)
+    {
+      const auto& s = self.shape();
+      auto out = xt::pytensor<uint32_t, 3>::from_shape({s[0], s[1], s[2]});
+      {
+        py::gil_scoped_release release;
+        self.nanCount(out);
+      }
+      return out;
+    })
+    .def("meanImage", [] (const Class& self)
+    {
+      const auto& s = self.shape();
+      auto out = xt::pytensor<T, 2>::from_shape({s[1], s[2]});
+      {
+        py::gil_scoped_release release;
+        self.meanImage(out);
+      }
+      return out;
+    })
+    .def("noiseMask", [] (const Class& self, T lb, T ub)
+    {
+      const auto& s = self.shape();
+      auto out = xt::pytensor<bool, 2>::from_shape({s[1], s[2]});
+      {
+        py::gil_scoped_release release;
+        self.noiseMask(out, lb, ub);
+      }
+      return out;
+    }, py::arg("lb"), py::arg("ub"));
+}
+
+
 PYBIND11_MODULE(datamodel, m) {
   xt::import_numpy();
 
+  foam::definePartitionConfig(m);
+
   declare_MovingAverage<float>(m, "Float");
   declare_MovingAverage<double>(m, "Double");
 
@@ -182,4 +592,7 @@ PYBIND11_MODULE(datamodel, m) {
 
   declare_RawImageData<float>(m, "Float");
   declare_RawImageData<double>(m, "Double");
+
+  declare_DarkAccumulator<float>(m, "Float");
+  declare_DarkAccumulator<double>(m, "Double");
 }
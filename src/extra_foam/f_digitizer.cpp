@@ -0,0 +1,63 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cstdint>
+
+#include "pybind11/pybind11.h"
+
+#include "xtensor/xtensor.hpp"
+
+#include "f_digitizer.hpp"
+#include "f_pyconfig.hpp"
+
+namespace py = pybind11;
+
+
+PYBIND11_MODULE(digitizer, m)
+{
+
+  using namespace foam;
+
+  xt::import_numpy();
+
+  m.doc() = "Digitizer waveform processing.";
+
+  defineProfiler(m);
+  definePartitionConfig(m);
+
+// The raw samples are integrated in their own type. The integrals are always
+// returned as float32, which is the type of the pulse-resolved digitizer data.
+#define FOAM_INTEGRATE_PULSES_IMP(VALUE_TYPE)                                                     \
+  m.def("integratePulses", [] (const xt::pytensor<VALUE_TYPE, 1>& src,                            \
+                               std::size_t baseline_start, std::size_t baseline_end,              \
+                               std::size_t pulse_start, std::size_t pulse_period,                 \
+                               std::size_t pulse_width, std::size_t n_pulses)                     \
+  {                                                                                               \
+    return foam::integratePulses<xt::xtensor<float, 1>>(                                          \
+      src, baseline_start, baseline_end, pulse_start, pulse_period, pulse_width, n_pulses);       \
+  }, py::arg("src").noconvert(), py::arg("baseline_start"), py::arg("baseline_end"),              \
+     py::arg("pulse_start"), py::arg("pulse_period"), py::arg("pulse_width"),                     \
+     py::arg("n_pulses") = 0, release_gil());                                                     \
+  m.def("integratePulses", [] (const xt::pytensor<VALUE_TYPE, 1>& src,                            \
+                               std::size_t baseline_start, std::size_t baseline_end,              \
+                               std::size_t pulse_start, std::size_t pulse_period,                 \
+                               std::size_t pulse_width, xt::pytensor<float, 1>& out)              \
+  {                                                                                               \
+    foam::integratePulses(                                                                        \
+      src, baseline_start, baseline_end, pulse_start, pulse_period, pulse_width, out);            \
+  }, py::arg("src").noconvert(), py::arg("baseline_start"), py::arg("baseline_end"),              \
+     py::arg("pulse_start"), py::arg("pulse_period"), py::arg("pulse_width"),                     \
+     py::arg("out").noconvert(), release_gil());
+
+  FOAM_INTEGRATE_PULSES_IMP(int16_t)
+  FOAM_INTEGRATE_PULSES_IMP(uint16_t)
+  FOAM_INTEGRATE_PULSES_IMP(float)
+  FOAM_INTEGRATE_PULSES_IMP(double)
+
+}
@@ -10,33 +10,28 @@
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 
-#if defined(FOAM_WITH_TBB)
-#include "tbb/parallel_for.h"
-#include "tbb/blocked_range2d.h"
-#endif
-
 #include "f_geometry.hpp"
 #include "f_pyconfig.hpp"
 
 namespace py = pybind11;
 
 
-template<typename Geometry>
-void declare_1MGeometry(py::module &m, std::string&& detector)
+/**
+ * Declare the assembling and dismantling methods which are shared by all the geometries.
+ */
+template<typename GeometryBase, typename PyClass>
+void declare_GeometryMethods(PyClass& base)
 {
-  using GeometryBase = foam::Detector1MGeometryBase<Geometry>;
-  const std::string py_base_class_name = detector + std::string("_Detector1MGeometryBase");
-
-  py::class_<GeometryBase> base(m, py_base_class_name.c_str());
-
 #define FOAM_POSITION_ALL_MODULES_SINGLE_IMP(SRC_TYPE, DST_TYPE)                                      \
   base.def("positionAllModules",                                                                      \
   (void (GeometryBase::*)(const xt::pytensor<SRC_TYPE, 3>&, xt::pytensor<DST_TYPE, 2>&, bool) const)  \
     &GeometryBase::positionAllModules,                                                                \
-    py::arg("src").noconvert(), py::arg("dst").noconvert(), py::arg("ignore_tile_edge") = false);
+    py::arg("src").noconvert(), py::arg("dst").noconvert(), py::arg("ignore_tile_edge") = false, foam::release_gil());
 
   FOAM_POSITION_ALL_MODULES_SINGLE_IMP(float, float)
   FOAM_POSITION_ALL_MODULES_SINGLE_IMP(uint16_t, float)
+  FOAM_POSITION_ALL_MODULES_SINGLE_IMP(int16_t, float)
+  FOAM_POSITION_ALL_MODULES_SINGLE_IMP(uint32_t, float)
   FOAM_POSITION_ALL_MODULES_SINGLE_IMP(bool, float)
   FOAM_POSITION_ALL_MODULES_SINGLE_IMP(uint16_t, uint16_t)
   FOAM_POSITION_ALL_MODULES_SINGLE_IMP(bool, bool)
@@ -45,10 +40,12 @@ void declare_1MGeometry(py::module &m, std::string&& detector)
   base.def("positionAllModules",                                                                          \
   (void (GeometryBase::*)(const xt::pytensor<SRC_TYPE, 4>&, xt::pytensor<DST_TYPE, 3>&, bool) const)      \
     &GeometryBase::positionAllModules,                                                                    \
-    py::arg("src").noconvert(), py::arg("dst").noconvert(), py::arg("ignore_tile_edge") = false);
+    py::arg("src").noconvert(), py::arg("dst").noconvert(), py::arg("ignore_tile_edge") = false, foam::release_gil());
 
   FOAM_POSITION_ALL_MODULES_IMP(float, float)
   FOAM_POSITION_ALL_MODULES_IMP(uint16_t, float)
+  FOAM_POSITION_ALL_MODULES_IMP(int16_t, float)
+  FOAM_POSITION_ALL_MODULES_IMP(uint32_t, float)
   FOAM_POSITION_ALL_MODULES_IMP(bool, float)
   FOAM_POSITION_ALL_MODULES_IMP(uint16_t, uint16_t)
   FOAM_POSITION_ALL_MODULES_IMP(bool, bool)
@@ -57,19 +54,56 @@ void declare_1MGeometry(py::module &m, std::string&& detector)
   base.def("positionAllModules",                                                                                    \
     (void (GeometryBase::*)(const std::vector<xt::pytensor<SRC_TYPE, 3>>&, xt::pytensor<DST_TYPE, 3>&, bool) const) \
     &GeometryBase::positionAllModules,                                                                              \
-    py::arg("src").noconvert(), py::arg("dst").noconvert(), py::arg("ignore_tile_edge") = false);
+    py::arg("src").noconvert(), py::arg("dst").noconvert(), py::arg("ignore_tile_edge") = false, foam::release_gil());
 
   FOAM_POSITION_ALL_MODULES_VECTOR_SRC_IMP(float, float)
   FOAM_POSITION_ALL_MODULES_VECTOR_SRC_IMP(uint16_t, float)
+  FOAM_POSITION_ALL_MODULES_VECTOR_SRC_IMP(int16_t, float)
+  FOAM_POSITION_ALL_MODULES_VECTOR_SRC_IMP(uint32_t, float)
   FOAM_POSITION_ALL_MODULES_VECTOR_SRC_IMP(bool, float)
   FOAM_POSITION_ALL_MODULES_VECTOR_SRC_IMP(uint16_t, uint16_t)
   FOAM_POSITION_ALL_MODULES_VECTOR_SRC_IMP(bool, bool)
 
+#define FOAM_POSITION_ALL_MODULES_CORRECTED_IMP(SRC_TYPE, DST_TYPE)                                       \
+  base.def("positionAllModules",                                                                          \
+  (void (GeometryBase::*)(const xt::pytensor<SRC_TYPE, 4>&, xt::pytensor<DST_TYPE, 3>&,                   \
+                          const xt::pytensor<DST_TYPE, 3>&, const xt::pytensor<DST_TYPE, 3>&, bool) const) \
+    &GeometryBase::positionAllModules,                                                                    \
+    py::arg("src").noconvert(), py::arg("dst").noconvert(),                                               \
+    py::arg("gain").noconvert(), py::arg("offset").noconvert(), py::arg("ignore_tile_edge") = false,      \
+    foam::release_gil());                                                                                 \
+  base.def("positionAllModules",                                                                          \
+  (void (GeometryBase::*)(const xt::pytensor<SRC_TYPE, 4>&, xt::pytensor<DST_TYPE, 3>&,                   \
+                          const xt::pytensor<DST_TYPE, 3>&, const xt::pytensor<DST_TYPE, 3>&,             \
+                          const xt::pytensor<bool, 3>&, bool) const)                                      \
+    &GeometryBase::positionAllModules,                                                                    \
+    py::arg("src").noconvert(), py::arg("dst").noconvert(),                                               \
+    py::arg("gain").noconvert(), py::arg("offset").noconvert(), py::arg("mask").noconvert(),              \
+    py::arg("ignore_tile_edge") = false, foam::release_gil());
+
+  FOAM_POSITION_ALL_MODULES_CORRECTED_IMP(float, float)
+  FOAM_POSITION_ALL_MODULES_CORRECTED_IMP(uint16_t, float)
+  FOAM_POSITION_ALL_MODULES_CORRECTED_IMP(int16_t, float)
+  FOAM_POSITION_ALL_MODULES_CORRECTED_IMP(uint32_t, float)
+
+#define FOAM_POSITION_MODULE_IMP(SRC_TYPE, DST_TYPE)                                                      \
+  base.def("positionModule",                                                                              \
+  (void (GeometryBase::*)(const xt::pytensor<SRC_TYPE, 4>&, xt::pytensor<DST_TYPE, 3>&, int, bool) const) \
+    &GeometryBase::positionModule,                                                                        \
+    py::arg("src").noconvert(), py::arg("dst").noconvert(), py::arg("im"),                                \
+    py::arg("ignore_tile_edge") = false, foam::release_gil());
+
+  FOAM_POSITION_MODULE_IMP(float, float)
+  FOAM_POSITION_MODULE_IMP(uint16_t, float)
+  FOAM_POSITION_MODULE_IMP(int16_t, float)
+  FOAM_POSITION_MODULE_IMP(uint32_t, float)
+  FOAM_POSITION_MODULE_IMP(uint16_t, uint16_t)
+
 #define FOAM_DISMANTLE_ALL_MODULES_SINGLE_IMP(SRC_TYPE, DST_TYPE)                                      \
   base.def("dismantleAllModules",                                                                      \
   (void (GeometryBase::*)(const xt::pytensor<SRC_TYPE, 2>&, xt::pytensor<DST_TYPE, 3>&) const)         \
     &GeometryBase::dismantleAllModules,                                                                \
-    py::arg("src").noconvert(), py::arg("dst").noconvert());
+    py::arg("src").noconvert(), py::arg("dst").noconvert(), foam::release_gil());
 
   FOAM_DISMANTLE_ALL_MODULES_SINGLE_IMP(float, float)
   FOAM_DISMANTLE_ALL_MODULES_SINGLE_IMP(uint16_t, uint16_t)
@@ -79,11 +113,35 @@ void declare_1MGeometry(py::module &m, std::string&& detector)
   base.def("dismantleAllModules",                                                                      \
   (void (GeometryBase::*)(const xt::pytensor<SRC_TYPE, 3>&, xt::pytensor<DST_TYPE, 4>&) const)         \
     &GeometryBase::dismantleAllModules,                                                                \
-    py::arg("src").noconvert(), py::arg("dst").noconvert());
+    py::arg("src").noconvert(), py::arg("dst").noconvert(), foam::release_gil());
 
   FOAM_DISMANTLE_ALL_MODULES(float, float)
   FOAM_DISMANTLE_ALL_MODULES(uint16_t, uint16_t)
   FOAM_DISMANTLE_ALL_MODULES(bool, bool)
+}
+
+template<typename Geometry>
+void declare_1MGeometry(py::module &m, std::string&& detector)
+{
+  using GeometryBase = foam::Detector1MGeometryBase<Geometry>;
+  const std::string py_base_class_name = detector + std::string("_Detector1MGeometryBase");
+
+  py::class_<GeometryBase> base(m, py_base_class_name.c_str());
+
+  declare_GeometryMethods<GeometryBase>(base);
+
+  base.def("pixelPositions", [] (const GeometryBase& self, bool ignore_tile_edge)
+  {
+    auto dst = xt::pytensor<int32_t, 4>::from_shape({static_cast<std::size_t>(GeometryBase::n_modules),
+                                                     static_cast<std::size_t>(Geometry::module_shape[0]),
+                                                     static_cast<std::size_t>(Geometry::module_shape[1]),
+                                                     2});
+    {
+      py::gil_scoped_release release;
+      self.pixelPositions(dst, ignore_tile_edge);
+    }
+    return dst;
+  }, py::arg("ignore_tile_edge") = false);
 
   base.def("assembledShape", &GeometryBase::assembledShape)
     .def_readonly_static("n_quads", &GeometryBase::n_quads)
@@ -104,15 +162,67 @@ void declare_1MGeometry(py::module &m, std::string&& detector)
 
 }
 
+void declare_GenericGeometry(py::module &m)
+{
+  using Tile = foam::GeometryTile;
+
+  py::class_<Tile>(m, "GeometryTile")
+    .def(py::init([] (int module, const std::array<int, 2>& origin, const std::array<int, 2>& shape,
+                      const std::array<double, 2>& corner, const std::array<double, 2>& fs_vec,
+                      const std::array<double, 2>& ss_vec)
+      { return Tile {module, origin, shape, corner, fs_vec, ss_vec}; }),
+      py::arg("module"), py::arg("origin"), py::arg("shape"), py::arg("corner"),
+      py::arg("fs_vec"), py::arg("ss_vec"))
+    .def_readonly("module", &Tile::module)
+    .def_readonly("origin", &Tile::origin)
+    .def_readonly("shape", &Tile::shape)
+    .def_readonly("corner", &Tile::corner)
+    .def_readonly("fs_vec", &Tile::fs_vec)
+    .def_readonly("ss_vec", &Tile::ss_vec);
+
+  using Geometry = foam::GenericGeometry;
+
+  py::class_<Geometry> cls(m, "GenericGeometry");
+
+  declare_GeometryMethods<Geometry>(cls);
+
+  cls.def("pixelPositions", [] (const Geometry& self, bool ignore_tile_edge)
+  {
+    auto dst = xt::pytensor<int32_t, 4>::from_shape({static_cast<std::size_t>(self.nModules()),
+                                                     static_cast<std::size_t>(self.moduleShape()[0]),
+                                                     static_cast<std::size_t>(self.moduleShape()[1]),
+                                                     2});
+    {
+      py::gil_scoped_release release;
+      self.pixelPositions(dst, ignore_tile_edge);
+    }
+    return dst;
+  }, py::arg("ignore_tile_edge") = false);
+
+  cls.def(py::init<int, const Geometry::shapeType&>(), py::arg("n_modules"), py::arg("module_shape"))
+    .def(py::init<int, const Geometry::shapeType&, const std::vector<Tile>&>(),
+         py::arg("n_modules"), py::arg("module_shape"), py::arg("tiles"))
+    .def("assembledShape", &Geometry::assembledShape)
+    .def_property_readonly("n_modules", &Geometry::nModules)
+    .def_property_readonly("module_shape", &Geometry::moduleShape)
+    .def_property_readonly("tiles", &Geometry::tiles);
+}
+
 PYBIND11_MODULE(geometry, m)
 {
   xt::import_numpy();
 
   m.doc() = "Detector geometry.";
 
+  foam::defineProfiler(m);
+
+  foam::definePartitionConfig(m);
+
   declare_1MGeometry<foam::AGIPD_1MGeometry>(m, "AGIPD");
 
   declare_1MGeometry<foam::LPD_1MGeometry>(m, "LPD");
 
   declare_1MGeometry<foam::DSSC_1MGeometry>(m, "DSSC");
+
+  declare_GenericGeometry(m);
 }
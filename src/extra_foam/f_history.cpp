@@ -0,0 +1,77 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include "pybind11/pybind11.h"
+#include "pybind11/numpy.h"
+#include "pybind11/stl.h"
+
+#include "f_history.hpp"
+
+namespace py = pybind11;
+
+
+namespace
+{
+
+using foam::HistoryBuffer;
+
+// read-only view of a column, which keeps the buffer alive
+template<typename T>
+py::array columnView(HistoryBuffer& self, const T* data, std::size_t n)
+{
+  py::array_t<T> arr(static_cast<py::ssize_t>(n), data, py::cast(self, py::return_value_policy::reference));
+  arr.attr("setflags")(py::arg("write") = false);
+  return arr;
+}
+
+} // namespace
+
+
+PYBIND11_MODULE(history, m)
+{
+  m.doc() = "Fixed-capacity columnar history with binned statistics.";
+
+  py::class_<HistoryBuffer> cls(m, "HistoryBuffer");
+
+  cls.def(py::init<std::size_t, std::size_t, double, std::size_t>(),
+          py::arg("capacity"), py::arg("n_columns"), py::arg("resolution") = 0., py::arg("min_count") = 2)
+    .def("append", (void (HistoryBuffer::*)(uint64_t, double, const std::vector<double>&))
+                   &HistoryBuffer::append,
+         py::arg("tid"), py::arg("x"), py::arg("y"))
+    .def("clear", &HistoryBuffer::clear)
+    .def("setResolution", &HistoryBuffer::setResolution, py::arg("resolution"))
+    .def("__len__", &HistoryBuffer::size)
+    .def_property_readonly("capacity", &HistoryBuffer::capacity)
+    .def_property_readonly("n_columns", &HistoryBuffer::nColumns)
+    .def_property_readonly("resolution", &HistoryBuffer::resolution)
+    .def_property_readonly("min_count", &HistoryBuffer::minCount)
+    .def_property_readonly("n_bins", &HistoryBuffer::nBins)
+    // The returned arrays are read-only views of the buffer, which are only
+    // meaningful until the buffer is modified.
+    .def("tids", [] (HistoryBuffer& self) { return columnView(self, self.tids(), self.size()); })
+    .def("x", [] (HistoryBuffer& self) { return columnView(self, self.x(), self.size()); })
+    .def("y", [] (HistoryBuffer& self, std::size_t j)
+    {
+      return columnView(self, self.y(j), self.size());
+    }, py::arg("column") = 0)
+    .def("binX", [] (HistoryBuffer& self) { return columnView(self, self.binX(), self.nBins()); })
+    .def("binCount", [] (HistoryBuffer& self) { return columnView(self, self.binCount(), self.nBins()); })
+    .def("binCount", [] (HistoryBuffer& self, std::size_t j)
+    {
+      return columnView(self, self.binCount(j), self.nBins());
+    }, py::arg("column"))
+    .def("binMean", [] (HistoryBuffer& self, std::size_t j)
+    {
+      return columnView(self, self.binMean(j), self.nBins());
+    }, py::arg("column") = 0)
+    .def("binStd", [] (HistoryBuffer& self, std::size_t j)
+    {
+      return columnView(self, self.binStd(j), self.nBins());
+    }, py::arg("column") = 0);
+}
@@ -0,0 +1,61 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <string>
+
+#include "pybind11/pybind11.h"
+
+#include "f_image_codec.hpp"
+#include "f_pyconfig.hpp"
+
+namespace py = pybind11;
+
+
+PYBIND11_MODULE(image_codec, m)
+{
+  xt::import_numpy();
+
+  using namespace foam;
+
+  m.doc() = "Compact encoding of image arrays for display.";
+
+  defineProfiler(m);
+  definePartitionConfig(m);
+
+  py::enum_<ImageCodec>(m, "ImageCodec")
+    .value("FLOAT32", ImageCodec::FLOAT32)
+    .value("FLOAT16", ImageCodec::FLOAT16)
+    .value("UINT16", ImageCodec::UINT16)
+    .value("UINT8", ImageCodec::UINT8);
+
+// The stream is built without the GIL and is copied once into a bytes object.
+// It is decoded in place into a pre-allocated array.
+#define FOAM_IMAGE_CODEC_IMPL(VALUE_TYPE)                                                         \
+  m.def("encodeImages", [] (const xt::pytensor<VALUE_TYPE, 3>& src, ImageCodec codec)             \
+  {                                                                                               \
+    std::string encoded;                                                                          \
+    {                                                                                             \
+      py::gil_scoped_release release;                                                             \
+      encoded = foam::encodeImages(src, codec);                                                   \
+    }                                                                                             \
+    return py::bytes(encoded);                                                                    \
+  }, py::arg("src").noconvert(), py::arg("codec"));                                               \
+  m.def("decodeImages", [] (const py::buffer& data, ImageCodec codec,                             \
+                            xt::pytensor<VALUE_TYPE, 3>& out)                                     \
+  {                                                                                               \
+    py::buffer_info info = data.request();                                                        \
+    py::gil_scoped_release release;                                                               \
+    foam::decodeImages(static_cast<const char*>(info.ptr),                                        \
+                       static_cast<std::size_t>(info.size * info.itemsize), codec, out);          \
+  }, py::arg("data"), py::arg("codec"), py::arg("out").noconvert());
+
+  FOAM_IMAGE_CODEC_IMPL(float)
+  FOAM_IMAGE_CODEC_IMPL(double)
+
+}
@@ -26,32 +26,79 @@ PYBIND11_MODULE(imageproc, m)
 
   m.doc() = "A collection of image processing functions.";
 
+  defineProfiler(m);
+
+  m.def("simdEnabled", &simdEnabled);
+  m.def("setSimdEnabled", &setSimdEnabled, py::arg("enabled"));
+
+  definePartitionConfig(m);
+
 #define FOAM_NANMEAN_IMAGE_ARRAY_IMPL(VALUE_TYPE)                                      \
   m.def("nanmeanImageArray", [] (const xt::pytensor<VALUE_TYPE, 3>& src)               \
-    { return nanmeanImageArray(src); }, py::arg("src").noconvert());
+    { return nanmeanImageArray(src); }, py::arg("src").noconvert(), release_gil());
 
 #define FOAM_NANMEAN_IMAGE_ARRAY_WITH_FILTER_IMPL(VALUE_TYPE)                                   \
   m.def("nanmeanImageArray",                                                                    \
     [] (const xt::pytensor<VALUE_TYPE, 3>& src, const std::vector<size_t>& keep)                \
-    { return nanmeanImageArray(src, keep); }, py::arg("src").noconvert(), py::arg("keep"));
-
-#define FOAM_NANMEAN_IMAGE_ARRAY_BINARY_IMPL(VALUE_TYPE)                                        \
-  m.def("nanmeanImageArray",                                                                    \
-    [] (const xt::pytensor<VALUE_TYPE, 2>& src1, const xt::pytensor<VALUE_TYPE, 2>& src2)       \
-    { return nanmeanImageArray(src1, src2); },                                                  \
-    py::arg("src1").noconvert(), py::arg("src2").noconvert());
+    { return nanmeanImageArray(src, keep); },                                                   \
+    py::arg("src").noconvert(), py::arg("keep"), release_gil());
+
+#define FOAM_NANMEAN_IMAGE_ARRAY_BINARY_IMPL(VALUE_TYPE)                                                 \
+  m.def("nanmeanImageArray",                                                                             \
+    [] (const xt::pytensor<VALUE_TYPE, 2>& src1, const xt::pytensor<VALUE_TYPE, 2>& src2)                \
+    {                                                                                                    \
+      auto mean = xt::pytensor<VALUE_TYPE, 2>::from_shape({static_cast<std::size_t>(src1.shape()[0]),    \
+                                                           static_cast<std::size_t>(src1.shape()[1])});  \
+      {                                                                                                  \
+        py::gil_scoped_release release;                                                                  \
+        nanmeanImageArray(src1, src2, mean);                                                             \
+      }                                                                                                  \
+      return mean;                                                                                       \
+    }, py::arg("src1").noconvert(), py::arg("src2").noconvert());                                        \
+  m.def("nanmeanImageArray",                                                                             \
+    [] (const xt::pytensor<VALUE_TYPE, 2>& src1, const xt::pytensor<VALUE_TYPE, 2>& src2,                \
+        xt::pytensor<VALUE_TYPE, 2>& out)                                                                \
+    { nanmeanImageArray(src1, src2, out); },                                                             \
+    py::arg("src1").noconvert(), py::arg("src2").noconvert(), py::arg("out").noconvert(), release_gil());
+
+#define FOAM_NANMEAN_IMAGE_ARRAY_WITH_OUT_IMPL(VALUE_TYPE)                        \
+  m.def("nanmeanImageArray",                                                      \
+    [] (const xt::pytensor<VALUE_TYPE, 3>& src, xt::pytensor<VALUE_TYPE, 2>& out) \
+    { nanmeanImageArray(src, out); },                                             \
+    py::arg("src").noconvert(), py::arg("out").noconvert(), release_gil());       \
+  m.def("nanmeanImageArray",                                                      \
+    [] (const xt::pytensor<VALUE_TYPE, 3>& src, const std::vector<size_t>& keep,  \
+        xt::pytensor<VALUE_TYPE, 2>& out)                                         \
+    { nanmeanImageArray(src, keep, out); },                                       \
+    py::arg("src").noconvert(), py::arg("keep"), py::arg("out").noconvert(), release_gil());
 
   FOAM_NANMEAN_IMAGE_ARRAY_IMPL(double)
   FOAM_NANMEAN_IMAGE_ARRAY_IMPL(float)
   FOAM_NANMEAN_IMAGE_ARRAY_WITH_FILTER_IMPL(double)
   FOAM_NANMEAN_IMAGE_ARRAY_WITH_FILTER_IMPL(float)
+  FOAM_NANMEAN_IMAGE_ARRAY_WITH_OUT_IMPL(double)
+  FOAM_NANMEAN_IMAGE_ARRAY_WITH_OUT_IMPL(float)
   FOAM_NANMEAN_IMAGE_ARRAY_BINARY_IMPL(double)
   FOAM_NANMEAN_IMAGE_ARRAY_BINARY_IMPL(float)
 
+#define FOAM_NANMEAN_ON_OFF_IMAGE_ARRAY_IMPL(VALUE_TYPE)                                        \
+  m.def("nanmeanOnOffImageArray",                                                               \
+    [] (const xt::pytensor<VALUE_TYPE, 3>& src,                                                 \
+        const std::vector<size_t>& on, const std::vector<size_t>& off,                          \
+        xt::pytensor<VALUE_TYPE, 2>& mean_on, xt::pytensor<VALUE_TYPE, 2>& mean_off)            \
+    {                                                                                           \
+      py::gil_scoped_release release;                                                           \
+      nanmeanOnOffImageArray(src, on, off, mean_on, mean_off);                                  \
+    }, py::arg("src").noconvert(), py::arg("on"), py::arg("off"),                               \
+       py::arg("mean_on").noconvert(), py::arg("mean_off").noconvert());
+
+  FOAM_NANMEAN_ON_OFF_IMAGE_ARRAY_IMPL(double)
+  FOAM_NANMEAN_ON_OFF_IMAGE_ARRAY_IMPL(float)
+
 #define FOAM_MOVING_AVG_IMAGE_DATA_IMPL(VALUE_TYPE, N_DIM)                                     \
   m.def("movingAvgImageData",                                                                  \
     &movingAvgImageData<xt::pytensor<VALUE_TYPE, N_DIM>>,                                      \
-    py::arg("src").noconvert(), py::arg("data").noconvert(), py::arg("count"));
+    py::arg("src").noconvert(), py::arg("data").noconvert(), py::arg("count"), release_gil());
 
   FOAM_MOVING_AVG_IMAGE_DATA_IMPL(double, 2)
   FOAM_MOVING_AVG_IMAGE_DATA_IMPL(float, 2)
@@ -65,14 +112,14 @@ PYBIND11_MODULE(imageproc, m)
 #define FOAM_IMAGE_DATA_NAN_MASK_IMPL(VALUE_TYPE, N_DIM)                                      \
   m.def("imageDataNanMask",                                                                   \
     &imageDataNanMask<xt::pytensor<VALUE_TYPE, N_DIM>, xt::pytensor<bool, N_DIM>>,            \
-    py::arg("src").noconvert(), py::arg("out").noconvert());
+    py::arg("src").noconvert(), py::arg("out").noconvert(), release_gil());
 
   FOAM_IMAGE_DATA_NAN_MASK_IMPL(double, 2)
   FOAM_IMAGE_DATA_NAN_MASK_IMPL(float, 2)
 
 #define FOAM_MASK_IMAGE_DATA_IMPL(FUNCTOR, VALUE_TYPE, N_DIM)                                 \
   m.def(#FUNCTOR,                                                                             \
-    &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>>, py::arg("src").noconvert());
+    &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>>, py::arg("src").noconvert(), release_gil());
 
 #define FOAM_MASK_IMAGE_DATA(FUNCTOR)                                                         \
   FOAM_MASK_IMAGE_DATA_IMPL(FUNCTOR, double, 2)                                               \
@@ -83,11 +130,18 @@ PYBIND11_MODULE(imageproc, m)
   FOAM_MASK_IMAGE_DATA(maskImageDataZero)
   FOAM_MASK_IMAGE_DATA(maskImageDataNan)
 
+#define FOAM_FILL_IMAGE_DATA_IMPL(VALUE_TYPE)                                                 \
+  m.def("fillImageData", &fillImageData<xt::pytensor<VALUE_TYPE, 3>, VALUE_TYPE>,            \
+    py::arg("src").noconvert(), py::arg("value"), release_gil());
+
+  FOAM_FILL_IMAGE_DATA_IMPL(double)
+  FOAM_FILL_IMAGE_DATA_IMPL(float)
+
 #define FOAM_MASK_IMAGE_DATA_THRESHOLD_IMPL(FUNCTOR, VALUE_TYPE, N_DIM)                      \
   m.def(#FUNCTOR,                                                                            \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, VALUE_TYPE, VALUE_TYPE))                     \
     &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>, VALUE_TYPE>,                                   \
-    py::arg("src").noconvert(), py::arg("lb"), py::arg("ub"));
+    py::arg("src").noconvert(), py::arg("lb"), py::arg("ub"), release_gil());
 
 #define FOAM_MASK_IMAGE_DATA_THRESHOLD(FUNCTOR)                                              \
   FOAM_MASK_IMAGE_DATA_THRESHOLD_IMPL(FUNCTOR, double, 2)                                    \
@@ -102,7 +156,7 @@ PYBIND11_MODULE(imageproc, m)
   m.def(#FUNCTOR,                                                                                     \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, VALUE_TYPE, VALUE_TYPE, xt::pytensor<bool, N_DIM>&))  \
     &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>, VALUE_TYPE, xt::pytensor<bool, N_DIM>>,                 \
-    py::arg("src").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("out").noconvert());
+    py::arg("src").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("out").noconvert(), release_gil());
 
 #define FOAM_MASK_IMAGE_DATA_THRESHOLD_WITH_OUT(FUNCTOR)                                              \
   FOAM_MASK_IMAGE_DATA_THRESHOLD_WITH_OUT_IMPL(FUNCTOR, double, 2)                                    \
@@ -115,7 +169,7 @@ PYBIND11_MODULE(imageproc, m)
   m.def(#FUNCTOR,                                                                          \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const xt::pytensor<bool, 2>&))             \
     &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>, xt::pytensor<bool, 2>>,                      \
-    py::arg("src").noconvert(), py::arg("mask").noconvert());
+    py::arg("src").noconvert(), py::arg("mask").noconvert(), release_gil());
 
 #define FOAM_MASK_IMAGE_DATA_IMAGE(FUNCTOR)                                                \
   FOAM_MASK_IMAGE_DATA_IMAGE_IMPL(FUNCTOR, double, 2)                                      \
@@ -130,7 +184,7 @@ PYBIND11_MODULE(imageproc, m)
   m.def(#FUNCTOR,                                                                                           \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const xt::pytensor<bool, 2>&, xt::pytensor<bool, N_DIM>&))  \
     &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>, xt::pytensor<bool, 2>, xt::pytensor<bool, N_DIM>>,            \
-    py::arg("src").noconvert(), py::arg("mask").noconvert(), py::arg("out").noconvert());
+    py::arg("src").noconvert(), py::arg("mask").noconvert(), py::arg("out").noconvert(), release_gil());
 
 #define FOAM_MASK_IMAGE_DATA_IMAGE_WITH_OUT(FUNCTOR)                                                \
   FOAM_MASK_IMAGE_DATA_IMAGE_WITH_OUT_IMPL(FUNCTOR, double, 2)                                      \
@@ -143,7 +197,7 @@ PYBIND11_MODULE(imageproc, m)
   m.def(#FUNCTOR,                                                                                       \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const xt::pytensor<bool, 2>&, VALUE_TYPE, VALUE_TYPE))  \
     &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>, xt::pytensor<bool, 2>, VALUE_TYPE>,                       \
-    py::arg("src").noconvert(), py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"));
+    py::arg("src").noconvert(), py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"), release_gil());
 
 #define FOAM_MASK_IMAGE_DATA_BOTH(FUNCTOR)                                                \
   FOAM_MASK_IMAGE_DATA_BOTH_IMPL(FUNCTOR, double, 2)                                      \
@@ -158,7 +212,8 @@ PYBIND11_MODULE(imageproc, m)
   m.def(#FUNCTOR,                                                                                                                   \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const xt::pytensor<bool, 2>&, VALUE_TYPE, VALUE_TYPE, xt::pytensor<bool, N_DIM>&))  \
     &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>, xt::pytensor<bool, 2>, VALUE_TYPE, xt::pytensor<bool, N_DIM>>,                        \
-    py::arg("src").noconvert(), py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("out").noconvert());
+    py::arg("src").noconvert(), py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("out").noconvert(),  \
+    release_gil());
 
 #define FOAM_MASK_IMAGE_DATA_BOTH_WITH_OUT(FUNCTOR)                                                \
   FOAM_MASK_IMAGE_DATA_BOTH_WITH_OUT_IMPL(FUNCTOR, double, 2)                                      \
@@ -167,6 +222,95 @@ PYBIND11_MODULE(imageproc, m)
   FOAM_MASK_IMAGE_DATA_BOTH_WITH_OUT(maskImageDataZero)
   FOAM_MASK_IMAGE_DATA_BOTH_WITH_OUT(maskImageDataNan)
 
+  //
+  // bit-packed mask
+  //
+
+  py::class_<BitMask>(m, "BitMask")
+    .def(py::init<std::size_t, std::size_t, bool>(), py::arg("ny"), py::arg("nx"), py::arg("value") = false)
+    .def(py::init<const xt::pytensor<bool, 2>&>(), py::arg("mask").noconvert(), release_gil())
+    .def_static("frombytes", [] (std::size_t ny, std::size_t nx, const py::buffer& data)
+    {
+      py::buffer_info info = data.request();
+      return BitMask::fromBytes(ny, nx, static_cast<const uint8_t*>(info.ptr),
+                                static_cast<std::size_t>(info.size * info.itemsize));
+    }, py::arg("ny"), py::arg("nx"), py::arg("data"))
+    .def_property_readonly("shape", [] (const BitMask& self)
+    {
+      return py::make_tuple(self.shape()[0], self.shape()[1]);
+    })
+    .def("count", &BitMask::count)
+    .def("any", &BitMask::any)
+    .def("fill", &BitMask::fill, py::arg("value"))
+    .def("tobytes", [] (const BitMask& self)
+    {
+      return py::bytes(reinterpret_cast<const char*>(self.bytes()), self.nBytes());
+    })
+    .def("toImageMask", [] (const BitMask& self)
+    {
+      auto out = xt::pytensor<bool, 2>::from_shape({self.shape()[0], self.shape()[1]});
+      {
+        py::gil_scoped_release release;
+        self.toImageMask(out);
+      }
+      return out;
+    })
+    .def("__and__", [] (const BitMask& self, const BitMask& other) { return self & other; }, py::is_operator())
+    .def("__or__", [] (const BitMask& self, const BitMask& other) { return self | other; }, py::is_operator())
+    .def("__iand__", [] (BitMask& self, const BitMask& other) -> BitMask& { return self &= other; },
+         py::is_operator())
+    .def("__ior__", [] (BitMask& self, const BitMask& other) -> BitMask& { return self |= other; },
+         py::is_operator())
+    .def("__eq__", [] (const BitMask& self, const BitMask& other) { return self == other; }, py::is_operator());
+
+#define FOAM_IMAGE_DATA_BITMASK_IMPL(VALUE_TYPE)                                                     \
+  m.def("imageDataNanMask",                                                                          \
+    (void (*)(const xt::pytensor<VALUE_TYPE, 2>&, BitMask&))                                         \
+    &imageDataNanMask<xt::pytensor<VALUE_TYPE, 2>>,                                                  \
+    py::arg("src").noconvert(), py::arg("out"), release_gil());                                      \
+  m.def("imageDataThresholdMask",                                                                    \
+    &imageDataThresholdMask<xt::pytensor<VALUE_TYPE, 2>, VALUE_TYPE>,                                \
+    py::arg("src").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("out"), release_gil());
+
+  FOAM_IMAGE_DATA_BITMASK_IMPL(double)
+  FOAM_IMAGE_DATA_BITMASK_IMPL(float)
+
+#define FOAM_MASK_IMAGE_DATA_BITMASK_IMPL(FUNCTOR, VALUE_TYPE, N_DIM)                                \
+  m.def(#FUNCTOR,                                                                                    \
+    (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const BitMask&))                                     \
+    &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>>,                                                       \
+    py::arg("src").noconvert(), py::arg("mask"), release_gil());                                     \
+  m.def(#FUNCTOR,                                                                                    \
+    (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const BitMask&, VALUE_TYPE, VALUE_TYPE))             \
+    &FUNCTOR<xt::pytensor<VALUE_TYPE, N_DIM>, VALUE_TYPE>,                                           \
+    py::arg("src").noconvert(), py::arg("mask"), py::arg("lb"), py::arg("ub"), release_gil());
+
+#define FOAM_MASK_IMAGE_DATA_BITMASK_WITH_OUT_IMPL(FUNCTOR, VALUE_TYPE)                              \
+  m.def(#FUNCTOR,                                                                                    \
+    (void (*)(xt::pytensor<VALUE_TYPE, 2>&, VALUE_TYPE, VALUE_TYPE, BitMask&))                       \
+    &FUNCTOR<xt::pytensor<VALUE_TYPE, 2>, VALUE_TYPE>,                                               \
+    py::arg("src").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("out"), release_gil());        \
+  m.def(#FUNCTOR,                                                                                    \
+    (void (*)(xt::pytensor<VALUE_TYPE, 2>&, const BitMask&, BitMask&))                               \
+    &FUNCTOR<xt::pytensor<VALUE_TYPE, 2>>,                                                           \
+    py::arg("src").noconvert(), py::arg("mask"), py::arg("out"), release_gil());                     \
+  m.def(#FUNCTOR,                                                                                    \
+    (void (*)(xt::pytensor<VALUE_TYPE, 2>&, const BitMask&, VALUE_TYPE, VALUE_TYPE, BitMask&))       \
+    &FUNCTOR<xt::pytensor<VALUE_TYPE, 2>, VALUE_TYPE>,                                               \
+    py::arg("src").noconvert(), py::arg("mask"), py::arg("lb"), py::arg("ub"), py::arg("out"),       \
+    release_gil());
+
+#define FOAM_MASK_IMAGE_DATA_BITMASK(FUNCTOR)                                                        \
+  FOAM_MASK_IMAGE_DATA_BITMASK_IMPL(FUNCTOR, double, 2)                                              \
+  FOAM_MASK_IMAGE_DATA_BITMASK_IMPL(FUNCTOR, float, 2)                                               \
+  FOAM_MASK_IMAGE_DATA_BITMASK_IMPL(FUNCTOR, double, 3)                                              \
+  FOAM_MASK_IMAGE_DATA_BITMASK_IMPL(FUNCTOR, float, 3)                                               \
+  FOAM_MASK_IMAGE_DATA_BITMASK_WITH_OUT_IMPL(FUNCTOR, double)                                        \
+  FOAM_MASK_IMAGE_DATA_BITMASK_WITH_OUT_IMPL(FUNCTOR, float)
+
+  FOAM_MASK_IMAGE_DATA_BITMASK(maskImageDataZero)
+  FOAM_MASK_IMAGE_DATA_BITMASK(maskImageDataNan)
+
   //
   // gain / offset correction
   //
@@ -175,7 +319,7 @@ PYBIND11_MODULE(imageproc, m)
   m.def("correctOffset",                                                                    \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const xt::pytensor<VALUE_TYPE, N_DIM>&))    \
     &correctImageData<OffsetPolicy, xt::pytensor<VALUE_TYPE, N_DIM>>,                       \
-    py::arg("src").noconvert(), py::arg("offset").noconvert());
+    py::arg("src").noconvert(), py::arg("offset").noconvert(), release_gil());
 
   FOAM_CORRECT_OFFSET_IMPL(double, 2)
   FOAM_CORRECT_OFFSET_IMPL(float, 2)
@@ -186,7 +330,7 @@ PYBIND11_MODULE(imageproc, m)
   m.def("correctGain",                                                                      \
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&, const xt::pytensor<VALUE_TYPE, N_DIM>&))    \
     &correctImageData<GainPolicy, xt::pytensor<VALUE_TYPE, N_DIM>>,                         \
-    py::arg("src").noconvert(), py::arg("gain").noconvert());
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), release_gil());
 
   FOAM_CORRECT_GAIN_IMPL(double, 2)
   FOAM_CORRECT_GAIN_IMPL(float, 2)
@@ -198,10 +342,96 @@ PYBIND11_MODULE(imageproc, m)
     (void (*)(xt::pytensor<VALUE_TYPE, N_DIM>&,                                                 \
               const xt::pytensor<VALUE_TYPE, N_DIM>&, const xt::pytensor<VALUE_TYPE, N_DIM>&))  \
     &correctImageData<xt::pytensor<VALUE_TYPE, N_DIM>>,                                         \
-    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert());
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(), release_gil());
 
   FOAM_CORRECT_GAIN_AND_OFFSET_IMPL(double, 2)
   FOAM_CORRECT_GAIN_AND_OFFSET_IMPL(float, 2)
   FOAM_CORRECT_GAIN_AND_OFFSET_IMPL(double, 3)
   FOAM_CORRECT_GAIN_AND_OFFSET_IMPL(float, 3)
+
+  //
+  // fused correction, masking and nanmean
+  //
+
+#define FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_IMPL(VALUE_TYPE)                                              \
+  m.def("correctMaskNanmeanImageArray",                                                                   \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                                 \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,               \
+        const xt::pytensor<bool, 2>& mask, VALUE_TYPE lb, VALUE_TYPE ub)                                  \
+    { return correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub); },                            \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),               \
+    py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"), release_gil());
+
+#define FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_WITH_FILTER_IMPL(VALUE_TYPE)                                  \
+  m.def("correctMaskNanmeanImageArray",                                                                   \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                                 \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,               \
+        const xt::pytensor<bool, 2>& mask, VALUE_TYPE lb, VALUE_TYPE ub, const std::vector<size_t>& keep) \
+    { return correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub, keep); },                      \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),               \
+    py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("keep"), release_gil());
+
+#define FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_BITMASK_IMPL(VALUE_TYPE)                                      \
+  m.def("correctMaskNanmeanImageArray",                                                                   \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                                 \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,               \
+        const BitMask& mask, VALUE_TYPE lb, VALUE_TYPE ub)                                                \
+    { return correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub); },                            \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),               \
+    py::arg("mask"), py::arg("lb"), py::arg("ub"), release_gil());                                        \
+  m.def("correctMaskNanmeanImageArray",                                                                   \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                                 \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,               \
+        const BitMask& mask, VALUE_TYPE lb, VALUE_TYPE ub, const std::vector<size_t>& keep)               \
+    { return correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub, keep); },                      \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),               \
+    py::arg("mask"), py::arg("lb"), py::arg("ub"), py::arg("keep"), release_gil());
+
+#define FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_WITH_OUT_IMPL(VALUE_TYPE)                                     \
+  m.def("correctMaskNanmeanImageArray",                                                                     \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                                   \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,                 \
+        const xt::pytensor<bool, 2>& mask, VALUE_TYPE lb, VALUE_TYPE ub,                                    \
+        xt::pytensor<VALUE_TYPE, 2>& out)                                                                   \
+    { correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub, out); },                                \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),                 \
+    py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("out").noconvert(), release_gil());  \
+  m.def("correctMaskNanmeanImageArray",                                                                     \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                                   \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,                 \
+        const xt::pytensor<bool, 2>& mask, VALUE_TYPE lb, VALUE_TYPE ub, const std::vector<size_t>& keep,   \
+        xt::pytensor<VALUE_TYPE, 2>& out)                                                                   \
+    { correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub, keep, out); },                          \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),                 \
+    py::arg("mask").noconvert(), py::arg("lb"), py::arg("ub"), py::arg("keep"), py::arg("out").noconvert(), \
+    release_gil());
+
+#define FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_BITMASK_WITH_OUT_IMPL(VALUE_TYPE)                 \
+  m.def("correctMaskNanmeanImageArray",                                                         \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                       \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,     \
+        const BitMask& mask, VALUE_TYPE lb, VALUE_TYPE ub, xt::pytensor<VALUE_TYPE, 2>& out)    \
+    { correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub, out); },                    \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),     \
+    py::arg("mask"), py::arg("lb"), py::arg("ub"), py::arg("out").noconvert(), release_gil());  \
+  m.def("correctMaskNanmeanImageArray",                                                         \
+    [] (xt::pytensor<VALUE_TYPE, 3>& src,                                                       \
+        const xt::pytensor<VALUE_TYPE, 3>& gain, const xt::pytensor<VALUE_TYPE, 3>& offset,     \
+        const BitMask& mask, VALUE_TYPE lb, VALUE_TYPE ub, const std::vector<size_t>& keep,     \
+        xt::pytensor<VALUE_TYPE, 2>& out)                                                       \
+    { correctMaskNanmeanImageArray(src, gain, offset, mask, lb, ub, keep, out); },              \
+    py::arg("src").noconvert(), py::arg("gain").noconvert(), py::arg("offset").noconvert(),     \
+    py::arg("mask"), py::arg("lb"), py::arg("ub"), py::arg("keep"), py::arg("out").noconvert(), \
+    release_gil());
+
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_IMPL(double)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_IMPL(float)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_WITH_FILTER_IMPL(double)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_WITH_FILTER_IMPL(float)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_BITMASK_IMPL(double)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_BITMASK_IMPL(float)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_WITH_OUT_IMPL(double)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_WITH_OUT_IMPL(float)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_BITMASK_WITH_OUT_IMPL(double)
+  FOAM_CORRECT_MASK_NANMEAN_IMAGE_ARRAY_BITMASK_WITH_OUT_IMPL(float)
 }
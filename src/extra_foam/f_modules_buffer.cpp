@@ -0,0 +1,68 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <vector>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/numpy.h"
+
+#include "f_modules_buffer.hpp"
+#include "f_pyconfig.hpp"
+
+namespace py = pybind11;
+
+
+PYBIND11_MODULE(modules_buffer, m)
+{
+  xt::import_numpy();
+
+  using ModulesBuffer = foam::ModulesBuffer<float>;
+
+  m.doc() = "Persistent buffer of modules data.";
+
+  foam::definePartitionConfig(m);
+
+  py::class_<ModulesBuffer> cls(m, "ModulesBuffer");
+
+  cls.def(py::init<std::size_t, std::size_t, std::size_t, bool>(),
+          py::arg("n_modules"), py::arg("ny"), py::arg("nx"), py::arg("pin") = false)
+    .def("reset", &ModulesBuffer::reset, py::arg("n_pulses"))
+    .def("fillMissing", &ModulesBuffer::fillMissing, py::arg("value"), foam::release_gil())
+    .def("arrived", &ModulesBuffer::arrived, py::arg("im"))
+    .def("nArrived", &ModulesBuffer::nArrived)
+    .def("complete", &ModulesBuffer::complete)
+    .def_property_readonly("shape", [] (const ModulesBuffer& self)
+    {
+      const auto& s = self.shape();
+      return py::make_tuple(s[0], s[1], s[2], s[3]);
+    })
+    .def_property_readonly("capacity", &ModulesBuffer::capacity)
+    .def_property_readonly("pinned", &ModulesBuffer::pinned)
+    // The returned array is a view of the buffer, which is overwritten by
+    // the next train.
+    .def_property_readonly("data", [] (py::object self)
+    {
+      auto& buffer = self.cast<ModulesBuffer&>();
+      const auto& s = buffer.shape();
+      std::vector<py::ssize_t> shape(s.begin(), s.end());
+      return py::array_t<float>(shape, buffer.data(), self);
+    });
+
+#define FOAM_SET_MODULE_IMPL(SRC_TYPE)                                                              \
+  cls.def("setModule", [] (ModulesBuffer& self, std::size_t im, const xt::pytensor<SRC_TYPE, 3>& src) \
+  {                                                                                                   \
+    py::gil_scoped_release release;                                                                   \
+    self.setModule(im, src);                                                                          \
+  }, py::arg("im"), py::arg("src").noconvert());
+
+  FOAM_SET_MODULE_IMPL(float)
+  FOAM_SET_MODULE_IMPL(uint16_t)
+  FOAM_SET_MODULE_IMPL(int16_t)
+  FOAM_SET_MODULE_IMPL(uint32_t)
+}
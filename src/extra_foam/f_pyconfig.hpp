@@ -11,6 +11,9 @@
 #include "xtensor-python/pytensor.hpp"
 #include "xtensor-python/pyarray.hpp"
 
+#include "f_parallel.hpp"
+#include "f_profiler.hpp"
+
 namespace foam
 {
 
@@ -32,4 +35,80 @@ struct IsModulesArray<xt::pytensor<T, 4, L>> : std::true_type {};
 template<typename T, xt::layout_type L>
 struct IsModulesVector<std::vector<xt::pytensor<T, 3, L>>> : std::true_type {};
 
+/**
+ * Release the GIL during the call of a binding.
+ *
+ * It is only used by the bindings of kernels which do not touch any Python
+ * object, i.e. kernels which write into arrays allocated beforehand or return
+ * xtensor containers, which are converted to numpy arrays after the GIL has
+ * been re-acquired. Other Python threads must not modify the arrays passed to
+ * such a kernel during the call.
+ */
+using release_gil = pybind11::call_guard<pybind11::gil_scoped_release>;
+
+/**
+ * Define the bindings of the kernel profiler of a module.
+ *
+ * The latencies are reported in nanoseconds. Each module has its own
+ * profiler, which only records the kernels called through it.
+ */
+inline void defineProfiler(pybind11::module& m)
+{
+  namespace py = pybind11;
+
+  m.def("setProfilingEnabled", [] (bool enabled) { profiler::Registry::instance().setEnabled(enabled); },
+        py::arg("enabled"));
+  m.def("profilingEnabled", [] () { return profiler::Registry::instance().enabled(); });
+  m.def("resetProfiling", [] () { profiler::Registry::instance().reset(); });
+  m.def("profilingStats", [] (bool reset)
+    {
+      std::vector<profiler::StageStats> stats;
+      {
+        py::gil_scoped_release release;
+        stats = profiler::Registry::instance().collect(reset);
+      }
+
+      py::dict ret;
+      for (const auto& s : stats)
+      {
+        if (s.count == 0) continue;
+        py::dict d;
+        d["count"] = s.count;
+        d["total_ns"] = s.total_ns;
+        d["max_ns"] = s.latency.max();
+        d["p50_ns"] = s.latency.quantile(0.5);
+        d["p99_ns"] = s.latency.quantile(0.99);
+        d["bytes"] = s.bytes;
+        d["tasks"] = s.tasks;
+        d["allocations"] = s.allocations;
+        ret[py::str(s.name)] = d;
+      }
+      return ret;
+    }, py::arg("reset") = false);
+}
+
+/**
+ * Define the bindings of the partition config of a module.
+ *
+ * Each module has its own copy of the config, which is only used by the
+ * kernels called through it. Therefore, the config must be set in all the
+ * modules, e.g. by extra_foam.algorithms.set_partition_config.
+ */
+inline void definePartitionConfig(pybind11::module& m)
+{
+  namespace py = pybind11;
+
+  m.def("setPartitionConfig",
+    [] (const std::string& mode, std::size_t grain_size, bool affinity, bool numa)
+    { setPartitionConfig({toPartitionMode(mode), grain_size, affinity, numa}); },
+    py::arg("mode") = "row", py::arg("grain_size") = 1, py::arg("affinity") = true,
+    py::arg("numa") = false);
+  m.def("partitionConfig", [] ()
+    {
+      auto config = partitionConfig();
+      return py::make_tuple(toString(config.mode), config.grain_size, config.affinity, config.numa);
+    });
+  m.def("numaNodeCount", &numaNodeCount);
+}
+
 } // foam
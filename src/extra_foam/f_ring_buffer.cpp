@@ -0,0 +1,146 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <sstream>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/numpy.h"
+#include "pybind11/stl.h"
+
+#include "f_ring_buffer.hpp"
+
+namespace py = pybind11;
+
+
+namespace
+{
+
+using foam::SharedRingBuffer;
+
+SharedRingBuffer::SlotInfo slotInfo(uint64_t tid, const py::array& arr)
+{
+  if (!(arr.flags() & py::array::c_style)) throw std::invalid_argument("Array must be C-contiguous!");
+
+  auto ndim = static_cast<std::size_t>(arr.ndim());
+  if (ndim > SharedRingBuffer::kMaxDims)
+  {
+    std::stringstream ss;
+    ss << "Number of dimensions must not exceed " << SharedRingBuffer::kMaxDims << ", got " << ndim;
+    throw std::invalid_argument(ss.str());
+  }
+
+  std::string dtype = py::str(arr.dtype());
+  if (dtype.size() >= SharedRingBuffer::kMaxDtypeLength)
+    throw std::invalid_argument("Unsupported data type: " + dtype);
+
+  SharedRingBuffer::SlotInfo info;
+  info.tid = tid;
+  info.ndim = ndim;
+  for (std::size_t i = 0; i < ndim; ++i) info.shape[i] = static_cast<uint64_t>(arr.shape(i));
+  info.nbytes = static_cast<uint64_t>(arr.nbytes());
+  std::strcpy(info.dtype, dtype.c_str());
+  return info;
+}
+
+std::vector<py::ssize_t> slotShape(const SharedRingBuffer::SlotInfo& info)
+{
+  return std::vector<py::ssize_t>(info.shape, info.shape + info.ndim);
+}
+
+} // namespace
+
+
+PYBIND11_MODULE(ring_buffer, m)
+{
+  using foam::RingBufferHandle;
+
+  m.doc() = "Shared-memory ring buffer of train data.";
+
+  py::class_<RingBufferHandle>(m, "RingBufferHandle")
+    .def(py::init([] (std::size_t slot, uint64_t seq, uint64_t tid)
+    {
+      return RingBufferHandle {slot, seq, tid};
+    }), py::arg("slot"), py::arg("seq"), py::arg("tid"))
+    .def_readonly("slot", &RingBufferHandle::slot)
+    .def_readonly("seq", &RingBufferHandle::seq)
+    .def_readonly("tid", &RingBufferHandle::tid)
+    .def("__repr__", [] (const RingBufferHandle& self)
+    {
+      std::stringstream ss;
+      ss << "RingBufferHandle(slot=" << self.slot << ", seq=" << self.seq << ", tid=" << self.tid << ")";
+      return ss.str();
+    })
+    .def(py::pickle(
+      [] (const RingBufferHandle& self) { return py::make_tuple(self.slot, self.seq, self.tid); },
+      [] (const py::tuple& t)
+      {
+        return RingBufferHandle {t[0].cast<std::size_t>(), t[1].cast<uint64_t>(), t[2].cast<uint64_t>()};
+      }
+    ));
+
+  py::class_<SharedRingBuffer> cls(m, "SharedRingBuffer");
+
+  cls.def(py::init<const std::string&, std::size_t, std::size_t>(),
+          py::arg("name"), py::arg("n_slots"), py::arg("slot_size"))
+    .def(py::init<const std::string&>(), py::arg("name"))
+    .def_property_readonly("name", &SharedRingBuffer::name)
+    .def_property_readonly("owner", &SharedRingBuffer::owner)
+    .def_property_readonly("n_slots", &SharedRingBuffer::nSlots)
+    .def_property_readonly("slot_size", &SharedRingBuffer::slotSize)
+    .def("write", [] (SharedRingBuffer& self, uint64_t tid, const py::array& arr)
+    {
+      auto info = slotInfo(tid, arr);
+      const void* data = arr.data();
+      py::gil_scoped_release release;
+      return self.write(data, info);
+    }, py::arg("tid"), py::arg("arr"))
+    // The returned array is a writable view of the claimed slot, which is
+    // published by passing it to publish().
+    .def("claim", [] (SharedRingBuffer& self, const std::vector<py::ssize_t>& shape, const py::dtype& dtype)
+    {
+      py::ssize_t nbytes = dtype.itemsize();
+      for (auto s : shape) nbytes *= s;
+      if (static_cast<std::size_t>(nbytes) > self.slotSize())
+      {
+        std::stringstream ss;
+        ss << "Data size " << nbytes << " exceeds the slot size " << self.slotSize();
+        throw std::invalid_argument(ss.str());
+      }
+      self.claim();
+      return py::array(dtype, shape, self.claimedData(), py::cast(self, py::return_value_policy::reference));
+    }, py::arg("shape"), py::arg("dtype"))
+    .def("publish", [] (SharedRingBuffer& self, uint64_t tid, const py::array& arr)
+    {
+      if (arr.data() != self.claimedData())
+        throw std::invalid_argument("The array is not a view of the claimed slot!");
+      return self.publish(slotInfo(tid, arr));
+    }, py::arg("tid"), py::arg("arr"))
+    .def("abandon", &SharedRingBuffer::abandon)
+    .def("latest", [] (const SharedRingBuffer& self) -> py::object
+    {
+      RingBufferHandle handle;
+      if (self.latest(handle)) return py::cast(handle);
+      return py::none();
+    })
+    .def("acquire", &SharedRingBuffer::acquire, py::arg("handle"))
+    .def("release", &SharedRingBuffer::release, py::arg("handle"))
+    .def("recover", &SharedRingBuffer::recover)
+    .def("n_holders", &SharedRingBuffer::nHolders, py::arg("slot"))
+    .def("valid", &SharedRingBuffer::valid, py::arg("handle"))
+    // The returned array is a read-only view of the slot, which is only
+    // meaningful while the slot is held.
+    .def("view", [] (SharedRingBuffer& self, const RingBufferHandle& handle)
+    {
+      const auto& info = self.info(handle.slot);
+      py::array arr(py::dtype(std::string(info.dtype)), slotShape(info), self.slotData(handle.slot),
+                    py::cast(self, py::return_value_policy::reference));
+      arr.attr("setflags")(py::arg("write") = false);
+      return arr;
+    }, py::arg("handle"));
+}
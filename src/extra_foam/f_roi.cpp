@@ -0,0 +1,114 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <limits>
+
+#include "pybind11/pybind11.h"
+#include "pybind11/stl.h"
+
+#include "xtensor/xtensor.hpp"
+
+#include "f_roi.hpp"
+#include "f_pyconfig.hpp"
+
+namespace py = pybind11;
+
+
+PYBIND11_MODULE(roi, m)
+{
+  xt::import_numpy();
+
+  using foam::RoiStat;
+
+  m.doc() = "ROI analysis over arrays of images.";
+
+  foam::defineProfiler(m);
+  foam::definePartitionConfig(m);
+
+  const double inf = std::numeric_limits<double>::infinity();
+
+  py::enum_<RoiStat>(m, "RoiStat")
+    .value("COUNT", RoiStat::COUNT)
+    .value("SUM", RoiStat::SUM)
+    .value("MEAN", RoiStat::MEAN)
+    .value("MEDIAN", RoiStat::MEDIAN)
+    .value("MIN", RoiStat::MIN)
+    .value("MAX", RoiStat::MAX)
+    .value("VAR", RoiStat::VAR)
+    .value("STD", RoiStat::STD);
+
+  m.attr("N_ROI_STATS") = foam::kNumRoiStats;
+
+#define FOAM_ROI_STATISTICS_IMP(VALUE_TYPE)                                                                  \
+  m.def("roiStatistics", [] (const xt::pytensor<VALUE_TYPE, 3>& src,                                         \
+                             const std::vector<std::array<int, 4>>& rois,                                    \
+                             double lb, double ub, bool with_median)                                         \
+  {                                                                                                          \
+    return foam::roiStatistics<xt::xtensor<VALUE_TYPE, 3>>(src, rois, lb, ub, with_median);                  \
+  }, py::arg("src").noconvert(), py::arg("rois"), py::arg("lb") = -inf, py::arg("ub") = inf,                 \
+     py::arg("with_median") = false, foam::release_gil());                                                   \
+  m.def("roiStatistics", [] (const xt::pytensor<VALUE_TYPE, 3>& src,                                         \
+                             const std::vector<std::array<int, 4>>& rois,                                    \
+                             const xt::pytensor<bool, 2>& mask, double lb, double ub, bool with_median)      \
+  {                                                                                                          \
+    return foam::roiStatistics<xt::xtensor<VALUE_TYPE, 3>>(src, rois, mask, lb, ub, with_median);            \
+  }, py::arg("src").noconvert(), py::arg("rois"), py::arg("mask").noconvert(),                               \
+     py::arg("lb") = -inf, py::arg("ub") = inf, py::arg("with_median") = false, foam::release_gil());        \
+  m.def("roiStatistics", [] (const xt::pytensor<VALUE_TYPE, 3>& src,                                         \
+                             const std::vector<std::array<int, 4>>& rois,                                    \
+                             double lb, double ub, bool with_median, xt::pytensor<VALUE_TYPE, 3>& out)       \
+  {                                                                                                          \
+    foam::roiStatistics(src, rois, lb, ub, with_median, out);                                                \
+  }, py::arg("src").noconvert(), py::arg("rois"), py::arg("lb"), py::arg("ub"), py::arg("with_median"),      \
+     py::arg("out").noconvert(), foam::release_gil());                                                       \
+  m.def("roiStatistics", [] (const xt::pytensor<VALUE_TYPE, 3>& src,                                         \
+                             const std::vector<std::array<int, 4>>& rois,                                    \
+                             const xt::pytensor<bool, 2>& mask, double lb, double ub, bool with_median,      \
+                             xt::pytensor<VALUE_TYPE, 3>& out)                                               \
+  {                                                                                                          \
+    foam::roiStatistics(src, rois, mask, lb, ub, with_median, out);                                          \
+  }, py::arg("src").noconvert(), py::arg("rois"), py::arg("mask").noconvert(), py::arg("lb"),               \
+     py::arg("ub"), py::arg("with_median"), py::arg("out").noconvert(), foam::release_gil());
+
+  FOAM_ROI_STATISTICS_IMP(float)
+  FOAM_ROI_STATISTICS_IMP(double)
+
+#define FOAM_ROI_PROJECTION_IMP(VALUE_TYPE)                                                                  \
+  m.def("roiProjection", [] (const xt::pytensor<VALUE_TYPE, 3>& src, const std::array<int, 4>& roi,          \
+                             const std::string& direction, bool mean, double lb, double ub)                  \
+  {                                                                                                          \
+    return foam::roiProjection<xt::xtensor<VALUE_TYPE, 2>>(src, roi, direction, mean, lb, ub);               \
+  }, py::arg("src").noconvert(), py::arg("roi"), py::arg("direction"), py::arg("mean") = false,              \
+     py::arg("lb") = -inf, py::arg("ub") = inf, foam::release_gil());                                        \
+  m.def("roiProjection", [] (const xt::pytensor<VALUE_TYPE, 3>& src, const std::array<int, 4>& roi,          \
+                             const xt::pytensor<bool, 2>& mask,                                              \
+                             const std::string& direction, bool mean, double lb, double ub)                  \
+  {                                                                                                          \
+    return foam::roiProjection<xt::xtensor<VALUE_TYPE, 2>>(src, roi, mask, direction, mean, lb, ub);         \
+  }, py::arg("src").noconvert(), py::arg("roi"), py::arg("mask").noconvert(), py::arg("direction"),          \
+     py::arg("mean") = false, py::arg("lb") = -inf, py::arg("ub") = inf, foam::release_gil());               \
+  m.def("roiProjection", [] (const xt::pytensor<VALUE_TYPE, 3>& src, const std::array<int, 4>& roi,          \
+                             const std::string& direction, bool mean, double lb, double ub,                  \
+                             xt::pytensor<VALUE_TYPE, 2>& out)                                               \
+  {                                                                                                          \
+    foam::roiProjection(src, roi, direction, mean, lb, ub, out);                                             \
+  }, py::arg("src").noconvert(), py::arg("roi"), py::arg("direction"), py::arg("mean"),                      \
+     py::arg("lb"), py::arg("ub"), py::arg("out").noconvert(), foam::release_gil());                         \
+  m.def("roiProjection", [] (const xt::pytensor<VALUE_TYPE, 3>& src, const std::array<int, 4>& roi,          \
+                             const xt::pytensor<bool, 2>& mask,                                              \
+                             const std::string& direction, bool mean, double lb, double ub,                  \
+                             xt::pytensor<VALUE_TYPE, 2>& out)                                               \
+  {                                                                                                          \
+    foam::roiProjection(src, roi, mask, direction, mean, lb, ub, out);                                       \
+  }, py::arg("src").noconvert(), py::arg("roi"), py::arg("mask").noconvert(), py::arg("direction"),          \
+     py::arg("mean"), py::arg("lb"), py::arg("ub"), py::arg("out").noconvert(), foam::release_gil());
+
+  FOAM_ROI_PROJECTION_IMP(float)
+  FOAM_ROI_PROJECTION_IMP(double)
+}
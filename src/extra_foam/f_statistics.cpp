@@ -12,6 +12,9 @@
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 
+#include "xtensor/xarray.hpp"
+#include "xtensor/xtensor.hpp"
+
 #include "f_statistics.hpp"
 #include "f_pyconfig.hpp"
 
@@ -27,19 +30,35 @@ PYBIND11_MODULE(statistics, m)
 
   m.doc() = "A collection of statistics functions.";
 
+  defineProfiler(m);
+  definePartitionConfig(m);
+
+// The results are returned as xtensor containers so that the reductions can
+// run without the GIL. Alternatively, they are written to a pre-allocated
+// "out" array.
 #define FOAM_NAN_REDUCER_IMP(REDUCER, VALUE_TYPE, N_DIM)                                          \
   m.def(#REDUCER, [] (const xt::pytensor<VALUE_TYPE, N_DIM>& src, const std::vector<int>& axis)   \
   {                                                                                               \
-    return xt::eval(xt::REDUCER<VALUE_TYPE>(src, axis));                                          \
-  }, py::arg("src").noconvert(), py::arg("axis"));                                                \
+    return foam::REDUCER<xt::xarray<VALUE_TYPE>>(src, axis);                                      \
+  }, py::arg("src").noconvert(), py::arg("axis"), release_gil());                                 \
   m.def(#REDUCER, [] (const xt::pytensor<VALUE_TYPE, N_DIM>& src, int axis)                       \
   {                                                                                               \
-    return xt::eval(xt::REDUCER<VALUE_TYPE>(src, {axis}));                                        \
-  }, py::arg("src").noconvert(), py::arg("axis"));                                                \
+    return foam::REDUCER<xt::xarray<VALUE_TYPE>>(src, {axis});                                    \
+  }, py::arg("src").noconvert(), py::arg("axis"), release_gil());                                 \
+  m.def(#REDUCER, [] (const xt::pytensor<VALUE_TYPE, N_DIM>& src, const std::vector<int>& axis,   \
+                      xt::pyarray<VALUE_TYPE>& out)                                               \
+  {                                                                                               \
+    foam::REDUCER(src, axis, out);                                                                \
+  }, py::arg("src").noconvert(), py::arg("axis"), py::arg("out").noconvert(), release_gil());     \
+  m.def(#REDUCER, [] (const xt::pytensor<VALUE_TYPE, N_DIM>& src, int axis,                       \
+                      xt::pyarray<VALUE_TYPE>& out)                                               \
+  {                                                                                               \
+    foam::REDUCER(src, {axis}, out);                                                              \
+  }, py::arg("src").noconvert(), py::arg("axis"), py::arg("out").noconvert(), release_gil());     \
   m.def(#REDUCER, [] (const xt::pytensor<VALUE_TYPE, N_DIM>& src)                                 \
   {                                                                                               \
-    return xt::eval(xt::REDUCER<VALUE_TYPE>(src))[0];                                             \
-  }, py::arg("src").noconvert());
+    return foam::REDUCER(src);                                                                    \
+  }, py::arg("src").noconvert(), release_gil());
 
 #define FOAM_NAN_REDUCER_ALL_DIMENSIONS(FUNCTOR, VALUE_TYPE)                                   \
   FOAM_NAN_REDUCER_IMP(FUNCTOR, VALUE_TYPE, 1)                                                 \
@@ -54,5 +73,50 @@ PYBIND11_MODULE(statistics, m)
 
   FOAM_NAN_REDUCER(nansum)
   FOAM_NAN_REDUCER(nanmean)
+  FOAM_NAN_REDUCER(nanvar)
+  FOAM_NAN_REDUCER(nanstd)
+  FOAM_NAN_REDUCER(nanmin)
+  FOAM_NAN_REDUCER(nanmax)
+
+#define FOAM_HISTOGRAM_WITH_STATS_IMP(VALUE_TYPE, N_DIM)                                          \
+  m.def("histogramWithStats", [] (const xt::pytensor<VALUE_TYPE, N_DIM>& src,                    \
+                                  std::size_t n_bins, double lb, double ub)                      \
+  {                                                                                               \
+    return foam::histogramWithStats<xt::xtensor<int64_t, 1>, xt::xtensor<double, 1>>(            \
+      src, n_bins, lb, ub);                                                                       \
+  }, py::arg("src").noconvert(), py::arg("n_bins"), py::arg("lb"), py::arg("ub"), release_gil());
+
+#define FOAM_HISTOGRAM_WITH_STATS(VALUE_TYPE)                                                  \
+  FOAM_HISTOGRAM_WITH_STATS_IMP(VALUE_TYPE, 1)                                                 \
+  FOAM_HISTOGRAM_WITH_STATS_IMP(VALUE_TYPE, 2)                                                 \
+  FOAM_HISTOGRAM_WITH_STATS_IMP(VALUE_TYPE, 3)
+
+  FOAM_HISTOGRAM_WITH_STATS(float)
+  FOAM_HISTOGRAM_WITH_STATS(double)
+
+#define FOAM_QUICK_MIN_MAX_IMP(VALUE_TYPE, N_DIM)                                                 \
+  m.def("quickMinMax", [] (const xt::pytensor<VALUE_TYPE, N_DIM>& src, double q)                  \
+  {                                                                                               \
+    return foam::quickMinMax(src, q);                                                             \
+  }, py::arg("src").noconvert(), py::arg("q") = 1., release_gil());
+
+  FOAM_QUICK_MIN_MAX_IMP(float, 2)
+  FOAM_QUICK_MIN_MAX_IMP(double, 2)
+  FOAM_QUICK_MIN_MAX_IMP(float, 3)
+  FOAM_QUICK_MIN_MAX_IMP(double, 3)
+
+#define FOAM_NAN_DOWN_SAMPLE_IMAGE_IMP(VALUE_TYPE)                                                \
+  m.def("nanDownSampleImage", [] (const xt::pytensor<VALUE_TYPE, 2>& src, std::size_t rate)       \
+  {                                                                                               \
+    return foam::nanDownSampleImage<xt::xtensor<VALUE_TYPE, 2>>(src, rate);                       \
+  }, py::arg("src").noconvert(), py::arg("rate"), release_gil());                                 \
+  m.def("nanDownSampleImageWithLevels", [] (const xt::pytensor<VALUE_TYPE, 2>& src,               \
+                                            std::size_t rate, double q)                           \
+  {                                                                                               \
+    return foam::nanDownSampleImageWithLevels<xt::xtensor<VALUE_TYPE, 2>>(src, rate, q);          \
+  }, py::arg("src").noconvert(), py::arg("rate"), py::arg("q") = 1., release_gil());
+
+  FOAM_NAN_DOWN_SAMPLE_IMAGE_IMP(float)
+  FOAM_NAN_DOWN_SAMPLE_IMAGE_IMP(double)
 
 }
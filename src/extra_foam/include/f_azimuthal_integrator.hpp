@@ -0,0 +1,654 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_F_AZIMUTHAL_INTEGRATOR_HPP
+#define EXTRA_FOAM_F_AZIMUTHAL_INTEGRATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "f_traits.hpp"
+#include "f_parallel.hpp"
+#include "f_utilities.hpp"
+
+
+namespace foam
+{
+
+namespace detail
+{
+
+/**
+ * Sparse map (CSR) from radial bins to pixels.
+ *
+ * The pixels of each bin are sorted by their indices, so that an image is
+ * read in increasing address order within a bin.
+ */
+struct RadialBinMap
+{
+  std::vector<std::size_t> indptr; // size = n_bins + 1
+  std::vector<std::size_t> indices; // flattened (row-major) pixel indices
+  std::vector<double> weights; // normalization (solid angle * polarization) of the pixels
+  std::vector<double> centers; // momentum transfer at the bin centers, in 1/A
+};
+
+/**
+ * Offsets of the flattened pixel indices in an array with the given
+ * strides (in number of elements).
+ */
+template<typename Shape, typename Strides>
+inline std::vector<std::ptrdiff_t> pixelOffsets(const std::vector<std::size_t>& indices,
+                                                const Shape& shape, const Strides& strides)
+{
+  std::size_t nd = shape.size();
+  std::vector<std::ptrdiff_t> offsets(indices.size());
+  for (std::size_t i = 0; i < indices.size(); ++i)
+  {
+    std::size_t idx = indices[i];
+    std::ptrdiff_t offset = 0;
+    for (std::size_t d = nd; d-- > 0;)
+    {
+      offset += static_cast<std::ptrdiff_t>(idx % shape[d]) * strides[d];
+      idx /= shape[d];
+    }
+    offsets[i] = offset;
+  }
+  return offsets;
+}
+
+} // detail
+
+/**
+ * Azimuthal integrator for flat detectors perpendicular to the beam.
+ *
+ * It follows the geometry convention of pyFAI with zero rotations: the
+ * position of a pixel center is (index + 0.5) * pixel size - poni, and the
+ * intensity of a radial bin is sum(signal) / sum(solid angle * polarization)
+ * over the valid pixels in the bin. Pixels are not split, i.e. each pixel
+ * contributes to the bin which contains the momentum transfer at its center.
+ *
+ * The map from radial bins to pixels is computed once and cached until the
+ * shape of the input, the number of bins or the radial range changes. The
+ * cache is not thread-safe: an integrator should be used by a single thread.
+ *
+ * Data of a modular detector can also be integrated without being assembled
+ * once the positions of the module pixels in the assembled image are set. The
+ * map is then defined in module coordinates (modules, y, x) and the result is
+ * the same as integrating the assembled image.
+ */
+class AzimuthalIntegrator
+{
+public:
+
+  using RangeType = std::array<double, 2>;
+
+private:
+
+  double dist_; // sample distance, in m
+  double poni1_; // in m
+  double poni2_; // in m
+  double pixel1_; // pixel size along axis 1 (y), in m
+  double pixel2_; // pixel size along axis 2 (x), in m
+  double wavelength_; // in m
+  double polarization_factor_;
+
+  std::vector<std::size_t> shape_; // shape of the cached input (without the image dimension)
+  std::size_t npt_ = 0;
+  std::array<std::size_t, 3> modules_shape_ {0, 0, 0};
+  std::vector<int> positions_; // flattened (row, col) of the module pixels in the assembled image
+  RangeType radial_range_ {0., 0.};
+  detail::RadialBinMap map_;
+
+  /**
+   * Compute the momentum transfer (1/A) and the normalization of a pixel
+   * at the given position (in m) relative to the poni.
+   */
+  void pixelQAndWeight(double p1, double p2, double& q, double& w) const;
+
+  /**
+   * Build a new radial bin map.
+   *
+   * @param n_pixels: number of pixels.
+   * @param position: function with signature position(i, p1, p2), which sets
+   *                  the position (in m) of the center of the i-th pixel. It
+   *                  returns false if the pixel should be ignored.
+   */
+  template<typename F>
+  void buildMap(std::size_t n_pixels, std::size_t npt, const RangeType& radial_range, F&& position);
+
+  /**
+   * Integrate an array of images by replaying the cached map.
+   *
+   * @param src: pointer to the first image.
+   * @param image_stride: stride between images.
+   * @param src_offsets: offsets of the pixels in the map within an image.
+   * @param mask: pointer to the mask. nullptr for no mask.
+   * @param mask_offsets: offsets of the pixels in the map within the mask.
+   * @param ds: strides (image, bin) of the output.
+   */
+  template<typename T, typename U>
+  void integrateImp(const T* src, std::size_t n_images, std::ptrdiff_t image_stride,
+                    const std::vector<std::ptrdiff_t>& src_offsets,
+                    const bool* mask, const std::vector<std::ptrdiff_t>& mask_offsets,
+                    const RangeType& threshold, U* dst, const std::array<std::ptrdiff_t, 2>& ds) const;
+
+  /**
+   * Update the cached map for images with the given shape.
+   */
+  template<typename Shape>
+  void updateImageMap(const Shape& shape, std::size_t npt, const RangeType& radial_range);
+
+  /**
+   * Update the cached map for modules data with the given shape (modules, y, x).
+   */
+  template<typename Shape>
+  void updateModulesMap(const Shape& shape, std::size_t npt, const RangeType& radial_range);
+
+  template<typename E, typename D>
+  void integrateImages(const E& src, std::size_t n_images, const bool* mask,
+                       const std::vector<std::ptrdiff_t>& mask_offsets, D& dst,
+                       const RangeType& radial_range, const RangeType& threshold);
+
+  /**
+   * Check the shape of the output, which is (bins,) for a single image and
+   * (images, bins) for an array of images.
+   */
+  template<typename Shape>
+  void checkOutputShape(const Shape& ds, std::size_t nd, std::size_t n_images) const;
+
+public:
+
+  /**
+   * Constructor.
+   *
+   * @param dist: distance from the sample to the detector plane (orthogonal
+   *              distance, not along the beam), in m.
+   * @param poni1: coordinate of the point of normal incidence along axis 1 (y), in m.
+   * @param poni2: coordinate of the point of normal incidence along axis 2 (x), in m.
+   * @param pixel1: pixel size along axis 1 (y), in m.
+   * @param pixel2: pixel size along axis 2 (x), in m.
+   * @param wavelength: photon wavelength, in m.
+   * @param polarization_factor: polarization factor between -1 (vertical) and
+   *                             1 (horizontal).
+   */
+  AzimuthalIntegrator(double dist, double poni1, double poni2, double pixel1, double pixel2,
+                      double wavelength, double polarization_factor = 1.);
+
+  ~AzimuthalIntegrator() = default;
+
+  /**
+   * Azimuthal integration of an image.
+   *
+   * @param src: image data. shape = (y, x)
+   * @param dst: integrated intensities. The number of bins is given by its size.
+   * @param radial_range: radial range (1/A) of the integration. A non-finite
+   *                      boundary is replaced by the min/max momentum
+   *                      transfer of the image.
+   * @param threshold: (lower, upper) boundaries of the pixel values. Pixels
+   *                   outside the boundaries are ignored.
+   */
+  template<typename E, typename D, EnableIf<E, IsImage> = false>
+  void integrate1d(const E& src, D& dst, const RangeType& radial_range,
+                   const RangeType& threshold = {-std::numeric_limits<double>::infinity(),
+                                                 std::numeric_limits<double>::infinity()});
+
+  /**
+   * Azimuthal integration of a masked image.
+   *
+   * @param mask: image mask. Pixels with mask == true are ignored. shape = (y, x)
+   */
+  template<typename E, typename M, typename D, EnableIf<E, IsImage> = false, EnableIf<M, IsImageMask> = false>
+  void integrate1d(const E& src, const M& mask, D& dst, const RangeType& radial_range,
+                   const RangeType& threshold = {-std::numeric_limits<double>::infinity(),
+                                                 std::numeric_limits<double>::infinity()});
+
+  /**
+   * Azimuthal integration of an array of images in a single parallel pass.
+   *
+   * @param src: image data. shape = (images, y, x)
+   * @param dst: integrated intensities. shape = (images, bins)
+   */
+  template<typename E, typename D, EnableIf<E, IsImageArray> = false>
+  void integrate1d(const E& src, D& dst, const RangeType& radial_range,
+                   const RangeType& threshold = {-std::numeric_limits<double>::infinity(),
+                                                 std::numeric_limits<double>::infinity()});
+
+  /**
+   * Azimuthal integration of an array of images with a common image mask in
+   * a single parallel pass.
+   *
+   * @param mask: image mask. Pixels with mask == true are ignored. shape = (y, x)
+   */
+  template<typename E, typename M, typename D, EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
+  void integrate1d(const E& src, const M& mask, D& dst, const RangeType& radial_range,
+                   const RangeType& threshold = {-std::numeric_limits<double>::infinity(),
+                                                 std::numeric_limits<double>::infinity()});
+
+  /**
+   * Set the positions of the pixels of a modular detector in the assembled
+   * image, which are required for integrating modules data.
+   *
+   * @param positions: (row, col) of each module pixel in the assembled
+   *                   image. Pixels with negative positions, e.g. the ignored
+   *                   tile edges, are ignored. shape = (modules, y, x, 2)
+   */
+  template<typename P, EnableIf<P, IsModulesArray> = false>
+  void setPixelPositions(const P& positions);
+
+  /**
+   * Azimuthal integration of modules data in a single parallel pass, without
+   * assembling them.
+   *
+   * @param src: modules data. shape = (images, modules, y, x)
+   * @param dst: integrated intensities. shape = (images, bins)
+   */
+  template<typename E, typename D, EnableIf<E, IsModulesArray> = false>
+  void integrate1d(const E& src, D& dst, const RangeType& radial_range,
+                   const RangeType& threshold = {-std::numeric_limits<double>::infinity(),
+                                                 std::numeric_limits<double>::infinity()});
+
+  /**
+   * Azimuthal integration of masked modules data in a single parallel pass,
+   * without assembling them.
+   *
+   * @param mask: pixel mask in modules. Pixels with mask == true are ignored.
+   *              shape = (modules, y, x)
+   */
+  template<typename E, typename M, typename D, EnableIf<E, IsModulesArray> = false, EnableIf<M, IsImageArray> = false>
+  void integrate1d(const E& src, const M& mask, D& dst, const RangeType& radial_range,
+                   const RangeType& threshold = {-std::numeric_limits<double>::infinity(),
+                                                 std::numeric_limits<double>::infinity()});
+
+  /**
+   * Momentum transfer (1/A) at the radial bin centers of the last integration.
+   */
+  const std::vector<double>& radial() const { return map_.centers; }
+
+  /**
+   * Compute the momentum transfer (1/A) at the pixel centers of an image.
+   *
+   * @param dst: output. shape = (y, x)
+   */
+  template<typename E>
+  void qMap(E& dst) const;
+
+  double dist() const { return dist_; }
+  double poni1() const { return poni1_; }
+  double poni2() const { return poni2_; }
+  double pixel1() const { return pixel1_; }
+  double pixel2() const { return pixel2_; }
+  double wavelength() const { return wavelength_; }
+  double polarizationFactor() const { return polarization_factor_; }
+};
+
+inline AzimuthalIntegrator::AzimuthalIntegrator(double dist, double poni1, double poni2,
+                                                double pixel1, double pixel2,
+                                                double wavelength, double polarization_factor)
+  : dist_(dist), poni1_(poni1), poni2_(poni2), pixel1_(pixel1), pixel2_(pixel2),
+    wavelength_(wavelength), polarization_factor_(polarization_factor)
+{
+  if (dist <= 0) throw std::invalid_argument("Sample distance must be positive!");
+  if (pixel1 <= 0 || pixel2 <= 0) throw std::invalid_argument("Pixel size must be positive!");
+  if (wavelength <= 0) throw std::invalid_argument("Wavelength must be positive!");
+  if (polarization_factor < -1. || polarization_factor > 1.)
+    throw std::invalid_argument("Polarization factor must be within [-1, 1]!");
+}
+
+inline void AzimuthalIntegrator::pixelQAndWeight(double p1, double p2, double& q, double& w) const
+{
+  double r2 = p1 * p1 + p2 * p2;
+  double d2 = dist_ * dist_;
+  double cos2_tth = d2 / (d2 + r2);
+  double tth = std::atan2(std::sqrt(r2), dist_);
+  // 1/m -> 1/A
+  constexpr double pi = 3.14159265358979323846;
+  q = 4. * pi * std::sin(0.5 * tth) / wavelength_ * 1e-10;
+
+  double solid_angle = cos2_tth * std::sqrt(cos2_tth);
+  double cos_2chi = r2 > 0. ? (p2 * p2 - p1 * p1) / r2 : 1.;
+  double polarization = 0.5 * (1. + cos2_tth - polarization_factor_ * cos_2chi * (1. - cos2_tth));
+  w = solid_angle * polarization;
+}
+
+template<typename F>
+void AzimuthalIntegrator::buildMap(std::size_t n_pixels, std::size_t npt, const RangeType& radial_range,
+                                   F&& position)
+{
+  if (npt == 0) throw std::invalid_argument("Number of integration points must be positive!");
+
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> q(n_pixels);
+  std::vector<double> w(n_pixels);
+  detail::parallelFor(n_pixels, [&] (std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      double p1, p2;
+      if (position(i, p1, p2)) pixelQAndWeight(p1 - poni1_, p2 - poni2_, q[i], w[i]);
+      else q[i] = nan;
+    }
+  });
+
+  double lb = radial_range[0];
+  double ub = radial_range[1];
+  if (! std::isfinite(lb) || ! std::isfinite(ub))
+  {
+    double q_min = std::numeric_limits<double>::infinity();
+    double q_max = -std::numeric_limits<double>::infinity();
+    for (auto v : q)
+    {
+      if (std::isnan(v)) continue;
+      q_min = std::min(q_min, v);
+      q_max = std::max(q_max, v);
+    }
+    if (! std::isfinite(lb)) lb = q_min;
+    if (! std::isfinite(ub)) ub = q_max;
+  }
+  if (! (lb < ub))
+  {
+    std::stringstream fmt;
+    fmt << "Invalid radial range: (" << lb << ", " << ub << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  // bin the pixels with a counting sort, which keeps the pixels of each bin
+  // sorted by their indices
+  double delta = (ub - lb) / npt;
+  std::vector<std::size_t> bins(n_pixels);
+  std::vector<std::size_t> indptr(npt + 1, 0);
+  for (std::size_t i = 0; i < n_pixels; ++i)
+  {
+    double v = q[i];
+    if (! (v >= lb && v <= ub))
+    {
+      bins[i] = npt;
+      continue;
+    }
+    auto ib = static_cast<std::size_t>((v - lb) / delta);
+    if (ib >= npt) ib = npt - 1;
+    bins[i] = ib;
+    ++indptr[ib + 1];
+  }
+  for (std::size_t ib = 0; ib < npt; ++ib) indptr[ib + 1] += indptr[ib];
+
+  std::vector<std::size_t> indices(indptr[npt]);
+  std::vector<double> weights(indptr[npt]);
+  std::vector<std::size_t> pos(indptr.begin(), indptr.end() - 1);
+  for (std::size_t i = 0; i < n_pixels; ++i)
+  {
+    std::size_t ib = bins[i];
+    if (ib == npt) continue;
+    indices[pos[ib]] = i;
+    weights[pos[ib]] = w[i];
+    ++pos[ib];
+  }
+
+  std::vector<double> centers(npt);
+  for (std::size_t ib = 0; ib < npt; ++ib) centers[ib] = lb + (ib + 0.5) * delta;
+
+  map_.indptr.swap(indptr);
+  map_.indices.swap(indices);
+  map_.weights.swap(weights);
+  map_.centers.swap(centers);
+  npt_ = npt;
+  radial_range_ = radial_range;
+}
+
+template<typename T, typename U>
+void AzimuthalIntegrator::integrateImp(const T* src, std::size_t n_images, std::ptrdiff_t image_stride,
+                                       const std::vector<std::ptrdiff_t>& src_offsets,
+                                       const bool* mask, const std::vector<std::ptrdiff_t>& mask_offsets,
+                                       const RangeType& threshold, U* dst,
+                                       const std::array<std::ptrdiff_t, 2>& ds) const
+{
+  const auto& indptr = map_.indptr;
+  const auto& weights = map_.weights;
+  double lb = threshold[0];
+  double ub = threshold[1];
+
+  detail::parallelForRows(n_images, npt_,
+    [&, src, mask, dst, image_stride, lb, ub] (std::size_t i, std::size_t b0, std::size_t nb)
+    {
+      const T* img = src + i * image_stride;
+      for (std::size_t b = b0; b < b0 + nb; ++b)
+      {
+        double sum = 0.;
+        double norm = 0.;
+        for (std::size_t k = indptr[b]; k < indptr[b + 1]; ++k)
+        {
+          if (mask != nullptr && mask[mask_offsets[k]]) continue;
+          double v = img[src_offsets[k]];
+          // nan is excluded by the comparisons
+          if (v >= lb && v <= ub)
+          {
+            sum += v;
+            norm += weights[k];
+          }
+        }
+        // follow pyFAI, which sets empty bins to 0
+        dst[i * ds[0] + b * ds[1]] = norm > 0. ? static_cast<U>(sum / norm) : U(0);
+      }
+    }
+  );
+}
+
+template<typename Shape>
+void AzimuthalIntegrator::updateImageMap(const Shape& shape, std::size_t npt, const RangeType& radial_range)
+{
+  std::vector<std::size_t> image_shape {static_cast<std::size_t>(shape[0]), static_cast<std::size_t>(shape[1])};
+  if (image_shape == shape_ && npt == npt_ && radial_range == radial_range_) return;
+
+  std::size_t nx = image_shape[1];
+  double pixel1 = pixel1_;
+  double pixel2 = pixel2_;
+  buildMap(image_shape[0] * nx, npt, radial_range,
+    [nx, pixel1, pixel2] (std::size_t i, double& p1, double& p2)
+    {
+      p1 = (i / nx + 0.5) * pixel1;
+      p2 = (i % nx + 0.5) * pixel2;
+      return true;
+    }
+  );
+  shape_ = image_shape;
+}
+
+template<typename Shape>
+void AzimuthalIntegrator::updateModulesMap(const Shape& shape, std::size_t npt, const RangeType& radial_range)
+{
+  std::vector<std::size_t> modules_shape {static_cast<std::size_t>(shape[0]),
+                                          static_cast<std::size_t>(shape[1]),
+                                          static_cast<std::size_t>(shape[2])};
+  if (positions_.empty()) throw std::invalid_argument("Pixel positions of the modules are not set!");
+  checkShape(modules_shape, modules_shape_, "Modules data and pixel positions have different shapes");
+  if (modules_shape == shape_ && npt == npt_ && radial_range == radial_range_) return;
+
+  const auto& positions = positions_;
+  double pixel1 = pixel1_;
+  double pixel2 = pixel2_;
+  buildMap(modules_shape[0] * modules_shape[1] * modules_shape[2], npt, radial_range,
+    [&positions, pixel1, pixel2] (std::size_t i, double& p1, double& p2)
+    {
+      int row = positions[2 * i];
+      int col = positions[2 * i + 1];
+      if (row < 0 || col < 0) return false;
+      p1 = (row + 0.5) * pixel1;
+      p2 = (col + 0.5) * pixel2;
+      return true;
+    }
+  );
+  shape_ = modules_shape;
+}
+
+template<typename Shape>
+void AzimuthalIntegrator::checkOutputShape(const Shape& ds, std::size_t nd, std::size_t n_images) const
+{
+  if (ds.size() != nd)
+  {
+    std::stringstream fmt;
+    fmt << "Expected " << nd << "D output array, get " << ds.size() << "D!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  if (nd == 2 && static_cast<std::size_t>(ds[0]) != n_images)
+  {
+    std::stringstream fmt;
+    fmt << "Expected output array with " << n_images << " rows, get " << ds[0] << "!";
+    throw std::invalid_argument(fmt.str());
+  }
+}
+
+template<typename E, typename D>
+void AzimuthalIntegrator::integrateImages(const E& src, std::size_t n_images, const bool* mask,
+                                          const std::vector<std::ptrdiff_t>& mask_offsets, D& dst,
+                                          const RangeType& radial_range, const RangeType& threshold)
+{
+  auto ss = src.shape();
+  auto st = src.strides();
+  std::size_t nd = ss.size();
+  auto ds = dst.shape();
+
+  // the map is defined over the last dimensions of the input, i.e. (y, x)
+  // for images and (modules, y, x) for modules data
+  std::size_t np = shape_.size();
+  std::vector<std::size_t> image_shape(ss.end() - np, ss.end());
+  std::vector<std::ptrdiff_t> image_strides(st.end() - np, st.end());
+  std::ptrdiff_t image_stride = nd > np ? static_cast<std::ptrdiff_t>(st[0]) : 0;
+  auto dt = dst.strides();
+  std::array<std::ptrdiff_t, 2> dst_strides {
+    ds.size() == 2 ? static_cast<std::ptrdiff_t>(dt[0]) : 0,
+    static_cast<std::ptrdiff_t>(dt[ds.size() - 1])
+  };
+
+  auto src_offsets = detail::pixelOffsets(map_.indices, image_shape, image_strides);
+  integrateImp(src.data(), n_images, image_stride, src_offsets, mask, mask_offsets,
+               threshold, dst.data(), dst_strides);
+}
+
+template<typename E, typename D, EnableIf<E, IsImage>>
+void AzimuthalIntegrator::integrate1d(const E& src, D& dst, const RangeType& radial_range,
+                                      const RangeType& threshold)
+{
+  checkOutputShape(dst.shape(), 1, 1);
+  updateImageMap(src.shape(), dst.size(), radial_range);
+  integrateImages(src, 1, nullptr, {}, dst, radial_range, threshold);
+}
+
+template<typename E, typename M, typename D, EnableIf<E, IsImage>, EnableIf<M, IsImageMask>>
+void AzimuthalIntegrator::integrate1d(const E& src, const M& mask, D& dst, const RangeType& radial_range,
+                                      const RangeType& threshold)
+{
+  checkShape(src.shape(), mask.shape(), "Image and mask have different shapes");
+  checkOutputShape(dst.shape(), 1, 1);
+  updateImageMap(src.shape(), dst.size(), radial_range);
+  auto mask_offsets = detail::pixelOffsets(map_.indices, mask.shape(), mask.strides());
+  integrateImages(src, 1, mask.data(), mask_offsets, dst, radial_range, threshold);
+}
+
+template<typename E, typename D, EnableIf<E, IsImageArray>>
+void AzimuthalIntegrator::integrate1d(const E& src, D& dst, const RangeType& radial_range,
+                                      const RangeType& threshold)
+{
+  auto ss = src.shape();
+  checkOutputShape(dst.shape(), 2, ss[0]);
+  updateImageMap(std::array<std::size_t, 2>{ss[1], ss[2]}, dst.shape()[1], radial_range);
+  integrateImages(src, ss[0], nullptr, {}, dst, radial_range, threshold);
+}
+
+template<typename E, typename M, typename D, EnableIf<E, IsImageArray>, EnableIf<M, IsImageMask>>
+void AzimuthalIntegrator::integrate1d(const E& src, const M& mask, D& dst, const RangeType& radial_range,
+                                      const RangeType& threshold)
+{
+  auto ss = src.shape();
+  std::array<std::size_t, 2> image_shape {ss[1], ss[2]};
+  checkShape(image_shape, mask.shape(), "Image and mask have different shapes");
+  checkOutputShape(dst.shape(), 2, ss[0]);
+  updateImageMap(image_shape, dst.shape()[1], radial_range);
+  auto mask_offsets = detail::pixelOffsets(map_.indices, mask.shape(), mask.strides());
+  integrateImages(src, ss[0], mask.data(), mask_offsets, dst, radial_range, threshold);
+}
+
+template<typename P, EnableIf<P, IsModulesArray>>
+void AzimuthalIntegrator::setPixelPositions(const P& positions)
+{
+  auto ps = positions.shape();
+  if (ps[3] != 2)
+  {
+    std::stringstream fmt;
+    fmt << "Expected pixel positions with shape (modules, y, x, 2), get ("
+        << ps[0] << ", " << ps[1] << ", " << ps[2] << ", " << ps[3] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  modules_shape_ = {static_cast<std::size_t>(ps[0]), static_cast<std::size_t>(ps[1]),
+                    static_cast<std::size_t>(ps[2])};
+  std::size_t n_pixels = modules_shape_[0] * modules_shape_[1] * modules_shape_[2];
+  positions_.resize(2 * n_pixels);
+  std::size_t i = 0;
+  for (std::size_t im = 0; im < modules_shape_[0]; ++im)
+  {
+    for (std::size_t j = 0; j < modules_shape_[1]; ++j)
+    {
+      for (std::size_t k = 0; k < modules_shape_[2]; ++k, i += 2)
+      {
+        positions_[i] = static_cast<int>(positions(im, j, k, 0));
+        positions_[i + 1] = static_cast<int>(positions(im, j, k, 1));
+      }
+    }
+  }
+
+  // invalidate the cached map
+  shape_.clear();
+}
+
+template<typename E, typename D, EnableIf<E, IsModulesArray>>
+void AzimuthalIntegrator::integrate1d(const E& src, D& dst, const RangeType& radial_range,
+                                      const RangeType& threshold)
+{
+  auto ss = src.shape();
+  checkOutputShape(dst.shape(), 2, ss[0]);
+  updateModulesMap(std::array<std::size_t, 3>{ss[1], ss[2], ss[3]}, dst.shape()[1], radial_range);
+  integrateImages(src, ss[0], nullptr, {}, dst, radial_range, threshold);
+}
+
+template<typename E, typename M, typename D, EnableIf<E, IsModulesArray>, EnableIf<M, IsImageArray>>
+void AzimuthalIntegrator::integrate1d(const E& src, const M& mask, D& dst, const RangeType& radial_range,
+                                      const RangeType& threshold)
+{
+  auto ss = src.shape();
+  std::array<std::size_t, 3> modules_shape {ss[1], ss[2], ss[3]};
+  checkShape(modules_shape, mask.shape(), "Modules data and mask have different shapes");
+  checkOutputShape(dst.shape(), 2, ss[0]);
+  updateModulesMap(modules_shape, dst.shape()[1], radial_range);
+  auto mask_offsets = detail::pixelOffsets(map_.indices, mask.shape(), mask.strides());
+  integrateImages(src, ss[0], mask.data(), mask_offsets, dst, radial_range, threshold);
+}
+
+template<typename E>
+void AzimuthalIntegrator::qMap(E& dst) const
+{
+  auto shape = dst.shape();
+  detail::parallelForRows(shape[0], shape[1], [&dst, this] (std::size_t j, std::size_t k0, std::size_t n)
+  {
+    for (std::size_t k = k0; k < k0 + n; ++k)
+    {
+      double q, w;
+      pixelQAndWeight((j + 0.5) * pixel1_ - poni1_, (k + 0.5) * pixel2_ - poni2_, q, w);
+      dst(j, k) = q;
+    }
+  });
+}
+
+} // foam
+
+#endif //EXTRA_FOAM_F_AZIMUTHAL_INTEGRATOR_HPP
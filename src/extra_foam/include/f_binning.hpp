@@ -0,0 +1,414 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_BINNING_H
+#define EXTRA_FOAM_BINNING_H
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "f_parallel.hpp"
+
+
+namespace foam
+{
+
+/**
+ * Statistic of the data in a bin.
+ *
+ * SUM: sum of the data.
+ * MEAN: mean of the data.
+ */
+enum class BinStatistic
+{
+  SUM = 0x01,
+  MEAN = 0x02,
+};
+
+inline BinStatistic toBinStatistic(const std::string& statistic)
+{
+  if (statistic == "sum") return BinStatistic::SUM;
+  if (statistic == "mean") return BinStatistic::MEAN;
+  throw std::invalid_argument("Unknown bin statistic: " + statistic);
+}
+
+/**
+ * Uniform bins within [lb, ub].
+ *
+ * All but the last bin are half-open, i.e. [edge_i, edge_i+1), while the last
+ * bin is [edge_n-1, ub], which is the same as scipy.stats.binned_statistic.
+ * Values outside the range do not belong to any bin.
+ */
+class UniformBins
+{
+public:
+
+  /**
+   * Constructor.
+   *
+   * @param n_bins: number of bins.
+   * @param lb: lower boundary.
+   * @param ub: upper boundary. If it is equal to lb, the range will be
+   *            extended to [lb - 0.5, ub + 0.5].
+   */
+  UniformBins(std::size_t n_bins, double lb, double ub) : n_bins_(n_bins)
+  {
+    if (n_bins == 0) throw std::invalid_argument("Number of bins must be positive!");
+    if (!(lb <= ub))
+    {
+      std::stringstream ss;
+      ss << "Invalid bin range: (" << lb << ", " << ub << ")";
+      throw std::invalid_argument(ss.str());
+    }
+    if (lb == ub)
+    {
+      lb -= 0.5;
+      ub += 0.5;
+    }
+
+    // the same as numpy.linspace(lb, ub, n_bins + 1)
+    edges_.resize(n_bins + 1);
+    double step = (ub - lb) / static_cast<double>(n_bins);
+    for (std::size_t i = 0; i < n_bins; ++i) edges_[i] = static_cast<double>(i) * step + lb;
+    edges_[n_bins] = ub;
+
+    lb_ = lb;
+    ub_ = ub;
+    scale_ = static_cast<double>(n_bins) / (ub - lb);
+  }
+
+  /**
+   * Return the index of the bin which a value belongs to, or -1 if the value
+   * is outside the range (e.g. nan).
+   *
+   * The index is calculated arithmetically and then corrected by comparing
+   * with the edges, so that it is consistent with searchsorted.
+   */
+  long index(double v) const
+  {
+    if (!(v >= lb_ && v <= ub_)) return -1;
+    if (v == ub_) return static_cast<long>(n_bins_) - 1;
+
+    auto i = static_cast<std::size_t>((v - lb_) * scale_);
+    if (i >= n_bins_) i = n_bins_ - 1;
+    if (v < edges_[i]) --i;
+    else if (v >= edges_[i + 1] && i + 1 < n_bins_) ++i;
+    return static_cast<long>(i);
+  }
+
+  std::size_t size() const { return n_bins_; }
+
+  const std::vector<double>& edges() const { return edges_; }
+
+private:
+  std::size_t n_bins_;
+  double lb_;
+  double ub_;
+  double scale_;
+  std::vector<double> edges_;
+};
+
+namespace detail
+{
+
+template<typename T>
+inline void normalizeBinStatistic(T* stats, const T* counts, std::size_t n)
+{
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    if (counts[i] > 0) stats[i] /= counts[i];
+  }
+}
+
+} // detail
+
+/**
+ * Bin the scalar FOM and the optional vector FOM (VFOM) with respect to one
+ * slow data.
+ *
+ * Empty bins have a statistic of 0. The heatmap of VFOM has a shape of
+ * (VFOM size, number of bins). Non-finite FOM and VFOM values are ignored by
+ * the statistics but the data points are still counted.
+ */
+class Binning1D
+{
+public:
+
+  /**
+   * Constructor.
+   *
+   * @param bins: bins of the slow data.
+   * @param statistic: statistic of the data in a bin.
+   * @param vfom_size: size of VFOM. 0 for no VFOM.
+   */
+  Binning1D(const UniformBins& bins, BinStatistic statistic, std::size_t vfom_size = 0)
+    : bins_(bins), statistic_(statistic), vfom_size_(vfom_size),
+      counts_(bins.size(), 0.), stats_(bins.size(), 0.), stats_counts_(bins.size(), 0.),
+      vfom_heat_(vfom_size * bins.size(), 0.), vfom_heat_counts_(vfom_size * bins.size(), 0.)
+  {
+  }
+
+  /**
+   * Bin the history data. The existing result is discarded.
+   *
+   * The bin index of each data point is calculated only once. The VFOM
+   * history is columnar, so that each row of the heatmap is accumulated from
+   * a contiguous (if sv == 1) column in parallel.
+   *
+   * @param x: history of the slow data.
+   * @param fom: history of FOM.
+   * @param n: number of data points.
+   * @param vfom: history of VFOM. It is ignored if vfom_size is 0.
+   * @param sv: stride between two data points of VFOM in elements.
+   * @param se: stride between two elements of VFOM in elements.
+   */
+  void rebin(const double* x, const double* fom, std::size_t n,
+             const double* vfom = nullptr, std::ptrdiff_t sv = 1, std::ptrdiff_t se = 0)
+  {
+    std::size_t n_bins = bins_.size();
+    std::fill(counts_.begin(), counts_.end(), 0.);
+    std::fill(stats_.begin(), stats_.end(), 0.);
+    std::fill(stats_counts_.begin(), stats_counts_.end(), 0.);
+    std::fill(vfom_heat_.begin(), vfom_heat_.end(), 0.);
+    std::fill(vfom_heat_counts_.begin(), vfom_heat_counts_.end(), 0.);
+
+    indices_.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      long idx = bins_.index(x[i]);
+      indices_[i] = idx;
+      if (idx < 0) continue;
+      counts_[idx] += 1;
+      if (!std::isfinite(fom[i])) continue;
+      stats_counts_[idx] += 1;
+      stats_[idx] += fom[i];
+    }
+    if (statistic_ == BinStatistic::MEAN)
+      detail::normalizeBinStatistic(stats_.data(), stats_counts_.data(), n_bins);
+
+    if (vfom_size_ == 0 || n == 0) return;
+    if (vfom == nullptr) throw std::invalid_argument("VFOM history is required!");
+
+    const long* indices = indices_.data();
+    double* heat = vfom_heat_.data();
+    double* heat_counts = vfom_heat_counts_.data();
+    bool average = statistic_ == BinStatistic::MEAN;
+    detail::parallelFor(vfom_size_, [=] (std::size_t begin, std::size_t end)
+    {
+      for (std::size_t j = begin; j < end; ++j)
+      {
+        const double* column = vfom + static_cast<std::ptrdiff_t>(j) * se;
+        double* row = heat + j * n_bins;
+        double* row_counts = heat_counts + j * n_bins;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+          long idx = indices[i];
+          if (idx < 0) continue;
+          double v = column[static_cast<std::ptrdiff_t>(i) * sv];
+          if (!std::isfinite(v)) continue;
+          row_counts[idx] += 1;
+          row[idx] += v;
+        }
+        if (average) detail::normalizeBinStatistic(row, row_counts, n_bins);
+      }
+    });
+  }
+
+  /**
+   * Add a new data point to the existing result.
+   *
+   * @param x: slow data.
+   * @param fom: FOM.
+   * @param vfom: VFOM. It is ignored if vfom_size is 0.
+   * @param se: stride between two elements of VFOM in elements.
+   *
+   * @return: index of the bin, or -1 if x is outside the range.
+   */
+  long update(double x, double fom, const double* vfom = nullptr, std::ptrdiff_t se = 1)
+  {
+    long idx = bins_.index(x);
+    if (idx < 0) return idx;
+
+    std::size_t n_bins = bins_.size();
+    counts_[idx] += 1;
+    bool average = statistic_ == BinStatistic::MEAN;
+    if (std::isfinite(fom))
+    {
+      double count = ++stats_counts_[idx];
+      if (average) stats_[idx] += (fom - stats_[idx]) / count;
+      else stats_[idx] += fom;
+    }
+
+    if (vfom_size_ == 0) return idx;
+    if (vfom == nullptr) throw std::invalid_argument("VFOM is required!");
+
+    double* heat = vfom_heat_.data() + idx;
+    double* heat_counts = vfom_heat_counts_.data() + idx;
+    for (std::size_t j = 0; j < vfom_size_; ++j)
+    {
+      double v = vfom[static_cast<std::ptrdiff_t>(j) * se];
+      if (!std::isfinite(v)) continue;
+      double count = ++heat_counts[j * n_bins];
+      double& h = heat[j * n_bins];
+      if (average) h += (v - h) / count;
+      else h += v;
+    }
+    return idx;
+  }
+
+  const UniformBins& bins() const { return bins_; }
+
+  BinStatistic statistic() const { return statistic_; }
+
+  std::size_t vfomSize() const { return vfom_size_; }
+
+  /**
+   * Number of data points in each bin. shape = (number of bins,)
+   */
+  const std::vector<double>& counts() const { return counts_; }
+
+  /**
+   * Statistic of FOM in each bin. shape = (number of bins,)
+   */
+  const std::vector<double>& stats() const { return stats_; }
+
+  /**
+   * Heatmap of VFOM. shape = (VFOM size, number of bins)
+   */
+  const std::vector<double>& vfomHeat() const { return vfom_heat_; }
+
+private:
+  UniformBins bins_;
+  BinStatistic statistic_;
+  std::size_t vfom_size_;
+
+  std::vector<double> counts_;
+  std::vector<double> stats_;
+  std::vector<double> stats_counts_; // number of finite FOM in each bin
+  std::vector<double> vfom_heat_;
+  std::vector<double> vfom_heat_counts_; // number of finite VFOM elements in each bin
+
+  std::vector<long> indices_; // reused between rebinnings
+};
+
+/**
+ * Bin the scalar FOM with respect to two slow data.
+ *
+ * The heatmap has a shape of (number of y bins, number of x bins). Empty
+ * bins have a statistic of 0. Non-finite FOM values are ignored by the
+ * statistic but the data points are still counted.
+ */
+class Binning2D
+{
+public:
+
+  /**
+   * Constructor.
+   *
+   * @param bins_x: bins of the first slow data.
+   * @param bins_y: bins of the second slow data.
+   * @param statistic: statistic of the data in a bin.
+   */
+  Binning2D(const UniformBins& bins_x, const UniformBins& bins_y, BinStatistic statistic)
+    : bins_x_(bins_x), bins_y_(bins_y), statistic_(statistic),
+      heat_count_(bins_x.size() * bins_y.size(), 0.), heat_(bins_x.size() * bins_y.size(), 0.),
+      heat_stats_count_(bins_x.size() * bins_y.size(), 0.)
+  {
+  }
+
+  /**
+   * Bin the history data. The existing result is discarded.
+   *
+   * @param x: history of the first slow data.
+   * @param y: history of the second slow data.
+   * @param fom: history of FOM.
+   * @param n: number of data points.
+   */
+  void rebin(const double* x, const double* y, const double* fom, std::size_t n)
+  {
+    std::fill(heat_count_.begin(), heat_count_.end(), 0.);
+    std::fill(heat_.begin(), heat_.end(), 0.);
+    std::fill(heat_stats_count_.begin(), heat_stats_count_.end(), 0.);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      long idx = index(x[i], y[i]);
+      if (idx < 0) continue;
+      heat_count_[idx] += 1;
+      if (!std::isfinite(fom[i])) continue;
+      heat_stats_count_[idx] += 1;
+      heat_[idx] += fom[i];
+    }
+    if (statistic_ == BinStatistic::MEAN)
+      detail::normalizeBinStatistic(heat_.data(), heat_stats_count_.data(), heat_.size());
+  }
+
+  /**
+   * Add a new data point to the existing result.
+   *
+   * @return: flattened index of the bin, or -1 if (x, y) is outside the range.
+   */
+  long update(double x, double y, double fom)
+  {
+    long idx = index(x, y);
+    if (idx < 0) return idx;
+
+    heat_count_[idx] += 1;
+    if (!std::isfinite(fom)) return idx;
+
+    double count = ++heat_stats_count_[idx];
+    if (statistic_ == BinStatistic::MEAN) heat_[idx] += (fom - heat_[idx]) / count;
+    else heat_[idx] += fom;
+    return idx;
+  }
+
+  const UniformBins& binsX() const { return bins_x_; }
+
+  const UniformBins& binsY() const { return bins_y_; }
+
+  BinStatistic statistic() const { return statistic_; }
+
+  /**
+   * Number of data points in each bin. shape = (number of y bins, number of x bins)
+   */
+  const std::vector<double>& heatCount() const { return heat_count_; }
+
+  /**
+   * Statistic of FOM in each bin. shape = (number of y bins, number of x bins)
+   */
+  const std::vector<double>& heat() const { return heat_; }
+
+private:
+
+  long index(double x, double y) const
+  {
+    long ix = bins_x_.index(x);
+    if (ix < 0) return -1;
+    long iy = bins_y_.index(y);
+    if (iy < 0) return -1;
+    return iy * static_cast<long>(bins_x_.size()) + ix;
+  }
+
+  UniformBins bins_x_;
+  UniformBins bins_y_;
+  BinStatistic statistic_;
+
+  std::vector<double> heat_count_;
+  std::vector<double> heat_;
+  std::vector<double> heat_stats_count_; // number of finite FOM in each bin
+};
+
+} // foam
+
+#endif //EXTRA_FOAM_BINNING_H
@@ -0,0 +1,241 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_BITMASK_H
+#define EXTRA_FOAM_BITMASK_H
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "f_traits.hpp"
+#include "f_utilities.hpp"
+
+
+namespace foam
+{
+
+/**
+ * Bit-packed image mask.
+ *
+ * The pixels are stored in row-major order with 64 pixels per word. The bits
+ * are ordered in the same way as numpy.packbits, i.e. the first pixel is the
+ * most significant bit of the first byte, so that the first nBytes() bytes
+ * can be transferred and unpacked in Python without repacking. The padding
+ * bits at the end are always zero.
+ */
+class BitMask
+{
+public:
+
+  using word_type = uint64_t;
+  using shape_type = std::array<std::size_t, 2>;
+
+  static constexpr std::size_t word_bits = 64;
+
+  BitMask() = default;
+
+  BitMask(std::size_t ny, std::size_t nx, bool value = false)
+    : shape_{{ny, nx}}, words_((ny * nx + word_bits - 1) / word_bits, value ? ~word_type(0) : word_type(0))
+  {
+    if (value) clearPadding();
+  }
+
+  /**
+   * Construct from an image mask.
+   *
+   * @param mask: image mask. shape = (y, x)
+   */
+  template<typename M, EnableIf<M, IsImageMask> = false>
+  explicit BitMask(const M& mask) : BitMask(mask.shape()[0], mask.shape()[1])
+  {
+    for (std::size_t j = 0; j < shape_[0]; ++j)
+    {
+      for (std::size_t k = 0; k < shape_[1]; ++k)
+      {
+        if (mask(j, k)) set(j, k);
+      }
+    }
+  }
+
+  /**
+   * Construct from a byte buffer in the format of numpy.packbits.
+   *
+   * @param ny: number of rows.
+   * @param nx: number of columns.
+   * @param data: pointer to the first byte.
+   * @param n: number of bytes in the buffer, which must not be smaller than nBytes().
+   */
+  static BitMask fromBytes(std::size_t ny, std::size_t nx, const uint8_t* data, std::size_t n)
+  {
+    BitMask mask(ny, nx);
+    if (n < mask.nBytes())
+    {
+      std::stringstream ss;
+      ss << "Expected at least " << mask.nBytes() << " bytes for a mask with shape ("
+         << ny << ", " << nx << "), got " << n;
+      throw std::invalid_argument(ss.str());
+    }
+    std::memcpy(mask.words_.data(), data, mask.nBytes());
+    mask.clearPadding();
+    return mask;
+  }
+
+  const shape_type& shape() const { return shape_; }
+
+  /**
+   * Number of pixels.
+   */
+  std::size_t size() const { return shape_[0] * shape_[1]; }
+
+  std::size_t nWords() const { return words_.size(); }
+
+  /**
+   * Number of bytes which hold all the pixels.
+   */
+  std::size_t nBytes() const { return (size() + 7) / 8; }
+
+  const word_type* words() const { return words_.data(); }
+
+  const uint8_t* bytes() const { return reinterpret_cast<const uint8_t*>(words_.data()); }
+
+  bool operator()(std::size_t j, std::size_t k) const
+  {
+    std::size_t p = j * shape_[1] + k;
+    return (bytes()[p >> 3] >> (7 - (p & 7))) & 1;
+  }
+
+  void set(std::size_t j, std::size_t k)
+  {
+    std::size_t p = j * shape_[1] + k;
+    mutableBytes()[p >> 3] |= uint8_t(0x80) >> (p & 7);
+  }
+
+  void reset(std::size_t j, std::size_t k)
+  {
+    std::size_t p = j * shape_[1] + k;
+    mutableBytes()[p >> 3] &= ~(uint8_t(0x80) >> (p & 7));
+  }
+
+  void fill(bool value)
+  {
+    std::fill(words_.begin(), words_.end(), value ? ~word_type(0) : word_type(0));
+    if (value) clearPadding();
+  }
+
+  /**
+   * Number of masked pixels.
+   */
+  std::size_t count() const
+  {
+    std::size_t c = 0;
+    for (auto w : words_) c += std::bitset<word_bits>(w).count();
+    return c;
+  }
+
+  bool any() const
+  {
+    for (auto w : words_) if (w != 0) return true;
+    return false;
+  }
+
+  /**
+   * Unpack the pixels [k0, k0 + n) of row j into a bool array.
+   *
+   * Words without any masked pixel are skipped as a whole.
+   */
+  void unpack(std::size_t j, std::size_t k0, std::size_t n, bool* out) const
+  {
+    std::size_t p = j * shape_[1] + k0;
+    std::size_t end = p + n;
+    const uint8_t* b = bytes();
+    while (p < end)
+    {
+      if ((p & (word_bits - 1)) == 0 && end - p >= word_bits && words_[p / word_bits] == 0)
+      {
+        std::fill_n(out, word_bits, false);
+        out += word_bits;
+        p += word_bits;
+        continue;
+      }
+      *out++ = (b[p >> 3] >> (7 - (p & 7))) & 1;
+      ++p;
+    }
+  }
+
+  /**
+   * Unpack into an image mask.
+   *
+   * @param out: output image mask. shape = (y, x)
+   */
+  template<typename M, EnableIf<M, IsImageMask> = false>
+  void toImageMask(M& out) const
+  {
+    checkShape(shape_, out.shape(), "Mask and output array have different shapes");
+    for (std::size_t j = 0; j < shape_[0]; ++j)
+    {
+      for (std::size_t k = 0; k < shape_[1]; ++k) out(j, k) = (*this)(j, k);
+    }
+  }
+
+  BitMask& operator&=(const BitMask& other)
+  {
+    checkShape(shape_, other.shape_, "Masks have different shapes");
+    for (std::size_t i = 0; i < words_.size(); ++i) words_[i] &= other.words_[i];
+    return *this;
+  }
+
+  BitMask& operator|=(const BitMask& other)
+  {
+    checkShape(shape_, other.shape_, "Masks have different shapes");
+    for (std::size_t i = 0; i < words_.size(); ++i) words_[i] |= other.words_[i];
+    return *this;
+  }
+
+  bool operator==(const BitMask& other) const
+  {
+    return shape_ == other.shape_ && words_ == other.words_;
+  }
+
+  bool operator!=(const BitMask& other) const { return !(*this == other); }
+
+private:
+
+  uint8_t* mutableBytes() { return reinterpret_cast<uint8_t*>(words_.data()); }
+
+  void clearPadding()
+  {
+    uint8_t* b = mutableBytes();
+    std::size_t n = size();
+    if (n & 7) b[n >> 3] &= uint8_t(0xff) << (8 - (n & 7));
+    std::fill(b + nBytes(), b + words_.size() * sizeof(word_type), uint8_t(0));
+  }
+
+  shape_type shape_ {0, 0};
+  std::vector<word_type> words_;
+};
+
+inline BitMask operator&(BitMask lhs, const BitMask& rhs)
+{
+  lhs &= rhs;
+  return lhs;
+}
+
+inline BitMask operator|(BitMask lhs, const BitMask& rhs)
+{
+  lhs |= rhs;
+  return lhs;
+}
+
+} // foam
+
+#endif //EXTRA_FOAM_BITMASK_H
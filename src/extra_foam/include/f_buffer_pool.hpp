@@ -0,0 +1,200 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_F_BUFFER_POOL_HPP
+#define EXTRA_FOAM_F_BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+
+namespace foam
+{
+
+// alignment of the pooled buffers in bytes, i.e. a cache line
+constexpr std::size_t kBufferAlignment = 64;
+
+namespace detail
+{
+
+/**
+ * Allocate a block of memory aligned to kBufferAlignment.
+ *
+ * The address returned by operator new is stored in front of the aligned
+ * block.
+ */
+inline void* alignedMalloc(std::size_t n_bytes)
+{
+  void* raw = ::operator new(n_bytes + kBufferAlignment + sizeof(void*));
+  auto addr = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+  addr = (addr + kBufferAlignment - 1) & ~(static_cast<std::uintptr_t>(kBufferAlignment) - 1);
+  auto aligned = reinterpret_cast<void*>(addr);
+  reinterpret_cast<void**>(aligned)[-1] = raw;
+  return aligned;
+}
+
+inline void alignedFree(void* p)
+{
+  if (p != nullptr) ::operator delete(reinterpret_cast<void**>(p)[-1]);
+}
+
+} // detail
+
+/**
+ * Cache of aligned memory blocks keyed by their sizes in bytes.
+ *
+ * The temporary buffers of the kernels, e.g. the accumulators of a row, have
+ * the same sizes from train to train. Instead of allocating and freeing them
+ * in every task, they are returned to the pool of the thread and reused.
+ * Since each thread has its own pool, no locking is required.
+ *
+ * The cached bytes of a pool are limited by a global capacity. Blocks which
+ * do not fit are freed immediately.
+ */
+class BufferPool
+{
+public:
+
+  struct Stats
+  {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    std::size_t cached_bytes = 0;
+  };
+
+  ~BufferPool() { clear(); }
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  /**
+   * Return the pool of the calling thread.
+   */
+  static BufferPool& local()
+  {
+    static thread_local BufferPool pool;
+    return pool;
+  }
+
+  /**
+   * Maximum number of bytes cached by the pool of each thread.
+   */
+  static std::atomic<std::size_t>& capacity()
+  {
+    static std::atomic<std::size_t> value {std::size_t(64) << 20}; // 64 MiB
+    return value;
+  }
+
+  static void setCapacity(std::size_t n_bytes) { capacity().store(n_bytes, std::memory_order_relaxed); }
+
+  void* acquire(std::size_t n_bytes)
+  {
+    auto it = free_.find(n_bytes);
+    if (it != free_.end() && !it->second.empty())
+    {
+      void* p = it->second.back();
+      it->second.pop_back();
+      stats_.cached_bytes -= n_bytes;
+      ++stats_.hits;
+      return p;
+    }
+
+    ++stats_.misses;
+    return detail::alignedMalloc(n_bytes);
+  }
+
+  void release(void* p, std::size_t n_bytes)
+  {
+    if (p == nullptr) return;
+    if (stats_.cached_bytes + n_bytes > capacity().load(std::memory_order_relaxed))
+    {
+      detail::alignedFree(p);
+      return;
+    }
+    free_[n_bytes].push_back(p);
+    stats_.cached_bytes += n_bytes;
+  }
+
+  /**
+   * Free all the cached blocks.
+   */
+  void clear()
+  {
+    for (auto& blocks : free_)
+    {
+      for (auto p : blocks.second) detail::alignedFree(p);
+    }
+    free_.clear();
+    stats_.cached_bytes = 0;
+  }
+
+  const Stats& stats() const { return stats_; }
+
+private:
+
+  BufferPool() = default;
+
+  std::unordered_map<std::size_t, std::vector<void*>> free_;
+  Stats stats_;
+};
+
+/**
+ * A temporary array of T drawn from the buffer pool of the calling thread.
+ *
+ * It must be destroyed by the same thread, which is always the case for a
+ * local variable in a task.
+ */
+template<typename T>
+class PooledBuffer
+{
+  static_assert(std::is_trivially_destructible<T>::value, "T must be trivially destructible!");
+
+public:
+
+  explicit PooledBuffer(std::size_t n)
+    : size_(n),
+      data_(n == 0 ? nullptr : static_cast<T*>(BufferPool::local().acquire(n * sizeof(T))))
+  {}
+
+  PooledBuffer(std::size_t n, T value) : PooledBuffer(n)
+  {
+    std::fill(data_, data_ + size_, value);
+  }
+
+  ~PooledBuffer() { BufferPool::local().release(data_, size_ * sizeof(T)); }
+
+  PooledBuffer(const PooledBuffer&) = delete;
+  PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+
+  std::size_t size() const { return size_; }
+
+  T* begin() { return data_; }
+  T* end() { return data_ + size_; }
+
+  T& operator[](std::size_t i) { return data_[i]; }
+  const T& operator[](std::size_t i) const { return data_[i]; }
+
+private:
+
+  std::size_t size_;
+  T* data_;
+};
+
+} // foam
+
+#endif //EXTRA_FOAM_F_BUFFER_POOL_HPP
@@ -0,0 +1,245 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_CORRELATOR_H
+#define EXTRA_FOAM_CORRELATOR_H
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace foam
+{
+
+enum class CorrelationStatus
+{
+  PENDING,    // the train still misses some sources
+  CORRELATED, // the train has just been completed by this put
+  LATE        // the train is older than the last correlated one or has been evicted
+};
+
+struct CorrelationResult
+{
+  CorrelationStatus status = CorrelationStatus::PENDING;
+  // whether an incomplete train was evicted to make room for this train
+  bool evicted = false;
+  uint64_t evicted_tid = 0;
+  // sources which had arrived for the evicted train
+  uint64_t evicted_sources = 0;
+};
+
+/**
+ * Correlate the data of different sources by train ID.
+ *
+ * Each train occupies the slot tid % capacity of a fixed-size table. The
+ * state of a slot is a single 64-bit word which packs a 32-bit tag of the
+ * train ID with the bitmask of the sources which have arrived, so that
+ * inserting a source, evicting an older train and detecting the completion
+ * of a train are all done by a single CAS. A train is only reported as
+ * correlated once and only if it is newer than the last correlated train,
+ * i.e. the correlated trains are emitted in order. Sources arriving for
+ * older trains are counted instead of being cached.
+ *
+ * It is lock-free and can be fed by multiple threads.
+ */
+class TrainCorrelator
+{
+public:
+
+  static constexpr std::size_t kMaxSources = 32;
+  static constexpr std::size_t kMaxCapacity = 1 << 14;
+
+  /**
+   * Constructor.
+   *
+   * @param n_sources: number of sources which must arrive for a train.
+   * @param capacity: max number of trains which can be pending at the
+   *                  same time.
+   */
+  TrainCorrelator(std::size_t n_sources, std::size_t capacity)
+    : n_sources_(n_sources), capacity_(capacity)
+  {
+    if (n_sources == 0 || n_sources > kMaxSources)
+    {
+      std::stringstream ss;
+      ss << "Number of sources must be within [1, " << kMaxSources << "], got " << n_sources;
+      throw std::invalid_argument(ss.str());
+    }
+    if (capacity == 0 || capacity > kMaxCapacity)
+    {
+      std::stringstream ss;
+      ss << "Capacity must be within [1, " << kMaxCapacity << "], got " << capacity;
+      throw std::invalid_argument(ss.str());
+    }
+
+    full_ = (uint64_t(1) << n_sources) - 1;
+    table_.reset(new std::atomic<uint64_t>[capacity]);
+    reset();
+  }
+
+  TrainCorrelator(const TrainCorrelator&) = delete;
+  TrainCorrelator& operator=(const TrainCorrelator&) = delete;
+
+  /**
+   * Register the arrival of one or more sources of a train.
+   *
+   * @param tid: train ID.
+   * @param sources: bitmask of the arrived sources.
+   */
+  CorrelationResult put(uint64_t tid, uint64_t sources)
+  {
+    if (sources == 0 || (sources & ~full_) != 0)
+    {
+      std::stringstream ss;
+      ss << "Invalid source mask " << sources << " for " << n_sources_ << " sources";
+      throw std::invalid_argument(ss.str());
+    }
+
+    CorrelationResult result;
+    if (isLate(tid))
+    {
+      n_late_.fetch_add(1, std::memory_order_relaxed);
+      result.status = CorrelationStatus::LATE;
+      return result;
+    }
+
+    auto& slot = table_[tid % capacity_];
+    uint32_t tag = static_cast<uint32_t>(tid);
+    uint64_t prev;
+    uint64_t state = slot.load(std::memory_order_acquire);
+    while (true)
+    {
+      uint32_t old_tag = static_cast<uint32_t>(state >> kMaxSources);
+      uint64_t old_sources = state & kSourceMask;
+      if (old_sources != 0 && old_tag == tag)
+      {
+        // the same train
+        if (slot.compare_exchange_weak(state, state | sources, std::memory_order_acq_rel))
+        {
+          prev = old_sources;
+          break;
+        }
+      } else if (old_sources == 0 || static_cast<int32_t>(old_tag - tag) < 0)
+      {
+        // empty or an older train
+        uint64_t new_state = (static_cast<uint64_t>(tag) << kMaxSources) | sources;
+        if (slot.compare_exchange_weak(state, new_state, std::memory_order_acq_rel))
+        {
+          if (old_sources != 0 && old_sources != full_)
+          {
+            n_dropped_.fetch_add(1, std::memory_order_relaxed);
+            result.evicted = true;
+            result.evicted_tid = tid - static_cast<uint32_t>(tag - old_tag);
+            result.evicted_sources = old_sources;
+          }
+          prev = 0;
+          break;
+        }
+      } else
+      {
+        // the slot has been taken by a newer train
+        n_late_.fetch_add(1, std::memory_order_relaxed);
+        result.status = CorrelationStatus::LATE;
+        return result;
+      }
+    }
+
+    if ((prev | sources) != full_ || prev == full_) return result;
+
+    // The train is complete. Emit it only if it is newer than the last
+    // correlated train.
+    uint64_t last = last_.load(std::memory_order_acquire);
+    while (last == 0 || last - 1 < tid)
+    {
+      if (last_.compare_exchange_weak(last, tid + 1, std::memory_order_acq_rel))
+      {
+        n_correlated_.fetch_add(1, std::memory_order_relaxed);
+        result.status = CorrelationStatus::CORRELATED;
+        return result;
+      }
+    }
+
+    n_late_.fetch_add(1, std::memory_order_relaxed);
+    result.status = CorrelationStatus::LATE;
+    return result;
+  }
+
+  /**
+   * Whether a train is older than or the same as the last correlated train.
+   */
+  bool isLate(uint64_t tid) const
+  {
+    uint64_t last = last_.load(std::memory_order_acquire);
+    return last != 0 && tid <= last - 1;
+  }
+
+  /**
+   * Whether there is a correlated train.
+   */
+  bool hasCorrelated() const { return last_.load(std::memory_order_acquire) != 0; }
+
+  /**
+   * ID of the last correlated train. Only meaningful if hasCorrelated() is true.
+   */
+  uint64_t correlatedTid() const { return last_.load(std::memory_order_acquire) - 1; }
+
+  /**
+   * Clear the table and the counters. It must not be called concurrently
+   * with put().
+   */
+  void reset()
+  {
+    for (std::size_t i = 0; i < capacity_; ++i) table_[i].store(0, std::memory_order_relaxed);
+    last_.store(0, std::memory_order_relaxed);
+    n_correlated_.store(0, std::memory_order_relaxed);
+    n_dropped_.store(0, std::memory_order_relaxed);
+    n_late_.store(0, std::memory_order_release);
+  }
+
+  std::size_t nSources() const { return n_sources_; }
+
+  std::size_t capacity() const { return capacity_; }
+
+  /**
+   * Number of correlated trains.
+   */
+  uint64_t nCorrelated() const { return n_correlated_.load(std::memory_order_relaxed); }
+
+  /**
+   * Number of incomplete trains which were evicted.
+   */
+  uint64_t nDropped() const { return n_dropped_.load(std::memory_order_relaxed); }
+
+  /**
+   * Number of puts which arrived too late.
+   */
+  uint64_t nLate() const { return n_late_.load(std::memory_order_relaxed); }
+
+private:
+
+  static constexpr uint64_t kSourceMask = (uint64_t(1) << kMaxSources) - 1;
+
+  std::size_t n_sources_;
+  std::size_t capacity_;
+  uint64_t full_;
+  std::unique_ptr<std::atomic<uint64_t>[]> table_;
+  // ID + 1 of the last correlated train, 0 for none
+  std::atomic<uint64_t> last_ {0};
+
+  std::atomic<uint64_t> n_correlated_ {0};
+  std::atomic<uint64_t> n_dropped_ {0};
+  std::atomic<uint64_t> n_late_ {0};
+};
+
+} // foam
+
+#endif //EXTRA_FOAM_CORRELATOR_H
@@ -0,0 +1,327 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_DARK_ACCUMULATOR_H
+#define EXTRA_FOAM_DARK_ACCUMULATOR_H
+
+#include <cmath>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "f_traits.hpp"
+#include "f_parallel.hpp"
+
+
+namespace foam
+{
+
+/**
+ * Accumulate the statistics of a dark run.
+ *
+ * For each memory cell and pixel, the running mean and the sum of squared
+ * differences from the mean (M2) of the valid (non-NaN) values are updated
+ * with Welford's algorithm, together with the number of valid values. The
+ * buffers are allocated with the first train, so that the memory does not
+ * grow with the number of recorded trains. Quantities which are only needed
+ * for visualization, e.g. the standard deviation and the average over memory
+ * cells, are derived on request.
+ *
+ * Train-resolved data are treated as data with a single memory cell.
+ */
+template<typename T>
+class DarkAccumulator
+{
+public:
+
+  using value_type = T;
+  using shape_type = std::array<std::size_t, 3>;
+
+  DarkAccumulator() = default;
+
+  DarkAccumulator(const DarkAccumulator&) = delete;
+  DarkAccumulator& operator=(const DarkAccumulator&) = delete;
+
+  /**
+   * Add the data of a train.
+   *
+   * All the statistics are updated in a single pass over the data. A new
+   * accumulation is started if the shape of the data changes.
+   *
+   * @param src: pointer to the first pixel of the data.
+   * @param shape: shape (memory cells, y, x) of the data.
+   * @param strides: strides (memory cells, y, x) of the data in elements.
+   */
+  template<typename U>
+  void update(const U* src, const shape_type& shape, const std::array<std::ptrdiff_t, 3>& strides)
+  {
+    if (shape != shape_) reshape(shape);
+    ++count_;
+
+    T* mean = mean_.data();
+    T* m2 = m2_.data();
+    uint32_t* n_valid = n_valid_.data();
+    std::size_t ny = shape_[1];
+    std::size_t nx = shape_[2];
+
+    detail::parallelForImageRows(shape_[0], ny, nx,
+      [=] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+      {
+        const U* s = src + static_cast<std::ptrdiff_t>(i) * strides[0] + static_cast<std::ptrdiff_t>(j) * strides[1];
+        std::size_t offset = (i * ny + j) * nx;
+        for (std::size_t k = k0; k < k0 + n; ++k)
+        {
+          T v = static_cast<T>(s[static_cast<std::ptrdiff_t>(k) * strides[2]]);
+          if (std::isnan(v)) continue;
+
+          std::size_t idx = offset + k;
+          uint32_t n = ++n_valid[idx];
+          if (n == 1)
+          {
+            mean[idx] = v;
+            m2[idx] = T(0);
+          } else
+          {
+            T delta = v - mean[idx];
+            mean[idx] += delta / static_cast<T>(n);
+            m2[idx] += delta * (v - mean[idx]);
+          }
+        }
+      }
+    );
+  }
+
+  /**
+   * Add the data of a pulse-resolved train.
+   *
+   * @param src: image data. shape = (memory cells, y, x)
+   */
+  template<typename E, EnableIf<E, IsImageArray> = false>
+  void update(const E& src)
+  {
+    auto ss = src.shape();
+    auto st = src.strides();
+    update(src.data() + src.data_offset(),
+           {ss[0], ss[1], ss[2]},
+           {static_cast<std::ptrdiff_t>(st[0]), static_cast<std::ptrdiff_t>(st[1]),
+            static_cast<std::ptrdiff_t>(st[2])});
+  }
+
+  /**
+   * Add the data of a train-resolved train.
+   *
+   * @param src: image data. shape = (y, x)
+   */
+  template<typename E, EnableIf<E, IsImage> = false>
+  void update(const E& src)
+  {
+    auto ss = src.shape();
+    auto st = src.strides();
+    update(src.data() + src.data_offset(),
+           {1, ss[0], ss[1]},
+           {0, static_cast<std::ptrdiff_t>(st[0]), static_cast<std::ptrdiff_t>(st[1])});
+  }
+
+  /**
+   * Calculate the standard deviation.
+   *
+   * NaN is written if a pixel has no more than ddof valid values.
+   *
+   * @param out: output array. shape = (memory cells, y, x)
+   * @param ddof: delta degrees of freedom.
+   */
+  template<typename E, EnableIf<E, IsImageArray> = false>
+  void stddev(E& out, std::size_t ddof = 0) const
+  {
+    checkShape(out.shape(), shape_);
+
+    const T* m2 = m2_.data();
+    const uint32_t* n_valid = n_valid_.data();
+    std::size_t ny = shape_[1];
+    std::size_t nx = shape_[2];
+    detail::parallelForImageRows(shape_[0], ny, nx,
+      [&out, m2, n_valid, ny, nx, ddof] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+      {
+        std::size_t offset = (i * ny + j) * nx;
+        for (std::size_t k = k0; k < k0 + n; ++k)
+        {
+          std::size_t n = n_valid[offset + k];
+          // m2 can be slightly negative due to rounding
+          out(i, j, k) = n > ddof ? std::sqrt(std::max(m2[offset + k] / static_cast<T>(n - ddof), T(0)))
+                                  : std::numeric_limits<T>::quiet_NaN();
+        }
+      }
+    );
+  }
+
+  /**
+   * Calculate the number of NaN values received.
+   *
+   * @param out: output array. shape = (memory cells, y, x)
+   */
+  template<typename E, EnableIf<E, IsImageArray> = false>
+  void nanCount(E& out) const
+  {
+    checkShape(out.shape(), shape_);
+
+    const uint32_t* n_valid = n_valid_.data();
+    std::size_t ny = shape_[1];
+    std::size_t nx = shape_[2];
+    std::size_t count = count_;
+    detail::parallelForImageRows(shape_[0], ny, nx,
+      [&out, n_valid, ny, nx, count] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+      {
+        std::size_t offset = (i * ny + j) * nx;
+        for (std::size_t k = k0; k < k0 + n; ++k) out(i, j, k) = count - n_valid[offset + k];
+      }
+    );
+  }
+
+  /**
+   * Calculate the nanmean of the averages of all the memory cells.
+   *
+   * @param out: output image. shape = (y, x)
+   */
+  template<typename E, EnableIf<E, IsImage> = false>
+  void meanImage(E& out) const
+  {
+    checkShape(out.shape(), std::array<std::size_t, 2>{{shape_[1], shape_[2]}});
+
+    std::size_t n_cells = shape_[0];
+    std::size_t ny = shape_[1];
+    std::size_t nx = shape_[2];
+    const T* mean = mean_.data();
+    detail::parallelForImageRows(1, ny, nx,
+      [&out, mean, n_cells, ny, nx] (std::size_t, std::size_t j, std::size_t k0, std::size_t n)
+      {
+        for (std::size_t k = k0; k < k0 + n; ++k)
+        {
+          T sum = 0;
+          std::size_t n = 0;
+          for (std::size_t i = 0; i < n_cells; ++i)
+          {
+            T v = mean[(i * ny + j) * nx + k];
+            if (std::isnan(v)) continue;
+            sum += v;
+            ++n;
+          }
+          out(j, k) = n > 0 ? sum / static_cast<T>(n) : std::numeric_limits<T>::quiet_NaN();
+        }
+      }
+    );
+  }
+
+  /**
+   * Calculate the bad pixel mask from the noise.
+   *
+   * A pixel is masked if it has never received a valid value or if its
+   * standard deviation is outside [lb, ub] in any memory cell.
+   *
+   * @param out: output mask. shape = (y, x)
+   * @param lb: lower boundary of the noise.
+   * @param ub: upper boundary of the noise.
+   */
+  template<typename M, EnableIf<M, IsImage> = false>
+  void noiseMask(M& out, T lb, T ub) const
+  {
+    checkShape(out.shape(), std::array<std::size_t, 2>{{shape_[1], shape_[2]}});
+
+    std::size_t n_cells = shape_[0];
+    std::size_t ny = shape_[1];
+    std::size_t nx = shape_[2];
+    const T* m2 = m2_.data();
+    const uint32_t* n_valid = n_valid_.data();
+    detail::parallelForImageRows(1, ny, nx,
+      [&out, m2, n_valid, n_cells, ny, nx, lb, ub] (std::size_t, std::size_t j, std::size_t k0, std::size_t n)
+      {
+        for (std::size_t k = k0; k < k0 + n; ++k)
+        {
+          bool masked = false;
+          for (std::size_t i = 0; i < n_cells; ++i)
+          {
+            std::size_t idx = (i * ny + j) * nx + k;
+            uint32_t n = n_valid[idx];
+            T sigma = n > 0 ? std::sqrt(std::max(m2[idx] / static_cast<T>(n), T(0))) : T(0);
+            if (n == 0 || sigma < lb || sigma > ub)
+            {
+              masked = true;
+              break;
+            }
+          }
+          out(j, k) = masked;
+        }
+      }
+    );
+  }
+
+  /**
+   * Discard the accumulated data. The memory is kept.
+   */
+  void reset()
+  {
+    std::fill(mean_.begin(), mean_.end(), std::numeric_limits<T>::quiet_NaN());
+    std::fill(m2_.begin(), m2_.end(), T(0));
+    std::fill(n_valid_.begin(), n_valid_.end(), 0);
+    count_ = 0;
+  }
+
+  /**
+   * Number of accumulated trains.
+   */
+  std::size_t count() const { return count_; }
+
+  /**
+   * Shape (memory cells, y, x) of the accumulated data.
+   */
+  const shape_type& shape() const { return shape_; }
+
+  /**
+   * Running average. NaN for pixels which have not received a valid value.
+   */
+  const T* mean() const { return mean_.data(); }
+
+private:
+
+  void reshape(const shape_type& shape)
+  {
+    std::size_t size = shape[0] * shape[1] * shape[2];
+    mean_.assign(size, std::numeric_limits<T>::quiet_NaN());
+    m2_.assign(size, T(0));
+    n_valid_.assign(size, 0);
+    shape_ = shape;
+    count_ = 0;
+  }
+
+  template<typename S, std::size_t N>
+  void checkShape(const S& shape, const std::array<std::size_t, N>& expected) const
+  {
+    if (shape.size() != N || ! std::equal(expected.begin(), expected.end(), shape.begin()))
+    {
+      std::stringstream fmt;
+      fmt << "Expected output with shape (";
+      for (std::size_t i = 0; i < N; ++i) fmt << (i > 0 ? ", " : "") << expected[i];
+      fmt << ")";
+      throw std::invalid_argument(fmt.str());
+    }
+  }
+
+  shape_type shape_ {{0, 0, 0}};
+  std::vector<T> mean_;
+  std::vector<T> m2_;
+  std::vector<uint32_t> n_valid_;
+  std::size_t count_ = 0;
+};
+
+} // foam
+
+#endif //EXTRA_FOAM_DARK_ACCUMULATOR_H
@@ -0,0 +1,185 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_DIGITIZER_H
+#define EXTRA_FOAM_DIGITIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "f_parallel.hpp"
+
+
+namespace foam
+{
+
+/**
+ * Sample windows for integrating the pulses in a digitizer waveform.
+ *
+ * The baseline is the mean of the samples in [baseline_start, baseline_end).
+ * The i-th pulse consists of the samples in
+ * [pulse_start + i * pulse_period, pulse_start + i * pulse_period + pulse_width).
+ */
+struct PulseWindows
+{
+  std::size_t baseline_start;
+  std::size_t baseline_end;
+  std::size_t pulse_start;
+  std::size_t pulse_period;
+  std::size_t pulse_width;
+
+  /**
+   * Number of pulses which fit in a waveform of n_samples samples.
+   */
+  std::size_t maxPulses(std::size_t n_samples) const
+  {
+    if (pulse_start + pulse_width > n_samples) return 0;
+    if (pulse_period == 0) return 1;
+    return (n_samples - pulse_start - pulse_width) / pulse_period + 1;
+  }
+
+  void check(std::size_t n_samples, std::size_t n_pulses) const
+  {
+    if (baseline_end < baseline_start)
+      throw std::invalid_argument("Baseline end must not be smaller than baseline start!");
+    if (baseline_end > n_samples)
+      throw std::out_of_range("Baseline window is out of the waveform!");
+    if (pulse_width == 0) throw std::invalid_argument("Pulse width must be positive!");
+    if (n_pulses > 1 && pulse_period == 0)
+      throw std::invalid_argument("Pulse period must be positive for more than one pulse!");
+    if (n_pulses > maxPulses(n_samples))
+    {
+      std::stringstream ss;
+      ss << "Only " << maxPulses(n_samples) << " pulses fit in a waveform of "
+         << n_samples << " samples, requested " << n_pulses;
+      throw std::out_of_range(ss.str());
+    }
+  }
+};
+
+namespace detail
+{
+
+template<typename T>
+using IntegralAccType = std::conditional_t<std::is_integral<T>::value, std::int64_t, double>;
+
+/**
+ * Sum of the samples p[0], p[stride], ..., p[(n - 1) * stride].
+ *
+ * Integer samples are summed exactly in 64-bit integers.
+ */
+template<typename T>
+inline IntegralAccType<T> sumSamples(const T* p, std::ptrdiff_t stride, std::size_t n)
+{
+  IntegralAccType<T> acc = 0;
+  if (stride == 1)
+  {
+    // contiguous samples, which can be vectorized by the compiler
+    for (std::size_t k = 0; k < n; ++k) acc += p[k];
+  } else
+  {
+    for (std::size_t k = 0; k < n; ++k) acc += p[k * stride];
+  }
+  return acc;
+}
+
+template<typename E, typename O>
+inline void integratePulsesTo(const E& src, const PulseWindows& windows, O& out)
+{
+  using value_type = typename O::value_type;
+
+  std::size_t n_samples = src.shape()[0];
+  std::size_t n_pulses = out.shape()[0];
+  windows.check(n_samples, n_pulses);
+  if (n_pulses == 0) return;
+
+  const auto* p = &src(0);
+  auto stride = static_cast<std::ptrdiff_t>(src.strides()[0]);
+
+  std::size_t n_baseline = windows.baseline_end - windows.baseline_start;
+  double baseline = 0.;
+  if (n_baseline > 0)
+  {
+    baseline = static_cast<double>(sumSamples(p + windows.baseline_start * stride, stride, n_baseline))
+               / n_baseline;
+  }
+  double offset = baseline * windows.pulse_width;
+
+  parallelFor(n_pulses, [&out, &windows, p, stride, offset] (std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      std::size_t start = windows.pulse_start + i * windows.pulse_period;
+      auto sum = sumSamples(p + start * stride, stride, windows.pulse_width);
+      out(i) = static_cast<value_type>(static_cast<double>(sum) - offset);
+    }
+  });
+}
+
+} // detail
+
+/**
+ * Integrate the pulses in a digitizer waveform with baseline subtraction.
+ *
+ * The raw samples, e.g. int16 for ADQ digitizers, are read directly without
+ * being converted to floating point first.
+ *
+ * @tparam R: type of the output array, e.g. xt::xtensor<float, 1>.
+ *
+ * @param src: waveform. shape = (samples,)
+ * @param baseline_start: first sample of the baseline window.
+ * @param baseline_end: end (exclusive) of the baseline window. If it is the
+ *                      same as baseline_start, the baseline is 0.
+ * @param pulse_start: first sample of the first pulse.
+ * @param pulse_period: number of samples between two pulses.
+ * @param pulse_width: number of samples of each pulse.
+ * @param n_pulses: number of pulses. 0 for as many pulses as fit in the
+ *                  waveform.
+ *
+ * @return: integrals of the pulses, i.e. the sum of (sample - baseline)
+ *          within each pulse. shape = (pulses,)
+ */
+template<typename R, typename E>
+inline R integratePulses(const E& src, std::size_t baseline_start, std::size_t baseline_end,
+                         std::size_t pulse_start, std::size_t pulse_period, std::size_t pulse_width,
+                         std::size_t n_pulses = 0)
+{
+  FOAM_PROFILE_SCOPE("integratePulses", profiler::nBytes(src));
+
+  PulseWindows windows {baseline_start, baseline_end, pulse_start, pulse_period, pulse_width};
+  if (n_pulses == 0) n_pulses = windows.maxPulses(src.shape()[0]);
+
+  profiler::countAllocation();
+  auto out = R::from_shape({n_pulses});
+  detail::integratePulsesTo(src, windows, out);
+  return out;
+}
+
+/**
+ * Integrate the pulses in a digitizer waveform into a pre-allocated array.
+ *
+ * The number of pulses is the size of the output.
+ */
+template<typename E, typename O>
+inline void integratePulses(const E& src, std::size_t baseline_start, std::size_t baseline_end,
+                            std::size_t pulse_start, std::size_t pulse_period, std::size_t pulse_width,
+                            O& out)
+{
+  FOAM_PROFILE_SCOPE("integratePulses", profiler::nBytes(src));
+
+  PulseWindows windows {baseline_start, baseline_end, pulse_start, pulse_period, pulse_width};
+  detail::integratePulsesTo(src, windows, out);
+}
+
+} // foam
+
+#endif //EXTRA_FOAM_DIGITIZER_H
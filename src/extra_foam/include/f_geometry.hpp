@@ -15,24 +15,269 @@
 #include <array>
 #include <type_traits>
 #include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "xtensor/xio.hpp"
 #include "xtensor/xview.hpp"
 #include "xtensor/xfixed.hpp"
 #include "xtensor/xmath.hpp"
 #include "xtensor/xindex_view.hpp"
-#if defined(FOAM_WITH_TBB)
-#include "tbb/parallel_for.h"
-#include "tbb/blocked_range2d.h"
-#include "tbb/blocked_range3d.h"
-#endif
 
 #include "f_traits.hpp"
+#include "f_parallel.hpp"
 #include <algorithm>
 
 namespace foam
 {
 
+namespace detail
+{
+
+/**
+ * A run of pixels which are contiguous along a row of the assembled image.
+ *
+ * The run starts at (mod_row, mod_col) of the module data and (img_row, img_col)
+ * of the assembled image. For each successive pixel, the module position moves
+ * by (mod_drow, mod_dcol) and the image column by img_dcol.
+ */
+struct AssemblyRun
+{
+  int mod_row;
+  int mod_col;
+  int mod_drow;
+  int mod_dcol;
+  int img_row;
+  int img_col;
+  int img_dcol;
+  int length;
+  bool edge; // whether the run is the first or the last row of a tile
+};
+
+/**
+ * Index of the first pixel of a tile along an axis of the assembled image.
+ *
+ * @param pos: position of the corner of the first pixel in pixels.
+ * @param center: index of the origin in the assembled image.
+ * @param dir: direction (1 or -1) of the tile along the axis.
+ */
+inline int firstPixelIndex(double pos, int center, int dir)
+{
+  int idx = static_cast<int>(std::round(pos)) + center;
+  return dir > 0 ? idx : idx - 1;
+}
+
+/**
+ * Append the runs of a tile to the assembly plan of a module.
+ *
+ * @param origin: (row, col) of the first pixel of the tile in the module data.
+ * @param transposed: true if the rows of the module data run along the y axis of the
+ *    assembled image, i.e. each column of the tile is a run.
+ * @param n_runs: number of rows of the assembled image covered by the tile.
+ * @param length: number of pixels of each run.
+ * @param img_row: row of the first pixel in the assembled image.
+ * @param img_col: column of the first pixel in the assembled image.
+ * @param ix_dir: direction (1 or -1) of the runs along the x axis.
+ * @param iy_dir: direction (1 or -1) of the successive runs along the y axis.
+ */
+inline void appendTileRuns(std::vector<AssemblyRun>& runs, const std::array<int, 2>& origin, bool transposed,
+                           int n_runs, int length, int img_row, int img_col, int ix_dir, int iy_dir)
+{
+  for (int i = 0; i < n_runs; ++i)
+  {
+    AssemblyRun run;
+    if (transposed)
+    {
+      run.mod_row = origin[0];
+      run.mod_col = origin[1] + i;
+      run.mod_drow = 1;
+      run.mod_dcol = 0;
+    } else
+    {
+      run.mod_row = origin[0] + i;
+      run.mod_col = origin[1];
+      run.mod_drow = 0;
+      run.mod_dcol = 1;
+    }
+    run.img_row = img_row + i * iy_dir;
+    run.img_col = img_col;
+    run.img_dcol = ix_dir;
+    run.length = length;
+    run.edge = (i == 0 || i == n_runs - 1);
+    runs.push_back(run);
+  }
+}
+
+/**
+ * Copy n elements between two strided ranges.
+ */
+template<typename T, typename U>
+inline void copyRun(const T* src, std::ptrdiff_t ss, U* dst, std::ptrdiff_t ds, int n)
+{
+  if (ss == 1 && ds == 1)
+  {
+    std::copy_n(src, n, dst);
+  } else
+  {
+    for (int i = 0; i < n; ++i, src += ss, dst += ds) *dst = static_cast<U>(*src);
+  }
+}
+
+/**
+ * Correct and mask n elements between two strided ranges.
+ *
+ * The strides of the gain, the offset and the mask are given in cs. Masked
+ * elements are set to nan.
+ */
+template<typename T, typename U>
+inline void correctRun(const T* src, std::ptrdiff_t ss, U* dst, std::ptrdiff_t ds,
+                       const U* gain, const U* offset, const bool* mask,
+                       const std::array<std::ptrdiff_t, 3>& cs, int n)
+{
+  if (mask == nullptr)
+  {
+    for (int i = 0; i < n; ++i, src += ss, dst += ds, gain += cs[0], offset += cs[1])
+    {
+      *dst = *gain * (static_cast<U>(*src) - *offset);
+    }
+  } else
+  {
+    constexpr U nan = std::numeric_limits<U>::quiet_NaN();
+    for (int i = 0; i < n; ++i, src += ss, dst += ds, gain += cs[0], offset += cs[1], mask += cs[2])
+    {
+      *dst = *mask ? nan : *gain * (static_cast<U>(*src) - *offset);
+    }
+  }
+}
+
+template<typename E>
+inline std::array<std::ptrdiff_t, 2> lastStrides(const E& e)
+{
+  auto n = e.strides().size();
+  return {static_cast<std::ptrdiff_t>(e.strides()[n - 2]), static_cast<std::ptrdiff_t>(e.strides()[n - 1])};
+}
+
+/**
+ * Position a single module at the assembled image by replaying its assembly plan.
+ *
+ * @param runs: assembly plan of the module.
+ * @param src: pointer to the first pixel of the module data.
+ * @param ss: strides (y, x) of the module data.
+ * @param dst: pointer to the first pixel of the assembled image.
+ * @param ds: strides (y, x) of the assembled image.
+ * @param ignore_tile_edge: true for ignoring the pixels at the edges of tiles.
+ */
+template<typename T, typename U, typename S>
+inline void positionRuns(const std::vector<AssemblyRun>& runs, const T* src, const S& ss, U* dst, const S& ds,
+                         bool ignore_tile_edge)
+{
+  for (const auto& run : runs)
+  {
+    int trim = 0;
+    if (ignore_tile_edge)
+    {
+      if (run.edge) continue;
+      trim = 1;
+    }
+
+    std::ptrdiff_t src_step = run.mod_drow * ss[0] + run.mod_dcol * ss[1];
+    std::ptrdiff_t dst_step = run.img_dcol * ds[1];
+    copyRun(src + run.mod_row * ss[0] + run.mod_col * ss[1] + trim * src_step, src_step,
+            dst + run.img_row * ds[0] + run.img_col * ds[1] + trim * dst_step, dst_step,
+            run.length - 2 * trim);
+  }
+}
+
+/**
+ * Correct, mask and position a single module at the assembled image by
+ * replaying its assembly plan.
+ *
+ * @param gain: pointer to the first gain constant of the module.
+ * @param offset: pointer to the first offset constant of the module.
+ * @param mask: pointer to the first mask pixel of the module. nullptr for no mask.
+ * @param cs: strides (y, x) of the gain, offset and mask, respectively.
+ */
+template<typename T, typename U, typename S>
+inline void correctRuns(const std::vector<AssemblyRun>& runs, const T* src, const S& ss, U* dst, const S& ds,
+                        const U* gain, const U* offset, const bool* mask, const std::array<S, 3>& cs,
+                        bool ignore_tile_edge)
+{
+  for (const auto& run : runs)
+  {
+    int trim = 0;
+    if (ignore_tile_edge)
+    {
+      if (run.edge) continue;
+      trim = 1;
+    }
+
+    int mod_row = run.mod_row + trim * run.mod_drow;
+    int mod_col = run.mod_col + trim * run.mod_dcol;
+    std::array<std::ptrdiff_t, 3> c_step;
+    for (int i = 0; i < 3; ++i) c_step[i] = run.mod_drow * cs[i][0] + run.mod_dcol * cs[i][1];
+    correctRun(src + mod_row * ss[0] + mod_col * ss[1], run.mod_drow * ss[0] + run.mod_dcol * ss[1],
+               dst + run.img_row * ds[0] + (run.img_col + trim * run.img_dcol) * ds[1],
+               run.img_dcol * ds[1],
+               gain + mod_row * cs[0][0] + mod_col * cs[0][1],
+               offset + mod_row * cs[1][0] + mod_col * cs[1][1],
+               mask == nullptr ? nullptr : mask + mod_row * cs[2][0] + mod_col * cs[2][1],
+               c_step, run.length - 2 * trim);
+  }
+}
+
+/**
+ * Dismantle a single module from the assembled image by replaying its assembly plan.
+ *
+ * @param src: pointer to the first pixel of the assembled image.
+ * @param ss: strides (y, x) of the assembled image.
+ * @param dst: pointer to the first pixel of the module data.
+ * @param ds: strides (y, x) of the module data.
+ */
+template<typename T, typename U, typename S>
+inline void dismantleRuns(const std::vector<AssemblyRun>& runs, const T* src, const S& ss, U* dst, const S& ds)
+{
+  for (const auto& run : runs)
+  {
+    copyRun(src + run.img_row * ss[0] + run.img_col * ss[1], run.img_dcol * ss[1],
+            dst + run.mod_row * ds[0] + run.mod_col * ds[1], run.mod_drow * ds[0] + run.mod_dcol * ds[1],
+            run.length);
+  }
+}
+
+/**
+ * Write the positions of the pixels of a single module in the assembled image.
+ *
+ * @param dst: (row, col) of each pixel. shape=(modules, y, x, 2)
+ * @param im: index of the module.
+ */
+template<typename E>
+inline void runPixelPositions(const std::vector<AssemblyRun>& runs, E& dst, int im, bool ignore_tile_edge)
+{
+  using value_type = typename E::value_type;
+  for (const auto& run : runs)
+  {
+    int trim = 0;
+    if (ignore_tile_edge)
+    {
+      if (run.edge) continue;
+      trim = 1;
+    }
+
+    for (int i = trim; i < run.length - trim; ++i)
+    {
+      int mod_row = run.mod_row + i * run.mod_drow;
+      int mod_col = run.mod_col + i * run.mod_dcol;
+      dst(im, mod_row, mod_col, 0) = static_cast<value_type>(run.img_row);
+      dst(im, mod_row, mod_col, 1) = static_cast<value_type>(run.img_col + i * run.img_dcol);
+    }
+  }
+}
+
+} // detail
+
 template<typename G>
 class Detector1MGeometryBase
 {
@@ -86,6 +331,61 @@ public:
     EnableIf<std::decay_t<M>, IsModulesVector> = false, EnableIf<E, IsImageArray> = false>
   void positionAllModules(M&& src, E& dst, bool ignore_tile_edge=false) const;
 
+  /**
+   * Position a single module of all the memory cells at the correct area of
+   * the given assembled image.
+   *
+   * It allows assembling a module as soon as its data has arrived.
+   *
+   * @param src: multi-pulse, multiple-module data. shape=(memory cells, modules, y, x)
+   * @param dst: assembled data. shape=(memory cells, y, x)
+   * @param im: index of the module.
+   * @param ignore_tile_edge: true for ignoring the pixels at the edges of tiles.
+   */
+  template<typename M, typename E,
+    EnableIf<std::decay_t<M>, IsModulesArray> = false, EnableIf<E, IsImageArray> = false>
+  void positionModule(M&& src, E& dst, int im, bool ignore_tile_edge=false) const;
+
+  /**
+   * Correct and position all the modules at the correct area of the given
+   * assembled image in a single pass.
+   *
+   * The corrected value of a pixel is gain * (src - offset).
+   *
+   * @param src: multi-pulse, multiple-module data. shape=(memory cells, modules, y, x)
+   * @param dst: assembled data. shape=(memory cells, y, x)
+   * @param gain: gain constants. shape=(modules, y, x)
+   * @param offset: offset constants. shape=(modules, y, x)
+   * @param ignore_tile_edge: true for ignoring the pixels at the edges of tiles. If dst
+   *    is pre-filled with nan, it it equivalent to masking the tile edges.
+   */
+  template<typename M, typename E, typename C,
+    EnableIf<std::decay_t<M>, IsModulesArray> = false, EnableIf<E, IsImageArray> = false,
+    EnableIf<C, IsImageArray> = false>
+  void positionAllModules(M&& src, E& dst, const C& gain, const C& offset,
+                          bool ignore_tile_edge=false) const;
+
+  /**
+   * Correct, mask and position all the modules at the correct area of the
+   * given assembled image in a single pass.
+   *
+   * The corrected value of a pixel is gain * (src - offset) and masked pixels
+   * are set to nan.
+   *
+   * @param src: multi-pulse, multiple-module data. shape=(memory cells, modules, y, x)
+   * @param dst: assembled data. shape=(memory cells, y, x)
+   * @param gain: gain constants. shape=(modules, y, x)
+   * @param offset: offset constants. shape=(modules, y, x)
+   * @param mask: pixel mask in modules. shape=(modules, y, x)
+   * @param ignore_tile_edge: true for ignoring the pixels at the edges of tiles. If dst
+   *    is pre-filled with nan, it it equivalent to masking the tile edges.
+   */
+  template<typename M, typename E, typename C, typename K,
+    EnableIf<std::decay_t<M>, IsModulesArray> = false, EnableIf<E, IsImageArray> = false,
+    EnableIf<C, IsImageArray> = false, EnableIf<K, IsImageArray> = false>
+  void positionAllModules(M&& src, E& dst, const C& gain, const C& offset, const K& mask,
+                          bool ignore_tile_edge=false) const;
+
   /**
    * Dismantle an assembled image into modules.
    *
@@ -106,6 +406,20 @@ public:
     EnableIf<std::decay_t<M>, IsImageArray> = false, EnableIf<E, IsModulesArray> = false>
   void dismantleAllModules(M&& src, E& dst) const;
 
+  /**
+   * Compute the positions of the module pixels in the assembled image.
+   *
+   * It allows algorithms to work on the data in modules directly without
+   * assembling them.
+   *
+   * @param dst: (row, col) of each pixel in the assembled image. The pixels which
+   *    are not positioned, i.e. the tile edges if ignore_tile_edge is true, are
+   *    set to -1. shape=(modules, y, x, 2)
+   * @param ignore_tile_edge: true for ignoring the pixels at the edges of tiles.
+   */
+  template<typename E, EnableIf<E, IsModulesArray> = false>
+  void pixelPositions(E& dst, bool ignore_tile_edge=false) const;
+
   /**
    * Return the shape (y, x) of the assembled image.
    */
@@ -116,8 +430,21 @@ public:
 
 protected:
 
+  using AssemblyRun = detail::AssemblyRun;
+
+  // The assembly plan of each module. It only depends on the geometry, i.e.
+  // a new geometry needs to be constructed when the quadrant positions change.
+  std::array<std::vector<AssemblyRun>, n_modules> plan_;
+
   Detector1MGeometryBase() = default;
 
+  /**
+   * Build the assembly plan from the corner positions of the tiles.
+   *
+   * It must be called at the end of the constructors of the concrete geometry.
+   */
+  void buildAssemblyPlan();
+
   /**
    * Return the size (y, x) and center (x, y) of the assembled image.
    */
@@ -133,14 +460,36 @@ protected:
   void checkShapeForAssembling(const SrcShape& ss, const DstShape& ds) const;
 
   /**
-   * Position a single module at the assembled image.
+   * Position a single module at the assembled image by replaying the assembly plan.
+   *
+   * @param src: pointer to the first pixel of the module data.
+   * @param ss: strides (y, x) of the module data.
+   * @param dst: pointer to the first pixel of the assembled image.
+   * @param ds: strides (y, x) of the assembled image.
+   * @param im: index of the module.
+   */
+  template<typename T, typename U, typename S>
+  void positionModule(const T* src, const S& ss, U* dst, const S& ds, int im, bool ignore_tile_edge) const;
+
+  /**
+   * Correct, mask and position a single module at the assembled image by
+   * replaying the assembly plan.
    *
-   * @param src: data from a single module. shape=(y, x).
-   * @param dst: assembled single image. shape=(y, x)
-   * @param pos: two diagonal corner positions of each tile. shape=(tiles, 2, 3)
+   * @param gain: pointer to the first gain constant of the module.
+   * @param offset: pointer to the first offset constant of the module.
+   * @param mask: pointer to the first mask pixel of the module. nullptr for no mask.
+   * @param cs: strides (y, x) of the gain, offset and mask, respectively.
+   */
+  template<typename T, typename U, typename S>
+  void positionModule(const T* src, const S& ss, U* dst, const S& ds,
+                      const U* gain, const U* offset, const bool* mask, const std::array<S, 3>& cs,
+                      int im, bool ignore_tile_edge) const;
+
+  /**
+   * Check the shape of the constants used for assembling.
    */
-  template<typename M, typename N, typename T>
-  void positionModule(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const;
+  template<typename Shape>
+  void checkShapeForConstants(const Shape& cs, const std::string& name) const;
 
   /**
    * Check the src and dst shapes used for dismantling..
@@ -152,14 +501,16 @@ protected:
   void checkShapeForDismantling(const SrcShape& ss, const DstShape& ds) const;
 
   /**
-   * Dismantle a single module into tiles.
+   * Dismantle a single module from the assembled image by replaying the assembly plan.
    *
-   * @param src: data from a single module. shape=(y, x).
-   * @param dst: assembled single image. shape=(y, x)
-   * @param pos: two diagonal corner positions of each tile. shape=(tiles, 2, 3)
+   * @param src: pointer to the first pixel of the assembled image.
+   * @param ss: strides (y, x) of the assembled image.
+   * @param dst: pointer to the first pixel of the module data.
+   * @param ds: strides (y, x) of the module data.
+   * @param im: index of the module.
    */
-  template<typename M, typename N, typename T>
-  void dismantleModule(M&& src, N& dst, T&& pos) const;
+  template<typename T, typename U, typename S>
+  void dismantleModule(const T* src, const S& ss, U* dst, const S& ds, int im) const;
 };
 
 template<typename G>
@@ -173,22 +524,18 @@ template<typename G>
 template<typename M, typename E, EnableIf<std::decay_t<M>, IsImageArray>, EnableIf<E, IsImage>>
 void Detector1MGeometryBase<G>::positionAllModules(M&& src, E& dst, bool ignore_tile_edge) const
 {
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
   auto ss = src.shape();
   auto ds = dst.shape();
   this->checkShapeForAssembling(
     std::array<int, 4>({1, static_cast<int>(ss[0]), static_cast<int>(ss[1]), static_cast<int>(ss[2])}),
     std::array<int, 4>({1, static_cast<int>(ds[0]), static_cast<int>(ds[1])}));
 
-  auto norm_pos = static_cast<const G*>(this)->corner_pos_ / static_cast<const G*>(this)->pixelSize();
-
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
   for (int im = 0; im < n_modules; ++im)
   {
-      positionModule(
-        xt::view(src, im, xt::all(), xt::all()),
-        dst,
-        xt::view(norm_pos, im, xt::all(), xt::all(), xt::all()),
-        ignore_tile_edge
-      );
+    positionModule(&src(im, 0, 0), sst, &dst(0, 0), dst_st, im, ignore_tile_edge);
   }
 }
 
@@ -196,45 +543,27 @@ template<typename G>
 template<typename M, typename E, EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>>
 void Detector1MGeometryBase<G>::positionAllModules(M&& src, E& dst, bool ignore_tile_edge) const
 {
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
   auto ss = src.shape();
   auto ds = dst.shape();
   this->checkShapeForAssembling(ss, ds);
 
   int n_pulses = ss[0];
-  auto norm_pos = static_cast<const G*>(this)->corner_pos_ / static_cast<const G*>(this)->pixelSize();
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range2d<int>(0, n_modules, 0, n_pulses),
-    [&src, &dst, &norm_pos, ignore_tile_edge, this] (const tbb::blocked_range2d<int> &block)
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelForPulsesModules(n_pulses, n_modules,
+    [&src, &dst, &sst, &dst_st, ignore_tile_edge, this] (std::size_t ip, std::size_t im)
     {
-      for(int im=block.rows().begin(); im != block.rows().end(); ++im)
-      {
-        for(int ip=block.cols().begin(); ip != block.cols().end(); ++ip)
-        {
-#else
-      for (int im = 0; im < n_modules; ++im)
-        {
-        for (int ip = 0; ip < n_pulses; ++ip)
-        {
-#endif
-          auto&& dst_view = xt::view(dst, ip, xt::all(), xt::all());
-          positionModule(
-            xt::view(src, ip, im, xt::all(), xt::all()),
-            dst_view,
-            xt::view(norm_pos, im, xt::all(), xt::all(), xt::all()),
-            ignore_tile_edge
-          );
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      positionModule(&src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st, im, ignore_tile_edge);
     }
   );
-#endif
 }
 
 template<typename G>
 template<typename M, typename E, EnableIf<std::decay_t<M>, IsModulesVector>, EnableIf<E, IsImageArray>>
 void Detector1MGeometryBase<G>::positionAllModules(M&& src, E& dst, bool ignore_tile_edge) const
 {
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
   auto ms = src[0].shape();
   auto ss = std::array<int, 4> {static_cast<int>(ms[0]),
                                 static_cast<int>(src.size()),
@@ -244,56 +573,116 @@ void Detector1MGeometryBase<G>::positionAllModules(M&& src, E& dst, bool ignore_
   this->checkShapeForAssembling(ss, ds);
 
   int n_pulses = ss[0];
-  auto norm_pos = static_cast<const G*>(this)->corner_pos_ / static_cast<const G*>(this)->pixelSize();
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range2d<int>(0, n_modules, 0, n_pulses),
-    [&src, &dst, &norm_pos, ignore_tile_edge, this] (const tbb::blocked_range2d<int> &block)
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelForPulsesModules(n_pulses, n_modules,
+    [&src, &dst, &dst_st, ignore_tile_edge, this] (std::size_t ip, std::size_t im)
     {
-      for(int im=block.rows().begin(); im != block.rows().end(); ++im)
-      {
-        for(int ip=block.cols().begin(); ip != block.cols().end(); ++ip)
-        {
-#else
-      for (int im = 0; im < n_modules; ++im)
+      positionModule(&src[im](ip, 0, 0), detail::lastStrides(src[im]), &dst(ip, 0, 0), dst_st,
+                     im, ignore_tile_edge);
+    }
+  );
+}
+
+template<typename G>
+template<typename M, typename E, EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>>
+void Detector1MGeometryBase<G>::positionModule(M&& src, E& dst, int im, bool ignore_tile_edge) const
+{
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  this->checkShapeForAssembling(ss, ds);
+
+  if (im < 0 || im >= n_modules)
+  {
+    std::stringstream fmt;
+    fmt << "Module index " << im << " is out of range [0, " << n_modules << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelFor(ss[0], [&src, &dst, &sst, &dst_st, im, ignore_tile_edge, this]
+    (std::size_t begin, std::size_t end)
+    {
+      for (std::size_t ip = begin; ip != end; ++ip)
       {
-        for (int ip = 0; ip < n_pulses; ++ip)
-        {
-#endif
-          auto&& dst_view = xt::view(dst, ip, xt::all(), xt::all());
-          positionModule(
-            xt::view(src[im], ip, xt::all(), xt::all()),
-            dst_view,
-            xt::view(norm_pos, im, xt::all(), xt::all(), xt::all()),
-            ignore_tile_edge
-          );
-        }
+        positionModule(&src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st, im, ignore_tile_edge);
       }
-#if defined(FOAM_WITH_TBB)
     }
   );
-#endif
+}
+
+template<typename G>
+template<typename M, typename E, typename C,
+  EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>, EnableIf<C, IsImageArray>>
+void Detector1MGeometryBase<G>::positionAllModules(M&& src, E& dst, const C& gain, const C& offset,
+                                                   bool ignore_tile_edge) const
+{
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  this->checkShapeForAssembling(ss, ds);
+  this->checkShapeForConstants(gain.shape(), "gain");
+  this->checkShapeForConstants(offset.shape(), "offset");
+
+  int n_pulses = ss[0];
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  std::array<decltype(sst), 3> cst { detail::lastStrides(gain), detail::lastStrides(offset), decltype(sst)() };
+  detail::parallelForPulsesModules(n_pulses, n_modules,
+    [&src, &dst, &gain, &offset, &sst, &dst_st, &cst, ignore_tile_edge, this] (std::size_t ip, std::size_t im)
+    {
+      positionModule(&src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st,
+                     &gain(im, 0, 0), &offset(im, 0, 0), nullptr, cst, im, ignore_tile_edge);
+    }
+  );
+}
+
+template<typename G>
+template<typename M, typename E, typename C, typename K,
+  EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>,
+  EnableIf<C, IsImageArray>, EnableIf<K, IsImageArray>>
+void Detector1MGeometryBase<G>::positionAllModules(M&& src, E& dst, const C& gain, const C& offset,
+                                                   const K& mask, bool ignore_tile_edge) const
+{
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  this->checkShapeForAssembling(ss, ds);
+  this->checkShapeForConstants(gain.shape(), "gain");
+  this->checkShapeForConstants(offset.shape(), "offset");
+  this->checkShapeForConstants(mask.shape(), "mask");
+
+  int n_pulses = ss[0];
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  std::array<decltype(sst), 3> cst {
+    detail::lastStrides(gain), detail::lastStrides(offset), detail::lastStrides(mask) };
+  detail::parallelForPulsesModules(n_pulses, n_modules,
+    [&src, &dst, &gain, &offset, &mask, &sst, &dst_st, &cst, ignore_tile_edge, this]
+    (std::size_t ip, std::size_t im)
+    {
+      positionModule(&src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st,
+                     &gain(im, 0, 0), &offset(im, 0, 0), &mask(im, 0, 0), cst, im, ignore_tile_edge);
+    }
+  );
 }
 
 template<typename G>
 template<typename M, typename E, EnableIf<std::decay_t<M>, IsImage>, EnableIf<E, IsImageArray>>
 void Detector1MGeometryBase<G>::dismantleAllModules(M&& src, E& dst) const
 {
+  FOAM_PROFILE_SCOPE("dismantleAllModules", profiler::nBytes(src));
   auto ss = src.shape();
   auto ds = dst.shape();
   checkShapeForDismantling(
     std::array<int, 4>({1, static_cast<int>(ss[0]), static_cast<int>(ss[1])}),
     std::array<int, 4>({1, static_cast<int>(ds[0]), static_cast<int>(ds[1]), static_cast<int>(ds[2])}));
 
-  auto norm_pos = static_cast<const G*>(this)->corner_pos_ / static_cast<const G*>(this)->pixelSize();
-
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
   for (int im = 0; im < n_modules; ++im)
   {
-    auto&& dst_view = xt::view(dst, im, xt::all(), xt::all());
-    dismantleModule(
-      src,
-      dst_view,
-      xt::view(norm_pos, im, xt::all(), xt::all(), xt::all())
-    );
+    dismantleModule(&src(0, 0), sst, &dst(im, 0, 0), dst_st, im);
   }
 }
 
@@ -301,38 +690,39 @@ template<typename G>
 template<typename M, typename E, EnableIf<std::decay_t<M>, IsImageArray>, EnableIf<E, IsModulesArray>>
 void Detector1MGeometryBase<G>::dismantleAllModules(M&& src, E& dst) const
 {
+  FOAM_PROFILE_SCOPE("dismantleAllModules", profiler::nBytes(src));
   auto ss = src.shape();
   auto ds = dst.shape();
   checkShapeForDismantling(ss, ds);
 
   int n_pulses = ss[0];
-  auto norm_pos = static_cast<const G*>(this)->corner_pos_ / static_cast<const G*>(this)->pixelSize();
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range2d<int>(0, n_modules, 0, n_pulses),
-    [&src, &dst, &norm_pos, this] (const tbb::blocked_range2d<int> &block)
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelForPulsesModules(n_pulses, n_modules,
+    [&src, &dst, &sst, &dst_st, this] (std::size_t ip, std::size_t im)
     {
-      for(int im=block.rows().begin(); im != block.rows().end(); ++im)
-      {
-        for(int ip=block.cols().begin(); ip != block.cols().end(); ++ip)
-        {
-#else
-      for (int im = 0; im < n_modules; ++im)
-      {
-        for (int ip = 0; ip < n_pulses; ++ip)
-        {
-#endif
-          auto&& dst_view = xt::view(dst, ip, im, xt::all(), xt::all());
-          dismantleModule(
-            xt::view(src, ip, xt::all(), xt::all()),
-            dst_view,
-            xt::view(norm_pos, im, xt::all(), xt::all(), xt::all())
-          );
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      dismantleModule(&src(ip, 0, 0), sst, &dst(ip, im, 0, 0), dst_st, im);
     }
   );
-#endif
+}
+
+template<typename G>
+template<typename E, EnableIf<E, IsModulesArray>>
+void Detector1MGeometryBase<G>::pixelPositions(E& dst, bool ignore_tile_edge) const
+{
+  auto ds = dst.shape();
+  if (ds[0] != G::n_modules || ds[1] != G::module_shape[0] || ds[2] != G::module_shape[1] || ds[3] != 2)
+  {
+    std::stringstream fmt;
+    fmt << "Expected output array with shape (" << G::n_modules << ", " << G::module_shape[0]
+        << ", " << G::module_shape[1] << ", 2), get ("
+        << ds[0] << ", " << ds[1] << ", " << ds[2] << ", " << ds[3] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  using value_type = typename E::value_type;
+  std::fill(dst.begin(), dst.end(), value_type(-1));
+  for (int im = 0; im < n_modules; ++im) detail::runPixelPositions(plan_[im], dst, im, ignore_tile_edge);
 }
 
 template<typename G>
@@ -404,10 +794,68 @@ void Detector1MGeometryBase<G>::checkShapeForAssembling(const SrcShape& ss, cons
 }
 
 template<typename G>
-template<typename M, typename N, typename T>
-void Detector1MGeometryBase<G>::positionModule(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const
+void Detector1MGeometryBase<G>::buildAssemblyPlan()
+{
+  auto center = assembledDim().second;
+  auto norm_pos = static_cast<const G*>(this)->corner_pos_ / static_cast<const G*>(this)->pixelSize();
+  int wt = G::tile_shape[1];
+  int ht = G::tile_shape[0];
+
+  for (int im = 0; im < n_modules; ++im)
+  {
+    auto& runs = plan_[im];
+    runs.clear();
+    runs.reserve(G::n_tiles_per_module * ht);
+
+    for (int it = 0; it < G::n_tiles_per_module; ++it)
+    {
+      auto x0 = norm_pos(im, it, 0, 0);
+      auto y0 = norm_pos(im, it, 0, 1);
+
+      int ix_dir = (norm_pos(im, it, 1, 0) - x0 > 0) ? 1 : -1;
+      int iy_dir = (norm_pos(im, it, 1, 1) - y0 > 0) ? 1 : -1;
+
+      int ix0_dst = detail::firstPixelIndex(x0, center[0], ix_dir);
+      int iy0_dst = detail::firstPixelIndex(y0, center[1], iy_dir);
+
+      // origin of the tile in the module (y, x)
+      auto origin = G::tileOrigin(it);
+      // module data is stored as (x, y) if transposed
+      detail::appendTileRuns(runs, G::transposed ? std::array<int, 2>{origin[1], origin[0]} : origin,
+                             G::transposed, ht, wt, iy0_dst, ix0_dst, ix_dir, iy_dir);
+    }
+  }
+}
+
+template<typename G>
+template<typename T, typename U, typename S>
+void Detector1MGeometryBase<G>::positionModule(const T* src, const S& ss, U* dst, const S& ds,
+                                               int im, bool ignore_tile_edge) const
+{
+  detail::positionRuns(plan_[im], src, ss, dst, ds, ignore_tile_edge);
+}
+
+template<typename G>
+template<typename T, typename U, typename S>
+void Detector1MGeometryBase<G>::positionModule(const T* src, const S& ss, U* dst, const S& ds,
+                                               const U* gain, const U* offset, const bool* mask,
+                                               const std::array<S, 3>& cs,
+                                               int im, bool ignore_tile_edge) const
+{
+  detail::correctRuns(plan_[im], src, ss, dst, ds, gain, offset, mask, cs, ignore_tile_edge);
+}
+
+template<typename G>
+template<typename Shape>
+void Detector1MGeometryBase<G>::checkShapeForConstants(const Shape& cs, const std::string& name) const
 {
-  static_cast<const G*>(this)->positionModuleImp(std::forward<M>(src), dst, std::forward<T>(pos), ignore_tile_edge);
+  if (cs[0] != G::n_modules || cs[1] != G::module_shape[0] || cs[2] != G::module_shape[1])
+  {
+    std::stringstream fmt;
+    fmt << "Expected " << name << " with shape (" << G::n_modules << ", " << G::module_shape[0]
+        << ", " << G::module_shape[1] << "), get (" << cs[0] << ", " << cs[1] << ", " << cs[2] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
 }
 
 template<typename G>
@@ -441,10 +889,10 @@ void Detector1MGeometryBase<G>::checkShapeForDismantling(const SrcShape& ss, con
 }
 
 template<typename G>
-template<typename M, typename N, typename T>
-void Detector1MGeometryBase<G>::dismantleModule(M&& src, N& dst, T&& pos) const
+template<typename T, typename U, typename S>
+void Detector1MGeometryBase<G>::dismantleModule(const T* src, const S& ss, U* dst, const S& ds, int im) const
 {
-  static_cast<const G*>(this)->dismantleModuleImp(std::forward<M>(src), dst, std::forward<T>(pos));
+  detail::dismantleRuns(plan_[im], src, ss, dst, ds);
 }
 
 /**
@@ -486,11 +934,14 @@ private:
 
   friend Detector1MGeometryBase<AGIPD_1MGeometry>;
 
-  template<typename M, typename N, typename T>
-  void positionModuleImp(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const;
+  // module data are stored as (ss/x, fs/y)
+  static const bool transposed = true;
 
-  template<typename M, typename N, typename T>
-  void dismantleModuleImp(M&& src, N& dst, T&& pos) const;
+  // (y, x) of the first pixel of a tile in the module
+  static std::array<int, 2> tileOrigin(int it)
+  {
+    return {0, it * tile_shape[1]};
+  }
 
 public:
 
@@ -513,6 +964,7 @@ const AGIPD_1MGeometry::shapeType AGIPD_1MGeometry::module_shape {512, 128};
 // (fs/y, ss/x)
 const AGIPD_1MGeometry::shapeType AGIPD_1MGeometry::tile_shape {128, 64};
 constexpr int AGIPD_1MGeometry::n_tiles_per_module;
+constexpr bool AGIPD_1MGeometry::transposed;
 const AGIPD_1MGeometry::quadOrientType AGIPD_1MGeometry::quad_orientations {
   std::array<int, 2>{1, -1},
   std::array<int, 2>{1, -1},
@@ -571,6 +1023,8 @@ AGIPD_1MGeometry::AGIPD_1MGeometry()
       corner_pos_(im, it, 1, 2) = 0.0;
     }
   }
+
+  buildAssemblyPlan();
 }
 
 AGIPD_1MGeometry::AGIPD_1MGeometry(
@@ -591,77 +1045,11 @@ AGIPD_1MGeometry::AGIPD_1MGeometry(
       corner_pos_(im, it, 1, 2) = 0.0;
     }
   }
-}
-
-template<typename M, typename N, typename T>
-void AGIPD_1MGeometry::positionModuleImp(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const
-{
-  auto center = assembledDim().second;
-  int n_tiles = n_tiles_per_module;
-  int wt = tile_shape[1];
-  int ht = tile_shape[0];
-
-  int edge = 0;
-  if (ignore_tile_edge) edge = 1;
-
-  for (int it = 0; it < n_tiles; ++it)
-  {
-    auto x0 = pos(it, 0, 0);
-    auto y0 = pos(it, 0, 1);
 
-    int ix_dir = (pos(it, 1, 0) - x0 > 0) ? 1 : -1;
-    int iy_dir = (pos(it, 1, 1) - y0 > 0) ? 1 : -1;
-
-    int ix0 = it * wt;
-    int iy0 = 0;
-
-    int ix0_dst = ix_dir > 0 ? static_cast<int>(std::round(x0)) + center[0]
-                             : static_cast<int>(std::round(x0)) + center[0] - 1;
-    int iy0_dst = iy_dir > 0 ? static_cast<int>(std::round(y0)) + center[1]
-                             : static_cast<int>(std::round(y0)) + center[1] - 1;
-    for (int iy = iy0 + edge, iy_dst = iy0_dst + iy_dir * edge; iy < iy0 + ht - edge; ++iy, iy_dst += iy_dir)
-    {
-      for (int ix = ix0 + edge, ix_dst = ix0_dst + ix_dir * edge; ix < ix0 + wt - edge; ++ix, ix_dst += ix_dir)
-      {
-        dst(iy_dst, ix_dst) = src(ix, iy); // (fs/y, ss/x)
-      }
-    }
-  }
+  buildAssemblyPlan();
 }
 
-template<typename M, typename N, typename T>
-void AGIPD_1MGeometry::dismantleModuleImp(M&& src, N& dst, T&& pos) const
-{
-  auto center = assembledDim().second;
-  int n_tiles = n_tiles_per_module;
-  int wt = tile_shape[1];
-  int ht = tile_shape[0];
-
-  for (int it = 0; it < n_tiles; ++it)
-  {
-    auto x0 = pos(it, 0, 0);
-    auto y0 = pos(it, 0, 1);
-
-    int ix_dir = (pos(it, 1, 0) - x0 > 0) ? 1 : -1;
-    int iy_dir = (pos(it, 1, 1) - y0 > 0) ? 1 : -1;
 
-    int ix0 = ix_dir > 0 ? static_cast<int>(std::round(x0)) + center[0]
-                         : static_cast<int>(std::round(x0)) + center[0] - 1;
-    int iy0 = iy_dir > 0 ? static_cast<int>(std::round(y0)) + center[1]
-                         : static_cast<int>(std::round(y0)) + center[1] - 1;
-
-    int ix0_dst = it * wt;
-    int iy0_dst = 0;
-
-    for (int iy = iy0, iy_dst = iy0_dst; iy_dst < iy0_dst + ht; ++iy_dst, iy += iy_dir)
-    {
-      for (int ix = ix0 , ix_dst = ix0_dst; ix_dst < ix0_dst + wt; ++ix_dst, ix += ix_dir)
-      {
-        dst(ix_dst, iy_dst) = src(iy, ix); // (fs/y, ss/x)
-      }
-    }
-  }
-}
 
 /**
  * LPD-1M geometry
@@ -703,11 +1091,13 @@ private:
 
   friend Detector1MGeometryBase<LPD_1MGeometry>;
 
-  template<typename M, typename N, typename T>
-  void positionModuleImp(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const;
+  static const bool transposed = false;
 
-  template<typename M, typename N, typename T>
-  void dismantleModuleImp(M&& src, N& dst, T&& pos) const;
+  // (y, x) of the first pixel of a tile in the module
+  static std::array<int, 2> tileOrigin(int it)
+  {
+    return {it < 8 ? (7 - it % 8) * tile_shape[0] : (it % 8) * tile_shape[0], (it / 8) * tile_shape[1]};
+  }
 
 public:
 
@@ -730,6 +1120,7 @@ const LPD_1MGeometry::shapeType LPD_1MGeometry::module_shape {256, 256};
 // (ss/y, fs/x)
 const LPD_1MGeometry::shapeType LPD_1MGeometry::tile_shape {32, 128};
 constexpr int LPD_1MGeometry::n_tiles_per_module;
+constexpr bool LPD_1MGeometry::transposed;
 const LPD_1MGeometry::quadOrientType LPD_1MGeometry::quad_orientations {
   std::array<int, 2>{1, 1},
   std::array<int, 2>{1, 1},
@@ -787,6 +1178,8 @@ LPD_1MGeometry::LPD_1MGeometry()
       corner_pos_(im, it, 1, 2) = 0.0;
     }
   }
+
+  buildAssemblyPlan();
 }
 
 LPD_1MGeometry::LPD_1MGeometry(
@@ -803,76 +1196,11 @@ LPD_1MGeometry::LPD_1MGeometry(
       corner_pos_(im, it, 1, 2) = 0.0;
     }
   }
-}
-
-template<typename M, typename N, typename T>
-void LPD_1MGeometry::positionModuleImp(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const
-{
-  auto center = assembledDim().second;
-  int n_tiles = n_tiles_per_module;
-  int wt = tile_shape[1];
-  int ht = tile_shape[0];
 
-  int edge = 0;
-  if (ignore_tile_edge) edge = 1;
-
-  for (int it = 0; it < n_tiles; ++it)
-  {
-    auto x0 = pos(it, 0, 0);
-    auto y0 = pos(it, 0, 1);
-
-    int ix_dir = (pos(it, 1, 0) - x0 > 0) ? 1 : -1;
-    int iy_dir = (pos(it, 1, 1) - y0 > 0) ? 1 : -1;
-
-    int ix0 = (it / 8) * wt;
-    int iy0 = it < 8 ? (7 - it % 8) * ht : (it % 8) * ht;
-    int ix0_dst = ix_dir > 0 ? static_cast<int>(std::round(x0)) + center[0]
-                             : static_cast<int>(std::round(x0)) + center[0] - 1;
-    int iy0_dst = iy_dir > 0 ? static_cast<int>(std::round(y0)) + center[1]
-                             : static_cast<int>(std::round(y0)) + center[1] - 1;
-    for (int iy = iy0 + edge, iy_dst = iy0_dst + iy_dir * edge; iy < iy0 + ht - edge; ++iy, iy_dst += iy_dir)
-    {
-      for (int ix = ix0 + edge, ix_dst = ix0_dst + ix_dir * edge; ix < ix0 + wt - edge; ++ix, ix_dst += ix_dir)
-      {
-        dst(iy_dst, ix_dst) = src(iy, ix);
-      }
-    }
-  }
+  buildAssemblyPlan();
 }
 
-template<typename M, typename N, typename T>
-void LPD_1MGeometry::dismantleModuleImp(M&& src, N& dst, T&& pos) const
-{
-  auto center = assembledDim().second;
-  int n_tiles = n_tiles_per_module;
-  int wt = tile_shape[1];
-  int ht = tile_shape[0];
 
-  for (int it = 0; it < n_tiles; ++it)
-  {
-    auto x0 = pos(it, 0, 0);
-    auto y0 = pos(it, 0, 1);
-
-    int ix_dir = (pos(it, 1, 0) - x0 > 0) ? 1 : -1;
-    int iy_dir = (pos(it, 1, 1) - y0 > 0) ? 1 : -1;
-
-    int ix0 = ix_dir > 0 ? static_cast<int>(std::round(x0)) + center[0]
-                         : static_cast<int>(std::round(x0)) + center[0] - 1;
-    int iy0 = iy_dir > 0 ? static_cast<int>(std::round(y0)) + center[1]
-                         : static_cast<int>(std::round(y0)) + center[1] - 1;
-
-    int ix0_dst = (it / 8) * wt;
-    int iy0_dst = it < 8 ? (7 - it % 8) * ht : (it % 8) * ht;
-
-    for (int iy = iy0, iy_dst = iy0_dst; iy_dst < iy0_dst + ht; ++iy_dst, iy += iy_dir)
-    {
-      for (int ix = ix0, ix_dst = ix0_dst; ix_dst < ix0_dst + wt; ++ix_dst, ix += ix_dir)
-      {
-        dst(iy_dst, ix_dst) = src(iy, ix);
-      }
-    }
-  }
-}
 
 /**
  * DSSC-1M geometry
@@ -910,11 +1238,13 @@ private:
 
   friend Detector1MGeometryBase<DSSC_1MGeometry>;
 
-  template<typename M, typename N, typename T>
-  void positionModuleImp(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const;
+  static const bool transposed = false;
 
-  template<typename M, typename N, typename T>
-  void dismantleModuleImp(M&& src, N& dst, T&& pos) const;
+  // (y, x) of the first pixel of a tile in the module
+  static std::array<int, 2> tileOrigin(int it)
+  {
+    return {0, it * tile_shape[1]};
+  }
 
 public:
 
@@ -944,6 +1274,7 @@ const DSSC_1MGeometry::shapeType DSSC_1MGeometry::module_shape {128, 512};
 // (ss/y, fs/x)
 const DSSC_1MGeometry::shapeType DSSC_1MGeometry::tile_shape {128, 256};
 constexpr int DSSC_1MGeometry::n_tiles_per_module;
+constexpr bool DSSC_1MGeometry::transposed;
 const DSSC_1MGeometry::quadOrientType DSSC_1MGeometry::quad_orientations {
   std::array<int, 2>{-1, 1},
   std::array<int, 2>{-1, 1},
@@ -990,6 +1321,8 @@ DSSC_1MGeometry::DSSC_1MGeometry()
       corner_pos_(im, it, 1, 2) = 0.0;
     }
   }
+
+  buildAssemblyPlan();
 }
 
 DSSC_1MGeometry::DSSC_1MGeometry(
@@ -1010,74 +1343,577 @@ DSSC_1MGeometry::DSSC_1MGeometry(
       corner_pos_(im, it, 1, 2) = 0.0;
     }
   }
+
+  buildAssemblyPlan();
 }
 
-template<typename M, typename N, typename T>
-void DSSC_1MGeometry::positionModuleImp(M&& src, N& dst, T&& pos, bool ignore_tile_edge) const
+
+
+/**
+ * A tile of a detector module, i.e. a rectangular block of the module data
+ * which is positioned as a whole.
+ *
+ * All the positions and vectors are in units of pixels, where x is along the
+ * columns and y is along the rows of the assembled image. The fast-scan (fs)
+ * and slow-scan (ss) vectors are the steps between adjacent pixels along the
+ * columns and rows of the module data. They are snapped to unit vectors along
+ * x or y, like the "*_fast" methods in EXtra-geom.
+ */
+struct GeometryTile
 {
-  auto center = assembledDim().second;
-  int n_tiles = n_tiles_per_module;
-  int wt = tile_shape[1];
-  int ht = tile_shape[0];
+  int module; // index of the module
+  std::array<int, 2> origin; // (ss, fs) of the first pixel in the module data
+  std::array<int, 2> shape; // (ss, fs)
+  std::array<double, 2> corner; // (x, y) of the corner of the first pixel
+  std::array<double, 2> fs_vec; // (x, y)
+  std::array<double, 2> ss_vec; // (x, y)
+};
+
+/**
+ * Geometry of a detector with any number of modules and tiles.
+ *
+ * It is meant for the detectors which are not 1M detectors, e.g. JungFrau and
+ * ePix100, whose layout is only known from the geometry file. The tiles are
+ * turned into the same assembly plan as the one used by the 1M geometries.
+ */
+class GenericGeometry
+{
+public:
+
+  using shapeType = std::array<int, 2>;
+
+  /**
+   * Stack the modules vertically along the y axis without gaps. Each module
+   * is a single tile.
+   *
+   * @param n_modules: number of modules.
+   * @param module_shape: shape (ss, fs) of the module data.
+   */
+  GenericGeometry(int n_modules, const shapeType& module_shape);
+
+  /**
+   * @param n_modules: number of modules.
+   * @param module_shape: shape (ss, fs) of the module data.
+   * @param tiles: tiles of all the modules.
+   */
+  GenericGeometry(int n_modules, const shapeType& module_shape, const std::vector<GeometryTile>& tiles);
+
+  ~GenericGeometry() = default;
+
+  /**
+   * Position all the modules at the correct area of the given assembled image.
+   *
+   * @param src: data in modules. shape=(modules, y, x)
+   * @param dst: assembled image. shape=(y, x)
+   * @param ignore_tile_edge: true for ignoring the pixels at the edges of tiles. If dst
+   *    is pre-filled with nan, it it equivalent to masking the tile edges.
+   */
+  template<typename M, typename E,
+    EnableIf<std::decay_t<M>, IsImageArray> = false, EnableIf<E, IsImage> = false>
+  void positionAllModules(M&& src, E& dst, bool ignore_tile_edge=false) const;
+
+  /**
+   * Position all the modules at the correct area of the given assembled image.
+   *
+   * @param src: multi-pulse, multiple-module data. shape=(memory cells, modules, y, x)
+   * @param dst: assembled data. shape=(memory cells, y, x)
+   */
+  template<typename M, typename E,
+    EnableIf<std::decay_t<M>, IsModulesArray> = false, EnableIf<E, IsImageArray> = false>
+  void positionAllModules(M&& src, E& dst, bool ignore_tile_edge=false) const;
+
+  /**
+   * Position all the modules at the correct area of the given assembled image.
+   *
+   * @param src: a vector of module data, which has a shape of (modules, y, x)
+   * @param dst: assembled data. shape=(memory cells, y, x)
+   */
+  template<typename M, typename E,
+    EnableIf<std::decay_t<M>, IsModulesVector> = false, EnableIf<E, IsImageArray> = false>
+  void positionAllModules(M&& src, E& dst, bool ignore_tile_edge=false) const;
+
+  /**
+   * Position a single module of all the memory cells at the correct area of
+   * the given assembled image.
+   *
+   * @param im: index of the module.
+   */
+  template<typename M, typename E,
+    EnableIf<std::decay_t<M>, IsModulesArray> = false, EnableIf<E, IsImageArray> = false>
+  void positionModule(M&& src, E& dst, int im, bool ignore_tile_edge=false) const;
+
+  /**
+   * Correct and position all the modules in a single pass.
+   *
+   * The corrected value of a pixel is gain * (src - offset).
+   *
+   * @param gain: gain constants. shape=(modules, y, x)
+   * @param offset: offset constants. shape=(modules, y, x)
+   */
+  template<typename M, typename E, typename C,
+    EnableIf<std::decay_t<M>, IsModulesArray> = false, EnableIf<E, IsImageArray> = false,
+    EnableIf<C, IsImageArray> = false>
+  void positionAllModules(M&& src, E& dst, const C& gain, const C& offset,
+                          bool ignore_tile_edge=false) const;
+
+  /**
+   * Correct, mask and position all the modules in a single pass.
+   *
+   * @param mask: pixel mask in modules. Masked pixels are set to nan. shape=(modules, y, x)
+   */
+  template<typename M, typename E, typename C, typename K,
+    EnableIf<std::decay_t<M>, IsModulesArray> = false, EnableIf<E, IsImageArray> = false,
+    EnableIf<C, IsImageArray> = false, EnableIf<K, IsImageArray> = false>
+  void positionAllModules(M&& src, E& dst, const C& gain, const C& offset, const K& mask,
+                          bool ignore_tile_edge=false) const;
+
+  /**
+   * Dismantle an assembled image into modules.
+   *
+   * @param src: assembled data (y, x)
+   * @param dst: data in modules. shape=(modules, y, x)
+   */
+  template<typename M, typename E,
+    EnableIf<std::decay_t<M>, IsImage> = false, EnableIf<E, IsImageArray> = false>
+  void dismantleAllModules(M&& src, E& dst) const;
+
+  /**
+   * Dismantle all assembled images into modules.
+   *
+   * @param src: assembled data (memory cells, y, x)
+   * @param dst: data in modules. shape=(memory cells, modules, y, x)
+   */
+  template<typename M, typename E,
+    EnableIf<std::decay_t<M>, IsImageArray> = false, EnableIf<E, IsModulesArray> = false>
+  void dismantleAllModules(M&& src, E& dst) const;
 
-  int edge = 0;
-  if (ignore_tile_edge) edge = 1;
+  /**
+   * Compute the positions of the module pixels in the assembled image.
+   *
+   * @param dst: (row, col) of each pixel in the assembled image. The pixels which
+   *    are not positioned are set to -1. shape=(modules, y, x, 2)
+   */
+  template<typename E, EnableIf<E, IsModulesArray> = false>
+  void pixelPositions(E& dst, bool ignore_tile_edge=false) const;
+
+  /**
+   * Return the shape (y, x) of the assembled image.
+   */
+  shapeType assembledShape() const { return assembled_shape_; }
+
+  int nModules() const { return n_modules_; }
+
+  const shapeType& moduleShape() const { return module_shape_; }
+
+  const std::vector<GeometryTile>& tiles() const { return tiles_; }
+
+private:
+
+  int n_modules_;
+  shapeType module_shape_;
+  std::vector<GeometryTile> tiles_;
+  shapeType assembled_shape_;
+
+  // the assembly plan of each module
+  std::vector<std::vector<detail::AssemblyRun>> plan_;
+
+  /**
+   * Check the tiles and build the assembly plan.
+   */
+  void buildAssemblyPlan();
+
+  template<typename SrcShape, typename DstShape>
+  void checkShapeForAssembling(const SrcShape& ss, const DstShape& ds) const;
+
+  template<typename Shape>
+  void checkShapeForConstants(const Shape& cs, const std::string& name) const;
 
-  for (int it = 0; it < n_tiles; ++it)
+  template<typename SrcShape, typename DstShape>
+  void checkShapeForDismantling(const SrcShape& ss, const DstShape& ds) const;
+};
+
+namespace detail
+{
+
+/**
+ * Snap a fast-scan or slow-scan vector (x, y) to a unit vector along x or y.
+ */
+inline std::array<int, 2> snapTileVector(const std::array<double, 2>& vec, const char* name)
+{
+  std::array<int, 2> snapped {static_cast<int>(std::round(vec[0])), static_cast<int>(std::round(vec[1]))};
+  if (std::abs(snapped[0]) + std::abs(snapped[1]) != 1)
+  {
+    std::stringstream fmt;
+    fmt << name << " vector (" << vec[0] << ", " << vec[1] << ") cannot be snapped to a unit vector "
+        << "along the x or y axis!";
+    throw std::invalid_argument(fmt.str());
+  }
+  return snapped;
+}
+
+} // detail
+
+inline GenericGeometry::GenericGeometry(int n_modules, const shapeType& module_shape)
+  : n_modules_(n_modules), module_shape_(module_shape)
+{
+  for (int im = 0; im < n_modules; ++im)
   {
-    auto x0 = pos(it, 0, 0);
-    auto y0 = pos(it, 0, 1);
-
-    int ix_dir = (pos(it, 1, 0) - x0 > 0) ? 1 : -1;
-    int iy_dir = (pos(it, 1, 1) - y0 > 0) ? 1 : -1;
-
-    int ix0 = it * wt;
-    int iy0 = 0;
-    int ix0_dst = ix_dir > 0 ? static_cast<int>(std::round(x0)) + center[0]
-                             : static_cast<int>(std::round(x0)) + center[0] - 1;
-    int iy0_dst = iy_dir > 0 ? static_cast<int>(std::round(y0)) + center[1]
-                             : static_cast<int>(std::round(y0)) + center[1] - 1;
-    for (int iy = iy0 + edge, iy_dst = iy0_dst + iy_dir * edge; iy < ht - edge; ++iy, iy_dst += iy_dir)
+    tiles_.push_back({im, {0, 0}, module_shape,
+                      {0., static_cast<double>(im * module_shape[0])}, {1., 0.}, {0., 1.}});
+  }
+
+  buildAssemblyPlan();
+}
+
+inline GenericGeometry::GenericGeometry(int n_modules, const shapeType& module_shape,
+                                        const std::vector<GeometryTile>& tiles)
+  : n_modules_(n_modules), module_shape_(module_shape), tiles_(tiles)
+{
+  buildAssemblyPlan();
+}
+
+inline void GenericGeometry::buildAssemblyPlan()
+{
+  if (n_modules_ <= 0) throw std::invalid_argument("Number of modules must be positive!");
+  if (module_shape_[0] <= 0 || module_shape_[1] <= 0)
+    throw std::invalid_argument("Module shape must be positive!");
+  if (tiles_.empty()) throw std::invalid_argument("Geometry has no tile!");
+
+  double min_x = std::numeric_limits<double>::max();
+  double min_y = std::numeric_limits<double>::max();
+  double max_x = std::numeric_limits<double>::lowest();
+  double max_y = std::numeric_limits<double>::lowest();
+  for (const auto& tile : tiles_)
+  {
+    if (tile.module < 0 || tile.module >= n_modules_)
     {
-      for (int ix = ix0 + edge, ix_dst = ix0_dst + ix_dir * edge; ix < ix0 + wt - edge; ++ix, ix_dst += ix_dir)
+      std::stringstream fmt;
+      fmt << "Module index " << tile.module << " of a tile is out of range [0, " << n_modules_ << ")!";
+      throw std::invalid_argument(fmt.str());
+    }
+
+    if (tile.shape[0] <= 0 || tile.shape[1] <= 0 || tile.origin[0] < 0 || tile.origin[1] < 0
+        || tile.origin[0] + tile.shape[0] > module_shape_[0] || tile.origin[1] + tile.shape[1] > module_shape_[1])
+    {
+      std::stringstream fmt;
+      fmt << "Tile with origin (" << tile.origin[0] << ", " << tile.origin[1] << ") and shape ("
+          << tile.shape[0] << ", " << tile.shape[1] << ") does not fit in module with shape ("
+          << module_shape_[0] << ", " << module_shape_[1] << ")!";
+      throw std::invalid_argument(fmt.str());
+    }
+
+    auto fs = detail::snapTileVector(tile.fs_vec, "Fast-scan");
+    auto ss = detail::snapTileVector(tile.ss_vec, "Slow-scan");
+    if (fs[0] * ss[0] + fs[1] * ss[1] != 0)
+      throw std::invalid_argument("Fast-scan and slow-scan vectors of a tile must be orthogonal!");
+
+    // diagonal corner of the tile
+    double x1 = tile.corner[0] + fs[0] * tile.shape[1] + ss[0] * tile.shape[0];
+    double y1 = tile.corner[1] + fs[1] * tile.shape[1] + ss[1] * tile.shape[0];
+    min_x = std::min({min_x, tile.corner[0], x1});
+    min_y = std::min({min_y, tile.corner[1], y1});
+    max_x = std::max({max_x, tile.corner[0], x1});
+    max_y = std::max({max_y, tile.corner[1], y1});
+  }
+
+  // same rounding as in Detector1MGeometryBase::assembledDim
+  int min_ix = static_cast<int>(std::round(min_x));
+  int min_iy = static_cast<int>(std::round(min_y));
+  assembled_shape_ = {static_cast<int>(std::round(max_y)) - min_iy, static_cast<int>(std::round(max_x)) - min_ix};
+
+  plan_.assign(n_modules_, std::vector<detail::AssemblyRun>());
+  for (const auto& tile : tiles_)
+  {
+    auto fs = detail::snapTileVector(tile.fs_vec, "Fast-scan");
+    auto ss = detail::snapTileVector(tile.ss_vec, "Slow-scan");
+
+    // each column of the tile is a run if fs is along the y axis
+    bool transposed = (fs[0] == 0);
+    int ix_dir = transposed ? ss[0] : fs[0];
+    int iy_dir = transposed ? fs[1] : ss[1];
+    int n_runs = transposed ? tile.shape[1] : tile.shape[0];
+    int length = transposed ? tile.shape[0] : tile.shape[1];
+
+    detail::appendTileRuns(plan_[tile.module], tile.origin, transposed, n_runs, length,
+                           detail::firstPixelIndex(tile.corner[1], -min_iy, iy_dir),
+                           detail::firstPixelIndex(tile.corner[0], -min_ix, ix_dir),
+                           ix_dir, iy_dir);
+  }
+}
+
+template<typename M, typename E, EnableIf<std::decay_t<M>, IsImageArray>, EnableIf<E, IsImage>>
+void GenericGeometry::positionAllModules(M&& src, E& dst, bool ignore_tile_edge) const
+{
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  checkShapeForAssembling(
+    std::array<int, 4>({1, static_cast<int>(ss[0]), static_cast<int>(ss[1]), static_cast<int>(ss[2])}),
+    std::array<int, 4>({1, static_cast<int>(ds[0]), static_cast<int>(ds[1])}));
+
+  // a train-resolved detector has no memory cell to split over
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelFor(n_modules_, [&src, &dst, &sst, &dst_st, ignore_tile_edge, this]
+    (std::size_t begin, std::size_t end)
+    {
+      for (std::size_t im = begin; im != end; ++im)
       {
-        dst(iy_dst, ix_dst) = src(iy, ix);
+        detail::positionRuns(plan_[im], &src(im, 0, 0), sst, &dst(0, 0), dst_st, ignore_tile_edge);
       }
     }
-  }
+  );
 }
 
-template<typename M, typename N, typename T>
-void DSSC_1MGeometry::dismantleModuleImp(M&& src, N& dst, T&& pos) const
+template<typename M, typename E, EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>>
+void GenericGeometry::positionAllModules(M&& src, E& dst, bool ignore_tile_edge) const
 {
-  auto center = assembledDim().second;
-  int n_tiles = n_tiles_per_module;
-  int wt = tile_shape[1];
-  int ht = tile_shape[0];
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  checkShapeForAssembling(ss, ds);
 
-  for (int it = 0; it < n_tiles; ++it)
-  {
-    auto x0 = pos(it, 0, 0);
-    auto y0 = pos(it, 0, 1);
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelForPulsesModules(ss[0], n_modules_,
+    [&src, &dst, &sst, &dst_st, ignore_tile_edge, this] (std::size_t ip, std::size_t im)
+    {
+      detail::positionRuns(plan_[im], &src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st, ignore_tile_edge);
+    }
+  );
+}
+
+template<typename M, typename E, EnableIf<std::decay_t<M>, IsModulesVector>, EnableIf<E, IsImageArray>>
+void GenericGeometry::positionAllModules(M&& src, E& dst, bool ignore_tile_edge) const
+{
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
+  if (src.empty()) throw std::invalid_argument("Expected at least one module!");
+  auto ms = src[0].shape();
+  auto ss = std::array<int, 4> {static_cast<int>(ms[0]),
+                                static_cast<int>(src.size()),
+                                static_cast<int>(ms[1]),
+                                static_cast<int>(ms[2])};
+  auto ds = dst.shape();
+  checkShapeForAssembling(ss, ds);
 
-    int ix_dir = (pos(it, 1, 0) - x0 > 0) ? 1 : -1;
-    int iy_dir = (pos(it, 1, 1) - y0 > 0) ? 1 : -1;
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelForPulsesModules(ss[0], n_modules_,
+    [&src, &dst, &dst_st, ignore_tile_edge, this] (std::size_t ip, std::size_t im)
+    {
+      detail::positionRuns(plan_[im], &src[im](ip, 0, 0), detail::lastStrides(src[im]),
+                           &dst(ip, 0, 0), dst_st, ignore_tile_edge);
+    }
+  );
+}
 
-    int ix0 = ix_dir > 0 ? static_cast<int>(std::round(x0)) + center[0]
-                         : static_cast<int>(std::round(x0)) + center[0] - 1;
-    int iy0 = iy_dir > 0 ? static_cast<int>(std::round(y0)) + center[1]
-                         : static_cast<int>(std::round(y0)) + center[1] - 1;
+template<typename M, typename E, EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>>
+void GenericGeometry::positionModule(M&& src, E& dst, int im, bool ignore_tile_edge) const
+{
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  checkShapeForAssembling(ss, ds);
 
-    int ix0_dst = it * wt;
-    int iy0_dst = 0;
+  if (im < 0 || im >= n_modules_)
+  {
+    std::stringstream fmt;
+    fmt << "Module index " << im << " is out of range [0, " << n_modules_ << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
 
-    for (int iy = iy0, iy_dst = iy0_dst; iy_dst < ht; ++iy_dst, iy += iy_dir)
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelFor(ss[0], [&src, &dst, &sst, &dst_st, im, ignore_tile_edge, this]
+    (std::size_t begin, std::size_t end)
     {
-      for (int ix = ix0, ix_dst = ix0_dst; ix_dst < ix0_dst + wt; ++ix_dst, ix += ix_dir)
+      for (std::size_t ip = begin; ip != end; ++ip)
       {
-        dst(iy_dst, ix_dst) = src(iy, ix);
+        detail::positionRuns(plan_[im], &src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st, ignore_tile_edge);
       }
     }
+  );
+}
+
+template<typename M, typename E, typename C,
+  EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>, EnableIf<C, IsImageArray>>
+void GenericGeometry::positionAllModules(M&& src, E& dst, const C& gain, const C& offset,
+                                         bool ignore_tile_edge) const
+{
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  checkShapeForAssembling(ss, ds);
+  checkShapeForConstants(gain.shape(), "gain");
+  checkShapeForConstants(offset.shape(), "offset");
+
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  std::array<decltype(sst), 3> cst { detail::lastStrides(gain), detail::lastStrides(offset), decltype(sst)() };
+  detail::parallelForPulsesModules(ss[0], n_modules_,
+    [&src, &dst, &gain, &offset, &sst, &dst_st, &cst, ignore_tile_edge, this] (std::size_t ip, std::size_t im)
+    {
+      detail::correctRuns(plan_[im], &src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st,
+                          &gain(im, 0, 0), &offset(im, 0, 0), nullptr, cst, ignore_tile_edge);
+    }
+  );
+}
+
+template<typename M, typename E, typename C, typename K,
+  EnableIf<std::decay_t<M>, IsModulesArray>, EnableIf<E, IsImageArray>,
+  EnableIf<C, IsImageArray>, EnableIf<K, IsImageArray>>
+void GenericGeometry::positionAllModules(M&& src, E& dst, const C& gain, const C& offset,
+                                         const K& mask, bool ignore_tile_edge) const
+{
+  FOAM_PROFILE_SCOPE("positionAllModules", profiler::nBytes(dst));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  checkShapeForAssembling(ss, ds);
+  checkShapeForConstants(gain.shape(), "gain");
+  checkShapeForConstants(offset.shape(), "offset");
+  checkShapeForConstants(mask.shape(), "mask");
+
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  std::array<decltype(sst), 3> cst {
+    detail::lastStrides(gain), detail::lastStrides(offset), detail::lastStrides(mask) };
+  detail::parallelForPulsesModules(ss[0], n_modules_,
+    [&src, &dst, &gain, &offset, &mask, &sst, &dst_st, &cst, ignore_tile_edge, this]
+    (std::size_t ip, std::size_t im)
+    {
+      detail::correctRuns(plan_[im], &src(ip, im, 0, 0), sst, &dst(ip, 0, 0), dst_st,
+                          &gain(im, 0, 0), &offset(im, 0, 0), &mask(im, 0, 0), cst, ignore_tile_edge);
+    }
+  );
+}
+
+template<typename M, typename E, EnableIf<std::decay_t<M>, IsImage>, EnableIf<E, IsImageArray>>
+void GenericGeometry::dismantleAllModules(M&& src, E& dst) const
+{
+  FOAM_PROFILE_SCOPE("dismantleAllModules", profiler::nBytes(src));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  checkShapeForDismantling(
+    std::array<int, 4>({1, static_cast<int>(ss[0]), static_cast<int>(ss[1])}),
+    std::array<int, 4>({1, static_cast<int>(ds[0]), static_cast<int>(ds[1]), static_cast<int>(ds[2])}));
+
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  for (int im = 0; im < n_modules_; ++im)
+  {
+    detail::dismantleRuns(plan_[im], &src(0, 0), sst, &dst(im, 0, 0), dst_st);
+  }
+}
+
+template<typename M, typename E, EnableIf<std::decay_t<M>, IsImageArray>, EnableIf<E, IsModulesArray>>
+void GenericGeometry::dismantleAllModules(M&& src, E& dst) const
+{
+  FOAM_PROFILE_SCOPE("dismantleAllModules", profiler::nBytes(src));
+  auto ss = src.shape();
+  auto ds = dst.shape();
+  checkShapeForDismantling(ss, ds);
+
+  auto sst = detail::lastStrides(src);
+  auto dst_st = detail::lastStrides(dst);
+  detail::parallelForPulsesModules(ss[0], n_modules_,
+    [&src, &dst, &sst, &dst_st, this] (std::size_t ip, std::size_t im)
+    {
+      detail::dismantleRuns(plan_[im], &src(ip, 0, 0), sst, &dst(ip, im, 0, 0), dst_st);
+    }
+  );
+}
+
+template<typename E, EnableIf<E, IsModulesArray>>
+void GenericGeometry::pixelPositions(E& dst, bool ignore_tile_edge) const
+{
+  auto ds = dst.shape();
+  if (static_cast<int>(ds[0]) != n_modules_ || static_cast<int>(ds[1]) != module_shape_[0]
+      || static_cast<int>(ds[2]) != module_shape_[1] || ds[3] != 2)
+  {
+    std::stringstream fmt;
+    fmt << "Expected output array with shape (" << n_modules_ << ", " << module_shape_[0]
+        << ", " << module_shape_[1] << ", 2), get ("
+        << ds[0] << ", " << ds[1] << ", " << ds[2] << ", " << ds[3] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  using value_type = typename E::value_type;
+  std::fill(dst.begin(), dst.end(), value_type(-1));
+  for (int im = 0; im < n_modules_; ++im) detail::runPixelPositions(plan_[im], dst, im, ignore_tile_edge);
+}
+
+template<typename SrcShape, typename DstShape>
+void GenericGeometry::checkShapeForAssembling(const SrcShape& ss, const DstShape& ds) const
+{
+  if (ss[0] != ds[0])
+  {
+    std::stringstream fmt;
+    fmt << "Modules data and output array have different memory cells: "
+        << ss[0] << " and " << ds[0] << "!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  if (static_cast<int>(ss[1]) != n_modules_)
+  {
+    std::stringstream fmt;
+    fmt << "Expected " << n_modules_ << " modules, get " << ss[1] << "!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  if (static_cast<int>(ss[2]) != module_shape_[0] || static_cast<int>(ss[3]) != module_shape_[1])
+  {
+    std::stringstream fmt;
+    fmt << "Expected modules with shape (" << module_shape_[0] << ", " << module_shape_[1]
+        << ") modules, get (" << ss[2] << ", " << ss[3] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  if (static_cast<int>(ds[1]) != assembled_shape_[0] || static_cast<int>(ds[2]) != assembled_shape_[1])
+  {
+    std::stringstream fmt;
+    fmt << "Expected output array with shape (" << assembled_shape_[0] << ", " << assembled_shape_[1]
+        << "), get (" << ds[1] << ", " << ds[2] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+}
+
+template<typename Shape>
+void GenericGeometry::checkShapeForConstants(const Shape& cs, const std::string& name) const
+{
+  if (static_cast<int>(cs[0]) != n_modules_ || static_cast<int>(cs[1]) != module_shape_[0]
+      || static_cast<int>(cs[2]) != module_shape_[1])
+  {
+    std::stringstream fmt;
+    fmt << "Expected " << name << " with shape (" << n_modules_ << ", " << module_shape_[0]
+        << ", " << module_shape_[1] << "), get (" << cs[0] << ", " << cs[1] << ", " << cs[2] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+}
+
+template<typename SrcShape, typename DstShape>
+void GenericGeometry::checkShapeForDismantling(const SrcShape& ss, const DstShape& ds) const
+{
+  if (ss[0] != ds[0])
+  {
+    std::stringstream fmt;
+    fmt << "Input and output array have different memory cells: " << ss[0] << " and " << ds[0] << "!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  if (static_cast<int>(ss[1]) != assembled_shape_[0] || static_cast<int>(ss[2]) != assembled_shape_[1])
+  {
+    std::stringstream fmt;
+    fmt << "Expected source image with shape (" << assembled_shape_[0] << ", " << assembled_shape_[1]
+        << "), get (" << ss[1] << ", " << ss[2] << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+
+  if (static_cast<int>(ds[1]) != n_modules_ || static_cast<int>(ds[2]) != module_shape_[0]
+      || static_cast<int>(ds[3]) != module_shape_[1])
+  {
+    std::stringstream fmt;
+    fmt << "Expected output array with shape ("
+        << n_modules_ << ", " << module_shape_[0] << ", " << module_shape_[1] << "), get ("
+        << ds[1] << ", " << ds[2] << ", " << ds[3] << ")!";
+    throw std::invalid_argument(fmt.str());
   }
 }
 
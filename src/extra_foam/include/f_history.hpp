@@ -0,0 +1,431 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_HISTORY_H
+#define EXTRA_FOAM_HISTORY_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+
+namespace foam
+{
+
+/**
+ * Running mean and variance of a stream of samples.
+ *
+ * The states of two disjoint sets of samples are merged by the parallel
+ * algorithm of Chan et al., e.g. when two bins are re-bucketed into one.
+ */
+struct RunningStats
+{
+  uint64_t count = 0;
+  double mean = 0.;
+  double m2 = 0.; // sum of the squared deviations from the mean
+
+  void push(double v)
+  {
+    ++count;
+    double delta = v - mean;
+    mean += delta / count;
+    m2 += delta * (v - mean);
+  }
+
+  void merge(const RunningStats& other)
+  {
+    if (other.count == 0) return;
+    if (count == 0)
+    {
+      *this = other;
+      return;
+    }
+    uint64_t n = count + other.count;
+    double delta = other.mean - mean;
+    mean += delta * other.count / n;
+    m2 += other.m2 + delta * delta * count * other.count / n;
+    count = n;
+  }
+
+  double std() const
+  {
+    return count > 0 ? std::sqrt(m2 / count) : std::numeric_limits<double>::quiet_NaN();
+  }
+};
+
+namespace detail
+{
+
+/**
+ * Column of a ring buffer whose i-th element is stored at both i and
+ * i + capacity, so that any window of the ring is contiguous in memory.
+ */
+template<typename T>
+class MirroredColumn
+{
+public:
+
+  explicit MirroredColumn(std::size_t capacity) : capacity_(capacity), data_(2 * capacity) {}
+
+  void set(std::size_t i, T v)
+  {
+    data_[i] = v;
+    data_[i + capacity_] = v;
+  }
+
+  // i is within [0, 2 * capacity)
+  T operator[](std::size_t i) const { return data_[i]; }
+
+  const T* data() const { return data_.data(); }
+
+private:
+  std::size_t capacity_;
+  std::vector<T> data_;
+};
+
+} // detail
+
+/**
+ * Fixed-capacity columnar history of (train ID, x, y_0, ..., y_{N-1}).
+ *
+ * The samples are stored in a ring buffer as a structure of arrays and the
+ * oldest sample is dropped once the buffer is full. With a positive
+ * resolution, the samples are also accumulated into x-bins in a
+ * stop-and-collect way: a sample joins the latest bin if its x is within
+ * the resolution of the mean x of the bin, otherwise it starts a new bin.
+ * A bin which has collected less than min_count samples is replaced by the
+ * next one. Each bin keeps the running statistics of every y column, which
+ * ignore NaN, so that appending a sample costs O(columns).
+ *
+ * The columns are exposed as contiguous arrays in chronological order. The
+ * pointers stay valid during the lifetime of the buffer, but the pointed
+ * data change with the next append, clear or setResolution.
+ */
+class HistoryBuffer
+{
+public:
+
+  /**
+   * Constructor.
+   *
+   * @param capacity: max number of samples, which is also the max number
+   *                  of bins.
+   * @param n_columns: number of y columns.
+   * @param resolution: resolution of the x-bins. 0 for no binning.
+   * @param min_count: min number of samples of a bin.
+   */
+  HistoryBuffer(std::size_t capacity, std::size_t n_columns, double resolution = 0., std::size_t min_count = 2)
+    : capacity_(capacity), n_columns_(n_columns), min_count_(min_count),
+      tid_(capacity), x_(capacity), bin_x_(capacity), bin_count_(capacity)
+  {
+    if (capacity == 0) throw std::invalid_argument("Capacity must be positive!");
+    if (n_columns == 0) throw std::invalid_argument("Number of columns must be positive!");
+    checkResolution(resolution);
+    resolution_ = resolution;
+
+    for (std::size_t j = 0; j < n_columns; ++j)
+    {
+      y_.emplace_back(capacity);
+      bin_y_count_.emplace_back(capacity);
+      bin_mean_.emplace_back(capacity);
+      bin_m2_.emplace_back(capacity);
+      bin_std_.emplace_back(capacity);
+    }
+  }
+
+  /**
+   * Append a sample.
+   *
+   * @param y: pointer to the n_columns values of the sample. NaN stands for
+   *           a missing value.
+   */
+  void append(uint64_t tid, double x, const double* y)
+  {
+    std::size_t i = (start_ + size_) % capacity_;
+    tid_.set(i, tid);
+    x_.set(i, x);
+    for (std::size_t j = 0; j < n_columns_; ++j) y_[j].set(i, y[j]);
+
+    if (size_ < capacity_) ++size_;
+    else start_ = (start_ + 1) % capacity_;
+
+    if (resolution_ > 0.) binSample(x, y);
+  }
+
+  void append(uint64_t tid, double x, const std::vector<double>& y)
+  {
+    if (y.size() != n_columns_)
+    {
+      std::stringstream ss;
+      ss << "Expected " << n_columns_ << " y values, got " << y.size();
+      throw std::invalid_argument(ss.str());
+    }
+    append(tid, x, y.data());
+  }
+
+  /**
+   * Remove all the samples and bins.
+   */
+  void clear()
+  {
+    start_ = 0;
+    size_ = 0;
+    clearBins();
+  }
+
+  /**
+   * Change the resolution of the x-bins.
+   *
+   * A coarser resolution merges the neighbouring bins whose mean x are
+   * within the new resolution in O(bins). Since a bin cannot be split, a
+   * finer resolution re-bins the samples in the history instead, i.e. the
+   * bins of samples which have been dropped from the history are lost.
+   * 0 removes all the bins.
+   */
+  void setResolution(double resolution)
+  {
+    checkResolution(resolution);
+    if (resolution == resolution_) return;
+
+    bool coarser = resolution_ > 0. && resolution > resolution_;
+    resolution_ = resolution;
+    if (coarser)
+    {
+      mergeBins();
+      return;
+    }
+
+    clearBins();
+    if (resolution_ > 0.)
+    {
+      std::vector<double> y(n_columns_);
+      for (std::size_t k = start_; k < start_ + size_; ++k)
+      {
+        for (std::size_t j = 0; j < n_columns_; ++j) y[j] = y_[j][k];
+        binSample(x_[k], y.data());
+      }
+    }
+  }
+
+  std::size_t capacity() const { return capacity_; }
+
+  std::size_t nColumns() const { return n_columns_; }
+
+  double resolution() const { return resolution_; }
+
+  std::size_t minCount() const { return min_count_; }
+
+  /**
+   * Number of samples.
+   */
+  std::size_t size() const { return size_; }
+
+  const uint64_t* tids() const { return tid_.data() + start_; }
+
+  const double* x() const { return x_.data() + start_; }
+
+  const double* y(std::size_t j) const { return y_[checkedColumn(j)].data() + start_; }
+
+  /**
+   * Number of bins, excluding the latest one if it has less than min_count
+   * samples.
+   */
+  std::size_t nBins() const
+  {
+    if (n_bins_ > 0 && bin_count_[bin_start_ + n_bins_ - 1] < min_count_) return n_bins_ - 1;
+    return n_bins_;
+  }
+
+  // mean x of the bins
+  const double* binX() const { return bin_x_.data() + bin_start_; }
+
+  // number of samples of the bins
+  const uint64_t* binCount() const { return bin_count_.data() + bin_start_; }
+
+  // number of non-NaN values of the j-th column in the bins
+  const uint64_t* binCount(std::size_t j) const { return bin_y_count_[checkedColumn(j)].data() + bin_start_; }
+
+  const double* binMean(std::size_t j) const { return bin_mean_[checkedColumn(j)].data() + bin_start_; }
+
+  // population standard deviation, NaN if the bin has no value
+  const double* binStd(std::size_t j) const { return bin_std_[checkedColumn(j)].data() + bin_start_; }
+
+private:
+
+  static constexpr double kEpsilon = 1e-9;
+
+  static void checkResolution(double resolution)
+  {
+    if (!(resolution >= 0.) || std::isinf(resolution))
+    {
+      std::stringstream ss;
+      ss << "Resolution must be non-negative and finite, got " << resolution;
+      throw std::invalid_argument(ss.str());
+    }
+  }
+
+  std::size_t checkedColumn(std::size_t j) const
+  {
+    if (j >= n_columns_)
+    {
+      std::stringstream ss;
+      ss << "Column " << j << " is out of range [0, " << n_columns_ << ")";
+      throw std::out_of_range(ss.str());
+    }
+    return j;
+  }
+
+  void clearBins()
+  {
+    bin_start_ = 0;
+    n_bins_ = 0;
+  }
+
+  bool sameBin(double x, double bin_x) const
+  {
+    return std::abs(x - bin_x) - resolution_ < kEpsilon;
+  }
+
+  RunningStats binStats(std::size_t i, std::size_t j) const
+  {
+    RunningStats s;
+    s.count = bin_y_count_[j][i];
+    s.mean = bin_mean_[j][i];
+    s.m2 = bin_m2_[j][i];
+    return s;
+  }
+
+  void setBinStats(std::size_t i, std::size_t j, const RunningStats& s)
+  {
+    bin_y_count_[j].set(i, s.count);
+    bin_mean_[j].set(i, s.mean);
+    bin_m2_[j].set(i, s.m2);
+    bin_std_[j].set(i, s.std());
+  }
+
+  // start the bin at i with a single sample
+  void resetBin(std::size_t i, double x, const double* y)
+  {
+    bin_x_.set(i, x);
+    bin_count_.set(i, 1);
+    for (std::size_t j = 0; j < n_columns_; ++j)
+    {
+      RunningStats s;
+      if (!std::isnan(y[j])) s.push(y[j]);
+      setBinStats(i, j, s);
+    }
+  }
+
+  void binSample(double x, const double* y)
+  {
+    if (n_bins_ > 0)
+    {
+      std::size_t last = (bin_start_ + n_bins_ - 1) % capacity_;
+      if (sameBin(x, bin_x_[last]))
+      {
+        uint64_t count = bin_count_[last] + 1;
+        bin_count_.set(last, count);
+        bin_x_.set(last, bin_x_[last] + (x - bin_x_[last]) / count);
+        for (std::size_t j = 0; j < n_columns_; ++j)
+        {
+          if (std::isnan(y[j])) continue;
+          RunningStats s = binStats(last, j);
+          s.push(y[j]);
+          setBinStats(last, j, s);
+        }
+        return;
+      }
+
+      if (bin_count_[last] < min_count_)
+      {
+        // discard the samples collected at the previous location
+        resetBin(last, x, y);
+        return;
+      }
+    }
+
+    std::size_t i = (bin_start_ + n_bins_) % capacity_;
+    if (n_bins_ < capacity_) ++n_bins_;
+    else bin_start_ = (bin_start_ + 1) % capacity_;
+    resetBin(i, x, y);
+  }
+
+  // Merge the neighbouring bins in place. The k-th bin is read from
+  // bin_start_ + k and the merged bins are written to the first m <= k
+  // positions of the ring, whose mirrors are outside the window being read.
+  // The latest bin is kept open if it has less than min_count samples.
+  void mergeBins()
+  {
+    std::size_t m = 0;
+    for (std::size_t k = 0; k < n_bins_; ++k)
+    {
+      std::size_t src = bin_start_ + k;
+      double x = bin_x_[src];
+      uint64_t count = bin_count_[src];
+      bool open = k == n_bins_ - 1 && count < min_count_;
+
+      if (m > 0 && !open)
+      {
+        std::size_t i = (bin_start_ + m - 1) % capacity_;
+        if (sameBin(x, bin_x_[i]))
+        {
+          uint64_t n = bin_count_[i] + count;
+          bin_x_.set(i, bin_x_[i] + (x - bin_x_[i]) * count / n);
+          bin_count_.set(i, n);
+          for (std::size_t j = 0; j < n_columns_; ++j)
+          {
+            RunningStats s = binStats(i, j);
+            s.merge(binStats(src, j));
+            setBinStats(i, j, s);
+          }
+          continue;
+        }
+      }
+
+      if (m != k)
+      {
+        std::size_t i = (bin_start_ + m) % capacity_;
+        bin_x_.set(i, x);
+        bin_count_.set(i, count);
+        for (std::size_t j = 0; j < n_columns_; ++j) setBinStats(i, j, binStats(src, j));
+      }
+      ++m;
+    }
+    n_bins_ = m;
+  }
+
+  std::size_t capacity_;
+  std::size_t n_columns_;
+  double resolution_;
+  std::size_t min_count_;
+
+  // ring of the samples
+  std::size_t start_ = 0;
+  std::size_t size_ = 0;
+  detail::MirroredColumn<uint64_t> tid_;
+  detail::MirroredColumn<double> x_;
+  std::vector<detail::MirroredColumn<double>> y_;
+
+  // ring of the bins
+  std::size_t bin_start_ = 0;
+  std::size_t n_bins_ = 0;
+  detail::MirroredColumn<double> bin_x_;
+  detail::MirroredColumn<uint64_t> bin_count_;
+  std::vector<detail::MirroredColumn<uint64_t>> bin_y_count_;
+  std::vector<detail::MirroredColumn<double>> bin_mean_;
+  std::vector<detail::MirroredColumn<double>> bin_m2_;
+  std::vector<detail::MirroredColumn<double>> bin_std_;
+};
+
+} // foam
+
+#endif //EXTRA_FOAM_HISTORY_H
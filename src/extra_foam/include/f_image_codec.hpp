@@ -0,0 +1,579 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_IMAGE_CODEC_H
+#define EXTRA_FOAM_IMAGE_CODEC_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "f_traits.hpp"
+#include "f_parallel.hpp"
+#include "f_buffer_pool.hpp"
+
+
+namespace foam
+{
+
+/**
+ * Pixel encoding of an image stream.
+ *
+ * UINT16 and UINT8 quantize each image linearly between its finite minimum
+ * and maximum. The largest code is reserved for non-finite pixels, which are
+ * decoded as NaN.
+ */
+enum class ImageCodec : uint8_t
+{
+  FLOAT32 = 0,
+  FLOAT16,
+  UINT16,
+  UINT8,
+};
+
+inline std::size_t codecItemSize(ImageCodec codec)
+{
+  switch (codec)
+  {
+    case ImageCodec::FLOAT32: return 4;
+    case ImageCodec::FLOAT16: return 2;
+    case ImageCodec::UINT16: return 2;
+    case ImageCodec::UINT8: return 1;
+  }
+  throw std::invalid_argument("Unknown image codec!");
+}
+
+namespace detail
+{
+
+/**
+ * IEEE 754 binary32 to binary16 with round-to-nearest-even.
+ *
+ * Values beyond the range of binary16 become infinity.
+ */
+inline uint16_t floatToHalf(float v)
+{
+  uint32_t x;
+  std::memcpy(&x, &v, sizeof x);
+  uint32_t sign = x & 0x80000000u;
+  x ^= sign;
+
+  uint16_t h;
+  if (x >= 0x47800000u)
+  {
+    // infinity or NaN
+    h = x > 0x7f800000u ? 0x7e00 : 0x7c00;
+  } else if (x < 0x38800000u)
+  {
+    // subnormal or zero: align the mantissa with a magic number so that
+    // the rounding is done by the floating point addition
+    const uint32_t magic_bits = ((127 - 15) + (23 - 10) + 1) << 23;
+    float magic, f;
+    std::memcpy(&magic, &magic_bits, sizeof magic);
+    std::memcpy(&f, &x, sizeof f);
+    f += magic;
+    uint32_t r;
+    std::memcpy(&r, &f, sizeof r);
+    h = static_cast<uint16_t>(r - magic_bits);
+  } else
+  {
+    uint32_t odd = (x >> 13) & 1u;
+    x += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu + odd;
+    h = static_cast<uint16_t>(x >> 13);
+  }
+  return static_cast<uint16_t>(h | (sign >> 16));
+}
+
+inline float halfToFloat(uint16_t h)
+{
+  const uint32_t shifted_exp = 0x7c00u << 13;
+  const uint32_t magic_bits = 113u << 23;
+
+  uint32_t x = (h & 0x7fffu) << 13;
+  uint32_t exp = x & shifted_exp;
+  x += (127 - 15) << 23;
+  if (exp == shifted_exp)
+  {
+    // infinity or NaN
+    x += (128 - 16) << 23;
+  } else if (exp == 0)
+  {
+    // subnormal or zero
+    x += 1u << 23;
+    float magic, f;
+    std::memcpy(&magic, &magic_bits, sizeof magic);
+    std::memcpy(&f, &x, sizeof f);
+    f -= magic;
+    std::memcpy(&x, &f, sizeof x);
+  }
+  x |= static_cast<uint32_t>(h & 0x8000u) << 16;
+
+  float v;
+  std::memcpy(&v, &x, sizeof v);
+  return v;
+}
+
+/**
+ * Header of an encoded image.
+ *
+ * A value is decoded as lo + code * step for the quantized codecs.
+ */
+struct EncodedFrame
+{
+  double lo;
+  double step;
+  uint32_t n_bytes; // size of the payload
+  uint32_t flags;
+};
+
+static_assert(sizeof(EncodedFrame) == 24, "Unexpected padding in EncodedFrame!");
+
+constexpr uint32_t kFrameCompressed = 1u;
+
+// size of the hash table of the compressor in log2
+constexpr int kLzHashLog = 14;
+constexpr std::size_t kLzMinMatch = 4;
+constexpr std::size_t kLzMaxOffset = 65535;
+
+inline uint32_t read32(const uint8_t* p)
+{
+  uint32_t v;
+  std::memcpy(&v, p, sizeof v);
+  return v;
+}
+
+inline void writeLength(std::vector<uint8_t>& out, std::size_t n)
+{
+  for (; n >= 255; n -= 255) out.push_back(255);
+  out.push_back(static_cast<uint8_t>(n));
+}
+
+/**
+ * Append a sequence of literals followed by an optional match.
+ *
+ * A sequence starts with a token whose high and low nibbles are the number
+ * of literals and the match length minus kLzMinMatch, respectively. Lengths
+ * of 15 and above continue in the following bytes.
+ */
+inline void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, std::size_t n_literals,
+                          std::size_t offset, std::size_t match_len)
+{
+  std::size_t ml = match_len == 0 ? 0 : match_len - kLzMinMatch;
+  out.push_back(static_cast<uint8_t>((std::min<std::size_t>(n_literals, 15) << 4) |
+                                     std::min<std::size_t>(ml, 15)));
+  if (n_literals >= 15) writeLength(out, n_literals - 15);
+  out.insert(out.end(), literals, literals + n_literals);
+
+  if (match_len == 0) return;
+  out.push_back(static_cast<uint8_t>(offset & 0xff));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (ml >= 15) writeLength(out, ml - 15);
+}
+
+/**
+ * Compress bytes with a greedy LZ77 in the spirit of LZ4.
+ *
+ * The last sequence only has literals.
+ */
+inline void lzCompress(const uint8_t* src, std::size_t n, std::vector<uint8_t>& out)
+{
+  out.clear();
+  out.reserve(n / 2 + 16);
+
+  // positions + 1 of the last occurrences of 4-byte sequences, 0 for none
+  PooledBuffer<uint32_t> table(std::size_t(1) << kLzHashLog, 0);
+
+  std::size_t anchor = 0;
+  std::size_t ip = 0;
+  while (ip + kLzMinMatch <= n)
+  {
+    uint32_t seq = read32(src + ip);
+    uint32_t h = (seq * 2654435761u) >> (32 - kLzHashLog);
+    std::size_t candidate = table[h];
+    table[h] = static_cast<uint32_t>(ip + 1);
+
+    if (candidate != 0 && ip - (candidate - 1) <= kLzMaxOffset && read32(src + candidate - 1) == seq)
+    {
+      std::size_t ref = candidate - 1;
+      std::size_t len = kLzMinMatch;
+      while (ip + len < n && src[ref + len] == src[ip + len]) ++len;
+
+      writeSequence(out, src + anchor, ip - anchor, ip - ref, len);
+      ip += len;
+      anchor = ip;
+    } else
+    {
+      // skip faster over incompressible data
+      ip += 1 + ((ip - anchor) >> 6);
+    }
+  }
+  writeSequence(out, src + anchor, n - anchor, 0, 0);
+}
+
+inline std::size_t readLength(const uint8_t*& ip, const uint8_t* end)
+{
+  std::size_t n = 0;
+  uint8_t b;
+  do
+  {
+    if (ip == end) throw std::invalid_argument("Corrupted image stream!");
+    b = *ip++;
+    n += b;
+  } while (b == 255);
+  return n;
+}
+
+/**
+ * Decompress exactly n bytes into dst.
+ */
+inline void lzDecompress(const uint8_t* src, std::size_t n_src, uint8_t* dst, std::size_t n)
+{
+  const uint8_t* ip = src;
+  const uint8_t* end = src + n_src;
+  std::size_t op = 0;
+
+  while (true)
+  {
+    if (ip == end) throw std::invalid_argument("Corrupted image stream!");
+    uint8_t token = *ip++;
+
+    std::size_t n_literals = token >> 4;
+    if (n_literals == 15) n_literals += readLength(ip, end);
+    if (n_literals > static_cast<std::size_t>(end - ip) || n_literals > n - op)
+      throw std::invalid_argument("Corrupted image stream!");
+    std::memcpy(dst + op, ip, n_literals);
+    ip += n_literals;
+    op += n_literals;
+
+    if (ip == end) break;
+
+    if (end - ip < 2) throw std::invalid_argument("Corrupted image stream!");
+    std::size_t offset = ip[0] | (static_cast<std::size_t>(ip[1]) << 8);
+    ip += 2;
+    std::size_t len = (token & 0x0f);
+    if (len == 15) len += readLength(ip, end);
+    len += kLzMinMatch;
+    if (offset == 0 || offset > op || len > n - op)
+      throw std::invalid_argument("Corrupted image stream!");
+
+    // the match may overlap the output
+    const uint8_t* ref = dst + op - offset;
+    for (std::size_t k = 0; k < len; ++k) dst[op + k] = ref[k];
+    op += len;
+  }
+
+  if (op != n) throw std::invalid_argument("Corrupted image stream!");
+}
+
+/**
+ * Group the k-th bytes of all the items together, which turns the slowly
+ * varying high bytes of neighbouring pixels into long runs.
+ */
+inline void shuffleBytes(const uint8_t* src, uint8_t* dst, std::size_t n_items, std::size_t item_size)
+{
+  for (std::size_t i = 0; i < n_items; ++i)
+  {
+    for (std::size_t b = 0; b < item_size; ++b) dst[b * n_items + i] = src[i * item_size + b];
+  }
+}
+
+inline void unshuffleBytes(const uint8_t* src, uint8_t* dst, std::size_t n_items, std::size_t item_size)
+{
+  for (std::size_t b = 0; b < item_size; ++b)
+  {
+    for (std::size_t i = 0; i < n_items; ++i) dst[i * item_size + b] = src[b * n_items + i];
+  }
+}
+
+/**
+ * Quantize an image into codes of type C.
+ */
+template<typename C, typename E>
+inline void quantizeImage(const E& src, std::size_t i, EncodedFrame& frame, C* codes)
+{
+  auto shape = src.shape();
+  std::size_t ny = shape[1], nx = shape[2];
+  const C sentinel = std::numeric_limits<C>::max();
+
+  double lo = std::numeric_limits<double>::infinity();
+  double hi = -lo;
+  for (std::size_t j = 0; j < ny; ++j)
+  {
+    for (std::size_t k = 0; k < nx; ++k)
+    {
+      double v = src(i, j, k);
+      if (std::isfinite(v))
+      {
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+      }
+    }
+  }
+
+  if (lo > hi)
+  {
+    // no finite pixel
+    frame.lo = std::numeric_limits<double>::quiet_NaN();
+    frame.step = 0.;
+    std::fill(codes, codes + ny * nx, sentinel);
+    return;
+  }
+
+  frame.lo = lo;
+  frame.step = (hi - lo) / (sentinel - 1);
+  double inv_step = frame.step > 0. ? 1. / frame.step : 0.;
+  for (std::size_t j = 0; j < ny; ++j)
+  {
+    C* row = codes + j * nx;
+    for (std::size_t k = 0; k < nx; ++k)
+    {
+      double v = src(i, j, k);
+      row[k] = std::isfinite(v) ? static_cast<C>((v - lo) * inv_step + 0.5) : sentinel;
+    }
+  }
+}
+
+template<typename C, typename O>
+inline void dequantizeImage(const C* codes, const EncodedFrame& frame, std::size_t i, O& out)
+{
+  using value_type = typename O::value_type;
+
+  auto shape = out.shape();
+  std::size_t ny = shape[1], nx = shape[2];
+  const C sentinel = std::numeric_limits<C>::max();
+  const auto nan = std::numeric_limits<value_type>::quiet_NaN();
+
+  for (std::size_t j = 0; j < ny; ++j)
+  {
+    const C* row = codes + j * nx;
+    for (std::size_t k = 0; k < nx; ++k)
+    {
+      out(i, j, k) = row[k] == sentinel ? nan : static_cast<value_type>(frame.lo + row[k] * frame.step);
+    }
+  }
+}
+
+template<typename E>
+inline void encodeImage(const E& src, std::size_t i, ImageCodec codec,
+                        EncodedFrame& frame, std::vector<uint8_t>& payload)
+{
+  auto shape = src.shape();
+  std::size_t n_pixels = shape[1] * shape[2];
+  std::size_t item_size = codecItemSize(codec);
+  std::size_t n_bytes = n_pixels * item_size;
+
+  PooledBuffer<uint8_t> raw(n_bytes);
+  frame.lo = 0.;
+  frame.step = 1.;
+  switch (codec)
+  {
+    case ImageCodec::FLOAT32:
+    {
+      auto p = reinterpret_cast<float*>(raw.data());
+      for (std::size_t j = 0; j < shape[1]; ++j)
+      {
+        for (std::size_t k = 0; k < shape[2]; ++k) *p++ = static_cast<float>(src(i, j, k));
+      }
+      break;
+    }
+    case ImageCodec::FLOAT16:
+    {
+      auto p = reinterpret_cast<uint16_t*>(raw.data());
+      for (std::size_t j = 0; j < shape[1]; ++j)
+      {
+        for (std::size_t k = 0; k < shape[2]; ++k) *p++ = floatToHalf(static_cast<float>(src(i, j, k)));
+      }
+      break;
+    }
+    case ImageCodec::UINT16:
+      quantizeImage(src, i, frame, reinterpret_cast<uint16_t*>(raw.data()));
+      break;
+    case ImageCodec::UINT8:
+      quantizeImage(src, i, frame, raw.data());
+      break;
+  }
+
+  const uint8_t* bytes = raw.data();
+  PooledBuffer<uint8_t> shuffled(item_size > 1 ? n_bytes : 0);
+  if (item_size > 1)
+  {
+    shuffleBytes(raw.data(), shuffled.data(), n_pixels, item_size);
+    bytes = shuffled.data();
+  }
+
+  lzCompress(bytes, n_bytes, payload);
+  frame.flags = kFrameCompressed;
+  if (payload.size() >= n_bytes)
+  {
+    // store incompressible images as they are
+    payload.assign(bytes, bytes + n_bytes);
+    frame.flags = 0;
+  }
+  frame.n_bytes = static_cast<uint32_t>(payload.size());
+}
+
+template<typename O>
+inline void decodeImage(const uint8_t* payload, const EncodedFrame& frame, ImageCodec codec,
+                        std::size_t i, O& out)
+{
+  using value_type = typename O::value_type;
+
+  auto shape = out.shape();
+  std::size_t n_pixels = shape[1] * shape[2];
+  std::size_t item_size = codecItemSize(codec);
+  std::size_t n_bytes = n_pixels * item_size;
+
+  PooledBuffer<uint8_t> shuffled((frame.flags & kFrameCompressed) ? n_bytes : 0);
+  const uint8_t* bytes = payload;
+  if (frame.flags & kFrameCompressed)
+  {
+    lzDecompress(payload, frame.n_bytes, shuffled.data(), n_bytes);
+    bytes = shuffled.data();
+  } else if (frame.n_bytes != n_bytes)
+  {
+    throw std::invalid_argument("Corrupted image stream!");
+  }
+
+  PooledBuffer<uint8_t> raw(item_size > 1 ? n_bytes : 0);
+  if (item_size > 1)
+  {
+    unshuffleBytes(bytes, raw.data(), n_pixels, item_size);
+    bytes = raw.data();
+  }
+
+  switch (codec)
+  {
+    case ImageCodec::FLOAT32:
+    case ImageCodec::FLOAT16:
+    {
+      for (std::size_t j = 0; j < shape[1]; ++j)
+      {
+        for (std::size_t k = 0; k < shape[2]; ++k)
+        {
+          std::size_t idx = j * shape[2] + k;
+          float v;
+          if (codec == ImageCodec::FLOAT32)
+          {
+            std::memcpy(&v, bytes + idx * 4, sizeof v);
+          } else
+          {
+            uint16_t h;
+            std::memcpy(&h, bytes + idx * 2, sizeof h);
+            v = halfToFloat(h);
+          }
+          out(i, j, k) = static_cast<value_type>(v);
+        }
+      }
+      break;
+    }
+    case ImageCodec::UINT16:
+    {
+      // the buffer is aligned and is at least as large as the image
+      dequantizeImage(reinterpret_cast<const uint16_t*>(bytes), frame, i, out);
+      break;
+    }
+    case ImageCodec::UINT8:
+      dequantizeImage(bytes, frame, i, out);
+      break;
+  }
+}
+
+} // detail
+
+/**
+ * Encode an array of images into a compact byte stream for display.
+ *
+ * Each image is quantized according to the codec, byte-shuffled and
+ * compressed. The images are encoded in parallel.
+ *
+ * The stream consists of a table of the frame headers followed by the
+ * payloads of the images. It uses the native byte order.
+ *
+ * @param src: image array. shape = (indices, y, x)
+ * @param codec: pixel encoding.
+ */
+template<typename E, EnableIf<std::decay_t<E>, IsImageArray> = false>
+inline std::string encodeImages(const E& src, ImageCodec codec)
+{
+  FOAM_PROFILE_SCOPE("encodeImages", profiler::nBytes(src));
+
+  std::size_t n_images = src.shape()[0];
+  std::vector<detail::EncodedFrame> frames(n_images);
+  std::vector<std::vector<uint8_t>> payloads(n_images);
+
+  detail::parallelFor(n_images, [&src, codec, &frames, &payloads] (std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin; i < end; ++i) detail::encodeImage(src, i, codec, frames[i], payloads[i]);
+  });
+
+  std::size_t n_bytes = n_images * sizeof(detail::EncodedFrame);
+  for (const auto& p : payloads) n_bytes += p.size();
+
+  profiler::countAllocation();
+  std::string out(n_bytes, '\0');
+  if (n_images > 0) std::memcpy(&out[0], frames.data(), n_images * sizeof(detail::EncodedFrame));
+  std::size_t offset = n_images * sizeof(detail::EncodedFrame);
+  for (const auto& p : payloads)
+  {
+    if (!p.empty()) std::memcpy(&out[offset], p.data(), p.size());
+    offset += p.size();
+  }
+  return out;
+}
+
+/**
+ * Decode a byte stream created by encodeImages into an image array.
+ *
+ * @param data: pointer to the stream.
+ * @param n_bytes: size of the stream.
+ * @param codec: pixel encoding of the stream.
+ * @param out: image array with the shape of the encoded images.
+ */
+template<typename O, EnableIf<std::decay_t<O>, IsImageArray> = false>
+inline void decodeImages(const char* data, std::size_t n_bytes, ImageCodec codec, O& out)
+{
+  FOAM_PROFILE_SCOPE("decodeImages", profiler::nBytes(out));
+
+  codecItemSize(codec); // validate the codec
+
+  std::size_t n_images = out.shape()[0];
+  std::size_t table_size = n_images * sizeof(detail::EncodedFrame);
+  if (n_bytes < table_size) throw std::invalid_argument("Corrupted image stream!");
+
+  std::vector<detail::EncodedFrame> frames(n_images);
+  if (n_images > 0) std::memcpy(frames.data(), data, table_size);
+
+  std::vector<std::size_t> offsets(n_images);
+  std::size_t offset = table_size;
+  for (std::size_t i = 0; i < n_images; ++i)
+  {
+    offsets[i] = offset;
+    offset += frames[i].n_bytes;
+  }
+  if (offset != n_bytes) throw std::invalid_argument("Corrupted image stream!");
+
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  detail::parallelFor(n_images, [bytes, codec, &frames, &offsets, &out] (std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      detail::decodeImage(bytes + offsets[i], frames[i], codec, i, out);
+    }
+  });
+}
+
+} // foam
+
+#endif //EXTRA_FOAM_IMAGE_CODEC_H
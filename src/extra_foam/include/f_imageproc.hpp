@@ -10,87 +10,339 @@
 #ifndef EXTRA_FOAM_IMAGE_PROC_H
 #define EXTRA_FOAM_IMAGE_PROC_H
 
+#include <memory>
 #include <type_traits>
 
 #include "xtensor/xview.hpp"
 #include "xtensor/xmath.hpp"
 #include "xtensor/xindex_view.hpp"
 
-#if defined(FOAM_WITH_TBB)
-#include "tbb/parallel_for.h"
-#include "tbb/blocked_range2d.h"
-#include "tbb/blocked_range3d.h"
-#endif
-
 #include "f_traits.hpp"
+#include "f_bitmask.hpp"
 #include "f_utilities.hpp"
+#include "f_simd.hpp"
+#include "f_parallel.hpp"
+#include "f_buffer_pool.hpp"
 
 
 namespace foam
 {
 
+namespace detail
+{
+
+// Elementwise operations used in the masking and correction kernels. Each of
+// them provides a scalar overload and a batch overload for the SIMD path.
+
+template<typename T>
+struct MaskZeroNanOp
+{
+  T operator()(T v) const { return std::isnan(v) ? T(0) : v; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B>
+  B operator()(const B& v) const { return xsimd::select(xsimd::isnan(v), B(T(0)), v); }
+#endif
+};
+
+template<typename T>
+struct FillOp
+{
+  T value;
+
+  T operator()(T) const { return value; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B>
+  B operator()(const B&) const { return B(value); }
+#endif
+};
+
+template<typename T>
+struct MaskZeroThresholdOp
+{
+  T lb;
+  T ub;
+
+  T operator()(T v) const { return (std::isnan(v) || v < lb || v > ub) ? T(0) : v; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B>
+  B operator()(const B& v) const
+  {
+    return xsimd::select(xsimd::isnan(v) | (v < B(lb)) | (v > B(ub)), B(T(0)), v);
+  }
+#endif
+};
+
+template<typename T>
+struct MaskNanThresholdOp
+{
+  T lb;
+  T ub;
+
+  T operator()(T v) const { return (v < lb || v > ub) ? std::numeric_limits<T>::quiet_NaN() : v; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B>
+  B operator()(const B& v) const
+  {
+    return xsimd::select((v < B(lb)) | (v > B(ub)), B(std::numeric_limits<T>::quiet_NaN()), v);
+  }
+#endif
+};
+
+template<typename T>
+struct MaskZeroImageOp
+{
+  T operator()(T v, bool m) const { return (m || std::isnan(v)) ? T(0) : v; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B, typename BB>
+  B operator()(const B& v, const BB& m) const { return xsimd::select(m | xsimd::isnan(v), B(T(0)), v); }
+#endif
+};
+
+template<typename T>
+struct MaskNanImageOp
+{
+  T operator()(T v, bool m) const { return m ? std::numeric_limits<T>::quiet_NaN() : v; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B, typename BB>
+  B operator()(const B& v, const BB& m) const
+  {
+    return xsimd::select(m, B(std::numeric_limits<T>::quiet_NaN()), v);
+  }
+#endif
+};
+
+template<typename T>
+struct MaskZeroImageThresholdOp
+{
+  T lb;
+  T ub;
+
+  T operator()(T v, bool m) const { return (m || std::isnan(v) || v < lb || v > ub) ? T(0) : v; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B, typename BB>
+  B operator()(const B& v, const BB& m) const
+  {
+    return xsimd::select(m | xsimd::isnan(v) | (v < B(lb)) | (v > B(ub)), B(T(0)), v);
+  }
+#endif
+};
+
+template<typename T>
+struct MaskNanImageThresholdOp
+{
+  T lb;
+  T ub;
+
+  T operator()(T v, bool m) const
+  {
+    return (m || v < lb || v > ub) ? std::numeric_limits<T>::quiet_NaN() : v;
+  }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+  template<typename B, typename BB>
+  B operator()(const B& v, const BB& m) const
+  {
+    return xsimd::select(m | (v < B(lb)) | (v > B(ub)), B(std::numeric_limits<T>::quiet_NaN()), v);
+  }
+#endif
+};
+
+template<typename T>
+struct MovingAvgOp
+{
+  T count;
+
+  // identical for scalars and batches
+  template<typename B>
+  B operator()(const B& v, const B& data) const { return v + (data - v) / B(count); }
+};
+
+template<typename Policy>
+struct CorrectOp
+{
+  template<typename B>
+  B operator()(const B& v, const B& a) const { return Policy::correct(v, a); }
+};
+
+struct CorrectGainOffsetOp
+{
+  template<typename B>
+  B operator()(const B& v, const B& gain, const B& offset) const { return gain * (v - offset); }
+};
+
+} // detail
+
 #if defined(FOAM_WITH_TBB)
 namespace detail
 {
 
-template<typename E>
-inline auto nanmeanImageArrayImp(E&& src, const std::vector<size_t>& keep = {})
+/**
+ * NUMA mode of nanmeanImageArrayImp.
+ *
+ * Each node accumulates its own pulses into partial sums and counts which
+ * are allocated and first touched in its arena. The partial results are
+ * merged afterwards.
+ */
+template<typename E, typename O>
+inline void nanmeanImageArrayNumaImp(const E& src, O& mean, const std::vector<size_t>& keep)
 {
-  using value_type = typename std::decay_t<E>::value_type;
+  using value_type = typename E::value_type;
   auto shape = src.shape();
+  std::size_t ny = shape[1];
+  std::size_t nx = shape[2];
 
-  // a bit hacky
-  using return_type = decltype(xt::eval(xt::sum<value_type>(std::declval<E>(), {0})));
-  auto mean = return_type::from_shape({static_cast<std::size_t>(shape[1]),
-                                       static_cast<std::size_t>(shape[2])});
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+
+  std::size_t n_nodes = numaNodeCount();
+  std::vector<std::vector<value_type>> sums(n_nodes);
+  std::vector<std::vector<value_type>> counts(n_nodes);
 
-  tbb::parallel_for(tbb::blocked_range2d<int>(0, shape[1], 0, shape[2]),
-    [&src, &keep, &shape, &mean] (const tbb::blocked_range2d<int> &block)
+  forEachNumaNode(shape[0],
+    [&src, &keep, &sums, &counts, ny, nx, sx] (std::size_t node, std::size_t begin, std::size_t end)
     {
-      for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-      {
-        for(int k=block.cols().begin(); k != block.cols().end(); ++k)
+      auto& sum = sums[node];
+      auto& count = counts[node];
+      sum.assign(ny * nx, value_type(0));
+      count.assign(ny * nx, value_type(0));
+
+      parallelForRows(ny, nx,
+        [&src, &keep, &sum, &count, nx, sx, begin, end] (std::size_t j, std::size_t k0, std::size_t n)
         {
-          std::size_t count = 0;
-          value_type sum = 0;
+          value_type* s = sum.data() + j * nx + k0;
+          value_type* c = count.data() + j * nx + k0;
           if (keep.empty())
           {
-            for (auto i=0; i<shape[0]; ++i)
-            {
-              auto v = src(i, j, k);
-              if (! std::isnan(v))
-              {
-                count += 1;
-                sum += v;
-              }
-            }
+            for (auto i = begin; i < end; ++i) nanSumCount(&src(i, j, k0), sx, n, s, c);
           } else
           {
-            for (auto it=keep.begin(); it != keep.end(); ++it)
+            for (auto it = keep.begin(); it != keep.end(); ++it)
             {
-              auto v = src(*it, j, k);
-              if (! std::isnan(v))
-              {
-                count += 1;
-                sum += v;
-              }
+              if (*it >= begin && *it < end) nanSumCount(&src(*it, j, k0), sx, n, s, c);
             }
           }
+        }
+      );
+    }
+  );
 
-          if (count == 0)
-            mean(j, k) = std::numeric_limits<value_type>::quiet_NaN();
-          else mean(j, k) = sum / value_type(count);
+  parallelForRows(ny, nx,
+    [&mean, &sums, &counts, nx] (std::size_t j, std::size_t k0, std::size_t n)
+    {
+      for (std::size_t l = 0; l < n; ++l)
+      {
+        std::size_t idx = j * nx + k0 + l;
+        value_type s = 0;
+        value_type c = 0;
+        for (std::size_t node = 0; node < sums.size(); ++node)
+        {
+          // the nodes without pulses have not allocated the partial results
+          if (sums[node].empty()) continue;
+          s += sums[node][idx];
+          c += counts[node][idx];
         }
+        mean(j, k0 + l) = c == 0 ? std::numeric_limits<value_type>::quiet_NaN() : s / c;
       }
     }
   );
+}
 
-  return mean;
+template<typename E, typename O>
+inline void nanmeanImageArrayImp(const E& src, O& mean, const std::vector<size_t>& keep = {})
+{
+  if (numaActive())
+  {
+    nanmeanImageArrayNumaImp(src, mean, keep);
+    return;
+  }
+
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+
+  parallelForRows(shape[1], shape[2],
+    [&src, &keep, &shape, &mean, sx] (std::size_t j, std::size_t k0, std::size_t n)
+    {
+      // accumulate row segments over images to allow vectorization
+      PooledBuffer<value_type> sum(n, value_type(0));
+      PooledBuffer<value_type> count(n, value_type(0));
+
+      if (keep.empty())
+      {
+        for (auto i=0; i<shape[0]; ++i)
+          nanSumCount(&src(i, j, k0), sx, n, sum.data(), count.data());
+      } else
+      {
+        for (auto it=keep.begin(); it != keep.end(); ++it)
+          nanSumCount(&src(*it, j, k0), sx, n, sum.data(), count.data());
+      }
+
+      for (std::size_t l = 0; l < n; ++l)
+      {
+        if (count[l] == 0)
+          mean(j, k0 + l) = std::numeric_limits<value_type>::quiet_NaN();
+        else mean(j, k0 + l) = sum[l] / count[l];
+      }
+    }
+  );
 }
 
 } // detail
 #endif
 
+namespace detail
+{
+
+/**
+ * Allocate the output image of a reduction over an array of images.
+ */
+template<typename E>
+inline auto imageArrayReductionOutput(const E& src)
+{
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  // a bit hacky
+  using return_type = decltype(xt::eval(xt::sum<value_type>(std::declval<const E&>(), {0})));
+  profiler::countAllocation();
+  return return_type::from_shape({static_cast<std::size_t>(shape[1]),
+                                  static_cast<std::size_t>(shape[2])});
+}
+
+template<typename E, typename O>
+inline void nanmeanImageArrayTo(const E& src, const std::vector<size_t>& keep, O& out)
+{
+  checkShape(src.shape(), out.shape(), "Image and output have different shapes", 1);
+#if defined(FOAM_WITH_TBB)
+  if (keep.empty()) throw std::invalid_argument("keep cannot be empty!");
+  nanmeanImageArrayImp(src, out, keep);
+#else
+  using value_type = typename E::value_type;
+  out = xt::nanmean<value_type>(xt::view(src, xt::keep(keep), xt::all(), xt::all()), 0);
+#endif
+}
+
+template<typename E, typename O>
+inline void nanmeanImageArrayTo(const E& src, O& out)
+{
+  checkShape(src.shape(), out.shape(), "Image and output have different shapes", 1);
+#if defined(FOAM_WITH_TBB)
+  nanmeanImageArrayImp(src, out);
+#else
+  using value_type = typename E::value_type;
+  out = xt::nanmean<value_type>(src, 0);
+#endif
+}
+
+} // detail
+
 /**
  * Calculate the nanmean of the selected images from an array of images.
  *
@@ -101,25 +353,41 @@ inline auto nanmeanImageArrayImp(E&& src, const std::vector<size_t>& keep = {})
 template<typename E, EnableIf<std::decay_t<E>, IsImageArray> = false>
 inline auto nanmeanImageArray(E&& src, const std::vector<size_t>& keep)
 {
-#if defined(FOAM_WITH_TBB)
-  if (keep.empty()) throw std::invalid_argument("keep cannot be empty!");
-  return detail::nanmeanImageArrayImp(std::forward<E>(src), keep);
-#else
-  using value_type = typename std::decay_t<E>::value_type;
-  auto&& sliced(xt::view(std::forward<E>(src), xt::keep(keep), xt::all(), xt::all()));
-  return xt::eval(xt::nanmean<value_type>(sliced, 0));
-#endif
+  FOAM_PROFILE_SCOPE("nanmeanImageArray", profiler::nBytes(src));
+  auto mean = detail::imageArrayReductionOutput(src);
+  detail::nanmeanImageArrayTo(src, keep, mean);
+  return mean;
 }
 
 template<typename E, EnableIf<std::decay_t<E>, IsImageArray> = false>
 inline auto nanmeanImageArray(E&& src)
 {
-#if defined(FOAM_WITH_TBB)
-  return detail::nanmeanImageArrayImp(std::forward<E>(src));
-#else
-  using value_type = typename std::decay_t<E>::value_type;
-  return xt::eval(xt::nanmean<value_type>(std::forward<E>(src), 0));
-#endif
+  FOAM_PROFILE_SCOPE("nanmeanImageArray", profiler::nBytes(src));
+  auto mean = detail::imageArrayReductionOutput(src);
+  detail::nanmeanImageArrayTo(src, mean);
+  return mean;
+}
+
+/**
+ * Calculate the nanmean of the selected images from an array of images and
+ * write it to a pre-allocated image.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param keep: a list of selected indices.
+ * @param out: the nanmean image. shape = (y, x)
+ */
+template<typename E, typename O, EnableIf<E, IsImageArray> = false, EnableIf<O, IsImage> = false>
+inline void nanmeanImageArray(const E& src, const std::vector<size_t>& keep, O& out)
+{
+  FOAM_PROFILE_SCOPE("nanmeanImageArray", profiler::nBytes(src));
+  detail::nanmeanImageArrayTo(src, keep, out);
+}
+
+template<typename E, typename O, EnableIf<E, IsImageArray> = false, EnableIf<O, IsImage> = false>
+inline void nanmeanImageArray(const E& src, O& out)
+{
+  FOAM_PROFILE_SCOPE("nanmeanImageArray", profiler::nBytes(src));
+  detail::nanmeanImageArrayTo(src, out);
 }
 
 /**
@@ -127,44 +395,69 @@ inline auto nanmeanImageArray(E&& src)
  *
  * @param src1: image data. shape = (y, x)
  * @param src2: image data. shape = (y, x)
- * @return: the nanmean image. shape = (y, x)
+ * @param mean: the nanmean image. shape = (y, x)
  */
-template<typename E>
-inline auto nanmeanImageArray(E&& src1, E&& src2)
+template<typename E, typename O>
+inline void nanmeanImageArray(const E& src1, const E& src2, O& mean)
 {
-  using value_type = typename std::decay_t<E>::value_type;
+  FOAM_PROFILE_SCOPE("nanmeanTwoImages", profiler::nBytes(src1) + profiler::nBytes(src2));
+  using value_type = typename E::value_type;
   auto shape = src1.shape();
 
   checkShape(shape, src2.shape(), "Images have different shapes");
+  checkShape(shape, mean.shape(), "Image and output have different shapes");
 
 #if defined(FOAM_WITH_TBB)
-  auto mean = std::decay_t<E>({shape[0], shape[1]});
-
-  tbb::parallel_for(tbb::blocked_range2d<int>(0, shape[0], 0, shape[1]),
-    [&src1, &src2, &shape, &mean] (const tbb::blocked_range2d<int> &block)
+  detail::parallelForRows(shape[0], shape[1],
+    [&src1, &src2, &mean] (std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int j=block.rows().begin(); j != block.rows().end(); ++j)
+      for(std::size_t k=k0; k != k0 + n; ++k)
       {
-        for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-        {
-          auto x = src1(j, k);
-          auto y = src2(j, k);
-
-          if (std::isnan(x) and std::isnan(y))
-            mean(j, k) = std::numeric_limits<value_type>::quiet_NaN();
-          else if (std::isnan(x))
-            mean(j, k) = y;
-          else if (std::isnan(y))
-            mean(j, k) = x;
-          else mean(j, k)  = value_type(0.5) * (x + y);
-        }
+        auto x = src1(j, k);
+        auto y = src2(j, k);
+
+        if (std::isnan(x) and std::isnan(y))
+          mean(j, k) = std::numeric_limits<value_type>::quiet_NaN();
+        else if (std::isnan(x))
+          mean(j, k) = y;
+        else if (std::isnan(y))
+          mean(j, k) = x;
+        else mean(j, k)  = value_type(0.5) * (x + y);
       }
     }
   );
+#else
+  auto&& stacked = xt::stack(xt::xtuple(src1, src2));
+  mean = xt::nanmean<value_type>(stacked, 0);
+#endif
+}
+
+/**
+ * Calculate the nanmean of two images.
+ *
+ * @param src1: image data. shape = (y, x)
+ * @param src2: image data. shape = (y, x)
+ * @return: the nanmean image. shape = (y, x)
+ */
+template<typename E>
+inline auto nanmeanImageArray(E&& src1, E&& src2)
+{
+#if defined(FOAM_WITH_TBB)
+  auto shape = src1.shape();
 
+  checkShape(shape, src2.shape(), "Images have different shapes");
+
+  profiler::countAllocation();
+  auto mean = std::decay_t<E>({shape[0], shape[1]});
+  nanmeanImageArray(src1, src2, mean);
   return mean;
 #else
+  using value_type = typename std::decay_t<E>::value_type;
+
+  checkShape(src1.shape(), src2.shape(), "Images have different shapes");
+
   auto&& stacked = xt::stack(xt::xtuple(std::forward<E>(src1), std::forward<E>(src2)));
+  profiler::countAllocation();
   return xt::eval(xt::nanmean<value_type>(stacked, 0));
 #endif
 }
@@ -177,15 +470,15 @@ inline auto nanmeanImageArray(E&& src1, E&& src2)
 template <typename E, EnableIf<E, IsImage> = false>
 inline void maskImageDataZero(E& src)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
+  detail::MaskZeroNanOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      if (std::isnan(src(j, k))) src(j, k) = value_type(0);
-    }
+    detail::unaryTransform(&src(j, 0), sx, shape[1], op);
   }
 }
 
@@ -210,6 +503,7 @@ inline void maskImageDataNan(E& src) {}
 template <typename E, typename N, EnableIf<E, IsImage> = false, EnableIf<N, IsImageMask> = false>
 inline void imageDataNanMask(const E& src, N& out)
 {
+  FOAM_PROFILE_SCOPE("imageDataNanMask", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
@@ -236,17 +530,15 @@ template <typename E, typename T,
   EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
 inline void maskImageDataZero(E& src, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+  detail::MaskZeroThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      auto v = src(j, k);
-      if (std::isnan(v) || v < lb || v > ub) src(j, k) = value_type(0);
-    }
+    detail::unaryTransform(&src(j, 0), sx, shape[1], op);
   }
 }
 
@@ -264,6 +556,7 @@ template <typename E, typename T, typename N,
   EnableIf<N, IsImageMask> = false>
 inline void maskImageDataZero(E& src, T lb, T ub, N& out)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
@@ -295,18 +588,15 @@ template <typename E, typename T,
   EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
 inline void maskImageDataNan(E& src, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+  detail::MaskNanThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      auto v = src(j, k);
-      if (std::isnan(v)) continue;
-      if (v < lb || v > ub) src(j, k) = nan;
-    }
+    detail::unaryTransform(&src(j, 0), sx, shape[1], op);
   }
 }
 
@@ -323,6 +613,7 @@ template <typename E, typename T, typename N,
   EnableIf<N, IsImageMask> = false>
 inline void maskImageDataNan(E& src, T lb, T ub, N& out)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
@@ -355,18 +646,18 @@ template <typename E, typename M,
   EnableIf<E, IsImage> = false, EnableIf<M, IsImageMask> = false>
 inline void maskImageDataZero(E& src, const M& mask)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes");
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+  detail::MaskZeroImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      if (mask(j, k) || std::isnan(src(j, k))) src(j, k) = value_type(0);
-    }
+    detail::maskedTransform(&src(j, 0), sx, &mask(j, 0), mx, shape[1], op);
   }
 }
 
@@ -382,6 +673,7 @@ template <typename E, typename M, typename N,
   EnableIf<E, IsImage> = false, EnableIf<M, IsImageMask> = false, EnableIf<N, IsImageMask> = false>
 inline void maskImageDataZero(E& src, const M& mask, M& out)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
@@ -412,18 +704,18 @@ template <typename E, typename M,
   EnableIf<E, IsImage> = false, EnableIf<M, IsImageMask> = false>
 inline void maskImageDataNan(E& src, const M& mask)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes");
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+  detail::MaskNanImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      if (mask(j, k)) src(j, k) = nan;
-    }
+    detail::maskedTransform(&src(j, 0), sx, &mask(j, 0), mx, shape[1], op);
   }
 }
 
@@ -437,6 +729,7 @@ template <typename E, typename M, typename N,
   EnableIf<E, IsImage> = false, EnableIf<M, IsImageMask> = false, EnableIf<N, IsImageMask> = false>
 inline void maskImageDataNan(E& src, const M& mask, N& out)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
@@ -474,23 +767,18 @@ template <typename E, typename M, typename T,
   std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
 inline void maskImageDataZero(E& src, const M& mask, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes");
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+  detail::MaskZeroImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      if (mask(j, k)) src(j, k) = value_type(0);
-      else
-      {
-        auto v = src(j, k);
-        if (std::isnan(v) || v < lb || v > ub) src(j, k) = value_type(0);
-      }
-    }
+    detail::maskedTransform(&src(j, 0), sx, &mask(j, 0), mx, shape[1], op);
   }
 }
 
@@ -508,6 +796,7 @@ template <typename E, typename M, typename T, typename N,
   EnableIf<E, IsImage> = false, EnableIf<M, IsImageMask> = false, EnableIf<N, IsImageMask> = false>
 inline void maskImageDataZero(E& src, const M& mask, T lb, T ub, N& out)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
@@ -549,24 +838,18 @@ template <typename E, typename M, typename T,
   std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
 inline void maskImageDataNan(E& src, const M& mask, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes");
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+  detail::MaskNanImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      if (mask(j, k)) src(j, k) = nan;
-      else
-      {
-        auto v = src(j, k);
-        if (std::isnan(v)) continue;
-        if (v < lb || v > ub) src(j, k) = nan;
-      }
-    }
+    detail::maskedTransform(&src(j, 0), sx, &mask(j, 0), mx, shape[1], op);
   }
 }
 
@@ -582,6 +865,7 @@ template <typename E, typename M, typename T, typename N,
   EnableIf<E, IsImage> = false, EnableIf<M, IsImageMask> = false, EnableIf<N, IsImageMask> = false>
 inline void maskImageDataNan(E& src, const M& mask, T lb, T ub, N& out)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
@@ -610,6 +894,33 @@ inline void maskImageDataNan(E& src, const M& mask, T lb, T ub, N& out)
   }
 }
 
+/**
+ * Inplace fill an array of images with a value.
+ *
+ * The images are written with the same partition as the other kernels, so
+ * that a newly allocated buffer is first touched by the threads (and, in the
+ * NUMA mode, on the nodes) which will process it.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param value: fill value.
+ */
+template <typename E, typename T, EnableIf<E, IsImageArray> = false>
+inline void fillImageData(E& src, T value)
+{
+  FOAM_PROFILE_SCOPE("fillImageData", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  detail::FillOp<value_type> op {static_cast<value_type>(value)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+    {
+      detail::unaryTransform(&src(i, j, k0), sx, n, op);
+    }
+  );
+}
+
 /**
  * Inplace convert nan using 0 in an array of images.
  *
@@ -618,28 +929,18 @@ inline void maskImageDataNan(E& src, const M& mask, T lb, T ub, N& out)
 template <typename E, EnableIf<E, IsImageArray> = false>
 inline void maskImageDataZero(E& src)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src] (const tbb::blocked_range3d<int> &block)
+  detail::MaskZeroNanOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-            if (std::isnan(src(i, j, k))) src(i, j, k) = value_type(0);
-          }
-        }
-      }
+      detail::unaryTransform(&src(i, j, k0), sx, n, op);
     }
   );
-#else
-  xt::filter(src, xt::isnan(src)) = value_type(0);
-#endif
 }
 
 /**
@@ -662,30 +963,18 @@ template <typename E, typename T,
   EnableIf<E, IsImageArray> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
 inline void maskImageDataZero(E& src, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
-#if defined(FOAM_WITH_TBB)
   auto shape = src.shape();
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, lb, ub, nan] (const tbb::blocked_range3d<int> &block)
+  detail::MaskZeroThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-            auto v = src(i, j, k);
-            if (std::isnan(v) || v < lb || v > ub) src(i, j, k) = value_type(0);
-          }
-        }
-      }
+      detail::unaryTransform(&src(i, j, k0), sx, n, op);
     }
   );
-#else
-  xt::filter(src, xt::isnan(src) | src < lb | src > ub) = value_type(0);
-#endif
 }
 
 /**
@@ -699,32 +988,18 @@ template <typename E, typename T,
   EnableIf<E, IsImageArray> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
 inline void maskImageDataNan(E& src, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
-
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
-#if defined(FOAM_WITH_TBB)
   auto shape = src.shape();
 
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, lb, ub, nan] (const tbb::blocked_range3d<int> &block)
+  detail::MaskNanThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-            auto v = src(i, j, k);
-            if (std::isnan(v)) continue;
-            if (v < lb || v > ub) src(i, j, k) = nan;
-          }
-        }
-      }
+      detail::unaryTransform(&src(i, j, k0), sx, n, op);
     }
   );
-#else
-  xt::filter(src, src < lb | src > ub) = nan;
-#endif
 }
 
 /**
@@ -738,38 +1013,21 @@ template <typename E, typename M,
   EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
 inline void maskImageDataZero(E& src, const M& mask)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, &mask, nan] (const tbb::blocked_range3d<int> &block)
+  detail::MaskZeroImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx, mx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-#else
-      for (size_t i = 0; i < shape[0]; ++i)
-      {
-        for (size_t j = 0; j < shape[1]; ++j)
-        {
-          for (size_t k = 0; k < shape[2]; ++k)
-          {
-#endif
-            if (mask(j, k) || std::isnan(src(i, j, k))) src(i, j, k) = value_type(0);
-          }
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      detail::maskedTransform(&src(i, j, k0), sx, &mask(j, k0), mx, n, op);
     }
   );
-#endif
 }
 
 /**
@@ -782,142 +1040,464 @@ template <typename E, typename M,
   EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
 inline void maskImageDataNan(E& src, const M& mask)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, &mask, nan] (const tbb::blocked_range3d<int> &block)
+  detail::MaskNanImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx, mx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+    {
+      detail::maskedTransform(&src(i, j, k0), sx, &mask(j, k0), mx, n, op);
+    }
+  );
+}
+
+/**
+ * Inplace mask an array of images using 0 with both threshold mask and an image mask.
+ * Nan pixels in those images are also converted into 0.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param mask: image mask. shape = (y, x)
+ */
+template <typename E, typename M, typename T,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
+inline void maskImageDataZero(E& src, const M& mask, T lb, T ub)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
+
+  detail::MaskZeroImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx, mx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+    {
+      detail::maskedTransform(&src(i, j, k0), sx, &mask(j, k0), mx, n, op);
+    }
+  );
+}
+
+/**
+ * Inplace mask an array of images using nan with both threshold mask and an image mask.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param mask: image mask. shape = (y, x)
+ */
+template <typename E, typename M, typename T,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
+inline void maskImageDataNan(E& src, const M& mask, T lb, T ub)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
+
+  detail::MaskNanImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto mx = static_cast<std::ptrdiff_t>(mask.strides()[1]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx, mx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+    {
+      detail::maskedTransform(&src(i, j, k0), sx, &mask(j, k0), mx, n, op);
+    }
+  );
+}
+
+namespace detail
+{
+
+/**
+ * Inplace apply an elementwise operation to a 1D range of a row of data with
+ * the corresponding range of a bit-packed mask.
+ *
+ * The mask is unpacked chunk by chunk into a buffer on the stack so that the
+ * SIMD path of maskedTransform can be reused.
+ */
+template<typename T, typename Op>
+inline void bitMaskedTransform(T* p, std::ptrdiff_t sp, const BitMask& mask,
+                               std::size_t j, std::size_t k0, std::size_t n, Op& op)
+{
+  constexpr std::size_t chunk = 4 * BitMask::word_bits;
+  bool buf[chunk];
+  for (std::size_t k = 0; k < n; k += chunk)
+  {
+    std::size_t m = std::min(chunk, n - k);
+    mask.unpack(j, k0 + k, m, buf);
+    maskedTransform(p + k * sp, sp, buf, 1, m, op);
+  }
+}
+
+} // detail
+
+/**
+ * Get the nan mask of an image.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param out: bit-packed mask to place the mask. shape = (y, x)
+ */
+template <typename E, EnableIf<E, IsImage> = false>
+inline void imageDataNanMask(const E& src, BitMask& out)
+{
+  FOAM_PROFILE_SCOPE("imageDataNanMask", profiler::nBytes(src));
+  auto shape = src.shape();
+
+  checkShape(shape, out.shape(), "Image and output array have different shapes");
+
+  for (size_t j = 0; j < shape[0]; ++j)
+  {
+    for (size_t k = 0; k < shape[1]; ++k)
+    {
+      if (std::isnan(src(j, k))) out.set(j, k);
+    }
+  }
+}
+
+/**
+ * Get the threshold mask of an image. Nan pixels are also masked.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ * @param out: bit-packed mask to place the mask. shape = (y, x)
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void imageDataThresholdMask(const E& src, T lb, T ub, BitMask& out)
+{
+  FOAM_PROFILE_SCOPE("imageDataThresholdMask", profiler::nBytes(src));
+  auto shape = src.shape();
+
+  checkShape(shape, out.shape(), "Image and output array have different shapes");
+
+  for (size_t j = 0; j < shape[0]; ++j)
+  {
+    for (size_t k = 0; k < shape[1]; ++k)
+    {
+      auto v = src(j, k);
+      if (std::isnan(v) || v < lb || v > ub) out.set(j, k);
+    }
+  }
+}
+
+/**
+ * Inplace mask an image using 0 with a bit-packed image mask. Nan pixels in
+ * the image are also converted into 0.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ */
+template <typename E, EnableIf<E, IsImage> = false>
+inline void maskImageDataZero(E& src, const BitMask& mask)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes");
+
+  detail::MaskZeroImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  for (size_t j = 0; j < shape[0]; ++j)
+  {
+    detail::bitMaskedTransform(&src(j, 0), sx, mask, j, 0, shape[1], op);
+  }
+}
+
+/**
+ * Inplace mask an image using nan with a bit-packed image mask.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ */
+template <typename E, EnableIf<E, IsImage> = false>
+inline void maskImageDataNan(E& src, const BitMask& mask)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes");
+
+  detail::MaskNanImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  for (size_t j = 0; j < shape[0]; ++j)
+  {
+    detail::bitMaskedTransform(&src(j, 0), sx, mask, j, 0, shape[1], op);
+  }
+}
+
+/**
+ * Inplace mask an image using 0 with both threshold mask and a bit-packed
+ * image mask. Nan pixels in the image are also converted into 0.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataZero(E& src, const BitMask& mask, T lb, T ub)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes");
+
+  detail::MaskZeroImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  for (size_t j = 0; j < shape[0]; ++j)
+  {
+    detail::bitMaskedTransform(&src(j, 0), sx, mask, j, 0, shape[1], op);
+  }
+}
+
+/**
+ * Inplace mask an image using nan with both threshold mask and a bit-packed
+ * image mask.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataNan(E& src, const BitMask& mask, T lb, T ub)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes");
+
+  detail::MaskNanImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  for (size_t j = 0; j < shape[0]; ++j)
+  {
+    detail::bitMaskedTransform(&src(j, 0), sx, mask, j, 0, shape[1], op);
+  }
+}
+
+/**
+ * Inplace mask an image using 0 with threshold mask. Nan pixels in
+ * the image are also converted into 0.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ * @param out: bit-packed mask to place the overall mask. shape = (y, x)
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataZero(E& src, T lb, T ub, BitMask& out)
+{
+  imageDataThresholdMask(src, lb, ub, out);
+  maskImageDataZero(src, lb, ub);
+}
+
+/**
+ * Inplace mask an image using nan with threshold mask.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ * @param out: bit-packed mask to place the overall mask. shape = (y, x)
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataNan(E& src, T lb, T ub, BitMask& out)
+{
+  imageDataThresholdMask(src, lb, ub, out);
+  maskImageDataNan(src, lb, ub);
+}
+
+/**
+ * Inplace mask an image using 0 with a bit-packed image mask. Nan pixels in
+ * the image are also converted into 0.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param out: bit-packed mask to place the overall mask. shape = (y, x)
+ */
+template <typename E, EnableIf<E, IsImage> = false>
+inline void maskImageDataZero(E& src, const BitMask& mask, BitMask& out)
+{
+  imageDataNanMask(src, out);
+  out |= mask;
+  maskImageDataZero(src, mask);
+}
+
+/**
+ * Inplace mask an image using nan with a bit-packed image mask.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param out: bit-packed mask to place the overall mask. shape = (y, x)
+ */
+template <typename E, EnableIf<E, IsImage> = false>
+inline void maskImageDataNan(E& src, const BitMask& mask, BitMask& out)
+{
+  imageDataNanMask(src, out);
+  out |= mask;
+  maskImageDataNan(src, mask);
+}
+
+/**
+ * Inplace mask an image using 0 with both threshold mask and a bit-packed
+ * image mask. Nan pixels in the image are also converted into 0.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ * @param out: bit-packed mask to place the overall mask. shape = (y, x)
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataZero(E& src, const BitMask& mask, T lb, T ub, BitMask& out)
+{
+  imageDataThresholdMask(src, lb, ub, out);
+  out |= mask;
+  maskImageDataZero(src, mask, lb, ub);
+}
+
+/**
+ * Inplace mask an image using nan with both threshold mask and a bit-packed
+ * image mask.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ * @param out: bit-packed mask to place the overall mask. shape = (y, x)
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImage> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataNan(E& src, const BitMask& mask, T lb, T ub, BitMask& out)
+{
+  imageDataThresholdMask(src, lb, ub, out);
+  out |= mask;
+  maskImageDataNan(src, mask, lb, ub);
+}
+
+/**
+ * Inplace mask an array of images using 0 with a bit-packed image mask. Nan
+ * pixels in those images are also converted into 0.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ */
+template <typename E, EnableIf<E, IsImageArray> = false>
+inline void maskImageDataZero(E& src, const BitMask& mask)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
+
+  detail::MaskZeroImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+    {
+      detail::bitMaskedTransform(&src(i, j, k0), sx, mask, j, k0, n, op);
+    }
+  );
+}
+
+/**
+ * Inplace mask an array of images using nan with a bit-packed image mask.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ */
+template <typename E, EnableIf<E, IsImageArray> = false>
+inline void maskImageDataNan(E& src, const BitMask& mask)
+{
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+
+  checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
+
+  detail::MaskNanImageOp<value_type> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-#else
-      for (size_t i = 0; i < shape[0]; ++i)
-      {
-        for (size_t j = 0; j < shape[1]; ++j)
-        {
-          for (size_t k = 0; k < shape[2]; ++k)
-          {
-#endif
-            if (mask(j, k)) src(i, j, k) = nan;
-          }
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      detail::bitMaskedTransform(&src(i, j, k0), sx, mask, j, k0, n, op);
     }
   );
-#endif
 }
 
 /**
- * Inplace mask an array of images using 0 with both threshold mask and an image mask.
- * Nan pixels in those images are also converted into 0.
+ * Inplace mask an array of images using 0 with both threshold mask and a
+ * bit-packed image mask. Nan pixels in those images are also converted into 0.
  *
  * @param src: image data. shape = (indices, y, x)
- * @param mask: image mask. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
  */
-template <typename E, typename M, typename T,
-  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
-inline void maskImageDataZero(E& src, const M& mask, T lb, T ub)
+template <typename E, typename T,
+  EnableIf<E, IsImageArray> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataZero(E& src, const BitMask& mask, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataZero", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, &mask, lb, ub, nan] (const tbb::blocked_range3d<int> &block)
+  detail::MaskZeroImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-#else
-      for (size_t i = 0; i < shape[0]; ++i)
-      {
-        for (size_t j = 0; j < shape[1]; ++j)
-        {
-          for (size_t k = 0; k < shape[2]; ++k)
-          {
-#endif
-            if (mask(j, k))
-            {
-              src(i, j, k) = value_type(0);
-            } else
-            {
-              auto v = src(i, j, k);
-              if (std::isnan(v) || v < lb || v > ub) src(i, j, k) = value_type(0);
-            }
-          }
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      detail::bitMaskedTransform(&src(i, j, k0), sx, mask, j, k0, n, op);
     }
   );
-#endif
 }
 
 /**
- * Inplace mask an array of images using nan with both threshold mask and an image mask.
+ * Inplace mask an array of images using nan with both threshold mask and a
+ * bit-packed image mask.
  *
  * @param src: image data. shape = (indices, y, x)
- * @param mask: image mask. shape = (y, x)
+ * @param mask: bit-packed image mask. shape = (y, x)
+ * @param lb: lower threshold
+ * @param ub: upper threshold
  */
-template <typename E, typename M, typename T,
-  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
-inline void maskImageDataNan(E& src, const M& mask, T lb, T ub)
+template <typename E, typename T,
+  EnableIf<E, IsImageArray> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void maskImageDataNan(E& src, const BitMask& mask, T lb, T ub)
 {
+  FOAM_PROFILE_SCOPE("maskImageDataNan", profiler::nBytes(src));
   using value_type = typename E::value_type;
   auto shape = src.shape();
 
   checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
 
-  auto nan = std::numeric_limits<value_type>::quiet_NaN();
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, &mask, lb, ub, nan] (const tbb::blocked_range3d<int> &block)
+  detail::MaskNanImageThresholdOp<value_type> op {value_type(lb), value_type(ub)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &mask, &op, sx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-#else
-      for (size_t i = 0; i < shape[0]; ++i)
-      {
-        for (size_t j = 0; j < shape[1]; ++j)
-        {
-          for (size_t k = 0; k < shape[2]; ++k)
-          {
-#endif
-            if (mask(j, k))
-            {
-              src(i, j, k) = nan;
-            } else
-            {
-              auto v = src(i, j, k);
-              if (std::isnan(v)) continue;
-              if (v < lb || v > ub) src(i, j, k) = nan;
-            }
-          }
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      detail::bitMaskedTransform(&src(i, j, k0), sx, mask, j, k0, n, op);
     }
   );
-#endif
 }
 
 /**
@@ -930,6 +1510,7 @@ inline void maskImageDataNan(E& src, const M& mask, T lb, T ub)
 template <typename E, EnableIf<E, IsImage> = false>
 inline void movingAvgImageData(E& src, const E& data, size_t count)
 {
+  FOAM_PROFILE_SCOPE("movingAvgImageData", profiler::nBytes(src));
   if (count == 0) throw std::invalid_argument("'count' cannot be zero!");
 
   using value_type = typename E::value_type;
@@ -937,12 +1518,12 @@ inline void movingAvgImageData(E& src, const E& data, size_t count)
 
   checkShape(shape, data.shape(), "Inconsistent data shapes");
 
+  detail::MovingAvgOp<value_type> op {value_type(count)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  auto dx = static_cast<std::ptrdiff_t>(data.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      src(j, k) += (data(j, k) - src(j, k)) / value_type(count);
-    }
+    detail::binaryTransform(&src(j, 0), sx, &data(j, 0), dx, shape[1], op);
   }
 }
 
@@ -956,6 +1537,7 @@ inline void movingAvgImageData(E& src, const E& data, size_t count)
 template <typename E, EnableIf<E, IsImageArray> = false>
 inline void movingAvgImageData(E& src, const E& data, size_t count)
 {
+  FOAM_PROFILE_SCOPE("movingAvgImageData", profiler::nBytes(src));
   if (count == 0) throw std::invalid_argument("'count' cannot be zero!");
 
   using value_type = typename E::value_type;
@@ -963,32 +1545,15 @@ inline void movingAvgImageData(E& src, const E& data, size_t count)
 
   checkShape(shape, data.shape(), "Inconsistent data shapes");
 
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, &data, count] (const tbb::blocked_range3d<int> &block)
+  detail::MovingAvgOp<value_type> op {value_type(count)};
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto dx = static_cast<std::ptrdiff_t>(data.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &data, &op, sx, dx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-#else
-      for (size_t i = 0; i < shape[0]; ++i)
-      {
-        for (size_t j = 0; j < shape[1]; ++j)
-        {
-          for (size_t k = 0; k < shape[2]; ++k)
-          {
-#endif
-            src(i, j, k) += (data(i, j, k) - src(i, j, k)) / value_type(count);
-          }
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      detail::binaryTransform(&src(i, j, k0), sx, &data(i, j, k0), dx, n, op);
     }
   );
-#endif
 }
 
 class OffsetPolicy {
@@ -1018,36 +1583,20 @@ public:
 template <typename Policy, typename E, EnableIf<E, IsImageArray> = false>
 inline void correctImageData(E& src, const E& constants)
 {
+  FOAM_PROFILE_SCOPE("correctImageData", profiler::nBytes(src));
   auto shape = src.shape();
 
   checkShape(shape, constants.shape(), "data and constants have different shapes");
 
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, &constants] (const tbb::blocked_range3d<int> &block)
+  detail::CorrectOp<Policy> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto cx = static_cast<std::ptrdiff_t>(constants.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &constants, &op, sx, cx] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-#else
-      for (size_t i = 0; i < shape[0]; ++i)
-      {
-        for (size_t j = 0; j < shape[1]; ++j)
-        {
-          for (size_t k = 0; k < shape[2]; ++k)
-          {
-#endif
-            src(i, j, k) = Policy::correct(src(i, j, k), constants(i, j, k));
-          }
-        }
-      }
-#if defined(FOAM_WITH_TBB)
+      detail::binaryTransform(&src(i, j, k0), sx, &constants(i, j, k0), cx, n, op);
     }
   );
-#endif
 }
 
 /**
@@ -1061,16 +1610,17 @@ inline void correctImageData(E& src, const E& constants)
 template <typename Policy, typename E, EnableIf<E, IsImage> = false>
 inline void correctImageData(E& src, const E& constants)
 {
+  FOAM_PROFILE_SCOPE("correctImageData", profiler::nBytes(src));
   auto shape = src.shape();
 
   checkShape(shape, constants.shape(), "data and constants have different shapes");
 
+  detail::CorrectOp<Policy> op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  auto cx = static_cast<std::ptrdiff_t>(constants.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
-    {
-      src(j, k) = Policy::correct(src(j, k), constants(j, k));
-    }
+    detail::binaryTransform(&src(j, 0), sx, &constants(j, 0), cx, shape[1], op);
   }
 }
 
@@ -1084,37 +1634,22 @@ inline void correctImageData(E& src, const E& constants)
 template <typename E, EnableIf<E, IsImageArray> = false>
 inline void correctImageData(E& src, const E& gain, const E& offset)
 {
+  FOAM_PROFILE_SCOPE("correctImageData", profiler::nBytes(src));
   auto shape = src.shape();
 
   checkShape(shape, gain.shape(), "data and gain constants have different shapes");
   checkShape(shape, offset.shape(), "data and offset constants have different shapes");
 
-#if defined(FOAM_WITH_TBB)
-  tbb::parallel_for(tbb::blocked_range3d<int>(0, shape[0], 0, shape[1], 0, shape[2]),
-    [&src, &gain, &offset] (const tbb::blocked_range3d<int> &block)
-    {
-      for(int i=block.pages().begin(); i != block.pages().end(); ++i)
-      {
-        for(int j=block.rows().begin(); j != block.rows().end(); ++j)
-        {
-          for(int k=block.cols().begin(); k != block.cols().end(); ++k)
-          {
-#else
-  for (size_t i = 0; i < shape[0]; ++i)
+  detail::CorrectGainOffsetOp op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto gx = static_cast<std::ptrdiff_t>(gain.strides()[2]);
+  auto ox = static_cast<std::ptrdiff_t>(offset.strides()[2]);
+  detail::parallelForImageRows(shape[0], shape[1], shape[2],
+    [&src, &gain, &offset, &op, sx, gx, ox] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
     {
-      for (size_t j = 0; j < shape[1]; ++j)
-      {
-        for (size_t k = 0; k < shape[2]; ++k)
-        {
-#endif
-          src(i, j, k) = gain(i, j, k) * (src(i, j, k) - offset(i, j, k));
-        }
-      }
-    }
-#if defined(FOAM_WITH_TBB)
+      detail::ternaryTransform(&src(i, j, k0), sx, &gain(i, j, k0), gx, &offset(i, j, k0), ox, n, op);
     }
   );
-#endif
 }
 
 /**
@@ -1127,18 +1662,360 @@ inline void correctImageData(E& src, const E& gain, const E& offset)
 template <typename E, EnableIf<E, IsImage> = false>
 inline void correctImageData(E& src, const E& gain, const E& offset)
 {
+  FOAM_PROFILE_SCOPE("correctImageData", profiler::nBytes(src));
   auto shape = src.shape();
 
   checkShape(shape, gain.shape(), "data and gain constants have different shapes");
   checkShape(shape, offset.shape(), "data and offset constants have different shapes");
 
+  detail::CorrectGainOffsetOp op;
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[1]);
+  auto gx = static_cast<std::ptrdiff_t>(gain.strides()[1]);
+  auto ox = static_cast<std::ptrdiff_t>(offset.strides()[1]);
   for (size_t j = 0; j < shape[0]; ++j)
   {
-    for (size_t k = 0; k < shape[1]; ++k)
+    detail::ternaryTransform(&src(j, 0), sx, &gain(j, 0), gx, &offset(j, 0), ox, shape[1], op);
+  }
+}
+
+namespace detail
+{
+
+template <typename M, EnableIf<M, IsImageMask> = false>
+inline const bool* imageMaskRow(const M& mask, std::size_t j, bool*)
+{
+  return &mask(j, 0);
+}
+
+inline const bool* imageMaskRow(const BitMask& mask, std::size_t j, bool* buf)
+{
+  mask.unpack(j, 0, mask.shape()[1], buf);
+  return buf;
+}
+
+template <typename M, EnableIf<M, IsImageMask> = false>
+inline std::ptrdiff_t imageMaskRowStride(const M& mask)
+{
+  return static_cast<std::ptrdiff_t>(mask.strides()[1]);
+}
+
+inline std::ptrdiff_t imageMaskRowStride(const BitMask&)
+{
+  return 1;
+}
+
+template <bool WithGain, bool WithOffset, typename E, typename M, typename T, typename O>
+inline void correctMaskNanmeanImageArrayImp(E& src, const E& gain, const E& offset, const M& mask,
+                                            T lb, T ub, const std::vector<size_t>& keep, O& mean)
+{
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+  int n_pulses = static_cast<int>(shape[0]);
+  int n_rows = static_cast<int>(shape[1]);
+  int n_cols = static_cast<int>(shape[2]);
+
+  std::vector<char> selected(shape[0], keep.empty() ? 1 : 0);
+  for (auto idx : keep)
+  {
+    if (idx >= shape[0]) throw std::out_of_range("Index of the kept image is out of range!");
+    selected[idx] = 1;
+  }
+
+  bool with_mask = mask.size() != 0;
+  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+  auto gx = WithGain ? static_cast<std::ptrdiff_t>(gain.strides()[2]) : 0;
+  auto ox = WithOffset ? static_cast<std::ptrdiff_t>(offset.strides()[2]) : 0;
+  auto mx = with_mask ? imageMaskRowStride(mask) : 0;
+
+  auto sweep = [&src, &gain, &offset, &mask, &mean, &selected,
+                n_pulses, n_cols, with_mask, lb, ub, nan, sx, gx, ox, mx] (int row_begin, int row_end)
+  {
+    // a bit-packed mask is unpacked once per row
+    std::unique_ptr<bool[]> row_buf(std::is_same<M, BitMask>::value && with_mask ? new bool[n_cols] : nullptr);
+
+    CorrectGainOffsetOp gain_offset_op;
+    CorrectOp<GainPolicy> gain_op;
+    CorrectOp<OffsetPolicy> offset_op;
+    MaskNanThresholdOp<value_type> threshold_op {value_type(lb), value_type(ub)};
+    MaskNanImageThresholdOp<value_type> image_threshold_op {value_type(lb), value_type(ub)};
+
+    PooledBuffer<value_type> sum(n_cols);
+    PooledBuffer<value_type> count(n_cols);
+    for (int j = row_begin; j != row_end; ++j)
     {
-      src(j, k) = gain(j, k) * (src(j, k) - offset(j, k));
+      std::fill(sum.begin(), sum.end(), value_type(0));
+      std::fill(count.begin(), count.end(), value_type(0));
+      const bool* m = with_mask ? imageMaskRow(mask, j, row_buf.get()) : nullptr;
+
+      // the row is processed in several passes while it stays in the cache
+      for (int i = 0; i < n_pulses; ++i)
+      {
+        auto p = &src(i, j, 0);
+        if (WithGain && WithOffset)
+          ternaryTransform(p, sx, &gain(i, j, 0), gx, &offset(i, j, 0), ox, n_cols, gain_offset_op);
+        else if (WithOffset)
+          binaryTransform(p, sx, &offset(i, j, 0), ox, n_cols, offset_op);
+        else if (WithGain)
+          binaryTransform(p, sx, &gain(i, j, 0), gx, n_cols, gain_op);
+
+        if (with_mask) maskedTransform(p, sx, m, mx, n_cols, image_threshold_op);
+        else unaryTransform(p, sx, n_cols, threshold_op);
+
+        if (selected[i]) nanSumCount(p, sx, n_cols, sum.data(), count.data());
+      }
+
+      for (int k = 0; k < n_cols; ++k)
+      {
+        if (count[k] == 0) mean(j, k) = nan;
+        else mean(j, k) = sum[k] / count[k];
+      }
     }
+  };
+
+  parallelFor(n_rows, [&sweep] (std::size_t row_begin, std::size_t row_end)
+  {
+    sweep(static_cast<int>(row_begin), static_cast<int>(row_end));
+  });
+}
+
+template <typename E, typename M, typename T, typename O>
+inline void correctMaskNanmeanImageArrayDispatch(E& src, const E& gain, const E& offset, const M& mask,
+                                                 T lb, T ub, const std::vector<size_t>& keep, O& mean)
+{
+  auto shape = src.shape();
+
+  bool with_gain = gain.size() != 0;
+  bool with_offset = offset.size() != 0;
+  if (with_gain) checkShape(shape, gain.shape(), "data and gain constants have different shapes");
+  if (with_offset) checkShape(shape, offset.shape(), "data and offset constants have different shapes");
+  if (mask.size() != 0) checkShape(shape, mask.shape(), "Image and mask have different shapes", 1);
+  checkShape(shape, mean.shape(), "Image and output have different shapes", 1);
+
+  if (with_gain && with_offset)
+    correctMaskNanmeanImageArrayImp<true, true>(src, gain, offset, mask, lb, ub, keep, mean);
+  else if (with_gain)
+    correctMaskNanmeanImageArrayImp<true, false>(src, gain, offset, mask, lb, ub, keep, mean);
+  else if (with_offset)
+    correctMaskNanmeanImageArrayImp<false, true>(src, gain, offset, mask, lb, ub, keep, mean);
+  else
+    correctMaskNanmeanImageArrayImp<false, false>(src, gain, offset, mask, lb, ub, keep, mean);
+}
+
+template <typename E, typename M, typename T>
+inline auto correctMaskNanmeanImageArrayDispatch(E& src, const E& gain, const E& offset, const M& mask,
+                                                 T lb, T ub, const std::vector<size_t>& keep)
+{
+  FOAM_PROFILE_SCOPE("correctMaskNanmeanImageArray", profiler::nBytes(src));
+  auto mean = imageArrayReductionOutput(src);
+  correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, keep, mean);
+  return mean;
+}
+
+} // detail
+
+/**
+ * Inplace apply gain and offset correction, mask using nan with both threshold
+ * mask and an image mask, and calculate the nanmean of an array of images in a
+ * single sweep over the data.
+ *
+ * It is equivalent to calling correctImageData, maskImageDataNan and
+ * nanmeanImageArray in sequence, but the data are only streamed through
+ * memory once.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param gain: gain correction constants, which has the same shape as src.
+ *    An empty array means no gain correction.
+ * @param offset: offset correction constants, which has the same shape as src.
+ *    An empty array means no offset correction.
+ * @param mask: image mask. shape = (y, x). An empty array means no image mask.
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ * @return: the nanmean image. shape = (y, x)
+ */
+template <typename E, typename M, typename T,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false,
+  std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline auto correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const M& mask, T lb, T ub)
+{
+  return detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, {});
+}
+
+/**
+ * Inplace apply gain and offset correction, mask using nan with both threshold
+ * mask and an image mask, and calculate the nanmean of the selected images from
+ * an array of images in a single sweep over the data.
+ *
+ * Note: all the images are corrected and masked while only the selected ones
+ *       contribute to the nanmean.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param gain: gain correction constants, which has the same shape as src.
+ *    An empty array means no gain correction.
+ * @param offset: offset correction constants, which has the same shape as src.
+ *    An empty array means no offset correction.
+ * @param mask: image mask. shape = (y, x). An empty array means no image mask.
+ * @param lb: lower threshold
+ * @param ub: upper threshold
+ * @param keep: a list of selected indices.
+ * @return: the nanmean image. shape = (y, x)
+ */
+template <typename E, typename M, typename T,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false,
+  std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline auto correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const M& mask, T lb, T ub,
+                                         const std::vector<size_t>& keep)
+{
+  if (keep.empty()) throw std::invalid_argument("keep cannot be empty!");
+  return detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, keep);
+}
+
+/**
+ * Overload of correctMaskNanmeanImageArray with a bit-packed image mask.
+ *
+ * @param mask: bit-packed image mask. shape = (y, x). An empty mask means no image mask.
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImageArray> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline auto correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const BitMask& mask, T lb, T ub)
+{
+  return detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, {});
+}
+
+/**
+ * Overload of correctMaskNanmeanImageArray with a bit-packed image mask and
+ * a list of selected indices.
+ *
+ * @param mask: bit-packed image mask. shape = (y, x). An empty mask means no image mask.
+ */
+template <typename E, typename T,
+  EnableIf<E, IsImageArray> = false, std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline auto correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const BitMask& mask, T lb, T ub,
+                                         const std::vector<size_t>& keep)
+{
+  if (keep.empty()) throw std::invalid_argument("keep cannot be empty!");
+  return detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, keep);
+}
+
+/**
+ * Overload of correctMaskNanmeanImageArray which writes the nanmean to a
+ * pre-allocated image.
+ *
+ * @param out: the nanmean image. shape = (y, x)
+ */
+template <typename E, typename M, typename T, typename O,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false, EnableIf<O, IsImage> = false,
+  std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const M& mask, T lb, T ub,
+                                         O& out)
+{
+  FOAM_PROFILE_SCOPE("correctMaskNanmeanImageArray", profiler::nBytes(src));
+  detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, {}, out);
+}
+
+template <typename E, typename M, typename T, typename O,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false, EnableIf<O, IsImage> = false,
+  std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const M& mask, T lb, T ub,
+                                         const std::vector<size_t>& keep, O& out)
+{
+  FOAM_PROFILE_SCOPE("correctMaskNanmeanImageArray", profiler::nBytes(src));
+  if (keep.empty()) throw std::invalid_argument("keep cannot be empty!");
+  detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, keep, out);
+}
+
+template <typename E, typename T, typename O,
+  EnableIf<E, IsImageArray> = false, EnableIf<O, IsImage> = false,
+  std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const BitMask& mask, T lb, T ub,
+                                         O& out)
+{
+  FOAM_PROFILE_SCOPE("correctMaskNanmeanImageArray", profiler::nBytes(src));
+  detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, {}, out);
+}
+
+template <typename E, typename T, typename O,
+  EnableIf<E, IsImageArray> = false, EnableIf<O, IsImage> = false,
+  std::enable_if_t<std::is_arithmetic<T>::value, bool> = false>
+inline void correctMaskNanmeanImageArray(E& src, const E& gain, const E& offset, const BitMask& mask, T lb, T ub,
+                                         const std::vector<size_t>& keep, O& out)
+{
+  FOAM_PROFILE_SCOPE("correctMaskNanmeanImageArray", profiler::nBytes(src));
+  if (keep.empty()) throw std::invalid_argument("keep cannot be empty!");
+  detail::correctMaskNanmeanImageArrayDispatch(src, gain, offset, mask, lb, ub, keep, out);
+}
+
+/**
+ * Calculate the nanmeans of the on- and off-images from an array of images in
+ * a single sweep over the data.
+ *
+ * It is equivalent to calling nanmeanImageArray with the on- and off-indices
+ * separately, but each row of the images is only streamed through memory
+ * once. An image can be both on and off.
+ *
+ * @param src: image data. shape = (indices, y, x)
+ * @param on: indices of the on-images. An empty list leaves mean_on untouched.
+ * @param off: indices of the off-images. An empty list leaves mean_off untouched.
+ * @param mean_on: nanmean of the on-images. shape = (y, x)
+ * @param mean_off: nanmean of the off-images. shape = (y, x)
+ */
+template <typename E, typename O, EnableIf<E, IsImageArray> = false, EnableIf<O, IsImage> = false>
+inline void nanmeanOnOffImageArray(const E& src, const std::vector<size_t>& on, const std::vector<size_t>& off,
+                                   O& mean_on, O& mean_off)
+{
+  FOAM_PROFILE_SCOPE("nanmeanOnOffImageArray", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  auto shape = src.shape();
+  std::size_t n_pulses = shape[0];
+  std::size_t n_rows = shape[1];
+  std::size_t n_cols = shape[2];
+
+  bool with_on = !on.empty();
+  bool with_off = !off.empty();
+  if (with_on) checkShape(shape, mean_on.shape(), "Image and on-image have different shapes", 1);
+  if (with_off) checkShape(shape, mean_off.shape(), "Image and off-image have different shapes", 1);
+
+  // bit 0 for on and bit 1 for off
+  std::vector<char> tags(n_pulses, 0);
+  for (auto idx : on)
+  {
+    if (idx >= n_pulses) throw std::out_of_range("Index of the on-image is out of range!");
+    tags[idx] |= 1;
+  }
+  for (auto idx : off)
+  {
+    if (idx >= n_pulses) throw std::out_of_range("Index of the off-image is out of range!");
+    tags[idx] |= 2;
   }
+
+  auto nan = std::numeric_limits<value_type>::quiet_NaN();
+  auto sx = static_cast<std::ptrdiff_t>(src.strides()[2]);
+
+  detail::parallelForRows(n_rows, n_cols,
+    [&src, &tags, &mean_on, &mean_off, n_pulses, with_on, with_off, nan, sx]
+    (std::size_t j, std::size_t k0, std::size_t n)
+    {
+      PooledBuffer<value_type> sum_on(with_on ? n : 0, value_type(0));
+      PooledBuffer<value_type> count_on(with_on ? n : 0, value_type(0));
+      PooledBuffer<value_type> sum_off(with_off ? n : 0, value_type(0));
+      PooledBuffer<value_type> count_off(with_off ? n : 0, value_type(0));
+
+      for (std::size_t i = 0; i < n_pulses; ++i)
+      {
+        if (tags[i] == 0) continue;
+        auto p = &src(i, j, k0);
+        if (tags[i] & 1) detail::nanSumCount(p, sx, n, sum_on.data(), count_on.data());
+        if (tags[i] & 2) detail::nanSumCount(p, sx, n, sum_off.data(), count_off.data());
+      }
+
+      for (std::size_t l = 0; l < n; ++l)
+      {
+        if (with_on) mean_on(j, k0 + l) = count_on[l] == 0 ? nan : sum_on[l] / count_on[l];
+        if (with_off) mean_off(j, k0 + l) = count_off[l] == 0 ? nan : sum_off[l] / count_off[l];
+      }
+    }
+  );
 }
 
 } // foam
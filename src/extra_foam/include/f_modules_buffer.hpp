@@ -0,0 +1,255 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_MODULES_BUFFER_H
+#define EXTRA_FOAM_MODULES_BUFFER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <array>
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include "f_traits.hpp"
+#include "f_parallel.hpp"
+
+
+namespace foam
+{
+
+/**
+ * Persistent buffer of multi-pulse, multiple-module data.
+ *
+ * The data of each module is copied straight from the received payload,
+ * which can have any strides (e.g. (x, y, memory cells) on the bridge), into
+ * an aligned C-contiguous array with shape (memory cells, modules, y, x).
+ * The memory is only reallocated when the number of memory cells exceeds
+ * the capacity, so that it is reused train after train.
+ */
+template<typename T>
+class ModulesBuffer
+{
+public:
+
+  using value_type = T;
+  using shape_type = std::array<std::size_t, 4>;
+
+  static constexpr std::size_t alignment = 64;
+
+  /**
+   * Constructor.
+   *
+   * @param n_modules: number of modules.
+   * @param ny: number of rows of a module.
+   * @param nx: number of columns of a module.
+   * @param pin: true for locking the memory in RAM, so that it will not be
+   *             paged out. It is silently ignored if the lock fails.
+   */
+  ModulesBuffer(std::size_t n_modules, std::size_t ny, std::size_t nx, bool pin = false)
+    : shape_{{0, n_modules, ny, nx}}, arrived_(n_modules, 0), pin_(pin)
+  {
+    if (n_modules == 0 || ny == 0 || nx == 0)
+      throw std::invalid_argument("Number of modules and module shape must be positive!");
+  }
+
+  ~ModulesBuffer() { deallocate(); }
+
+  ModulesBuffer(const ModulesBuffer&) = delete;
+  ModulesBuffer& operator=(const ModulesBuffer&) = delete;
+
+  /**
+   * Prepare the buffer for a new train.
+   *
+   * The data of the previous train is not cleared.
+   *
+   * @param n_pulses: number of memory cells of the new train.
+   */
+  void reset(std::size_t n_pulses)
+  {
+    if (n_pulses > capacity_)
+    {
+      deallocate();
+      allocate(n_pulses);
+    }
+    shape_[0] = n_pulses;
+    std::fill(arrived_.begin(), arrived_.end(), 0);
+  }
+
+  /**
+   * Copy the data of a module into the buffer.
+   *
+   * Modules with different indices can be copied concurrently.
+   *
+   * @param im: index of the module.
+   * @param src: pointer to the first pixel of the module data.
+   * @param strides: strides (memory cells, y, x) of the module data in elements.
+   */
+  template<typename U>
+  void setModule(std::size_t im, const U* src, const std::array<std::ptrdiff_t, 3>& strides)
+  {
+    checkModuleIndex(im);
+
+    std::size_t n_pulses = shape_[0];
+    std::size_t ny = shape_[2];
+    std::size_t nx = shape_[3];
+    T* dst = data_;
+    auto row = [=] (std::size_t ip, std::size_t j)
+    {
+      const U* s = src + static_cast<std::ptrdiff_t>(ip) * strides[0] + static_cast<std::ptrdiff_t>(j) * strides[1];
+      T* d = dst + ((ip * shape_[1] + im) * ny + j) * nx;
+      if (strides[2] == 1)
+      {
+        for (std::size_t k = 0; k < nx; ++k) d[k] = static_cast<T>(s[k]);
+      } else
+      {
+        for (std::size_t k = 0; k < nx; ++k) d[k] = static_cast<T>(s[static_cast<std::ptrdiff_t>(k) * strides[2]]);
+      }
+    };
+
+    // Iterate the memory cells in the inner loop. If the memory cells are
+    // the fastest axis of the source, the cache lines of a row are then
+    // reused by the following memory cells.
+    detail::parallelFor(ny * n_pulses, [&row, n_pulses] (std::size_t begin, std::size_t end)
+    {
+      for (std::size_t idx = begin; idx != end; ++idx) row(idx % n_pulses, idx / n_pulses);
+    });
+
+    arrived_[im] = 1;
+  }
+
+  /**
+   * Copy the data of a module into the buffer.
+   *
+   * @param im: index of the module.
+   * @param src: module data. shape = (memory cells, y, x)
+   */
+  template<typename E, EnableIf<E, IsImageArray> = false>
+  void setModule(std::size_t im, const E& src)
+  {
+    auto ss = src.shape();
+    if (ss[0] != shape_[0] || ss[1] != shape_[2] || ss[2] != shape_[3])
+    {
+      std::stringstream fmt;
+      fmt << "Expected module data with shape (" << shape_[0] << ", " << shape_[2] << ", " << shape_[3]
+          << "), got (" << ss[0] << ", " << ss[1] << ", " << ss[2] << ")";
+      throw std::invalid_argument(fmt.str());
+    }
+
+    auto st = src.strides();
+    setModule(im, src.data() + src.data_offset(),
+              {static_cast<std::ptrdiff_t>(st[0]), static_cast<std::ptrdiff_t>(st[1]),
+               static_cast<std::ptrdiff_t>(st[2])});
+  }
+
+  /**
+   * Fill the modules which have not arrived since the last reset.
+   */
+  void fillMissing(T value)
+  {
+    std::size_t module_size = shape_[2] * shape_[3];
+    for (std::size_t ip = 0; ip < shape_[0]; ++ip)
+    {
+      for (std::size_t im = 0; im < shape_[1]; ++im)
+      {
+        if (!arrived_[im])
+        {
+          T* d = data_ + (ip * shape_[1] + im) * module_size;
+          std::fill(d, d + module_size, value);
+        }
+      }
+    }
+  }
+
+  bool arrived(std::size_t im) const
+  {
+    checkModuleIndex(im);
+    return arrived_[im] != 0;
+  }
+
+  /**
+   * Number of modules which have arrived since the last reset.
+   */
+  std::size_t nArrived() const
+  {
+    return static_cast<std::size_t>(std::count(arrived_.begin(), arrived_.end(), 1));
+  }
+
+  bool complete() const { return nArrived() == shape_[1]; }
+
+  /**
+   * Shape (memory cells, modules, y, x) of the buffer.
+   */
+  const shape_type& shape() const { return shape_; }
+
+  /**
+   * Number of memory cells which can be held without reallocation.
+   */
+  std::size_t capacity() const { return capacity_; }
+
+  bool pinned() const { return pinned_; }
+
+  T* data() { return data_; }
+
+  const T* data() const { return data_; }
+
+private:
+
+  void checkModuleIndex(std::size_t im) const
+  {
+    if (im >= shape_[1])
+    {
+      std::stringstream fmt;
+      fmt << "Module index " << im << " is out of range [0, " << shape_[1] << ")";
+      throw std::out_of_range(fmt.str());
+    }
+  }
+
+  void allocate(std::size_t n_pulses)
+  {
+    nbytes_ = n_pulses * shape_[1] * shape_[2] * shape_[3] * sizeof(T);
+    // round up to a multiple of the alignment
+    nbytes_ = (nbytes_ + alignment - 1) / alignment * alignment;
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, nbytes_) != 0) throw std::bad_alloc();
+    data_ = static_cast<T*>(ptr);
+    capacity_ = n_pulses;
+    if (pin_) pinned_ = (mlock(ptr, nbytes_) == 0);
+  }
+
+  void deallocate()
+  {
+    if (data_ == nullptr) return;
+    if (pinned_) munlock(data_, nbytes_);
+    std::free(data_);
+    data_ = nullptr;
+    nbytes_ = 0;
+    capacity_ = 0;
+    pinned_ = false;
+  }
+
+  shape_type shape_;
+  std::vector<uint8_t> arrived_;
+  T* data_ = nullptr;
+  std::size_t nbytes_ = 0;
+  std::size_t capacity_ = 0;
+  bool pin_;
+  bool pinned_ = false;
+};
+
+template<typename T>
+constexpr std::size_t ModulesBuffer<T>::alignment;
+
+} // foam
+
+#endif //EXTRA_FOAM_MODULES_BUFFER_H
@@ -0,0 +1,613 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_F_PARALLEL_HPP
+#define EXTRA_FOAM_F_PARALLEL_HPP
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "f_profiler.hpp"
+
+#if defined(FOAM_WITH_TBB)
+#include "tbb/info.h"
+#include "tbb/task_arena.h"
+#include "tbb/task_group.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_reduce.h"
+#include "tbb/partitioner.h"
+#include "tbb/blocked_range.h"
+#include "tbb/blocked_range2d.h"
+#include "tbb/blocked_range3d.h"
+#endif
+
+
+namespace foam
+{
+
+/**
+ * How the work of a parallel kernel is split into tasks.
+ *
+ * BLOCKED: split all the dimensions including the innermost (x) one.
+ * ROW: split only over the outer dimensions (pulses/modules/rows), so that
+ *      each row is processed as a whole by a flat loop.
+ */
+enum class PartitionMode
+{
+  BLOCKED,
+  ROW
+};
+
+inline PartitionMode toPartitionMode(const std::string& mode)
+{
+  if (mode == "row") return PartitionMode::ROW;
+  if (mode == "blocked") return PartitionMode::BLOCKED;
+  throw std::invalid_argument("Unknown partition mode: " + mode);
+}
+
+inline std::string toString(PartitionMode mode)
+{
+  return mode == PartitionMode::ROW ? "row" : "blocked";
+}
+
+struct PartitionConfig
+{
+  PartitionMode mode = PartitionMode::ROW;
+  // minimum number of items (images, rows, ...) per task
+  std::size_t grain_size = 1;
+  // reuse the affinity of the previous call of the same kernel, so that the
+  // same cores touch the same part of the data train after train
+  bool affinity = true;
+  // split the pulses over the NUMA nodes and process the pulses of each node
+  // in a task arena pinned to it
+  bool numa = false;
+};
+
+namespace detail
+{
+
+// The config is a function-local static of an inline function, so each
+// shared library (e.g. each Python extension module) has its own copy.
+inline PartitionConfig& globalPartitionConfig()
+{
+  static PartitionConfig config;
+  return config;
+}
+
+inline const PartitionConfig*& scopedPartitionConfig()
+{
+  static thread_local const PartitionConfig* config = nullptr;
+  return config;
+}
+
+} // detail
+
+/**
+ * Set the global partition config which is used by all the parallel kernels
+ * of the calling shared library.
+ *
+ * Other shared libraries which include this header keep their own config,
+ * i.e. the config must be set in each Python extension module. This is done
+ * by extra_foam.algorithms.set_partition_config.
+ */
+inline void setPartitionConfig(const PartitionConfig& config)
+{
+  if (config.grain_size == 0) throw std::invalid_argument("Grain size must be positive!");
+  detail::globalPartitionConfig() = config;
+}
+
+/**
+ * Get the partition config in use for the calling thread.
+ */
+inline const PartitionConfig& partitionConfig()
+{
+  auto scoped = detail::scopedPartitionConfig();
+  if (scoped != nullptr) return *scoped;
+  return detail::globalPartitionConfig();
+}
+
+/**
+ * Override the partition config for the kernels called by the current thread
+ * within the lifetime of the object.
+ */
+class ScopedPartitionConfig
+{
+  PartitionConfig config_;
+  const PartitionConfig* prev_;
+
+public:
+
+  explicit ScopedPartitionConfig(const PartitionConfig& config)
+    : config_(config), prev_(detail::scopedPartitionConfig())
+  {
+    if (config_.grain_size == 0) throw std::invalid_argument("Grain size must be positive!");
+    detail::scopedPartitionConfig() = &config_;
+  }
+
+  ~ScopedPartitionConfig() { detail::scopedPartitionConfig() = prev_; }
+
+  ScopedPartitionConfig(const ScopedPartitionConfig&) = delete;
+  ScopedPartitionConfig& operator=(const ScopedPartitionConfig&) = delete;
+};
+
+namespace detail
+{
+
+#if defined(FOAM_WITH_TBB)
+
+/**
+ * Task arenas pinned to the NUMA nodes of the machine.
+ *
+ * Without the topology information (e.g. TBB is built without hwloc),
+ * there is only one arena.
+ */
+class NumaArenas
+{
+public:
+
+  static NumaArenas& instance()
+  {
+    static NumaArenas arenas;
+    return arenas;
+  }
+
+  std::size_t size() const { return arenas_.size(); }
+
+  tbb::task_arena& operator[](std::size_t node) { return *arenas_[node]; }
+
+  /**
+   * Replace the arenas with n_nodes arenas which are not pinned, e.g. to
+   * emulate a multi-socket machine in tests.
+   *
+   * It must not be called while any kernel is running.
+   *
+   * @param max_concurrency: max concurrency of each arena.
+   */
+  void emulate(std::size_t n_nodes, int max_concurrency = tbb::task_arena::automatic)
+  {
+    if (n_nodes == 0) throw std::invalid_argument("Number of NUMA nodes must be positive!");
+    arenas_.clear();
+    for (std::size_t i = 0; i < n_nodes; ++i) arenas_.emplace_back(new tbb::task_arena(max_concurrency));
+  }
+
+  /**
+   * Restore the arenas pinned to the NUMA nodes.
+   */
+  void reset()
+  {
+    arenas_.clear();
+    for (auto id : tbb::info::numa_nodes())
+    {
+      arenas_.emplace_back(new tbb::task_arena(tbb::task_arena::constraints(id)));
+    }
+  }
+
+private:
+
+  NumaArenas() { reset(); }
+
+  std::vector<std::unique_ptr<tbb::task_arena>> arenas_;
+};
+
+// whether the calling thread is processing the pulses of a NUMA node
+inline bool& insideNumaNode()
+{
+  static thread_local bool inside = false;
+  return inside;
+}
+
+#endif
+
+} // detail
+
+/**
+ * Number of NUMA nodes which the pulses are split over in the NUMA mode.
+ */
+inline std::size_t numaNodeCount()
+{
+#if defined(FOAM_WITH_TBB)
+  return detail::NumaArenas::instance().size();
+#else
+  return 1;
+#endif
+}
+
+namespace detail
+{
+
+/**
+ * Range of the items (e.g. pulses) owned by a NUMA node.
+ *
+ * The items are split into contiguous blocks of nearly equal sizes. The
+ * mapping only depends on the numbers of items and nodes, so that all the
+ * kernels assign a pulse to the same node.
+ */
+inline std::pair<std::size_t, std::size_t> numaRange(std::size_t n, std::size_t n_nodes, std::size_t node)
+{
+  return {n * node / n_nodes, n * (node + 1) / n_nodes};
+}
+
+/**
+ * Whether the kernels called by the current thread split the pulses over
+ * the NUMA nodes.
+ */
+inline bool numaActive()
+{
+#if defined(FOAM_WITH_TBB)
+  return partitionConfig().numa && ! insideNumaNode() && numaNodeCount() > 1;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Apply a function to the ranges of [0, n) owned by the NUMA nodes.
+ *
+ * In the NUMA mode, the ranges are processed concurrently, each in the task
+ * arena of its node. The parallel kernels called by the function run in
+ * the same arena and do not split the range further over the nodes.
+ * Otherwise, the function is called once with the whole range.
+ *
+ * @param n: number of items.
+ * @param f: function with signature f(node, begin, end).
+ */
+template<typename F>
+inline void forEachNumaNode(std::size_t n, F&& f)
+{
+#if defined(FOAM_WITH_TBB)
+  if (numaActive())
+  {
+    auto& arenas = NumaArenas::instance();
+    std::size_t n_nodes = arenas.size();
+    std::unique_ptr<tbb::task_group[]> groups(new tbb::task_group[n_nodes]);
+    // The config in use, which can be a scoped one of the calling thread, is
+    // re-installed on the arena threads which process the nodes.
+    const PartitionConfig config = partitionConfig();
+
+    for (std::size_t node = 0; node < n_nodes; ++node)
+    {
+      auto range = numaRange(n, n_nodes, node);
+      if (range.first == range.second) continue;
+      auto& group = groups[node];
+      arenas[node].execute([&group, &f, &config, node, range]
+      {
+        group.run([&f, &config, node, range]
+        {
+          ScopedPartitionConfig scoped(config);
+          auto& inside = insideNumaNode();
+          bool prev = inside;
+          inside = true;
+          try
+          {
+            f(node, range.first, range.second);
+          } catch (...)
+          {
+            inside = prev;
+            throw;
+          }
+          inside = prev;
+        });
+      });
+    }
+
+    // all the groups must be waited for even if one of them fails
+    std::exception_ptr error;
+    for (std::size_t node = 0; node < n_nodes; ++node)
+    {
+      auto& group = groups[node];
+      try
+      {
+        arenas[node].execute([&group] { group.wait(); });
+      } catch (...)
+      {
+        if (! error) error = std::current_exception();
+      }
+    }
+    if (error) std::rethrow_exception(error);
+    return;
+  }
+#endif
+
+  f(std::size_t(0), std::size_t(0), n);
+}
+
+#if defined(FOAM_WITH_TBB)
+
+/**
+ * Run tbb::parallel_for with either the given affinity partitioner or the
+ * auto partitioner.
+ *
+ * The affinity partitioner must be owned by the call site (one per kernel)
+ * since the recorded affinity is only meaningful for the same iteration space.
+ *
+ * Each execution of the body is counted as a task by the profiler.
+ */
+template<typename Range, typename Body>
+inline void tbbParallelFor(const Range& range, const Body& body, tbb::affinity_partitioner& ap, bool affinity)
+{
+  auto task = [&body] (const Range& block)
+  {
+    profiler::countTask();
+    body(block);
+  };
+  if (affinity) tbb::parallel_for(range, task, ap);
+  else tbb::parallel_for(range, task, tbb::auto_partitioner());
+}
+
+#endif
+
+/**
+ * Apply a function to the sub-ranges of [0, n) in parallel.
+ *
+ * @param n: number of items.
+ * @param f: function with signature f(begin, end).
+ */
+template<typename F>
+inline void parallelFor(std::size_t n, F&& f)
+{
+  if (n == 0) return;
+
+#if defined(FOAM_WITH_TBB)
+  static thread_local tbb::affinity_partitioner ap;
+  const auto& config = partitionConfig();
+
+  tbbParallelFor(tbb::blocked_range<std::size_t>(0, n, config.grain_size),
+    [&f] (const tbb::blocked_range<std::size_t> &block)
+    {
+      f(block.begin(), block.end());
+    },
+    ap, config.affinity
+  );
+#else
+  f(0, n);
+#endif
+}
+
+/**
+ * Reduce the sub-ranges of [0, n) in parallel.
+ *
+ * The order of joining the partial results is not deterministic.
+ *
+ * @param n: number of items.
+ * @param identity: identity value of the reduction.
+ * @param f: function with signature V f(begin, end, V init), which reduces
+ *           [begin, end) onto init.
+ * @param join: function with signature V join(V, V).
+ */
+template<typename V, typename F, typename J>
+inline V parallelReduce(std::size_t n, const V& identity, F&& f, J&& join)
+{
+  if (n == 0) return identity;
+
+#if defined(FOAM_WITH_TBB)
+  static thread_local tbb::affinity_partitioner ap;
+  const auto& config = partitionConfig();
+
+  tbb::blocked_range<std::size_t> range(0, n, config.grain_size);
+  auto body = [&f] (const tbb::blocked_range<std::size_t> &block, V init)
+  {
+    profiler::countTask();
+    return f(block.begin(), block.end(), init);
+  };
+  if (config.affinity) return tbb::parallel_reduce(range, identity, body, join, ap);
+  return tbb::parallel_reduce(range, identity, body, join, tbb::auto_partitioner());
+#else
+  return f(0, n, identity);
+#endif
+}
+
+/**
+ * Apply a function to the row segments of an image in parallel.
+ *
+ * @param n_rows: number of rows (y).
+ * @param n_cols: number of columns (x).
+ * @param f: function with signature f(j, k0, n), which processes the
+ *           row segment [k0, k0 + n) of the j-th row.
+ */
+template<typename F>
+inline void parallelForRows(std::size_t n_rows, std::size_t n_cols, F&& f)
+{
+  if (n_rows == 0 || n_cols == 0) return;
+
+#if defined(FOAM_WITH_TBB)
+  const auto& config = partitionConfig();
+
+  if (config.mode == PartitionMode::ROW)
+  {
+    static thread_local tbb::affinity_partitioner ap;
+    tbbParallelFor(tbb::blocked_range<std::size_t>(0, n_rows, config.grain_size),
+      [&f, n_cols] (const tbb::blocked_range<std::size_t> &block)
+      {
+        for (std::size_t j = block.begin(); j != block.end(); ++j) f(j, 0, n_cols);
+      },
+      ap, config.affinity
+    );
+  } else
+  {
+    static thread_local tbb::affinity_partitioner ap;
+    tbbParallelFor(tbb::blocked_range2d<std::size_t>(0, n_rows, config.grain_size, 0, n_cols, 1),
+      [&f] (const tbb::blocked_range2d<std::size_t> &block)
+      {
+        std::size_t k0 = block.cols().begin();
+        std::size_t n = block.cols().size();
+        for (std::size_t j = block.rows().begin(); j != block.rows().end(); ++j) f(j, k0, n);
+      },
+      ap, config.affinity
+    );
+  }
+#else
+  for (std::size_t j = 0; j < n_rows; ++j) f(j, 0, n_cols);
+#endif
+}
+
+template<typename F>
+inline void parallelForImageRowsImp(std::size_t n_images, std::size_t n_rows, std::size_t n_cols, F&& f)
+{
+#if defined(FOAM_WITH_TBB)
+  const auto& config = partitionConfig();
+
+  if (config.mode == PartitionMode::ROW)
+  {
+    // flatten (images, rows) so that the work is well balanced even when
+    // there are fewer images than cores
+    static thread_local tbb::affinity_partitioner ap;
+    tbbParallelFor(tbb::blocked_range<std::size_t>(0, n_images * n_rows, config.grain_size),
+      [&f, n_rows, n_cols] (const tbb::blocked_range<std::size_t> &block)
+      {
+        for (std::size_t idx = block.begin(); idx != block.end(); ++idx)
+        {
+          f(idx / n_rows, idx % n_rows, 0, n_cols);
+        }
+      },
+      ap, config.affinity
+    );
+  } else
+  {
+    static thread_local tbb::affinity_partitioner ap;
+    tbbParallelFor(tbb::blocked_range3d<std::size_t>(0, n_images, config.grain_size,
+                                                     0, n_rows, config.grain_size,
+                                                     0, n_cols, 1),
+      [&f] (const tbb::blocked_range3d<std::size_t> &block)
+      {
+        std::size_t k0 = block.cols().begin();
+        std::size_t n = block.cols().size();
+        for (std::size_t i = block.pages().begin(); i != block.pages().end(); ++i)
+        {
+          for (std::size_t j = block.rows().begin(); j != block.rows().end(); ++j)
+          {
+            f(i, j, k0, n);
+          }
+        }
+      },
+      ap, config.affinity
+    );
+  }
+#else
+  for (std::size_t i = 0; i < n_images; ++i)
+  {
+    for (std::size_t j = 0; j < n_rows; ++j)
+    {
+      f(i, j, 0, n_cols);
+    }
+  }
+#endif
+}
+
+/**
+ * Apply a function to the row segments of an array of images in parallel.
+ *
+ * In the NUMA mode, the images are first split over the NUMA nodes.
+ *
+ * @param n_images: number of images.
+ * @param n_rows: number of rows (y) of each image.
+ * @param n_cols: number of columns (x) of each image.
+ * @param f: function with signature f(i, j, k0, n), which processes the
+ *           row segment [k0, k0 + n) of the j-th row of the i-th image.
+ */
+template<typename F>
+inline void parallelForImageRows(std::size_t n_images, std::size_t n_rows, std::size_t n_cols, F&& f)
+{
+  if (n_images == 0 || n_rows == 0 || n_cols == 0) return;
+
+  if (numaActive())
+  {
+    forEachNumaNode(n_images, [&f, n_rows, n_cols] (std::size_t, std::size_t begin, std::size_t end)
+    {
+      parallelForImageRowsImp(end - begin, n_rows, n_cols,
+        [&f, begin] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n) { f(begin + i, j, k0, n); }
+      );
+    });
+  } else
+  {
+    parallelForImageRowsImp(n_images, n_rows, n_cols, f);
+  }
+}
+
+template<typename F>
+inline void parallelForPulsesModulesImp(std::size_t n_pulses, std::size_t n_modules, F&& f)
+{
+#if defined(FOAM_WITH_TBB)
+  const auto& config = partitionConfig();
+
+  if (config.mode == PartitionMode::ROW)
+  {
+    static thread_local tbb::affinity_partitioner ap;
+    tbbParallelFor(tbb::blocked_range<std::size_t>(0, n_pulses, config.grain_size),
+      [&f, n_modules] (const tbb::blocked_range<std::size_t> &block)
+      {
+        for (std::size_t ip = block.begin(); ip != block.end(); ++ip)
+        {
+          for (std::size_t im = 0; im < n_modules; ++im) f(ip, im);
+        }
+      },
+      ap, config.affinity
+    );
+  } else
+  {
+    static thread_local tbb::affinity_partitioner ap;
+    tbbParallelFor(tbb::blocked_range2d<std::size_t>(0, n_modules, 1, 0, n_pulses, config.grain_size),
+      [&f] (const tbb::blocked_range2d<std::size_t> &block)
+      {
+        for (std::size_t im = block.rows().begin(); im != block.rows().end(); ++im)
+        {
+          for (std::size_t ip = block.cols().begin(); ip != block.cols().end(); ++ip) f(ip, im);
+        }
+      },
+      ap, config.affinity
+    );
+  }
+#else
+  for (std::size_t im = 0; im < n_modules; ++im)
+  {
+    for (std::size_t ip = 0; ip < n_pulses; ++ip) f(ip, im);
+  }
+#endif
+}
+
+/**
+ * Apply a function to each (pulse, module) pair of a modular detector in
+ * parallel.
+ *
+ * In ROW mode, only the pulses are split so that each pulse is assembled by
+ * a single task.
+ * In the NUMA mode, the pulses are first split over the NUMA nodes.
+ *
+ * @param n_pulses: number of pulses.
+ * @param n_modules: number of modules.
+ * @param f: function with signature f(ip, im).
+ */
+template<typename F>
+inline void parallelForPulsesModules(std::size_t n_pulses, std::size_t n_modules, F&& f)
+{
+  if (n_pulses == 0 || n_modules == 0) return;
+
+  if (numaActive())
+  {
+    forEachNumaNode(n_pulses, [&f, n_modules] (std::size_t, std::size_t begin, std::size_t end)
+    {
+      parallelForPulsesModulesImp(end - begin, n_modules,
+        [&f, begin] (std::size_t ip, std::size_t im) { f(begin + ip, im); }
+      );
+    });
+  } else
+  {
+    parallelForPulsesModulesImp(n_pulses, n_modules, f);
+  }
+}
+
+} // detail
+
+} // foam
+
+#endif //EXTRA_FOAM_F_PARALLEL_HPP
@@ -0,0 +1,423 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_F_PROFILER_HPP
+#define EXTRA_FOAM_F_PROFILER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace foam
+{
+namespace profiler
+{
+
+/**
+ * Histogram of latencies in nanoseconds with logarithmic buckets.
+ *
+ * Each power of two is split into 8 linear buckets, so that a quantile is
+ * accurate within 1/16 of its value.
+ */
+class LatencyHistogram
+{
+public:
+
+  static constexpr std::size_t kSubBuckets = 8;
+  static constexpr std::size_t kNumBuckets = kSubBuckets + (64 - 3) * kSubBuckets;
+
+  static std::size_t bucket(uint64_t v)
+  {
+    if (v < kSubBuckets) return static_cast<std::size_t>(v);
+
+    std::size_t e = 63;
+    while (! (v >> e)) --e;
+    // e >= 3, i.e. the 4 most significant bits determine the bucket
+    return kSubBuckets + (e - 3) * kSubBuckets + static_cast<std::size_t>((v >> (e - 3)) & (kSubBuckets - 1));
+  }
+
+  static uint64_t lowerBound(std::size_t idx)
+  {
+    if (idx < kSubBuckets) return idx;
+    std::size_t e = (idx - kSubBuckets) / kSubBuckets + 3;
+    uint64_t sub = (idx - kSubBuckets) % kSubBuckets;
+    return (kSubBuckets + sub) << (e - 3);
+  }
+
+  static uint64_t upperBound(std::size_t idx)
+  {
+    if (idx < kSubBuckets) return idx + 1;
+    std::size_t e = (idx - kSubBuckets) / kSubBuckets + 3;
+    uint64_t sub = (idx - kSubBuckets) % kSubBuckets;
+    return (kSubBuckets + sub + 1) << (e - 3);
+  }
+
+  void add(uint64_t v)
+  {
+    ++counts_[bucket(v)];
+    ++count_;
+    if (v > max_) max_ = v;
+  }
+
+  /**
+   * Return the q-th quantile, which is the center of the bucket it falls
+   * in, or the maximum if that is smaller.
+   *
+   * @param q: quantile in [0, 1].
+   */
+  double quantile(double q) const
+  {
+    if (count_ == 0) return 0.;
+
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1)) + 1;
+    uint64_t n = 0;
+    for (std::size_t i = 0; i < kNumBuckets; ++i)
+    {
+      n += counts_[i];
+      if (n >= rank)
+      {
+        double center = 0.5 * static_cast<double>(lowerBound(i) + upperBound(i) - 1);
+        return std::min(center, static_cast<double>(max_));
+      }
+    }
+    return static_cast<double>(max_);
+  }
+
+  uint64_t count() const { return count_; }
+
+  uint64_t max() const { return max_; }
+
+private:
+
+  std::array<uint64_t, kNumBuckets> counts_ {};
+  uint64_t count_ = 0;
+  uint64_t max_ = 0;
+};
+
+/**
+ * Aggregated statistics of an instrumented stage.
+ */
+struct StageStats
+{
+  std::string name;
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+  uint64_t bytes = 0;
+  uint64_t tasks = 0;
+  uint64_t allocations = 0;
+  LatencyHistogram latency;
+};
+
+namespace detail
+{
+
+// number of samples buffered per thread before they are collected
+constexpr std::size_t kRingSize = 1024;
+
+/**
+ * A sample recorded by a scoped timer.
+ *
+ * The fields are atomic since a slot can be overwritten by the owning
+ * thread while it is being read by the collector.
+ */
+struct Sample
+{
+  std::atomic<uint64_t> stage {0};
+  std::atomic<uint64_t> ns {0};
+  std::atomic<uint64_t> bytes {0};
+  std::atomic<uint64_t> tasks {0};
+  std::atomic<uint64_t> allocations {0};
+};
+
+/**
+ * Single-producer single-consumer ring buffer of samples.
+ *
+ * Only the owning thread writes and only the collector, which holds the
+ * mutex of the registry, reads. When the writer laps the reader the oldest
+ * samples are dropped.
+ */
+struct ThreadBuffer
+{
+  std::array<Sample, kRingSize> samples;
+  std::atomic<uint64_t> head {0}; // number of samples written
+  uint64_t tail = 0; // number of samples consumed by the collector
+  std::atomic<bool> in_use {true};
+
+  void push(uint64_t stage, uint64_t ns, uint64_t bytes, uint64_t tasks, uint64_t allocations)
+  {
+    uint64_t idx = head.load(std::memory_order_relaxed);
+    auto& s = samples[idx % kRingSize];
+    s.stage.store(stage, std::memory_order_relaxed);
+    s.ns.store(ns, std::memory_order_relaxed);
+    s.bytes.store(bytes, std::memory_order_relaxed);
+    s.tasks.store(tasks, std::memory_order_relaxed);
+    s.allocations.store(allocations, std::memory_order_relaxed);
+    head.store(idx + 1, std::memory_order_release);
+  }
+};
+
+} // detail
+
+/**
+ * Registry of the instrumented stages and the per-thread sample buffers.
+ *
+ * Recording a sample is lock-free. The mutex is only taken when a stage or
+ * a thread is seen for the first time and when the samples are collected.
+ *
+ * Note: each extension module has its own registry.
+ */
+class Registry
+{
+public:
+
+  static Registry& instance()
+  {
+    static Registry registry;
+    return registry;
+  }
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  void setEnabled(bool value) { enabled_.store(value, std::memory_order_relaxed); }
+
+  /**
+   * Return the ID of a stage, which is registered if it does not exist.
+   */
+  std::size_t stageId(const std::string& name)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (std::size_t i = 0; i < stats_.size(); ++i)
+    {
+      if (stats_[i].name == name) return i;
+    }
+    stats_.emplace_back();
+    stats_.back().name = name;
+    return stats_.size() - 1;
+  }
+
+  void countTask() { if (enabled()) n_tasks_.fetch_add(1, std::memory_order_relaxed); }
+
+  void countAllocation() { if (enabled()) n_allocations_.fetch_add(1, std::memory_order_relaxed); }
+
+  uint64_t nTasks() const { return n_tasks_.load(std::memory_order_relaxed); }
+
+  uint64_t nAllocations() const { return n_allocations_.load(std::memory_order_relaxed); }
+
+  void record(std::size_t stage, uint64_t ns, uint64_t bytes, uint64_t tasks, uint64_t allocations)
+  {
+    threadBuffer().push(stage, ns, bytes, tasks, allocations);
+  }
+
+  /**
+   * Move the buffered samples into the aggregated statistics and return a
+   * copy of the latter.
+   *
+   * @param reset: true for clearing the aggregated statistics afterwards,
+   *               so that each sample is returned exactly once.
+   */
+  std::vector<StageStats> collect(bool reset = false)
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto& buf : buffers_) drain(*buf);
+    auto stats = stats_;
+    if (reset) clearStats();
+    return stats;
+  }
+
+  /**
+   * Discard the buffered samples and the aggregated statistics.
+   */
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto& buf : buffers_) buf->tail = buf->head.load(std::memory_order_acquire);
+    clearStats();
+  }
+
+  /**
+   * Number of samples dropped because the collector did not keep up.
+   */
+  uint64_t nDropped()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return n_dropped_;
+  }
+
+private:
+
+  Registry() = default;
+
+  struct ThreadHandle
+  {
+    detail::ThreadBuffer* buffer = nullptr;
+
+    ~ThreadHandle() { if (buffer != nullptr) buffer->in_use.store(false, std::memory_order_release); }
+  };
+
+  detail::ThreadBuffer& threadBuffer()
+  {
+    static thread_local ThreadHandle handle;
+    if (handle.buffer == nullptr) handle.buffer = acquireBuffer();
+    return *handle.buffer;
+  }
+
+  detail::ThreadBuffer* acquireBuffer()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    // reuse the buffer of a finished thread after collecting its samples
+    for (auto& buf : buffers_)
+    {
+      if (! buf->in_use.load(std::memory_order_acquire))
+      {
+        drain(*buf);
+        buf->in_use.store(true, std::memory_order_relaxed);
+        return buf.get();
+      }
+    }
+    buffers_.emplace_back(new detail::ThreadBuffer);
+    return buffers_.back().get();
+  }
+
+  void clearStats()
+  {
+    for (auto& s : stats_)
+    {
+      std::string name = std::move(s.name);
+      s = StageStats();
+      s.name = std::move(name);
+    }
+    n_dropped_ = 0;
+  }
+
+  void drain(detail::ThreadBuffer& buf)
+  {
+    uint64_t head = buf.head.load(std::memory_order_acquire);
+    // the slot of the oldest sample is the next one to be written, so at
+    // most kRingSize - 1 samples can be read safely
+    if (head - buf.tail >= detail::kRingSize)
+    {
+      n_dropped_ += head - buf.tail - (detail::kRingSize - 1);
+      buf.tail = head - (detail::kRingSize - 1);
+    }
+
+    for (uint64_t idx = buf.tail; idx < head; ++idx)
+    {
+      const auto& s = buf.samples[idx % detail::kRingSize];
+      auto stage = s.stage.load(std::memory_order_relaxed);
+      auto ns = s.ns.load(std::memory_order_relaxed);
+      auto bytes = s.bytes.load(std::memory_order_relaxed);
+      auto tasks = s.tasks.load(std::memory_order_relaxed);
+      auto allocations = s.allocations.load(std::memory_order_relaxed);
+
+      // discard the sample if the slot has been reused while reading it
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (buf.head.load(std::memory_order_relaxed) - idx >= detail::kRingSize)
+      {
+        ++n_dropped_;
+        continue;
+      }
+
+      if (stage >= stats_.size()) continue;
+      auto& st = stats_[stage];
+      ++st.count;
+      st.total_ns += ns;
+      st.bytes += bytes;
+      st.tasks += tasks;
+      st.allocations += allocations;
+      st.latency.add(ns);
+    }
+    buf.tail = head;
+  }
+
+  std::atomic<bool> enabled_ {false};
+  std::atomic<uint64_t> n_tasks_ {0};
+  std::atomic<uint64_t> n_allocations_ {0};
+
+  std::mutex mtx_;
+  std::vector<StageStats> stats_;
+  std::vector<std::unique_ptr<detail::ThreadBuffer>> buffers_;
+  uint64_t n_dropped_ = 0;
+};
+
+inline void countTask() { Registry::instance().countTask(); }
+
+inline void countAllocation() { Registry::instance().countAllocation(); }
+
+/**
+ * Number of bytes of the data of an array.
+ */
+template<typename E>
+inline uint64_t nBytes(const E& src)
+{
+  return static_cast<uint64_t>(src.size() * sizeof(typename E::value_type));
+}
+
+/**
+ * Record the wall time of a scope together with the bytes processed and the
+ * numbers of TBB tasks and allocations within it.
+ *
+ * Nothing is recorded if the profiler is disabled when the timer is
+ * created. The task and allocation counts also include those of the other
+ * kernels running concurrently.
+ */
+class ScopedTimer
+{
+public:
+
+  ScopedTimer(std::size_t stage, uint64_t bytes)
+    : registry_(Registry::instance()), active_(registry_.enabled()), stage_(stage), bytes_(bytes)
+  {
+    if (! active_) return;
+    n_tasks_ = registry_.nTasks();
+    n_allocations_ = registry_.nAllocations();
+    t0_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedTimer()
+  {
+    if (! active_) return;
+    auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0_);
+    registry_.record(stage_, static_cast<uint64_t>(dt.count()), bytes_,
+                     registry_.nTasks() - n_tasks_, registry_.nAllocations() - n_allocations_);
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+
+  Registry& registry_;
+  bool active_;
+  std::size_t stage_;
+  uint64_t bytes_;
+  uint64_t n_tasks_ = 0;
+  uint64_t n_allocations_ = 0;
+  std::chrono::steady_clock::time_point t0_;
+};
+
+} // profiler
+} // foam
+
+/**
+ * Time the rest of the enclosing scope as the stage NAME, which processes
+ * BYTES bytes.
+ */
+#define FOAM_PROFILE_SCOPE(NAME, BYTES)                                                                 \
+  static const std::size_t foam_profiler_stage_ = ::foam::profiler::Registry::instance().stageId(NAME); \
+  ::foam::profiler::ScopedTimer foam_profiler_timer_(foam_profiler_stage_, static_cast<uint64_t>(BYTES))
+
+#endif //EXTRA_FOAM_F_PROFILER_HPP
@@ -0,0 +1,527 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_RING_BUFFER_H
+#define EXTRA_FOAM_RING_BUFFER_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if ATOMIC_LLONG_LOCK_FREE != 2 || ATOMIC_INT_LOCK_FREE != 2
+#error "Lock-free 32-bit and 64-bit atomics are required by SharedRingBuffer"
+#endif
+
+
+namespace foam
+{
+
+/**
+ * Handle of a published slot.
+ *
+ * It is cheap to copy and to send to another process, which can then map
+ * the data in the slot without copying them as long as the slot has not
+ * been overwritten.
+ */
+struct RingBufferHandle
+{
+  std::size_t slot;
+  uint64_t seq;
+  uint64_t tid;
+};
+
+/**
+ * Ring buffer of fixed-size slots in POSIX shared memory.
+ *
+ * A single producer writes the data of a train into a slot and publishes it,
+ * while any number of consumers in any process attach to the buffer by name
+ * and map the published slots. The slot index is lock-free:
+ *
+ * - Each slot has a state word, which is set while the producer writes, and
+ *   a table of the process IDs of the consumers which hold the slot.
+ * - The producer only takes a slot which is held by nobody, and skips the
+ *   held ones. The oldest train is overwritten if no slot is held.
+ * - Each publication gets a unique sequence number, which invalidates the
+ *   handles of the train previously stored in the slot.
+ *
+ * A consumer which dies while holding a slot cannot release it. The holds
+ * of dead processes are recovered by the producer once all the slots are
+ * held. A process is considered dead once it has been reaped by its parent,
+ * so the producer and the consumers must share the PID namespace, and a
+ * hold is kept if the PID has been reused in the meantime.
+ */
+class SharedRingBuffer
+{
+public:
+
+  static constexpr std::size_t kMaxDims = 4;
+  static constexpr std::size_t kMaxDtypeLength = 16;
+  // maximum number of holds of a slot at the same time
+  static constexpr std::size_t kMaxHolders = 8;
+
+  /**
+   * Description of the data stored in a slot.
+   */
+  struct SlotInfo
+  {
+    uint64_t tid = 0;
+    uint64_t ndim = 0;
+    uint64_t shape[kMaxDims] = {0};
+    uint64_t nbytes = 0;
+    char dtype[kMaxDtypeLength] = {0};
+  };
+
+private:
+
+  static constexpr uint64_t kMagic = 0x464f414d52494e47; // "FOAMRING"
+  static constexpr uint32_t kWriting = 0x80000000u;
+  static constexpr std::size_t kAlignment = 64;
+  static constexpr std::size_t kSlotBits = 16;
+  static constexpr std::size_t kMaxWaits = 1000;
+
+  struct alignas(64) Header
+  {
+    uint64_t magic;
+    uint64_t n_slots;
+    uint64_t slot_size;
+    uint64_t slot_stride;
+    // (sequence number << kSlotBits) | slot index of the latest publication
+    alignas(64) std::atomic<uint64_t> latest;
+  };
+
+  struct alignas(64) SlotHeader
+  {
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> tid;
+    std::atomic<uint32_t> state;
+    // process IDs of the holders, 0 for a free entry
+    std::atomic<int32_t> holders[kMaxHolders];
+    SlotInfo info;
+  };
+
+  static std::size_t alignUp(std::size_t n) { return (n + kAlignment - 1) / kAlignment * kAlignment; }
+
+  // errno must be saved by the caller before any cleanup which can overwrite it
+  static void throwErrno(const std::string& header, const std::string& name, int err)
+  {
+    std::stringstream ss;
+    ss << header << " '" << name << "': " << std::strerror(err);
+    throw std::runtime_error(ss.str());
+  }
+
+public:
+
+  /**
+   * Create a ring buffer.
+   *
+   * @param name: name of the shared memory object, e.g. "/foam_pulse_worker".
+   * @param n_slots: number of slots.
+   * @param slot_size: capacity (in bytes) of each slot.
+   */
+  SharedRingBuffer(const std::string& name, std::size_t n_slots, std::size_t slot_size)
+    : name_(name), owner_(true)
+  {
+    if (n_slots < 2 || n_slots >= (std::size_t(1) << kSlotBits))
+    {
+      std::stringstream ss;
+      ss << "Number of slots must be within [2, " << (std::size_t(1) << kSlotBits) << "), got " << n_slots;
+      throw std::invalid_argument(ss.str());
+    }
+    if (slot_size == 0) throw std::invalid_argument("Slot size must be positive!");
+
+    std::size_t slot_stride = alignUp(sizeof(SlotHeader)) + alignUp(slot_size);
+    size_ = alignUp(sizeof(Header)) + n_slots * slot_stride;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) throwErrno("Failed to create shared memory", name, errno);
+    if (ftruncate(fd, static_cast<off_t>(size_)) == -1)
+    {
+      int err = errno;
+      close(fd);
+      shm_unlink(name.c_str());
+      throwErrno("Failed to allocate shared memory", name, err);
+    }
+    map(fd);
+
+    header_ = new (base_) Header;
+    header_->n_slots = n_slots;
+    header_->slot_size = slot_size;
+    header_->slot_stride = slot_stride;
+    header_->latest.store(0, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < n_slots; ++i)
+    {
+      auto slot = new (slotHeader(i)) SlotHeader;
+      slot->seq.store(0, std::memory_order_relaxed);
+      slot->tid.store(0, std::memory_order_relaxed);
+      slot->state.store(0, std::memory_order_relaxed);
+      for (auto& holder : slot->holders) holder.store(0, std::memory_order_relaxed);
+    }
+    // the buffer becomes valid only after it has been fully initialized
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kMagic;
+  }
+
+  /**
+   * Attach to an existing ring buffer.
+   *
+   * @param name: name of the shared memory object.
+   */
+  explicit SharedRingBuffer(const std::string& name) : name_(name), owner_(false)
+  {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd == -1) throwErrno("Failed to open shared memory", name, errno);
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+      int err = errno;
+      close(fd);
+      throwErrno("Failed to stat shared memory", name, err);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ < sizeof(Header))
+    {
+      close(fd);
+      throw std::runtime_error("'" + name + "' is not a ring buffer!");
+    }
+    map(fd);
+
+    header_ = reinterpret_cast<Header*>(base_);
+    if (header_->magic != kMagic)
+    {
+      munmap(base_, size_);
+      throw std::runtime_error("'" + name + "' is not a ring buffer!");
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+
+  SharedRingBuffer(const SharedRingBuffer&) = delete;
+  SharedRingBuffer& operator=(const SharedRingBuffer&) = delete;
+
+  ~SharedRingBuffer()
+  {
+    munmap(base_, size_);
+    if (owner_) shm_unlink(name_.c_str());
+  }
+
+  const std::string& name() const { return name_; }
+
+  bool owner() const { return owner_; }
+
+  std::size_t nSlots() const { return header_->n_slots; }
+
+  std::size_t slotSize() const { return header_->slot_size; }
+
+  //
+  // producer
+  //
+
+  /**
+   * Reserve a slot for writing.
+   *
+   * The slots after the latest publication are tried in turn and the ones
+   * held by consumers are skipped. If all of them are held, the holds of
+   * dead consumers are recovered before trying again.
+   *
+   * @return: index of the reserved slot.
+   */
+  std::size_t claim()
+  {
+    if (!owner_) throw std::logic_error("Only the owner of the ring buffer can write!");
+    if (claimed_ != kNoSlot) throw std::logic_error("A slot has already been claimed!");
+
+    std::size_t slot = tryClaim();
+    if (slot == kNoSlot && recover() > 0) slot = tryClaim();
+    if (slot == kNoSlot) throw std::runtime_error("All the slots are held by consumers!");
+
+    claimed_ = slot;
+    return slot;
+  }
+
+  /**
+   * Release the holds of the consumer processes which no longer exist.
+   *
+   * @return: number of the released holds.
+   */
+  std::size_t recover()
+  {
+    std::size_t n_released = 0;
+    for (std::size_t slot = 0; slot < nSlots(); ++slot)
+    {
+      for (auto& holder : slotHeader(slot)->holders)
+      {
+        int32_t pid = holder.load(std::memory_order_relaxed);
+        if (pid == 0 || alive(pid)) continue;
+        if (holder.compare_exchange_strong(pid, 0, std::memory_order_release)) ++n_released;
+      }
+    }
+    return n_released;
+  }
+
+  /**
+   * Pointer to the data of the claimed slot.
+   */
+  char* claimedData()
+  {
+    if (claimed_ == kNoSlot) throw std::logic_error("No slot has been claimed!");
+    return slotData(claimed_);
+  }
+
+  /**
+   * Publish the claimed slot.
+   *
+   * @param info: description of the written data.
+   * @return: handle of the published slot.
+   */
+  RingBufferHandle publish(const SlotInfo& info)
+  {
+    if (claimed_ == kNoSlot) throw std::logic_error("No slot has been claimed!");
+    if (info.nbytes > slotSize())
+    {
+      std::stringstream ss;
+      ss << "Data size " << info.nbytes << " exceeds the slot size " << slotSize();
+      throw std::invalid_argument(ss.str());
+    }
+
+    std::size_t slot = claimed_;
+    uint64_t seq = (header_->latest.load(std::memory_order_relaxed) >> kSlotBits) + 1;
+
+    SlotHeader* sh = slotHeader(slot);
+    sh->info = info;
+    sh->tid.store(info.tid, std::memory_order_relaxed);
+    sh->seq.store(seq, std::memory_order_relaxed);
+    sh->state.store(0, std::memory_order_release);
+    header_->latest.store((seq << kSlotBits) | slot, std::memory_order_release);
+
+    claimed_ = kNoSlot;
+    return {slot, seq, info.tid};
+  }
+
+  /**
+   * Give up the claimed slot without publishing it.
+   */
+  void abandon()
+  {
+    if (claimed_ == kNoSlot) return;
+    slotHeader(claimed_)->state.store(0, std::memory_order_release);
+    claimed_ = kNoSlot;
+  }
+
+  /**
+   * Copy data into a slot and publish it.
+   */
+  RingBufferHandle write(const void* data, const SlotInfo& info)
+  {
+    if (info.nbytes > slotSize())
+    {
+      std::stringstream ss;
+      ss << "Data size " << info.nbytes << " exceeds the slot size " << slotSize();
+      throw std::invalid_argument(ss.str());
+    }
+    claim();
+    std::memcpy(claimedData(), data, info.nbytes);
+    return publish(info);
+  }
+
+  //
+  // consumer
+  //
+
+  /**
+   * Get the handle of the latest publication.
+   *
+   * @return: false if nothing has been published yet.
+   */
+  bool latest(RingBufferHandle& handle) const
+  {
+    uint64_t v = header_->latest.load(std::memory_order_acquire);
+    if (v == 0) return false;
+    handle.slot = static_cast<std::size_t>(v & kSlotMask);
+    handle.seq = v >> kSlotBits;
+    handle.tid = slotHeader(handle.slot)->tid.load(std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * Hold the slot of a handle so that it will not be overwritten.
+   *
+   * @return: false if the slot has already been overwritten or if it is
+   *          held kMaxHolders times already.
+   */
+  bool acquire(const RingBufferHandle& handle)
+  {
+    SlotHeader* sh = checkedSlotHeader(handle.slot);
+    std::atomic<int32_t>* entry = nullptr;
+    int32_t pid = static_cast<int32_t>(getpid());
+    for (auto& holder : sh->holders)
+    {
+      int32_t expected = 0;
+      if (holder.compare_exchange_strong(expected, pid, std::memory_order_seq_cst))
+      {
+        entry = &holder;
+        break;
+      }
+    }
+    if (entry == nullptr) return false;
+
+    // The hold is published before the state is checked, while the producer
+    // sets the state before checking the holds. Therefore, at least one of
+    // them sees the other. The producer backs off if it sees the hold, which
+    // is waited for as long as the train is still in the slot.
+    for (std::size_t i = 0; i < kMaxWaits; ++i)
+    {
+      uint32_t s = sh->state.load(std::memory_order_seq_cst);
+      if (sh->seq.load(std::memory_order_acquire) != handle.seq) break;
+      if (!(s & kWriting)) return true;
+      std::this_thread::yield();
+    }
+    entry->store(0, std::memory_order_release);
+    return false;
+  }
+
+  /**
+   * Release a slot which was held by acquire.
+   */
+  void release(const RingBufferHandle& handle)
+  {
+    int32_t pid = static_cast<int32_t>(getpid());
+    for (auto& holder : checkedSlotHeader(handle.slot)->holders)
+    {
+      int32_t expected = pid;
+      if (holder.compare_exchange_strong(expected, 0, std::memory_order_release)) return;
+    }
+  }
+
+  /**
+   * Number of holds of a slot.
+   */
+  std::size_t nHolders(std::size_t slot) const
+  {
+    std::size_t n = 0;
+    for (auto& holder : checkedSlotHeader(slot)->holders)
+    {
+      if (holder.load(std::memory_order_relaxed) != 0) ++n;
+    }
+    return n;
+  }
+
+  /**
+   * Whether the slot of a handle still stores the data of the handle.
+   */
+  bool valid(const RingBufferHandle& handle) const
+  {
+    return checkedSlotHeader(handle.slot)->seq.load(std::memory_order_acquire) == handle.seq;
+  }
+
+  /**
+   * Description of the data in a slot. Only meaningful while the slot is held.
+   */
+  const SlotInfo& info(std::size_t slot) const { return checkedSlotHeader(slot)->info; }
+
+  const char* slotData(std::size_t slot) const
+  {
+    checkedSlotHeader(slot);
+    return base_ + alignUp(sizeof(Header)) + slot * header_->slot_stride + alignUp(sizeof(SlotHeader));
+  }
+
+  char* slotData(std::size_t slot)
+  {
+    return const_cast<char*>(static_cast<const SharedRingBuffer*>(this)->slotData(slot));
+  }
+
+private:
+
+  static constexpr std::size_t kNoSlot = static_cast<std::size_t>(-1);
+  static constexpr uint64_t kSlotMask = (uint64_t(1) << kSlotBits) - 1;
+
+  static bool alive(int32_t pid)
+  {
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+  }
+
+  // Reserve a slot which is held by nobody or return kNoSlot.
+  std::size_t tryClaim()
+  {
+    std::size_t n = nSlots();
+    std::size_t start = (header_->latest.load(std::memory_order_relaxed) & kSlotMask) + 1;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      std::size_t slot = (start + i) % n;
+      SlotHeader* sh = slotHeader(slot);
+      uint32_t expected = 0;
+      if (!sh->state.compare_exchange_strong(expected, kWriting, std::memory_order_seq_cst)) continue;
+
+      bool held = false;
+      for (auto& holder : sh->holders)
+      {
+        if (holder.load(std::memory_order_seq_cst) != 0)
+        {
+          held = true;
+          break;
+        }
+      }
+      if (held)
+      {
+        sh->state.store(0, std::memory_order_release);
+        continue;
+      }
+
+      // invalidate the handles of the previous train in this slot
+      sh->seq.store(0, std::memory_order_release);
+      return slot;
+    }
+    return kNoSlot;
+  }
+
+  void map(int fd)
+  {
+    void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+      if (owner_) shm_unlink(name_.c_str());
+      throwErrno("Failed to map shared memory", name_, err);
+    }
+    base_ = static_cast<char*>(p);
+  }
+
+  SlotHeader* slotHeader(std::size_t slot) const
+  {
+    return reinterpret_cast<SlotHeader*>(base_ + alignUp(sizeof(Header)) + slot * header_->slot_stride);
+  }
+
+  SlotHeader* checkedSlotHeader(std::size_t slot) const
+  {
+    if (slot >= nSlots()) throw std::out_of_range("Slot index is out of range!");
+    return slotHeader(slot);
+  }
+
+  std::string name_;
+  bool owner_;
+  std::size_t size_ = 0;
+  char* base_ = nullptr;
+  Header* header_ = nullptr;
+  std::size_t claimed_ = kNoSlot;
+};
+
+} // foam
+
+#endif //EXTRA_FOAM_RING_BUFFER_H
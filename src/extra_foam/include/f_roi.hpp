@@ -0,0 +1,442 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_F_ROI_HPP
+#define EXTRA_FOAM_F_ROI_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "xtensor/xtensor.hpp"
+
+#include "f_traits.hpp"
+#include "f_helpers.hpp"
+#include "f_parallel.hpp"
+#include "f_buffer_pool.hpp"
+#include "f_utilities.hpp"
+
+
+namespace foam
+{
+
+/**
+ * Statistics of ROIs, in the order of the last axis of the output of roiStatistics.
+ */
+enum class RoiStat : std::size_t
+{
+  COUNT = 0, // number of valid pixels
+  SUM,
+  MEAN,
+  MEDIAN,
+  MIN,
+  MAX,
+  VAR,
+  STD
+};
+
+constexpr std::size_t kNumRoiStats = 8;
+
+namespace detail
+{
+
+using RoiType = std::array<int, 4>;
+
+/**
+ * Clip a ROI (x, y, w, h) by an image with the given shape (y, x).
+ *
+ * Return an empty ROI if there is no intersection.
+ */
+inline RoiType clipRoi(const RoiType& roi, std::size_t h, std::size_t w)
+{
+  auto clipped = intersection(roi, {0, 0, static_cast<int>(w), static_cast<int>(h)});
+  if (clipped[2] <= 0 || clipped[3] <= 0) return {0, 0, 0, 0};
+  return clipped;
+}
+
+/**
+ * Pointers and strides of an image (or an array of images) and its optional mask.
+ */
+template<typename T>
+struct MaskedImages
+{
+  const T* data;
+  std::ptrdiff_t image_stride;
+  std::array<std::ptrdiff_t, 2> strides;
+  const bool* mask; // nullptr for no mask
+  std::array<std::ptrdiff_t, 2> mask_strides;
+  T lb;
+  T ub;
+
+  /**
+   * Apply a function to the valid pixels in a ROI of the i-th image.
+   *
+   * A pixel is valid if it is not masked and lb <= v <= ub. In particular,
+   * nan pixels are never valid.
+   *
+   * @param f: function with signature f(j, k, v), where (j, k) is the position
+   *           of the pixel relative to the ROI.
+   */
+  template<typename F>
+  void forEachValid(std::size_t i, const RoiType& roi, F&& f) const
+  {
+    const T* img = data + i * image_stride;
+    for (int j = 0; j < roi[3]; ++j)
+    {
+      const T* row = img + (roi[1] + j) * strides[0] + roi[0] * strides[1];
+      const bool* mask_row = mask == nullptr ?
+        nullptr : mask + (roi[1] + j) * mask_strides[0] + roi[0] * mask_strides[1];
+      for (int k = 0; k < roi[2]; ++k)
+      {
+        if (mask_row != nullptr && mask_row[k * mask_strides[1]]) continue;
+        T v = row[k * strides[1]];
+        // nan is excluded by the comparisons
+        if (v >= lb && v <= ub) f(j, k, v);
+      }
+    }
+  }
+};
+
+template<typename E, typename T = typename E::value_type>
+inline MaskedImages<T> maskedImages(const E& src, const bool* mask, const std::array<std::ptrdiff_t, 2>& ms,
+                                    double lb, double ub)
+{
+  if (lb > ub) throw std::invalid_argument("Lower threshold cannot be larger than the upper one!");
+
+  auto st = src.strides();
+  std::size_t nd = st.size();
+  return {src.data(),
+          nd == 3 ? static_cast<std::ptrdiff_t>(st[0]) : 0,
+          {static_cast<std::ptrdiff_t>(st[nd - 2]), static_cast<std::ptrdiff_t>(st[nd - 1])},
+          mask, ms, static_cast<T>(lb), static_cast<T>(ub)};
+}
+
+template<typename M>
+inline std::array<std::ptrdiff_t, 2> maskStrides(const M& mask)
+{
+  return {static_cast<std::ptrdiff_t>(mask.strides()[0]), static_cast<std::ptrdiff_t>(mask.strides()[1])};
+}
+
+/**
+ * Median of the values in the buffer, which is reordered. It follows
+ * numpy.median for an even number of values.
+ */
+inline double medianOf(std::vector<double>& buf)
+{
+  std::size_t n = buf.size();
+  auto mid = buf.begin() + n / 2;
+  std::nth_element(buf.begin(), mid, buf.end());
+  double median = *mid;
+  if (n % 2 == 0) median = 0.5 * (median + *std::max_element(buf.begin(), mid));
+  return median;
+}
+
+template<typename T, typename O>
+inline void roiStatisticsTo(const MaskedImages<T>& images, std::size_t n_images, std::size_t h, std::size_t w,
+                            const std::vector<RoiType>& rois, bool with_median, O& dst)
+{
+  std::size_t n_rois = rois.size();
+  checkShape(std::array<std::size_t, 3>{n_images, n_rois, kNumRoiStats}, dst.shape(),
+             "Output has a wrong shape");
+  std::vector<RoiType> clipped(n_rois);
+  for (std::size_t r = 0; r < n_rois; ++r) clipped[r] = clipRoi(rois[r], h, w);
+
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+  // each task processes a few (image, ROI) pairs, whose data are read at most
+  // three times while they are still in the cache
+  parallelFor(n_images * n_rois, [&] (std::size_t begin, std::size_t end)
+  {
+    std::vector<double> buf;
+    for (std::size_t idx = begin; idx < end; ++idx)
+    {
+      std::size_t i = idx / n_rois;
+      std::size_t r = idx % n_rois;
+      const auto& roi = clipped[r];
+
+      std::size_t count = 0;
+      double sum = 0.;
+      double vmin = std::numeric_limits<double>::infinity();
+      double vmax = -std::numeric_limits<double>::infinity();
+      images.forEachValid(i, roi, [&] (int, int, T v)
+      {
+        ++count;
+        sum += v;
+        vmin = std::min(vmin, static_cast<double>(v));
+        vmax = std::max(vmax, static_cast<double>(v));
+      });
+
+      auto out = &dst(i, r, 0);
+      out[static_cast<std::size_t>(RoiStat::COUNT)] = static_cast<double>(count);
+      // follow numpy.nansum, which returns 0 for all-nan slices
+      out[static_cast<std::size_t>(RoiStat::SUM)] = sum;
+      if (count == 0)
+      {
+        for (auto s : {RoiStat::MEAN, RoiStat::MEDIAN, RoiStat::MIN, RoiStat::MAX, RoiStat::VAR, RoiStat::STD})
+          out[static_cast<std::size_t>(s)] = nan;
+        continue;
+      }
+
+      double mean = sum / count;
+      double ssd = 0.;
+      images.forEachValid(i, roi, [&] (int, int, T v) { ssd += (v - mean) * (v - mean); });
+      double var = ssd / count;
+
+      double median = nan;
+      if (with_median)
+      {
+        buf.clear();
+        images.forEachValid(i, roi, [&buf] (int, int, T v) { buf.push_back(v); });
+        median = medianOf(buf);
+      }
+
+      out[static_cast<std::size_t>(RoiStat::MEAN)] = mean;
+      out[static_cast<std::size_t>(RoiStat::MEDIAN)] = median;
+      out[static_cast<std::size_t>(RoiStat::MIN)] = vmin;
+      out[static_cast<std::size_t>(RoiStat::MAX)] = vmax;
+      out[static_cast<std::size_t>(RoiStat::VAR)] = var;
+      out[static_cast<std::size_t>(RoiStat::STD)] = std::sqrt(var);
+    }
+  });
+}
+
+template<typename R, typename T>
+inline R roiStatisticsImp(const MaskedImages<T>& images, std::size_t n_images, std::size_t h, std::size_t w,
+                          const std::vector<RoiType>& rois, bool with_median)
+{
+  profiler::countAllocation();
+  auto dst = R::from_shape({n_images, rois.size(), kNumRoiStats});
+  roiStatisticsTo(images, n_images, h, w, rois, with_median, dst);
+  return dst;
+}
+
+inline bool projectionAlongX(const std::string& direction)
+{
+  if (direction == "x") return true;
+  if (direction == "y") return false;
+  throw std::invalid_argument("Unknown projection direction: " + direction);
+}
+
+/**
+ * Length of the projection of a ROI clipped by the image.
+ */
+inline std::size_t projectionLength(const RoiType& roi, std::size_t h, std::size_t w, bool along_x)
+{
+  auto clipped = clipRoi(roi, h, w);
+  return static_cast<std::size_t>(along_x ? clipped[2] : clipped[3]);
+}
+
+template<typename T, typename O>
+inline void roiProjectionTo(const MaskedImages<T>& images, std::size_t n_images, std::size_t h, std::size_t w,
+                            const RoiType& roi, const std::string& direction, bool mean, O& dst)
+{
+  bool along_x = projectionAlongX(direction);
+  auto clipped = clipRoi(roi, h, w);
+  auto n = projectionLength(roi, h, w, along_x);
+  checkShape(std::array<std::size_t, 2>{n_images, n}, dst.shape(), "Output has a wrong shape");
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+  parallelFor(n_images, [&] (std::size_t begin, std::size_t end)
+  {
+    PooledBuffer<double> sums(n);
+    PooledBuffer<std::size_t> counts(n);
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      std::fill(sums.begin(), sums.end(), 0.);
+      std::fill(counts.begin(), counts.end(), 0);
+      // the ROI is always read row by row
+      images.forEachValid(i, clipped, [&sums, &counts, along_x] (int j, int k, T v)
+      {
+        int p = along_x ? k : j;
+        sums[p] += v;
+        ++counts[p];
+      });
+
+      for (std::size_t p = 0; p < n; ++p)
+      {
+        // follow numpy.nansum and numpy.nanmean for all-nan slices
+        if (mean) dst(i, p) = counts[p] > 0 ? sums[p] / counts[p] : nan;
+        else dst(i, p) = sums[p];
+      }
+    }
+  });
+}
+
+template<typename R, typename T>
+inline R roiProjectionImp(const MaskedImages<T>& images, std::size_t n_images, std::size_t h, std::size_t w,
+                          const RoiType& roi, const std::string& direction, bool mean)
+{
+  auto n = projectionLength(roi, h, w, projectionAlongX(direction));
+  profiler::countAllocation();
+  auto dst = R::from_shape({n_images, n});
+  roiProjectionTo(images, n_images, h, w, roi, direction, mean, dst);
+  return dst;
+}
+
+} // detail
+
+/**
+ * Calculate the statistics of the valid pixels in multiple ROIs of an array
+ * of images in a single parallel pass, without copying the ROIs.
+ *
+ * A pixel is valid if it is not nan, not masked and within the threshold.
+ * For ROIs without any valid pixel, the sum is 0 and the other statistics
+ * except the count are nan. The variance is the population variance (ddof = 0).
+ *
+ * @param src: image data. shape = (images, y, x)
+ * @param rois: (x, y, w, h) of the ROIs. They are clipped by the image.
+ * @param lb: lower threshold.
+ * @param ub: upper threshold.
+ * @param with_median: true for calculating the median, which requires an
+ *                     extra copy of the valid pixels. Otherwise, the median
+ *                     is nan.
+ *
+ * @return: statistics in the order of RoiStat. They are accumulated in double
+ *          precision and converted to the value type of R. shape = (images, ROIs, kNumRoiStats)
+ */
+template<typename R = xt::xtensor<double, 3>, typename E, EnableIf<E, IsImageArray> = false>
+inline R roiStatistics(const E& src, const std::vector<std::array<int, 4>>& rois,
+                       double lb = -std::numeric_limits<double>::infinity(),
+                       double ub = std::numeric_limits<double>::infinity(),
+                       bool with_median = false)
+{
+  FOAM_PROFILE_SCOPE("roiStatistics", profiler::nBytes(src));
+  auto ss = src.shape();
+  auto images = detail::maskedImages(src, nullptr, {0, 0}, lb, ub);
+  return detail::roiStatisticsImp<R>(images, ss[0], ss[1], ss[2], rois, with_median);
+}
+
+/**
+ * Calculate the statistics of the valid pixels in multiple ROIs of an array
+ * of images with a common image mask.
+ *
+ * @param mask: image mask. Pixels with mask == true are ignored. shape = (y, x)
+ */
+template<typename R = xt::xtensor<double, 3>, typename E, typename M,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
+inline R roiStatistics(const E& src, const std::vector<std::array<int, 4>>& rois, const M& mask,
+                       double lb = -std::numeric_limits<double>::infinity(),
+                       double ub = std::numeric_limits<double>::infinity(),
+                       bool with_median = false)
+{
+  FOAM_PROFILE_SCOPE("roiStatistics", profiler::nBytes(src));
+  auto ss = src.shape();
+  checkShape(mask.shape(), std::array<std::size_t, 2>{ss[1], ss[2]}, "Image and mask have different shapes");
+  auto images = detail::maskedImages(src, mask.data(), detail::maskStrides(mask), lb, ub);
+  return detail::roiStatisticsImp<R>(images, ss[0], ss[1], ss[2], rois, with_median);
+}
+
+/**
+ * Project the valid pixels in a ROI of an array of images onto the x or y axis.
+ *
+ * @param src: image data. shape = (images, y, x)
+ * @param roi: (x, y, w, h) of the ROI. It is clipped by the image.
+ * @param direction: "x" for projecting onto the x axis (reduce along y) and
+ *                   "y" for projecting onto the y axis (reduce along x).
+ * @param mean: true for the nanmean and false for the nansum of the pixels.
+ * @param lb: lower threshold.
+ * @param ub: upper threshold.
+ *
+ * @return: projections. shape = (images, w) for "x" and (images, h) for "y".
+ */
+template<typename R = xt::xtensor<double, 2>, typename E, EnableIf<E, IsImageArray> = false>
+inline R roiProjection(const E& src, const std::array<int, 4>& roi, const std::string& direction, bool mean,
+                       double lb = -std::numeric_limits<double>::infinity(),
+                       double ub = std::numeric_limits<double>::infinity())
+{
+  FOAM_PROFILE_SCOPE("roiProjection", profiler::nBytes(src));
+  auto ss = src.shape();
+  auto images = detail::maskedImages(src, nullptr, {0, 0}, lb, ub);
+  return detail::roiProjectionImp<R>(images, ss[0], ss[1], ss[2], roi, direction, mean);
+}
+
+/**
+ * Project the valid pixels in a ROI of an array of images with a common
+ * image mask onto the x or y axis.
+ *
+ * @param mask: image mask. Pixels with mask == true are ignored. shape = (y, x)
+ */
+template<typename R = xt::xtensor<double, 2>, typename E, typename M,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false>
+inline R roiProjection(const E& src, const std::array<int, 4>& roi, const M& mask,
+                       const std::string& direction, bool mean,
+                       double lb = -std::numeric_limits<double>::infinity(),
+                       double ub = std::numeric_limits<double>::infinity())
+{
+  FOAM_PROFILE_SCOPE("roiProjection", profiler::nBytes(src));
+  auto ss = src.shape();
+  checkShape(mask.shape(), std::array<std::size_t, 2>{ss[1], ss[2]}, "Image and mask have different shapes");
+  auto images = detail::maskedImages(src, mask.data(), detail::maskStrides(mask), lb, ub);
+  return detail::roiProjectionImp<R>(images, ss[0], ss[1], ss[2], roi, direction, mean);
+}
+
+/**
+ * Overloads of roiStatistics which write the statistics to a pre-allocated
+ * array.
+ *
+ * @param out: statistics. shape = (images, ROIs, kNumRoiStats)
+ */
+template<typename E, typename O, EnableIf<E, IsImageArray> = false, EnableIf<O, IsImageArray> = false>
+inline void roiStatistics(const E& src, const std::vector<std::array<int, 4>>& rois,
+                          double lb, double ub, bool with_median, O& out)
+{
+  FOAM_PROFILE_SCOPE("roiStatistics", profiler::nBytes(src));
+  auto ss = src.shape();
+  auto images = detail::maskedImages(src, nullptr, {0, 0}, lb, ub);
+  detail::roiStatisticsTo(images, ss[0], ss[1], ss[2], rois, with_median, out);
+}
+
+template<typename E, typename M, typename O,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false, EnableIf<O, IsImageArray> = false>
+inline void roiStatistics(const E& src, const std::vector<std::array<int, 4>>& rois, const M& mask,
+                          double lb, double ub, bool with_median, O& out)
+{
+  FOAM_PROFILE_SCOPE("roiStatistics", profiler::nBytes(src));
+  auto ss = src.shape();
+  checkShape(mask.shape(), std::array<std::size_t, 2>{ss[1], ss[2]}, "Image and mask have different shapes");
+  auto images = detail::maskedImages(src, mask.data(), detail::maskStrides(mask), lb, ub);
+  detail::roiStatisticsTo(images, ss[0], ss[1], ss[2], rois, with_median, out);
+}
+
+/**
+ * Overloads of roiProjection which write the projections to a pre-allocated
+ * array.
+ *
+ * @param out: projections. shape = (images, w) for "x" and (images, h) for "y".
+ */
+template<typename E, typename O, EnableIf<E, IsImageArray> = false, EnableIf<O, IsImage> = false>
+inline void roiProjection(const E& src, const std::array<int, 4>& roi, const std::string& direction, bool mean,
+                          double lb, double ub, O& out)
+{
+  FOAM_PROFILE_SCOPE("roiProjection", profiler::nBytes(src));
+  auto ss = src.shape();
+  auto images = detail::maskedImages(src, nullptr, {0, 0}, lb, ub);
+  detail::roiProjectionTo(images, ss[0], ss[1], ss[2], roi, direction, mean, out);
+}
+
+template<typename E, typename M, typename O,
+  EnableIf<E, IsImageArray> = false, EnableIf<M, IsImageMask> = false, EnableIf<O, IsImage> = false>
+inline void roiProjection(const E& src, const std::array<int, 4>& roi, const M& mask,
+                          const std::string& direction, bool mean, double lb, double ub, O& out)
+{
+  FOAM_PROFILE_SCOPE("roiProjection", profiler::nBytes(src));
+  auto ss = src.shape();
+  checkShape(mask.shape(), std::array<std::size_t, 2>{ss[1], ss[2]}, "Image and mask have different shapes");
+  auto images = detail::maskedImages(src, mask.data(), detail::maskStrides(mask), lb, ub);
+  detail::roiProjectionTo(images, ss[0], ss[1], ss[2], roi, direction, mean, out);
+}
+
+} // foam
+
+#endif //EXTRA_FOAM_F_ROI_HPP
@@ -0,0 +1,285 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#ifndef EXTRA_FOAM_F_SIMD_HPP
+#define EXTRA_FOAM_F_SIMD_HPP
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(FOAM_WITH_XSIMD)
+#include "xsimd/xsimd.hpp"
+// xsimd falls back to scalar types if no instruction set is available
+#if defined(XSIMD_BATCH_FLOAT_SIZE) && defined(XSIMD_BATCH_DOUBLE_SIZE)
+#define FOAM_SIMD_AVAILABLE
+#endif
+#endif
+
+
+namespace foam
+{
+
+namespace detail
+{
+
+inline std::atomic<bool>& simdFlag()
+{
+  static std::atomic<bool> flag {true};
+  return flag;
+}
+
+template<typename T>
+struct IsSimdType : std::integral_constant<bool,
+  std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+} // detail
+
+/**
+ * Whether the explicit SIMD code paths are compiled in.
+ */
+constexpr bool simdAvailable()
+{
+#if defined(FOAM_SIMD_AVAILABLE)
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Enable/disable the explicit SIMD code paths at runtime.
+ *
+ * It is mainly used for benchmarking against the scalar code paths. It has
+ * no effect if SIMD is not available.
+ */
+inline void setSimdEnabled(bool enabled)
+{
+  detail::simdFlag().store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * Whether the explicit SIMD code paths are used.
+ */
+inline bool simdEnabled()
+{
+  return simdAvailable() && detail::simdFlag().load(std::memory_order_relaxed);
+}
+
+namespace detail
+{
+
+#if defined(FOAM_SIMD_AVAILABLE)
+
+template<typename T>
+using simd_batch = xsimd::simd_type<T>;
+
+/**
+ * Load a bool mask into a batch_bool which can be used for blending batches
+ * of type T.
+ */
+template<typename T>
+inline auto loadMaskBatch(const bool* mask)
+{
+  using batch_type = simd_batch<T>;
+  alignas(64) T buf[batch_type::size];
+  for (std::size_t l = 0; l < batch_type::size; ++l) buf[l] = mask[l] ? T(1) : T(0);
+  return xsimd::load_aligned(buf) != batch_type(T(0));
+}
+
+template<typename T, typename Op>
+inline std::size_t unaryTransformSimd(T* p, std::size_t n, Op& op, std::true_type)
+{
+  using batch_type = simd_batch<T>;
+  constexpr std::size_t size = batch_type::size;
+  std::size_t vn = n - n % size;
+  for (std::size_t k = 0; k < vn; k += size)
+  {
+    batch_type v = xsimd::load_unaligned(p + k);
+    xsimd::store_unaligned(p + k, op(v));
+  }
+  return vn;
+}
+
+template<typename T, typename Op>
+inline std::size_t binaryTransformSimd(T* p, const T* q, std::size_t n, Op& op, std::true_type)
+{
+  using batch_type = simd_batch<T>;
+  constexpr std::size_t size = batch_type::size;
+  std::size_t vn = n - n % size;
+  for (std::size_t k = 0; k < vn; k += size)
+  {
+    batch_type v = xsimd::load_unaligned(p + k);
+    batch_type a = xsimd::load_unaligned(q + k);
+    xsimd::store_unaligned(p + k, op(v, a));
+  }
+  return vn;
+}
+
+template<typename T, typename Op>
+inline std::size_t ternaryTransformSimd(T* p, const T* q, const T* r, std::size_t n, Op& op, std::true_type)
+{
+  using batch_type = simd_batch<T>;
+  constexpr std::size_t size = batch_type::size;
+  std::size_t vn = n - n % size;
+  for (std::size_t k = 0; k < vn; k += size)
+  {
+    batch_type v = xsimd::load_unaligned(p + k);
+    batch_type a = xsimd::load_unaligned(q + k);
+    batch_type b = xsimd::load_unaligned(r + k);
+    xsimd::store_unaligned(p + k, op(v, a, b));
+  }
+  return vn;
+}
+
+template<typename T, typename Op>
+inline std::size_t maskedTransformSimd(T* p, const bool* m, std::size_t n, Op& op, std::true_type)
+{
+  using batch_type = simd_batch<T>;
+  constexpr std::size_t size = batch_type::size;
+  std::size_t vn = n - n % size;
+  for (std::size_t k = 0; k < vn; k += size)
+  {
+    batch_type v = xsimd::load_unaligned(p + k);
+    xsimd::store_unaligned(p + k, op(v, loadMaskBatch<T>(m + k)));
+  }
+  return vn;
+}
+
+template<typename T>
+inline std::size_t nanSumCountSimd(const T* p, std::size_t n, T* sum, T* count, std::true_type)
+{
+  using batch_type = simd_batch<T>;
+  constexpr std::size_t size = batch_type::size;
+  std::size_t vn = n - n % size;
+  batch_type zero(T(0));
+  batch_type one(T(1));
+  for (std::size_t k = 0; k < vn; k += size)
+  {
+    batch_type v = xsimd::load_unaligned(p + k);
+    auto is_nan = xsimd::isnan(v);
+    xsimd::store_unaligned(sum + k, xsimd::load_unaligned(sum + k) + xsimd::select(is_nan, zero, v));
+    xsimd::store_unaligned(count + k, xsimd::load_unaligned(count + k) + xsimd::select(is_nan, zero, one));
+  }
+  return vn;
+}
+
+#endif
+
+// fallbacks for types without SIMD support
+
+template<typename T, typename Op>
+inline std::size_t unaryTransformSimd(T*, std::size_t, Op&, std::false_type) { return 0; }
+
+template<typename T, typename Op>
+inline std::size_t binaryTransformSimd(T*, const T*, std::size_t, Op&, std::false_type) { return 0; }
+
+template<typename T, typename Op>
+inline std::size_t ternaryTransformSimd(T*, const T*, const T*, std::size_t, Op&, std::false_type) { return 0; }
+
+template<typename T, typename Op>
+inline std::size_t maskedTransformSimd(T*, const bool*, std::size_t, Op&, std::false_type) { return 0; }
+
+template<typename T>
+inline std::size_t nanSumCountSimd(const T*, std::size_t, T*, T*, std::false_type) { return 0; }
+
+template<typename T>
+using SimdTag = std::integral_constant<bool, simdAvailable() && IsSimdType<T>::value>;
+
+/**
+ * Inplace apply an elementwise operation to a 1D range of data.
+ *
+ * The operation must provide 'T operator()(T)' and, if SIMD is available,
+ * a templated overload for batches. The SIMD path is only taken if the data
+ * are contiguous. The remaining tail is processed by the scalar path.
+ *
+ * @param p: pointer to the first element.
+ * @param sp: stride of the data in number of elements.
+ * @param n: number of elements.
+ * @param op: elementwise operation.
+ */
+template<typename T, typename Op>
+inline void unaryTransform(T* p, std::ptrdiff_t sp, std::size_t n, Op& op)
+{
+  std::size_t k = 0;
+  if (sp == 1 && simdEnabled()) k = unaryTransformSimd(p, n, op, SimdTag<T>());
+  for (; k < n; ++k) p[k * sp] = op(p[k * sp]);
+}
+
+/**
+ * Inplace apply an elementwise operation to a 1D range of data with
+ * another 1D range of arguments, e.g. correction constants.
+ */
+template<typename T, typename Op>
+inline void binaryTransform(T* p, std::ptrdiff_t sp, const T* q, std::ptrdiff_t sq, std::size_t n, Op& op)
+{
+  std::size_t k = 0;
+  if (sp == 1 && sq == 1 && simdEnabled()) k = binaryTransformSimd(p, q, n, op, SimdTag<T>());
+  for (; k < n; ++k) p[k * sp] = op(p[k * sp], q[k * sq]);
+}
+
+/**
+ * Inplace apply an elementwise operation to a 1D range of data with
+ * other two 1D ranges of arguments, e.g. gain and offset constants.
+ */
+template<typename T, typename Op>
+inline void ternaryTransform(T* p, std::ptrdiff_t sp,
+                             const T* q, std::ptrdiff_t sq,
+                             const T* r, std::ptrdiff_t sr,
+                             std::size_t n, Op& op)
+{
+  std::size_t k = 0;
+  if (sp == 1 && sq == 1 && sr == 1 && simdEnabled()) k = ternaryTransformSimd(p, q, r, n, op, SimdTag<T>());
+  for (; k < n; ++k) p[k * sp] = op(p[k * sp], q[k * sq], r[k * sr]);
+}
+
+/**
+ * Inplace apply an elementwise operation to a 1D range of data with a
+ * 1D range of a bool mask.
+ */
+template<typename T, typename Op>
+inline void maskedTransform(T* p, std::ptrdiff_t sp, const bool* m, std::ptrdiff_t sm, std::size_t n, Op& op)
+{
+  std::size_t k = 0;
+  if (sp == 1 && sm == 1 && simdEnabled()) k = maskedTransformSimd(p, m, n, op, SimdTag<T>());
+  for (; k < n; ++k) p[k * sp] = op(p[k * sp], m[k * sm]);
+}
+
+/**
+ * Accumulate the sum and the count of the non-nan elements of a 1D range of
+ * data into the contiguous arrays sum and count.
+ *
+ * @param p: pointer to the first element.
+ * @param sp: stride of the data in number of elements.
+ * @param n: number of elements.
+ * @param sum: pointer to the first element of the sums. size = n
+ * @param count: pointer to the first element of the counts. size = n
+ */
+template<typename T>
+inline void nanSumCount(const T* p, std::ptrdiff_t sp, std::size_t n, T* sum, T* count)
+{
+  std::size_t k = 0;
+  if (sp == 1 && simdEnabled()) k = nanSumCountSimd(p, n, sum, count, SimdTag<T>());
+  for (; k < n; ++k)
+  {
+    auto v = p[k * sp];
+    if (! std::isnan(v))
+    {
+      sum[k] += v;
+      count[k] += T(1);
+    }
+  }
+}
+
+} // detail
+
+} // foam
+
+#endif //EXTRA_FOAM_F_SIMD_HPP
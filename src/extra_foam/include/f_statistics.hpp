@@ -10,23 +10,1178 @@
 #ifndef EXTRA_FOAM_F_STATISTICS_HPP
 #define EXTRA_FOAM_F_STATISTICS_HPP
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "xtensor/xview.hpp"
 #include "xtensor/xmath.hpp"
 
-#if defined(FOAM_WITH_TBB)
-#include "tbb/parallel_for.h"
-#include "tbb/blocked_range2d.h"
-#include "tbb/blocked_range3d.h"
-#endif
-
 #include "f_traits.hpp"
+#include "f_simd.hpp"
+#include "f_parallel.hpp"
+#include "f_buffer_pool.hpp"
 
 
 namespace foam
 {
 
+namespace detail
+{
+
+template<typename T>
+inline bool isNan(T v) { return std::isnan(v); }
+
+template<typename T>
+inline T select(bool cond, T a, T b) { return cond ? a : b; }
+
+template<typename T>
+inline T minimum(T a, T b) { return a < b ? a : b; }
+
+template<typename T>
+inline T maximum(T a, T b) { return a > b ? a : b; }
+
+#if defined(FOAM_SIMD_AVAILABLE)
+
+template<typename T, std::size_t N>
+inline auto isNan(const xsimd::batch<T, N>& v) { return xsimd::isnan(v); }
+
+template<typename T, std::size_t N>
+inline xsimd::batch<T, N> select(const xsimd::batch_bool<T, N>& cond,
+                                 const xsimd::batch<T, N>& a, const xsimd::batch<T, N>& b)
+{
+  return xsimd::select(cond, a, b);
+}
+
+template<typename T, std::size_t N>
+inline xsimd::batch<T, N> minimum(const xsimd::batch<T, N>& a, const xsimd::batch<T, N>& b)
+{
+  return xsimd::min(a, b);
+}
+
+template<typename T, std::size_t N>
+inline xsimd::batch<T, N> maximum(const xsimd::batch<T, N>& a, const xsimd::batch<T, N>& b)
+{
+  return xsimd::max(a, b);
+}
+
+#endif
+
+/**
+ * Policies of the nan reductions.
+ *
+ * The state of a reduction consists of two values (a, b), where b is always
+ * the number of non-nan elements. 'add' is written for both scalars and
+ * SIMD batches. 'm' is the mean of the reduced elements, which is only
+ * used by NanSqDevPolicy.
+ */
+template<typename T>
+struct NanSumPolicy
+{
+  static constexpr bool needs_mean = false;
+
+  static T init() { return T(0); }
+
+  template<typename B>
+  static void add(B& a, B& b, const B& v, const B&)
+  {
+    auto is_nan = isNan(v);
+    a += select(is_nan, B(T(0)), v);
+    b += select(is_nan, B(T(0)), B(T(1)));
+  }
+
+  static void merge(T& a, T& b, T a2, T b2) { a += a2; b += b2; }
+
+  static T result(T a, T) { return a; }
+};
+
+template<typename T>
+struct NanMeanPolicy : NanSumPolicy<T>
+{
+  static T result(T a, T b) { return b == T(0) ? std::numeric_limits<T>::quiet_NaN() : a / b; }
+};
+
+template<typename T>
+struct NanSqDevPolicy : NanMeanPolicy<T>
+{
+  static constexpr bool needs_mean = true;
+
+  template<typename B>
+  static void add(B& a, B& b, const B& v, const B& m)
+  {
+    auto is_nan = isNan(v);
+    B d = v - m;
+    a += select(is_nan, B(T(0)), d * d);
+    b += select(is_nan, B(T(0)), B(T(1)));
+  }
+};
+
+template<typename T>
+struct NanMinPolicy
+{
+  static constexpr bool needs_mean = false;
+
+  static T init() { return std::numeric_limits<T>::infinity(); }
+
+  template<typename B>
+  static void add(B& a, B& b, const B& v, const B&)
+  {
+    auto is_nan = isNan(v);
+    a = select(is_nan, a, minimum(a, v));
+    b += select(is_nan, B(T(0)), B(T(1)));
+  }
+
+  static void merge(T& a, T& b, T a2, T b2) { a = minimum(a, a2); b += b2; }
+
+  static T result(T a, T b) { return b == T(0) ? std::numeric_limits<T>::quiet_NaN() : a; }
+};
+
+template<typename T>
+struct NanMaxPolicy : NanMinPolicy<T>
+{
+  static T init() { return -std::numeric_limits<T>::infinity(); }
+
+  template<typename B>
+  static void add(B& a, B& b, const B& v, const B&)
+  {
+    auto is_nan = isNan(v);
+    a = select(is_nan, a, maximum(a, v));
+    b += select(is_nan, B(T(0)), B(T(1)));
+  }
+
+  static void merge(T& a, T& b, T a2, T b2) { a = maximum(a, a2); b += b2; }
+};
+
+#if defined(FOAM_SIMD_AVAILABLE)
+
+template<typename Policy, typename T>
+inline std::size_t reduceRangeSimd(const T* p, std::size_t n, T m, T& a, T& b, std::true_type)
+{
+  using batch_type = simd_batch<T>;
+  constexpr std::size_t size = batch_type::size;
+  std::size_t vn = n - n % size;
+  if (vn == 0) return 0;
+
+  batch_type va(Policy::init());
+  batch_type vb(T(0));
+  batch_type vm(m);
+  for (std::size_t k = 0; k < vn; k += size)
+  {
+    batch_type v = xsimd::load_unaligned(p + k);
+    Policy::add(va, vb, v, vm);
+  }
+
+  alignas(64) T sa[size];
+  alignas(64) T sb[size];
+  xsimd::store_aligned(sa, va);
+  xsimd::store_aligned(sb, vb);
+  for (std::size_t l = 0; l < size; ++l) Policy::merge(a, b, sa[l], sb[l]);
+  return vn;
+}
+
+template<typename Policy, typename T>
+inline std::size_t reduceRowSimd(const T* p, std::size_t n, const T* m, T* a, T* b, std::true_type)
+{
+  using batch_type = simd_batch<T>;
+  constexpr std::size_t size = batch_type::size;
+  std::size_t vn = n - n % size;
+  batch_type zero(T(0));
+  for (std::size_t k = 0; k < vn; k += size)
+  {
+    batch_type v = xsimd::load_unaligned(p + k);
+    batch_type va = xsimd::load_unaligned(a + k);
+    batch_type vb = xsimd::load_unaligned(b + k);
+    Policy::add(va, vb, v, Policy::needs_mean ? batch_type(xsimd::load_unaligned(m + k)) : zero);
+    xsimd::store_unaligned(a + k, va);
+    xsimd::store_unaligned(b + k, vb);
+  }
+  return vn;
+}
+
+#endif
+
+template<typename Policy, typename T>
+inline std::size_t reduceRangeSimd(const T*, std::size_t, T, T&, T&, std::false_type) { return 0; }
+
+template<typename Policy, typename T>
+inline std::size_t reduceRowSimd(const T*, std::size_t, const T*, T*, T*, std::false_type) { return 0; }
+
+/**
+ * Reduce a 1D range of data onto the state (a, b).
+ *
+ * @param p: pointer to the first element.
+ * @param sp: stride of the data in number of elements.
+ * @param n: number of elements.
+ * @param m: mean of the reduced elements (NanSqDevPolicy only).
+ */
+template<typename Policy, typename T>
+inline void reduceRange(const T* p, std::ptrdiff_t sp, std::size_t n, T m, T& a, T& b)
+{
+  std::size_t k = 0;
+  if (sp == 1 && simdEnabled()) k = reduceRangeSimd<Policy>(p, n, m, a, b, SimdTag<T>());
+  for (; k < n; ++k) Policy::add(a, b, p[k * sp], m);
+}
+
+/**
+ * Reduce a 1D range of data element-wise onto the contiguous states (a, b).
+ *
+ * @param m: means of the reduced elements (NanSqDevPolicy only). size = n
+ */
+template<typename Policy, typename T>
+inline void reduceRow(const T* p, std::ptrdiff_t sp, std::size_t n, const T* m, T* a, T* b)
+{
+  std::size_t k = 0;
+  if (sp == 1 && simdEnabled()) k = reduceRowSimd<Policy>(p, n, m, a, b, SimdTag<T>());
+  for (; k < n; ++k) Policy::add(a[k], b[k], p[k * sp], Policy::needs_mean ? m[k] : T(0));
+}
+
+/**
+ * Return the offsets of all the elements spanned by the given axes.
+ */
+inline std::vector<std::ptrdiff_t> spanOffsets(const std::vector<std::size_t>& shape,
+                                               const std::vector<std::ptrdiff_t>& strides,
+                                               const std::vector<std::size_t>& axes)
+{
+  std::vector<std::ptrdiff_t> offsets {0};
+  for (auto ax : axes)
+  {
+    std::vector<std::ptrdiff_t> expanded;
+    expanded.reserve(offsets.size() * shape[ax]);
+    for (auto offset : offsets)
+    {
+      for (std::size_t i = 0; i < shape[ax]; ++i) expanded.push_back(offset + i * strides[ax]);
+    }
+    offsets.swap(expanded);
+  }
+  return offsets;
+}
+
+/**
+ * Layout of a reduction over arbitrary axes.
+ *
+ * If the last axis is reduced, each output is reduced from a collection of
+ * 1D ranges along the last axis. Otherwise, each output row (along the last
+ * axis) is reduced element-wise from a collection of 1D ranges along the last
+ * axis. In both cases, the innermost loop runs over the last axis, which is
+ * the contiguous one in general, and no intermediate array is materialized.
+ */
+struct ReductionLayout
+{
+  std::vector<std::size_t> out_shape;
+  bool inner; // whether the last axis is reduced
+  std::size_t n; // length of the last axis
+  std::ptrdiff_t stride; // stride of the last axis
+  std::vector<std::ptrdiff_t> out_offsets; // offsets of the outputs (inner) or the output rows (outer)
+  std::vector<std::ptrdiff_t> line_offsets; // offsets of the reduced ranges
+
+  std::size_t outSize() const { return inner ? out_offsets.size() : out_offsets.size() * n; }
+};
+
+template<typename E>
+inline ReductionLayout reductionLayout(const E& src, const std::vector<int>& axis)
+{
+  std::size_t nd = src.dimension();
+  if (nd == 0) throw std::invalid_argument("Reduction of a 0-dimensional array is not supported!");
+  std::vector<std::size_t> shape(src.shape().begin(), src.shape().end());
+  std::vector<std::ptrdiff_t> strides(src.strides().begin(), src.strides().end());
+
+  std::vector<bool> reduced(nd, false);
+  for (auto ax : axis)
+  {
+    int nax = ax < 0 ? ax + static_cast<int>(nd) : ax;
+    if (nax < 0 || nax >= static_cast<int>(nd))
+      throw std::invalid_argument("Axis " + std::to_string(ax) + " is out of bounds for an array of dimension "
+                                  + std::to_string(nd) + "!");
+    if (reduced[nax]) throw std::invalid_argument("Duplicated axis " + std::to_string(ax) + "!");
+    reduced[nax] = true;
+  }
+
+  ReductionLayout layout;
+  layout.inner = reduced[nd - 1];
+  layout.n = shape[nd - 1];
+  layout.stride = strides[nd - 1];
+
+  std::vector<std::size_t> kept_axes, reduced_axes;
+  for (std::size_t i = 0; i < nd - 1; ++i)
+  {
+    if (reduced[i]) reduced_axes.push_back(i);
+    else kept_axes.push_back(i);
+  }
+  for (auto i : kept_axes) layout.out_shape.push_back(shape[i]);
+  if (! layout.inner) layout.out_shape.push_back(shape[nd - 1]);
+
+  layout.out_offsets = spanOffsets(shape, strides, kept_axes);
+  layout.line_offsets = spanOffsets(shape, strides, reduced_axes);
+  return layout;
+}
+
+/**
+ * Nan reduction over the given axes.
+ *
+ * @param src: data.
+ * @param layout: layout of the reduction.
+ * @param out: pointer to the output, which is row-major with the shape
+ *             layout.out_shape.
+ * @param mean: pointer to the mean of the reduced elements with the same
+ *              layout as out (NanSqDevPolicy only).
+ */
+template<typename Policy, typename T>
+inline void nanReduceImp(const T* src, const ReductionLayout& layout, T* out, const T* mean)
+{
+  std::size_t n = layout.n;
+  std::ptrdiff_t stride = layout.stride;
+  const auto& out_offsets = layout.out_offsets;
+  const auto& line_offsets = layout.line_offsets;
+
+  if (layout.inner)
+  {
+    if (out_offsets.size() == 1)
+    {
+      // reduce everything to a single value
+      T m = Policy::needs_mean ? mean[0] : T(0);
+      auto state = parallelReduce(line_offsets.size(), std::array<T, 2>{Policy::init(), T(0)},
+        [=, &out_offsets, &line_offsets] (std::size_t begin, std::size_t end, std::array<T, 2> s)
+        {
+          for (std::size_t l = begin; l < end; ++l)
+          {
+            reduceRange<Policy>(src + out_offsets[0] + line_offsets[l], stride, n, m, s[0], s[1]);
+          }
+          return s;
+        },
+        [] (std::array<T, 2> s1, const std::array<T, 2>& s2)
+        {
+          Policy::merge(s1[0], s1[1], s2[0], s2[1]);
+          return s1;
+        }
+      );
+      out[0] = Policy::result(state[0], state[1]);
+      return;
+    }
+
+    parallelFor(out_offsets.size(), [=, &out_offsets, &line_offsets] (std::size_t begin, std::size_t end)
+    {
+      for (std::size_t o = begin; o < end; ++o)
+      {
+        T a = Policy::init();
+        T b = T(0);
+        T m = Policy::needs_mean ? mean[o] : T(0);
+        for (auto line_offset : line_offsets)
+        {
+          reduceRange<Policy>(src + out_offsets[o] + line_offset, stride, n, m, a, b);
+        }
+        out[o] = Policy::result(a, b);
+      }
+    });
+  } else
+  {
+    parallelForRows(out_offsets.size(), n,
+      [=, &out_offsets, &line_offsets] (std::size_t j, std::size_t k0, std::size_t nk)
+      {
+        T* a = out + j * n + k0;
+        const T* m = Policy::needs_mean ? mean + j * n + k0 : nullptr;
+        std::fill(a, a + nk, Policy::init());
+        PooledBuffer<T> b(nk, T(0));
+        for (auto line_offset : line_offsets)
+        {
+          reduceRow<Policy>(src + out_offsets[j] + line_offset + k0 * stride, stride, nk, m, a, b.data());
+        }
+        for (std::size_t k = 0; k < nk; ++k) a[k] = Policy::result(a[k], b[k]);
+      }
+    );
+  }
+}
+
+template<typename E>
+inline std::vector<int> allAxes(const E& src)
+{
+  std::vector<int> axis(src.dimension());
+  for (std::size_t i = 0; i < axis.size(); ++i) axis[i] = static_cast<int>(i);
+  return axis;
+}
+
+template<typename T>
+inline void nanVarImp(const T* src, const ReductionLayout& layout, T* out, bool take_sqrt)
+{
+  PooledBuffer<T> mean(layout.outSize());
+  nanReduceImp<NanMeanPolicy<T>, T>(src, layout, mean.data(), nullptr);
+  nanReduceImp<NanSqDevPolicy<T>, T>(src, layout, out, mean.data());
+  if (take_sqrt)
+  {
+    for (std::size_t i = 0; i < layout.outSize(); ++i) out[i] = std::sqrt(out[i]);
+  }
+}
+
+template<typename Policy, typename R, typename E>
+inline R nanReduce(const E& src, const std::vector<int>& axis)
+{
+  auto layout = reductionLayout(src, axis);
+  profiler::countAllocation();
+  auto out = R::from_shape(layout.out_shape);
+  if (layout.outSize() > 0)
+  {
+    nanReduceImp<Policy, typename E::value_type>(src.data(), layout, out.data(), nullptr);
+  }
+  return out;
+}
+
+/**
+ * Check that a pre-allocated output is a row-major array with the shape
+ * layout.out_shape.
+ */
+template<typename O>
+inline void checkReductionOutput(const ReductionLayout& layout, const O& out)
+{
+  const auto& shape = out.shape();
+  if (out.dimension() != layout.out_shape.size()
+      || ! std::equal(layout.out_shape.begin(), layout.out_shape.end(), shape.begin()))
+    throw std::invalid_argument("Output has a wrong shape!");
+
+  std::ptrdiff_t stride = 1;
+  for (std::size_t i = out.dimension(); i-- > 0;)
+  {
+    if (shape[i] != 1 && out.strides()[i] != stride)
+      throw std::invalid_argument("Output must be C-contiguous!");
+    stride *= static_cast<std::ptrdiff_t>(shape[i]);
+  }
+}
+
+template<typename Policy, typename E, typename O>
+inline void nanReduce(const E& src, const std::vector<int>& axis, O& out)
+{
+  auto layout = reductionLayout(src, axis);
+  checkReductionOutput(layout, out);
+  if (layout.outSize() > 0)
+  {
+    nanReduceImp<Policy, typename E::value_type>(src.data(), layout, out.data(), nullptr);
+  }
+}
+
+template<typename Policy, typename E>
+inline typename E::value_type nanReduce(const E& src)
+{
+  typename E::value_type out;
+  nanReduceImp<Policy, typename E::value_type>(src.data(), reductionLayout(src, allAxes(src)), &out, nullptr);
+  return out;
+}
+
+template<typename R, typename E>
+inline R nanVar(const E& src, const std::vector<int>& axis, bool take_sqrt)
+{
+  auto layout = reductionLayout(src, axis);
+  profiler::countAllocation();
+  auto out = R::from_shape(layout.out_shape);
+  if (layout.outSize() > 0) nanVarImp(src.data(), layout, out.data(), take_sqrt);
+  return out;
+}
+
+template<typename E, typename O>
+inline void nanVar(const E& src, const std::vector<int>& axis, O& out, bool take_sqrt)
+{
+  auto layout = reductionLayout(src, axis);
+  checkReductionOutput(layout, out);
+  if (layout.outSize() > 0) nanVarImp(src.data(), layout, out.data(), take_sqrt);
+}
+
+template<typename E>
+inline typename E::value_type nanVar(const E& src, bool take_sqrt)
+{
+  typename E::value_type out;
+  nanVarImp(src.data(), reductionLayout(src, allAxes(src)), &out, take_sqrt);
+  return out;
+}
+
+/**
+ * Apply a function to the elements [begin, end) of an array, where the
+ * elements are indexed in row-major order.
+ */
+template<typename T, typename F>
+inline void forEachElement(const T* src, const ReductionLayout& layout, std::size_t begin, std::size_t end, F&& f)
+{
+  if (begin >= end) return;
+
+  std::size_t n = layout.n;
+  std::ptrdiff_t stride = layout.stride;
+  std::size_t l = begin / n;
+  std::size_t k0 = begin % n;
+  while (begin < end)
+  {
+    const T* p = src + layout.line_offsets[l];
+    std::size_t k1 = std::min(n, k0 + end - begin);
+    for (std::size_t k = k0; k < k1; ++k) f(static_cast<double>(p[k * stride]));
+    begin += k1 - k0;
+    ++l;
+    k0 = 0;
+  }
+}
+
+/**
+ * Number of elements processed by a task in the histogram kernels.
+ */
+constexpr std::size_t kHistogramBlockSize = 4096;
+
+/**
+ * Uniform bins between the outer edges [lo, hi].
+ *
+ * The edges and the bin index arithmetic follow numpy.histogram, i.e. the
+ * edges are rounded to the data type and the last bin includes the upper
+ * edge.
+ */
+template<typename T>
+class UniformBins
+{
+  double lo_;
+  double hi_;
+  double norm_;
+  std::vector<double> edges_;
+
+public:
+
+  UniformBins(double lo, double hi, std::size_t n_bins)
+    : lo_(static_cast<T>(lo)), hi_(static_cast<T>(hi)), norm_(n_bins / (hi - lo)), edges_(n_bins + 1)
+  {
+    double step = (hi - lo) / n_bins;
+    for (std::size_t i = 0; i < n_bins; ++i) edges_[i] = static_cast<T>(lo + i * step);
+    edges_[0] = lo_;
+    edges_[n_bins] = hi_;
+  }
+
+  std::size_t size() const { return edges_.size() - 1; }
+
+  const std::vector<double>& edges() const { return edges_; }
+
+  // false for nan
+  bool contains(double v) const { return v >= lo_ && v <= hi_; }
+
+  std::size_t index(double v) const
+  {
+    std::size_t n_bins = size();
+    auto i = static_cast<std::size_t>((v - lo_) * norm_);
+    if (i >= n_bins) i = n_bins - 1;
+    // correct the rounding error of the fast path
+    if (v < edges_[i]) --i;
+    else if (i + 1 < n_bins && v >= edges_[i + 1]) ++i;
+    return i;
+  }
+};
+
+/**
+ * Determine the outer edges of a histogram from the bin range and the
+ * min/max of the data within the range.
+ *
+ * It follows statistics_py._get_outer_edges.
+ */
+inline std::pair<double, double> histogramOuterEdges(double lb, double ub, double v_min, double v_max,
+                                                     bool empty)
+{
+  if (! std::isfinite(lb) && ! std::isfinite(ub))
+  {
+    if (empty)
+    {
+      v_min = 0.;
+      v_max = 0.;
+    }
+    if (v_min == v_max)
+    {
+      v_min -= 0.5;
+      v_max += 0.5;
+    }
+  } else if (! std::isfinite(ub))
+  {
+    v_min = lb;
+    if (empty || v_max <= v_min) v_max = v_min + 1.;
+  } else if (! std::isfinite(lb))
+  {
+    v_max = ub;
+    if (empty || v_min >= v_max) v_min = v_max - 1.;
+  } else
+  {
+    v_min = lb;
+    v_max = ub;
+  }
+
+  if (! std::isfinite(v_min) || ! std::isfinite(v_max))
+  {
+    std::stringstream fmt;
+    fmt << "Finite outer edges cannot be found: (" << v_min << ", " << v_max << ")!";
+    throw std::invalid_argument(fmt.str());
+  }
+  return {v_min, v_max};
+}
+
+/**
+ * Counts and the shifted moments of a histogram.
+ */
+struct HistogramState
+{
+  std::vector<std::int64_t> counts;
+  double sum = 0.; // sum of (v - shift)
+  double sum2 = 0.; // sum of (v - shift)^2
+
+  void merge(const HistogramState& other)
+  {
+    for (std::size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+    sum += other.sum;
+    sum2 += other.sum2;
+  }
+};
+
+/**
+ * Find the median of the histogrammed data exactly.
+ *
+ * The bins which contain the middle element(s) are located from the
+ * cumulative counts, so that only the elements in these bins are collected
+ * and partially sorted.
+ */
+template<typename T>
+inline double histogramMedian(const T* src, const ReductionLayout& layout, std::size_t n_elements,
+                              const UniformBins<T>& bins, const std::vector<std::int64_t>& counts,
+                              std::int64_t count)
+{
+  std::int64_t r1 = (count - 1) / 2;
+  std::int64_t r2 = count / 2;
+
+  std::size_t b1 = 0;
+  std::int64_t offset = 0;
+  while (offset + counts[b1] <= r1) offset += counts[b1++];
+  std::size_t b2 = b1;
+  std::int64_t cum = offset + counts[b1];
+  while (cum <= r2) cum += counts[++b2];
+
+  std::size_t n_blocks = (n_elements + kHistogramBlockSize - 1) / kHistogramBlockSize;
+  auto selected = parallelReduce(n_blocks, std::vector<double>(),
+    [src, &layout, &bins, n_elements, b1, b2] (std::size_t begin, std::size_t end, std::vector<double> init)
+    {
+      forEachElement(src, layout, begin * kHistogramBlockSize, std::min(end * kHistogramBlockSize, n_elements),
+        [&init, &bins, b1, b2] (double v)
+        {
+          if (! bins.contains(v)) return;
+          auto i = bins.index(v);
+          if (i >= b1 && i <= b2) init.push_back(v);
+        }
+      );
+      return init;
+    },
+    [] (std::vector<double> v1, const std::vector<double>& v2)
+    {
+      v1.insert(v1.end(), v2.begin(), v2.end());
+      return v1;
+    }
+  );
+
+  auto it1 = selected.begin() + (r1 - offset);
+  std::nth_element(selected.begin(), it1, selected.end());
+  double v1 = *it1;
+  if (r2 == r1) return v1;
+  return 0.5 * (v1 + *std::min_element(it1 + 1, selected.end()));
+}
+
+} // detail
+
+/**
+ * Sum of the array elements over the given axes, treating nan as zero.
+ *
+ * Similar to numpy.nansum. The reduction does not materialize any
+ * intermediate array, even for multiple axes.
+ *
+ * @tparam R: type of the output array, e.g. xt::xarray or xt::pyarray.
+ *
+ * @param src: data, which must be a container with strides.
+ * @param axis: axes along which the reduction is performed.
+ */
+template<typename R, typename E>
+inline R nansum(const E& src, const std::vector<int>& axis)
+{
+  FOAM_PROFILE_SCOPE("nansum", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanSumPolicy<typename E::value_type>, R>(src, axis);
+}
+
+/**
+ * Sum of all the array elements, treating nan as zero.
+ */
+template<typename E>
+inline typename E::value_type nansum(const E& src)
+{
+  FOAM_PROFILE_SCOPE("nansum", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanSumPolicy<typename E::value_type>>(src);
+}
+
+/**
+ * Mean of the array elements over the given axes, ignoring nan.
+ */
+template<typename R, typename E>
+inline R nanmean(const E& src, const std::vector<int>& axis)
+{
+  FOAM_PROFILE_SCOPE("nanmean", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanMeanPolicy<typename E::value_type>, R>(src, axis);
+}
+
+/**
+ * Mean of all the array elements, ignoring nan.
+ */
+template<typename E>
+inline typename E::value_type nanmean(const E& src)
+{
+  FOAM_PROFILE_SCOPE("nanmean", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanMeanPolicy<typename E::value_type>>(src);
+}
+
+/**
+ * Variance of the array elements over the given axes, ignoring nan.
+ *
+ * It is computed with two passes over the data and the number of degrees
+ * of freedom is the number of non-nan elements (ddof = 0).
+ */
+template<typename R, typename E>
+inline R nanvar(const E& src, const std::vector<int>& axis)
+{
+  FOAM_PROFILE_SCOPE("nanvar", profiler::nBytes(src));
+  return detail::nanVar<R>(src, axis, false);
+}
+
+/**
+ * Variance of all the array elements, ignoring nan.
+ */
+template<typename E>
+inline typename E::value_type nanvar(const E& src)
+{
+  FOAM_PROFILE_SCOPE("nanvar", profiler::nBytes(src));
+  return detail::nanVar(src, false);
+}
+
+/**
+ * Standard deviation of the array elements over the given axes, ignoring nan.
+ */
+template<typename R, typename E>
+inline R nanstd(const E& src, const std::vector<int>& axis)
+{
+  FOAM_PROFILE_SCOPE("nanstd", profiler::nBytes(src));
+  return detail::nanVar<R>(src, axis, true);
+}
+
+/**
+ * Standard deviation of all the array elements, ignoring nan.
+ */
+template<typename E>
+inline typename E::value_type nanstd(const E& src)
+{
+  FOAM_PROFILE_SCOPE("nanstd", profiler::nBytes(src));
+  return detail::nanVar(src, true);
+}
+
+/**
+ * Minimum of the array elements over the given axes, ignoring nan.
+ *
+ * The result is nan if all the reduced elements are nan.
+ */
+template<typename R, typename E>
+inline R nanmin(const E& src, const std::vector<int>& axis)
+{
+  FOAM_PROFILE_SCOPE("nanmin", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanMinPolicy<typename E::value_type>, R>(src, axis);
+}
+
+/**
+ * Minimum of all the array elements, ignoring nan.
+ */
+template<typename E>
+inline typename E::value_type nanmin(const E& src)
+{
+  FOAM_PROFILE_SCOPE("nanmin", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanMinPolicy<typename E::value_type>>(src);
+}
+
+/**
+ * Maximum of the array elements over the given axes, ignoring nan.
+ *
+ * The result is nan if all the reduced elements are nan.
+ */
+template<typename R, typename E>
+inline R nanmax(const E& src, const std::vector<int>& axis)
+{
+  FOAM_PROFILE_SCOPE("nanmax", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanMaxPolicy<typename E::value_type>, R>(src, axis);
+}
+
+/**
+ * Maximum of all the array elements, ignoring nan.
+ */
+template<typename E>
+inline typename E::value_type nanmax(const E& src)
+{
+  FOAM_PROFILE_SCOPE("nanmax", profiler::nBytes(src));
+  return detail::nanReduce<detail::NanMaxPolicy<typename E::value_type>>(src);
+}
+
+/**
+ * Overloads of the nan reductions over the given axes which write the result
+ * to a pre-allocated array.
+ *
+ * @param out: output, which must be C-contiguous and have the shape of the
+ *             reduced array. It must have the same value type as src.
+ */
+template<typename E, typename O>
+inline void nansum(const E& src, const std::vector<int>& axis, O& out)
+{
+  FOAM_PROFILE_SCOPE("nansum", profiler::nBytes(src));
+  detail::nanReduce<detail::NanSumPolicy<typename E::value_type>>(src, axis, out);
+}
+
+template<typename E, typename O>
+inline void nanmean(const E& src, const std::vector<int>& axis, O& out)
+{
+  FOAM_PROFILE_SCOPE("nanmean", profiler::nBytes(src));
+  detail::nanReduce<detail::NanMeanPolicy<typename E::value_type>>(src, axis, out);
+}
+
+template<typename E, typename O>
+inline void nanvar(const E& src, const std::vector<int>& axis, O& out)
+{
+  FOAM_PROFILE_SCOPE("nanvar", profiler::nBytes(src));
+  detail::nanVar(src, axis, out, false);
+}
+
+template<typename E, typename O>
+inline void nanstd(const E& src, const std::vector<int>& axis, O& out)
+{
+  FOAM_PROFILE_SCOPE("nanstd", profiler::nBytes(src));
+  detail::nanVar(src, axis, out, true);
+}
+
+template<typename E, typename O>
+inline void nanmin(const E& src, const std::vector<int>& axis, O& out)
+{
+  FOAM_PROFILE_SCOPE("nanmin", profiler::nBytes(src));
+  detail::nanReduce<detail::NanMinPolicy<typename E::value_type>>(src, axis, out);
+}
+
+template<typename E, typename O>
+inline void nanmax(const E& src, const std::vector<int>& axis, O& out)
+{
+  FOAM_PROFILE_SCOPE("nanmax", profiler::nBytes(src));
+  detail::nanReduce<detail::NanMaxPolicy<typename E::value_type>>(src, axis, out);
+}
+
+/**
+ * Compute the histogram and the statistics of the elements of an array
+ * within the bin range, ignoring nan.
+ *
+ * The counts and the moments are accumulated in a single pass over the data
+ * with per-task histograms which are merged at the end. If the bin range is
+ * not finite, an additional pass is required to find the outer edges. The
+ * median is exact: it is located in the histogram and refined with the
+ * elements in the bin(s) containing it.
+ *
+ * @tparam H: type of the output counts, e.g. xt::xtensor<int64_t, 1>.
+ * @tparam B: type of the output bin centers, e.g. xt::xtensor<double, 1>.
+ *
+ * @param src: data.
+ * @param n_bins: number of bins.
+ * @param lb: lower boundary of the bin range. It can be -inf.
+ * @param ub: upper boundary of the bin range. It can be inf.
+ *
+ * @return: (counts, bin centers, mean, median, standard deviation). The
+ *          statistics are all nan if there is no element within the range.
+ */
+template<typename H, typename B, typename E>
+inline std::tuple<H, B, double, double, double>
+histogramWithStats(const E& src, std::size_t n_bins, double lb, double ub)
+{
+  FOAM_PROFILE_SCOPE("histogramWithStats", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+  constexpr std::size_t block_size = detail::kHistogramBlockSize;
+
+  if (n_bins == 0) throw std::invalid_argument("Number of bins must be positive!");
+  if (! (lb < ub)) throw std::invalid_argument("Lower boundary must be smaller than upper boundary!");
+
+  auto layout = detail::reductionLayout(src, detail::allAxes(src));
+  std::size_t n_elements = layout.line_offsets.size() * layout.n;
+  std::size_t n_blocks = (n_elements + block_size - 1) / block_size;
+  const value_type* data = src.data();
+
+  double v_min = lb;
+  double v_max = ub;
+  bool empty = false;
+  if (! std::isfinite(lb) || ! std::isfinite(ub))
+  {
+    auto state = detail::parallelReduce(n_blocks,
+      std::array<double, 3> {std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0.},
+      [data, &layout, n_elements, lb, ub] (std::size_t begin, std::size_t end, std::array<double, 3> s)
+      {
+        detail::forEachElement(data, layout, begin * block_size, std::min(end * block_size, n_elements),
+          [&s, lb, ub] (double v)
+          {
+            if (v >= lb && v <= ub)
+            {
+              if (v < s[0]) s[0] = v;
+              if (v > s[1]) s[1] = v;
+              s[2] += 1.;
+            }
+          }
+        );
+        return s;
+      },
+      [] (std::array<double, 3> s1, const std::array<double, 3>& s2)
+      {
+        s1[0] = std::min(s1[0], s2[0]);
+        s1[1] = std::max(s1[1], s2[1]);
+        s1[2] += s2[2];
+        return s1;
+      }
+    );
+    v_min = state[0];
+    v_max = state[1];
+    empty = state[2] == 0.;
+  }
+
+  auto edges = detail::histogramOuterEdges(lb, ub, v_min, v_max, empty);
+  detail::UniformBins<value_type> bins(edges.first, edges.second, n_bins);
+  // shift the data to reduce the cancellation error of the variance
+  double shift = 0.5 * (edges.first + edges.second);
+
+  detail::HistogramState identity;
+  identity.counts.resize(n_bins, 0);
+  auto state = detail::parallelReduce(n_blocks, identity,
+    [data, &layout, &bins, n_elements, shift] (std::size_t begin, std::size_t end, detail::HistogramState s)
+    {
+      detail::forEachElement(data, layout, begin * block_size, std::min(end * block_size, n_elements),
+        [&s, &bins, shift] (double v)
+        {
+          if (bins.contains(v))
+          {
+            ++s.counts[bins.index(v)];
+            double d = v - shift;
+            s.sum += d;
+            s.sum2 += d * d;
+          }
+        }
+      );
+      return s;
+    },
+    [] (detail::HistogramState s1, const detail::HistogramState& s2)
+    {
+      s1.merge(s2);
+      return s1;
+    }
+  );
+
+  std::array<std::size_t, 1> shape {n_bins};
+  profiler::countAllocation();
+  auto hist = H::from_shape(shape);
+  profiler::countAllocation();
+  auto centers = B::from_shape(shape);
+  std::int64_t count = 0;
+  const auto& bin_edges = bins.edges();
+  for (std::size_t i = 0; i < n_bins; ++i)
+  {
+    hist(i) = state.counts[i];
+    centers(i) = 0.5 * (bin_edges[i] + bin_edges[i + 1]);
+    count += state.counts[i];
+  }
+
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  if (count == 0) return std::make_tuple(std::move(hist), std::move(centers), nan, nan, nan);
+
+  double mean_shifted = state.sum / count;
+  double var = std::max(0., state.sum2 / count - mean_shifted * mean_shifted);
+  double median = detail::histogramMedian(data, layout, n_elements, bins, state.counts, count);
+  return std::make_tuple(std::move(hist), std::move(centers), shift + mean_shifted, median, std::sqrt(var));
+}
+
+namespace detail
+{
+
+// number of bins of the histogram used to estimate the image levels
+constexpr std::size_t kLevelBins = 1024;
+
+/**
+ * Estimate the (1 - q, q) quantiles of the finite elements.
+ *
+ * The quantiles are located in a histogram between the min and max of the
+ * data. The lower (upper) edge of the bin which contains the lower (upper)
+ * nearest rank is returned, so that the estimated range is never narrower
+ * than the exact one by more than a bin.
+ */
+template<typename T>
+inline std::pair<double, double> quickMinMaxImp(const T* data, const ReductionLayout& layout,
+                                                std::size_t n_elements, double q)
+{
+  constexpr std::size_t block_size = kHistogramBlockSize;
+  std::size_t n_blocks = (n_elements + block_size - 1) / block_size;
+
+  auto state = parallelReduce(n_blocks,
+    std::array<double, 3> {std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0.},
+    [data, &layout, n_elements] (std::size_t begin, std::size_t end, std::array<double, 3> s)
+    {
+      forEachElement(data, layout, begin * block_size, std::min(end * block_size, n_elements),
+        [&s] (double v)
+        {
+          if (std::isfinite(v))
+          {
+            if (v < s[0]) s[0] = v;
+            if (v > s[1]) s[1] = v;
+            s[2] += 1.;
+          }
+        }
+      );
+      return s;
+    },
+    [] (std::array<double, 3> s1, const std::array<double, 3>& s2)
+    {
+      s1[0] = std::min(s1[0], s2[0]);
+      s1[1] = std::max(s1[1], s2[1]);
+      s1[2] += s2[2];
+      return s1;
+    }
+  );
+
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  if (state[2] == 0.) return {nan, nan};
+  double v_min = state[0];
+  double v_max = state[1];
+  if (q == 1. || v_min == v_max) return {v_min, v_max};
+
+  UniformBins<T> bins(v_min, v_max, kLevelBins);
+  auto counts = parallelReduce(n_blocks, std::vector<std::int64_t>(kLevelBins, 0),
+    [data, &layout, &bins, n_elements] (std::size_t begin, std::size_t end, std::vector<std::int64_t> c)
+    {
+      forEachElement(data, layout, begin * block_size, std::min(end * block_size, n_elements),
+        [&c, &bins] (double v) { if (bins.contains(v)) ++c[bins.index(v)]; }
+      );
+      return c;
+    },
+    [] (std::vector<std::int64_t> c1, const std::vector<std::int64_t>& c2)
+    {
+      for (std::size_t i = 0; i < c1.size(); ++i) c1[i] += c2[i];
+      return c1;
+    }
+  );
+
+  // nearest ranks, rounded half to even as numpy.nanquantile
+  auto count = static_cast<std::int64_t>(state[2]);
+  auto r_lo = static_cast<std::int64_t>(std::nearbyint((1. - q) * (count - 1)));
+  auto r_hi = static_cast<std::int64_t>(std::nearbyint(q * (count - 1)));
+
+  const auto& edges = bins.edges();
+  std::size_t b = 0;
+  std::int64_t cum = counts[0];
+  while (cum <= r_lo) cum += counts[++b];
+  double lo = edges[b];
+  while (cum <= r_hi) cum += counts[++b];
+  return {lo, edges[b + 1]};
+}
+
+} // detail
+
+/**
+ * Estimate the levels of an image for display.
+ *
+ * Similar to statistics_py.quick_min_max, but without down-sampling the
+ * data. Non-finite elements are ignored. The quantiles are approximated
+ * by the bin edges of a histogram with kLevelBins bins.
+ *
+ * @param src: data.
+ * @param q: quantile within [0, 1]. The levels are the (1 - q, q)
+ *           quantiles. 1 for the min and max.
+ *
+ * @return: (lower, upper) levels, which are nan if there is no finite
+ *          element.
+ */
+template<typename E>
+inline std::pair<double, double> quickMinMax(const E& src, double q = 1.)
+{
+  FOAM_PROFILE_SCOPE("quickMinMax", profiler::nBytes(src));
+
+  if (! (q >= 0. && q <= 1.)) throw std::invalid_argument("Quantile must be within [0, 1]!");
+  if (q < 0.5) q = 1. - q;
+
+  auto layout = detail::reductionLayout(src, detail::allAxes(src));
+  std::size_t n_elements = layout.line_offsets.size() * layout.n;
+  return detail::quickMinMaxImp(src.data(), layout, n_elements, q);
+}
+
+/**
+ * Down-sample an image by averaging the non-nan pixels in blocks of
+ * rate x rate pixels.
+ *
+ * The blocks at the bottom and right edges are smaller if the shape is not
+ * a multiple of rate. A block without any non-nan pixel gives nan.
+ *
+ * @tparam R: type of the output image, e.g. xt::xtensor<T, 2>.
+ *
+ * @param src: image data. shape = (y, x)
+ * @param rate: down-sampling rate.
+ *
+ * @return: down-sampled image. shape = (ceil(y / rate), ceil(x / rate))
+ */
+template<typename R, typename E, EnableIf<E, IsImage> = false>
+inline R nanDownSampleImage(const E& src, std::size_t rate)
+{
+  FOAM_PROFILE_SCOPE("nanDownSampleImage", profiler::nBytes(src));
+  using value_type = typename E::value_type;
+
+  if (rate == 0) throw std::invalid_argument("Down-sampling rate must be positive!");
+
+  auto shape = src.shape();
+  std::size_t ny = shape[0];
+  std::size_t nx = shape[1];
+  std::size_t ny_out = (ny + rate - 1) / rate;
+  std::size_t nx_out = (nx + rate - 1) / rate;
+
+  profiler::countAllocation();
+  auto out = R::from_shape({ny_out, nx_out});
+
+  detail::parallelForRows(ny_out, nx_out,
+    [&src, &out, rate, ny, nx] (std::size_t j, std::size_t k0, std::size_t n)
+    {
+      PooledBuffer<value_type> sum(n, value_type(0));
+      PooledBuffer<value_type> count(n, value_type(0));
+
+      std::size_t x_end = std::min((k0 + n) * rate, nx);
+      for (std::size_t y = j * rate; y < std::min((j + 1) * rate, ny); ++y)
+      {
+        for (std::size_t x = k0 * rate; x < x_end; ++x)
+        {
+          auto v = src(y, x);
+          if (std::isnan(v)) continue;
+          std::size_t l = x / rate - k0;
+          sum[l] += v;
+          count[l] += value_type(1);
+        }
+      }
+
+      for (std::size_t l = 0; l < n; ++l)
+      {
+        out(j, k0 + l) = count[l] == 0 ? std::numeric_limits<value_type>::quiet_NaN() : sum[l] / count[l];
+      }
+    }
+  );
+
+  return out;
+}
+
+/**
+ * Down-sample an image and estimate the levels of the down-sampled image.
+ *
+ * It produces the image to display and its levels in one go.
+ *
+ * @return: (down-sampled image, lower level, upper level)
+ */
+template<typename R, typename E, EnableIf<E, IsImage> = false>
+inline std::tuple<R, double, double> nanDownSampleImageWithLevels(const E& src, std::size_t rate, double q)
+{
+  auto out = nanDownSampleImage<R>(src, rate);
+  auto levels = quickMinMax(out, q);
+  return std::make_tuple(std::move(out), levels.first, levels.second);
+}
+
 } // foam
 
 
@@ -0,0 +1,165 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xview.hpp"
+#include "xtensor/xmath.hpp"
+
+#include "f_azimuthal_integrator.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using ::testing::Each;
+using ::testing::FloatNear;
+
+auto inf = std::numeric_limits<double>::infinity();
+
+class AzimuthalIntegratorTest : public ::testing::Test
+{
+protected:
+  AzimuthalIntegratorTest() : integ_(0.2, 40 * 2e-4, 20 * 2e-4, 2e-4, 2e-4, 5e-10) {}
+
+  AzimuthalIntegrator integ_;
+  std::size_t ny_ = 128;
+  std::size_t nx_ = 64;
+  std::size_t npt_ = 16;
+};
+
+TEST_F(AzimuthalIntegratorTest, TestQMap)
+{
+  xt::xtensor<double, 2> q({ny_, nx_});
+  integ_.qMap(q);
+
+  // the poni is at the corner of pixel (40, 20)
+  double q0 = q(40, 20);
+  EXPECT_NEAR(q0, q(39, 20), 1e-12);
+  EXPECT_NEAR(q0, q(40, 19), 1e-12);
+  EXPECT_NEAR(q0, q(39, 19), 1e-12);
+  EXPECT_LT(q0, q(41, 20));
+  EXPECT_LT(q0, q(40, 21));
+}
+
+TEST_F(AzimuthalIntegratorTest, TestIntegrateImageArray)
+{
+  xt::xtensor<double, 2> q({ny_, nx_});
+  integ_.qMap(q);
+  xt::xtensor<float, 3> src({3, ny_, nx_});
+  for (std::size_t i = 0; i < 3; ++i) xt::view(src, i, xt::all(), xt::all()) = static_cast<float>(i + 1);
+
+  xt::xtensor<float, 2> dst({3, npt_});
+  integ_.integrate1d(src, dst, {-inf, inf});
+
+  const auto& radial = integ_.radial();
+  ASSERT_EQ(npt_, radial.size());
+  EXPECT_NEAR(xt::amin(q)(), radial[0] - 0.5 * (radial[1] - radial[0]), 1e-12);
+  EXPECT_NEAR(xt::amax(q)(), radial[npt_ - 1] + 0.5 * (radial[1] - radial[0]), 1e-12);
+
+  // the normalization is close to 1 for small scattering angles
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    auto row = xt::eval(xt::view(dst, i, xt::all()) / (i + 1.f));
+    EXPECT_THAT(row, Each(FloatNear(1.f, 0.1f)));
+  }
+
+  EXPECT_THROW(integ_.integrate1d(src, dst, {0.2, 0.1}), std::invalid_argument);
+  xt::xtensor<float, 2> dst_wrong({2, npt_});
+  EXPECT_THROW(integ_.integrate1d(src, dst_wrong, {0., 0.1}), std::invalid_argument);
+}
+
+TEST_F(AzimuthalIntegratorTest, TestMaskAndThreshold)
+{
+  xt::xtensor<float, 2> src({ny_, nx_});
+  src.fill(1.f);
+  xt::xtensor<float, 1> ref({npt_});
+  integ_.integrate1d(src, ref, {0., 0.09});
+
+  // masked pixels, pixels outside the threshold and nan pixels are ignored
+  xt::xtensor<bool, 2> mask = xt::zeros<bool>({ny_, nx_});
+  for (std::size_t j = 0; j < ny_; j += 2) mask(j, 3) = true;
+  for (std::size_t j = 0; j < ny_; j += 2) src(j, 3) = 100.f;
+  src(1, 5) = 200.f;
+  src(3, 7) = std::numeric_limits<float>::quiet_NaN();
+
+  xt::xtensor<float, 1> dst({npt_});
+  integ_.integrate1d(src, mask, dst, {0., 0.09}, {0., 10.});
+  for (std::size_t i = 0; i < npt_; ++i) EXPECT_NEAR(ref(i), dst(i), 1e-3);
+
+  // empty bins are set to 0
+  integ_.integrate1d(src, dst, {1., 2.});
+  EXPECT_THAT(dst, Each(0.f));
+
+  xt::xtensor<bool, 2> mask_wrong({ny_, nx_ + 1});
+  EXPECT_THROW(integ_.integrate1d(src, mask_wrong, dst, {0., 0.09}), std::invalid_argument);
+}
+
+TEST_F(AzimuthalIntegratorTest, TestIntegrateModules)
+{
+  // split the image into two modules and flip the second one vertically
+  std::size_t mh = ny_ / 2;
+  xt::xtensor<float, 3> src({2, ny_, nx_});
+  xt::xtensor<float, 4> modules({2, 2, mh, nx_});
+  xt::xtensor<int32_t, 4> pos({2, mh, nx_, 2});
+  for (std::size_t i = 0; i < 2; ++i)
+  {
+    for (std::size_t j = 0; j < ny_; ++j)
+    {
+      for (std::size_t k = 0; k < nx_; ++k) src(i, j, k) = static_cast<float>((i + 1) * (j + 2 * k));
+    }
+  }
+  for (std::size_t im = 0; im < 2; ++im)
+  {
+    for (std::size_t j = 0; j < mh; ++j)
+    {
+      std::size_t row = im == 0 ? j : ny_ - 1 - j;
+      for (std::size_t k = 0; k < nx_; ++k)
+      {
+        pos(im, j, k, 0) = static_cast<int32_t>(row);
+        pos(im, j, k, 1) = static_cast<int32_t>(k);
+        for (std::size_t i = 0; i < 2; ++i) modules(i, im, j, k) = src(i, row, k);
+      }
+    }
+  }
+
+  xt::xtensor<float, 2> dst({2, npt_});
+  EXPECT_THROW(integ_.integrate1d(modules, dst, {0., 0.09}), std::invalid_argument);
+
+  integ_.setPixelPositions(pos);
+  xt::xtensor<float, 2> ref({2, npt_});
+  integ_.integrate1d(src, ref, {0., 0.09});
+  integ_.integrate1d(modules, dst, {0., 0.09});
+  // the pixels in a bin are summed up in a different order
+  for (std::size_t i = 0; i < dst.size(); ++i) EXPECT_NEAR(ref.data()[i], dst.data()[i], 1e-3);
+
+  // ignored pixels are equivalent to nan pixels in the assembled image
+  xt::xtensor<bool, 3> mask = xt::zeros<bool>({2, mh, nx_});
+  mask(0, 1, 2) = true;
+  pos(1, 3, 4, 0) = -1;
+  pos(1, 3, 4, 1) = -1;
+  integ_.setPixelPositions(pos);
+  integ_.integrate1d(modules, mask, dst, {0., 0.09});
+  for (std::size_t i = 0; i < 2; ++i)
+  {
+    src(i, 1, 2) = std::numeric_limits<float>::quiet_NaN();
+    src(i, ny_ - 4, 4) = std::numeric_limits<float>::quiet_NaN();
+  }
+  integ_.integrate1d(src, ref, {0., 0.09});
+  for (std::size_t i = 0; i < dst.size(); ++i) EXPECT_NEAR(ref.data()[i], dst.data()[i], 1e-3);
+
+  xt::xtensor<bool, 3> mask_wrong({2, mh + 1, nx_});
+  EXPECT_THROW(integ_.integrate1d(modules, mask_wrong, dst, {0., 0.09}), std::invalid_argument);
+}
+
+} //test
+} //foam
@@ -0,0 +1,200 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "f_binning.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using ::testing::ElementsAre;
+
+TEST(TestUniformBins, TestGeneral)
+{
+  EXPECT_THROW(UniformBins(0, 0, 1), std::invalid_argument);
+  EXPECT_THROW(UniformBins(2, 1, 0), std::invalid_argument);
+  EXPECT_THROW(UniformBins(2, 0, std::nan("")), std::invalid_argument);
+
+  UniformBins bins(4, 1, 9);
+  EXPECT_EQ(4, bins.size());
+  EXPECT_THAT(bins.edges(), ElementsAre(1, 3, 5, 7, 9));
+
+  EXPECT_EQ(-1, bins.index(0.9));
+  EXPECT_EQ(0, bins.index(1));
+  EXPECT_EQ(0, bins.index(2.9));
+  EXPECT_EQ(1, bins.index(3));
+  EXPECT_EQ(3, bins.index(8.9));
+  // the last bin is closed
+  EXPECT_EQ(3, bins.index(9));
+  EXPECT_EQ(-1, bins.index(9.1));
+  EXPECT_EQ(-1, bins.index(std::nan("")));
+
+  UniformBins bins2(2, 1, 1);
+  EXPECT_THAT(bins2.edges(), ElementsAre(0.5, 1, 1.5));
+  EXPECT_EQ(1, bins2.index(1));
+}
+
+TEST(TestUniformBins, TestConsistentWithEdges)
+{
+  UniformBins bins(7, -0.3, 1.1);
+  const auto& edges = bins.edges();
+  for (int i = -20; i < 140; ++i)
+  {
+    double v = 0.01 * i;
+    // the same as numpy.searchsorted(edges, v, side='right') - 1
+    long expected = std::upper_bound(edges.begin(), edges.end(), v) - edges.begin() - 1;
+    if (v == edges.back()) expected = 6;
+    if (expected >= 7) expected = -1;
+    EXPECT_EQ(expected, bins.index(v));
+  }
+  for (std::size_t i = 0; i < bins.size(); ++i) EXPECT_EQ(static_cast<long>(i), bins.index(edges[i]));
+}
+
+TEST(TestBinning1D, TestRebin)
+{
+  std::vector<double> x {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  std::vector<double> fom {10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+
+  Binning1D sum_binning(UniformBins(4, 0, 8), BinStatistic::SUM);
+  sum_binning.rebin(x.data(), fom.data(), x.size());
+  EXPECT_THAT(sum_binning.counts(), ElementsAre(2, 2, 2, 3));
+  EXPECT_THAT(sum_binning.stats(), ElementsAre(21, 25, 29, 51));
+  EXPECT_TRUE(sum_binning.vfomHeat().empty());
+
+  Binning1D binning(UniformBins(4, 0, 8), BinStatistic::MEAN);
+  binning.rebin(x.data(), fom.data(), x.size());
+  EXPECT_THAT(binning.stats(), ElementsAre(10.5, 12.5, 14.5, 17));
+
+  EXPECT_EQ(-1, binning.update(-1, 100));
+  EXPECT_EQ(1, binning.update(2.5, 15.5));
+  EXPECT_THAT(binning.counts(), ElementsAre(2, 3, 2, 3));
+  EXPECT_THAT(binning.stats(), ElementsAre(10.5, 13.5, 14.5, 17));
+
+  // rebin discards the existing result
+  binning.rebin(x.data(), fom.data(), 2);
+  EXPECT_THAT(binning.counts(), ElementsAre(2, 0, 0, 0));
+  EXPECT_THAT(binning.stats(), ElementsAre(10.5, 0, 0, 0));
+}
+
+TEST(TestBinning1D, TestVfom)
+{
+  std::vector<double> x {0, 1, 2, 5};
+  std::vector<double> fom {1, 2, 3, 4};
+  // columnar history of VFOM with shape (4, 3), i.e. strides = (1, 4)
+  std::vector<double> vfom {1, 2, 3, 4,
+                            10, 20, 30, 40,
+                            100, 200, 300, 400};
+
+  Binning1D binning(UniformBins(2, 0, 4), BinStatistic::MEAN, 3);
+  EXPECT_THROW(binning.rebin(x.data(), fom.data(), x.size()), std::invalid_argument);
+  binning.rebin(x.data(), fom.data(), x.size(), vfom.data(), 1, 4);
+  EXPECT_THAT(binning.counts(), ElementsAre(2, 1));
+  // shape = (3, 2)
+  EXPECT_THAT(binning.vfomHeat(), ElementsAre(1.5, 3, 15, 30, 150, 300));
+
+  std::vector<double> v {5, 50, 500};
+  EXPECT_EQ(1, binning.update(3, 5, v.data()));
+  EXPECT_THAT(binning.vfomHeat(), ElementsAre(1.5, 4, 15, 40, 150, 400));
+  EXPECT_EQ(-1, binning.update(5, 5, v.data()));
+  EXPECT_THAT(binning.vfomHeat(), ElementsAre(1.5, 4, 15, 40, 150, 400));
+
+  // row-major history with strides = (3, 1)
+  std::vector<double> vfom_c {1, 10, 100,
+                              2, 20, 200,
+                              3, 30, 300,
+                              4, 40, 400};
+  Binning1D sum_binning(UniformBins(2, 0, 4), BinStatistic::SUM, 3);
+  sum_binning.rebin(x.data(), fom.data(), x.size(), vfom_c.data(), 3, 1);
+  EXPECT_THAT(sum_binning.vfomHeat(), ElementsAre(3, 3, 30, 30, 300, 300));
+  sum_binning.update(3, 5, v.data());
+  EXPECT_THAT(sum_binning.vfomHeat(), ElementsAre(3, 8, 30, 80, 300, 800));
+}
+
+TEST(TestBinning1D, TestNan)
+{
+  double nan = std::nan("");
+  std::vector<double> x {0, 1, 2, 3};
+  std::vector<double> fom {1, nan, 3, std::numeric_limits<double>::infinity()};
+  // columnar history of VFOM with shape (4, 2)
+  std::vector<double> vfom {1, 2, nan, 4,
+                            nan, 20, 30, 40};
+
+  Binning1D binning(UniformBins(2, 0, 4), BinStatistic::MEAN, 2);
+  binning.rebin(x.data(), fom.data(), x.size(), vfom.data(), 1, 4);
+  EXPECT_THAT(binning.counts(), ElementsAre(2, 2));
+  EXPECT_THAT(binning.stats(), ElementsAre(1, 3));
+  EXPECT_THAT(binning.vfomHeat(), ElementsAre(1.5, 4, 20, 35));
+
+  // the running mean is not poisoned
+  std::vector<double> v {nan, 5};
+  binning.update(0.5, nan, v.data());
+  EXPECT_THAT(binning.counts(), ElementsAre(3, 2));
+  EXPECT_THAT(binning.stats(), ElementsAre(1, 3));
+  EXPECT_THAT(binning.vfomHeat(), ElementsAre(1.5, 4, 12.5, 35));
+  binning.update(0.5, 4, v.data());
+  EXPECT_THAT(binning.stats(), ElementsAre(2.5, 3));
+
+  Binning1D sum_binning(UniformBins(2, 0, 4), BinStatistic::SUM);
+  sum_binning.rebin(x.data(), fom.data(), x.size());
+  EXPECT_THAT(sum_binning.stats(), ElementsAre(1, 3));
+  sum_binning.update(3, nan);
+  EXPECT_THAT(sum_binning.stats(), ElementsAre(1, 3));
+}
+
+TEST(TestBinning2D, TestGeneral)
+{
+  std::vector<double> x {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  std::vector<double> y {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  std::vector<double> fom {10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+
+  Binning2D binning(UniformBins(4, 1, 8), UniformBins(2, 2, 6), BinStatistic::SUM);
+  binning.rebin(x.data(), y.data(), fom.data(), x.size());
+  // shape = (2, 4)
+  EXPECT_THAT(binning.heatCount(), ElementsAre(2, 0, 0, 0,
+                                               0, 2, 1, 0));
+  EXPECT_THAT(binning.heat(), ElementsAre(23, 0, 0, 0,
+                                          0, 27, 15, 0));
+
+  EXPECT_EQ(-1, binning.update(0, 2, 1));
+  EXPECT_EQ(-1, binning.update(1, 7, 1));
+  EXPECT_EQ(7, binning.update(8, 6, 1));
+  EXPECT_THAT(binning.heatCount(), ElementsAre(2, 0, 0, 0,
+                                               0, 2, 1, 1));
+
+  Binning2D avg_binning(UniformBins(4, 1, 8), UniformBins(2, 2, 6), BinStatistic::MEAN);
+  avg_binning.rebin(x.data(), y.data(), fom.data(), x.size());
+  EXPECT_THAT(avg_binning.heat(), ElementsAre(11.5, 0, 0, 0,
+                                              0, 13.5, 15, 0));
+  avg_binning.update(3, 4, 10.5);
+  EXPECT_THAT(avg_binning.heat(), ElementsAre(11.5, 0, 0, 0,
+                                              0, 12.5, 15, 0));
+
+  // NaN FOM is counted but does not poison the statistic
+  avg_binning.update(3, 4, std::nan(""));
+  EXPECT_THAT(avg_binning.heatCount(), ElementsAre(2, 0, 0, 0,
+                                                   0, 4, 1, 0));
+  EXPECT_THAT(avg_binning.heat(), ElementsAre(11.5, 0, 0, 0,
+                                              0, 12.5, 15, 0));
+  fom[1] = std::nan("");
+  avg_binning.rebin(x.data(), y.data(), fom.data(), x.size());
+  EXPECT_THAT(avg_binning.heat(), ElementsAre(12, 0, 0, 0,
+                                              0, 13.5, 15, 0));
+}
+
+} // test
+} // foam
@@ -0,0 +1,123 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "xtensor/xtensor.hpp"
+
+#include "f_bitmask.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+
+TEST(TestBitMask, TestGeneral)
+{
+  BitMask empty;
+  EXPECT_EQ(0, empty.size());
+  EXPECT_EQ(0, empty.nWords());
+
+  BitMask mask(3, 70);
+  EXPECT_EQ(210, mask.size());
+  EXPECT_EQ(4, mask.nWords());
+  EXPECT_EQ(27, mask.nBytes());
+  EXPECT_FALSE(mask.any());
+
+  mask.set(0, 0);
+  mask.set(1, 69);
+  mask.set(2, 5);
+  EXPECT_TRUE(mask(0, 0));
+  EXPECT_TRUE(mask(1, 69));
+  EXPECT_FALSE(mask(1, 68));
+  EXPECT_EQ(3, mask.count());
+  mask.reset(1, 69);
+  EXPECT_FALSE(mask(1, 69));
+  EXPECT_EQ(2, mask.count());
+
+  // padding bits are not set
+  mask.fill(true);
+  EXPECT_EQ(210, mask.count());
+  mask.fill(false);
+  EXPECT_EQ(0, mask.count());
+}
+
+TEST(TestBitMask, TestPackbitsLayout)
+{
+  xt::xtensor<bool, 2> img_mask {{true, false, false, false, false, false, false, true, true},
+                                 {false, false, false, false, false, false, false, false, true}};
+  BitMask mask(img_mask);
+  ASSERT_EQ(3, mask.nBytes());
+  // identical to numpy.packbits
+  EXPECT_THAT(std::vector<uint8_t>(mask.bytes(), mask.bytes() + mask.nBytes()),
+              ElementsAre(0x81, 0x80, 0x40));
+
+  auto mask2 = BitMask::fromBytes(2, 9, mask.bytes(), mask.nBytes());
+  EXPECT_EQ(mask, mask2);
+  EXPECT_THROW(BitMask::fromBytes(2, 9, mask.bytes(), 2), std::invalid_argument);
+
+  // padding bits in the buffer are ignored
+  std::vector<uint8_t> buf {0x81, 0x80, 0x41};
+  EXPECT_EQ(mask, BitMask::fromBytes(2, 9, buf.data(), buf.size()));
+
+  xt::xtensor<bool, 2> out = xt::zeros<bool>({2, 9});
+  mask.toImageMask(out);
+  EXPECT_THAT(out, ElementsAreArray(img_mask));
+  xt::xtensor<bool, 2> out_w = xt::zeros<bool>({2, 8});
+  EXPECT_THROW(mask.toImageMask(out_w), std::invalid_argument);
+}
+
+TEST(TestBitMask, TestUnpack)
+{
+  std::size_t ny = 3, nx = 200;
+  BitMask mask(ny, nx);
+  for (std::size_t j = 0; j < ny; ++j)
+  {
+    for (std::size_t k = 0; k < nx; ++k) if ((j * nx + k) % 150 == 0) mask.set(j, k);
+  }
+
+  bool buf[200];
+  for (std::size_t j = 0; j < ny; ++j)
+  {
+    mask.unpack(j, 0, nx, buf);
+    for (std::size_t k = 0; k < nx; ++k) EXPECT_EQ((j * nx + k) % 150 == 0, buf[k]);
+    mask.unpack(j, 10, 100, buf);
+    for (std::size_t k = 0; k < 100; ++k) EXPECT_EQ((j * nx + k + 10) % 150 == 0, buf[k]);
+  }
+}
+
+TEST(TestBitMask, TestCombine)
+{
+  xt::xtensor<bool, 2> m1 {{true, false, true}, {false, false, true}};
+  xt::xtensor<bool, 2> m2 {{true, true, false}, {false, false, true}};
+  BitMask b1(m1);
+  BitMask b2(m2);
+
+  xt::xtensor<bool, 2> out = xt::zeros<bool>({2, 3});
+  (b1 | b2).toImageMask(out);
+  EXPECT_THAT(out, ElementsAre(true, true, true, false, false, true));
+  (b1 & b2).toImageMask(out);
+  EXPECT_THAT(out, ElementsAre(true, false, false, false, false, true));
+
+  b1 |= b2;
+  EXPECT_EQ(4, b1.count());
+  b1 &= b2;
+  EXPECT_EQ(b2, b1);
+
+  BitMask b3(3, 2);
+  EXPECT_THROW(b1 |= b3, std::invalid_argument);
+  EXPECT_THROW(b1 &= b3, std::invalid_argument);
+}
+
+} //test
+} //foam
@@ -0,0 +1,122 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cstdint>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "f_buffer_pool.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+namespace
+{
+
+bool isAligned(const void* p)
+{
+  return reinterpret_cast<std::uintptr_t>(p) % kBufferAlignment == 0;
+}
+
+} // namespace
+
+TEST(TestBufferPool, TestAlignment)
+{
+  BufferPool::local().clear();
+
+  for (std::size_t n : {1, 3, 64, 1000})
+  {
+    PooledBuffer<float> buf(n, 1.f);
+    EXPECT_TRUE(isAligned(buf.data()));
+    EXPECT_EQ(n, buf.size());
+    for (auto v : buf) EXPECT_EQ(1.f, v);
+  }
+
+  PooledBuffer<double> empty(0);
+  EXPECT_EQ(nullptr, empty.data());
+  EXPECT_EQ(empty.begin(), empty.end());
+}
+
+TEST(TestBufferPool, TestReuse)
+{
+  auto& pool = BufferPool::local();
+  pool.clear();
+  auto hits = pool.stats().hits;
+  auto misses = pool.stats().misses;
+
+  const float* p;
+  {
+    PooledBuffer<float> buf(100);
+    p = buf.data();
+  }
+  EXPECT_EQ(misses + 1, pool.stats().misses);
+  EXPECT_EQ(100 * sizeof(float), pool.stats().cached_bytes);
+
+  {
+    // blocks are keyed by their sizes in bytes
+    PooledBuffer<int32_t> buf(100, 0);
+    EXPECT_EQ(p, reinterpret_cast<const float*>(buf.data()));
+    EXPECT_EQ(hits + 1, pool.stats().hits);
+    EXPECT_EQ(0, pool.stats().cached_bytes);
+
+    PooledBuffer<float> buf2(100);
+    EXPECT_NE(p, buf2.data());
+    PooledBuffer<float> buf3(200);
+    EXPECT_EQ(misses + 3, pool.stats().misses);
+  }
+  EXPECT_EQ(400 * sizeof(float), pool.stats().cached_bytes);
+
+  pool.clear();
+  EXPECT_EQ(0, pool.stats().cached_bytes);
+}
+
+TEST(TestBufferPool, TestCapacity)
+{
+  auto& pool = BufferPool::local();
+  pool.clear();
+  auto capacity = BufferPool::capacity().load();
+  BufferPool::setCapacity(1000);
+
+  {
+    PooledBuffer<char> buf1(600);
+    PooledBuffer<char> buf2(600);
+  }
+  // only one of the blocks fits
+  EXPECT_EQ(600, pool.stats().cached_bytes);
+
+  BufferPool::setCapacity(capacity);
+  pool.clear();
+}
+
+TEST(TestBufferPool, TestThreadLocal)
+{
+  BufferPool::local().clear();
+  {
+    PooledBuffer<double> buf(10);
+  }
+
+  std::size_t cached = 1;
+  std::thread t([&cached] {
+    cached = BufferPool::local().stats().cached_bytes;
+    PooledBuffer<double> buf(10);
+  });
+  t.join();
+
+  // each thread has its own pool
+  EXPECT_EQ(0, cached);
+  EXPECT_EQ(10 * sizeof(double), BufferPool::local().stats().cached_bytes);
+  BufferPool::local().clear();
+}
+
+} // test
+} // foam
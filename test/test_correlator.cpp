@@ -0,0 +1,123 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "f_correlator.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+TEST(TestTrainCorrelator, TestGeneral)
+{
+  EXPECT_THROW(TrainCorrelator(0, 4), std::invalid_argument);
+  EXPECT_THROW(TrainCorrelator(33, 4), std::invalid_argument);
+  EXPECT_THROW(TrainCorrelator(3, 0), std::invalid_argument);
+
+  TrainCorrelator correlator(3, 4);
+  EXPECT_FALSE(correlator.hasCorrelated());
+  EXPECT_THROW(correlator.put(1000, 0), std::invalid_argument);
+  EXPECT_THROW(correlator.put(1000, 0b1000), std::invalid_argument);
+
+  EXPECT_EQ(CorrelationStatus::PENDING, correlator.put(1000, 0b001).status);
+  EXPECT_EQ(CorrelationStatus::PENDING, correlator.put(1001, 0b011).status);
+  EXPECT_EQ(CorrelationStatus::PENDING, correlator.put(1000, 0b010).status);
+  // the same source arrives twice
+  EXPECT_EQ(CorrelationStatus::PENDING, correlator.put(1000, 0b010).status);
+  EXPECT_EQ(CorrelationStatus::CORRELATED, correlator.put(1001, 0b100).status);
+  EXPECT_TRUE(correlator.hasCorrelated());
+  EXPECT_EQ(1001, correlator.correlatedTid());
+
+  // train 1000 is older than the last correlated train
+  EXPECT_EQ(CorrelationStatus::LATE, correlator.put(1000, 0b100).status);
+  EXPECT_EQ(CorrelationStatus::LATE, correlator.put(1001, 0b100).status);
+
+  EXPECT_EQ(CorrelationStatus::CORRELATED, correlator.put(1002, 0b111).status);
+  EXPECT_EQ(1002, correlator.correlatedTid());
+
+  EXPECT_EQ(2, correlator.nCorrelated());
+  EXPECT_EQ(0, correlator.nDropped());
+  EXPECT_EQ(2, correlator.nLate());
+
+  correlator.reset();
+  EXPECT_FALSE(correlator.hasCorrelated());
+  EXPECT_EQ(0, correlator.nCorrelated());
+  EXPECT_EQ(0, correlator.nLate());
+  EXPECT_EQ(CorrelationStatus::PENDING, correlator.put(1000, 0b001).status);
+}
+
+TEST(TestTrainCorrelator, TestEviction)
+{
+  TrainCorrelator correlator(2, 3);
+
+  for (uint64_t tid = 1000; tid < 1003; ++tid)
+  {
+    EXPECT_EQ(CorrelationStatus::PENDING, correlator.put(tid, 0b01).status);
+  }
+
+  // train 1003 takes the slot of train 1000
+  auto result = correlator.put(1003, 0b10);
+  EXPECT_EQ(CorrelationStatus::PENDING, result.status);
+  EXPECT_TRUE(result.evicted);
+  EXPECT_EQ(1000, result.evicted_tid);
+  EXPECT_EQ(0b01, result.evicted_sources);
+  EXPECT_EQ(1, correlator.nDropped());
+
+  // the sources of train 1000 arriving after the eviction are late
+  EXPECT_EQ(CorrelationStatus::LATE, correlator.put(1000, 0b10).status);
+  EXPECT_EQ(1, correlator.nLate());
+
+  EXPECT_EQ(CorrelationStatus::CORRELATED, correlator.put(1002, 0b10).status);
+  // train 1001 became stale once train 1002 was correlated
+  EXPECT_EQ(CorrelationStatus::LATE, correlator.put(1001, 0b10).status);
+
+  // a large jump of train ID
+  result = correlator.put(1000000, 0b11);
+  EXPECT_EQ(CorrelationStatus::CORRELATED, result.status);
+}
+
+TEST(TestTrainCorrelator, TestConcurrentPut)
+{
+  std::size_t n_sources = 8;
+  uint64_t n_trains = 2000;
+  TrainCorrelator correlator(n_sources, 64);
+
+  // each thread feeds a single source of all the trains
+  std::vector<std::thread> threads;
+  std::vector<uint64_t> n_correlated(n_sources, 0);
+  for (std::size_t i = 0; i < n_sources; ++i)
+  {
+    threads.emplace_back([&correlator, &n_correlated, i, n_trains] ()
+    {
+      for (uint64_t tid = 1; tid <= n_trains; ++tid)
+      {
+        if (correlator.put(tid, uint64_t(1) << i).status == CorrelationStatus::CORRELATED) ++n_correlated[i];
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  uint64_t total = 0;
+  for (auto n : n_correlated) total += n;
+  EXPECT_EQ(total, correlator.nCorrelated());
+  EXPECT_GT(total, 0);
+  // every train is either correlated, dropped or superseded by a newer train
+  EXPECT_LE(total, n_trains);
+  EXPECT_TRUE(correlator.hasCorrelated());
+  EXPECT_LE(correlator.correlatedTid(), n_trains);
+}
+
+} //test
+} //foam
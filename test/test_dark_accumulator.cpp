@@ -0,0 +1,206 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "xtensor/xtensor.hpp"
+
+#include "f_dark_accumulator.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+TEST(TestDarkAccumulator, TestPulseResolved)
+{
+  DarkAccumulator<float> acc;
+  EXPECT_EQ(0, acc.count());
+
+  float nan = std::nanf("");
+  xt::xtensor<float, 3> a1 {{{1, 2}, {nan, 4}}, {{5, 6}, {7, nan}}};
+  xt::xtensor<float, 3> a2 {{{3, 2}, {nan, 8}}, {{1, 6}, {nan, nan}}};
+  xt::xtensor<float, 3> a3 {{{5, 2}, {nan, 6}}, {{3, 6}, {1, nan}}};
+  acc.update(a1);
+  acc.update(a2);
+  acc.update(a3);
+  EXPECT_EQ(3, acc.count());
+  EXPECT_EQ((DarkAccumulator<float>::shape_type{2, 2, 2}), acc.shape());
+
+  const float* mean = acc.mean();
+  EXPECT_FLOAT_EQ(3.f, mean[0]);
+  EXPECT_FLOAT_EQ(2.f, mean[1]);
+  EXPECT_TRUE(std::isnan(mean[2]));
+  EXPECT_FLOAT_EQ(6.f, mean[3]);
+  EXPECT_FLOAT_EQ(3.f, mean[4]);
+  EXPECT_FLOAT_EQ(6.f, mean[5]);
+  EXPECT_FLOAT_EQ(4.f, mean[6]);
+  EXPECT_TRUE(std::isnan(mean[7]));
+
+  xt::xtensor<float, 3> sigma = xt::xtensor<float, 3>::from_shape({2, 2, 2});
+  acc.stddev(sigma);
+  EXPECT_FLOAT_EQ(std::sqrt(8.f / 3), sigma(0, 0, 0));
+  EXPECT_FLOAT_EQ(0.f, sigma(0, 0, 1));
+  EXPECT_TRUE(std::isnan(sigma(0, 1, 0)));
+  EXPECT_FLOAT_EQ(3.f, sigma(1, 1, 0));
+  acc.stddev(sigma, 1);
+  EXPECT_FLOAT_EQ(2.f, sigma(0, 0, 0));
+  EXPECT_FLOAT_EQ(std::sqrt(18.f), sigma(1, 1, 0));
+
+  xt::xtensor<uint32_t, 3> nan_count = xt::xtensor<uint32_t, 3>::from_shape({2, 2, 2});
+  acc.nanCount(nan_count);
+  EXPECT_EQ(0, nan_count(0, 0, 0));
+  EXPECT_EQ(3, nan_count(0, 1, 0));
+  EXPECT_EQ(1, nan_count(1, 1, 0));
+  EXPECT_EQ(3, nan_count(1, 1, 1));
+
+  xt::xtensor<float, 2> mean_image = xt::xtensor<float, 2>::from_shape({2, 2});
+  acc.meanImage(mean_image);
+  EXPECT_FLOAT_EQ(3.f, mean_image(0, 0));
+  EXPECT_FLOAT_EQ(4.f, mean_image(0, 1));
+  EXPECT_FLOAT_EQ(4.f, mean_image(1, 0));
+  EXPECT_FLOAT_EQ(6.f, mean_image(1, 1));
+
+  xt::xtensor<bool, 2> mask = xt::xtensor<bool, 2>::from_shape({2, 2});
+  acc.noiseMask(mask, 0.f, 2.f);
+  // sigma(1, 1, 0) > 2
+  EXPECT_FALSE(mask(0, 0));
+  EXPECT_FALSE(mask(0, 1));
+  EXPECT_TRUE(mask(1, 0));
+  // sigma(0, 1, 1) > 2
+  EXPECT_TRUE(mask(1, 1));
+  acc.noiseMask(mask, 0.1f, 10.f);
+  // sigma(0, 0, 1) == 0
+  EXPECT_TRUE(mask(0, 1));
+  EXPECT_FALSE(mask(0, 0));
+
+  xt::xtensor<float, 2> wrong = xt::xtensor<float, 2>::from_shape({2, 3});
+  EXPECT_THROW(acc.meanImage(wrong), std::invalid_argument);
+
+  acc.reset();
+  EXPECT_EQ(0, acc.count());
+  EXPECT_TRUE(std::isnan(acc.mean()[0]));
+  acc.update(a2);
+  EXPECT_FLOAT_EQ(3.f, acc.mean()[0]);
+
+  // shape changes
+  xt::xtensor<float, 3> b {{{1, 2, 3}}};
+  acc.update(b);
+  EXPECT_EQ(1, acc.count());
+  EXPECT_EQ((DarkAccumulator<float>::shape_type{1, 1, 3}), acc.shape());
+  EXPECT_FLOAT_EQ(3.f, acc.mean()[2]);
+}
+
+TEST(TestDarkAccumulator, TestTrainResolved)
+{
+  DarkAccumulator<double> acc;
+
+  xt::xtensor<double, 2> a1 {{1, 2}, {3, 4}};
+  xt::xtensor<double, 2> a2 {{3, 4}, {5, 6}};
+  acc.update(a1);
+  acc.update(a2);
+  EXPECT_EQ((DarkAccumulator<double>::shape_type{1, 2, 2}), acc.shape());
+  for (std::size_t i = 0; i < 4; ++i) EXPECT_DOUBLE_EQ(a1.data()[i] + 1, acc.mean()[i]);
+
+  xt::xtensor<double, 3> sigma = xt::xtensor<double, 3>::from_shape({1, 2, 2});
+  acc.stddev(sigma);
+  for (std::size_t i = 0; i < 4; ++i) EXPECT_DOUBLE_EQ(1., sigma.data()[i]);
+}
+
+TEST(TestDarkAccumulator, TestBlockedPartition)
+{
+  std::size_t n_cells = 3, ny = 4, nx = 37;
+  std::vector<xt::xtensor<float, 3>> arrs;
+  for (std::size_t t = 0; t < 4; ++t)
+  {
+    xt::xtensor<float, 3> arr = xt::xtensor<float, 3>::from_shape({n_cells, ny, nx});
+    for (std::size_t i = 0; i < arr.size(); ++i)
+    {
+      arr.data()[i] = (i + t) % 5 == 0 ? std::nanf("") : static_cast<float>((i * (t + 3)) % 11);
+    }
+    arrs.push_back(arr);
+  }
+
+  auto accumulate = [&arrs] (DarkAccumulator<float>& acc) { for (const auto& arr : arrs) acc.update(arr); };
+
+  DarkAccumulator<float> expected;
+  accumulate(expected);
+
+  // the column blocks must each be processed once
+  ScopedPartitionConfig scoped({PartitionMode::BLOCKED, 1, false});
+  DarkAccumulator<float> acc;
+  accumulate(acc);
+
+  std::size_t n = n_cells * ny * nx;
+  auto sigma = xt::xtensor<float, 3>::from_shape({n_cells, ny, nx});
+  auto sigma_expected = sigma;
+  acc.stddev(sigma);
+  auto nan_count = xt::xtensor<uint32_t, 3>::from_shape({n_cells, ny, nx});
+  auto nan_count_expected = nan_count;
+  acc.nanCount(nan_count);
+  {
+    ScopedPartitionConfig row({PartitionMode::ROW, 1, true});
+    expected.stddev(sigma_expected);
+    expected.nanCount(nan_count_expected);
+  }
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    if (std::isnan(expected.mean()[i])) EXPECT_TRUE(std::isnan(acc.mean()[i]));
+    else EXPECT_FLOAT_EQ(expected.mean()[i], acc.mean()[i]);
+    if (std::isnan(sigma_expected.data()[i])) EXPECT_TRUE(std::isnan(sigma.data()[i]));
+    else EXPECT_FLOAT_EQ(sigma_expected.data()[i], sigma.data()[i]);
+    EXPECT_EQ(nan_count_expected.data()[i], nan_count.data()[i]);
+  }
+
+  auto image = xt::xtensor<float, 2>::from_shape({ny, nx});
+  auto image_expected = image;
+  auto mask = xt::xtensor<bool, 2>::from_shape({ny, nx});
+  auto mask_expected = mask;
+  acc.meanImage(image);
+  acc.noiseMask(mask, 0.5f, 3.f);
+  {
+    ScopedPartitionConfig row({PartitionMode::ROW, 1, true});
+    expected.meanImage(image_expected);
+    expected.noiseMask(mask_expected, 0.5f, 3.f);
+  }
+  for (std::size_t i = 0; i < ny * nx; ++i)
+  {
+    EXPECT_FLOAT_EQ(image_expected.data()[i], image.data()[i]);
+    EXPECT_EQ(mask_expected.data()[i], mask.data()[i]);
+  }
+}
+
+TEST(TestDarkAccumulator, TestStrided)
+{
+  DarkAccumulator<float> acc;
+
+  // (x, y, memory cells) layout, e.g. from the bridge
+  std::array<uint16_t, 12> src;
+  for (std::size_t i = 0; i < src.size(); ++i) src[i] = static_cast<uint16_t>(i);
+  // shape = (2, 3, 2), strides = (1, 2, 6)
+  acc.update(src.data(), {2, 3, 2}, {1, 2, 6});
+  for (std::size_t i = 0; i < 2; ++i)
+  {
+    for (std::size_t j = 0; j < 3; ++j)
+    {
+      for (std::size_t k = 0; k < 2; ++k)
+      {
+        EXPECT_FLOAT_EQ(static_cast<float>(i + 2 * j + 6 * k), acc.mean()[(i * 3 + j) * 2 + k]);
+      }
+    }
+  }
+}
+
+} // test
+} // foam
@@ -0,0 +1,93 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xview.hpp"
+
+#include "f_digitizer.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using ::testing::ElementsAre;
+using ::testing::FloatEq;
+
+TEST(TestIntegratePulses, TestGeneral)
+{
+  using Integrals = xt::xtensor<float, 1>;
+
+  // baseline = 2
+  xt::xtensor<int16_t, 1> a {1, 3, 2, 2, 5, 6, -1, 2, 7, 9, 2, 2};
+
+  // pulses: {5, 6}, {7, 9}
+  auto ret = integratePulses<Integrals>(a, 0, 4, 4, 4, 2);
+  EXPECT_THAT(ret, ElementsAre(7.f, 12.f));
+  EXPECT_THAT(integratePulses<Integrals>(a, 0, 4, 4, 4, 2, 1), ElementsAre(7.f));
+
+  // no baseline subtraction
+  EXPECT_THAT(integratePulses<Integrals>(a, 3, 3, 4, 4, 2), ElementsAre(11.f, 16.f));
+
+  // a single pulse without period
+  EXPECT_THAT(integratePulses<Integrals>(a, 0, 4, 0, 0, 12), ElementsAre(FloatEq(16.f)));
+
+  // overlapped pulses
+  EXPECT_THAT(integratePulses<Integrals>(a, 0, 2, 4, 1, 3), ElementsAre(4.f, 1.f, 2.f, 12.f, 12.f, 7.f));
+
+  // write into a pre-allocated array
+  Integrals out = Integrals::from_shape({2});
+  integratePulses(a, 0, 4, 4, 4, 2, out);
+  EXPECT_THAT(out, ElementsAre(7.f, 12.f));
+
+  // strided waveform: {1, 2, 5, -1, 7, 2}
+  auto b = xt::view(a, xt::range(0, 12, 2));
+  EXPECT_THAT(integratePulses<Integrals>(b, 0, 2, 2, 2, 1), ElementsAre(3.5f, 5.5f));
+
+  // floating point samples
+  xt::xtensor<float, 1> c {0.5f, 0.5f, 1.f, 2.f, 3.f};
+  EXPECT_THAT(integratePulses<Integrals>(c, 0, 2, 2, 1, 2), ElementsAre(2.f, 4.f));
+}
+
+TEST(TestIntegratePulses, TestNoOverflow)
+{
+  using Integrals = xt::xtensor<float, 1>;
+
+  xt::xtensor<int16_t, 1> a = xt::xtensor<int16_t, 1>::from_shape({1000});
+  for (auto& v : a) v = 30000;
+  auto ret = integratePulses<Integrals>(a, 0, 0, 0, 0, 1000);
+  EXPECT_THAT(ret, ElementsAre(3.e7f));
+}
+
+TEST(TestIntegratePulses, TestInvalidWindows)
+{
+  using Integrals = xt::xtensor<float, 1>;
+
+  xt::xtensor<uint16_t, 1> a = xt::xtensor<uint16_t, 1>::from_shape({10});
+
+  EXPECT_THROW(integratePulses<Integrals>(a, 4, 2, 4, 4, 2), std::invalid_argument);
+  EXPECT_THROW(integratePulses<Integrals>(a, 0, 11, 4, 4, 2), std::out_of_range);
+  EXPECT_THROW(integratePulses<Integrals>(a, 0, 2, 4, 4, 0), std::invalid_argument);
+  EXPECT_THROW(integratePulses<Integrals>(a, 0, 2, 4, 0, 2, 2), std::invalid_argument);
+  EXPECT_THROW(integratePulses<Integrals>(a, 0, 2, 4, 4, 2, 3), std::out_of_range);
+
+  // no pulse fits in the waveform
+  EXPECT_EQ(0, integratePulses<Integrals>(a, 0, 2, 9, 4, 2).size());
+
+  Integrals out = Integrals::from_shape({3});
+  EXPECT_THROW(integratePulses(a, 0, 2, 4, 3, 2, out), std::out_of_range);
+}
+
+} //test
+} //foam
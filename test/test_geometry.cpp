@@ -105,6 +105,26 @@ TYPED_TEST(Geometry1M, testPositionAllModulesBridge)
   EXPECT_THAT(dst, ::testing::Each(1.f));
 }
 
+TYPED_TEST(Geometry1M, testPositionModule)
+{
+  xt::xtensor<float, 3> dst {
+      xt::empty<float>({2, static_cast<int>(this->shape[0]), static_cast<int>(this->shape[1])}) };
+  xt::xtensor<float, 3> ref {
+      xt::empty<float>({2, static_cast<int>(this->shape[0]), static_cast<int>(this->shape[1])}) };
+  dst.fill(-1.f);
+  ref.fill(-1.f);
+  xt::xtensor<float, 4> modules { xt::ones<float>({2, this->nm_, this->mh_, this->mw_}) };
+  for (auto im = 0; im < this->nm_; ++im) xt::view(modules, xt::all(), im, xt::all(), xt::all()) *= im;
+
+  // assembling the modules one by one is equivalent to assembling them all at once
+  for (auto im = 0; im < this->nm_; ++im) this->geom_->positionModule(modules, dst, im);
+  this->geom_->positionAllModules(modules, ref);
+  EXPECT_THAT(dst, ElementsAreArray(ref));
+
+  EXPECT_THROW(this->geom_->positionModule(modules, dst, this->nm_), std::invalid_argument);
+  EXPECT_THROW(this->geom_->positionModule(modules, dst, -1), std::invalid_argument);
+}
+
 TYPED_TEST(Geometry1M, testPositionAllModulesFile)
 {
   xt::xtensor<float, 3> dst {
@@ -116,6 +136,24 @@ TYPED_TEST(Geometry1M, testPositionAllModulesFile)
   EXPECT_THAT(dst, ::testing::Each(1.f));
 }
 
+TYPED_TEST(Geometry1M, testPositionAllModulesRawData)
+{
+  xt::xtensor<float, 3> dst {
+      xt::empty<float>({2, static_cast<int>(this->shape[0]), static_cast<int>(this->shape[1])}) };
+
+  xt::xtensor<uint16_t, 4> modules_u16 { 65535 * xt::ones<uint16_t>({2, this->nm_, this->mh_, this->mw_}) };
+  this->geom_->positionAllModules(modules_u16, dst);
+  EXPECT_THAT(dst, ::testing::Each(65535.f));
+
+  xt::xtensor<int16_t, 4> modules_i16 { -2 * xt::ones<int16_t>({2, this->nm_, this->mh_, this->mw_}) };
+  this->geom_->positionAllModules(modules_i16, dst);
+  EXPECT_THAT(dst, ::testing::Each(-2.f));
+
+  xt::xtensor<uint32_t, 4> modules_u32 { 100000 * xt::ones<uint32_t>({2, this->nm_, this->mh_, this->mw_}) };
+  this->geom_->positionAllModules(modules_u32, dst);
+  EXPECT_THAT(dst, ::testing::Each(100000.f));
+}
+
 TYPED_TEST(Geometry1M, testIgnoreTileEdge)
 {
   xt::xtensor<float, 3> dst {
@@ -185,5 +223,208 @@ TYPED_TEST(Geometry1M, testDismentalAllModules)
   EXPECT_THAT(dst_src, ::testing::Each(1.f));
 }
 
+TYPED_TEST(Geometry1M, testAssemblyRoundTrip)
+{
+  // every pixel has a unique value so that misplaced pixels can be detected
+  xt::xtensor<float, 4> src = xt::arange<float>(2 * this->nm_ * this->mh_ * this->mw_)
+    .reshape({2, this->nm_, this->mh_, this->mw_});
+  xt::xtensor<float, 3> dst {
+    xt::empty<float>({2, static_cast<int>(this->shape[0]), static_cast<int>(this->shape[1])}) };
+  dst.fill(this->nan);
+  xt::xtensor<float, 4> dst_src { xt::zeros<float>(src.shape()) };
+
+  this->geom_->positionAllModules(src, dst);
+  EXPECT_EQ(static_cast<std::size_t>(xt::sum(xt::isnan(dst))()), dst.size() - src.size());
+
+  this->geom_->dismantleAllModules(dst, dst_src);
+  EXPECT_EQ(src, dst_src);
+
+  // positioning the modules with tile edges ignored is a subset of the full assembling
+  xt::xtensor<float, 3> dst_ignore_edge { xt::empty<float>(dst.shape()) };
+  dst_ignore_edge.fill(this->nan);
+  this->geom_->positionAllModules(src, dst_ignore_edge, true);
+  auto edge = xt::isnan(dst_ignore_edge);
+  EXPECT_EQ(xt::eval(xt::where(edge, 0.f, dst)), xt::eval(xt::where(edge, 0.f, dst_ignore_edge)));
+}
+
+TYPED_TEST(Geometry1M, testPositionAllModulesCorrected)
+{
+  xt::xtensor<float, 4> src { 2.f * xt::ones<float>({2, this->nm_, this->mh_, this->mw_}) };
+  xt::xtensor<float, 3> gain { 3.f * xt::ones<float>({this->nm_, this->mh_, this->mw_}) };
+  xt::xtensor<float, 3> offset { xt::ones<float>({this->nm_, this->mh_, this->mw_}) };
+  xt::xtensor<float, 3> dst {
+    xt::empty<float>({2, static_cast<int>(this->shape[0]), static_cast<int>(this->shape[1])}) };
+
+  this->geom_->positionAllModules(src, dst, gain, offset);
+  EXPECT_THAT(dst, ::testing::Each(3.f));
+
+  xt::xtensor<bool, 3> mask { xt::zeros<bool>({this->nm_, this->mh_, this->mw_}) };
+  mask(0, 0, 0) = true;
+  mask(this->nm_ - 1, this->mh_ - 1, this->mw_ - 1) = true;
+  this->geom_->positionAllModules(src, dst, gain, offset, mask);
+  EXPECT_EQ(2 * 2, static_cast<int>(xt::sum(xt::isnan(dst))()));
+  EXPECT_EQ(3.f * (dst.size() - 4), xt::nansum(dst)());
+
+  xt::xtensor<float, 3> gain_wrong { xt::ones<float>({this->nm_ - 1, this->mh_, this->mw_}) };
+  EXPECT_THROW(this->geom_->positionAllModules(src, dst, gain_wrong, offset), std::invalid_argument);
+}
+
+TYPED_TEST(Geometry1M, testPixelPositions)
+{
+  xt::xtensor<float, 4> src = xt::arange<float>(this->nm_ * this->mh_ * this->mw_)
+    .reshape({1, this->nm_, this->mh_, this->mw_});
+  xt::xtensor<float, 3> dst {
+    xt::empty<float>({1, static_cast<int>(this->shape[0]), static_cast<int>(this->shape[1])}) };
+  this->geom_->positionAllModules(src, dst);
+
+  // assembling is equivalent to writing each pixel at its position
+  xt::xtensor<int32_t, 4> pos { xt::empty<int32_t>({this->nm_, this->mh_, this->mw_, 2}) };
+  this->geom_->pixelPositions(pos);
+  for (int im = 0; im < this->nm_; ++im)
+  {
+    for (int j = 0; j < this->mh_; ++j)
+    {
+      for (int k = 0; k < this->mw_; ++k)
+      {
+        ASSERT_EQ(src(0, im, j, k), dst(0, pos(im, j, k, 0), pos(im, j, k, 1)));
+      }
+    }
+  }
+
+  // tile edges are ignored
+  this->geom_->pixelPositions(pos, true);
+  auto n_ignored = static_cast<int>(xt::sum(xt::equal(xt::view(pos, xt::all(), xt::all(), xt::all(), 0), -1))());
+  int n_tiles = this->nm_ * TypeParam::n_tiles_per_module;
+  EXPECT_EQ(n_tiles * (this->tw_ * this->th_ - (this->tw_ - 2) * (this->th_ - 2)), n_ignored);
+  EXPECT_EQ(n_ignored, static_cast<int>(xt::sum(xt::equal(xt::view(pos, xt::all(), xt::all(), xt::all(), 1), -1))()));
+
+  xt::xtensor<int32_t, 4> pos_wrong { xt::empty<int32_t>({this->nm_, this->mh_, this->mw_, 3}) };
+  EXPECT_THROW(this->geom_->pixelPositions(pos_wrong), std::invalid_argument);
+}
+
+TEST(GenericGeometry, testStacked)
+{
+  GenericGeometry geom(3, {4, 5});
+  EXPECT_THAT(geom.assembledShape(), ElementsAre(12, 5));
+
+  xt::xtensor<float, 4> src = xt::arange<float>(2 * 3 * 4 * 5).reshape({2, 3, 4, 5});
+  xt::xtensor<float, 3> dst { xt::empty<float>({2, 12, 5}) };
+  geom.positionAllModules(src, dst);
+  // equivalent to stacking the modules vertically
+  EXPECT_THAT(dst, ElementsAreArray(src));
+
+  xt::xtensor<float, 4> dst_src { xt::zeros<float>(src.shape()) };
+  geom.dismantleAllModules(dst, dst_src);
+  EXPECT_EQ(src, dst_src);
+
+  xt::xtensor<float, 3> src_single = xt::view(src, 1, xt::all(), xt::all(), xt::all());
+  xt::xtensor<float, 2> dst_single { xt::empty<float>({12, 5}) };
+  geom.positionAllModules(src_single, dst_single);
+  EXPECT_EQ(xt::eval(xt::view(dst, 1, xt::all(), xt::all())), dst_single);
+
+  xt::xtensor<float, 4> src_wrong { xt::ones<float>({2, 2, 4, 5}) };
+  EXPECT_THROW(geom.positionAllModules(src_wrong, dst), std::invalid_argument);
+  xt::xtensor<float, 3> dst_wrong { xt::empty<float>({2, 13, 5}) };
+  EXPECT_THROW(geom.positionAllModules(src, dst_wrong), std::invalid_argument);
+  EXPECT_THROW(geom.positionModule(src, dst, 3), std::invalid_argument);
+}
+
+TEST(GenericGeometry, testTileOrientation)
+{
+  // two tiles of module 0 with a gap of one row in between, module 1 with
+  // the fast scan along -y and the slow scan along x
+  std::vector<GeometryTile> tiles {
+    {0, {0, 0}, {2, 6}, {0., 0.}, {1., 0.}, {0., 1.}},
+    {0, {2, 0}, {2, 6}, {0., 3.}, {1., 0.}, {0., 1.}},
+    {1, {0, 0}, {4, 6}, {8., 6.}, {0., -1.}, {1., 0.}}
+  };
+  GenericGeometry geom(2, {4, 6}, tiles);
+  EXPECT_THAT(geom.assembledShape(), ElementsAre(6, 12));
+
+  float nan = std::numeric_limits<float>::quiet_NaN();
+  xt::xtensor<float, 4> src = xt::arange<float>(2 * 4 * 6).reshape({1, 2, 4, 6});
+  xt::xtensor<float, 3> dst { xt::empty<float>({1, 6, 12}) };
+  dst.fill(nan);
+  geom.positionAllModules(src, dst);
+
+  EXPECT_EQ(xt::eval(xt::view(src, 0, 0, xt::range(0, 2), xt::all())),
+            xt::eval(xt::view(dst, 0, xt::range(0, 2), xt::range(0, 6))));
+  EXPECT_EQ(xt::eval(xt::view(src, 0, 0, xt::range(2, 4), xt::all())),
+            xt::eval(xt::view(dst, 0, xt::range(3, 5), xt::range(0, 6))));
+  EXPECT_THAT(xt::view(dst, 0, 2, xt::range(0, 8)), ::testing::Each(NanSensitiveFloatEq(nan)));
+  for (int ss = 0; ss < 4; ++ss)
+  {
+    for (int fs = 0; fs < 6; ++fs) EXPECT_EQ(src(0, 1, ss, fs), dst(0, 5 - fs, 8 + ss));
+  }
+
+  xt::xtensor<int32_t, 4> pos { xt::empty<int32_t>({2, 4, 6, 2}) };
+  geom.pixelPositions(pos);
+  EXPECT_THAT(xt::view(pos, 0, 2, 0, xt::all()), ElementsAre(3, 0));
+  EXPECT_THAT(xt::view(pos, 1, 0, 0, xt::all()), ElementsAre(5, 8));
+}
+
+TEST(GenericGeometry, testEquivalentTo1MGeometry)
+{
+  // first pixel positions of the default DSSC-1M geometry in pixels
+  int positions[16][2][2] {
+    {{   0,    0}, {-256,    0}},
+    {{   0,  128}, {-256,  128}},
+    {{   0,  256}, {-256,  256}},
+    {{   0,  384}, {-256,  384}},
+    {{   0, -512}, {-256, -512}},
+    {{   0, -384}, {-256, -384}},
+    {{   0, -256}, {-256, -256}},
+    {{   0, -128}, {-256, -128}},
+    {{   0,    0}, { 256,    0}},
+    {{   0, -128}, { 256, -128}},
+    {{   0, -256}, { 256, -256}},
+    {{   0, -384}, { 256, -384}},
+    {{   0,  512}, { 256,  512}},
+    {{   0,  384}, { 256,  384}},
+    {{   0,  256}, { 256,  256}},
+    {{   0,  128}, { 256,  128}},
+  };
+
+  std::vector<GeometryTile> tiles;
+  auto ts = DSSC_1MGeometry::tile_shape;
+  for (int im = 0; im < DSSC_1MGeometry::n_modules; ++im)
+  {
+    auto orient = DSSC_1MGeometry::quad_orientations[im / 4];
+    for (int it = 0; it < DSSC_1MGeometry::n_tiles_per_module; ++it)
+    {
+      tiles.push_back({im, {0, it * ts[1]}, ts,
+                       {static_cast<double>(positions[im][it][0]), static_cast<double>(positions[im][it][1])},
+                       {static_cast<double>(orient[0]), 0.}, {0., static_cast<double>(orient[1])}});
+    }
+  }
+
+  DSSC_1MGeometry geom_1m;
+  GenericGeometry geom(DSSC_1MGeometry::n_modules, DSSC_1MGeometry::module_shape, tiles);
+  EXPECT_EQ(geom_1m.assembledShape(), geom.assembledShape());
+
+  auto ms = DSSC_1MGeometry::module_shape;
+  xt::xtensor<int32_t, 4> pos_1m { xt::empty<int32_t>({DSSC_1MGeometry::n_modules, ms[0], ms[1], 2}) };
+  xt::xtensor<int32_t, 4> pos { xt::empty<int32_t>(pos_1m.shape()) };
+  for (bool ignore_tile_edge : {false, true})
+  {
+    geom_1m.pixelPositions(pos_1m, ignore_tile_edge);
+    geom.pixelPositions(pos, ignore_tile_edge);
+    EXPECT_EQ(pos_1m, pos);
+  }
+}
+
+TEST(GenericGeometry, testInvalidTiles)
+{
+  EXPECT_THROW(GenericGeometry(2, {4, 4}, {{2, {0, 0}, {4, 4}, {0., 0.}, {1., 0.}, {0., 1.}}}),
+               std::invalid_argument);
+  EXPECT_THROW(GenericGeometry(1, {4, 4}, {{0, {1, 0}, {4, 4}, {0., 0.}, {1., 0.}, {0., 1.}}}),
+               std::invalid_argument);
+  EXPECT_THROW(GenericGeometry(1, {4, 4}, {{0, {0, 0}, {4, 4}, {0., 0.}, {0.7, 0.7}, {0., 1.}}}),
+               std::invalid_argument);
+  EXPECT_THROW(GenericGeometry(1, {4, 4}, {{0, {0, 0}, {4, 4}, {0., 0.}, {1., 0.}, {-1., 0.}}}),
+               std::invalid_argument);
+  EXPECT_THROW(GenericGeometry(1, {4, 4}, {}), std::invalid_argument);
+}
+
 } //test
-} //foam
\ No newline at end of file
+} //foam
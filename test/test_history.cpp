@@ -0,0 +1,210 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "f_history.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using ::testing::ElementsAre;
+
+auto nan = std::numeric_limits<double>::quiet_NaN();
+
+template<typename T>
+std::vector<T> toVector(const T* p, std::size_t n)
+{
+  return std::vector<T>(p, p + n);
+}
+
+TEST(TestRunningStats, TestMerge)
+{
+  std::vector<double> a {1., 2., 3.};
+  std::vector<double> b {10., 20.};
+
+  RunningStats sa, sb, s;
+  for (auto v : a) { sa.push(v); s.push(v); }
+  for (auto v : b) { sb.push(v); s.push(v); }
+  sa.merge(sb);
+
+  EXPECT_EQ(5u, sa.count);
+  EXPECT_DOUBLE_EQ(s.mean, sa.mean);
+  EXPECT_DOUBLE_EQ(s.std(), sa.std());
+  EXPECT_DOUBLE_EQ(7.2, sa.mean);
+
+  RunningStats empty;
+  EXPECT_TRUE(std::isnan(empty.std()));
+  empty.merge(sb);
+  EXPECT_DOUBLE_EQ(15., empty.mean);
+  EXPECT_DOUBLE_EQ(5., empty.std());
+}
+
+TEST(TestHistoryBuffer, TestRing)
+{
+  HistoryBuffer h(3, 2);
+  EXPECT_EQ(3u, h.capacity());
+  EXPECT_EQ(2u, h.nColumns());
+  EXPECT_EQ(0u, h.size());
+
+  for (uint64_t i = 0; i < 5; ++i) h.append(1000 + i, i, {10. * i, i % 2 ? 1. : nan});
+
+  ASSERT_EQ(3u, h.size());
+  EXPECT_THAT(toVector(h.tids(), 3), ElementsAre(1002u, 1003u, 1004u));
+  EXPECT_THAT(toVector(h.x(), 3), ElementsAre(2., 3., 4.));
+  EXPECT_THAT(toVector(h.y(0), 3), ElementsAre(20., 30., 40.));
+  EXPECT_EQ(1., h.y(1)[1]);
+  EXPECT_TRUE(std::isnan(h.y(1)[2]));
+  EXPECT_EQ(0u, h.nBins());
+
+  h.clear();
+  EXPECT_EQ(0u, h.size());
+  h.append(1, 1., {1., 1.});
+  EXPECT_THAT(toVector(h.tids(), 1), ElementsAre(1u));
+
+  EXPECT_THROW(h.y(2), std::out_of_range);
+  EXPECT_THROW(h.append(1, 1., {1.}), std::invalid_argument);
+  EXPECT_THROW(HistoryBuffer(0, 1), std::invalid_argument);
+  EXPECT_THROW(HistoryBuffer(1, 0), std::invalid_argument);
+  EXPECT_THROW(HistoryBuffer(1, 1, -1.), std::invalid_argument);
+  EXPECT_THROW(h.setResolution(nan), std::invalid_argument);
+}
+
+TEST(TestHistoryBuffer, TestBins)
+{
+  HistoryBuffer h(10, 2, 0.1);
+
+  // the second location has only one sample, which is discarded
+  std::vector<double> xs {0., 0.05, 0.1, 1., 2., 2., 2.05};
+  std::vector<double> ys {1., 2., 3., 100., 10., 20., 30.};
+  for (std::size_t i = 0; i < xs.size(); ++i) h.append(i, xs[i], {ys[i], i == 4 ? 5. : nan});
+
+  ASSERT_EQ(2u, h.nBins());
+  EXPECT_DOUBLE_EQ(0.05, h.binX()[0]);
+  EXPECT_DOUBLE_EQ(6.05 / 3, h.binX()[1]);
+  EXPECT_THAT(toVector(h.binCount(), 2), ElementsAre(3u, 3u));
+  EXPECT_THAT(toVector(h.binMean(0), 2), ElementsAre(2., 20.));
+  EXPECT_DOUBLE_EQ(std::sqrt(2. / 3), h.binStd(0)[0]);
+  EXPECT_THAT(toVector(h.binCount(1), 2), ElementsAre(0u, 1u));
+  EXPECT_TRUE(std::isnan(h.binStd(1)[0]));
+  EXPECT_EQ(5., h.binMean(1)[1]);
+
+  // an incomplete bin is not reported
+  h.append(7, 5., {1., nan});
+  EXPECT_EQ(2u, h.nBins());
+  h.append(8, 5., {3., nan});
+  EXPECT_EQ(3u, h.nBins());
+
+  // the oldest bin is dropped
+  for (uint64_t i = 0; i < 16; ++i) h.append(9 + i, 10. + i / 2, {1., 1.});
+  EXPECT_EQ(10u, h.nBins());
+  EXPECT_EQ(10u, h.size());
+  EXPECT_DOUBLE_EQ(6.05 / 3, h.binX()[0]);
+  EXPECT_EQ(17., h.binX()[9]);
+
+  h.clear();
+  EXPECT_EQ(0u, h.nBins());
+}
+
+TEST(TestHistoryBuffer, TestSetResolution)
+{
+  HistoryBuffer h(10, 1, 0.1, 1);
+
+  std::vector<double> xs {0., 0., 0., 0.5, 0.5, 3.};
+  std::vector<double> ys {1., 2., 3., 10., 20., 7.};
+  for (std::size_t i = 0; i < xs.size(); ++i) h.append(i, xs[i], &ys[i]);
+  ASSERT_EQ(3u, h.nBins());
+
+  // coarser: the bins are merged
+  h.setResolution(1.);
+  ASSERT_EQ(2u, h.nBins());
+  EXPECT_THAT(toVector(h.binCount(), 2), ElementsAre(5u, 1u));
+  EXPECT_DOUBLE_EQ(0.2, h.binX()[0]);
+  EXPECT_DOUBLE_EQ(7.2, h.binMean(0)[0]);
+  EXPECT_NEAR(std::sqrt(((1. - 7.2) * (1. - 7.2) + (2. - 7.2) * (2. - 7.2) + (3. - 7.2) * (3. - 7.2) +
+                              (10. - 7.2) * (10. - 7.2) + (20. - 7.2) * (20. - 7.2)) / 5), h.binStd(0)[0], 1e-12);
+
+  // new samples are accumulated with the new resolution
+  h.append(6, 3.9, {9.});
+  EXPECT_EQ(2u, h.binCount()[1]);
+
+  // finer: the samples are re-binned
+  h.setResolution(0.1);
+  ASSERT_EQ(4u, h.nBins());
+  EXPECT_THAT(toVector(h.binCount(), 4), ElementsAre(3u, 2u, 1u, 1u));
+  EXPECT_THAT(toVector(h.binMean(0), 4), ElementsAre(2., 15., 7., 9.));
+
+  // no binning
+  h.setResolution(0.);
+  EXPECT_EQ(0u, h.nBins());
+  EXPECT_EQ(7u, h.size());
+
+  h.setResolution(10.);
+  ASSERT_EQ(1u, h.nBins());
+  EXPECT_EQ(7u, h.binCount()[0]);
+}
+
+TEST(TestHistoryBuffer, TestMergeOpenBin)
+{
+  HistoryBuffer h(10, 1, 0.1);
+
+  std::vector<double> xs {0., 0., 0.5, 0.5, 0.9};
+  std::vector<double> ys {1., 3., 5., 7., 100.};
+  for (std::size_t i = 0; i < xs.size(); ++i) h.append(i, xs[i], &ys[i]);
+  ASSERT_EQ(2u, h.nBins());
+
+  // the open bin is not merged into a completed one
+  h.setResolution(1.);
+  ASSERT_EQ(1u, h.nBins());
+  EXPECT_EQ(4u, h.binCount()[0]);
+  EXPECT_DOUBLE_EQ(0.25, h.binX()[0]);
+  EXPECT_DOUBLE_EQ(4., h.binMean(0)[0]);
+
+  // the open bin is completed by the next sample
+  h.append(5, 0.95, {200.});
+  ASSERT_EQ(2u, h.nBins());
+  EXPECT_EQ(2u, h.binCount()[1]);
+  EXPECT_DOUBLE_EQ(0.925, h.binX()[1]);
+  EXPECT_DOUBLE_EQ(150., h.binMean(0)[1]);
+}
+
+TEST(TestHistoryBuffer, TestMergeWrappedBins)
+{
+  HistoryBuffer h(3, 1, 0.1, 1);
+  for (int i = 0; i < 8; ++i)
+  {
+    double y = i;
+    h.append(i, i, &y);
+  }
+  ASSERT_EQ(3u, h.nBins());
+  EXPECT_THAT(toVector(h.binX(), 3), ElementsAre(5., 6., 7.));
+
+  h.setResolution(1.5);
+  ASSERT_EQ(1u, h.nBins());
+  EXPECT_DOUBLE_EQ(6., h.binX()[0]);
+  EXPECT_DOUBLE_EQ(6., h.binMean(0)[0]);
+
+  for (int i = 0; i < 4; ++i)
+  {
+    double y = i;
+    h.append(i, 100. + 10 * i, &y);
+  }
+  ASSERT_EQ(3u, h.nBins());
+  EXPECT_THAT(toVector(h.binX(), 3), ElementsAre(110., 120., 130.));
+}
+
+} //test
+} //foam
@@ -0,0 +1,120 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xrandom.hpp"
+#include "xtensor/xview.hpp"
+
+#include "f_image_codec.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using ::testing::Pointwise;
+using ::testing::NanSensitiveFloatEq;
+using ::testing::NanSensitiveFloatNear;
+
+auto nan = std::numeric_limits<float>::quiet_NaN();
+auto inf = std::numeric_limits<float>::infinity();
+
+TEST(TestImageCodec, TestHalfFloat)
+{
+  for (float v : {0.f, -0.f, 1.f, -2.5f, 65504.f, 6.1035156e-05f, 5.9604645e-08f, inf, -inf})
+  {
+    EXPECT_EQ(v, detail::halfToFloat(detail::floatToHalf(v)));
+  }
+  EXPECT_TRUE(std::isnan(detail::halfToFloat(detail::floatToHalf(nan))));
+
+  // round to nearest even
+  EXPECT_EQ(0x3c00, detail::floatToHalf(1.f + 1.f / 2048));
+  EXPECT_EQ(0x3c02, detail::floatToHalf(1.f + 3.f / 2048));
+  // overflow and underflow
+  EXPECT_EQ(0x7c00, detail::floatToHalf(65520.f));
+  EXPECT_EQ(0x0000, detail::floatToHalf(1e-8f));
+}
+
+TEST(TestImageCodec, TestLz)
+{
+  xt::random::seed(42);
+  for (std::size_t n : {0, 1, 4, 100, 100000})
+  {
+    // half of the bytes are random and the others are in short runs
+    xt::xtensor<uint8_t, 1> src = xt::random::randint<uint8_t>({n}, 0, 255);
+    for (std::size_t i = 0; i < n; i += 2) src(i) = static_cast<uint8_t>(i / 64);
+
+    std::vector<uint8_t> compressed;
+    detail::lzCompress(src.data(), n, compressed);
+    std::vector<uint8_t> decompressed(n);
+    detail::lzDecompress(compressed.data(), compressed.size(), decompressed.data(), n);
+    EXPECT_THAT(decompressed, ::testing::ElementsAreArray(src.begin(), src.end()));
+
+    if (n > 0)
+    {
+      EXPECT_THROW(detail::lzDecompress(compressed.data(), compressed.size() - 1, decompressed.data(), n),
+                   std::invalid_argument);
+    }
+  }
+}
+
+TEST(TestImageCodec, TestRoundTrip)
+{
+  using Images = xt::xtensor<float, 3>;
+
+  xt::random::seed(42);
+  Images src = xt::random::rand<float>({4, 32, 50}, 0.f, 100.f);
+  for (std::size_t i = 0; i < src.size(); i += 7) src.data()[i] = nan;
+  src(0, 0, 1) = inf;
+  // an image without finite pixels and a constant image
+  xt::view(src, 1, xt::all(), xt::all()) = nan;
+  xt::view(src, 2, xt::all(), xt::all()) = 7.f;
+
+  // non-finite pixels are decoded as NaN by the quantized codecs
+  Images src_nan = src;
+  src_nan(0, 0, 1) = nan;
+
+  Images out = Images::from_shape(src.shape());
+
+  auto encoded = encodeImages(src, ImageCodec::FLOAT32);
+  decodeImages(encoded.data(), encoded.size(), ImageCodec::FLOAT32, out);
+  EXPECT_THAT(out, Pointwise(NanSensitiveFloatEq(), src));
+
+  encoded = encodeImages(src, ImageCodec::FLOAT16);
+  decodeImages(encoded.data(), encoded.size(), ImageCodec::FLOAT16, out);
+  EXPECT_THAT(out, Pointwise(NanSensitiveFloatNear(0.05f), src));
+
+  // the step is (max - min) / (2^n - 2)
+  for (auto codec : {ImageCodec::UINT16, ImageCodec::UINT8})
+  {
+    float atol = codec == ImageCodec::UINT16 ? 1e-3f : 0.25f;
+    encoded = encodeImages(src, codec);
+    EXPECT_LT(encoded.size(), src.size() * codecItemSize(codec));
+    decodeImages(encoded.data(), encoded.size(), codec, out);
+    EXPECT_THAT(out, Pointwise(NanSensitiveFloatNear(atol), src_nan));
+  }
+
+  EXPECT_THROW(decodeImages(encoded.data(), encoded.size() - 1, ImageCodec::UINT8, out),
+               std::invalid_argument);
+  EXPECT_THROW(decodeImages(encoded.data(), encoded.size(), ImageCodec::UINT16, out),
+               std::invalid_argument);
+  Images out_small = Images::from_shape({3, 32, 50});
+  EXPECT_THROW(decodeImages(encoded.data(), encoded.size(), ImageCodec::UINT8, out_small),
+               std::invalid_argument);
+}
+
+} //test
+} //foam
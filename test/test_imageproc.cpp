@@ -8,6 +8,7 @@
  * All rights reserved.
  */
 #include <array>
+#include <tuple>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -61,6 +62,13 @@ TEST(TestNanmeanImageArray, TestTwoImages)
   xt::xtensor<float, 2> img3 {{1.f, 2.f, 3.f}, {inf, nan, nan}};
   EXPECT_THAT(nanmeanImageArray(img1, img3), ElementsAre(1.f, -inf, 2.5, inf, 5.f, nan_mt));
 
+  // output
+  auto out = xt::xtensor<float, 2>::from_shape({2, 3});
+  nanmeanImageArray(img1, img2, out);
+  EXPECT_THAT(out, ElementsAreArray(ret_gt));
+  auto out_wrong = xt::xtensor<float, 2>::from_shape({3, 2});
+  EXPECT_THROW(nanmeanImageArray(img1, img2, out_wrong), std::invalid_argument);
+
   // rvalue
   EXPECT_THAT(nanmeanImageArray(std::move(img1), std::move(img2)), ElementsAreArray(ret_gt));
 }
@@ -263,6 +271,99 @@ TEST(TestMaskImageData, Test3DBothMask)
   testMaskImageData(maskImageDataNan<xt::xtensor<float, 3>, xt::xtensor<bool, 2>, float>, nan_mt);
 }
 
+TEST(TestMaskImageData, TestBitMask)
+{
+  xt::xtensor<bool, 2> img_mask {{true, true, false}, {true, false, false}};
+  BitMask mask(img_mask);
+  BitMask mask_w(2, 2);
+
+  auto test2D = [&mask, &mask_w](auto f, auto f_th, auto mt)
+  {
+    xt::xtensor<float, 2> img {{1.f, 2.f, 3.f}, {4.f, 5.f, nan}};
+    EXPECT_THROW(f(img, mask_w), std::invalid_argument);
+    f(img, mask);
+    EXPECT_THAT(img, ElementsAre(mt, mt, 3.f, mt, 5.f, mt));
+
+    xt::xtensor<float, 2> img2 {{1.f, 2.f, 3.f}, {4.f, 5.f, nan}};
+    f_th(img2, mask, 2.f, 4.f);
+    EXPECT_THAT(img2, ElementsAre(mt, mt, 3.f, mt, mt, mt));
+  };
+
+  test2D([](auto& src, const auto& m) { maskImageDataZero(src, m); },
+         [](auto& src, const auto& m, float lb, float ub) { maskImageDataZero(src, m, lb, ub); }, zero_mt);
+  test2D([](auto& src, const auto& m) { maskImageDataNan(src, m); },
+         [](auto& src, const auto& m, float lb, float ub) { maskImageDataNan(src, m, lb, ub); }, nan_mt);
+
+  auto test3D = [&mask, &mask_w](auto f, auto f_th, auto mt)
+  {
+    xt::xtensor<float, 3> imgs {{{1.f, 2.f, 3.f}, {4.f, 5.f, 6.f}}, {{2.f, 3.f, nan}, {5.f, 6.f, 7.f}}};
+    EXPECT_THROW(f(imgs, mask_w), std::invalid_argument);
+    auto imgs2 = imgs;
+    f(imgs, mask);
+    EXPECT_THAT(xt::view(imgs, 0, xt::all(), xt::all()), ElementsAre(mt, mt, 3.f, mt, 5.f, 6.f));
+    EXPECT_THAT(xt::view(imgs, 1, xt::all(), xt::all()), ElementsAre(mt, mt, mt, mt, 6.f, 7.f));
+
+    f_th(imgs2, mask, 2.f, 4.f);
+    EXPECT_THAT(xt::view(imgs2, 0, xt::all(), xt::all()), ElementsAre(mt, mt, 3.f, mt, mt, mt));
+    EXPECT_THAT(xt::view(imgs2, 1, xt::all(), xt::all()), ElementsAre(mt, mt, mt, mt, mt, mt));
+  };
+
+  test3D([](auto& src, const auto& m) { maskImageDataZero(src, m); },
+         [](auto& src, const auto& m, float lb, float ub) { maskImageDataZero(src, m, lb, ub); }, zero_mt);
+  test3D([](auto& src, const auto& m) { maskImageDataNan(src, m); },
+         [](auto& src, const auto& m, float lb, float ub) { maskImageDataNan(src, m, lb, ub); }, nan_mt);
+
+  // bit-packed and bool masks are interchangeable
+  std::size_t ny = 3, nx = 130;
+  xt::xtensor<bool, 2> large_mask = xt::zeros<bool>({ny, nx});
+  for (std::size_t j = 0; j < ny; ++j)
+  {
+    for (std::size_t k = 0; k < nx; ++k) large_mask(j, k) = (j * nx + k) % 7 == 0;
+  }
+  xt::xtensor<float, 3> imgs1 = xt::ones<float>({2, ny, nx});
+  xt::xtensor<float, 3> imgs2 = xt::ones<float>({2, ny, nx});
+  maskImageDataZero(imgs1, large_mask);
+  maskImageDataZero(imgs2, BitMask(large_mask));
+  EXPECT_THAT(imgs1, ElementsAreArray(imgs2));
+}
+
+TEST(TestMaskImageData, TestBitMaskWithOutput)
+{
+  xt::xtensor<bool, 2> img_mask {{true, false, false}, {true, false, false}};
+  BitMask mask(img_mask);
+  xt::xtensor<bool, 2> out_gt = xt::zeros<bool>({2, 3});
+
+  xt::xtensor<float, 2> img {{1.f, 2.f, nan}, {3.f, 4.f, 5.f}};
+  BitMask nan_out(2, 3);
+  BitMask out_w(2, 2);
+  EXPECT_THROW(imageDataNanMask(img, out_w), std::invalid_argument);
+  imageDataNanMask(img, nan_out);
+  nan_out.toImageMask(out_gt);
+  EXPECT_THAT(out_gt, ElementsAre(false, false, true, false, false, false));
+
+  BitMask threshold_out(2, 3);
+  EXPECT_THROW(imageDataThresholdMask(img, 2.f, 3.f, out_w), std::invalid_argument);
+  imageDataThresholdMask(img, 2.f, 3.f, threshold_out);
+  threshold_out.toImageMask(out_gt);
+  EXPECT_THAT(out_gt, ElementsAre(true, false, true, false, true, true));
+
+  auto testWithOutput = [&mask](auto f, auto mt)
+  {
+    xt::xtensor<float, 2> img {{1.f, 2.f, nan}, {3.f, 4.f, 5.f}};
+    BitMask out(2, 3);
+    f(img, mask, 2.f, 3.f, out);
+    EXPECT_THAT(img, ElementsAre(mt, 2.f, mt, mt, mt, mt));
+    xt::xtensor<bool, 2> out_b = xt::zeros<bool>({2, 3});
+    out.toImageMask(out_b);
+    EXPECT_THAT(out_b, ElementsAre(true, false, true, true, true, true));
+  };
+
+  testWithOutput([](auto& src, const auto& m, float lb, float ub, auto& out)
+                 { maskImageDataZero(src, m, lb, ub, out); }, zero_mt);
+  testWithOutput([](auto& src, const auto& m, float lb, float ub, auto& out)
+                 { maskImageDataNan(src, m, lb, ub, out); }, nan_mt);
+}
+
 TEST(TestMovingAvgImageData, Test2D)
 {
   xt::xtensor<float, 2> img1 {{1.f, 2.f, 3.f}, {3.f, 4.f, 5.f}};
@@ -393,5 +494,155 @@ TEST(correctImageData, TestGainOffset2D)
   EXPECT_THAT(img, ElementsAre(nan_mt, -2.f, nan_mt, -1.f, 0.f, -2.f));
 }
 
+TEST(correctMaskNanmeanImageArray, TestGeneral)
+{
+  xt::xtensor<float, 3> imgs {{{nan, 2.f, 3.f}, {3.f, 4.f, 5.f}},
+                              {{1.f, 2.f, 3.f}, {6.f, 4.f, 5.f}}};
+  xt::xtensor<float, 3> offset {{{1.f, 1.f, 1.f}, {1.f, 1.f, 1.f}},
+                                {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}}};
+  xt::xtensor<float, 3> gain {{{2.f, 2.f, 2.f}, {2.f, 2.f, 2.f}},
+                              {{1.f, 1.f, 1.f}, {1.f, 1.f, 1.f}}};
+  xt::xtensor<bool, 2> mask {{false, false, false}, {false, true, false}};
+  auto empty_constants = xt::xtensor<float, 3>::from_shape({0, 0, 0});
+  auto empty_mask = xt::xtensor<bool, 2>::from_shape({0, 0});
+
+  xt::xtensor<bool, 2> mask_w {{true, true}, {true, true}};
+  EXPECT_THROW(correctMaskNanmeanImageArray(imgs, gain, offset, mask_w, 0.f, 6.f), std::invalid_argument);
+  xt::xtensor<float, 3> gain_w {xt::ones<float>({2, 2, 2})};
+  EXPECT_THROW(correctMaskNanmeanImageArray(imgs, gain_w, offset, mask, 0.f, 6.f), std::invalid_argument);
+  EXPECT_THROW(correctMaskNanmeanImageArray(imgs, gain, offset, mask, 0.f, 6.f, {}), std::invalid_argument);
+  EXPECT_THROW(correctMaskNanmeanImageArray(imgs, gain, offset, mask, 0.f, 6.f, {2}), std::out_of_range);
+
+  // correct with both gain and offset
+  auto imgs1 = imgs;
+  auto mean = correctMaskNanmeanImageArray(imgs1, gain, offset, mask, 0.f, 5.f);
+  EXPECT_THAT(xt::view(imgs1, 0, xt::all(), xt::all()), ElementsAre(nan_mt, 2.f, 4.f, 4.f, nan_mt, nan_mt));
+  EXPECT_THAT(xt::view(imgs1, 1, xt::all(), xt::all()), ElementsAre(1.f, 2.f, 3.f, nan_mt, nan_mt, 5.f));
+  EXPECT_THAT(mean, ElementsAre(1.f, 2.f, 3.5f, 4.f, nan_mt, 5.f));
+
+  // only the selected images contribute to the nanmean
+  auto imgs2 = imgs;
+  mean = correctMaskNanmeanImageArray(imgs2, gain, offset, mask, 0.f, 5.f, {1});
+  EXPECT_THAT(xt::view(imgs2, 0, xt::all(), xt::all()), ElementsAre(nan_mt, 2.f, 4.f, 4.f, nan_mt, nan_mt));
+  EXPECT_THAT(mean, ElementsAre(1.f, 2.f, 3.f, nan_mt, nan_mt, 5.f));
+
+  // offset only
+  auto imgs3 = imgs;
+  mean = correctMaskNanmeanImageArray(imgs3, empty_constants, offset, empty_mask, -10.f, 10.f);
+  EXPECT_THAT(xt::view(imgs3, 0, xt::all(), xt::all()), ElementsAre(nan_mt, 1.f, 2.f, 2.f, 3.f, 4.f));
+  EXPECT_THAT(mean, ElementsAre(1.f, 1.5f, 2.5f, 4.f, 3.5f, 4.5f));
+
+  // neither gain nor offset
+  auto imgs4 = imgs;
+  mean = correctMaskNanmeanImageArray(imgs4, empty_constants, empty_constants, mask, -10.f, 10.f);
+  EXPECT_THAT(xt::view(imgs4, 1, xt::all(), xt::all()), ElementsAre(1.f, 2.f, 3.f, 6.f, nan_mt, 5.f));
+  EXPECT_THAT(mean, ElementsAre(1.f, 2.f, 3.f, 4.5f, nan_mt, 5.f));
+}
+
+TEST(correctMaskNanmeanImageArray, TestBitMask)
+{
+  xt::xtensor<float, 3> imgs {{{nan, 2.f, 3.f}, {3.f, 4.f, 5.f}},
+                              {{1.f, 2.f, 3.f}, {6.f, 4.f, 5.f}}};
+  xt::xtensor<float, 3> offset {{{1.f, 1.f, 1.f}, {1.f, 1.f, 1.f}},
+                                {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}}};
+  xt::xtensor<float, 3> gain {{{2.f, 2.f, 2.f}, {2.f, 2.f, 2.f}},
+                              {{1.f, 1.f, 1.f}, {1.f, 1.f, 1.f}}};
+  xt::xtensor<bool, 2> mask {{false, false, false}, {false, true, false}};
+  BitMask bit_mask(mask);
+
+  EXPECT_THROW(correctMaskNanmeanImageArray(imgs, gain, offset, BitMask(2, 2), 0.f, 6.f),
+               std::invalid_argument);
+  EXPECT_THROW(correctMaskNanmeanImageArray(imgs, gain, offset, bit_mask, 0.f, 6.f, {}), std::invalid_argument);
+
+  auto imgs1 = imgs;
+  auto imgs2 = imgs;
+  correctMaskNanmeanImageArray(imgs1, gain, offset, mask, 0.f, 5.f);
+  auto mean = correctMaskNanmeanImageArray(imgs2, gain, offset, bit_mask, 0.f, 5.f);
+  for (std::size_t i = 0; i < imgs1.size(); ++i) EXPECT_THAT(imgs2.data()[i], NanSensitiveFloatEq(imgs1.data()[i]));
+  EXPECT_THAT(mean, ElementsAre(1.f, 2.f, 3.5f, 4.f, nan_mt, 5.f));
+
+  // an empty bit-packed mask means no image mask
+  auto imgs3 = imgs;
+  mean = correctMaskNanmeanImageArray(imgs3, gain, offset, BitMask(), 0.f, 5.f, {1});
+  EXPECT_THAT(mean, ElementsAre(1.f, 2.f, 3.f, nan_mt, 4.f, 5.f));
+}
+
+TEST(nanmeanOnOffImageArray, TestGeneral)
+{
+  xt::xtensor<float, 3> imgs {{{nan, 2.f, 3.f}, {3.f, 4.f, 5.f}},
+                              {{1.f, 2.f, 3.f}, {6.f, nan, 5.f}},
+                              {{3.f, 4.f, 1.f}, {2.f, nan, 1.f}}};
+  auto mean_on = xt::xtensor<float, 2>::from_shape({2, 3});
+  auto mean_off = xt::xtensor<float, 2>::from_shape({2, 3});
+
+  xt::xtensor<float, 2> mean_w = xt::xtensor<float, 2>::from_shape({3, 2});
+  EXPECT_THROW(nanmeanOnOffImageArray(imgs, {0}, {1}, mean_w, mean_off), std::invalid_argument);
+  EXPECT_THROW(nanmeanOnOffImageArray(imgs, {0}, {3}, mean_on, mean_off), std::out_of_range);
+
+  nanmeanOnOffImageArray(imgs, {0, 2}, {1}, mean_on, mean_off);
+  EXPECT_THAT(mean_on, ElementsAre(3.f, 3.f, 2.f, 2.5f, 4.f, 3.f));
+  EXPECT_THAT(mean_off, ElementsAre(1.f, 2.f, 3.f, 6.f, nan_mt, 5.f));
+  EXPECT_THAT(mean_on, ElementsAreArray(nanmeanImageArray(imgs, {0, 2})));
+
+  // an image can be both on and off
+  nanmeanOnOffImageArray(imgs, {1, 2}, {0, 1, 2}, mean_on, mean_off);
+  EXPECT_THAT(mean_on, ElementsAre(2.f, 3.f, 2.f, 4.f, nan_mt, 3.f));
+  EXPECT_THAT(mean_off, ElementsAre(2.f, 8.f / 3, 7.f / 3, 11.f / 3, 4.f, 11.f / 3));
+
+  // the output of an empty list is untouched
+  mean_off.fill(-1.f);
+  nanmeanOnOffImageArray(imgs, {1}, {}, mean_on, mean_off);
+  EXPECT_THAT(mean_on, ElementsAre(1.f, 2.f, 3.f, 6.f, nan_mt, 5.f));
+  EXPECT_THAT(mean_off, ElementsAre(-1.f, -1.f, -1.f, -1.f, -1.f, -1.f));
+}
+
+TEST(TestSimd, TestScalarConsistency)
+{
+  // The width is not a multiple of any batch size so that both the vectorized
+  // body and the scalar tail are exercised.
+  xt::xtensor<float, 3> imgs = xt::xtensor<float, 3>::from_shape({3, 4, 37});
+  xt::xtensor<float, 3> gain = xt::xtensor<float, 3>::from_shape({3, 4, 37});
+  xt::xtensor<float, 3> offset = xt::xtensor<float, 3>::from_shape({3, 4, 37});
+  xt::xtensor<bool, 2> mask = xt::xtensor<bool, 2>::from_shape({4, 37});
+  for (size_t i = 0; i < imgs.size(); ++i)
+  {
+    imgs[i] = (i % 7 == 0) ? nan : static_cast<float>(i % 11) - 5.f;
+    gain[i] = 0.5f + static_cast<float>(i % 3);
+    offset[i] = 0.25f * static_cast<float>(i % 5);
+  }
+  for (size_t i = 0; i < mask.size(); ++i) mask[i] = (i % 5 == 0);
+
+  auto isIdentical = [] (const auto& a, const auto& b)
+  {
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+      if (std::isnan(a[i]) != std::isnan(b[i])) return false;
+      if (! std::isnan(a[i]) && a[i] != b[i]) return false;
+    }
+    return true;
+  };
+
+  auto run = [&] (bool enabled)
+  {
+    setSimdEnabled(enabled);
+    auto src = imgs;
+    correctImageData(src, gain, offset);
+    movingAvgImageData(src, imgs, 3);
+    maskImageDataNan(src, mask, -2.f, 2.f);
+    auto mean = nanmeanImageArray(src);
+    auto src_zero = imgs;
+    maskImageDataZero(src_zero, mask, -2.f, 2.f);
+    setSimdEnabled(true);
+    return std::make_tuple(src, mean, src_zero);
+  };
+
+  auto scalar = run(false);
+  auto vectorized = run(true);
+
+  EXPECT_TRUE(isIdentical(std::get<0>(scalar), std::get<0>(vectorized)));
+  EXPECT_TRUE(isIdentical(std::get<1>(scalar), std::get<1>(vectorized)));
+  EXPECT_TRUE(isIdentical(std::get<2>(scalar), std::get<2>(vectorized)));
+}
+
 } // test
 } // foam
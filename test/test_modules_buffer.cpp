@@ -0,0 +1,111 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <cmath>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "xtensor/xtensor.hpp"
+
+#include "f_modules_buffer.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+TEST(TestModulesBuffer, TestGeneral)
+{
+  EXPECT_THROW(ModulesBuffer<float>(0, 4, 3), std::invalid_argument);
+
+  ModulesBuffer<float> buffer(2, 4, 3);
+  EXPECT_EQ(0, buffer.capacity());
+
+  buffer.reset(5);
+  EXPECT_EQ(5, buffer.capacity());
+  EXPECT_EQ((ModulesBuffer<float>::shape_type{5, 2, 4, 3}), buffer.shape());
+  EXPECT_EQ(0, reinterpret_cast<std::uintptr_t>(buffer.data()) % ModulesBuffer<float>::alignment);
+  float* data = buffer.data();
+
+  xt::xtensor<uint16_t, 3> src({5, 4, 3});
+  for (std::size_t i = 0; i < src.size(); ++i) src.data()[i] = static_cast<uint16_t>(i);
+  buffer.setModule(1, src);
+  EXPECT_TRUE(buffer.arrived(1));
+  EXPECT_FALSE(buffer.arrived(0));
+  EXPECT_EQ(1, buffer.nArrived());
+  EXPECT_FALSE(buffer.complete());
+  for (std::size_t ip = 0; ip < 5; ++ip)
+  {
+    for (std::size_t i = 0; i < 12; ++i)
+    {
+      EXPECT_EQ(static_cast<float>(ip * 12 + i), data[(ip * 2 + 1) * 12 + i]);
+    }
+  }
+
+  buffer.fillMissing(std::nanf(""));
+  for (std::size_t ip = 0; ip < 5; ++ip)
+  {
+    for (std::size_t i = 0; i < 12; ++i) EXPECT_TRUE(std::isnan(data[ip * 2 * 12 + i]));
+  }
+
+  xt::xtensor<uint16_t, 3> src_wrong({4, 4, 3});
+  EXPECT_THROW(buffer.setModule(0, src_wrong), std::invalid_argument);
+  EXPECT_THROW(buffer.setModule(2, src), std::out_of_range);
+
+  // the memory is reused for fewer memory cells
+  buffer.reset(3);
+  EXPECT_EQ(data, buffer.data());
+  EXPECT_EQ(5, buffer.capacity());
+  EXPECT_EQ(0, buffer.nArrived());
+
+  buffer.reset(6);
+  EXPECT_EQ(6, buffer.capacity());
+}
+
+TEST(TestModulesBuffer, TestStridedSource)
+{
+  std::size_t np = 7, ny = 4, nx = 3;
+  ModulesBuffer<float> buffer(2, ny, nx);
+  buffer.reset(np);
+
+  // the layout of the bridge data: (x, y, memory cells)
+  std::vector<float> src(np * ny * nx);
+  for (std::size_t ip = 0; ip < np; ++ip)
+  {
+    for (std::size_t j = 0; j < ny; ++j)
+    {
+      for (std::size_t k = 0; k < nx; ++k) src[(k * ny + j) * np + ip] = static_cast<float>(100 * ip + 10 * j + k);
+    }
+  }
+
+  std::array<std::ptrdiff_t, 3> strides {1, static_cast<std::ptrdiff_t>(np), static_cast<std::ptrdiff_t>(ny * np)};
+  buffer.setModule(0, src.data(), strides);
+  buffer.setModule(1, src.data(), strides);
+  EXPECT_TRUE(buffer.complete());
+
+  const float* data = buffer.data();
+  for (std::size_t ip = 0; ip < np; ++ip)
+  {
+    for (std::size_t im = 0; im < 2; ++im)
+    {
+      for (std::size_t j = 0; j < ny; ++j)
+      {
+        for (std::size_t k = 0; k < nx; ++k)
+        {
+          EXPECT_EQ(static_cast<float>(100 * ip + 10 * j + k), data[((ip * 2 + im) * ny + j) * nx + k]);
+        }
+      }
+    }
+  }
+}
+
+} //test
+} //foam
@@ -0,0 +1,233 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "f_parallel.hpp"
+
+#if defined(FOAM_WITH_TBB)
+#include "tbb/global_control.h"
+#endif
+
+namespace foam
+{
+namespace test
+{
+
+TEST(TestPartitionConfig, TestGeneral)
+{
+  EXPECT_EQ(PartitionMode::ROW, partitionConfig().mode);
+  EXPECT_EQ(1, partitionConfig().grain_size);
+  EXPECT_TRUE(partitionConfig().affinity);
+
+  EXPECT_EQ(PartitionMode::BLOCKED, toPartitionMode("blocked"));
+  EXPECT_EQ(PartitionMode::ROW, toPartitionMode("row"));
+  EXPECT_THROW(toPartitionMode("pulse"), std::invalid_argument);
+  EXPECT_EQ("blocked", toString(PartitionMode::BLOCKED));
+
+  {
+    ScopedPartitionConfig scoped({PartitionMode::BLOCKED, 4, false});
+    EXPECT_EQ(PartitionMode::BLOCKED, partitionConfig().mode);
+    EXPECT_EQ(4, partitionConfig().grain_size);
+    {
+      ScopedPartitionConfig nested({PartitionMode::ROW, 2, true});
+      EXPECT_EQ(2, partitionConfig().grain_size);
+    }
+    EXPECT_EQ(4, partitionConfig().grain_size);
+  }
+  EXPECT_EQ(PartitionMode::ROW, partitionConfig().mode);
+
+  EXPECT_THROW(setPartitionConfig({PartitionMode::ROW, 0, true}), std::invalid_argument);
+}
+
+TEST(TestParallelFor, TestCoverage)
+{
+  std::size_t n_images = 5, n_rows = 7, n_cols = 11;
+
+  for (auto mode : {PartitionMode::ROW, PartitionMode::BLOCKED})
+  {
+    for (auto affinity : {true, false})
+    {
+      ScopedPartitionConfig scoped({mode, 3, affinity});
+
+      // each element must be visited exactly once
+      std::vector<std::atomic<int>> visited(n_images * n_rows * n_cols);
+      for (auto& v : visited) v = 0;
+      detail::parallelForImageRows(n_images, n_rows, n_cols,
+        [&] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+        {
+          if (mode == PartitionMode::ROW) { EXPECT_EQ(n_cols, n); }
+          for (std::size_t k = k0; k < k0 + n; ++k) visited[(i * n_rows + j) * n_cols + k] += 1;
+        }
+      );
+      for (auto& v : visited) EXPECT_EQ(1, v);
+
+      std::vector<std::atomic<int>> visited_rows(n_rows * n_cols);
+      for (auto& v : visited_rows) v = 0;
+      detail::parallelForRows(n_rows, n_cols,
+        [&] (std::size_t j, std::size_t k0, std::size_t n)
+        {
+          for (std::size_t k = k0; k < k0 + n; ++k) visited_rows[j * n_cols + k] += 1;
+        }
+      );
+      for (auto& v : visited_rows) EXPECT_EQ(1, v);
+
+      std::vector<std::atomic<int>> visited_modules(n_images * 16);
+      for (auto& v : visited_modules) v = 0;
+      detail::parallelForPulsesModules(n_images, 16,
+        [&] (std::size_t ip, std::size_t im) { visited_modules[ip * 16 + im] += 1; }
+      );
+      for (auto& v : visited_modules) EXPECT_EQ(1, v);
+
+      std::atomic<std::size_t> total {0};
+      detail::parallelFor(100, [&] (std::size_t begin, std::size_t end) { total += end - begin; });
+      EXPECT_EQ(100, total);
+    }
+  }
+
+  // empty ranges
+  detail::parallelForImageRows(0, n_rows, n_cols,
+    [] (std::size_t, std::size_t, std::size_t, std::size_t) { FAIL(); });
+}
+
+TEST(TestNuma, TestRange)
+{
+  for (std::size_t n_nodes : {1, 2, 3})
+  {
+    std::size_t n = 10;
+    std::size_t begin = 0;
+    for (std::size_t node = 0; node < n_nodes; ++node)
+    {
+      auto range = detail::numaRange(n, n_nodes, node);
+      EXPECT_EQ(begin, range.first);
+      EXPECT_LE(range.second - range.first, n / n_nodes + 1);
+      begin = range.second;
+    }
+    EXPECT_EQ(n, begin);
+  }
+
+  // more nodes than items
+  EXPECT_EQ(detail::numaRange(2, 4, 0).first, detail::numaRange(2, 4, 0).second);
+}
+
+#if defined(FOAM_WITH_TBB)
+TEST(TestNuma, TestCoverage)
+{
+  detail::NumaArenas::instance().emulate(3);
+  EXPECT_EQ(3, numaNodeCount());
+  EXPECT_THROW(detail::NumaArenas::instance().emulate(0), std::invalid_argument);
+
+  std::size_t n_images = 7, n_rows = 5, n_cols = 9;
+  {
+    ScopedPartitionConfig scoped({PartitionMode::BLOCKED, 1, true, true});
+    EXPECT_TRUE(detail::numaActive());
+
+    std::vector<std::atomic<int>> nodes(n_images);
+    for (auto& v : nodes) v = -1;
+    detail::forEachNumaNode(n_images, [&] (std::size_t node, std::size_t begin, std::size_t end)
+    {
+      EXPECT_FALSE(detail::numaActive());
+      auto range = detail::numaRange(n_images, 3, node);
+      EXPECT_EQ(range.first, begin);
+      EXPECT_EQ(range.second, end);
+      for (auto i = begin; i < end; ++i) nodes[i] = static_cast<int>(node);
+    });
+    // 7 pulses over 3 nodes
+    std::vector<int> expected {0, 0, 1, 1, 2, 2, 2};
+    for (std::size_t i = 0; i < n_images; ++i) EXPECT_EQ(expected[i], nodes[i]);
+
+    std::vector<std::atomic<int>> visited(n_images * n_rows * n_cols);
+    for (auto& v : visited) v = 0;
+    detail::parallelForImageRows(n_images, n_rows, n_cols,
+      [&] (std::size_t i, std::size_t j, std::size_t k0, std::size_t n)
+      {
+        for (std::size_t k = k0; k < k0 + n; ++k) visited[(i * n_rows + j) * n_cols + k] += 1;
+      }
+    );
+    for (auto& v : visited) EXPECT_EQ(1, v);
+
+    std::vector<std::atomic<int>> visited_modules(n_images * 16);
+    for (auto& v : visited_modules) v = 0;
+    detail::parallelForPulsesModules(n_images, 16,
+      [&] (std::size_t ip, std::size_t im) { visited_modules[ip * 16 + im] += 1; }
+    );
+    for (auto& v : visited_modules) EXPECT_EQ(1, v);
+
+    // the exception is propagated after all the nodes have finished
+    std::atomic<int> n_finished {0};
+    EXPECT_THROW(detail::forEachNumaNode(n_images, [&] (std::size_t node, std::size_t, std::size_t)
+    {
+      ++n_finished;
+      if (node == 0) throw std::runtime_error("failed");
+    }), std::runtime_error);
+    EXPECT_EQ(3, n_finished);
+  }
+
+  EXPECT_FALSE(detail::numaActive());
+  detail::NumaArenas::instance().reset();
+}
+
+TEST(TestNuma, TestScopedConfigInsideNode)
+{
+  // allow worker threads to join the arenas even on a single core
+  tbb::global_control parallelism(tbb::global_control::max_allowed_parallelism, 4);
+  detail::NumaArenas::instance().emulate(2, 2);
+
+  {
+    ScopedPartitionConfig scoped({PartitionMode::BLOCKED, 3, false, true});
+
+    std::atomic<int> n_nodes {0};
+    std::atomic<int> n_started {0};
+    auto caller = std::this_thread::get_id();
+    std::atomic<bool> on_worker {false};
+    detail::forEachNumaNode(4, [&] (std::size_t, std::size_t, std::size_t)
+    {
+      // wait until both nodes are being processed, so that at least one of
+      // them runs on an arena worker thread instead of the calling thread
+      ++n_started;
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+      while (n_started < 2 && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+      if (std::this_thread::get_id() != caller) on_worker = true;
+
+      // the scoped config of the calling thread is in use on the arena threads
+      const auto& config = partitionConfig();
+      EXPECT_EQ(PartitionMode::BLOCKED, config.mode);
+      EXPECT_EQ(3u, config.grain_size);
+      EXPECT_FALSE(config.affinity);
+      EXPECT_TRUE(config.numa);
+      EXPECT_FALSE(detail::numaActive());
+      ++n_nodes;
+    });
+    EXPECT_EQ(2, n_nodes);
+    EXPECT_TRUE(on_worker);
+
+    // the kernels called inside a node use it as well
+    ScopedPartitionConfig nested({PartitionMode::ROW, 64, false, true});
+    detail::forEachNumaNode(256, [&] (std::size_t, std::size_t begin, std::size_t end)
+    {
+      detail::parallelFor(end - begin, [] (std::size_t block_begin, std::size_t block_end)
+      {
+        EXPECT_GE(block_end - block_begin, 64u);
+      });
+    });
+  }
+
+  EXPECT_EQ(1u, partitionConfig().grain_size);
+  detail::NumaArenas::instance().reset();
+}
+#endif
+
+} // test
+} // foam
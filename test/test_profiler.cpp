@@ -0,0 +1,168 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "f_profiler.hpp"
+#include "f_parallel.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using namespace profiler;
+
+namespace
+{
+
+StageStats findStage(const std::vector<StageStats>& stats, const std::string& name)
+{
+  auto it = std::find_if(stats.begin(), stats.end(), [&name] (const StageStats& s) { return s.name == name; });
+  return it == stats.end() ? StageStats() : *it;
+}
+
+class ScopedProfiling
+{
+public:
+  ScopedProfiling()
+  {
+    Registry::instance().reset();
+    Registry::instance().setEnabled(true);
+  }
+
+  ~ScopedProfiling()
+  {
+    Registry::instance().setEnabled(false);
+    Registry::instance().reset();
+  }
+};
+
+void profiledKernel(std::size_t n_bytes)
+{
+  FOAM_PROFILE_SCOPE("profiledKernel", n_bytes);
+  countAllocation();
+}
+
+} // namespace
+
+TEST(TestLatencyHistogram, TestBuckets)
+{
+  for (uint64_t v : {0ul, 1ul, 7ul, 8ul, 9ul, 15ul, 16ul, 17ul, 1000ul, 123456789ul})
+  {
+    auto idx = LatencyHistogram::bucket(v);
+    EXPECT_LE(LatencyHistogram::lowerBound(idx), v);
+    EXPECT_GT(LatencyHistogram::upperBound(idx), v);
+  }
+  EXPECT_EQ(LatencyHistogram::kNumBuckets - 1, LatencyHistogram::bucket(~uint64_t(0)));
+}
+
+TEST(TestLatencyHistogram, TestQuantile)
+{
+  LatencyHistogram hist;
+  EXPECT_EQ(0., hist.quantile(0.5));
+
+  for (uint64_t v = 1; v <= 1000; ++v) hist.add(1000 * v);
+  EXPECT_EQ(1000, hist.count());
+  EXPECT_EQ(1000000, hist.max());
+  // the relative error is bounded by the width of a bucket
+  EXPECT_NEAR(500000., hist.quantile(0.5), 500000. / 8);
+  EXPECT_NEAR(990000., hist.quantile(0.99), 990000. / 8);
+  EXPECT_EQ(1000000., hist.quantile(1.));
+}
+
+TEST(TestProfiler, TestDisabled)
+{
+  Registry::instance().reset();
+  ASSERT_FALSE(Registry::instance().enabled());
+
+  profiledKernel(100);
+  EXPECT_EQ(0, findStage(Registry::instance().collect(), "profiledKernel").count);
+}
+
+TEST(TestProfiler, TestScopedTimer)
+{
+  ScopedProfiling profiling;
+
+  for (int i = 0; i < 10; ++i) profiledKernel(100);
+
+  auto stats = findStage(Registry::instance().collect(), "profiledKernel");
+  EXPECT_EQ(10, stats.count);
+  EXPECT_EQ(1000, stats.bytes);
+  EXPECT_EQ(10, stats.allocations);
+  EXPECT_EQ(0, stats.tasks);
+  EXPECT_EQ(10, stats.latency.count());
+  EXPECT_GE(stats.total_ns, stats.latency.max());
+
+  // statistics are accumulated until being reset
+  profiledKernel(100);
+  stats = findStage(Registry::instance().collect(true), "profiledKernel");
+  EXPECT_EQ(11, stats.count);
+  EXPECT_EQ(0, findStage(Registry::instance().collect(), "profiledKernel").count);
+}
+
+TEST(TestProfiler, TestTaskCount)
+{
+  ScopedProfiling profiling;
+
+  {
+    FOAM_PROFILE_SCOPE("parallelKernel", 0);
+    foam::detail::parallelFor(100, [] (std::size_t, std::size_t) {});
+  }
+
+  auto stats = findStage(Registry::instance().collect(), "parallelKernel");
+  EXPECT_EQ(1, stats.count);
+#if defined(FOAM_WITH_TBB)
+  EXPECT_GE(stats.tasks, 1);
+#else
+  EXPECT_EQ(0, stats.tasks);
+#endif
+}
+
+TEST(TestProfiler, TestMultipleThreads)
+{
+  ScopedProfiling profiling;
+
+  std::size_t n_threads = 4;
+  std::size_t n_calls = 100;
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < n_threads; ++i)
+  {
+    threads.emplace_back([n_calls] { for (std::size_t j = 0; j < n_calls; ++j) profiledKernel(1); });
+  }
+  for (auto& t : threads) t.join();
+
+  // the buffers of the finished threads are still collected
+  auto stats = findStage(Registry::instance().collect(), "profiledKernel");
+  EXPECT_EQ(n_threads * n_calls, stats.count);
+  EXPECT_EQ(n_threads * n_calls, stats.bytes);
+  EXPECT_EQ(0, Registry::instance().nDropped());
+}
+
+TEST(TestProfiler, TestOverflow)
+{
+  ScopedProfiling profiling;
+
+  std::size_t n_calls = profiler::detail::kRingSize + 10;
+  for (std::size_t i = 0; i < n_calls; ++i) profiledKernel(1);
+
+  // the oldest samples are dropped
+  auto stats = findStage(Registry::instance().collect(), "profiledKernel");
+  EXPECT_EQ(profiler::detail::kRingSize - 1, stats.count);
+  EXPECT_EQ(11, Registry::instance().nDropped());
+}
+
+} // test
+} // foam
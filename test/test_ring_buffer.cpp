@@ -0,0 +1,215 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include <thread>
+
+#include <sys/wait.h>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "f_ring_buffer.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+class SharedRingBufferTest : public ::testing::Test
+{
+protected:
+  SharedRingBufferTest() : name_("/foam_test_ring_buffer_" + std::to_string(getpid())) {}
+
+  SharedRingBuffer::SlotInfo makeInfo(uint64_t tid, std::size_t n)
+  {
+    SharedRingBuffer::SlotInfo info;
+    info.tid = tid;
+    info.ndim = 1;
+    info.shape[0] = n;
+    info.nbytes = n * sizeof(uint64_t);
+    std::strcpy(info.dtype, "uint64");
+    return info;
+  }
+
+  std::string name_;
+};
+
+TEST_F(SharedRingBufferTest, TestGeneral)
+{
+  EXPECT_THROW(SharedRingBuffer(name_, 1, 1024), std::invalid_argument);
+  EXPECT_THROW(SharedRingBuffer(name_, 2, 0), std::invalid_argument);
+  EXPECT_THROW(SharedRingBuffer(name_ + "_missing"), std::runtime_error);
+
+  SharedRingBuffer producer(name_, 3, 1024);
+  EXPECT_TRUE(producer.owner());
+  EXPECT_EQ(3, producer.nSlots());
+  EXPECT_EQ(1024, producer.slotSize());
+  // the name is in use
+  EXPECT_THROW(SharedRingBuffer(name_, 3, 1024), std::runtime_error);
+
+  SharedRingBuffer consumer(name_);
+  EXPECT_FALSE(consumer.owner());
+  EXPECT_EQ(3, consumer.nSlots());
+  EXPECT_THROW(consumer.claim(), std::logic_error);
+
+  RingBufferHandle handle;
+  EXPECT_FALSE(consumer.latest(handle));
+
+  std::vector<uint64_t> data {1, 2, 3, 4};
+  auto published = producer.write(data.data(), makeInfo(10, data.size()));
+  ASSERT_TRUE(consumer.latest(handle));
+  EXPECT_EQ(published.slot, handle.slot);
+  EXPECT_EQ(published.seq, handle.seq);
+  EXPECT_EQ(10, handle.tid);
+
+  ASSERT_TRUE(consumer.acquire(handle));
+  auto info = consumer.info(handle.slot);
+  EXPECT_EQ(1, info.ndim);
+  EXPECT_EQ(4, info.shape[0]);
+  EXPECT_STREQ("uint64", info.dtype);
+  auto p = reinterpret_cast<const uint64_t*>(consumer.slotData(handle.slot));
+  EXPECT_THAT(std::vector<uint64_t>(p, p + 4), ::testing::ElementsAre(1, 2, 3, 4));
+  consumer.release(handle);
+
+  EXPECT_THROW(producer.write(data.data(), makeInfo(11, 1000)), std::invalid_argument);
+  EXPECT_THROW(consumer.acquire({3, 1, 10}), std::out_of_range);
+}
+
+TEST_F(SharedRingBufferTest, TestOverwrite)
+{
+  SharedRingBuffer producer(name_, 3, 1024);
+  SharedRingBuffer consumer(name_);
+
+  std::vector<uint64_t> data(8, 0);
+  auto held = producer.write(data.data(), makeInfo(1, data.size()));
+  auto stale = producer.write(data.data(), makeInfo(2, data.size()));
+  ASSERT_TRUE(consumer.acquire(held));
+
+  // the held slot is skipped while the others are overwritten
+  for (uint64_t tid = 3; tid < 10; ++tid)
+  {
+    auto handle = producer.write(data.data(), makeInfo(tid, data.size()));
+    EXPECT_NE(held.slot, handle.slot);
+  }
+  EXPECT_TRUE(consumer.valid(held));
+  EXPECT_FALSE(consumer.valid(stale));
+  EXPECT_FALSE(consumer.acquire(stale));
+
+  // no slot is available if all of them are held
+  RingBufferHandle latest;
+  ASSERT_TRUE(consumer.latest(latest));
+  ASSERT_TRUE(consumer.acquire(latest));
+  auto handle = producer.write(data.data(), makeInfo(10, data.size()));
+  ASSERT_TRUE(consumer.acquire(handle));
+  EXPECT_THROW(producer.claim(), std::runtime_error);
+
+  consumer.release(held);
+  EXPECT_EQ(held.slot, producer.write(data.data(), makeInfo(11, data.size())).slot);
+  EXPECT_FALSE(consumer.valid(held));
+
+  // claim without publishing
+  producer.claim();
+  EXPECT_THROW(producer.claim(), std::logic_error);
+  producer.abandon();
+  EXPECT_THROW(producer.claimedData(), std::logic_error);
+}
+
+TEST_F(SharedRingBufferTest, TestHolders)
+{
+  SharedRingBuffer producer(name_, 2, 1024);
+  SharedRingBuffer consumer(name_);
+
+  std::vector<uint64_t> data(8, 0);
+  auto handle = producer.write(data.data(), makeInfo(1, data.size()));
+  for (std::size_t i = 0; i < SharedRingBuffer::kMaxHolders; ++i) ASSERT_TRUE(consumer.acquire(handle));
+  EXPECT_EQ(SharedRingBuffer::kMaxHolders, consumer.nHolders(handle.slot));
+  EXPECT_FALSE(consumer.acquire(handle));
+
+  for (std::size_t i = 0; i < SharedRingBuffer::kMaxHolders; ++i) consumer.release(handle);
+  EXPECT_EQ(0, consumer.nHolders(handle.slot));
+  // the holds of a living process are not recovered
+  ASSERT_TRUE(consumer.acquire(handle));
+  EXPECT_EQ(0, producer.recover());
+  EXPECT_EQ(1, consumer.nHolders(handle.slot));
+}
+
+TEST_F(SharedRingBufferTest, TestDeadConsumer)
+{
+  SharedRingBuffer producer(name_, 2, 1024);
+  std::vector<uint64_t> data(8, 0);
+  auto held = producer.write(data.data(), makeInfo(1, data.size()));
+  auto handle = producer.write(data.data(), makeInfo(2, data.size()));
+
+  // the consumer dies without releasing the slot
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0)
+  {
+    SharedRingBuffer consumer(name_);
+    _exit(consumer.acquire(held) ? 0 : 1);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+  EXPECT_EQ(1, producer.nHolders(held.slot));
+
+  SharedRingBuffer consumer(name_);
+  ASSERT_TRUE(consumer.acquire(handle));
+
+  // the hold of the dead consumer is recovered once all the slots are held
+  EXPECT_EQ(held.slot, producer.write(data.data(), makeInfo(3, data.size())).slot);
+  EXPECT_EQ(0, producer.nHolders(held.slot));
+  EXPECT_FALSE(consumer.valid(held));
+  EXPECT_EQ(0, producer.recover());
+}
+
+TEST_F(SharedRingBufferTest, TestConcurrentReaders)
+{
+  SharedRingBuffer producer(name_, 4, 1024);
+  std::size_t n = 128;
+
+  std::atomic<bool> stop {false};
+  std::atomic<int> n_corrupted {0};
+  auto read = [this, n, &stop, &n_corrupted] ()
+  {
+    SharedRingBuffer consumer(name_);
+    while (!stop)
+    {
+      RingBufferHandle handle;
+      if (!consumer.latest(handle) || !consumer.acquire(handle)) continue;
+      auto p = reinterpret_cast<const uint64_t*>(consumer.slotData(handle.slot));
+      auto tid = consumer.info(handle.slot).tid;
+      for (std::size_t i = 0; i < n; ++i) if (p[i] != tid) ++n_corrupted;
+      consumer.release(handle);
+    }
+  };
+
+  std::thread t1(read);
+  std::thread t2(read);
+  std::vector<uint64_t> data(n);
+  for (uint64_t tid = 1; tid < 20000; ++tid)
+  {
+    std::fill(data.begin(), data.end(), tid);
+    try
+    {
+      producer.write(data.data(), makeInfo(tid, n));
+    } catch (std::runtime_error&)
+    {
+      producer.abandon();
+    }
+  }
+  stop = true;
+  t1.join();
+  t2.join();
+
+  EXPECT_EQ(0, n_corrupted);
+}
+
+} //test
+} //foam
@@ -0,0 +1,134 @@
+/**
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+ *
+ * Author: Jun Zhu <jun.zhu@xfel.eu>
+ * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
+ * All rights reserved.
+ */
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "xtensor/xtensor.hpp"
+#include "xtensor/xview.hpp"
+#include "xtensor/xmath.hpp"
+
+#include "f_roi.hpp"
+
+namespace foam
+{
+namespace test
+{
+
+using ::testing::ElementsAre;
+using ::testing::NanSensitiveDoubleEq;
+
+constexpr auto nan = std::numeric_limits<float>::quiet_NaN();
+
+double stat(const xt::xtensor<double, 3>& s, std::size_t i, std::size_t r, RoiStat type)
+{
+  return s(i, r, static_cast<std::size_t>(type));
+}
+
+class RoiTest : public ::testing::Test
+{
+protected:
+  RoiTest() : src_({2, 4, 5})
+  {
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+      for (std::size_t j = 0; j < 4; ++j)
+      {
+        for (std::size_t k = 0; k < 5; ++k) src_(i, j, k) = static_cast<float>(10 * i + 5 * j + k);
+      }
+    }
+    src_(0, 1, 1) = nan;
+  }
+
+  xt::xtensor<float, 3> src_;
+};
+
+TEST_F(RoiTest, TestStatistics)
+{
+  // the second ROI is clipped and the third one is outside the image
+  std::vector<std::array<int, 4>> rois {{0, 0, 2, 2}, {3, 2, 10, 10}, {10, 10, 2, 2}};
+  auto s = roiStatistics(src_, rois, -1e9, 1e9, true);
+  ASSERT_THAT(s.shape(), ElementsAre(2, 3, kNumRoiStats));
+
+  // values: 0, 1, 5
+  EXPECT_EQ(3, stat(s, 0, 0, RoiStat::COUNT));
+  EXPECT_DOUBLE_EQ(6., stat(s, 0, 0, RoiStat::SUM));
+  EXPECT_DOUBLE_EQ(2., stat(s, 0, 0, RoiStat::MEAN));
+  EXPECT_DOUBLE_EQ(1., stat(s, 0, 0, RoiStat::MEDIAN));
+  EXPECT_DOUBLE_EQ(0., stat(s, 0, 0, RoiStat::MIN));
+  EXPECT_DOUBLE_EQ(5., stat(s, 0, 0, RoiStat::MAX));
+  EXPECT_DOUBLE_EQ(14. / 3, stat(s, 0, 0, RoiStat::VAR));
+  EXPECT_DOUBLE_EQ(std::sqrt(14. / 3), stat(s, 0, 0, RoiStat::STD));
+
+  // values: 23, 24, 28, 29
+  EXPECT_EQ(4, stat(s, 1, 1, RoiStat::COUNT));
+  EXPECT_DOUBLE_EQ(104., stat(s, 1, 1, RoiStat::SUM));
+  EXPECT_DOUBLE_EQ(26., stat(s, 1, 1, RoiStat::MEDIAN));
+
+  // empty ROI
+  EXPECT_EQ(0, stat(s, 1, 2, RoiStat::COUNT));
+  EXPECT_EQ(0, stat(s, 1, 2, RoiStat::SUM));
+  for (auto type : {RoiStat::MEAN, RoiStat::MEDIAN, RoiStat::MIN, RoiStat::MAX, RoiStat::VAR, RoiStat::STD})
+  {
+    EXPECT_THAT(stat(s, 1, 2, type), NanSensitiveDoubleEq(nan));
+  }
+
+  // median is not calculated by default
+  auto s_no_median = roiStatistics(src_, rois);
+  EXPECT_THAT(stat(s_no_median, 0, 0, RoiStat::MEDIAN), NanSensitiveDoubleEq(nan));
+  EXPECT_DOUBLE_EQ(6., stat(s_no_median, 0, 0, RoiStat::SUM));
+
+  EXPECT_THROW(roiStatistics(src_, rois, 1., 0.), std::invalid_argument);
+}
+
+TEST_F(RoiTest, TestStatisticsWithMask)
+{
+  std::vector<std::array<int, 4>> rois {{0, 0, 5, 4}};
+  xt::xtensor<bool, 2> mask = xt::zeros<bool>({4, 5});
+  mask(0, 0) = true;
+  mask(3, 4) = true;
+
+  auto s = roiStatistics(src_, rois, mask, 2., 20.);
+  // the second image: 10 <= v <= 20 except the masked pixel 10
+  EXPECT_EQ(10, stat(s, 1, 0, RoiStat::COUNT));
+  EXPECT_DOUBLE_EQ(11., stat(s, 1, 0, RoiStat::MIN));
+  EXPECT_DOUBLE_EQ(20., stat(s, 1, 0, RoiStat::MAX));
+
+  // nan pixels in the first image are ignored: 2 <= v <= 19
+  EXPECT_EQ(16, stat(s, 0, 0, RoiStat::COUNT));
+
+  xt::xtensor<bool, 2> mask_wrong = xt::zeros<bool>({4, 4});
+  EXPECT_THROW(roiStatistics(src_, rois, mask_wrong), std::invalid_argument);
+}
+
+TEST_F(RoiTest, TestProjection)
+{
+  std::array<int, 4> roi {1, 0, 2, 3};
+
+  auto px = roiProjection(src_, roi, "x", false);
+  ASSERT_THAT(px.shape(), ElementsAre(2, 2));
+  EXPECT_THAT(xt::view(px, 0, xt::all()), ElementsAre(1 + 11, 2 + 7 + 12));
+  EXPECT_THAT(xt::view(px, 1, xt::all()), ElementsAre(11 + 16 + 21, 12 + 17 + 22));
+
+  xt::xtensor<bool, 2> mask = xt::zeros<bool>({4, 5});
+  mask(2, 1) = true;
+  auto py = roiProjection(src_, roi, mask, "y", true);
+  ASSERT_THAT(py.shape(), ElementsAre(2, 3));
+  EXPECT_THAT(xt::view(py, 0, xt::all()), ElementsAre(1.5, 7., 12.));
+  EXPECT_THAT(xt::view(py, 1, xt::all()), ElementsAre(11.5, 16.5, 22.));
+
+  // all the pixels in a column are invalid
+  auto px_thr = roiProjection(src_, roi, "x", true, 20., 30.);
+  EXPECT_THAT(xt::view(px_thr, 0, xt::all()), ElementsAre(NanSensitiveDoubleEq(nan), NanSensitiveDoubleEq(nan)));
+
+  EXPECT_THROW(roiProjection(src_, roi, "z", true), std::invalid_argument);
+}
+
+} //test
+} //foam
@@ -7,11 +7,15 @@
  * Copyright (C) European X-Ray Free-Electron Laser Facility GmbH.
  * All rights reserved.
  */
+#include <algorithm>
+
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
 #include "xtensor/xio.hpp"
 #include "xtensor/xtensor.hpp"
+#include "xtensor/xarray.hpp"
+#include "xtensor/xrandom.hpp"
 
 #include "f_statistics.hpp"
 
@@ -24,6 +28,199 @@ using ::testing::ElementsAre;
 using ::testing::ElementsAreArray;
 using ::testing::NanSensitiveFloatEq;
 using ::testing::FloatEq;
+using ::testing::NanSensitiveFloatNear;
+using ::testing::Pointwise;
+
+auto nan = std::numeric_limits<float>::quiet_NaN();
+auto nan_mt = NanSensitiveFloatEq(nan);
+
+template<typename E>
+xt::xarray<float> randomWithNan(const E& shape)
+{
+  xt::random::seed(42);
+  xt::xarray<float> a = xt::random::rand<float>(shape, -1.f, 1.f);
+  for (std::size_t i = 0; i < a.size(); i += 7) a.data()[i] = nan;
+  return a;
+}
+
+TEST(TestNanReducer, TestAllAxes)
+{
+  xt::xtensor<float, 2> a {{nan, 1.f, 2.f}, {3.f, 6.f, nan}};
+
+  EXPECT_FLOAT_EQ(12.f, foam::nansum(a));
+  EXPECT_FLOAT_EQ(3.f, foam::nanmean(a));
+  EXPECT_FLOAT_EQ(3.5f, foam::nanvar(a));
+  EXPECT_FLOAT_EQ(std::sqrt(3.5f), foam::nanstd(a));
+  EXPECT_FLOAT_EQ(1.f, foam::nanmin(a));
+  EXPECT_FLOAT_EQ(6.f, foam::nanmax(a));
+
+  xt::xtensor<float, 2> b {{nan, nan}, {nan, nan}};
+  EXPECT_FLOAT_EQ(0.f, foam::nansum(b));
+  EXPECT_THAT(foam::nanmean(b), nan_mt);
+  EXPECT_THAT(foam::nanvar(b), nan_mt);
+  EXPECT_THAT(foam::nanmin(b), nan_mt);
+  EXPECT_THAT(foam::nanmax(b), nan_mt);
+}
+
+TEST(TestNanReducer, TestAxes)
+{
+  xt::xtensor<float, 3> a {{{nan, nan, 2.f}, {3.f, 6.f, nan}},
+                           {{1.f, 4.f, nan}, {6.f, 3.f, nan}}};
+
+  // the last axis is kept
+  EXPECT_THAT(foam::nansum<xt::xarray<float>>(a, {0}), ElementsAre(1.f, 4.f, 2.f, 9.f, 9.f, 0.f));
+  EXPECT_THAT(foam::nanmean<xt::xarray<float>>(a, {0}), ElementsAre(1.f, 4.f, 2.f, 4.5f, 4.5f, nan_mt));
+  EXPECT_THAT(foam::nanmin<xt::xarray<float>>(a, {0, 1}), ElementsAre(1.f, 3.f, 2.f));
+  EXPECT_THAT(foam::nanmax<xt::xarray<float>>(a, {0, 1}), ElementsAre(6.f, 6.f, 2.f));
+  EXPECT_THAT(foam::nanvar<xt::xarray<float>>(a, {0}), ElementsAre(0.f, 0.f, 0.f, 2.25f, 2.25f, nan_mt));
+
+  // the last axis is reduced
+  EXPECT_THAT(foam::nansum<xt::xarray<float>>(a, {-1}), ElementsAre(2.f, 9.f, 5.f, 9.f));
+  EXPECT_THAT(foam::nanmean<xt::xarray<float>>(a, {1, 2}), ElementsAre(11.f / 3, 3.5f));
+  EXPECT_THAT(foam::nanstd<xt::xarray<float>>(a, {2}), ElementsAre(0.f, 1.5f, 1.5f, 1.5f));
+
+  auto ret = foam::nansum<xt::xarray<float>>(a, {1});
+  EXPECT_THAT(ret.shape(), ElementsAre(2, 3));
+  ret = foam::nansum<xt::xarray<float>>(a, {0, 2});
+  EXPECT_THAT(ret.shape(), ElementsAre(2));
+
+  EXPECT_THROW(foam::nansum<xt::xarray<float>>(a, {3}), std::invalid_argument);
+  EXPECT_THROW(foam::nansum<xt::xarray<float>>(a, {-4}), std::invalid_argument);
+  EXPECT_THROW(foam::nansum<xt::xarray<float>>(a, {1, -2}), std::invalid_argument);
+}
+
+TEST(TestNanReducer, TestAgainstXtensor)
+{
+  auto a = randomWithNan(std::vector<std::size_t>{3, 4, 5, 37});
+
+  for (auto axis : std::vector<std::vector<int>>{{0}, {1}, {3}, {0, 2}, {1, 3}, {0, 1, 2}, {0, 1, 2, 3}})
+  {
+    std::vector<std::size_t> xt_axis(axis.begin(), axis.end());
+    xt::xarray<float> sum_gt = xt::nansum<float>(a, xt_axis);
+    xt::xarray<float> mean_gt = xt::nanmean<float>(a, xt_axis);
+    EXPECT_THAT(foam::nansum<xt::xarray<float>>(a, axis), Pointwise(NanSensitiveFloatNear(1e-5), sum_gt));
+    EXPECT_THAT(foam::nanmean<xt::xarray<float>>(a, axis), Pointwise(NanSensitiveFloatNear(1e-6), mean_gt));
+  }
+}
+
+TEST(TestHistogramWithStats, TestGeneral)
+{
+  using Hist = xt::xtensor<int64_t, 1>;
+  using Centers = xt::xtensor<double, 1>;
+
+  xt::xtensor<float, 2> a {{nan, 1.f, 2.f}, {3.f, 6.f, nan}};
+  auto ret = histogramWithStats<Hist, Centers>(a, 4, 1., 3.);
+  EXPECT_THAT(std::get<0>(ret), ElementsAre(1, 0, 1, 1));
+  EXPECT_THAT(std::get<1>(ret), ElementsAre(1.25, 1.75, 2.25, 2.75));
+  EXPECT_DOUBLE_EQ(2., std::get<2>(ret));
+  EXPECT_DOUBLE_EQ(2., std::get<3>(ret));
+  EXPECT_DOUBLE_EQ(std::sqrt(2. / 3), std::get<4>(ret));
+
+  // auto range
+  ret = histogramWithStats<Hist, Centers>(a, 5, -std::numeric_limits<double>::infinity(),
+                                          std::numeric_limits<double>::infinity());
+  EXPECT_THAT(std::get<0>(ret), ElementsAre(1, 1, 1, 0, 1));
+  EXPECT_THAT(std::get<1>(ret), ElementsAre(1.5, 2.5, 3.5, 4.5, 5.5));
+  EXPECT_DOUBLE_EQ(3., std::get<2>(ret));
+  EXPECT_DOUBLE_EQ(2.5, std::get<3>(ret));
+
+  // no element within the range
+  ret = histogramWithStats<Hist, Centers>(a, 2, 10., 12.);
+  EXPECT_THAT(std::get<0>(ret), ElementsAre(0, 0));
+  EXPECT_TRUE(std::isnan(std::get<2>(ret)));
+  EXPECT_TRUE(std::isnan(std::get<3>(ret)));
+  EXPECT_TRUE(std::isnan(std::get<4>(ret)));
+
+  EXPECT_THROW((histogramWithStats<Hist, Centers>(a, 0, 1., 3.)), std::invalid_argument);
+  EXPECT_THROW((histogramWithStats<Hist, Centers>(a, 4, 3., 1.)), std::invalid_argument);
+  a(0, 0) = std::numeric_limits<float>::infinity();
+  EXPECT_THROW((histogramWithStats<Hist, Centers>(a, 4, 1., std::numeric_limits<double>::infinity())),
+               std::invalid_argument);
+}
+
+TEST(TestHistogramWithStats, TestMedian)
+{
+  using Hist = xt::xtensor<int64_t, 1>;
+  using Centers = xt::xtensor<double, 1>;
+
+  auto a = randomWithNan(std::vector<std::size_t>{37, 1001});
+  std::vector<float> sorted;
+  for (auto v : a) if (! std::isnan(v)) sorted.push_back(v);
+  std::sort(sorted.begin(), sorted.end());
+  std::size_t n = sorted.size();
+  double median_gt = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+
+  for (std::size_t n_bins : {1, 2, 13, 1000})
+  {
+    auto ret = histogramWithStats<Hist, Centers>(a, n_bins, -1., 1.);
+    EXPECT_EQ(static_cast<int64_t>(n), xt::sum(std::get<0>(ret))());
+    EXPECT_DOUBLE_EQ(median_gt, std::get<3>(ret));
+  }
+}
+
+TEST(TestQuickMinMax, TestGeneral)
+{
+  xt::xtensor<float, 2> a {{nan, 1.f, 2.f, 3.f, 4.f}, {5.f, 6.f, 7.f, 8.f, nan}};
+  EXPECT_EQ(std::make_pair(1., 8.), quickMinMax(a));
+  EXPECT_EQ(std::make_pair(1., 8.), quickMinMax(a, 1.));
+
+  // the estimated levels enclose the nearest ranks within a bin width
+  double width = 7. / detail::kLevelBins;
+  for (auto q : {0.9, 0.1})
+  {
+    auto levels = quickMinMax(a, q);
+    EXPECT_LE(levels.first, 2.);
+    EXPECT_GE(levels.first, 2. - width);
+    EXPECT_GE(levels.second, 7.);
+    EXPECT_LE(levels.second, 7. + width);
+  }
+  auto levels = quickMinMax(a, 0.7);
+  EXPECT_NEAR(3., levels.first, width);
+  EXPECT_NEAR(6., levels.second, width);
+
+  EXPECT_THROW(quickMinMax(a, 1.1), std::invalid_argument);
+  EXPECT_THROW(quickMinMax(a, -0.1), std::invalid_argument);
+
+  // non-finite elements are ignored
+  a(0, 1) = std::numeric_limits<float>::infinity();
+  EXPECT_EQ(std::make_pair(2., 8.), quickMinMax(a));
+
+  // constant
+  xt::xtensor<double, 2> b {{2., 2.}, {nan, 2.}};
+  EXPECT_EQ(std::make_pair(2., 2.), quickMinMax(b, 0.9));
+
+  // no finite element
+  xt::xtensor<float, 2> c {{nan, nan}};
+  EXPECT_TRUE(std::isnan(quickMinMax(c, 0.9).first));
+  EXPECT_TRUE(std::isnan(quickMinMax(c).second));
+}
+
+TEST(TestNanDownSampleImage, TestGeneral)
+{
+  using Image = xt::xtensor<float, 2>;
+
+  Image a {{1.f, 2.f, 3.f, 4.f, 5.f},
+           {3.f, nan, 5.f, nan, 7.f},
+           {nan, nan, 1.f, 1.f, 9.f}};
+
+  auto ret = nanDownSampleImage<Image>(a, 2);
+  ASSERT_THAT(ret.shape(), ElementsAre(2, 3));
+  EXPECT_THAT(ret, ElementsAre(2.f, 4.f, 6.f, nan_mt, 1.f, 9.f));
+
+  EXPECT_THAT(nanDownSampleImage<Image>(a, 1), Pointwise(NanSensitiveFloatEq(), a));
+
+  auto ret4 = nanDownSampleImage<Image>(a, 4);
+  ASSERT_THAT(ret4.shape(), ElementsAre(1, 2));
+  EXPECT_FLOAT_EQ(2.5f, ret4(0, 0));
+  EXPECT_FLOAT_EQ(7.f, ret4(0, 1));
+
+  EXPECT_THROW(nanDownSampleImage<Image>(a, 0), std::invalid_argument);
+
+  auto ret_levels = nanDownSampleImageWithLevels<Image>(a, 2, 1.);
+  EXPECT_THAT(std::get<0>(ret_levels), ElementsAre(2.f, 4.f, 6.f, nan_mt, 1.f, 9.f));
+  EXPECT_DOUBLE_EQ(1., std::get<1>(ret_levels));
+  EXPECT_DOUBLE_EQ(9., std::get<2>(ret_levels));
+}
 
 } //test
 } //foam
\ No newline at end of file